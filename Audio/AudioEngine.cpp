@@ -14,10 +14,14 @@
 #include "pch.h"
 #include "Audio.h"
 #include "SoundCommon.h"
+#include "ScopedInstrumentationEvent.h"
 
-#include <list>
 #include <unordered_map>
 
+#if !defined(_MSC_VER) || (_MSC_VER >= 1700)
+#include <thread>
+#endif
+
 using namespace DirectX;
 using namespace Microsoft::WRL;
 
@@ -102,6 +106,72 @@ namespace
         HANDLE mBufferEnd;
     };
 
+    // Each one-shot voice gets its own callback, so a completed voice identifies itself rather than
+    // requiring a scan of every playing one-shot
+    struct OneShotVoice : public IXAudio2VoiceCallback
+    {
+        OneShotVoice() :
+            voice( nullptr ),
+            voiceKey( 0 ),
+            pending( 0 ),
+            orphaned( 0 ),
+            playing( false ),
+            completed( nullptr ),
+            bufferEnd( nullptr )
+        {
+            memset( &listEntry, 0, sizeof(SLIST_ENTRY) );
+        }
+
+        STDMETHOD_(void, OnVoiceProcessingPassStart) (UINT32) override {}
+        STDMETHOD_(void, OnVoiceProcessingPassEnd)() override {}
+        STDMETHOD_(void, OnStreamEnd)() override {}
+        STDMETHOD_(void, OnBufferStart)( void* ) override {}
+
+        STDMETHOD_(void, OnBufferEnd)( void* context ) override
+        {
+            if ( context && !orphaned )
+            {
+                auto inotify = reinterpret_cast<IVoiceNotify*>( context );
+                inotify->OnBufferEnd();
+            }
+
+            // One-shots submit a single buffer, so this voice is now done
+            if ( InterlockedExchange( &pending, 0 ) )
+            {
+                InterlockedPushEntrySList( completed, &listEntry );
+                SetEvent( bufferEnd );
+            }
+        }
+
+        STDMETHOD_(void, OnLoopEnd)( void* ) override {}
+        STDMETHOD_(void, OnVoiceError)( void*, HRESULT ) override {}
+
+        SLIST_ENTRY             listEntry;
+        IXAudio2SourceVoice*    voice;
+        unsigned int            voiceKey;
+        volatile LONG           pending;
+        volatile LONG           orphaned;
+        bool                    playing;
+        PSLIST_HEADER           completed;
+        HANDLE                  bufferEnd;
+    };
+
+    static const size_t ONESHOT_BLOCK_SIZE = 32;
+
+    // Commands can be posted from any thread, and are run in order by the audio thread
+    struct AudioCommandEntry
+    {
+        SLIST_ENTRY                 listEntry;
+        AudioEngine::AudioCommand   command;
+        void*                       context;
+        float                       value;
+    };
+
+    static const size_t COMMAND_BLOCK_SIZE = 64;
+
+    // Longest the audio thread waits between updates, which streaming and virtual voices rely on
+    static const DWORD AUDIO_THREAD_INTERVAL = 10;
+
     static const XAUDIO2FX_REVERB_I3DL2_PARAMETERS gReverbPresets[] =
     {
         XAUDIO2FX_I3DL2_PRESET_DEFAULT,             // Reverb_Off
@@ -267,29 +337,50 @@ public:
         defaultRate( 44100 ),
         maxVoiceOneshots( SIZE_MAX ),
         maxVoiceInstances( SIZE_MAX ),
+        maxVoiceIdlePerFormat( SIZE_MAX ),
+        maxAudibleInstances( SIZE_MAX ),
         mMasterVolume( 1.f ),
         mCriticalError( false ),
         mReverbEnabled( false ),
         mEngineFlags( AudioEngine_Default ),
         mCategory( AudioCategory_GameEffects ),
-        mVoiceInstances( 0 )
+        mOneShotsPlaying( 0 ),
+        mVoicesIdle( 0 ),
+        mAudibleInstances( 0 ),
+        mHasVirtualVoices( false ),
+        mOperationSet( 0 ),
+        mVoiceInstances( 0 ),
+        mThreadQuit( nullptr ),
+        mCommandReady( nullptr ),
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+        mThread( nullptr ),
+#endif
+        mThreadRunning( false ),
+        mAcceptPosts( 0 ),
+        mPostsInFlight( 0 )
 #if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
         ,mDLL(nullptr)
 #endif
     {
         memset( &mX3DAudio, 0, X3DAUDIO_HANDLE_BYTESIZE );
+        InitializeSListHead( &mCompletedOneShots );
+        InitializeSListHead( &mCommandQueue );
+        InitializeSListHead( &mCommandFree );
     };
 
-#if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
     ~Impl()
     {
+        // Covers a constructor which threw after the audio thread started
+        StopThread();
+
+#if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
         if (mDLL)
         {
             FreeLibrary(mDLL);
             mDLL = nullptr;
         }
-    }
 #endif
+    }
 
     HRESULT Initialize( AUDIO_ENGINE_FLAGS flags, _In_opt_ const WAVEFORMATEX* wfx, _In_opt_z_ const wchar_t* deviceId, AUDIO_STREAM_CATEGORY category );
 
@@ -307,7 +398,12 @@ public:
         
     AudioStatistics GetStatistics() const;
 
+    template<typename T>
+    void Apply3D( const AudioListener& listener, _In_reads_(count) T* const* instances, _In_reads_(count) const AudioEmitter* emitters, size_t count );
+
     void TrimVoicePool();
+
+    void SetMaxVoiceIdlePerFormat( size_t maxIdle );
     
     void AllocateVoice( _In_ const WAVEFORMATEX* wfx, SOUND_EFFECT_INSTANCE_FLAGS flags, bool oneshot, _Outptr_result_maybenull_ IXAudio2SourceVoice** voice );
     void DestroyVoice( _In_ IXAudio2SourceVoice* voice );
@@ -315,6 +411,17 @@ public:
     void RegisterNotify( _In_ IVoiceNotify* notify, bool usesUpdate );
     void UnregisterNotify( _In_ IVoiceNotify* notify, bool oneshots, bool usesUpdate );
 
+    void RegisterVirtualVoice( _In_ IVirtualVoice* voice );
+    void UnregisterVirtualVoice( _In_ IVirtualVoice* voice );
+    bool ReserveAudibleVoice();
+
+    void Post( _In_ AudioCommand command, _In_opt_ void* context, float value );
+
+    bool IsUsingAudioThread() const { return mThreadRunning; }
+
+    // Serializes the audio thread with engine calls from other threads (recursive so callbacks can call back in)
+    mutable std::recursive_mutex        mLock;
+
     ComPtr<IXAudio2>                    xaudio2;
     IXAudio2MasteringVoice*             mMasterVoice;
     IXAudio2SubmixVoice*                mReverbVoice;
@@ -326,6 +433,8 @@ public:
     int                                 defaultRate;
     size_t                              maxVoiceOneshots;
     size_t                              maxVoiceInstances;
+    size_t                              maxVoiceIdlePerFormat;
+    size_t                              maxAudibleInstances;
     float                               mMasterVolume;
 
     X3DAUDIO_HANDLE                     mX3DAudio;
@@ -337,20 +446,79 @@ public:
 
 private:
     typedef std::set<IVoiceNotify*> notifylist_t;
-    typedef std::list<std::pair<unsigned int, IXAudio2SourceVoice*>> oneshotlist_t;
-    typedef std::unordered_multimap<unsigned int, IXAudio2SourceVoice*> voicepool_t;
+    typedef std::vector<OneShotVoice*> oneshotlist_t;
+    typedef std::unordered_map<unsigned int, oneshotlist_t> voicepool_t;
+
+    OneShotVoice* AcquireOneShot();
+    void ReleaseOneShot( _In_ OneShotVoice* oneshot );
+    void DestroyOneShots();
+    void UpdateVirtualVoices();
+    bool ProcessUpdate( DWORD result );
+
+    void StartThread();
+    void StopThread();
+    void AudioThread();
+    void ExecuteCommands();
+
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+    static DWORD WINAPI AudioThreadProc( LPVOID param );
+#endif
+
+    struct VirtualRank
+    {
+        IVirtualVoice*  voice;
+        int             priority;
+        float           audibility;
+
+        bool operator < ( const VirtualRank& other ) const
+        {
+            // Sorts the most important voices first
+            if ( priority != other.priority )
+                return priority > other.priority;
+            return audibility > other.audibility;
+        }
+    };
+
+    // Completed one-shots are pushed from the XAudio2 callback thread, so this must stay aligned
+    SLIST_HEADER                        mCompletedOneShots;
 
     AUDIO_STREAM_CATEGORY               mCategory;
     ComPtr<IUnknown>                    mReverbEffect;
     ComPtr<IUnknown>                    mVolumeLimiter;
-    oneshotlist_t                       mOneShots;
+    std::vector<std::unique_ptr<OneShotVoice[]>> mOneShotBlocks;
+    oneshotlist_t                       mOneShotFree;
     voicepool_t                         mVoicePool;
+    size_t                              mOneShotsPlaying;
+    size_t                              mVoicesIdle;
+    std::set<IVirtualVoice*>            mVirtualVoices;
+    std::vector<VirtualRank>            mVirtualRanks;
+    size_t                              mAudibleInstances;
+    bool                                mHasVirtualVoices;
+    UINT32                              mOperationSet;
     notifylist_t                        mNotifyObjects;
     notifylist_t                        mNotifyUpdates;
     size_t                              mVoiceInstances;
     VoiceCallback                       mVoiceCallback;
     EngineCallback                      mEngineCallback;
 
+    // Posted commands are pushed without locking, so these must stay aligned
+    SLIST_HEADER                        mCommandQueue;
+    SLIST_HEADER                        mCommandFree;
+    std::mutex                          mCommandBlockLock;
+    std::vector<std::unique_ptr<AudioCommandEntry[]>> mCommandBlocks;
+    HANDLE                              mThreadQuit;
+    HANDLE                              mCommandReady;
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+    HANDLE                              mThread;
+#else
+    std::thread                         mThread;
+#endif
+    bool                                mThreadRunning;
+
+    // Post only queues while the thread accepts commands, and StopThread waits for posts in flight before closing mCommandReady
+    volatile LONG                       mAcceptPosts;
+    volatile LONG                       mPostsInFlight;
+
 #if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
     HMODULE                             mDLL;
 #endif
@@ -363,13 +531,23 @@ HRESULT AudioEngine::Impl::Initialize( AUDIO_ENGINE_FLAGS flags, const WAVEFORMA
     mEngineFlags = flags;
     mCategory = category;
 
-    return Reset( wfx, deviceId );
+    HRESULT hr = Reset( wfx, deviceId );
+
+    // The thread also runs in 'silent mode' so a later Reset can resume processing
+    if ( ( flags & AudioEngine_UseAudioThread ) && ( SUCCEEDED(hr) || hr == HRESULT_FROM_WIN32( ERROR_NOT_FOUND ) ) )
+    {
+        StartThread();
+    }
+
+    return hr;
 }
 
 
 _Use_decl_annotations_
 HRESULT AudioEngine::Impl::Reset( const WAVEFORMATEX* wfx, const wchar_t* deviceId )
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     if ( wfx )
     {
         if ( wfx->wFormatTag != WAVE_FORMAT_PCM )
@@ -725,25 +903,15 @@ HRESULT AudioEngine::Impl::Reset( const WAVEFORMATEX* wfx, const wchar_t* device
 
 void AudioEngine::Impl::SetSilentMode()
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     for( auto it = mNotifyObjects.begin(); it != mNotifyObjects.end(); ++it )
     {
         assert( *it != 0 );
         (*it)->OnCriticalError();
     }
 
-    for( auto it = mOneShots.begin(); it != mOneShots.end(); ++it )
-    {
-        assert( it->second != 0 );
-        it->second->DestroyVoice();
-    }
-    mOneShots.clear();
-
-    for( auto it = mVoicePool.begin(); it != mVoicePool.end(); ++it )
-    {
-        assert( it->second != 0 );
-        it->second->DestroyVoice();
-    }
-    mVoicePool.clear();
+    DestroyOneShots();
 
     mVoiceInstances = 0;
 
@@ -758,6 +926,11 @@ void AudioEngine::Impl::SetSilentMode()
 
 void AudioEngine::Impl::Shutdown()
 {
+    StopThread();
+
+    // Run anything posted before shutdown while its targets are still valid
+    ExecuteCommands();
+
     for( auto it = mNotifyObjects.begin(); it != mNotifyObjects.end(); ++it )
     {
         assert( *it != 0 );
@@ -770,19 +943,7 @@ void AudioEngine::Impl::Shutdown()
 
         xaudio2->StopEngine();
 
-        for( auto it = mOneShots.begin(); it != mOneShots.end(); ++it )
-        {
-            assert( it->second != 0 );
-            it->second->DestroyVoice();
-        }
-        mOneShots.clear();
-
-        for( auto it = mVoicePool.begin(); it != mVoicePool.end(); ++it )
-        {
-            assert( it->second != 0 );
-            it->second->DestroyVoice();
-        }
-        mVoicePool.clear();
+        DestroyOneShots();
 
         mVoiceInstances = 0;
 
@@ -805,11 +966,29 @@ void AudioEngine::Impl::Shutdown()
 
 bool AudioEngine::Impl::Update()
 {
+    if ( mThreadRunning )
+    {
+        // The audio thread does the processing, and consumes the events
+        std::lock_guard<std::recursive_mutex> lock( mLock );
+        return ( xaudio2 != 0 );
+    }
+
     if ( !xaudio2 )
         return false;
 
+    ScopedInstrumentationEvent event( InstrumentationCategory_Audio, L"AudioEngine::Update", nullptr, 0, mNotifyUpdates.size() );
+
     HANDLE events[2] = { mEngineCallback.mCriticalError, mVoiceCallback.mBufferEnd };
     DWORD result = WaitForMultipleObjectsEx( 2, events, FALSE, 0, FALSE );
+    if ( result == WAIT_FAILED )
+        throw std::exception( "WaitForMultipleObjects" );
+
+    return ProcessUpdate( result );
+}
+
+
+bool AudioEngine::Impl::ProcessUpdate( DWORD result )
+{
     switch( result )
     {
     case WAIT_TIMEOUT:
@@ -822,47 +1001,23 @@ bool AudioEngine::Impl::Update()
         return false;
     
     case WAIT_OBJECT_0 + 1: // OnBufferEnd
-        // Scan for completed one-shot voices
-        for( auto it = mOneShots.begin(); it != mOneShots.end(); )
+        // Process only the one-shot voices that reported completion
+        for( auto entry = InterlockedFlushSList( &mCompletedOneShots ); entry; )
         {
-            assert( it->second != 0 );
-
-            XAUDIO2_VOICE_STATE xstate;
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-            it->second->GetState( &xstate, XAUDIO2_VOICE_NOSAMPLESPLAYED );
-#else
-            it->second->GetState( &xstate );
-#endif
+            auto oneshot = CONTAINING_RECORD( entry, OneShotVoice, listEntry );
+            entry = entry->Next;
 
-            if ( !xstate.BuffersQueued )
-            {
-                it->second->Stop( 0 );
-                if ( it->first )
-                {
-                    // Put voice back into voice pool for reuse since it has a non-zero voiceKey
-#ifdef VERBOSE_TRACE
-                    DebugTrace( "INFO: One-shot voice being saved for reuse (%08X)\n", it->first );
-#endif
-                    voicepool_t::value_type v( it->first, it->second );
-                    mVoicePool.emplace( v );
-                }
-                else
-                {
-                    // Voice is to be destroyed rather than reused
-#ifdef VERBOSE_TRACE
-                    DebugTrace( "INFO: Destroying one-shot voice\n" );
-#endif
-                    it->second->DestroyVoice();
-                }
-                it = mOneShots.erase( it );
-            }
-            else
-                ++it;
+            ReleaseOneShot( oneshot );
         }
         break;
+    }
 
-    case WAIT_FAILED:
-        throw std::exception( "WaitForMultipleObjects" );
+    //
+    // Assign source voices to the most audible instances
+    //
+    if ( maxAudibleInstances != SIZE_MAX || mHasVirtualVoices )
+    {
+        UpdateVirtualVoices();
     }
 
     //
@@ -881,6 +1036,8 @@ bool AudioEngine::Impl::Update()
 _Use_decl_annotations_
 void AudioEngine::Impl::SetReverb( const XAUDIO2FX_REVERB_PARAMETERS* native )
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     if ( !mReverbVoice )
         return;
 
@@ -904,6 +1061,8 @@ void AudioEngine::Impl::SetReverb( const XAUDIO2FX_REVERB_PARAMETERS* native )
 
 void AudioEngine::Impl::SetMasteringLimit( int release, int loudness )
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     if ( !mVolumeLimiter || !mMasterVoice )
         return;
     
@@ -924,11 +1083,13 @@ void AudioEngine::Impl::SetMasteringLimit( int release, int loudness )
 
 AudioStatistics AudioEngine::Impl::GetStatistics() const
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     AudioStatistics stats;
     memset( &stats, 0, sizeof(stats) );
 
-    stats.allocatedVoices = stats.allocatedVoicesOneShot = mOneShots.size() + mVoicePool.size();
-    stats.allocatedVoicesIdle = mVoicePool.size();
+    stats.allocatedVoices = stats.allocatedVoicesOneShot = mOneShotsPlaying + mVoicesIdle;
+    stats.allocatedVoicesIdle = mVoicesIdle;
 
     for( auto it = mNotifyObjects.begin(); it != mNotifyObjects.end(); ++it )
     {
@@ -936,14 +1097,50 @@ AudioStatistics AudioEngine::Impl::GetStatistics() const
         (*it)->GatherStatistics( stats );
     }
 
-    assert( stats.allocatedVoices == ( mOneShots.size() + mVoicePool.size() + mVoiceInstances ) );
+    assert( stats.allocatedVoices == ( mOneShotsPlaying + mVoicesIdle + mVoiceInstances ) );
 
     return stats;
 }
 
 
+template<typename T>
+void AudioEngine::Impl::Apply3D( const AudioListener& listener, T* const* instances, const AudioEmitter* emitters, size_t count )
+{
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
+    if ( !instances || !emitters )
+        throw std::exception( "Apply3D requires instances and emitters" );
+
+    if ( !xaudio2 )
+        return;
+
+    // XAUDIO2_COMMIT_NOW is zero, so skip it when the counter wraps
+    if ( ++mOperationSet == XAUDIO2_COMMIT_NOW )
+        ++mOperationSet;
+
+    bool commit = false;
+    for( size_t j = 0; j < count; ++j )
+    {
+        auto instance = instances[ j ];
+        if ( !instance )
+            continue;
+
+        if ( instance->Apply3D( listener, emitters[ j ], mOperationSet ) )
+            commit = true;
+    }
+
+    if ( commit )
+    {
+        HRESULT hr = xaudio2->CommitChanges( mOperationSet );
+        ThrowIfFailed( hr );
+    }
+}
+
+
 void AudioEngine::Impl::TrimVoicePool()
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     for( auto it = mNotifyObjects.begin(); it != mNotifyObjects.end(); ++it )
     {
         assert( *it != 0 );
@@ -952,10 +1149,221 @@ void AudioEngine::Impl::TrimVoicePool()
 
     for( auto it = mVoicePool.begin(); it != mVoicePool.end(); ++it )
     {
-        assert( it->second != 0 );
-        it->second->DestroyVoice();
+        auto& idle = it->second;
+        for( auto vit = idle.begin(); vit != idle.end(); ++vit )
+        {
+            auto oneshot = *vit;
+            assert( oneshot != 0 && oneshot->voice != 0 && !oneshot->playing );
+            oneshot->voice->DestroyVoice();
+            oneshot->voice = nullptr;
+            mOneShotFree.push_back( oneshot );
+        }
+    }
+    mVoicePool.clear();
+    mVoicesIdle = 0;
+
+    // Reclaim any one-shots which finished without reporting completion (i.e. the play failed after allocation)
+    for( auto it = mOneShotBlocks.begin(); it != mOneShotBlocks.end(); ++it )
+    {
+        for( size_t j = 0; j < ONESHOT_BLOCK_SIZE; ++j )
+        {
+            auto oneshot = &(*it)[ j ];
+            if ( !oneshot->playing )
+                continue;
+
+            XAUDIO2_VOICE_STATE xstate;
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+            oneshot->voice->GetState( &xstate, XAUDIO2_VOICE_NOSAMPLESPLAYED );
+#else
+            oneshot->voice->GetState( &xstate );
+#endif
+
+            if ( !xstate.BuffersQueued && InterlockedExchange( &oneshot->pending, 0 ) )
+            {
+                oneshot->voice->Stop( 0 );
+                oneshot->voice->DestroyVoice();
+                oneshot->voice = nullptr;
+                oneshot->playing = false;
+                --mOneShotsPlaying;
+                mOneShotFree.push_back( oneshot );
+            }
+        }
+    }
+}
+
+
+void AudioEngine::Impl::SetMaxVoiceIdlePerFormat( size_t maxIdle )
+{
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
+    maxVoiceIdlePerFormat = maxIdle;
+
+    for( auto it = mVoicePool.begin(); it != mVoicePool.end(); ++it )
+    {
+        auto& idle = it->second;
+        while ( idle.size() > maxIdle )
+        {
+            auto oneshot = idle.back();
+            idle.pop_back();
+
+            assert( oneshot != 0 && oneshot->voice != 0 );
+            oneshot->voice->DestroyVoice();
+            oneshot->voice = nullptr;
+            mOneShotFree.push_back( oneshot );
+            --mVoicesIdle;
+        }
+    }
+}
+
+
+void AudioEngine::Impl::UpdateVirtualVoices()
+{
+    // Voices already audible are favored slightly so near-equal instances don't swap voices every frame
+    static const float HYSTERESIS = 1.25f;
+
+    mVirtualRanks.clear();
+
+    for( auto it = mVirtualVoices.begin(); it != mVirtualVoices.end(); ++it )
+    {
+        VirtualRank rank;
+        rank.voice = *it;
+        if ( !rank.voice->GetAudibility( rank.priority, rank.audibility ) )
+            continue;
+
+        if ( !rank.voice->IsVirtual() )
+            rank.audibility *= HYSTERESIS;
+
+        mVirtualRanks.push_back( rank );
+    }
+
+    size_t audible = std::min( mVirtualRanks.size(), maxAudibleInstances );
+    if ( audible < mVirtualRanks.size() )
+    {
+        std::nth_element( mVirtualRanks.begin(), mVirtualRanks.begin() + audible, mVirtualRanks.end() );
+    }
+
+    // Release voices before handing them out again
+    bool hasVirtual = false;
+    for( size_t j = audible; j < mVirtualRanks.size(); ++j )
+    {
+        auto voice = mVirtualRanks[ j ].voice;
+        if ( !voice->IsVirtual() )
+        {
+            voice->SetVirtual( true );
+        }
+        hasVirtual = true;
+    }
+
+    for( size_t j = 0; j < audible; ++j )
+    {
+        auto voice = mVirtualRanks[ j ].voice;
+        if ( voice->IsVirtual() )
+        {
+            voice->SetVirtual( false );
+
+            // Stay virtual if a voice could not be allocated (i.e. 'silent mode')
+            if ( voice->IsVirtual() )
+                hasVirtual = true;
+        }
+    }
+
+    mAudibleInstances = audible;
+    mHasVirtualVoices = hasVirtual;
+}
+
+
+OneShotVoice* AudioEngine::Impl::AcquireOneShot()
+{
+    if ( mOneShotFree.empty() )
+    {
+        // One-shot records are allocated in blocks and never moved, as XAudio2 holds their callback pointers
+        std::unique_ptr<OneShotVoice[]> block( new OneShotVoice[ ONESHOT_BLOCK_SIZE ] );
+
+        mOneShotFree.reserve( mOneShotFree.size() + ONESHOT_BLOCK_SIZE );
+        for( size_t j = ONESHOT_BLOCK_SIZE; j > 0; --j )
+        {
+            auto oneshot = &block[ j - 1 ];
+            oneshot->completed = &mCompletedOneShots;
+            oneshot->bufferEnd = mVoiceCallback.mBufferEnd;
+            mOneShotFree.push_back( oneshot );
+        }
+
+        mOneShotBlocks.emplace_back( std::move( block ) );
+    }
+
+    auto oneshot = mOneShotFree.back();
+    mOneShotFree.pop_back();
+
+    assert( !oneshot->voice && !oneshot->playing );
+    return oneshot;
+}
+
+
+void AudioEngine::Impl::ReleaseOneShot( OneShotVoice* oneshot )
+{
+    assert( oneshot != 0 && oneshot->voice != 0 && oneshot->playing );
+
+    oneshot->voice->Stop( 0 );
+    oneshot->playing = false;
+
+    assert( mOneShotsPlaying > 0 );
+    --mOneShotsPlaying;
+
+    if ( oneshot->voiceKey )
+    {
+        auto& idle = mVoicePool[ oneshot->voiceKey ];
+        if ( idle.size() < maxVoiceIdlePerFormat )
+        {
+            // Put voice back into voice pool for reuse since it has a non-zero voiceKey
+#ifdef VERBOSE_TRACE
+            DebugTrace( "INFO: One-shot voice being saved for reuse (%08X)\n", oneshot->voiceKey );
+#endif
+            idle.push_back( oneshot );
+            ++mVoicesIdle;
+            return;
+        }
+    }
+
+    // Voice is to be destroyed rather than reused
+#ifdef VERBOSE_TRACE
+    DebugTrace( "INFO: Destroying one-shot voice\n" );
+#endif
+    oneshot->voice->DestroyVoice();
+    oneshot->voice = nullptr;
+    mOneShotFree.push_back( oneshot );
+}
+
+
+void AudioEngine::Impl::DestroyOneShots()
+{
+    for( auto it = mOneShotBlocks.begin(); it != mOneShotBlocks.end(); ++it )
+    {
+        for( size_t j = 0; j < ONESHOT_BLOCK_SIZE; ++j )
+        {
+            auto oneshot = &(*it)[ j ];
+            if ( oneshot->voice )
+            {
+                oneshot->voice->DestroyVoice();
+                oneshot->voice = nullptr;
+            }
+            oneshot->playing = false;
+            oneshot->pending = 0;
+        }
+    }
+
+    (void)InterlockedFlushSList( &mCompletedOneShots );
+
+    mOneShotFree.clear();
+    for( auto it = mOneShotBlocks.begin(); it != mOneShotBlocks.end(); ++it )
+    {
+        for( size_t j = 0; j < ONESHOT_BLOCK_SIZE; ++j )
+        {
+            mOneShotFree.push_back( &(*it)[ j ] );
+        }
     }
+
     mVoicePool.clear();
+    mOneShotsPlaying = mVoicesIdle = 0;
 }
 
 
@@ -965,6 +1373,8 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
     if ( !wfx )
         throw std::exception( "Wave format is required\n" );
 
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     // No need to call IsValid on wfx because CreateSourceVoice will do that
 
     if ( !voice )
@@ -981,6 +1391,7 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
 #endif
 
     unsigned int voiceKey = 0;
+    OneShotVoice* oneshotVoice = nullptr;
     if ( oneshot )
     {
         if ( flags & ( SoundEffectInstance_Use3D | SoundEffectInstance_ReverbUseFilters | SoundEffectInstance_NoSetPitch ) )
@@ -1010,12 +1421,15 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
             if ( voiceKey != 0 )
             {
                 auto it = mVoicePool.find( voiceKey );
-                if ( it != mVoicePool.end() )
+                if ( it != mVoicePool.end() && !it->second.empty() )
                 {
                     // Found a matching (stopped) voice to reuse
-                    assert( it->second != 0 );
-                    *voice = it->second;
-                    mVoicePool.erase( it );
+                    oneshotVoice = it->second.back();
+                    it->second.pop_back();
+                    --mVoicesIdle;
+
+                    assert( oneshotVoice != 0 && oneshotVoice->voice != 0 );
+                    *voice = oneshotVoice->voice;
 
                     // Reset any volume/pitch-shifting
                     HRESULT hr = (*voice)->SetVolume(1.f);
@@ -1035,10 +1449,10 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
                         ThrowIfFailed( hr );
                     }
                 }
-                else if ( ( mVoicePool.size() + mOneShots.size() + 1 ) >= maxVoiceOneshots )
+                else if ( ( mVoicesIdle + mOneShotsPlaying + 1 ) >= maxVoiceOneshots )
                 {
                     DebugTrace( "WARNING: Too many one-shot voices in use (%Iu + %Iu >= %Iu); one-shot not played\n",
-                                mVoicePool.size(), mOneShots.size() + 1, maxVoiceOneshots );
+                                mVoicesIdle, mOneShotsPlaying + 1, maxVoiceOneshots );
                     return;
                 }
                 else
@@ -1080,18 +1494,28 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
 
                     assert( voiceKey == makeVoiceKey( wfmt ) );
 
-                    HRESULT hr = xaudio2->CreateSourceVoice( voice, wfmt, 0, XAUDIO2_DEFAULT_FREQ_RATIO, &mVoiceCallback, nullptr, nullptr );
+                    oneshotVoice = AcquireOneShot();
+
+                    HRESULT hr = xaudio2->CreateSourceVoice( voice, wfmt, 0, XAUDIO2_DEFAULT_FREQ_RATIO, oneshotVoice, nullptr, nullptr );
                     if ( FAILED(hr) )
                     {
+                        mOneShotFree.push_back( oneshotVoice );
                         DebugTrace( "ERROR: CreateSourceVoice (reuse) failed with error %08X\n", hr );
                         throw std::exception( "CreateSourceVoice" );
                     }
+
+                    oneshotVoice->voice = *voice;
+                    oneshotVoice->voiceKey = voiceKey;
                 }
 
                 assert( *voice != 0 );
                 HRESULT hr = (*voice)->SetSourceSampleRate( wfx->nSamplesPerSec );
                 if ( FAILED(hr) )
                 {
+                    (*voice)->DestroyVoice();
+                    *voice = nullptr;
+                    oneshotVoice->voice = nullptr;
+                    mOneShotFree.push_back( oneshotVoice );
                     DebugTrace( "ERROR: SetSourceSampleRate failed with error %08X\n", hr );
                     throw std::exception( "SetSourceSampleRate" );
                 }
@@ -1103,12 +1527,14 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
     {
         if ( oneshot )
         {
-            if ( ( mVoicePool.size() + mOneShots.size() + 1 ) >= maxVoiceOneshots )
+            if ( ( mVoicesIdle + mOneShotsPlaying + 1 ) >= maxVoiceOneshots )
             {
                 DebugTrace( "WARNING: Too many one-shot voices in use (%Iu + %Iu >= %Iu); one-shot not played; see TrimVoicePool\n",
-                            mVoicePool.size(), mOneShots.size() + 1, maxVoiceOneshots );
+                            mVoicesIdle, mOneShotsPlaying + 1, maxVoiceOneshots );
                 return;
             }
+
+            oneshotVoice = AcquireOneShot();
         }
         else if ( ( mVoiceInstances + 1 ) >= maxVoiceInstances )
         {
@@ -1118,6 +1544,8 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
 
         UINT32 vflags = ( flags & SoundEffectInstance_NoSetPitch ) ? XAUDIO2_VOICE_NOPITCH : 0;
 
+        IXAudio2VoiceCallback* callback = ( oneshotVoice ) ? static_cast<IXAudio2VoiceCallback*>( oneshotVoice ) : &mVoiceCallback;
+
         HRESULT hr;
         if ( flags & SoundEffectInstance_Use3D )
         {
@@ -1132,7 +1560,7 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
                         wfx->nChannels, wfx->wBitsPerSample, wfx->nBlockAlign, wfx->nSamplesPerSec );
 #endif
 
-            hr = xaudio2->CreateSourceVoice( voice, wfx, vflags, XAUDIO2_DEFAULT_FREQ_RATIO, &mVoiceCallback, &sendList, nullptr );
+            hr = xaudio2->CreateSourceVoice( voice, wfx, vflags, XAUDIO2_DEFAULT_FREQ_RATIO, callback, &sendList, nullptr );
         }
         else
         {
@@ -1141,15 +1569,24 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
                         wfx->nChannels, wfx->wBitsPerSample, wfx->nBlockAlign, wfx->nSamplesPerSec );
 #endif
 
-            hr = xaudio2->CreateSourceVoice( voice, wfx, vflags, XAUDIO2_DEFAULT_FREQ_RATIO, &mVoiceCallback, nullptr, nullptr );
+            hr = xaudio2->CreateSourceVoice( voice, wfx, vflags, XAUDIO2_DEFAULT_FREQ_RATIO, callback, nullptr, nullptr );
         }
 
         if ( FAILED(hr) )
         {
+            if ( oneshotVoice )
+                mOneShotFree.push_back( oneshotVoice );
+
             DebugTrace( "ERROR: CreateSourceVoice failed with error %08X\n", hr );
             throw std::exception( "CreateSourceVoice" );
         }
-        else if ( !oneshot )
+        else if ( oneshotVoice )
+        {
+            // Non-reusable formats get a voice of their own, destroyed when it completes
+            oneshotVoice->voice = *voice;
+            oneshotVoice->voiceKey = 0;
+        }
+        else
         {
             ++mVoiceInstances;
         }
@@ -1157,33 +1594,35 @@ void AudioEngine::Impl::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INS
 
     if ( oneshot )
     {
-        assert( *voice != 0 );
-        mOneShots.emplace_back( std::make_pair( voiceKey, *voice ) );
+        assert( *voice != 0 && oneshotVoice != 0 );
+        oneshotVoice->orphaned = 0;
+        oneshotVoice->pending = 1;
+        oneshotVoice->playing = true;
+        ++mOneShotsPlaying;
     }
 }
 
 
 void AudioEngine::Impl::DestroyVoice( _In_ IXAudio2SourceVoice* voice )
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     if ( !voice )
         return;
 
 #ifndef NDEBUG
-    for( auto it = mOneShots.cbegin(); it != mOneShots.cend(); ++it )
+    for( auto it = mOneShotBlocks.cbegin(); it != mOneShotBlocks.cend(); ++it )
     {
-        if ( it->second == voice )
+        for( size_t j = 0; j < ONESHOT_BLOCK_SIZE; ++j )
         {
-            DebugTrace( "ERROR: DestroyVoice should not be called for a one-shot voice\n" );
-            throw std::exception( "DestroyVoice" );
-        }
-    }
-
-    for( auto it = mVoicePool.cbegin(); it != mVoicePool.cend(); ++it )
-    {
-        if ( it->second == voice )
-        {
-            DebugTrace( "ERROR: DestroyVoice should not be called for a one-shot voice; see TrimVoicePool\n" );
-            throw std::exception( "DestroyVoice" );
+            auto& oneshot = (*it)[ j ];
+            if ( oneshot.voice == voice )
+            {
+                DebugTrace( ( oneshot.playing )
+                            ? "ERROR: DestroyVoice should not be called for a one-shot voice\n"
+                            : "ERROR: DestroyVoice should not be called for a one-shot voice; see TrimVoicePool\n" );
+                throw std::exception( "DestroyVoice" );
+            }
         }
     }
 #endif
@@ -1196,6 +1635,8 @@ void AudioEngine::Impl::DestroyVoice( _In_ IXAudio2SourceVoice* voice )
 
 void AudioEngine::Impl::RegisterNotify( _In_ IVoiceNotify* notify, bool usesUpdate )
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     assert( notify != 0 );
     mNotifyObjects.insert( notify );
 
@@ -1206,49 +1647,325 @@ void AudioEngine::Impl::RegisterNotify( _In_ IVoiceNotify* notify, bool usesUpda
 }
 
 
+void AudioEngine::Impl::RegisterVirtualVoice( _In_ IVirtualVoice* voice )
+{
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
+    assert( voice != 0 );
+    mVirtualVoices.insert( voice );
+}
+
+
+void AudioEngine::Impl::UnregisterVirtualVoice( _In_ IVirtualVoice* voice )
+{
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
+    assert( voice != 0 );
+    mVirtualVoices.erase( voice );
+}
+
+
+bool AudioEngine::Impl::ReserveAudibleVoice()
+{
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
+    if ( maxAudibleInstances == SIZE_MAX )
+        return true;
+
+    // The count is rebuilt by each Update, so this only limits instances started between updates
+    if ( mAudibleInstances >= maxAudibleInstances )
+    {
+        mHasVirtualVoices = true;
+        return false;
+    }
+
+    ++mAudibleInstances;
+    return true;
+}
+
+
 void AudioEngine::Impl::UnregisterNotify( _In_ IVoiceNotify* notify, bool usesOneShots, bool usesUpdate )
 {
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
     assert( notify != 0 );
     mNotifyObjects.erase( notify );
 
     // Check for any pending one-shots for this notification object
     if ( usesOneShots )
     {
-        bool setevent = false;
-
-        for( auto it = mOneShots.begin(); it != mOneShots.end(); ++it )
+        for( auto it = mOneShotBlocks.begin(); it != mOneShotBlocks.end(); ++it )
         {
-            assert( it->second != 0 );
+            for( size_t j = 0; j < ONESHOT_BLOCK_SIZE; ++j )
+            {
+                auto& oneshot = (*it)[ j ];
+                if ( !oneshot.playing )
+                    continue;
+
+                assert( oneshot.voice != 0 );
 
-            XAUDIO2_VOICE_STATE state;
+                XAUDIO2_VOICE_STATE state;
 #if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-            it->second->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED );
+                oneshot.voice->GetState(&state, XAUDIO2_VOICE_NOSAMPLESPLAYED );
 #else
-            it->second->GetState(&state);
+                oneshot.voice->GetState(&state);
 #endif
 
-            if ( state.pCurrentBufferContext == notify )
-            {
-                it->second->Stop( 0 );
-                it->second->FlushSourceBuffers();
-                setevent = true;
+                if ( state.pCurrentBufferContext == notify )
+                {
+                    // The flushed buffer still reports completion, but must not call back into the notify object
+                    InterlockedExchange( &oneshot.orphaned, 1 );
+                    oneshot.voice->Stop( 0 );
+                    oneshot.voice->FlushSourceBuffers();
+                }
             }
         }
+    }
+
+    if ( usesUpdate )
+    {
+        mNotifyUpdates.erase( notify );
+    }
+}
+
+
 
-        if (setevent)
+_Use_decl_annotations_
+void AudioEngine::Impl::Post( AudioCommand command, void* context, float value )
+{
+    if ( !command )
+        throw std::exception( "Post requires a command" );
+
+    if ( !mAcceptPosts )
+    {
+        std::lock_guard<std::recursive_mutex> lock( mLock );
+        command( context, value );
+        return;
+    }
+
+    auto entry = InterlockedPopEntrySList( &mCommandFree );
+    if ( !entry )
+    {
+        // Only growing the pool takes a lock; the block's spare entries go to the free list
+        std::lock_guard<std::mutex> lock( mCommandBlockLock );
+
+        std::unique_ptr<AudioCommandEntry[]> block( new AudioCommandEntry[ COMMAND_BLOCK_SIZE ] );
+        for( size_t j = 1; j < COMMAND_BLOCK_SIZE; ++j )
         {
-            // Trigger scan on next call to Update...
-            SetEvent( mVoiceCallback.mBufferEnd );
+            InterlockedPushEntrySList( &mCommandFree, &block[ j ].listEntry );
         }
+
+        entry = &block[ 0 ].listEntry;
+        mCommandBlocks.push_back( std::move( block ) );
     }
 
-    if ( usesUpdate )
+    auto cmd = CONTAINING_RECORD( entry, AudioCommandEntry, listEntry );
+    cmd->command = command;
+    cmd->context = context;
+    cmd->value = value;
+
+    // Check again once counted, as StopThread may have started since; it waits for this post before closing the event
+    InterlockedIncrement( &mPostsInFlight );
+
+    if ( !mAcceptPosts )
     {
-        mNotifyUpdates.erase( notify );
+        InterlockedDecrement( &mPostsInFlight );
+        InterlockedPushEntrySList( &mCommandFree, entry );
+
+        std::lock_guard<std::recursive_mutex> lock( mLock );
+        command( context, value );
+        return;
+    }
+
+    InterlockedPushEntrySList( &mCommandQueue, entry );
+    SetEvent( mCommandReady );
+
+    InterlockedDecrement( &mPostsInFlight );
+}
+
+
+void AudioEngine::Impl::ExecuteCommands()
+{
+    auto entry = InterlockedFlushSList( &mCommandQueue );
+    if ( !entry )
+        return;
+
+    // The list is last-in first-out, so reverse it to run commands in the order they were posted
+    PSLIST_ENTRY ordered = nullptr;
+    while ( entry )
+    {
+        auto next = entry->Next;
+        entry->Next = ordered;
+        ordered = entry;
+        entry = next;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock( mLock );
+
+    while ( ordered )
+    {
+        auto next = ordered->Next;
+
+        auto cmd = CONTAINING_RECORD( ordered, AudioCommandEntry, listEntry );
+        auto command = cmd->command;
+        auto context = cmd->context;
+        auto value = cmd->value;
+
+        InterlockedPushEntrySList( &mCommandFree, ordered );
+
+        command( context, value );
+
+        ordered = next;
+    }
+}
+
+
+void AudioEngine::Impl::StartThread()
+{
+    if ( mThreadRunning )
+        return;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    mThreadQuit = CreateEventEx( nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE );
+    mCommandReady = CreateEventEx( nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE );
+#else
+    mThreadQuit = CreateEvent( nullptr, FALSE, FALSE, nullptr );
+    mCommandReady = CreateEvent( nullptr, FALSE, FALSE, nullptr );
+#endif
+    if ( !mThreadQuit || !mCommandReady )
+    {
+        StopThread();
+        throw std::exception( "CreateEvent" );
+    }
+
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+    mThread = CreateThread( nullptr, 0, AudioThreadProc, this, 0, nullptr );
+    if ( !mThread )
+    {
+        StopThread();
+        throw std::exception( "CreateThread" );
+    }
+#else
+    mThread = std::thread( &AudioEngine::Impl::AudioThread, this );
+#endif
+
+    mThreadRunning = true;
+
+    InterlockedExchange( &mAcceptPosts, 1 );
+}
+
+
+void AudioEngine::Impl::StopThread()
+{
+    if ( mThreadRunning )
+    {
+        // Later posts run directly, and any already queued are left for Shutdown to run after the thread exits
+        InterlockedExchange( &mAcceptPosts, 0 );
+
+        while ( mPostsInFlight != 0 )
+        {
+            SwitchToThread();
+        }
+
+        SetEvent( mThreadQuit );
+
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+        WaitForSingleObject( mThread, INFINITE );
+        CloseHandle( mThread );
+        mThread = nullptr;
+#else
+        mThread.join();
+#endif
+
+        mThreadRunning = false;
+    }
+
+    if ( mThreadQuit )
+    {
+        CloseHandle( mThreadQuit );
+        mThreadQuit = nullptr;
+    }
+
+    if ( mCommandReady )
+    {
+        CloseHandle( mCommandReady );
+        mCommandReady = nullptr;
     }
 }
 
 
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+DWORD WINAPI AudioEngine::Impl::AudioThreadProc( LPVOID param )
+{
+    static_cast<AudioEngine::Impl*>( param )->AudioThread();
+    return 0;
+}
+#endif
+
+
+void AudioEngine::Impl::AudioThread()
+{
+#if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
+    // XAudio 2.7 is a COM object
+    HRESULT hrCom = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+#endif
+
+    HANDLE events[4] = { mThreadQuit, mEngineCallback.mCriticalError, mVoiceCallback.mBufferEnd, mCommandReady };
+
+    for(;;)
+    {
+        DWORD result = WaitForMultipleObjectsEx( 4, events, FALSE, AUDIO_THREAD_INTERVAL, FALSE );
+        if ( result == WAIT_OBJECT_0 )
+            break;
+
+        if ( result == WAIT_FAILED )
+        {
+            DebugTrace( "ERROR: AudioEngine audio thread failed waiting for events (%08X)\n", HRESULT_FROM_WIN32( GetLastError() ) );
+            break;
+        }
+
+        // Exceptions can't propagate out of the thread, so report them and keep servicing the engine
+        try
+        {
+            ExecuteCommands();
+
+            std::lock_guard<std::recursive_mutex> lock( mLock );
+
+            if ( xaudio2 )
+            {
+                switch( result )
+                {
+                case WAIT_OBJECT_0 + 1: // OnCriticalError
+                    ProcessUpdate( WAIT_OBJECT_0 );
+                    break;
+
+                case WAIT_OBJECT_0 + 2: // OnBufferEnd
+                    ProcessUpdate( WAIT_OBJECT_0 + 1 );
+                    break;
+
+                default:                // Posted commands or the update interval elapsed
+                    ProcessUpdate( WAIT_TIMEOUT );
+                    break;
+                }
+            }
+        }
+        catch( std::exception& e )
+        {
+#ifndef _DEBUG
+            UNREFERENCED_PARAMETER(e);
+#endif
+            DebugTrace( "ERROR: AudioEngine audio thread update failed (%s)\n", e.what() );
+        }
+    }
+
+#if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
+    if ( SUCCEEDED(hrCom) )
+    {
+        CoUninitialize();
+    }
+#endif
+}
+
 //--------------------------------------------------------------------------------------
 // AudioEngine
 //--------------------------------------------------------------------------------------
@@ -1354,6 +2071,8 @@ bool AudioEngine::Reset( const WAVEFORMATEX* wfx, const wchar_t* deviceId )
 
 void AudioEngine::Suspend()
 {
+    std::lock_guard<std::recursive_mutex> lock( pImpl->mLock );
+
     if ( !pImpl->xaudio2 )
         return;
 
@@ -1363,6 +2082,8 @@ void AudioEngine::Suspend()
 
 void AudioEngine::Resume()
 {
+    std::lock_guard<std::recursive_mutex> lock( pImpl->mLock );
+
     if ( !pImpl->xaudio2 )
         return;
 
@@ -1381,6 +2102,8 @@ void AudioEngine::SetMasterVolume( float volume )
 {
     assert( volume >= -XAUDIO2_MAX_VOLUME_LEVEL && volume <= XAUDIO2_MAX_VOLUME_LEVEL );
 
+    std::lock_guard<std::recursive_mutex> lock( pImpl->mLock );
+
     pImpl->mMasterVolume = volume;
 
     if ( pImpl->mMasterVoice )
@@ -1423,6 +2146,20 @@ void AudioEngine::SetMasteringLimit( int release, int loudness )
 
 
 // Public accessors.
+_Use_decl_annotations_
+void AudioEngine::Apply3D( const AudioListener& listener, SoundEffectInstance* const* instances, const AudioEmitter* emitters, size_t count )
+{
+    pImpl->Apply3D( listener, instances, emitters, count );
+}
+
+
+_Use_decl_annotations_
+void AudioEngine::Apply3D( const AudioListener& listener, DynamicSoundEffectInstance* const* instances, const AudioEmitter* emitters, size_t count )
+{
+    pImpl->Apply3D( listener, instances, emitters, count );
+}
+
+
 AudioStatistics AudioEngine::GetStatistics() const
 {
     return pImpl->GetStatistics();
@@ -1479,6 +2216,12 @@ bool AudioEngine::IsCriticalError() const
 }
 
 
+AUDIO_ENGINE_FLAGS AudioEngine::GetFlags() const
+{
+    return pImpl->mEngineFlags;
+}
+
+
 // Voice management.
 void AudioEngine::SetDefaultSampleRate( int sampleRate )
 {
@@ -1505,6 +2248,21 @@ void AudioEngine::TrimVoicePool()
 }
 
 
+void AudioEngine::SetMaxVoicePoolPerFormat( size_t maxIdle )
+{
+    pImpl->SetMaxVoiceIdlePerFormat( maxIdle );
+}
+
+
+void AudioEngine::SetMaxAudibleInstances( size_t maxAudible )
+{
+    if ( !maxAudible )
+        throw std::out_of_range( "AudioEngine::SetMaxAudibleInstances" );
+
+    pImpl->maxAudibleInstances = maxAudible;
+}
+
+
 _Use_decl_annotations_
 void AudioEngine::AllocateVoice( const WAVEFORMATEX* wfx, SOUND_EFFECT_INSTANCE_FLAGS flags, bool oneshot, IXAudio2SourceVoice** voice )
 {
@@ -1530,6 +2288,49 @@ void AudioEngine::UnregisterNotify( _In_ IVoiceNotify* notify, bool oneshots, bo
 }
 
 
+void AudioEngine::RegisterVirtualVoice( _In_ IVirtualVoice* voice )
+{
+    pImpl->RegisterVirtualVoice( voice );
+}
+
+
+void AudioEngine::UnregisterVirtualVoice( _In_ IVirtualVoice* voice )
+{
+    pImpl->UnregisterVirtualVoice( voice );
+}
+
+
+bool AudioEngine::ReserveAudibleVoice()
+{
+    return pImpl->ReserveAudibleVoice();
+}
+
+
+_Use_decl_annotations_
+void AudioEngine::Post( AudioCommand command, void* context, float value )
+{
+    pImpl->Post( command, context, value );
+}
+
+
+bool AudioEngine::IsUsingAudioThread() const
+{
+    return pImpl->IsUsingAudioThread();
+}
+
+
+void AudioEngine::Lock()
+{
+    pImpl->mLock.lock();
+}
+
+
+void AudioEngine::Unlock()
+{
+    pImpl->mLock.unlock();
+}
+
+
 IXAudio2* AudioEngine::GetInterface() const
 {
     return pImpl->xaudio2.Get();
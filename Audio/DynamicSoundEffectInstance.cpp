@@ -16,6 +16,14 @@
 
 using namespace DirectX;
 
+namespace
+{
+    struct aligned_deleter { void operator()( void* p ) { _aligned_free( p ); } };
+
+    // Matches the refill threshold used by the buffer-needed callback
+    static const uint32_t DEFAULT_RING_BUFFERS = 3;
+}
+
 
 //======================================================================================
 // DynamicSoundEffectInstance
@@ -31,7 +39,13 @@ public:
         mBase(),
         mBufferEvent( INVALID_HANDLE_VALUE ),
         mBufferNeeded( nullptr ),
-        mObject( object )
+        mBufferFill( nullptr ),
+        mObject( object ),
+        mRingBufferBytes( 0 ),
+        mRingStride( 0 ),
+        mRingCount( 0 ),
+        mRingNext( 0 ),
+        mTargetLatency( 0 )
     {
         if ( ( sampleRate < XAUDIO2_MIN_SAMPLE_RATE )
              || ( sampleRate > XAUDIO2_MAX_SAMPLE_RATE ) )
@@ -96,6 +110,10 @@ public:
 
     void SubmitBuffer( _In_reads_bytes_(audioBytes) const uint8_t* pAudioData, uint32_t offset, size_t audioBytes );
 
+    void SetBufferFill( _In_opt_ std::function<size_t(DynamicSoundEffectInstance*, uint8_t*, size_t)> fillBuffer, size_t bufferBytes );
+
+    void SetTargetLatency( uint32_t latencyMS );
+
     const WAVEFORMATEX* GetFormat() const { return &mWaveFormat; } ;
 
     // IVoiceNotify
@@ -134,10 +152,20 @@ public:
     SoundEffectInstanceBase                             mBase;
 
 private:
+    void AllocateRing();
+    void FillBuffers();
+
     HANDLE                                              mBufferEvent;
     std::function<void(DynamicSoundEffectInstance*)>    mBufferNeeded;
+    std::function<size_t(DynamicSoundEffectInstance*, uint8_t*, size_t)> mBufferFill;
     DynamicSoundEffectInstance*                         mObject;
     WAVEFORMATEX                                        mWaveFormat;
+    std::unique_ptr<uint8_t, aligned_deleter>           mRing;
+    size_t                                              mRingBufferBytes;
+    size_t                                              mRingStride;
+    uint32_t                                            mRingCount;
+    uint32_t                                            mRingNext;
+    uint32_t                                            mTargetLatency;
 };
 
 
@@ -150,7 +178,11 @@ void DynamicSoundEffectInstance::Impl::Play()
 
     (void)mBase.Play();
 
-    if ( mBase.voice && ( mBase.state == PLAYING ) && ( mBase.GetPendingBufferCount() <= 2 ) )
+    if ( mBufferFill )
+    {
+        FillBuffers();
+    }
+    else if ( mBase.voice && ( mBase.state == PLAYING ) && ( mBase.GetPendingBufferCount() <= 2 ) )
     {
         SetEvent( mBufferEvent );
     }
@@ -163,7 +195,11 @@ void DynamicSoundEffectInstance::Impl::Resume()
     {
         mBase.Resume();
 
-        if ( ( mBase.state == PLAYING ) && ( mBase.GetPendingBufferCount() <= 2 ) )
+        if ( mBufferFill )
+        {
+            FillBuffers();
+        }
+        else if ( ( mBase.state == PLAYING ) && ( mBase.GetPendingBufferCount() <= 2 ) )
         {
             SetEvent( mBufferEvent );
         }
@@ -211,6 +247,120 @@ void DynamicSoundEffectInstance::Impl::SubmitBuffer( const uint8_t* pAudioData,
 }
 
 
+_Use_decl_annotations_
+void DynamicSoundEffectInstance::Impl::SetBufferFill( std::function<size_t(DynamicSoundEffectInstance*, uint8_t*, size_t)> fillBuffer, size_t bufferBytes )
+{
+    // Buffers still queued may point into the ring
+    if ( mBase.GetPendingBufferCount() > 0 )
+        throw std::exception( "SetBufferFill requires the instance to have no pending buffers" );
+
+    mBufferFill = fillBuffer;
+
+    if ( !mBufferFill )
+    {
+        mRing.reset();
+        mRingBufferBytes = mRingStride = 0;
+        mRingCount = mRingNext = 0;
+        return;
+    }
+
+    if ( !bufferBytes )
+    {
+        // Default to 10 ms of audio per buffer
+        bufferBytes = mWaveFormat.nAvgBytesPerSec / 100;
+    }
+
+    // Buffers must hold whole sample blocks
+    bufferBytes = ( ( bufferBytes + mWaveFormat.nBlockAlign - 1 ) / mWaveFormat.nBlockAlign ) * mWaveFormat.nBlockAlign;
+
+#ifdef _M_X64
+    if ( bufferBytes > 0xFFFFFFFF )
+        throw std::out_of_range( "SetBufferFill" );
+#endif
+
+    mRingBufferBytes = bufferBytes;
+
+    AllocateRing();
+}
+
+
+void DynamicSoundEffectInstance::Impl::SetTargetLatency( uint32_t latencyMS )
+{
+    if ( mBufferFill && mBase.GetPendingBufferCount() > 0 )
+        throw std::exception( "SetTargetLatency requires the instance to have no pending buffers" );
+
+    mTargetLatency = latencyMS;
+
+    if ( mBufferFill )
+    {
+        AllocateRing();
+    }
+}
+
+
+void DynamicSoundEffectInstance::Impl::AllocateRing()
+{
+    assert( mRingBufferBytes > 0 );
+
+    uint32_t count = DEFAULT_RING_BUFFERS;
+    if ( mTargetLatency > 0 )
+    {
+        // Enough buffers in flight to cover the requested latency
+        uint64_t bufferMS = ( uint64_t( mRingBufferBytes ) * 1000 ) / mWaveFormat.nAvgBytesPerSec;
+        if ( !bufferMS )
+            bufferMS = 1;
+
+        count = static_cast<uint32_t>( std::min<uint64_t>( ( mTargetLatency + bufferMS - 1 ) / bufferMS, XAUDIO2_MAX_QUEUED_BUFFERS ) );
+        if ( count < 2 )
+            count = 2;
+    }
+
+    // Each buffer starts on a 16-byte boundary so the callback can write with aligned SIMD stores
+    size_t stride = ( mRingBufferBytes + 15 ) & ~size_t( 15 );
+
+    if ( !mRing || ( stride * count ) > ( mRingStride * mRingCount ) )
+    {
+        mRing.reset( reinterpret_cast<uint8_t*>( _aligned_malloc( stride * count, 16 ) ) );
+        if ( !mRing )
+        {
+            mRingStride = 0;
+            mRingCount = 0;
+            throw std::bad_alloc();
+        }
+    }
+
+    mRingStride = stride;
+    mRingCount = count;
+    mRingNext = 0;
+}
+
+
+void DynamicSoundEffectInstance::Impl::FillBuffers()
+{
+    if ( !mBase.voice || ( mBase.state != PLAYING ) || !mRing )
+        return;
+
+    // Buffers complete in order, so while fewer than the ring size are queued the next slot is free to reuse
+    int pending = mBase.GetPendingBufferCount();
+    while ( pending < static_cast<int>( mRingCount ) && ( mBase.state == PLAYING ) )
+    {
+        uint8_t* slot = mRing.get() + mRingNext * mRingStride;
+
+        size_t bytes = mBufferFill( mObject, slot, mRingBufferBytes );
+        if ( !bytes )
+            break;
+
+        if ( bytes > mRingBufferBytes )
+            throw std::out_of_range( "Buffer fill callback wrote too many bytes" );
+
+        SubmitBuffer( slot, 0, bytes );
+
+        mRingNext = ( mRingNext + 1 ) % mRingCount;
+        ++pending;
+    }
+}
+
+
 void DynamicSoundEffectInstance::Impl::OnUpdate()
 {
     DWORD result = WaitForSingleObjectEx( mBufferEvent, 0, FALSE );
@@ -220,7 +370,12 @@ void DynamicSoundEffectInstance::Impl::OnUpdate()
         break;
 
     case WAIT_OBJECT_0:
-        if( mBufferNeeded )
+        if ( mBufferFill )
+        {
+            // Refills free slots of the ring in place
+            FillBuffers();
+        }
+        else if( mBufferNeeded )
         {
             // This callback happens on the same thread that called AudioEngine::Update()
             mBufferNeeded( mObject );
@@ -274,12 +429,16 @@ DynamicSoundEffectInstance::~DynamicSoundEffectInstance()
 // Public methods.
 void DynamicSoundEffectInstance::Play()
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->Play();
 }
 
 
 void DynamicSoundEffectInstance::Stop( bool immediate )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     bool looped = false;
     pImpl->mBase.Stop( immediate, looped );
 }
@@ -287,43 +446,65 @@ void DynamicSoundEffectInstance::Stop( bool immediate )
 
 void DynamicSoundEffectInstance::Pause()
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.Pause();
 }
 
 
 void DynamicSoundEffectInstance::Resume()
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->Resume();
 }
 
 
 void DynamicSoundEffectInstance::SetVolume( float volume )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.SetVolume( volume );
 }
 
 
 void DynamicSoundEffectInstance::SetPitch( float pitch )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.SetPitch( pitch );
 }
 
 
 void DynamicSoundEffectInstance::SetPan( float pan )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.SetPan( pan );
 }
 
 
 void DynamicSoundEffectInstance::Apply3D( const AudioListener& listener, const AudioEmitter& emitter )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.Apply3D( listener, emitter );
 }
 
 
+bool DynamicSoundEffectInstance::Apply3D( const AudioListener& listener, const AudioEmitter& emitter, uint32_t operationSet )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    return pImpl->mBase.Apply3D( listener, emitter, operationSet, true );
+}
+
+
 _Use_decl_annotations_
 void DynamicSoundEffectInstance::SubmitBuffer( const uint8_t* pAudioData, size_t audioBytes )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->SubmitBuffer( pAudioData, 0, audioBytes );
 }
 
@@ -331,13 +512,34 @@ void DynamicSoundEffectInstance::SubmitBuffer( const uint8_t* pAudioData, size_t
 _Use_decl_annotations_
 void DynamicSoundEffectInstance::SubmitBuffer( const uint8_t* pAudioData, uint32_t offset, size_t audioBytes )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->SubmitBuffer( pAudioData, offset, audioBytes );
 }
 
 
+_Use_decl_annotations_
+void DynamicSoundEffectInstance::SetBufferFill( std::function<size_t DIRECTX_STD_CALLCONV(DynamicSoundEffectInstance*, uint8_t*, size_t)> fillBuffer, size_t bufferBytes )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->SetBufferFill( fillBuffer, bufferBytes );
+}
+
+
+void DynamicSoundEffectInstance::SetTargetLatency( uint32_t latencyMS )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->SetTargetLatency( latencyMS );
+}
+
+
 // Public accessors.
 SoundState DynamicSoundEffectInstance::GetState()
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     return pImpl->mBase.GetState( false );
 }
 
@@ -375,6 +577,8 @@ size_t DynamicSoundEffectInstance::GetSampleSizeInBytes( uint64_t duration ) con
 
 int DynamicSoundEffectInstance::GetPendingBufferCount() const
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     return pImpl->mBase.GetPendingBufferCount();
 }
 
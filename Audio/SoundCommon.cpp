@@ -27,6 +27,113 @@ namespace
         while (x) {++bitCount; x &= (x-1);}
         return bitCount;
     }
+
+    // Polyphase resampling filter: a Blackman windowed-sinc with RESAMPLE_TAPS taps for each of RESAMPLE_PHASES + 1 fractional offsets
+    const int RESAMPLE_PHASES = 64;
+    const int RESAMPLE_TAPS = 16;
+
+    static_assert( ( RESAMPLE_TAPS % 4 ) == 0, "Resampling taps must be a multiple of the vector width" );
+
+    void BuildResampleFilter( _Out_writes_((RESAMPLE_PHASES + 1) * RESAMPLE_TAPS) float* filter, double cutoff )
+    {
+        static const double pi = 3.14159265358979323846;
+
+        for( int phase = 0; phase <= RESAMPLE_PHASES; ++phase )
+        {
+            double frac = double( phase ) / double( RESAMPLE_PHASES );
+
+            float* row = filter + phase * RESAMPLE_TAPS;
+            double sum = 0;
+            for( int tap = 0; tap < RESAMPLE_TAPS; ++tap )
+            {
+                // Distance from the output position to the input sample this tap reads
+                double x = double( tap - ( RESAMPLE_TAPS / 2 ) + 1 ) - frac;
+
+                double sinc = ( x == 0 ) ? 1.0 : sin( pi * x * cutoff ) / ( pi * x * cutoff );
+
+                double n = ( x + double( RESAMPLE_TAPS / 2 ) ) / double( RESAMPLE_TAPS );
+                double window = 0.42 - 0.5 * cos( 2.0 * pi * n ) + 0.08 * cos( 4.0 * pi * n );
+
+                double c = sinc * window;
+                row[ tap ] = static_cast<float>( c );
+                sum += c;
+            }
+
+            // Normalize for unity gain
+            for( int tap = 0; tap < RESAMPLE_TAPS; ++tap )
+            {
+                row[ tap ] = static_cast<float>( row[ tap ] / sum );
+            }
+        }
+    }
+
+    // Decodes integer or float PCM into interleaved float samples
+    void DecodePCM( _In_ const WAVEFORMATEX* wfx, _In_reads_bytes_(count * wfx->wBitsPerSample / 8) const uint8_t* src, _Out_writes_(count) float* dest, size_t count )
+    {
+        using namespace DirectX::PackedVector;
+
+        switch( GetFormatTag( wfx ) )
+        {
+        case WAVE_FORMAT_IEEE_FLOAT:
+            memcpy( dest, src, count * sizeof(float) );
+            break;
+
+        case WAVE_FORMAT_PCM:
+            switch( wfx->wBitsPerSample )
+            {
+            case 8:
+                {
+                    // 8-bit PCM is unsigned
+                    static const XMVECTORF32 s_scale = { 2.f, 2.f, 2.f, 2.f };
+                    size_t j = 0;
+                    for( ; j + 4 <= count; j += 4 )
+                    {
+                        XMVECTOR v = XMLoadUByteN4( reinterpret_cast<const XMUBYTEN4*>( src + j ) );
+                        v = XMVectorMultiplyAdd( v, s_scale, g_XMNegativeOne );
+                        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( dest + j ), v );
+                    }
+
+                    for( ; j < count; ++j )
+                    {
+                        dest[ j ] = ( float( src[ j ] ) / 127.5f ) - 1.f;
+                    }
+                }
+                break;
+
+            case 16:
+                ConvertInt16ToFloat( reinterpret_cast<const int16_t*>( src ), dest, count );
+                break;
+
+            case 24:
+                for( size_t j = 0; j < count; ++j, src += 3 )
+                {
+                    int32_t sample = int32_t( uint32_t( src[0] ) << 8 | uint32_t( src[1] ) << 16 | uint32_t( src[2] ) << 24 ) >> 8;
+                    dest[ j ] = float( sample ) / 8388608.f;
+                }
+                break;
+
+            case 32:
+                {
+                    static const XMVECTORF32 s_scale = { 1.f / 2147483648.f, 1.f / 2147483648.f, 1.f / 2147483648.f, 1.f / 2147483648.f };
+                    auto isrc = reinterpret_cast<const int32_t*>( src );
+                    size_t j = 0;
+                    for( ; j + 4 <= count; j += 4 )
+                    {
+                        XMVECTOR v = XMLoadInt4( reinterpret_cast<const uint32_t*>( isrc + j ) );
+                        v = XMVectorMultiply( XMConvertVectorIntToFloat( v, 0 ), s_scale );
+                        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( dest + j ), v );
+                    }
+
+                    for( ; j < count; ++j )
+                    {
+                        dest[ j ] = float( isrc[ j ] ) / 2147483648.f;
+                    }
+                }
+                break;
+            }
+            break;
+        }
+    }
 }
 
 
@@ -630,6 +737,226 @@ void DirectX::CreateXMA2( WAVEFORMATEX* wfx, size_t wfxSize, int sampleRate, int
 #endif // _XBOX_ONE && _TITLE
 
 
+//======================================================================================
+// PCM conversion utilities
+//======================================================================================
+
+_Use_decl_annotations_
+void DirectX::ConvertInt16ToFloat( const int16_t* src, float* dest, size_t count )
+{
+    using namespace DirectX::PackedVector;
+
+    size_t j = 0;
+    for( ; j + 4 <= count; j += 4 )
+    {
+        XMVECTOR v = XMLoadShortN4( reinterpret_cast<const XMSHORTN4*>( src + j ) );
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( dest + j ), v );
+    }
+
+    for( ; j < count; ++j )
+    {
+        dest[ j ] = std::max<float>( float( src[ j ] ) / 32767.f, -1.f );
+    }
+}
+
+
+_Use_decl_annotations_
+void DirectX::ConvertFloatToInt16( const float* src, int16_t* dest, size_t count )
+{
+    using namespace DirectX::PackedVector;
+
+    // XMStoreShortN4 saturates to -1..1 and rounds
+    size_t j = 0;
+    for( ; j + 4 <= count; j += 4 )
+    {
+        XMVECTOR v = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( src + j ) );
+        XMStoreShortN4( reinterpret_cast<XMSHORTN4*>( dest + j ), v );
+    }
+
+    for( ; j < count; ++j )
+    {
+        float sample = std::min<float>( std::max<float>( src[ j ], -1.f ), 1.f );
+        dest[ j ] = static_cast<int16_t>( sample * 32767.f + ( ( sample >= 0.f ) ? 0.5f : -0.5f ) );
+    }
+}
+
+
+_Use_decl_annotations_
+void DirectX::ConvertMonoToStereo( const float* src, float* dest, size_t frames )
+{
+    size_t j = 0;
+    for( ; j + 4 <= frames; j += 4 )
+    {
+        XMVECTOR v = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( src + j ) );
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( dest + j * 2 ), XMVectorMergeXY( v, v ) );
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( dest + j * 2 + 4 ), XMVectorMergeZW( v, v ) );
+    }
+
+    for( ; j < frames; ++j )
+    {
+        dest[ j * 2 ] = dest[ j * 2 + 1 ] = src[ j ];
+    }
+}
+
+
+_Use_decl_annotations_
+void DirectX::ConvertStereoToMono( const float* src, float* dest, size_t frames )
+{
+    size_t j = 0;
+    for( ; j + 4 <= frames; j += 4 )
+    {
+        XMVECTOR a = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( src + j * 2 ) );
+        XMVECTOR b = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( src + j * 2 + 4 ) );
+
+        XMVECTOR left = XMVectorPermute( a, b, XM_PERMUTE_0X, XM_PERMUTE_0Z, XM_PERMUTE_1X, XM_PERMUTE_1Z );
+        XMVECTOR right = XMVectorPermute( a, b, XM_PERMUTE_0Y, XM_PERMUTE_0W, XM_PERMUTE_1Y, XM_PERMUTE_1W );
+
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( dest + j ), XMVectorMultiply( XMVectorAdd( left, right ), g_XMOneHalf ) );
+    }
+
+    for( ; j < frames; ++j )
+    {
+        dest[ j ] = ( src[ j * 2 ] + src[ j * 2 + 1 ] ) * 0.5f;
+    }
+}
+
+
+size_t DirectX::GetResampledFrames( size_t frames, int srcRate, int destRate )
+{
+    if ( srcRate <= 0 || destRate <= 0 )
+        return 0;
+
+    return static_cast<size_t>( ( uint64_t( frames ) * uint64_t( destRate ) ) / uint64_t( srcRate ) );
+}
+
+
+_Use_decl_annotations_
+void DirectX::ResamplePCM( const float* src, size_t srcFrames, int channels, int srcRate, float* dest, size_t destFrames, int destRate )
+{
+    if ( !src || !dest || channels <= 0 || srcRate <= 0 || destRate <= 0 )
+        throw std::invalid_argument( "ResamplePCM" );
+
+    if ( !srcFrames || !destFrames )
+        return;
+
+    // Lower the cutoff when downsampling to avoid aliasing
+    float filter[ ( RESAMPLE_PHASES + 1 ) * RESAMPLE_TAPS ];
+    BuildResampleFilter( filter, ( destRate < srcRate ) ? ( double( destRate ) / double( srcRate ) ) : 1.0 );
+
+    // Input position in 32.32 fixed point
+    uint64_t step = ( uint64_t( srcRate ) << 32 ) / uint64_t( destRate );
+
+    // Each channel is de-interleaved with zero padding so every tap reads valid memory
+    std::vector<float> planar( srcFrames + RESAMPLE_TAPS * 2 );
+
+    for( int ch = 0; ch < channels; ++ch )
+    {
+        std::fill( planar.begin(), planar.end(), 0.f );
+        for( size_t j = 0; j < srcFrames; ++j )
+        {
+            planar[ RESAMPLE_TAPS + j ] = src[ j * channels + ch ];
+        }
+
+        const float* input = &planar[ RESAMPLE_TAPS - ( RESAMPLE_TAPS / 2 ) + 1 ];
+
+        uint64_t pos = 0;
+        for( size_t j = 0; j < destFrames; ++j, pos += step )
+        {
+            size_t index = static_cast<size_t>( pos >> 32 );
+            if ( index >= srcFrames )
+                index = srcFrames - 1;
+
+            int phase = static_cast<int>( ( ( pos & 0xFFFFFFFF ) * RESAMPLE_PHASES + 0x80000000 ) >> 32 );
+
+            const float* samples = input + index;
+            const float* coeffs = filter + phase * RESAMPLE_TAPS;
+
+            XMVECTOR acc = XMVectorZero();
+            for( int tap = 0; tap < RESAMPLE_TAPS; tap += 4 )
+            {
+                XMVECTOR s = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( samples + tap ) );
+                XMVECTOR c = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( coeffs + tap ) );
+                acc = XMVectorMultiplyAdd( s, c, acc );
+            }
+
+            dest[ j * channels + ch ] = XMVectorGetX( XMVector4Dot( acc, g_XMOne ) );
+        }
+    }
+}
+
+
+_Use_decl_annotations_
+HRESULT DirectX::NormalizePCM( const WAVEFORMATEX* wfx, const uint8_t* startAudio, size_t audioBytes, int sampleRate,
+                               std::unique_ptr<uint8_t[]>& result, const WAVEFORMATEX** resultWfx, const uint8_t** resultAudio, size_t& resultBytes )
+{
+    if ( !resultWfx || !resultAudio )
+        return E_INVALIDARG;
+
+    *resultWfx = nullptr;
+    *resultAudio = nullptr;
+    resultBytes = 0;
+
+    if ( !IsValid( wfx ) || !startAudio || !audioBytes )
+        return E_INVALIDARG;
+
+    uint32_t tag = GetFormatTag( wfx );
+    if ( tag != WAVE_FORMAT_PCM && tag != WAVE_FORMAT_IEEE_FLOAT )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    // A plain WAVEFORMATEX can't carry a non-default speaker layout
+    if ( wfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE
+         && reinterpret_cast<const WAVEFORMATEXTENSIBLE*>( wfx )->dwChannelMask != GetDefaultChannelMask( wfx->nChannels ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    int srcRate = static_cast<int>( wfx->nSamplesPerSec );
+    int destRate = ( sampleRate > 0 ) ? sampleRate : srcRate;
+
+    if ( tag == WAVE_FORMAT_PCM && wfx->wBitsPerSample == 16 && srcRate == destRate )
+    {
+        // Already in the normalized format
+        return S_FALSE;
+    }
+
+    int channels = wfx->nChannels;
+    size_t srcFrames = audioBytes / wfx->nBlockAlign;
+    size_t destFrames = ( srcRate == destRate ) ? srcFrames : GetResampledFrames( srcFrames, srcRate, destRate );
+    if ( !srcFrames || !destFrames )
+        return E_FAIL;
+
+    uint64_t bytes = uint64_t( destFrames ) * channels * sizeof(int16_t);
+    if ( bytes > 0xFFFFFFFF )
+        return HRESULT_FROM_WIN32( ERROR_ARITHMETIC_OVERFLOW );
+
+    std::vector<float> samples( srcFrames * channels );
+    DecodePCM( wfx, startAudio, &samples[0], samples.size() );
+
+    if ( srcRate != destRate )
+    {
+        std::vector<float> resampled( destFrames * channels );
+        ResamplePCM( &samples[0], srcFrames, channels, srcRate, &resampled[0], destFrames, destRate );
+        samples.swap( resampled );
+    }
+
+    // The audio data follows the format, starting on a 16-byte boundary
+    const size_t audioOffset = ( sizeof(WAVEFORMATEX) + 15 ) & ~size_t( 15 );
+
+    result.reset( new (std::nothrow) uint8_t[ audioOffset + static_cast<size_t>( bytes ) ] );
+    if ( !result )
+        return E_OUTOFMEMORY;
+
+    auto fmt = reinterpret_cast<WAVEFORMATEX*>( result.get() );
+    CreateIntegerPCM( fmt, destRate, channels, 16 );
+
+    ConvertFloatToInt16( &samples[0], reinterpret_cast<int16_t*>( result.get() + audioOffset ), samples.size() );
+
+    *resultWfx = fmt;
+    *resultAudio = result.get() + audioOffset;
+    resultBytes = static_cast<size_t>( bytes );
+
+    return S_OK;
+}
+
+
 _Use_decl_annotations_
 bool DirectX::ComputePan( float pan, int channels, float* matrix )
 {
@@ -702,10 +1029,46 @@ void SoundEffectInstanceBase::SetPan( float pan )
 }
 
 
-void SoundEffectInstanceBase::Apply3D( const AudioListener& listener, const AudioEmitter& emitter )
+bool SoundEffectInstanceBase::Has3DInputsChanged( const AudioListener& listener, const AudioEmitter& emitter )
 {
-    if ( !voice )
-        return;
+    // Everything X3DAudio uses except the emitter's curves and cone, which are assumed not to change
+    XMVECTOR inputs[6];
+    inputs[0] = XMVectorSubtract( XMLoadFloat3( reinterpret_cast<const XMFLOAT3*>( &emitter.Position ) ),
+                                  XMLoadFloat3( reinterpret_cast<const XMFLOAT3*>( &listener.Position ) ) );
+    inputs[1] = XMLoadFloat3( reinterpret_cast<const XMFLOAT3*>( &listener.OrientFront ) );
+    inputs[2] = XMLoadFloat3( reinterpret_cast<const XMFLOAT3*>( &listener.OrientTop ) );
+    inputs[3] = XMLoadFloat3( reinterpret_cast<const XMFLOAT3*>( &listener.Velocity ) );
+    inputs[4] = XMLoadFloat3( reinterpret_cast<const XMFLOAT3*>( &emitter.OrientFront ) );
+    inputs[5] = XMLoadFloat3( reinterpret_cast<const XMFLOAT3*>( &emitter.Velocity ) );
+
+    XMVECTOR scalars = XMVectorSet( emitter.InnerRadius, emitter.CurveDistanceScaler, emitter.DopplerScaler, emitter.ChannelRadius );
+
+    static const XMVECTORF32 s_epsilon = { 1e-3f, 1e-3f, 1e-3f, 1e-3f };
+
+    bool changed = !mDSPValid || !XMVector4NearEqual( scalars, XMLoadFloat4( &m3DScalars ), s_epsilon );
+    for( size_t j = 0; j < _countof(inputs) && !changed; ++j )
+    {
+        changed = !XMVector3NearEqual( inputs[ j ], XMLoadFloat3( &m3DInputs[ j ] ), s_epsilon );
+    }
+
+    if ( changed )
+    {
+        for( size_t j = 0; j < _countof(inputs); ++j )
+        {
+            XMStoreFloat3( &m3DInputs[ j ], inputs[ j ] );
+        }
+        XMStoreFloat4( &m3DScalars, scalars );
+    }
+
+    return changed;
+}
+
+
+bool SoundEffectInstanceBase::Apply3D( const AudioListener& listener, const AudioEmitter& emitter, UINT32 operationSet, bool skipUnchanged )
+{
+    // Virtual voices (PLAYING or PAUSED without a source voice) still track their 3D audibility
+    if ( !voice && state == STOPPED )
+        return false;
 
     if ( !( mFlags & SoundEffectInstance_Use3D ) )
     {
@@ -713,6 +1076,9 @@ void SoundEffectInstanceBase::Apply3D( const AudioListener& listener, const Audi
         throw std::exception( "Apply3D" );
     }
 
+    if ( skipUnchanged && !Has3DInputsChanged( listener, emitter ) )
+        return false;
+
     DWORD dwCalcFlags = X3DAUDIO_CALCULATE_MATRIX | X3DAUDIO_CALCULATE_DOPPLER | X3DAUDIO_CALCULATE_LPF_DIRECT;
 
     if ( mFlags & SoundEffectInstance_UseRedirectLFE )
@@ -721,8 +1087,7 @@ void SoundEffectInstanceBase::Apply3D( const AudioListener& listener, const Audi
         dwCalcFlags |= X3DAUDIO_CALCULATE_REDIRECT_TO_LFE;
     }
 
-    auto reverb = mReverbVoice;
-    if ( reverb )
+    if ( mReverbVoice )
     {
         dwCalcFlags |= X3DAUDIO_CALCULATE_LPF_REVERB | X3DAUDIO_CALCULATE_REVERB;
     }
@@ -732,35 +1097,106 @@ void SoundEffectInstanceBase::Apply3D( const AudioListener& listener, const Audi
     assert( mDSPSettings.DstChannelCount <= 8 );
     mDSPSettings.pMatrixCoefficients = matrix;
 
+    float prevReverb = mDSPSettings.ReverbLevel;
+    float prevLPFDirect = mDSPSettings.LPFDirectCoefficient;
+    float prevLPFReverb = mDSPSettings.LPFReverbCoefficient;
+
     assert( engine != 0 );
     X3DAudioCalculate( engine->Get3DHandle(), &listener, &emitter, dwCalcFlags, &mDSPSettings );
 
     mDSPSettings.pMatrixCoefficients = nullptr;
 
-    voice->SetFrequencyRatio( mFreqRatio * mDSPSettings.DopplerFactor );
+    // Skip the XAudio2 calls if the result has not meaningfully changed
+    const float EPSILON = 1e-4f;
+
+    bool changed = !mDSPValid
+                   || fabsf( mDSPSettings.DopplerFactor - mDopplerFactor ) > EPSILON
+                   || fabsf( mDSPSettings.ReverbLevel - prevReverb ) > EPSILON
+                   || fabsf( mDSPSettings.LPFDirectCoefficient - prevLPFDirect ) > EPSILON
+                   || fabsf( mDSPSettings.LPFReverbCoefficient - prevLPFReverb ) > EPSILON;
+
+    float peak = 0.f;
+    assert( mMatrix != 0 );
+    size_t count = mDSPSettings.SrcChannelCount * mDSPSettings.DstChannelCount;
+    for( size_t j = 0; j < count; ++j )
+    {
+        if ( fabsf( matrix[ j ] - mMatrix[ j ] ) > EPSILON )
+            changed = true;
+
+        mMatrix[ j ] = matrix[ j ];
+        peak = std::max( peak, fabsf( matrix[ j ] ) );
+    }
+
+    mDopplerFactor = mDSPSettings.DopplerFactor;
+    mAudibility = peak;
+    mDSPValid = true;
+
+    if ( !voice || ( skipUnchanged && !changed ) )
+        return false;
+
+    ApplyDSPSettings( operationSet );
+    return true;
+}
+
+
+void SoundEffectInstanceBase::ApplyDSPSettings( UINT32 operationSet )
+{
+    assert( voice != 0 && mDSPValid );
+
+    voice->SetFrequencyRatio( mFreqRatio * mDopplerFactor, operationSet );
 
     auto direct = mDirectVoice;
     assert( direct != 0 );
-    voice->SetOutputMatrix( direct, mDSPSettings.SrcChannelCount, mDSPSettings.DstChannelCount, matrix );
+    voice->SetOutputMatrix( direct, mDSPSettings.SrcChannelCount, mDSPSettings.DstChannelCount, mMatrix.get(), operationSet );
 
+    auto reverb = mReverbVoice;
     if ( reverb )
     {
-        voice->SetOutputMatrix( reverb, 1, 1, &mDSPSettings.ReverbLevel );
+        voice->SetOutputMatrix( reverb, 1, 1, &mDSPSettings.ReverbLevel, operationSet );
     }
 
     if ( mFlags & SoundEffectInstance_ReverbUseFilters )
     {
         XAUDIO2_FILTER_PARAMETERS filterDirect = { LowPassFilter, 2.0f * sinf(X3DAUDIO_PI/6.0f * mDSPSettings.LPFDirectCoefficient), 1.0f };
         // see XAudio2CutoffFrequencyToRadians() in XAudio2.h for more information on the formula used here
-        voice->SetOutputFilterParameters( direct, &filterDirect );
+        voice->SetOutputFilterParameters( direct, &filterDirect, operationSet );
 
         if ( reverb )
         {
             XAUDIO2_FILTER_PARAMETERS filterReverb = { LowPassFilter, 2.0f * sinf(X3DAUDIO_PI/6.0f * mDSPSettings.LPFReverbCoefficient), 1.0f };
             // see XAudio2CutoffFrequencyToRadians() in XAudio2.h for more information on the formula used here
-            voice->SetOutputFilterParameters( reverb, &filterReverb );
+            voice->SetOutputFilterParameters( reverb, &filterReverb, operationSet );
         }
     }
 }
 
 
+void SoundEffectInstanceBase::RestoreVoiceSettings()
+{
+    assert( voice != 0 );
+
+    if ( mVolume != 1.f )
+    {
+        HRESULT hr = voice->SetVolume( mVolume );
+        ThrowIfFailed( hr );
+    }
+
+    if ( mDSPValid )
+    {
+        ApplyDSPSettings();
+        return;
+    }
+
+    if ( mFreqRatio != 1.f )
+    {
+        HRESULT hr = voice->SetFrequencyRatio( mFreqRatio );
+        ThrowIfFailed( hr );
+    }
+
+    if ( mPan != 0.f )
+    {
+        SetPan( mPan );
+    }
+}
+
+
@@ -65,9 +65,51 @@ namespace DirectX
     void CreateXMA2( _Out_writes_bytes_(wfxSize) WAVEFORMATEX* wfx, size_t wfxSize, int sampleRate, int channels, int bytesPerBlock, int blockCount, int samplesEncoded );
 #endif
 
+    // Helpers for converting PCM sample data (vectorized with DirectXMath)
+    void ConvertInt16ToFloat( _In_reads_(count) const int16_t* src, _Out_writes_(count) float* dest, size_t count );
+    void ConvertFloatToInt16( _In_reads_(count) const float* src, _Out_writes_(count) int16_t* dest, size_t count );
+    void ConvertMonoToStereo( _In_reads_(frames) const float* src, _Out_writes_(frames * 2) float* dest, size_t frames );
+    void ConvertStereoToMono( _In_reads_(frames * 2) const float* src, _Out_writes_(frames) float* dest, size_t frames );
+
+    // Helpers for resampling interleaved float PCM with a polyphase windowed-sinc filter
+    size_t GetResampledFrames( size_t frames, int srcRate, int destRate );
+    void ResamplePCM( _In_reads_(srcFrames * channels) const float* src, size_t srcFrames, int channels, int srcRate,
+                      _Out_writes_(destFrames * channels) float* dest, size_t destFrames, int destRate );
+
+    // Helper for converting integer or float PCM to 16-bit integer PCM at the given sample rate (0 keeps the rate)
+    // Returns S_FALSE if the data is already in that format; the result holds the WAVEFORMATEX followed by the audio
+    HRESULT NormalizePCM( _In_ const WAVEFORMATEX* wfx, _In_reads_bytes_(audioBytes) const uint8_t* startAudio, size_t audioBytes, int sampleRate,
+                          _Inout_ std::unique_ptr<uint8_t[]>& result, _Outptr_ const WAVEFORMATEX** resultWfx, _Outptr_ const uint8_t** resultAudio,
+                          _Out_ size_t& resultBytes );
+
     // Helper for computing pan volume matrix
     bool ComputePan( float pan, int channels, _Out_writes_(16) float* matrix );
 
+    // Helper for holding the engine lock during an instance method, so it does not race the audio thread
+    class EngineLock
+    {
+    public:
+        explicit EngineLock( _In_opt_ AudioEngine* engine ) :
+            mEngine( engine )
+        {
+            if ( mEngine )
+                mEngine->Lock();
+        }
+
+        ~EngineLock()
+        {
+            if ( mEngine )
+                mEngine->Unlock();
+        }
+
+    private:
+        AudioEngine* mEngine;
+
+        EngineLock( EngineLock const& );
+        EngineLock& operator= ( EngineLock const& );
+    };
+
+
     // Helper class for implementing SoundEffectInstance
     class SoundEffectInstanceBase
     {
@@ -80,6 +122,9 @@ namespace DirectX
             mPitch( 0.f ),
             mFreqRatio( 1.f ),
             mPan( 0.f ),
+            mDopplerFactor( 1.f ),
+            mAudibility( 1.f ),
+            mDSPValid( false ),
             mFlags( SoundEffectInstance_Default ),
             mDirectVoice( nullptr ),
             mReverbVoice( nullptr )
@@ -107,6 +152,15 @@ namespace DirectX
             assert( wfx != 0 );
             mDSPSettings.SrcChannelCount = wfx->nChannels;
             mDSPSettings.DstChannelCount = eng->GetOutputChannels();
+
+            if ( flags & SoundEffectInstance_Use3D )
+            {
+                // The last 3D result is kept so it can be restored to a newly allocated voice
+                mMatrix.reset( new float[ wfx->nChannels * 8 ] );
+            }
+
+            memset( m3DInputs, 0, sizeof(m3DInputs) );
+            memset( &m3DScalars, 0, sizeof(m3DScalars) );
         }
 
         void AllocateVoice( _In_ const WAVEFORMATEX* wfx )
@@ -195,20 +249,25 @@ namespace DirectX
 
         void Pause()
         {
-            if ( voice && state == PLAYING )
+            // A virtual voice can be PLAYING without a source voice
+            if ( state == PLAYING )
             {
                 state = PAUSED;
 
-                voice->Stop( 0 );
+                if ( voice )
+                    voice->Stop( 0 );
             }
         }
 
         void Resume()
         {
-            if ( voice && state == PAUSED )
+            if ( state == PAUSED )
             {
-                HRESULT hr = voice->Start( 0 );
-                ThrowIfFailed( hr );
+                if ( voice )
+                {
+                    HRESULT hr = voice->Start( 0 );
+                    ThrowIfFailed( hr );
+                }
                 state = PLAYING;
             }
         }
@@ -237,11 +296,10 @@ namespace DirectX
             }
 
             mPitch = pitch;
+            mFreqRatio = XAudio2SemitonesToFrequencyRatio( mPitch * 12.f );
 
             if ( voice )
             {
-                mFreqRatio = XAudio2SemitonesToFrequencyRatio( mPitch * 12.f );
-
                 HRESULT hr = voice->SetFrequencyRatio( mFreqRatio );
                 ThrowIfFailed( hr );
             }
@@ -249,7 +307,27 @@ namespace DirectX
 
         void SetPan( float pan );
 
-        void Apply3D( const AudioListener& listener, const AudioEmitter& emitter );
+        void Apply3D( const AudioListener& listener, const AudioEmitter& emitter )
+        {
+            (void)Apply3D( listener, emitter, XAUDIO2_COMMIT_NOW, false );
+        }
+
+        bool Apply3D( const AudioListener& listener, const AudioEmitter& emitter, UINT32 operationSet, bool skipUnchanged );
+            // Returns true if any voice settings were changed, which with an operation set need to be committed
+
+        void RestoreVoiceSettings();
+            // Applies the current volume, pitch, pan, and 3D settings to a newly allocated voice
+
+        float GetFrequencyRatio() const
+        {
+            return ( mFlags & SoundEffectInstance_Use3D ) ? ( mFreqRatio * mDopplerFactor ) : mFreqRatio;
+        }
+
+        float GetAudibility() const
+        {
+            // Estimated output gain from the volume and (if 3D) the last computed attenuation
+            return fabsf( mVolume ) * ( ( mFlags & SoundEffectInstance_Use3D ) ? mAudibility : 1.f );
+        }
 
         SoundState GetState( bool autostop )
         {
@@ -361,9 +439,18 @@ namespace DirectX
         float                       mPitch;
         float                       mFreqRatio;
         float                       mPan;
+        float                       mDopplerFactor;
+        float                       mAudibility;
+        bool                        mDSPValid;
         SOUND_EFFECT_INSTANCE_FLAGS mFlags;
         IXAudio2Voice*              mDirectVoice;
         IXAudio2Voice*              mReverbVoice;
         X3DAUDIO_DSP_SETTINGS       mDSPSettings;
+        std::unique_ptr<float[]>    mMatrix;
+        XMFLOAT3                    m3DInputs[6];
+        XMFLOAT4                    m3DScalars;
+
+        bool Has3DInputsChanged( const AudioListener& listener, const AudioEmitter& emitter );
+        void ApplyDSPSettings( UINT32 operationSet = XAUDIO2_COMMIT_NOW );
    };
 }
\ No newline at end of file
@@ -132,7 +132,10 @@ public:
     virtual void __cdecl GatherStatistics( AudioStatistics& stats ) const override
     {
         stats.playingOneShots += mOneShots;
-        stats.audioBytes += mAudioBytes;
+
+        // Mapped wave data is paged in from the file rather than allocated
+        if ( !mMapping )
+            stats.audioBytes += mAudioBytes;
 
 #if defined(_XBOX_ONE) && defined(_TITLE)
         if ( mXMAMemory )
@@ -154,6 +157,9 @@ public:
     const uint32_t*                     mSeekTable;
 #endif
 
+    // Set when the wave data is used directly from a read-only view of the file
+    std::unique_ptr<WAVFileMapping>     mMapping;
+
 private:
     std::unique_ptr<uint8_t[]>          mWavData;
 
@@ -171,7 +177,7 @@ HRESULT SoundEffect::Impl::Initialize( AudioEngine* engine, std::unique_ptr<uint
 #endif
                                        uint32_t loopStart, uint32_t loopLength )
 {
-    if ( !engine || !IsValid( wfx ) || !startAudio || !audioBytes || !wavData )
+    if ( !engine || !IsValid( wfx ) || !startAudio || !audioBytes || ( !wavData && !mMapping ) )
         return E_INVALIDARG;
 
 #ifdef _M_X64
@@ -183,11 +189,45 @@ HRESULT SoundEffect::Impl::Initialize( AudioEngine* engine, std::unique_ptr<uint
     {
     case WAVE_FORMAT_PCM:
     case WAVE_FORMAT_IEEE_FLOAT:
+        if ( engine->GetFlags() & AudioEngine_NormalizePCM )
+        {
+            // Converting to 16-bit at the mastering rate lets one-shots share fewer pooled voice formats
+            int outputRate = static_cast<int>( engine->GetOutputFormat().Format.nSamplesPerSec );
+
+            std::unique_ptr<uint8_t[]> normalized;
+            const WAVEFORMATEX* normalizedWfx = nullptr;
+            const uint8_t* normalizedAudio = nullptr;
+            size_t normalizedBytes = 0;
+            HRESULT hr = NormalizePCM( wfx, startAudio, audioBytes, outputRate, normalized, &normalizedWfx, &normalizedAudio, normalizedBytes );
+            if ( hr == S_OK )
+            {
+                if ( normalizedWfx->nSamplesPerSec != wfx->nSamplesPerSec )
+                {
+                    loopStart = static_cast<uint32_t>( GetResampledFrames( loopStart, static_cast<int>( wfx->nSamplesPerSec ), static_cast<int>( normalizedWfx->nSamplesPerSec ) ) );
+                    loopLength = static_cast<uint32_t>( GetResampledFrames( loopLength, static_cast<int>( wfx->nSamplesPerSec ), static_cast<int>( normalizedWfx->nSamplesPerSec ) ) );
+                }
+
+                wavData.reset();
+                mWavData.reset( normalized.release() );
+                mMapping.reset();
+
+                mWaveFormat = normalizedWfx;
+                mStartAudio = normalizedAudio;
+                audioBytes = normalizedBytes;
+                break;
+            }
+            else if ( FAILED(hr) )
+            {
+                DebugTrace( "WARNING: SoundEffect failed (%08X) to normalize PCM data, using it as is\n", hr );
+            }
+        }
+        // fall-through
+
     case WAVE_FORMAT_ADPCM:
         // Take ownership of the buffer
         mWavData.reset( wavData.release() );
 
-        // WARNING: We assume the wfx and startAudio parameters are pointers into the wavData memory buffer
+        // WARNING: We assume the wfx and startAudio parameters are pointers into the wavData memory buffer (or the mapping)
         mWaveFormat = wfx;
         mStartAudio = startAudio;
         break;
@@ -210,7 +250,7 @@ HRESULT SoundEffect::Impl::Initialize( AudioEngine* engine, std::unique_ptr<uint
         // Take ownership of the buffer
         mWavData.reset( wavData.release() );
 
-        // WARNING: We assume the wfx, startAudio, and mSeekTable parameters are pointers into the wavData memory buffer
+        // WARNING: We assume the wfx, startAudio, and mSeekTable parameters are pointers into the wavData memory buffer (or the mapping)
         mWaveFormat = wfx;
         mStartAudio = startAudio;
         mSeekCount = static_cast<uint32_t>( seekCount );
@@ -263,7 +303,9 @@ HRESULT SoundEffect::Impl::Initialize( AudioEngine* engine, std::unique_ptr<uint
         mSeekCount = static_cast<uint32_t>( seekCount );
         mSeekTable = reinterpret_cast<const uint32_t*>( mWavData.get() + sizeof(XMA2WAVEFORMATEX) );
 
+        // Everything needed was copied
         wavData.reset();
+        mMapping.reset();
         break;
 
 #endif // _XBOX_ONE && _TITLE
@@ -365,16 +407,29 @@ void SoundEffect::Impl::Play( float volume, float pitch, float pan )
 
 // Public constructors.
 _Use_decl_annotations_
-SoundEffect::SoundEffect( AudioEngine* engine, const wchar_t* waveFileName )
+SoundEffect::SoundEffect( AudioEngine* engine, const wchar_t* waveFileName, bool memoryMapped )
   : pImpl(new Impl(engine) )
 {
     WAVData wavInfo;
     std::unique_ptr<uint8_t[]> wavData;
-    HRESULT hr = LoadWAVAudioFromFileEx( waveFileName, wavData, wavInfo );
+    HRESULT hr = E_FAIL;
+    if ( memoryMapped )
+    {
+        hr = LoadWAVAudioFromFileMapped( waveFileName, pImpl->mMapping, wavInfo );
+        if ( FAILED(hr) )
+        {
+            DebugTrace( "WARNING: SoundEffect failed (%08X) to memory-map .wav file \"%ls\"; reading into memory instead\n", hr, waveFileName );
+        }
+    }
+
     if ( FAILED(hr) )
     {
-        DebugTrace( "ERROR: SoundEffect failed (%08X) to load from .wav file \"%ls\"\n", hr, waveFileName );
-        throw std::exception( "SoundEffect" );
+        hr = LoadWAVAudioFromFileEx( waveFileName, wavData, wavInfo );
+        if ( FAILED(hr) )
+        {
+            DebugTrace( "ERROR: SoundEffect failed (%08X) to load from .wav file \"%ls\"\n", hr, waveFileName );
+            throw std::exception( "SoundEffect" );
+        }
     }
 
 #if defined(_XBOX_ONE) || (_WIN32_WINNT < _WIN32_WINNT_WIN8) || (_WIN32_WINNT >= _WIN32_WINNT_WIN10)
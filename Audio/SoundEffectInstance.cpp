@@ -17,12 +17,33 @@
 using namespace DirectX;
 
 
+namespace
+{
+    inline uint64_t GetTicksPerSecond()
+    {
+        static LARGE_INTEGER s_frequency = { 0 };
+        if ( !s_frequency.QuadPart )
+        {
+            QueryPerformanceFrequency( &s_frequency );
+        }
+        return static_cast<uint64_t>( s_frequency.QuadPart );
+    }
+
+    inline uint64_t GetTicks()
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter( &now );
+        return static_cast<uint64_t>( now.QuadPart );
+    }
+}
+
+
 //======================================================================================
 // SoundEffectInstance
 //======================================================================================
 
 // Internal object implementation class.
-class SoundEffectInstance::Impl : public IVoiceNotify
+class SoundEffectInstance::Impl : public IVoiceNotify, public IVirtualVoice
 {
 public:
     Impl( _In_ AudioEngine* engine, _In_ SoundEffect* effect, SOUND_EFFECT_INSTANCE_FLAGS flags ) :
@@ -30,13 +51,21 @@ public:
         mEffect( effect ),
         mWaveBank( nullptr ),
         mIndex( 0 ),
-        mLooped( false )
+        mLooped( false ),
+        mPriority( 0 ),
+        mVirtual( false ),
+        mPlayOffset( 0 ),
+        mVirtualPosition( 0 ),
+        mVirtualStamp( 0 )
     {
         assert( engine != 0 );
         engine->RegisterNotify( this, false );
+        engine->RegisterVirtualVoice( this );
 
         assert( mEffect != 0 );
-        mBase.Initialize( engine, effect->GetFormat(), flags );
+        auto wfx = effect->GetFormat();
+        mBase.Initialize( engine, wfx, flags );
+        InitializePosition( wfx, effect->GetSampleDuration() );
     }
 
     Impl( _In_ AudioEngine* engine, _In_ WaveBank* waveBank, uint32_t index, SOUND_EFFECT_INSTANCE_FLAGS flags ) :
@@ -44,15 +73,22 @@ public:
         mEffect( nullptr ),
         mWaveBank( waveBank ),
         mIndex( index ),
-        mLooped( false )
+        mLooped( false ),
+        mPriority( 0 ),
+        mVirtual( false ),
+        mPlayOffset( 0 ),
+        mVirtualPosition( 0 ),
+        mVirtualStamp( 0 )
     {
         assert( engine != 0 );
         engine->RegisterNotify( this, false );
+        engine->RegisterVirtualVoice( this );
 
         char buff[64];
         auto wfx = reinterpret_cast<WAVEFORMATEX*>( buff );
         assert( mWaveBank != 0 );
         mBase.Initialize( engine, mWaveBank->GetFormat( index, wfx, 64 ), flags );
+        InitializePosition( wfx, mWaveBank->GetSampleDuration( index ) );
     }
 
     virtual ~Impl()
@@ -61,12 +97,17 @@ public:
 
         if ( mBase.engine )
         {
+            mBase.engine->UnregisterVirtualVoice( this );
             mBase.engine->UnregisterNotify( this, false, false );
             mBase.engine = nullptr;
         }
     }
 
     void Play( bool loop );
+    void Stop( bool immediate );
+    void Pause();
+    void Resume();
+    SoundState GetState();
 
     // IVoiceNotify
     virtual void __cdecl OnBufferEnd() override
@@ -78,6 +119,7 @@ public:
     virtual void __cdecl OnCriticalError() override
     {
         mBase.OnCriticalError();
+        mVirtual = false;
     }
 
     virtual void __cdecl OnReset() override
@@ -94,6 +136,7 @@ public:
     virtual void __cdecl OnDestroyEngine() override
     {
         mBase.OnDestroy();
+        mVirtual = false;
     }
 
     virtual void __cdecl OnTrim() override
@@ -104,18 +147,247 @@ public:
     virtual void __cdecl GatherStatistics( AudioStatistics& stats ) const override
     {
         mBase.GatherStatistics(stats);
+
+        if ( mVirtual && mBase.state != STOPPED )
+            ++stats.virtualInstances;
+    }
+
+    // IVirtualVoice
+    virtual bool __cdecl GetAudibility( int& priority, float& audibility ) override
+    {
+        priority = mPriority;
+        audibility = 0.f;
+
+        if ( !mVirtual && !mBase.voice )
+            return false;
+
+        auto state = GetState();
+        if ( state == STOPPED )
+            return false;
+
+        // Paused instances are the first to give up their voice
+        if ( state == PLAYING )
+            audibility = mBase.GetAudibility();
+
+        return true;
+    }
+
+    virtual bool __cdecl IsVirtual() const override
+    {
+        return mVirtual;
     }
 
+    virtual void __cdecl SetVirtual( bool isvirtual ) override;
+
     SoundEffectInstanceBase         mBase;
     SoundEffect*                    mEffect;
     WaveBank*                       mWaveBank;
     uint32_t                        mIndex;
     bool                            mLooped;
+    int                             mPriority;
+    bool                            mVirtual;
+
+private:
+    void InitializePosition( _In_ const WAVEFORMATEX* wfx, size_t duration );
+    void UpdateVirtualPosition();
+    bool GetResumePosition( _Out_ uint32_t& playBegin ) const;
+    void SubmitBuffer( bool loop, uint32_t playBegin );
+
+    uint32_t                        mSampleRate;
+    uint32_t                        mDuration;
+    uint32_t                        mPositionAlign;
+    uint32_t                        mPlayOffset;
+    uint64_t                        mVirtualPosition;
+    uint64_t                        mVirtualStamp;
 };
 
 
+_Use_decl_annotations_
+void SoundEffectInstance::Impl::InitializePosition( const WAVEFORMATEX* wfx, size_t duration )
+{
+    assert( wfx != 0 );
+    mSampleRate = wfx->nSamplesPerSec;
+    mDuration = static_cast<uint32_t>( duration );
+
+    // Resume positions must land on a sample granularity the format supports for PlayBegin
+    switch( GetFormatTag( wfx ) )
+    {
+    case WAVE_FORMAT_ADPCM:
+        mPositionAlign = reinterpret_cast<const ADPCMWAVEFORMAT*>( wfx )->wSamplesPerBlock;
+        break;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    case WAVE_FORMAT_XMA2:
+        mPositionAlign = 128;
+        break;
+#endif
+
+    case WAVE_FORMAT_PCM:
+    case WAVE_FORMAT_IEEE_FLOAT:
+        mPositionAlign = 1;
+        break;
+
+    default:
+        // xWMA can only start from the beginning
+        mPositionAlign = 0;
+        break;
+    }
+}
+
+
+void SoundEffectInstance::Impl::UpdateVirtualPosition()
+{
+    uint64_t now = GetTicks();
+
+    if ( mBase.state == PLAYING )
+    {
+        double seconds = double( now - mVirtualStamp ) / double( GetTicksPerSecond() );
+        mVirtualPosition += static_cast<uint64_t>( seconds * double( mSampleRate ) * double( mBase.GetFrequencyRatio() ) );
+    }
+
+    mVirtualStamp = now;
+}
+
+
+_Use_decl_annotations_
+bool SoundEffectInstance::Impl::GetResumePosition( uint32_t& playBegin ) const
+{
+    playBegin = 0;
+
+    uint64_t position = mVirtualPosition;
+
+    if ( mDuration > 0 && position >= mDuration )
+    {
+        if ( !mLooped )
+            return false;
+
+        // Wrap within the loop region (or the whole wave) for looped playback
+        XAUDIO2_BUFFER buffer;
+#if defined(_XBOX_ONE) || (_WIN32_WINNT < _WIN32_WINNT_WIN8) || (_WIN32_WINNT >= _WIN32_WINNT_WIN10)
+        XAUDIO2_BUFFER_WMA wmaBuffer;
+        if ( mWaveBank )
+            (void)mWaveBank->FillSubmitBuffer( mIndex, buffer, wmaBuffer );
+        else
+            (void)mEffect->FillSubmitBuffer( buffer, wmaBuffer );
+#else
+        if ( mWaveBank )
+            mWaveBank->FillSubmitBuffer( mIndex, buffer );
+        else
+            mEffect->FillSubmitBuffer( buffer );
+#endif
+
+        uint64_t loopBegin = buffer.LoopBegin;
+        uint64_t loopLength = ( buffer.LoopLength > 0 ) ? buffer.LoopLength : ( mDuration - loopBegin );
+        if ( loopBegin >= mDuration || !loopLength )
+        {
+            loopBegin = 0;
+            loopLength = mDuration;
+        }
+
+        position = loopBegin + ( ( position - loopBegin ) % loopLength );
+    }
+
+    if ( !mPositionAlign )
+        return true;
+
+    playBegin = static_cast<uint32_t>( position - ( position % mPositionAlign ) );
+    return true;
+}
+
+
+void SoundEffectInstance::Impl::SetVirtual( bool isvirtual )
+{
+    if ( isvirtual == mVirtual )
+        return;
+
+    if ( isvirtual )
+    {
+        if ( !mBase.voice || mBase.state == STOPPED )
+            return;
+
+        XAUDIO2_VOICE_STATE xstate;
+        mBase.voice->GetState( &xstate );
+
+        mBase.voice->Stop( 0 );
+        mBase.voice->FlushSourceBuffers();
+        mBase.DestroyVoice();
+
+        mVirtual = true;
+        mVirtualPosition = uint64_t( mPlayOffset ) + xstate.SamplesPlayed;
+        mVirtualStamp = GetTicks();
+    }
+    else
+    {
+        if ( mBase.state == STOPPED )
+        {
+            mVirtual = false;
+            return;
+        }
+
+        UpdateVirtualPosition();
+
+        uint32_t playBegin;
+        if ( !GetResumePosition( playBegin ) )
+        {
+            // Finished while virtual
+            mVirtual = false;
+            mBase.state = STOPPED;
+            return;
+        }
+
+        if ( mWaveBank )
+        {
+            char buff[64];
+            auto wfx = reinterpret_cast<WAVEFORMATEX*>( buff );
+            mBase.AllocateVoice( mWaveBank->GetFormat( mIndex, wfx, 64) );
+        }
+        else
+        {
+            assert( mEffect != 0 );
+            mBase.AllocateVoice( mEffect->GetFormat() );
+        }
+
+        if ( !mBase.voice )
+            return;
+
+        mVirtual = false;
+
+        mBase.RestoreVoiceSettings();
+        SubmitBuffer( mLooped, playBegin );
+
+        if ( mBase.state == PLAYING )
+        {
+            HRESULT hr = mBase.voice->Start( 0 );
+            ThrowIfFailed( hr );
+        }
+    }
+}
+
+
 void SoundEffectInstance::Impl::Play( bool loop )
 {
+    if ( mVirtual )
+    {
+        Resume();
+        return;
+    }
+
+    if ( mBase.state == STOPPED )
+    {
+        assert( mBase.engine != 0 );
+        if ( !mBase.engine->ReserveAudibleVoice() )
+        {
+            // Over the audible instance limit, so start playing virtually
+            mBase.DestroyVoice();
+            mLooped = loop;
+            mVirtual = true;
+            mVirtualPosition = 0;
+            mVirtualStamp = GetTicks();
+            mBase.state = PLAYING;
+            return;
+        }
+    }
+
     if ( !mBase.voice )
     {
         if ( mWaveBank )
@@ -135,6 +407,12 @@ void SoundEffectInstance::Impl::Play( bool loop )
         return;
 
     // Submit audio data for STOPPED -> PLAYING state transition
+    SubmitBuffer( loop, 0 );
+}
+
+
+void SoundEffectInstance::Impl::SubmitBuffer( bool loop, uint32_t playBegin )
+{
     XAUDIO2_BUFFER buffer;
 
 #if defined(_XBOX_ONE) || (_WIN32_WINNT < _WIN32_WINNT_WIN8) || (_WIN32_WINNT >= _WIN32_WINNT_WIN10)
@@ -178,6 +456,10 @@ void SoundEffectInstance::Impl::Play( bool loop )
     }
     buffer.pContext = nullptr;
 
+    // Resuming a virtual voice starts part way through the wave
+    buffer.PlayBegin = playBegin;
+    mPlayOffset = playBegin;
+
     HRESULT hr;
 #if defined(_XBOX_ONE) || (_WIN32_WINNT < _WIN32_WINNT_WIN8) || (_WIN32_WINNT >= _WIN32_WINNT_WIN10)
     if ( iswma )
@@ -210,6 +492,61 @@ void SoundEffectInstance::Impl::Play( bool loop )
 }
 
 
+void SoundEffectInstance::Impl::Stop( bool immediate )
+{
+    if ( mVirtual )
+    {
+        // Tails and loop exits aren't simulated, so a virtual voice just stops
+        mVirtual = false;
+        mBase.state = STOPPED;
+        return;
+    }
+
+    mBase.Stop( immediate, mLooped );
+}
+
+
+void SoundEffectInstance::Impl::Pause()
+{
+    if ( mVirtual )
+        UpdateVirtualPosition();
+
+    mBase.Pause();
+}
+
+
+void SoundEffectInstance::Impl::Resume()
+{
+    if ( mVirtual )
+        UpdateVirtualPosition();
+
+    mBase.Resume();
+}
+
+
+SoundState SoundEffectInstance::Impl::GetState()
+{
+    if ( mVirtual )
+    {
+        if ( mBase.state == PLAYING && !mLooped )
+        {
+            // Automatic stop once the virtual play position reaches the end
+            UpdateVirtualPosition();
+
+            if ( mVirtualPosition >= mDuration )
+            {
+                mVirtual = false;
+                mBase.state = STOPPED;
+            }
+        }
+
+        return mBase.state;
+    }
+
+    return mBase.GetState( true );
+}
+
+
 //--------------------------------------------------------------------------------------
 // SoundEffectInstance
 //--------------------------------------------------------------------------------------
@@ -266,69 +603,122 @@ SoundEffectInstance::~SoundEffectInstance()
 // Public methods.
 void SoundEffectInstance::Play( bool loop )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->Play( loop );
 }
 
 
 void SoundEffectInstance::Stop( bool immediate )
 {
-    pImpl->mBase.Stop( immediate, pImpl->mLooped );
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->Stop( immediate );
 }
 
 
 void SoundEffectInstance::Pause()
 {
-    pImpl->mBase.Pause();
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->Pause();
 }
 
 
 void SoundEffectInstance::Resume()
 {
-    pImpl->mBase.Resume();
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->Resume();
 }
 
 
 void SoundEffectInstance::SetVolume( float volume )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.SetVolume( volume );
 }
 
 
 void SoundEffectInstance::SetPitch( float pitch )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.SetPitch( pitch );
 }
 
 
 void SoundEffectInstance::SetPan( float pan )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.SetPan( pan );
 }
 
 
 void SoundEffectInstance::Apply3D( const AudioListener& listener, const AudioEmitter& emitter )
 {
+    EngineLock lock( pImpl->mBase.engine );
+
     pImpl->mBase.Apply3D( listener, emitter );
 }
 
 
+bool SoundEffectInstance::Apply3D( const AudioListener& listener, const AudioEmitter& emitter, uint32_t operationSet )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    return pImpl->mBase.Apply3D( listener, emitter, operationSet, true );
+}
+
+
+void SoundEffectInstance::SetPriority( int priority )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->mPriority = priority;
+}
+
+
 // Public accessors.
+int SoundEffectInstance::GetPriority() const
+{
+    return pImpl->mPriority;
+}
+
+
 bool SoundEffectInstance::IsLooped() const
 {
     return pImpl->mLooped;
 }
 
 
+bool SoundEffectInstance::IsVirtual() const
+{
+    return pImpl->mVirtual;
+}
+
+
 SoundState SoundEffectInstance::GetState()
 {
-    return pImpl->mBase.GetState( true );
+    EngineLock lock( pImpl->mBase.engine );
+
+    return pImpl->GetState();
 }
 
 
 // Notifications.
 void SoundEffectInstance::OnDestroyParent()
 {
+    if ( pImpl->mBase.engine )
+    {
+        // The engine polls virtual voices every update, so it must not keep this one
+        pImpl->mBase.engine->UnregisterVirtualVoice( pImpl.get() );
+    }
+
     pImpl->mBase.OnDestroy();
+    pImpl->mVirtual = false;
     pImpl->mWaveBank = nullptr;
     pImpl->mEffect = nullptr;
 }
\ No newline at end of file
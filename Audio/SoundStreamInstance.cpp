@@ -0,0 +1,860 @@
+//--------------------------------------------------------------------------------------
+// File: SoundStreamInstance.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "SoundCommon.h"
+#include "WaveBankReader.h"
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+#include <apu.h>
+#endif
+
+using namespace DirectX;
+
+
+namespace
+{
+    // Streaming wave banks are opened with FILE_FLAG_NO_BUFFERING, so every read must start on a sector boundary,
+    // cover whole sectors, and land in sector-aligned memory. 4096 covers both 512e and 4K native drives.
+    const uint32_t SECTOR_SIZE = 4096;
+
+    // XMA2 data is read in whole 2K packets.
+    const uint32_t XMA_PACKET_SIZE = 2048;
+
+    inline uint64_t AlignDown( uint64_t value, uint32_t alignment )
+    {
+        return value - ( value % alignment );
+    }
+
+    inline uint32_t AlignUp( uint32_t value, uint32_t alignment )
+    {
+        return ( ( value + alignment - 1 ) / alignment ) * alignment;
+    }
+
+    struct aligned_deleter { void operator()( void* p ) { _aligned_free( p ); } };
+}
+
+
+//======================================================================================
+// SoundStreamInstance
+//======================================================================================
+
+// Internal object implementation class.
+class SoundStreamInstance::Impl : public IVoiceNotify
+{
+public:
+    Impl( _In_ AudioEngine* engine, _In_ WaveBank* waveBank, const WaveBankReader& reader, uint32_t index, SOUND_EFFECT_INSTANCE_FLAGS flags );
+
+    virtual ~Impl()
+    {
+        CancelReads();
+
+        mBase.DestroyVoice();
+
+        if ( mBase.engine )
+        {
+            mBase.engine->UnregisterNotify( this, false, true );
+            mBase.engine = nullptr;
+        }
+
+        for( size_t j = 0; j < BufferCount; ++j )
+        {
+            if ( mBuffers[ j ].request.hEvent )
+                CloseHandle( mBuffers[ j ].request.hEvent );
+        }
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+        if ( mXMAMemory )
+        {
+            ApuFree( mXMAMemory );
+            mXMAMemory = nullptr;
+        }
+#endif
+    }
+
+    void Play( bool loop );
+
+    void Stop( bool immediate );
+
+    const WAVEFORMATEX* GetFormat() const { return reinterpret_cast<const WAVEFORMATEX*>( mWaveFormat ); }
+
+    // IVoiceNotify
+    virtual void __cdecl OnBufferEnd() override
+    {
+        // We don't register for this notification for SoundStreamInstances, so this should not be invoked
+        assert( false );
+    }
+
+    virtual void __cdecl OnCriticalError() override
+    {
+        CancelReads();
+        mBase.OnCriticalError();
+        ReleaseBuffers();
+    }
+
+    virtual void __cdecl OnReset() override
+    {
+        mBase.OnReset();
+    }
+
+    virtual void __cdecl OnUpdate() override;
+
+    virtual void __cdecl OnDestroyEngine() override
+    {
+        CancelReads();
+        mBase.OnDestroy();
+        ReleaseBuffers();
+    }
+
+    virtual void __cdecl OnTrim() override
+    {
+        mBase.OnTrim();
+
+        if ( !mBase.voice )
+            ReleaseBuffers();
+    }
+
+    virtual void __cdecl GatherStatistics( AudioStatistics& stats ) const override
+    {
+        mBase.GatherStatistics( stats );
+
+        stats.streamingBytes += mBufferBytes * BufferCount;
+    }
+
+    void OnDestroyParent()
+    {
+        CancelReads();
+
+        // The stream is registered for updates, so it must not stay on the engine's list once orphaned
+        if ( mBase.engine )
+        {
+            mBase.engine->UnregisterNotify( this, false, true );
+        }
+
+        mBase.OnDestroy();
+        ReleaseBuffers();
+
+        mWaveBank = nullptr;
+        mAsync = INVALID_HANDLE_VALUE;
+    }
+
+    SoundEffectInstanceBase         mBase;
+    WaveBank*                       mWaveBank;
+    bool                            mLooped;
+
+private:
+    enum BufferState
+    {
+        BUFFER_FREE = 0,
+        BUFFER_READING,     // Overlapped read in flight
+        BUFFER_READY,       // Read complete, waiting to be submitted
+        BUFFER_SUBMITTED,   // Queued on the source voice
+    };
+
+    struct StreamBuffer
+    {
+        BufferState             state;
+        OVERLAPPED              request;
+        uint8_t*                data;
+        uint32_t                skipBytes;      // Bytes before the wanted data, from rounding the read down to a sector
+        uint32_t                audioBytes;
+        uint32_t                playBegin;      // In samples, from the start of this buffer
+        uint32_t                playLength;     // In samples, or 0 for the whole buffer
+        uint32_t                firstPacket;    // xWMA seek table range
+        uint32_t                packetCount;
+        bool                    endOfStream;
+        std::vector<uint32_t>   seekTable;      // xWMA decoded byte counts, relative to this buffer
+    };
+
+    void IssueReads();
+    bool CompleteRead( StreamBuffer& buffer );
+    void SubmitBuffer( StreamBuffer& buffer );
+    void CancelReads();
+    void ReleaseBuffers();
+
+    char                            mWaveFormat[64];
+    uint32_t                        mTag;
+    HANDLE                          mAsync;
+    uint32_t                        mStartOffset;   // File offset of the wave data
+    uint32_t                        mLengthBytes;
+
+    uint32_t                        mPacketBytes;   // Unit every buffer holds a whole number of (block or packet)
+    uint32_t                        mSamplesPerPacket;
+    uint32_t                        mChunkBytes;    // Wave bytes per buffer
+    uint32_t                        mBufferBytes;   // Allocated bytes per buffer
+
+    uint32_t                        mLoopStartBytes;
+    uint32_t                        mLoopEndBytes;
+    uint32_t                        mLoopStartSkip; // Samples to skip in the first packet of the loop
+    uint32_t                        mLoopEndSample; // Last sample to play, or 0 for the end of the loop data
+
+    const uint32_t*                 mSeekTable;
+    uint32_t                        mSeekCount;
+
+    uint32_t                        mCursor;        // Next byte to read, relative to the start of the wave
+    uint32_t                        mPendingPlayBegin;
+    bool                            mReadsDone;
+    bool                            mEndSubmitted;
+
+    size_t                          mNextRead;
+    size_t                          mNextSubmit;
+    size_t                          mNextRelease;
+    size_t                          mSubmittedCount;
+
+    StreamBuffer                    mBuffers[ BufferCount ];
+    std::unique_ptr<uint8_t, aligned_deleter> mMemory;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    void*                           mXMAMemory;
+#endif
+};
+
+
+_Use_decl_annotations_
+SoundStreamInstance::Impl::Impl( AudioEngine* engine, WaveBank* waveBank, const WaveBankReader& reader, uint32_t index, SOUND_EFFECT_INSTANCE_FLAGS flags ) :
+    mBase(),
+    mWaveBank( waveBank ),
+    mLooped( false ),
+    mTag( 0 ),
+    mAsync( INVALID_HANDLE_VALUE ),
+    mStartOffset( 0 ),
+    mLengthBytes( 0 ),
+    mPacketBytes( 0 ),
+    mSamplesPerPacket( 0 ),
+    mChunkBytes( 0 ),
+    mBufferBytes( 0 ),
+    mLoopStartBytes( 0 ),
+    mLoopEndBytes( 0 ),
+    mLoopStartSkip( 0 ),
+    mLoopEndSample( 0 ),
+    mSeekTable( nullptr ),
+    mSeekCount( 0 ),
+    mCursor( 0 ),
+    mPendingPlayBegin( 0 ),
+    mReadsDone( false ),
+    mEndSubmitted( false ),
+    mNextRead( 0 ),
+    mNextSubmit( 0 ),
+    mNextRelease( 0 ),
+    mSubmittedCount( 0 )
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    , mXMAMemory( nullptr )
+#endif
+{
+    auto wfx = reinterpret_cast<WAVEFORMATEX*>( mWaveFormat );
+    HRESULT hr = reader.GetFormat( index, wfx, sizeof(mWaveFormat) );
+    ThrowIfFailed( hr );
+
+    WaveBankReader::StreamingParameters params;
+    hr = reader.GetStreamingParameters( index, params );
+    ThrowIfFailed( hr );
+
+    WaveBankReader::Metadata metadata;
+    hr = reader.GetMetadata( index, metadata );
+    ThrowIfFailed( hr );
+
+    if ( !params.lengthBytes )
+        throw std::exception( "SoundStreamInstance" );
+
+    mAsync = params.async;
+    mStartOffset = params.offsetBytes;
+    mLengthBytes = params.lengthBytes;
+
+    mTag = GetFormatTag( wfx );
+
+    // Every buffer must hold whole blocks (ADPCM) or packets (xWMA, XMA2), so the chunk size is rounded to that unit.
+    // Only PCM and ADPCM honor the loop region; XAudio2 loops xWMA and XMA2 over the whole wave.
+    bool useLoopRegion = false;
+    switch( mTag )
+    {
+    case WAVE_FORMAT_PCM:
+        mPacketBytes = wfx->nBlockAlign;
+        mSamplesPerPacket = 1;
+        useLoopRegion = true;
+        break;
+
+    case WAVE_FORMAT_ADPCM:
+        mPacketBytes = wfx->nBlockAlign;
+        mSamplesPerPacket = reinterpret_cast<const ADPCMWAVEFORMAT*>( wfx )->wSamplesPerBlock;
+        useLoopRegion = true;
+        break;
+
+#if defined(_XBOX_ONE) || (_WIN32_WINNT < _WIN32_WINNT_WIN8) || (_WIN32_WINNT >= _WIN32_WINNT_WIN10)
+    case WAVE_FORMAT_WMAUDIO2:
+    case WAVE_FORMAT_WMAUDIO3:
+        {
+            mPacketBytes = wfx->nBlockAlign;
+
+            uint32_t tag;
+            hr = reader.GetSeekTable( index, &mSeekTable, mSeekCount, tag );
+            ThrowIfFailed( hr );
+
+            if ( !mSeekTable || !mSeekCount )
+            {
+                DebugTrace( "ERROR: SoundStreamInstance xWMA wave %u has no seek table\n", index );
+                throw std::exception( "SoundStreamInstance" );
+            }
+        }
+        break;
+#endif
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    case WAVE_FORMAT_XMA2:
+        mPacketBytes = XMA_PACKET_SIZE;
+        break;
+#endif
+
+    default:
+        DebugTrace( "ERROR: SoundStreamInstance does not support format tag %u\n", mTag );
+        throw std::exception( "SoundStreamInstance" );
+    }
+
+    if ( !mPacketBytes || ( mTag == WAVE_FORMAT_ADPCM && !mSamplesPerPacket ) )
+        throw std::exception( "SoundStreamInstance" );
+
+    mChunkBytes = std::max<uint32_t>( 1, static_cast<uint32_t>( SoundStreamInstance::BufferSize / mPacketBytes ) ) * mPacketBytes;
+    mChunkBytes = std::min( mChunkBytes, AlignUp( mLengthBytes, mPacketBytes ) );
+
+    // One extra sector covers the data lost to rounding the read offset down.
+    mBufferBytes = AlignUp( mChunkBytes, SECTOR_SIZE ) + SECTOR_SIZE;
+
+    mLoopEndBytes = mLengthBytes;
+
+    if ( useLoopRegion && metadata.loopLength > 0 )
+    {
+        uint32_t loopEnd = metadata.loopStart + metadata.loopLength;
+
+        uint64_t startBytes = uint64_t( metadata.loopStart / mSamplesPerPacket ) * mPacketBytes;
+        uint64_t endBytes = uint64_t( ( loopEnd + mSamplesPerPacket - 1 ) / mSamplesPerPacket ) * mPacketBytes;
+
+        if ( startBytes < endBytes && endBytes <= mLengthBytes )
+        {
+            mLoopStartBytes = static_cast<uint32_t>( startBytes );
+            mLoopEndBytes = static_cast<uint32_t>( endBytes );
+            mLoopStartSkip = metadata.loopStart % mSamplesPerPacket;
+            mLoopEndSample = loopEnd;
+        }
+        else
+        {
+            DebugTrace( "WARNING: SoundStreamInstance ignoring invalid loop region for wave %u\n", index );
+        }
+    }
+
+    // Allocate the ring of read buffers
+    size_t totalBytes = size_t( mBufferBytes ) * BufferCount;
+    uint8_t* memory = nullptr;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    if ( mTag == WAVE_FORMAT_XMA2 )
+    {
+        hr = ApuAlloc( &mXMAMemory, nullptr, static_cast<UINT32>( totalBytes ), SECTOR_SIZE /* multiple of SHAPE_XMA_INPUT_BUFFER_ALIGNMENT */ );
+        if ( FAILED(hr) )
+        {
+            DebugTrace( "ERROR: ApuAlloc failed. Did you allocate a large enough heap with ApuCreateHeap for all your XMA wave data?\n" );
+            throw std::exception( "ApuAlloc" );
+        }
+
+        memory = reinterpret_cast<uint8_t*>( mXMAMemory );
+    }
+    else
+#endif
+    {
+        mMemory.reset( reinterpret_cast<uint8_t*>( _aligned_malloc( totalBytes, SECTOR_SIZE ) ) );
+        if ( !mMemory )
+            throw std::bad_alloc();
+
+        memory = mMemory.get();
+    }
+
+    for( size_t j = 0; j < BufferCount; ++j )
+    {
+        auto& buffer = mBuffers[ j ];
+
+        buffer.state = BUFFER_FREE;
+        memset( &buffer.request, 0, sizeof(OVERLAPPED) );
+        buffer.data = memory + j * mBufferBytes;
+        buffer.skipBytes = buffer.audioBytes = buffer.playBegin = buffer.playLength = 0;
+        buffer.firstPacket = buffer.packetCount = 0;
+        buffer.endOfStream = false;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+        buffer.request.hEvent = CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE );
+#else
+        buffer.request.hEvent = CreateEvent( nullptr, TRUE, FALSE, nullptr );
+#endif
+        if ( !buffer.request.hEvent )
+        {
+            throw std::exception( "CreateEvent" );
+        }
+
+        if ( mSeekTable )
+            buffer.seekTable.reserve( mChunkBytes / mPacketBytes );
+    }
+
+    assert( engine != 0 );
+    engine->RegisterNotify( this, true );
+
+    mBase.Initialize( engine, wfx, flags );
+}
+
+
+void SoundStreamInstance::Impl::Play( bool loop )
+{
+    if ( !mBase.voice )
+    {
+        mBase.AllocateVoice( GetFormat() );
+    }
+
+    if ( !mBase.Play() )
+        return;
+
+    // STOPPED -> PLAYING, so start over from the top of the wave
+    mLooped = loop;
+    mCursor = 0;
+    mPendingPlayBegin = 0;
+    mReadsDone = false;
+    mEndSubmitted = false;
+
+    IssueReads();
+}
+
+
+void SoundStreamInstance::Impl::Stop( bool immediate )
+{
+    bool looped = mLooped;
+
+    mBase.Stop( immediate, mLooped );
+
+    if ( !immediate && looped )
+    {
+        // Reads continue through to the end of the wave, then the stream ends
+        return;
+    }
+
+    if ( mBase.voice )
+    {
+        mBase.voice->FlushSourceBuffers();
+    }
+
+    mBase.state = STOPPED;
+
+    CancelReads();
+}
+
+
+void SoundStreamInstance::Impl::OnUpdate()
+{
+    if ( !mBase.voice )
+        return;
+
+    // Buffers complete in the order they were queued, so the voice's queue depth tells us how many are done
+    if ( mSubmittedCount > 0 )
+    {
+        XAUDIO2_VOICE_STATE xstate;
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+        mBase.voice->GetState( &xstate, XAUDIO2_VOICE_NOSAMPLESPLAYED );
+#else
+        mBase.voice->GetState( &xstate );
+#endif
+
+        while ( mSubmittedCount > xstate.BuffersQueued )
+        {
+            assert( mBuffers[ mNextRelease ].state == BUFFER_SUBMITTED );
+            mBuffers[ mNextRelease ].state = BUFFER_FREE;
+            mNextRelease = ( mNextRelease + 1 ) % BufferCount;
+            --mSubmittedCount;
+        }
+    }
+
+    if ( mBase.state == STOPPED )
+        return;
+
+    // Submit completed reads in order
+    while ( mBuffers[ mNextSubmit ].state == BUFFER_READING )
+    {
+        auto& buffer = mBuffers[ mNextSubmit ];
+
+        if ( !CompleteRead( buffer ) )
+            break;
+
+        buffer.state = BUFFER_READY;
+
+        SubmitBuffer( buffer );
+    }
+
+    IssueReads();
+
+    if ( mEndSubmitted && !mSubmittedCount )
+    {
+        // Automatic stop once the final buffer has finished playing
+        mBase.voice->Stop( 0 );
+        mBase.state = STOPPED;
+    }
+}
+
+
+void SoundStreamInstance::Impl::IssueReads()
+{
+    if ( mAsync == INVALID_HANDLE_VALUE )
+        return;
+
+    while ( !mReadsDone && mBuffers[ mNextRead ].state == BUFFER_FREE )
+    {
+        auto& buffer = mBuffers[ mNextRead ];
+
+        uint32_t endBytes = ( mLooped ) ? mLoopEndBytes : mLengthBytes;
+        if ( mCursor >= endBytes )
+        {
+            // Stop( false ) on a looping stream that had already wrapped
+            mReadsDone = true;
+            break;
+        }
+
+        uint32_t bytes = std::min( mChunkBytes, endBytes - mCursor );
+
+        buffer.audioBytes = bytes;
+        buffer.playBegin = mPendingPlayBegin;
+        buffer.playLength = 0;
+        buffer.firstPacket = mCursor / mPacketBytes;
+        buffer.packetCount = ( bytes + mPacketBytes - 1 ) / mPacketBytes;
+        buffer.endOfStream = false;
+
+        mPendingPlayBegin = 0;
+
+        bool atEnd = ( mCursor + bytes >= endBytes );
+
+        if ( atEnd && mLooped && mLoopEndSample > 0 )
+        {
+            // Trim the last block of the loop to the loop end sample
+            uint32_t bufferStartSample = buffer.firstPacket * mSamplesPerPacket;
+            if ( mLoopEndSample > bufferStartSample + buffer.playBegin )
+            {
+                buffer.playLength = mLoopEndSample - bufferStartSample - buffer.playBegin;
+            }
+        }
+
+        uint64_t fileOffset = uint64_t( mStartOffset ) + mCursor;
+        uint64_t readOffset = AlignDown( fileOffset, SECTOR_SIZE );
+
+        buffer.skipBytes = static_cast<uint32_t>( fileOffset - readOffset );
+
+        uint32_t readBytes = AlignUp( buffer.skipBytes + bytes, SECTOR_SIZE );
+        assert( readBytes <= mBufferBytes );
+
+        HANDLE hEvent = buffer.request.hEvent;
+        memset( &buffer.request, 0, sizeof(OVERLAPPED) );
+        buffer.request.Offset = static_cast<DWORD>( readOffset );
+        buffer.request.OffsetHigh = static_cast<DWORD>( readOffset >> 32 );
+        buffer.request.hEvent = hEvent;
+
+        if ( !ReadFile( mAsync, buffer.data, readBytes, nullptr, &buffer.request ) )
+        {
+            DWORD error = GetLastError();
+            if ( error != ERROR_IO_PENDING )
+            {
+                DebugTrace( "ERROR: SoundStreamInstance failed (%08X) reading wave data\n", HRESULT_FROM_WIN32( error ) );
+                throw std::exception( "ReadFile" );
+            }
+        }
+
+        buffer.state = BUFFER_READING;
+        mNextRead = ( mNextRead + 1 ) % BufferCount;
+
+        mCursor += bytes;
+
+        if ( atEnd )
+        {
+            if ( mLooped )
+            {
+                mCursor = mLoopStartBytes;
+                mPendingPlayBegin = mLoopStartSkip;
+            }
+            else
+            {
+                buffer.endOfStream = true;
+                mReadsDone = true;
+            }
+        }
+    }
+}
+
+
+bool SoundStreamInstance::Impl::CompleteRead( StreamBuffer& buffer )
+{
+    DWORD bytes = 0;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    BOOL result = GetOverlappedResultEx( mAsync, &buffer.request, &bytes, 0, FALSE );
+#else
+    if ( !HasOverlappedIoCompleted( &buffer.request ) )
+        return false;
+
+    BOOL result = GetOverlappedResult( mAsync, &buffer.request, &bytes, FALSE );
+#endif
+
+    if ( !result )
+    {
+        DWORD error = GetLastError();
+        if ( error == ERROR_IO_INCOMPLETE || error == WAIT_TIMEOUT )
+            return false;
+
+        DebugTrace( "ERROR: SoundStreamInstance failed (%08X) reading wave data\n", HRESULT_FROM_WIN32( error ) );
+        throw std::exception( "GetOverlappedResult" );
+    }
+
+    if ( bytes < ( buffer.skipBytes + buffer.audioBytes ) )
+    {
+        DebugTrace( "ERROR: SoundStreamInstance hit the end of the wave bank file\n" );
+        throw std::exception( "GetOverlappedResult" );
+    }
+
+    return true;
+}
+
+
+void SoundStreamInstance::Impl::SubmitBuffer( StreamBuffer& buffer )
+{
+    assert( mBase.voice != 0 );
+
+    XAUDIO2_BUFFER xbuffer;
+    memset( &xbuffer, 0, sizeof(xbuffer) );
+
+    xbuffer.AudioBytes = buffer.audioBytes;
+    xbuffer.pAudioData = buffer.data + buffer.skipBytes;
+    xbuffer.PlayBegin = buffer.playBegin;
+    xbuffer.PlayLength = buffer.playLength;
+    xbuffer.Flags = ( buffer.endOfStream ) ? XAUDIO2_END_OF_STREAM : 0;
+
+    HRESULT hr;
+#if defined(_XBOX_ONE) || (_WIN32_WINNT < _WIN32_WINNT_WIN8) || (_WIN32_WINNT >= _WIN32_WINNT_WIN10)
+    if ( mSeekTable )
+    {
+        // Each buffer gets the slice of the seek table for its packets, rebased to the start of the buffer
+        uint32_t first = buffer.firstPacket;
+        uint32_t count = std::min( buffer.packetCount, ( first < mSeekCount ) ? ( mSeekCount - first ) : 0 );
+        uint32_t base = ( first > 0 ) ? mSeekTable[ first - 1 ] : 0;
+
+        buffer.seekTable.resize( count );
+        for( uint32_t j = 0; j < count; ++j )
+        {
+            buffer.seekTable[ j ] = mSeekTable[ first + j ] - base;
+        }
+
+        XAUDIO2_BUFFER_WMA wmaBuffer;
+        memset( &wmaBuffer, 0, sizeof(wmaBuffer) );
+        wmaBuffer.pDecodedPacketCumulativeBytes = ( count > 0 ) ? &buffer.seekTable.front() : nullptr;
+        wmaBuffer.PacketCount = count;
+
+        hr = mBase.voice->SubmitSourceBuffer( &xbuffer, &wmaBuffer );
+    }
+    else
+#endif
+    {
+        hr = mBase.voice->SubmitSourceBuffer( &xbuffer, nullptr );
+    }
+
+    if ( FAILED(hr) )
+    {
+#ifdef _DEBUG
+        DebugTrace( "ERROR: SoundStreamInstance failed (%08X) when submitting buffer:\n", hr );
+
+        auto wfx = GetFormat();
+        DebugTrace( "\tFormat Tag %u, %u channels, %u-bit, %u Hz, %u bytes\n", wfx->wFormatTag,
+                    wfx->nChannels, wfx->wBitsPerSample, wfx->nSamplesPerSec, buffer.audioBytes );
+#endif
+        Stop( true );
+        throw std::exception( "SubmitSourceBuffer" );
+    }
+
+    buffer.state = BUFFER_SUBMITTED;
+    mNextSubmit = ( mNextSubmit + 1 ) % BufferCount;
+    ++mSubmittedCount;
+
+    if ( buffer.endOfStream )
+        mEndSubmitted = true;
+}
+
+
+// Abandons any reads that have not been submitted. Buffers already on the voice are released by OnUpdate.
+void SoundStreamInstance::Impl::CancelReads()
+{
+    for( size_t j = 0; j < BufferCount; ++j )
+    {
+        auto& buffer = mBuffers[ j ];
+
+        if ( buffer.state == BUFFER_READING )
+        {
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+            (void)CancelIoEx( mAsync, &buffer.request );
+#endif
+
+            DWORD bytes;
+            (void)GetOverlappedResult( mAsync, &buffer.request, &bytes, TRUE );
+
+            buffer.state = BUFFER_FREE;
+        }
+        else if ( buffer.state == BUFFER_READY )
+        {
+            buffer.state = BUFFER_FREE;
+        }
+    }
+
+    mNextRead = mNextSubmit;
+    mReadsDone = true;
+}
+
+
+// Called once the voice is gone, when nothing can still be reading the submitted buffers.
+void SoundStreamInstance::Impl::ReleaseBuffers()
+{
+    assert( !mBase.voice );
+
+    for( size_t j = 0; j < BufferCount; ++j )
+    {
+        if ( mBuffers[ j ].state == BUFFER_SUBMITTED )
+            mBuffers[ j ].state = BUFFER_FREE;
+    }
+
+    mNextRelease = mNextSubmit = mNextRead;
+    mSubmittedCount = 0;
+    mEndSubmitted = false;
+}
+
+
+//--------------------------------------------------------------------------------------
+// SoundStreamInstance
+//--------------------------------------------------------------------------------------
+
+// Private constructors
+_Use_decl_annotations_
+SoundStreamInstance::SoundStreamInstance( AudioEngine* engine, WaveBank* waveBank, int index, SOUND_EFFECT_INSTANCE_FLAGS flags ) :
+    pImpl( new Impl( engine, waveBank, waveBank->GetReader(), index, flags ) )
+{
+}
+
+
+// Move constructor.
+SoundStreamInstance::SoundStreamInstance(SoundStreamInstance&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+SoundStreamInstance& SoundStreamInstance::operator= (SoundStreamInstance&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+SoundStreamInstance::~SoundStreamInstance()
+{
+    if( pImpl )
+    {
+        if ( pImpl->mWaveBank )
+        {
+            pImpl->mWaveBank->UnregisterInstance( this );
+            pImpl->mWaveBank = nullptr;
+        }
+    }
+}
+
+
+// Public methods.
+void SoundStreamInstance::Play( bool loop )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->Play( loop );
+}
+
+
+void SoundStreamInstance::Stop( bool immediate )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->Stop( immediate );
+}
+
+
+void SoundStreamInstance::Pause()
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->mBase.Pause();
+}
+
+
+void SoundStreamInstance::Resume()
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->mBase.Resume();
+}
+
+
+void SoundStreamInstance::SetVolume( float volume )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->mBase.SetVolume( volume );
+}
+
+
+void SoundStreamInstance::SetPitch( float pitch )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->mBase.SetPitch( pitch );
+}
+
+
+void SoundStreamInstance::SetPan( float pan )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->mBase.SetPan( pan );
+}
+
+
+void SoundStreamInstance::Apply3D( const AudioListener& listener, const AudioEmitter& emitter )
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    pImpl->mBase.Apply3D( listener, emitter );
+}
+
+
+// Public accessors.
+bool SoundStreamInstance::IsLooped() const
+{
+    return pImpl->mLooped;
+}
+
+
+SoundState SoundStreamInstance::GetState()
+{
+    EngineLock lock( pImpl->mBase.engine );
+
+    // The stream stops itself in AudioEngine::Update once the last buffer has played
+    return pImpl->mBase.GetState( false );
+}
+
+
+// Notifications.
+void SoundStreamInstance::OnDestroyParent()
+{
+    pImpl->OnDestroyParent();
+}
@@ -136,9 +136,8 @@ static const RIFFChunk* FindChunk( _In_reads_bytes_(sizeBytes) const uint8_t* da
 
 
 //--------------------------------------------------------------------------------------
-static HRESULT WaveFindFormatAndData( _In_reads_bytes_(wavDataSize) const uint8_t* wavData, _In_ size_t wavDataSize,
-                                      _Outptr_ const WAVEFORMATEX** pwfx, _Outptr_ const uint8_t** pdata, _Out_ uint32_t* dataSize,
-                                      _Out_ bool& dpds, _Out_ bool& seek )
+static HRESULT WaveFindFormat( _In_reads_bytes_(wavDataSize) const uint8_t* wavData, _In_ size_t wavDataSize,
+                               _Outptr_ const WAVEFORMATEX** pwfx, _Out_ bool& dpds, _Out_ bool& seek )
 {
     if ( !wavData || !pwfx )
         return E_POINTER;
@@ -274,8 +273,31 @@ static HRESULT WaveFindFormatAndData( _In_reads_bytes_(wavDataSize) const uint8_
         }
     }
 
+    *pwfx = reinterpret_cast<const WAVEFORMATEX*>( wf );
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT WaveFindFormatAndData( _In_reads_bytes_(wavDataSize) const uint8_t* wavData, _In_ size_t wavDataSize,
+                                      _Outptr_ const WAVEFORMATEX** pwfx, _Outptr_ const uint8_t** pdata, _Out_ uint32_t* dataSize,
+                                      _Out_ bool& dpds, _Out_ bool& seek )
+{
+    if ( !pdata || !dataSize )
+        return E_POINTER;
+
+    const WAVEFORMATEX* wf = nullptr;
+    HRESULT hr = WaveFindFormat( wavData, wavDataSize, &wf, dpds, seek );
+    if ( FAILED(hr) )
+        return hr;
+
+    const uint8_t* wavEnd = wavData + wavDataSize;
+
+    auto riffChunk = FindChunk( wavData, wavDataSize, FOURCC_RIFF_TAG );
+    assert( riffChunk != 0 );
+
     // Locate 'data'
-    ptr = reinterpret_cast<const uint8_t*>( riffHeader ) + sizeof(RIFFChunkHeader);
+    auto ptr = reinterpret_cast<const uint8_t*>( riffChunk ) + sizeof(RIFFChunkHeader);
     if ( ( ptr + sizeof(RIFFChunk) ) > wavEnd )
     {
         return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
@@ -293,7 +315,7 @@ static HRESULT WaveFindFormatAndData( _In_reads_bytes_(wavDataSize) const uint8_
         return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
     }
 
-    *pwfx = reinterpret_cast<const WAVEFORMATEX*>( wf );
+    *pwfx = wf;
     *pdata = ptr;
     *dataSize = dataChunk->size;
     return S_OK;
@@ -468,78 +490,216 @@ static HRESULT WaveFindTable( _In_reads_bytes_(wavDataSize) const uint8_t* wavDa
 
 
 //--------------------------------------------------------------------------------------
-static HRESULT LoadAudioFromFile( _In_z_ const wchar_t* szFileName, _Inout_ std::unique_ptr<uint8_t[]>& wavData, _Out_ DWORD* bytesRead )
+static HANDLE OpenWAVFile( _In_z_ const wchar_t* szFileName )
 {
-    if ( !szFileName )
-        return E_INVALIDARG;
-
-    // open the file
 #if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-    ScopedHandle hFile( safe_handle( CreateFile2( szFileName,
-                                                  GENERIC_READ,
-                                                  FILE_SHARE_READ,
-                                                  OPEN_EXISTING,
-                                                  nullptr ) ) );
+    return safe_handle( CreateFile2( szFileName,
+                                     GENERIC_READ,
+                                     FILE_SHARE_READ,
+                                     OPEN_EXISTING,
+                                     nullptr ) );
 #else
-    ScopedHandle hFile( safe_handle( CreateFileW( szFileName,
-                                                  GENERIC_READ,
-                                                  FILE_SHARE_READ,
-                                                  nullptr,
-                                                  OPEN_EXISTING,
-                                                  FILE_ATTRIBUTE_NORMAL,
-                                                  nullptr ) ) );
+    return safe_handle( CreateFileW( szFileName,
+                                     GENERIC_READ,
+                                     FILE_SHARE_READ,
+                                     nullptr,
+                                     OPEN_EXISTING,
+                                     FILE_ATTRIBUTE_NORMAL,
+                                     nullptr ) );
 #endif
+}
 
-    if ( !hFile )
-    {
-        return HRESULT_FROM_WIN32( GetLastError() );
-    }
 
-    // Get the file size
+//--------------------------------------------------------------------------------------
+static HRESULT GetWAVFileSize( _In_ HANDLE hFile, _Out_ uint64_t* fileSize )
+{
     LARGE_INTEGER FileSize = { 0 };
 
 #if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
     FILE_STANDARD_INFO fileInfo;
-    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
+    if ( !GetFileInformationByHandleEx( hFile, FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
     {
         return HRESULT_FROM_WIN32( GetLastError() );
     }
     FileSize = fileInfo.EndOfFile;
 #else
-    GetFileSizeEx( hFile.get(), &FileSize );
+    if ( !GetFileSizeEx( hFile, &FileSize ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
 #endif
 
-    // File is too big for 32-bit allocation, so reject read
-    if (FileSize.HighPart > 0)
+    *fileSize = static_cast<uint64_t>( FileSize.QuadPart );
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT ReadWAVFileAt( _In_ HANDLE hFile, _In_ uint64_t offset, _Out_writes_bytes_(bytes) void* dest, _In_ DWORD bytes )
+{
+    LARGE_INTEGER pos;
+    pos.QuadPart = static_cast<LONGLONG>( offset );
+    if ( !SetFilePointerEx( hFile, pos, nullptr, FILE_BEGIN ) )
     {
-        return E_FAIL;
+        return HRESULT_FROM_WIN32( GetLastError() );
     }
 
+    DWORD bytesRead = 0;
+    if ( !ReadFile( hFile, dest, bytes, &bytesRead, nullptr ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    return ( bytesRead < bytes ) ? HRESULT_FROM_WIN32( ERROR_HANDLE_EOF ) : S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Walks the file's chunks by seeking, and reads only the ones the parsers above use into a compact RIFF image.
+// The 'data' chunk is placed last in the image if requested, otherwise its location in the file is returned.
+static HRESULT ReadWAVChunks( _In_ HANDLE hFile, bool readData,
+                              _Inout_ std::unique_ptr<uint8_t[]>& image, _Out_ size_t* imageSize,
+                              _Out_ uint64_t* dataOffset, _Out_ uint32_t* dataSize )
+{
+    *imageSize = 0;
+    *dataOffset = 0;
+    *dataSize = 0;
+
+    uint64_t fileSize = 0;
+    HRESULT hr = GetWAVFileSize( hFile, &fileSize );
+    if ( FAILED(hr) )
+        return hr;
+
     // Need at least enough data to have a valid minimal WAV file
-    if (FileSize.LowPart < ( sizeof(RIFFChunk)*2 + sizeof(DWORD) + sizeof(WAVEFORMAT) ) )
+    if ( fileSize < ( sizeof(RIFFChunk)*2 + sizeof(DWORD) + sizeof(WAVEFORMAT) ) )
     {
         return E_FAIL;
     }
 
-    // create enough space for the file data
-    wavData.reset( new (std::nothrow) uint8_t[ FileSize.LowPart ] );
-    if (!wavData)
+    RIFFChunkHeader riff;
+    hr = ReadWAVFileAt( hFile, 0, &riff, sizeof(riff) );
+    if ( FAILED(hr) )
+        return hr;
+
+    if ( riff.tag != FOURCC_RIFF_TAG || riff.size < 4
+         || ( riff.riff != FOURCC_WAVE_FILE_TAG && riff.riff != FOURCC_XWMA_FILE_TAG ) )
+    {
+        return E_FAIL;
+    }
+
+    static const uint32_t s_tags[] = { FOURCC_FORMAT_TAG, FOURCC_DLS_SAMPLE, FOURCC_MIDI_SAMPLE, FOURCC_XWMA_DPDS, FOURCC_XMA_SEEK, FOURCC_DATA_TAG };
+    static const size_t TAG_COUNT = _countof(s_tags);
+    static const size_t TAG_DATA = TAG_COUNT - 1;
+
+    uint64_t offsets[ TAG_COUNT ] = { 0 };
+    uint32_t sizes[ TAG_COUNT ] = { 0 };
+    bool found[ TAG_COUNT ] = { false };
+
+    uint64_t riffEnd = std::min<uint64_t>( uint64_t( riff.size ) + sizeof(RIFFChunk), fileSize );
+
+    uint64_t offset = sizeof(RIFFChunkHeader);
+    while ( ( offset + sizeof(RIFFChunk) ) <= riffEnd )
+    {
+        RIFFChunk chunk;
+        hr = ReadWAVFileAt( hFile, offset, &chunk, sizeof(chunk) );
+        if ( FAILED(hr) )
+            return hr;
+
+        for( size_t j = 0; j < TAG_COUNT; ++j )
+        {
+            if ( chunk.tag == s_tags[ j ] && !found[ j ] )
+            {
+                if ( ( offset + sizeof(RIFFChunk) + chunk.size ) > fileSize )
+                    return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+
+                found[ j ] = true;
+                offsets[ j ] = offset + sizeof(RIFFChunk);
+                sizes[ j ] = chunk.size;
+                break;
+            }
+        }
+
+        // Chunks are padded to an even size
+        offset += sizeof(RIFFChunk) + uint64_t( chunk.size ) + ( chunk.size & 1 );
+    }
+
+    if ( !found[ 0 ] )
+    {
+        return E_FAIL;
+    }
+
+    if ( !found[ TAG_DATA ] || !sizes[ TAG_DATA ] )
+    {
+        return HRESULT_FROM_WIN32( ERROR_INVALID_DATA );
+    }
+
+    uint64_t total = sizeof(RIFFChunkHeader);
+    for( size_t j = 0; j < TAG_COUNT; ++j )
+    {
+        if ( found[ j ] && ( j != TAG_DATA || readData ) )
+            total += sizeof(RIFFChunk) + sizes[ j ];
+    }
+
+    if ( total > 0xFFFFFFFF || total > SIZE_MAX )
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
+    image.reset( new (std::nothrow) uint8_t[ static_cast<size_t>( total ) ] );
+    if ( !image )
     {
         return E_OUTOFMEMORY;
     }
 
-    // read the data in
-    if (!ReadFile( hFile.get(),
-                   wavData.get(),
-                   FileSize.LowPart,
-                   bytesRead,
-                   nullptr
-                   ))
+    auto header = reinterpret_cast<RIFFChunkHeader*>( image.get() );
+    header->tag = FOURCC_RIFF_TAG;
+    header->size = static_cast<uint32_t>( total - sizeof(RIFFChunk) );
+    header->riff = riff.riff;
+
+    // The image packs the chunks without padding, which is how FindChunk walks them
+    uint8_t* ptr = image.get() + sizeof(RIFFChunkHeader);
+    for( size_t j = 0; j < TAG_COUNT; ++j )
+    {
+        if ( !found[ j ] || ( j == TAG_DATA && !readData ) )
+            continue;
+
+        auto chunk = reinterpret_cast<RIFFChunk*>( ptr );
+        chunk->tag = s_tags[ j ];
+        chunk->size = sizes[ j ];
+        ptr += sizeof(RIFFChunk);
+
+        if ( sizes[ j ] > 0 )
+        {
+            hr = ReadWAVFileAt( hFile, offsets[ j ], ptr, sizes[ j ] );
+            if ( FAILED(hr) )
+                return hr;
+        }
+
+        ptr += sizes[ j ];
+    }
+
+    *imageSize = static_cast<size_t>( total );
+    *dataOffset = offsets[ TAG_DATA ];
+    *dataSize = sizes[ TAG_DATA ];
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT LoadAudioFromFile( _In_z_ const wchar_t* szFileName, _Inout_ std::unique_ptr<uint8_t[]>& wavData, _Out_ size_t* bytesRead )
+{
+    if ( !szFileName )
+        return E_INVALIDARG;
+
+    ScopedHandle hFile( OpenWAVFile( szFileName ) );
+    if ( !hFile )
     {
         return HRESULT_FROM_WIN32( GetLastError() );
     }
 
-    return (*bytesRead < FileSize.LowPart) ? E_FAIL : S_OK;
+    uint64_t dataOffset;
+    uint32_t dataSize;
+    return ReadWAVChunks( hFile.get(), true, wavData, bytesRead, &dataOffset, &dataSize );
 }
 
 
@@ -588,7 +748,7 @@ HRESULT DirectX::LoadWAVAudioFromFile( const wchar_t* szFileName,
     *startAudio = nullptr;
     *audioBytes = 0;
 
-    DWORD bytesRead = 0;
+    size_t bytesRead = 0;
     HRESULT hr = LoadAudioFromFile( szFileName, wavData, &bytesRead );
     if ( FAILED(hr) )
     {
@@ -654,7 +814,7 @@ HRESULT DirectX::LoadWAVAudioFromFileEx( const wchar_t* szFileName, std::unique_
 
     memset( &result, 0, sizeof(result) );
 
-    DWORD bytesRead = 0;
+    size_t bytesRead = 0;
     HRESULT hr = LoadAudioFromFile( szFileName, wavData, &bytesRead );
     if ( FAILED(hr) )
     {
@@ -686,3 +846,183 @@ HRESULT DirectX::LoadWAVAudioFromFileEx( const wchar_t* szFileName, std::unique_
     return S_OK;
 }
 
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadWAVAudioFromFileMapped( const wchar_t* szFileName, std::unique_ptr<WAVFileMapping>& mapping, DirectX::WAVData& result )
+{
+    if ( !szFileName )
+        return E_INVALIDARG;
+
+    memset( &result, 0, sizeof(result) );
+
+    std::unique_ptr<WAVFileMapping> view( new (std::nothrow) WAVFileMapping );
+    if ( !view )
+        return E_OUTOFMEMORY;
+
+    HRESULT hr = view->Open( szFileName );
+    if ( FAILED(hr) )
+        return hr;
+
+    // The results point directly into the mapped view
+    hr = LoadWAVAudioInMemoryEx( view->GetData(), view->GetSize(), result );
+    if ( FAILED(hr) )
+        return hr;
+
+    mapping = std::move( view );
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadWAVAudioHeaderFromFile( const wchar_t* szFileName, std::unique_ptr<uint8_t[]>& wavHeader, DirectX::WAVData& result, uint64_t* dataOffset )
+{
+    if ( !szFileName || !dataOffset )
+        return E_INVALIDARG;
+
+    memset( &result, 0, sizeof(result) );
+    *dataOffset = 0;
+
+    ScopedHandle hFile( OpenWAVFile( szFileName ) );
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    size_t headerSize = 0;
+    uint64_t offset = 0;
+    uint32_t dataSize = 0;
+    HRESULT hr = ReadWAVChunks( hFile.get(), false, wavHeader, &headerSize, &offset, &dataSize );
+    if ( FAILED(hr) )
+        return hr;
+
+    bool dpds, seek;
+    hr = WaveFindFormat( wavHeader.get(), headerSize, &result.wfx, dpds, seek );
+    if ( FAILED(hr) )
+        return hr;
+
+    hr = WaveFindLoopInfo( wavHeader.get(), headerSize, &result.loopStart, &result.loopLength );
+    if ( FAILED(hr) )
+        return hr;
+
+    if ( dpds )
+    {
+        hr = WaveFindTable( wavHeader.get(), headerSize, FOURCC_XWMA_DPDS, &result.seek, &result.seekCount );
+        if ( FAILED(hr) )
+            return hr;
+    }
+    else if ( seek )
+    {
+        hr = WaveFindTable( wavHeader.get(), headerSize, FOURCC_XMA_SEEK, &result.seek, &result.seekCount );
+        if ( FAILED(hr) )
+            return hr;
+    }
+
+    // The wave data itself stays in the file
+    result.audioBytes = dataSize;
+    *dataOffset = offset;
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// WAVFileMapping
+//--------------------------------------------------------------------------------------
+
+WAVFileMapping::WAVFileMapping() :
+    mMapping( nullptr ),
+    mView( nullptr ),
+    mSize( 0 )
+{
+}
+
+
+WAVFileMapping::~WAVFileMapping()
+{
+    Close();
+}
+
+
+_Use_decl_annotations_
+HRESULT WAVFileMapping::Open( const wchar_t* szFileName )
+{
+    Close();
+
+    if ( !szFileName )
+        return E_INVALIDARG;
+
+    ScopedHandle hFile( OpenWAVFile( szFileName ) );
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    uint64_t fileSize = 0;
+    HRESULT hr = GetWAVFileSize( hFile.get(), &fileSize );
+    if ( FAILED(hr) )
+        return hr;
+
+    // Need at least enough data to have a valid minimal WAV file
+    if ( fileSize < ( sizeof(RIFFChunk)*2 + sizeof(DWORD) + sizeof(WAVEFORMAT) ) )
+    {
+        return E_FAIL;
+    }
+
+    // The whole file is mapped, so it must fit in the address space
+    if ( fileSize > SIZE_MAX )
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+    }
+
+#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY == WINAPI_FAMILY_APP)
+    mMapping = CreateFileMappingFromApp( hFile.get(), nullptr, PAGE_READONLY, 0, nullptr );
+#elif !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+    mMapping = CreateFileMappingW( hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr );
+#else
+    return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+#endif
+
+    if ( !mMapping )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY == WINAPI_FAMILY_APP)
+    mView = reinterpret_cast<const uint8_t*>( MapViewOfFileFromApp( mMapping, FILE_MAP_READ, 0, 0 ) );
+#else
+    mView = reinterpret_cast<const uint8_t*>( MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 ) );
+#endif
+
+    if ( !mView )
+    {
+        DWORD error = GetLastError();
+        CloseHandle( mMapping );
+        mMapping = nullptr;
+        return HRESULT_FROM_WIN32( error );
+    }
+
+    mSize = static_cast<size_t>( fileSize );
+
+    // The mapping keeps the file open once the file handle is closed
+    return S_OK;
+}
+
+
+void WAVFileMapping::Close()
+{
+    if ( mView )
+    {
+        UnmapViewOfFile( mView );
+        mView = nullptr;
+    }
+
+    if ( mMapping )
+    {
+        CloseHandle( mMapping );
+        mMapping = nullptr;
+    }
+
+    mSize = 0;
+}
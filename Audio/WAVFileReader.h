@@ -56,4 +56,38 @@ namespace DirectX
     HRESULT LoadWAVAudioFromFileEx( _In_z_ const wchar_t* szFileName, 
                                     _Inout_ std::unique_ptr<uint8_t[]>& wavData,
                                     _Out_ WAVData& result );
+
+    // Read-only view of a whole .wav file
+    class WAVFileMapping
+    {
+    public:
+        WAVFileMapping();
+        ~WAVFileMapping();
+
+        HRESULT Open( _In_z_ const wchar_t* szFileName );
+        void Close();
+
+        const uint8_t* GetData() const { return mView; }
+        size_t GetSize() const { return mSize; }
+
+    private:
+        HANDLE          mMapping;
+        const uint8_t*  mView;
+        size_t          mSize;
+
+        // Prevent copying.
+        WAVFileMapping(WAVFileMapping const&) DIRECTX_CTOR_DELETE
+        WAVFileMapping& operator= (WAVFileMapping const&) DIRECTX_CTOR_DELETE
+    };
+
+    // Results point into the mapping, so it must outlive their use
+    HRESULT LoadWAVAudioFromFileMapped( _In_z_ const wchar_t* szFileName,
+                                        _Inout_ std::unique_ptr<WAVFileMapping>& mapping,
+                                        _Out_ WAVData& result );
+
+    // Reads only the format, loop, and seek table chunks; startAudio is null and the audioBytes of wave data start at dataOffset in the file
+    HRESULT LoadWAVAudioHeaderFromFile( _In_z_ const wchar_t* szFileName,
+                                        _Inout_ std::unique_ptr<uint8_t[]>& wavHeader,
+                                        _Out_ WAVData& result,
+                                        _Out_ uint64_t* dataOffset );
 }
\ No newline at end of file
@@ -30,14 +30,15 @@ using namespace DirectX;
 class WaveBank::Impl : public IVoiceNotify
 {
 public:
-    explicit Impl( _In_ AudioEngine* engine ) :
+    Impl( _In_ AudioEngine* engine, _In_ WaveBank* object ) :
         mEngine( engine ),
         mOneShots( 0 ),
         mPrepared( false ),
-        mStreaming( false )
+        mStreaming( false ),
+        mObject( object )
     {
         assert( mEngine != 0 );
-        mEngine->RegisterNotify( this, false );
+        mEngine->RegisterNotify( this, true );
     }
 
     virtual ~Impl()
@@ -55,6 +56,19 @@ public:
             mInstances.clear();
         }
 
+        if ( !mStreams.empty() )
+        {
+            DebugTrace( "WARNING: Destroying WaveBank \"%hs\" with %Iu outstanding SoundStreamInstances\n", mReader.BankName(), mStreams.size() );
+
+            for( auto it = mStreams.begin(); it != mStreams.end(); ++it )
+            {
+                assert( *it != 0 );
+                (*it)->OnDestroyParent();
+            }
+
+            mStreams.clear();
+        }
+
         if ( mOneShots > 0 )
         {
             DebugTrace( "WARNING: Destroying WaveBank \"%hs\" with %u outstanding one shot effects\n", mReader.BankName(), mOneShots );
@@ -62,12 +76,12 @@ public:
 
         if ( mEngine )
         {
-            mEngine->UnregisterNotify( this, true, false );
+            mEngine->UnregisterNotify( this, true, true );
             mEngine = nullptr;
         }
     }
 
-    HRESULT Initialize( _In_ AudioEngine* engine, _In_z_ const wchar_t* wbFileName );
+    HRESULT Initialize( _In_ AudioEngine* engine, _In_z_ const wchar_t* wbFileName, bool memoryMapped );
 
     void Play( int index, float volume, float pitch, float pan );
 
@@ -89,8 +103,21 @@ public:
 
     virtual void __cdecl OnUpdate() override
     {
-        // We do not register for update notification
-        assert(false);
+        if ( !mPreparedCallback )
+            return;
+
+        if ( !mPrepared )
+        {
+            if ( !mReader.IsPrepared() )
+                return;
+
+            mPrepared = true;
+        }
+
+        // Only called once, and the callback is free to set a new one
+        auto callback = mPreparedCallback;
+        mPreparedCallback = nullptr;
+        callback( mObject );
     }
 
     virtual void __cdecl OnDestroyEngine() override
@@ -108,7 +135,8 @@ public:
     {
         stats.playingOneShots += mOneShots;
 
-        if ( !mStreaming )
+        // Memory-mapped wave data is paged in by the OS rather than held in the heap
+        if ( !mStreaming && !mReader.IsMemoryMapped() )
         {
             stats.audioBytes += mReader.BankAudioSize();
 
@@ -121,20 +149,23 @@ public:
 
     AudioEngine*                        mEngine;
     std::list<SoundEffectInstance*>     mInstances;
+    std::list<SoundStreamInstance*>     mStreams;
     WaveBankReader                      mReader;
     uint32_t                            mOneShots;
     bool                                mPrepared;
     bool                                mStreaming;
+    std::function<void(WaveBank*)>      mPreparedCallback;
+    WaveBank*                           mObject;
 };
 
 
 _Use_decl_annotations_
-HRESULT WaveBank::Impl::Initialize( AudioEngine* engine, const wchar_t* wbFileName )
+HRESULT WaveBank::Impl::Initialize( AudioEngine* engine, const wchar_t* wbFileName, bool memoryMapped )
 {
     if ( !engine || !wbFileName )
         return E_INVALIDARG;
 
-    HRESULT hr = mReader.Open( wbFileName );
+    HRESULT hr = mReader.Open( wbFileName, memoryMapped );
     if ( FAILED(hr) )
         return hr;
 
@@ -255,10 +286,10 @@ void WaveBank::Impl::Play( int index, float volume, float pitch, float pan )
 
 // Public constructors.
 _Use_decl_annotations_
-WaveBank::WaveBank( AudioEngine* engine, const wchar_t* wbFileName )
-  : pImpl(new Impl(engine) )
+WaveBank::WaveBank( AudioEngine* engine, const wchar_t* wbFileName, bool memoryMapped )
+  : pImpl(new Impl(engine, this) )
 {
-    HRESULT hr = pImpl->Initialize( engine, wbFileName );
+    HRESULT hr = pImpl->Initialize( engine, wbFileName, memoryMapped );
     if ( FAILED(hr) )
     {
         DebugTrace( "ERROR: WaveBank failed (%08X) to intialize from .xwb file \"%ls\"\n", hr, wbFileName );
@@ -274,6 +305,8 @@ WaveBank::WaveBank( AudioEngine* engine, const wchar_t* wbFileName )
 WaveBank::WaveBank(WaveBank&& moveFrom)
   : pImpl(std::move(moveFrom.pImpl))
 {
+    if ( pImpl )
+        pImpl->mObject = this;
 }
 
 
@@ -281,6 +314,8 @@ WaveBank::WaveBank(WaveBank&& moveFrom)
 WaveBank& WaveBank::operator= (WaveBank&& moveFrom)
 {
     pImpl = std::move(moveFrom.pImpl);
+    if ( pImpl )
+        pImpl->mObject = this;
     return *this;
 }
 
@@ -372,6 +407,42 @@ std::unique_ptr<SoundEffectInstance> WaveBank::CreateInstance( _In_z_ const char
 }
 
 
+std::unique_ptr<SoundStreamInstance> WaveBank::CreateStreamInstance( int index, SOUND_EFFECT_INSTANCE_FLAGS flags )
+{
+    auto& wb = pImpl->mReader;
+
+    if ( !pImpl->mStreaming )
+    {
+        DebugTrace( "ERROR: SoundStreamInstances can only be created from a streaming wave bank\n");
+        throw std::exception( "WaveBank::CreateStreamInstance" );
+    }
+
+    if ( index < 0 || uint32_t(index) >= wb.Count() )
+    {
+        // We don't throw an exception here as titles often simply ignore missing assets rather than fail
+        return std::unique_ptr<SoundStreamInstance>();
+    }
+
+    auto stream = new SoundStreamInstance( pImpl->mEngine, this, index, flags );
+    assert( stream != 0 );
+    pImpl->mStreams.emplace_back( stream );
+    return std::unique_ptr<SoundStreamInstance>( stream );
+}
+
+
+std::unique_ptr<SoundStreamInstance> WaveBank::CreateStreamInstance( _In_z_ const char* name, SOUND_EFFECT_INSTANCE_FLAGS flags )
+{
+    int index = static_cast<int>( pImpl->mReader.Find( name ) );
+    if ( index == -1 )
+    {
+        // We don't throw an exception here as titles often simply ignore missing assets rather than fail
+        return std::unique_ptr<SoundStreamInstance>();
+    }
+
+    return CreateStreamInstance( index, flags );
+}
+
+
 void WaveBank::UnregisterInstance( _In_ SoundEffectInstance* instance )
 {
     auto it = std::find( pImpl->mInstances.begin(), pImpl->mInstances.end(), instance );
@@ -382,6 +453,22 @@ void WaveBank::UnregisterInstance( _In_ SoundEffectInstance* instance )
 }
 
 
+void WaveBank::UnregisterInstance( _In_ SoundStreamInstance* instance )
+{
+    auto it = std::find( pImpl->mStreams.begin(), pImpl->mStreams.end(), instance );
+    if ( it == pImpl->mStreams.end() )
+        return;
+
+    pImpl->mStreams.erase( it );
+}
+
+
+const WaveBankReader& WaveBank::GetReader() const
+{
+    return pImpl->mReader;
+}
+
+
 // Public accessors.
 bool WaveBank::IsPrepared() const
 {
@@ -396,9 +483,30 @@ bool WaveBank::IsPrepared() const
 }
 
 
+float WaveBank::GetPrepareProgress() const
+{
+    if ( pImpl->mPrepared )
+        return 1.f;
+
+    return pImpl->mReader.PrepareProgress();
+}
+
+
+void WaveBank::SetPreparedCallback( std::function<void DIRECTX_STD_CALLCONV(WaveBank*)> callback )
+{
+    pImpl->mPreparedCallback = callback;
+}
+
+
+bool WaveBank::IsMemoryMapped() const
+{
+    return pImpl->mReader.IsMemoryMapped();
+}
+
+
 bool WaveBank::IsInUse() const
 {
-    return ( pImpl->mOneShots > 0 ) || !pImpl->mInstances.empty();
+    return ( pImpl->mOneShots > 0 ) || !pImpl->mInstances.empty() || !pImpl->mStreams.empty();
 }
 
 
@@ -432,19 +432,22 @@ public:
     Impl() :
         m_async( INVALID_HANDLE_VALUE ),
         m_event( INVALID_HANDLE_VALUE ),
-        m_prepared(false)
+        m_prepared(false),
+        m_requestCount(0),
+        m_requestsDone(0),
+        m_mapping( nullptr ),
+        m_mappedView( nullptr )
 #if defined(_XBOX_ONE) && defined(_TITLE)
         , m_xmaMemory(nullptr)
 #endif
     {
         memset( &m_header, 0, sizeof(HEADER) );
         memset( &m_data, 0, sizeof(BANKDATA) );
-        memset( &m_request, 0, sizeof(OVERLAPPED) );
     }
 
     ~Impl() { Close(); }
 
-    HRESULT Open( _In_z_ const wchar_t* szFileName );
+    HRESULT Open( _In_z_ const wchar_t* szFileName, bool memoryMapped );
     void Close();
 
     HRESULT GetFormat( _In_ uint32_t index, _Out_writes_bytes_(maxsize) WAVEFORMATEX* pFormat, _In_ size_t maxsize ) const;
@@ -455,7 +458,11 @@ public:
 
     HRESULT GetMetadata( _In_ uint32_t index, _Out_ Metadata& metadata ) const;
 
+    HRESULT GetStreamingParameters( _In_ uint32_t index, _Out_ StreamingParameters& params ) const;
+
     bool UpdatePrepared();
+    void WaitOnPrepare();
+    float PrepareProgress();
 
     void Clear()
     {
@@ -478,14 +485,26 @@ public:
 
     HANDLE                              m_async;
     HANDLE                              m_event;
-    OVERLAPPED                          m_request;
     bool                                m_prepared;
 
+    // In-memory wave data is read with several overlapped requests so progress can be reported
+    std::unique_ptr<OVERLAPPED[]>       m_requests;
+    uint32_t                            m_requestCount;
+    uint32_t                            m_requestsDone;
+
+    // Memory-mapped wave data (whole file view)
+    HANDLE                              m_mapping;
+    const uint8_t*                      m_mappedView;
+
     HEADER                              m_header;
     BANKDATA                            m_data;
     std::map<std::string, uint32_t>     m_names;
 
 private:
+    HRESULT MapWaveData( _In_ HANDLE hFile );
+    HRESULT ReadWaveData( _In_ HANDLE hFile, _Out_writes_bytes_(length) void* dest, _In_ DWORD offset, _In_ DWORD length );
+    void CompleteRequests( bool cancel );
+
     std::unique_ptr<uint8_t[]>          m_entries;
     std::unique_ptr<uint8_t[]>          m_seekData;
     std::unique_ptr<uint8_t[]>          m_waveData;
@@ -498,7 +517,7 @@ public:
 
 
 _Use_decl_annotations_
-HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName )
+HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName, bool memoryMapped )
 {
     Close();
     Clear();
@@ -853,9 +872,9 @@ HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName )
     {
         // If in-memory, kick off read of wave data
         void *dest;
+        bool xma = false;
 
 #if defined(_XBOX_ONE) && defined(_TITLE)
-        bool xma = false;
         if ( m_data.dwFlags & BANKDATA::FLAGS_COMPACT )
         {
             if ( m_data.CompactFormat.wFormatTag == MINIWAVEFORMAT::TAG_XMA )
@@ -873,7 +892,29 @@ HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName )
                 }
             }
         }
+#endif // _XBOX_ONE && _TITLE
 
+        if ( memoryMapped )
+        {
+            // XMA data must live in APU memory, so it is always copied
+            if ( xma )
+            {
+                DebugTrace( "INFO: Wave bank contains XMA data which cannot be memory-mapped; reading into memory instead\n" );
+            }
+            else
+            {
+                HRESULT hr = MapWaveData( hFile.get() );
+                if ( SUCCEEDED(hr) )
+                {
+                    m_prepared = true;
+                    return S_OK;
+                }
+
+                DebugTrace( "WARNING: Failed to memory-map wave bank (%08X); reading into memory instead\n", hr );
+            }
+        }
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
         if ( xma )
         {
             HRESULT hr = ApuAlloc( &m_xmaMemory, nullptr, waveLen, SHAPE_XMA_INPUT_BUFFER_ALIGNMENT );
@@ -895,23 +936,15 @@ HRESULT WaveBankReader::Impl::Open( const wchar_t* szFileName )
             dest = m_waveData.get();
         }
 
-        memset( &m_request, 0, sizeof(OVERLAPPED) );
-        m_request.Offset = m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA].dwOffset;
-        m_request.hEvent = m_event;
-
-        if ( !ReadFile( hFile.get(), dest, waveLen, nullptr, &m_request ) )
-        {
-            DWORD error = GetLastError();
-            if ( error != ERROR_IO_PENDING )
-                return HRESULT_FROM_WIN32( error );
-        }
-        else
-        {
-            m_prepared = true;
-            memset( &m_request, 0, sizeof(OVERLAPPED) );
-        }
+        HRESULT hr = ReadWaveData( hFile.get(), dest, m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA].dwOffset, waveLen );
 
+        // Keep the handle even on failure so any requests already in flight are completed by Close
         m_async = hFile.release();
+
+        if ( FAILED(hr) )
+            return hr;
+
+        UpdatePrepared();
     }
 
     return S_OK;
@@ -922,17 +955,7 @@ void WaveBankReader::Impl::Close()
 {
     if ( m_async != INVALID_HANDLE_VALUE )
     {
-        if ( m_request.hEvent != 0 )
-        {
-            DWORD bytes;
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-            (void)GetOverlappedResultEx( m_async, &m_request, &bytes, INFINITE, FALSE );
-#else
-            (void)WaitForSingleObject( m_request.hEvent, INFINITE );
-
-            (void)GetOverlappedResult( m_async, &m_request, &bytes, FALSE );
-#endif
-        }
+        CompleteRequests( true );
 
         CloseHandle( m_async );
         m_async = INVALID_HANDLE_VALUE;
@@ -943,6 +966,17 @@ void WaveBankReader::Impl::Close()
         m_event = INVALID_HANDLE_VALUE;
     }
 
+    if ( m_mappedView )
+    {
+        UnmapViewOfFile( m_mappedView );
+        m_mappedView = nullptr;
+    }
+    if ( m_mapping )
+    {
+        CloseHandle( m_mapping );
+        m_mapping = nullptr;
+    }
+
 #if defined(_XBOX_ONE) && defined(_TITLE)
     if ( m_xmaMemory )
     {
@@ -953,6 +987,156 @@ void WaveBankReader::Impl::Close()
 }
 
 
+_Use_decl_annotations_
+HRESULT WaveBankReader::Impl::MapWaveData( HANDLE hFile )
+{
+    assert( !m_mapping && !m_mappedView );
+
+    // The view must cover the whole wave data segment
+    LARGE_INTEGER fileSize = { 0 };
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_STANDARD_INFO fileInfo;
+    if ( !GetFileInformationByHandleEx( hFile, FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    fileSize = fileInfo.EndOfFile;
+#else
+    if ( !GetFileSizeEx( hFile, &fileSize ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+#endif
+
+    auto& segment = m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA];
+    if ( uint64_t( fileSize.QuadPart ) < ( uint64_t( segment.dwOffset ) + segment.dwLength ) )
+    {
+        return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+    }
+
+#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY == WINAPI_FAMILY_APP)
+    m_mapping = CreateFileMappingFromApp( hFile, nullptr, PAGE_READONLY, 0, nullptr );
+#elif !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+    m_mapping = CreateFileMappingW( hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+#else
+    UNREFERENCED_PARAMETER( hFile );
+    return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+#endif
+
+    if ( !m_mapping )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY == WINAPI_FAMILY_APP)
+    m_mappedView = reinterpret_cast<const uint8_t*>( MapViewOfFileFromApp( m_mapping, FILE_MAP_READ, 0, 0 ) );
+#else
+    m_mappedView = reinterpret_cast<const uint8_t*>( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+#endif
+
+    if ( !m_mappedView )
+    {
+        DWORD error = GetLastError();
+        CloseHandle( m_mapping );
+        m_mapping = nullptr;
+        return HRESULT_FROM_WIN32( error );
+    }
+
+    return S_OK;
+}
+
+
+_Use_decl_annotations_
+HRESULT WaveBankReader::Impl::ReadWaveData( HANDLE hFile, void* dest, DWORD offset, DWORD length )
+{
+    static const DWORD MIN_REQUEST_SIZE = 1024 * 1024;
+    static const DWORD MAX_REQUESTS = 32;
+
+    DWORD chunk = std::max<DWORD>( MIN_REQUEST_SIZE, ( length + MAX_REQUESTS - 1 ) / MAX_REQUESTS );
+    uint32_t count = ( length + chunk - 1 ) / chunk;
+
+    m_requests.reset( new (std::nothrow) OVERLAPPED[ count ] );
+    if ( !m_requests )
+        return E_OUTOFMEMORY;
+
+    memset( m_requests.get(), 0, sizeof(OVERLAPPED) * count );
+    m_requestCount = 0;
+    m_requestsDone = 0;
+
+    for( uint32_t j = 0; j < count; ++j )
+    {
+        auto& request = m_requests[ j ];
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+        request.hEvent = CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE );
+#else
+        request.hEvent = CreateEvent( nullptr, TRUE, FALSE, nullptr );
+#endif
+        if ( !request.hEvent )
+            return HRESULT_FROM_WIN32( GetLastError() );
+
+        DWORD start = j * chunk;
+        request.Offset = offset + start;
+
+        if ( !ReadFile( hFile, reinterpret_cast<uint8_t*>( dest ) + start, std::min<DWORD>( chunk, length - start ), nullptr, &request ) )
+        {
+            DWORD error = GetLastError();
+            if ( error != ERROR_IO_PENDING )
+            {
+                // This request was never queued, so Close must not wait on it
+                CloseHandle( request.hEvent );
+                request.hEvent = nullptr;
+                return HRESULT_FROM_WIN32( error );
+            }
+        }
+
+        ++m_requestCount;
+    }
+
+    return S_OK;
+}
+
+
+void WaveBankReader::Impl::CompleteRequests( bool cancel )
+{
+    if ( !m_requests )
+        return;
+
+    for( uint32_t j = m_requestsDone; j < m_requestCount; ++j )
+    {
+        auto& request = m_requests[ j ];
+
+        if ( cancel )
+        {
+            (void)CancelIoEx( m_async, &request );
+        }
+
+        DWORD bytes;
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+        (void)GetOverlappedResultEx( m_async, &request, &bytes, INFINITE, FALSE );
+#else
+        (void)WaitForSingleObject( request.hEvent, INFINITE );
+
+        (void)GetOverlappedResult( m_async, &request, &bytes, FALSE );
+#endif
+    }
+
+    m_requestsDone = m_requestCount;
+
+    for( uint32_t j = 0; j < m_requestCount; ++j )
+    {
+        if ( m_requests[ j ].hEvent )
+            CloseHandle( m_requests[ j ].hEvent );
+    }
+
+    m_requests.reset();
+    m_requestCount = 0;
+    m_requestsDone = 0;
+}
+
+
 _Use_decl_annotations_
 HRESULT WaveBankReader::Impl::GetFormat( uint32_t index, WAVEFORMATEX* pFormat, size_t maxsize ) const
 {
@@ -1105,7 +1289,9 @@ HRESULT WaveBankReader::Impl::GetWaveData( uint32_t index, const uint8_t** pData
 #else
     const uint8_t* waveData = m_waveData.get();
 #endif
+    if ( m_mappedView )
     {
+        waveData = m_mappedView + m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA].dwOffset;
     }
 
     if ( !waveData )
@@ -1234,35 +1420,98 @@ HRESULT WaveBankReader::Impl::GetMetadata( uint32_t index, Metadata& metadata )
 }
 
 
+_Use_decl_annotations_
+HRESULT WaveBankReader::Impl::GetStreamingParameters( uint32_t index, StreamingParameters& params ) const
+{
+    memset( &params, 0, sizeof(StreamingParameters) );
+    params.async = INVALID_HANDLE_VALUE;
+
+    if ( !( m_data.dwFlags & BANKDATA::TYPE_STREAMING ) )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    if ( m_async == INVALID_HANDLE_VALUE )
+        return E_FAIL;
+
+    Metadata metadata;
+    HRESULT hr = GetMetadata( index, metadata );
+    if ( FAILED(hr) )
+        return hr;
+
+    auto& segment = m_header.Segments[HEADER::SEGIDX_ENTRYWAVEDATA];
+    if ( ( uint64_t( metadata.offsetBytes ) + metadata.lengthBytes ) > segment.dwLength )
+    {
+        return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+    }
+
+    params.async = m_async;
+    params.offsetBytes = segment.dwOffset + metadata.offsetBytes;
+    params.lengthBytes = metadata.lengthBytes;
+
+    return S_OK;
+}
+
+
 bool WaveBankReader::Impl::UpdatePrepared()
 {
     if ( m_prepared )
         return true;
 
-    if ( m_async == INVALID_HANDLE_VALUE )
+    if ( m_async == INVALID_HANDLE_VALUE || !m_requests )
         return false;
 
-    if ( m_request.hEvent != 0 )
+    while ( m_requestsDone < m_requestCount )
     {
+        auto& request = m_requests[ m_requestsDone ];
 
 #if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
         DWORD bytes;
-        BOOL result = GetOverlappedResultEx( m_async, &m_request, &bytes, 0, FALSE );
+        BOOL result = GetOverlappedResultEx( m_async, &request, &bytes, 0, FALSE );
 #else
-        bool result = HasOverlappedIoCompleted( &m_request );
+        bool result = HasOverlappedIoCompleted( &request );
 #endif
-        if ( result )
-        {
-            m_prepared = true;
+        if ( !result )
+            break;
 
-            memset( &m_request, 0, sizeof(OVERLAPPED) );
-        }
+        ++m_requestsDone;
+    }
+
+    if ( m_requestsDone >= m_requestCount )
+    {
+        CompleteRequests( false );
+
+        m_prepared = true;
     }
   
     return m_prepared;
 }
 
 
+void WaveBankReader::Impl::WaitOnPrepare()
+{
+    if ( m_prepared )
+        return;
+
+    if ( m_async == INVALID_HANDLE_VALUE || !m_requests )
+        return;
+
+    CompleteRequests( false );
+
+    m_prepared = true;
+}
+
+
+float WaveBankReader::Impl::PrepareProgress()
+{
+    if ( UpdatePrepared() )
+        return 1.f;
+
+    if ( !m_requestCount )
+        return 0.f;
+
+    return float( m_requestsDone ) / float( m_requestCount );
+}
+
+
 
 //--------------------------------------------------------------------------------------
 WaveBankReader::WaveBankReader() :
@@ -1277,9 +1526,9 @@ WaveBankReader::~WaveBankReader()
 
 
 _Use_decl_annotations_
-HRESULT WaveBankReader::Open( const wchar_t* szFileName )
+HRESULT WaveBankReader::Open( const wchar_t* szFileName, bool memoryMapped )
 {
-    return pImpl->Open( szFileName );
+    return pImpl->Open( szFileName, memoryMapped );
 }
 
 
@@ -1307,15 +1556,19 @@ bool WaveBankReader::IsPrepared()
 
 void WaveBankReader::WaitOnPrepare()
 {
-    if ( pImpl->m_prepared )
-        return;
+    pImpl->WaitOnPrepare();
+}
 
-    if ( pImpl->m_request.hEvent != 0 )
-    {
-        WaitForSingleObjectEx( pImpl->m_request.hEvent, INFINITE, FALSE );
 
-        pImpl->UpdatePrepared();
-    }
+float WaveBankReader::PrepareProgress()
+{
+    return pImpl->PrepareProgress();
+}
+
+
+bool WaveBankReader::IsMemoryMapped() const
+{
+    return pImpl->m_mappedView != nullptr;
 }
 
 
@@ -1385,6 +1638,13 @@ HRESULT WaveBankReader::GetMetadata( uint32_t index, Metadata& metadata ) const
 }
 
 
+_Use_decl_annotations_
+HRESULT WaveBankReader::GetStreamingParameters( uint32_t index, StreamingParameters& params ) const
+{
+    return pImpl->GetStreamingParameters( index, params );
+}
+
+
 HANDLE WaveBankReader::GetAsyncHandle() const
 {
     return ( pImpl->m_data.dwFlags & BANKDATA::TYPE_STREAMING ) ? pImpl->m_async : INVALID_HANDLE_VALUE;
@@ -33,12 +33,15 @@ namespace DirectX
         WaveBankReader();
         ~WaveBankReader();
 
-        HRESULT Open( _In_z_ const wchar_t* szFileName );
+        HRESULT Open( _In_z_ const wchar_t* szFileName, bool memoryMapped = false );
 
         uint32_t Find( _In_z_ const char* name ) const;
 
         bool IsPrepared();
         void WaitOnPrepare();
+        float PrepareProgress();
+
+        bool IsMemoryMapped() const;
 
         bool HasNames() const;
         bool IsStreamingBank() const;
@@ -71,6 +74,14 @@ namespace DirectX
         };
         HRESULT GetMetadata( _In_ uint32_t index, _Out_ Metadata& metadata ) const;
 
+        struct StreamingParameters
+        {
+            HANDLE      async;          // Unbuffered overlapped file handle, shared by all readers of the bank
+            uint32_t    offsetBytes;    // Offset of the wave data from the start of the file
+            uint32_t    lengthBytes;
+        };
+        HRESULT GetStreamingParameters( _In_ uint32_t index, _Out_ StreamingParameters& params ) const;
+
     private:
         // Private implementation.
         class Impl;
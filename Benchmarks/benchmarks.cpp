@@ -0,0 +1,999 @@
+//--------------------------------------------------------------------------------------
+// File: benchmarks.cpp
+//
+// Command-line tool that times the DirectX Tool Kit hot paths (sprite batching, text,
+// model drawing, effect constant updates, texture loading, audio engine updates, and
+// the SimpleMath batch operations) on a WARP device with an offscreen render target,
+// so the numbers do not depend on the GPU or display of the machine running it.
+//
+// Usage: benchmarks [/samples:<n>] [<output.json>]
+//
+// Results are written as JSON to the output file, or to stdout. Each case reports the
+// min, median, and mean time of its samples in milliseconds. All inputs come from fixed
+// seeds, so runs on the same machine are directly comparable.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <objbase.h>
+
+#include <d3d11.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <wrl/client.h>
+
+#include "Audio.h"
+#include "CommonStates.h"
+#include "DDSTextureLoader.h"
+#include "Effects.h"
+#include "Model.h"
+#include "SimpleMath.h"
+#include "SpriteBatch.h"
+#include "SpriteFont.h"
+#include "VertexTypes.h"
+#include "WICTextureLoader.h"
+
+#include "dds.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    const UINT RENDER_TARGET_WIDTH = 1280;
+    const UINT RENDER_TARGET_HEIGHT = 720;
+
+    const int WARMUP_SAMPLES = 2;
+    const int DEFAULT_SAMPLES = 20;
+
+    inline void ThrowIfFailed(HRESULT hr)
+    {
+        if (FAILED(hr))
+        {
+            throw std::exception();
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Repeatable pseudo-random numbers, so every run draws the same scene.
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : mState(seed) { }
+
+        uint32_t Next()
+        {
+            mState = mState * 1664525u + 1013904223u;
+            return mState;
+        }
+
+        // Uniform in [0, 1)
+        float NextFloat()
+        {
+            return float(Next() >> 8) * (1.f / 16777216.f);
+        }
+
+        float NextFloat(float minValue, float maxValue)
+        {
+            return minValue + NextFloat() * (maxValue - minValue);
+        }
+
+    private:
+        uint32_t mState;
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // Stops the optimizer from discarding results that are never read.
+    volatile float g_sink = 0.f;
+
+    inline void Consume(float value)
+    {
+        g_sink = g_sink + value;
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Times a case over a number of samples and collects the results for the report.
+    // Samples time the CPU cost of submitting the work. The GPU is drained after each
+    // one, outside the timing, so queued work never spills into the next sample.
+    class Benchmarks
+    {
+    public:
+        Benchmarks(ID3D11DeviceContext* context, ID3D11Query* query, int samples) :
+            mContext(context),
+            mQuery(query),
+            mSamples(samples)
+        {
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            mTicksToMs = 1000.0 / double(frequency.QuadPart);
+        }
+
+        // items is the number of operations in one sample, and bytes the amount of data
+        // they process (0 if not meaningful), used to report throughput.
+        template<typename Work>
+        void Run(const std::string& name, size_t items, size_t bytes, Work work, int samples = 0)
+        {
+            if (samples <= 0)
+                samples = mSamples;
+
+            for (int j = 0; j < WARMUP_SAMPLES; ++j)
+            {
+                work();
+                WaitForGPU();
+            }
+
+            std::vector<double> times;
+            times.reserve(samples);
+
+            for (int j = 0; j < samples; ++j)
+            {
+                LARGE_INTEGER start, end;
+                QueryPerformanceCounter(&start);
+
+                work();
+
+                QueryPerformanceCounter(&end);
+                WaitForGPU();
+
+                times.push_back(double(end.QuadPart - start.QuadPart) * mTicksToMs);
+            }
+
+            std::sort(times.begin(), times.end());
+
+            Result result = {};
+            result.name = name;
+            result.items = items;
+            result.bytes = bytes;
+            result.samples = samples;
+            result.minMs = times.front();
+            result.medianMs = (samples & 1) ? times[samples / 2] : (times[samples / 2 - 1] + times[samples / 2]) * 0.5;
+
+            double total = 0;
+            for (auto it = times.cbegin(); it != times.cend(); ++it)
+            {
+                total += *it;
+            }
+            result.meanMs = total / double(samples);
+
+            mResults.push_back(result);
+
+            fwprintf(stderr, L"%-48S %10.3f ms\n", name.c_str(), result.medianMs);
+        }
+
+        void Skip(const std::string& name, const char* reason)
+        {
+            Result result = {};
+            result.name = name;
+            result.skipped = reason;
+
+            mResults.push_back(result);
+
+            fwprintf(stderr, L"%-48S skipped (%S)\n", name.c_str(), reason);
+        }
+
+        void Write(FILE* file, const char* device) const
+        {
+            fprintf(file, "{\n  \"device\": \"%s\",\n  \"warmup\": %d,\n  \"results\": [\n", device, WARMUP_SAMPLES);
+
+            for (size_t j = 0; j < mResults.size(); ++j)
+            {
+                auto& result = mResults[j];
+
+                fprintf(file, "    { \"name\": \"%s\"", result.name.c_str());
+
+                if (result.skipped)
+                {
+                    fprintf(file, ", \"skipped\": \"%s\"", result.skipped);
+                }
+                else
+                {
+                    fprintf(file, ", \"items\": %Iu, \"samples\": %d, \"min_ms\": %.6f, \"median_ms\": %.6f, \"mean_ms\": %.6f",
+                            result.items, result.samples, result.minMs, result.medianMs, result.meanMs);
+
+                    if (result.medianMs > 0)
+                    {
+                        fprintf(file, ", \"items_per_sec\": %.1f", double(result.items) * 1000.0 / result.medianMs);
+
+                        if (result.bytes > 0)
+                        {
+                            fprintf(file, ", \"mb_per_sec\": %.3f", double(result.bytes) * 1000.0 / (result.medianMs * 1024.0 * 1024.0));
+                        }
+                    }
+                }
+
+                fprintf(file, " }%s\n", (j + 1 < mResults.size()) ? "," : "");
+            }
+
+            fprintf(file, "  ]\n}\n");
+        }
+
+    private:
+        struct Result
+        {
+            std::string name;
+            const char* skipped;
+            size_t items;
+            size_t bytes;
+            int samples;
+            double minMs;
+            double medianMs;
+            double meanMs;
+        };
+
+        void WaitForGPU()
+        {
+            mContext->End(mQuery);
+            mContext->Flush();
+
+            BOOL done = FALSE;
+            while (mContext->GetData(mQuery, &done, sizeof(done), 0) == S_FALSE)
+            {
+                SwitchToThread();
+            }
+        }
+
+        ID3D11DeviceContext* mContext;
+        ID3D11Query* mQuery;
+        int mSamples;
+        double mTicksToMs;
+        std::vector<Result> mResults;
+    };
+
+
+    std::string MakeName(const char* format, ...)
+    {
+        char name[128];
+
+        va_list args;
+        va_start(args, format);
+        vsprintf_s(name, format, args);
+        va_end(args);
+
+        return name;
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Generated resources
+    ComPtr<ID3D11ShaderResourceView> CreateTexture(_In_ ID3D11Device* device, UINT width, UINT height, uint32_t color, uint32_t stripe)
+    {
+        std::vector<uint32_t> pixels(width * height);
+        for (UINT y = 0; y < height; ++y)
+        {
+            for (UINT x = 0; x < width; ++x)
+            {
+                pixels[y * width + x] = ((x ^ y) & 4) ? stripe : color;
+            }
+        }
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        D3D11_SUBRESOURCE_DATA initData = { &pixels.front(), UINT(width * sizeof(uint32_t)), 0 };
+
+        ComPtr<ID3D11Texture2D> texture;
+        ThrowIfFailed(device->CreateTexture2D(&desc, &initData, &texture));
+
+        ComPtr<ID3D11ShaderResourceView> textureView;
+        ThrowIfFailed(device->CreateShaderResourceView(texture.Get(), nullptr, &textureView));
+
+        return textureView;
+    }
+
+
+    // A font with a box glyph for each printable ASCII character, laid out on a grid.
+    std::unique_ptr<SpriteFont> CreateGlyphFont(_In_ ID3D11Device* device)
+    {
+        const UINT CELL = 16;
+        const UINT COLUMNS = 16;
+        const wchar_t FIRST = L' ';
+        const wchar_t LAST = L'~';
+
+        UINT rows = (LAST - FIRST + COLUMNS) / COLUMNS;
+
+        auto texture = CreateTexture(device, CELL * COLUMNS, CELL * rows, 0xffffffff, 0x00000000);
+
+        std::vector<SpriteFont::Glyph> glyphs;
+        for (wchar_t ch = FIRST; ch <= LAST; ++ch)
+        {
+            UINT index = ch - FIRST;
+
+            SpriteFont::Glyph glyph = {};
+            glyph.Character = ch;
+            glyph.Subrect.left = LONG((index % COLUMNS) * CELL);
+            glyph.Subrect.top = LONG((index / COLUMNS) * CELL);
+            glyph.Subrect.right = glyph.Subrect.left + LONG(CELL - 4 + (index % 5));
+            glyph.Subrect.bottom = glyph.Subrect.top + LONG(CELL);
+            glyph.XOffset = 1.f;
+            glyph.XAdvance = 1.f;
+
+            glyphs.push_back(glyph);
+        }
+
+        return std::unique_ptr<SpriteFont>(new SpriteFont(texture.Get(), &glyphs.front(), glyphs.size(), float(CELL + 2)));
+    }
+
+
+    // One cube vertex and index buffer, shared by every part of the generated models.
+    void CreateCube(_In_ ID3D11Device* device, _Outptr_ ID3D11Buffer** vertexBuffer, _Outptr_ ID3D11Buffer** indexBuffer)
+    {
+        static const XMVECTORF32 faceNormals[6] =
+        {
+            { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 },
+        };
+
+        static const XMVECTORF32 textureCoordinates[4] =
+        {
+            { 1, 0 }, { 1, 1 }, { 0, 1 }, { 0, 0 },
+        };
+
+        std::vector<VertexPositionNormalTexture> vertices;
+        std::vector<uint16_t> indices;
+
+        for (int j = 0; j < 6; ++j)
+        {
+            XMVECTOR normal = faceNormals[j];
+
+            // Two vectors perpendicular to the face normal and each other.
+            XMVECTOR basis = (j >= 4) ? g_XMIdentityR2 : g_XMIdentityR1;
+            XMVECTOR side1 = XMVector3Cross(normal, basis);
+            XMVECTOR side2 = XMVector3Cross(normal, side1);
+
+            uint16_t base = uint16_t(vertices.size());
+            indices.push_back(uint16_t(base + 0));
+            indices.push_back(uint16_t(base + 1));
+            indices.push_back(uint16_t(base + 2));
+            indices.push_back(uint16_t(base + 0));
+            indices.push_back(uint16_t(base + 2));
+            indices.push_back(uint16_t(base + 3));
+
+            vertices.push_back(VertexPositionNormalTexture((normal - side1 - side2) * 0.5f, normal, textureCoordinates[0]));
+            vertices.push_back(VertexPositionNormalTexture((normal - side1 + side2) * 0.5f, normal, textureCoordinates[1]));
+            vertices.push_back(VertexPositionNormalTexture((normal + side1 + side2) * 0.5f, normal, textureCoordinates[2]));
+            vertices.push_back(VertexPositionNormalTexture((normal + side1 - side2) * 0.5f, normal, textureCoordinates[3]));
+        }
+
+        D3D11_BUFFER_DESC desc = {};
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+
+        desc.ByteWidth = UINT(vertices.size() * sizeof(VertexPositionNormalTexture));
+        desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+        D3D11_SUBRESOURCE_DATA vertexData = { &vertices.front(), 0, 0 };
+        ThrowIfFailed(device->CreateBuffer(&desc, &vertexData, vertexBuffer));
+
+        desc.ByteWidth = UINT(indices.size() * sizeof(uint16_t));
+        desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+        D3D11_SUBRESOURCE_DATA indexData = { &indices.front(), 0, 0 };
+        ThrowIfFailed(device->CreateBuffer(&desc, &indexData, indexBuffer));
+    }
+
+
+    // A model of partCount cubes, sixteen parts to a mesh, each part with its own BasicEffect
+    // as a loader would give a model with that many materials.
+    std::unique_ptr<Model> CreateModel(_In_ ID3D11Device* device, size_t partCount)
+    {
+        const size_t PARTS_PER_MESH = 16;
+
+        ComPtr<ID3D11Buffer> vertexBuffer;
+        ComPtr<ID3D11Buffer> indexBuffer;
+        CreateCube(device, &vertexBuffer, &indexBuffer);
+
+        auto vbDecl = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(VertexPositionNormalTexture::InputElements,
+                                                                              VertexPositionNormalTexture::InputElements + VertexPositionNormalTexture::InputElementCount);
+
+        Random random(59);
+
+        std::unique_ptr<Model> model(new Model());
+        model->name = L"Cubes";
+
+        std::shared_ptr<ModelMesh> mesh;
+        ComPtr<ID3D11InputLayout> inputLayout;
+
+        for (size_t j = 0; j < partCount; ++j)
+        {
+            if (!(j % PARTS_PER_MESH))
+            {
+                mesh = std::make_shared<ModelMesh>();
+                mesh->name = L"Mesh";
+                mesh->ccw = false;
+                mesh->pmalpha = true;
+                mesh->boundingSphere.Radius = 0.87f;
+                mesh->boundingBox.Extents = XMFLOAT3(0.5f, 0.5f, 0.5f);
+                model->meshes.push_back(mesh);
+            }
+
+            auto effect = std::make_shared<BasicEffect>(device);
+            effect->EnableDefaultLighting();
+            effect->SetDiffuseColor(XMVectorSet(random.NextFloat(), random.NextFloat(), random.NextFloat(), 1.f));
+
+            std::unique_ptr<ModelMeshPart> part(new ModelMeshPart());
+            part->indexCount = 36;
+            part->startIndex = 0;
+            part->vertexOffset = 0;
+            part->vertexStride = sizeof(VertexPositionNormalTexture);
+            part->primitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+            part->indexFormat = DXGI_FORMAT_R16_UINT;
+            part->vertexBuffer = vertexBuffer;
+            part->indexBuffer = indexBuffer;
+            part->effect = effect;
+            part->vbDecl = vbDecl;
+
+            // Every part uses the same vertex shader permutation, so one layout serves them all.
+            if (!inputLayout)
+            {
+                part->CreateInputLayout(device, effect.get(), &inputLayout);
+            }
+            part->inputLayout = inputLayout;
+
+            mesh->meshParts.emplace_back(std::move(part));
+        }
+
+        return model;
+    }
+
+
+    // A 32bpp .DDS file in memory with a full mip chain.
+    std::vector<uint8_t> CreateDDS(uint32_t width, uint32_t height)
+    {
+        uint32_t mipCount = 1;
+        size_t pixelBytes = width * height * 4;
+        for (uint32_t w = width, h = height; w > 1 || h > 1; ++mipCount)
+        {
+            w = std::max<uint32_t>(w / 2, 1);
+            h = std::max<uint32_t>(h / 2, 1);
+            pixelBytes += w * h * 4;
+        }
+
+        std::vector<uint8_t> data(sizeof(uint32_t) + sizeof(DDS_HEADER) + pixelBytes);
+
+        *reinterpret_cast<uint32_t*>(&data.front()) = DDS_MAGIC;
+
+        auto header = reinterpret_cast<DDS_HEADER*>(&data.front() + sizeof(uint32_t));
+        header->size = sizeof(DDS_HEADER);
+        header->flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP | DDS_HEADER_FLAGS_PITCH;
+        header->height = height;
+        header->width = width;
+        header->pitchOrLinearSize = width * 4;
+        header->mipMapCount = mipCount;
+        header->ddspf = DDSPF_A8R8G8B8;
+        header->caps = DDS_SURFACE_FLAGS_TEXTURE | DDS_SURFACE_FLAGS_MIPMAP;
+
+        Random random(1);
+        auto pixels = &data.front() + sizeof(uint32_t) + sizeof(DDS_HEADER);
+        for (size_t j = 0; j < pixelBytes; ++j)
+        {
+            pixels[j] = uint8_t(random.Next() >> 24);
+        }
+
+        return data;
+    }
+
+
+    // A 32bpp bottom-up .BMP file in memory, decoded and converted through WIC.
+    std::vector<uint8_t> CreateBMP(uint32_t width, uint32_t height)
+    {
+        size_t pixelBytes = width * height * 4;
+
+        std::vector<uint8_t> data(sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + pixelBytes);
+
+        auto file = reinterpret_cast<BITMAPFILEHEADER*>(&data.front());
+        file->bfType = 0x4D42; // "BM"
+        file->bfSize = DWORD(data.size());
+        file->bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+
+        auto info = reinterpret_cast<BITMAPINFOHEADER*>(&data.front() + sizeof(BITMAPFILEHEADER));
+        info->biSize = sizeof(BITMAPINFOHEADER);
+        info->biWidth = LONG(width);
+        info->biHeight = LONG(height);
+        info->biPlanes = 1;
+        info->biBitCount = 32;
+        info->biCompression = BI_RGB;
+        info->biSizeImage = DWORD(pixelBytes);
+
+        Random random(2);
+        auto pixels = &data.front() + file->bfOffBits;
+        for (size_t j = 0; j < pixelBytes; ++j)
+        {
+            pixels[j] = uint8_t(random.Next() >> 24);
+        }
+
+        return data;
+    }
+
+
+    // Ten seconds of a 16-bit mono tone, long enough to outlast the audio cases.
+    std::unique_ptr<SoundEffect> CreateSoundEffect(_In_ AudioEngine* engine)
+    {
+        const uint32_t SAMPLE_RATE = 44100;
+        const size_t SAMPLE_COUNT = SAMPLE_RATE * 10;
+        const size_t AUDIO_BYTES = SAMPLE_COUNT * sizeof(int16_t);
+
+        std::unique_ptr<uint8_t[]> wavData(new uint8_t[sizeof(WAVEFORMATEX) + AUDIO_BYTES]);
+
+        auto wfx = reinterpret_cast<WAVEFORMATEX*>(wavData.get());
+        wfx->wFormatTag = WAVE_FORMAT_PCM;
+        wfx->nChannels = 1;
+        wfx->nSamplesPerSec = SAMPLE_RATE;
+        wfx->nAvgBytesPerSec = SAMPLE_RATE * sizeof(int16_t);
+        wfx->nBlockAlign = sizeof(int16_t);
+        wfx->wBitsPerSample = 16;
+        wfx->cbSize = 0;
+
+        auto startAudio = wavData.get() + sizeof(WAVEFORMATEX);
+
+        auto samples = reinterpret_cast<int16_t*>(startAudio);
+        for (size_t j = 0; j < SAMPLE_COUNT; ++j)
+        {
+            samples[j] = int16_t(8192.f * XMScalarSin(float(j) * XM_2PI * 440.f / float(SAMPLE_RATE)));
+        }
+
+        return std::unique_ptr<SoundEffect>(new SoundEffect(engine, wavData, wfx, startAudio, AUDIO_BYTES));
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Cases
+    void RunSpriteBatch(Benchmarks& bench, _In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context)
+    {
+        static const char* s_sortModes[] = { "Deferred", "Immediate", "Texture", "BackToFront", "FrontToBack" };
+        static const size_t s_counts[] = { 1000, 10000, 100000 };
+
+        ComPtr<ID3D11ShaderResourceView> textures[4];
+        for (size_t j = 0; j < _countof(textures); ++j)
+        {
+            textures[j] = CreateTexture(device, 64, 64, 0xff000000 | uint32_t(0x3f << (j * 8)), 0xffffffff);
+        }
+
+        SpriteBatch spriteBatch(context);
+
+        for (size_t k = 0; k < _countof(s_counts); ++k)
+        {
+            size_t count = s_counts[k];
+
+            struct Sprite
+            {
+                XMFLOAT2 position;
+                XMFLOAT2 origin;
+                float rotation;
+                float scale;
+                float depth;
+                uint32_t texture;
+            };
+
+            Random random(uint32_t(count));
+
+            std::vector<Sprite> sprites(count);
+            for (auto it = sprites.begin(); it != sprites.end(); ++it)
+            {
+                it->position = XMFLOAT2(random.NextFloat(0.f, float(RENDER_TARGET_WIDTH)), random.NextFloat(0.f, float(RENDER_TARGET_HEIGHT)));
+                it->origin = XMFLOAT2(32.f, 32.f);
+                it->rotation = random.NextFloat(0.f, XM_2PI);
+                it->scale = random.NextFloat(0.125f, 0.5f);
+                it->depth = random.NextFloat();
+                it->texture = random.Next() % uint32_t(_countof(textures));
+            }
+
+            for (int mode = SpriteSortMode_Deferred; mode <= SpriteSortMode_FrontToBack; ++mode)
+            {
+                bench.Run(MakeName("SpriteBatch/%s/%Iu", s_sortModes[mode], count), count, 0, [&]()
+                {
+                    spriteBatch.Begin(SpriteSortMode(mode));
+
+                    for (auto it = sprites.cbegin(); it != sprites.cend(); ++it)
+                    {
+                        spriteBatch.Draw(textures[it->texture].Get(), it->position, nullptr, Colors::White,
+                                         it->rotation, it->origin, it->scale, SpriteEffects_None, it->depth);
+                    }
+
+                    spriteBatch.End();
+                }, (count >= 100000) ? 5 : 0);
+            }
+        }
+    }
+
+
+    void RunSpriteFont(Benchmarks& bench, _In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context)
+    {
+        const size_t LINES = 40;
+        const size_t MEASURES = 10000;
+
+        static const wchar_t s_text[] = L"The quick brown fox jumps over the lazy dog. 0123456789 (){}[]<>!?";
+
+        auto font = CreateGlyphFont(device);
+
+        SpriteBatch spriteBatch(context);
+
+        const size_t glyphCount = (_countof(s_text) - 1) * LINES;
+
+        bench.Run("SpriteFont/DrawString", glyphCount, 0, [&]()
+        {
+            spriteBatch.Begin();
+
+            for (size_t j = 0; j < LINES; ++j)
+            {
+                font->DrawString(&spriteBatch, s_text, XMFLOAT2(0.f, float(j) * font->GetLineSpacing()));
+            }
+
+            spriteBatch.End();
+        });
+
+        bench.Run("SpriteFont/MeasureString", MEASURES, 0, [&]()
+        {
+            XMVECTOR total = XMVectorZero();
+
+            for (size_t j = 0; j < MEASURES; ++j)
+            {
+                total += font->MeasureString(s_text);
+            }
+
+            Consume(XMVectorGetX(total));
+        });
+    }
+
+
+    void RunModel(Benchmarks& bench, _In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context)
+    {
+        static const size_t s_partCounts[] = { 16, 256, 1024 };
+
+        CommonStates states(device);
+
+        XMMATRIX world = XMMatrixRotationRollPitchYaw(0.5f, 0.25f, 0.f);
+        XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(0.f, 0.f, 4.f, 1.f), g_XMZero, g_XMIdentityR1);
+        XMMATRIX projection = XMMatrixPerspectiveFovRH(XM_PIDIV4, float(RENDER_TARGET_WIDTH) / float(RENDER_TARGET_HEIGHT), 0.1f, 100.f);
+
+        for (size_t k = 0; k < _countof(s_partCounts); ++k)
+        {
+            auto model = CreateModel(device, s_partCounts[k]);
+
+            bench.Run(MakeName("Model/Draw/%Iu", s_partCounts[k]), s_partCounts[k], 0, [&]()
+            {
+                model->Draw(context, states, world, view, projection);
+            });
+        }
+    }
+
+
+    void RunBasicEffect(Benchmarks& bench, _In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context)
+    {
+        const size_t APPLIES = 10000;
+
+        BasicEffect effect(device);
+        effect.EnableDefaultLighting();
+        effect.SetView(XMMatrixLookAtRH(XMVectorSet(0.f, 0.f, 4.f, 1.f), g_XMZero, g_XMIdentityR1));
+        effect.SetProjection(XMMatrixPerspectiveFovRH(XM_PIDIV4, 16.f / 9.f, 0.1f, 100.f));
+
+        bench.Run("BasicEffect/Apply/Clean", APPLIES, 0, [&]()
+        {
+            for (size_t j = 0; j < APPLIES; ++j)
+            {
+                effect.Apply(context);
+            }
+        });
+
+        bench.Run("BasicEffect/Apply/DirtyWorld", APPLIES, 0, [&]()
+        {
+            for (size_t j = 0; j < APPLIES; ++j)
+            {
+                effect.SetWorld(XMMatrixTranslation(float(j & 15), 0.f, 0.f));
+                effect.Apply(context);
+            }
+        });
+    }
+
+
+    void RunTextureLoaders(Benchmarks& bench, _In_ ID3D11Device* device)
+    {
+        const size_t LOADS = 20;
+
+        auto dds = CreateDDS(1024, 1024);
+
+        bench.Run("DDSTextureLoader/FromMemory/1024x1024", LOADS, dds.size() * LOADS, [&]()
+        {
+            for (size_t j = 0; j < LOADS; ++j)
+            {
+                ComPtr<ID3D11ShaderResourceView> textureView;
+                ThrowIfFailed(CreateDDSTextureFromMemory(device, &dds.front(), dds.size(), nullptr, &textureView));
+            }
+        });
+
+        auto bmp = CreateBMP(1024, 1024);
+
+        bench.Run("WICTextureLoader/FromMemory/1024x1024", LOADS, bmp.size() * LOADS, [&]()
+        {
+            for (size_t j = 0; j < LOADS; ++j)
+            {
+                ComPtr<ID3D11ShaderResourceView> textureView;
+                ThrowIfFailed(CreateWICTextureFromMemory(device, &bmp.front(), bmp.size(), nullptr, &textureView));
+            }
+        });
+    }
+
+
+    void RunAudioEngine(Benchmarks& bench)
+    {
+        const size_t UPDATES = 100;
+
+        static const size_t s_oneShotCounts[] = { 0, 16, 64 };
+
+        for (size_t k = 0; k < _countof(s_oneShotCounts); ++k)
+        {
+            size_t oneShots = s_oneShotCounts[k];
+
+            auto name = MakeName("AudioEngine/Update/%Iu", oneShots);
+
+            std::unique_ptr<AudioEngine> engine(new AudioEngine());
+            if (!engine->IsAudioDevicePresent())
+            {
+                bench.Skip(name, "no audio device");
+                continue;
+            }
+
+            auto effect = CreateSoundEffect(engine.get());
+
+            for (size_t j = 0; j < oneShots; ++j)
+            {
+                effect->Play(0.f, 0.f, 0.f);
+            }
+
+            bench.Run(name, UPDATES, 0, [&]()
+            {
+                for (size_t j = 0; j < UPDATES; ++j)
+                {
+                    engine->Update();
+                }
+            });
+
+            // The one-shots are still playing, so the engine (which destroys their voices)
+            // must go before the wave data they read from.
+            engine.reset();
+        }
+    }
+
+
+    void RunSimpleMath(Benchmarks& bench)
+    {
+        const size_t VECTORS = 100000;
+        const size_t MATRICES = 10000;
+        const size_t TRANSFORMS = 10000;
+
+        Random random(3);
+
+        std::vector<Vector3> v1(VECTORS), v2(VECTORS), vresult(VECTORS);
+        for (size_t j = 0; j < VECTORS; ++j)
+        {
+            v1[j] = Vector3(random.NextFloat(-1.f, 1.f), random.NextFloat(-1.f, 1.f), random.NextFloat(-1.f, 1.f));
+            v2[j] = Vector3(random.NextFloat(-1.f, 1.f), random.NextFloat(-1.f, 1.f), random.NextFloat(-1.f, 1.f));
+        }
+
+        Matrix m = Matrix::CreateFromYawPitchRoll(0.1f, 0.2f, 0.3f) * Matrix::CreateTranslation(1.f, 2.f, 3.f);
+
+        bench.Run("SimpleMath/Vector3/Transform/Scalar", VECTORS, 0, [&]()
+        {
+            for (size_t j = 0; j < VECTORS; ++j)
+            {
+                vresult[j] = Vector3::Transform(v1[j], m);
+            }
+            Consume(vresult.back().x);
+        });
+
+        bench.Run("SimpleMath/Vector3/Transform/Array", VECTORS, 0, [&]()
+        {
+            Vector3::Transform(&v1.front(), VECTORS, m, &vresult.front());
+            Consume(vresult.back().x);
+        });
+
+        bench.Run("SimpleMath/Vector3/Lerp/Array", VECTORS, 0, [&]()
+        {
+            Vector3::Lerp(&v1.front(), &v2.front(), VECTORS, 0.25f, &vresult.front());
+            Consume(vresult.back().x);
+        });
+
+        Vector3Array a1(&v1.front(), VECTORS);
+        Vector3Array a2(&v2.front(), VECTORS);
+        Vector3Array aresult(VECTORS);
+
+        bench.Run("SimpleMath/Vector3Array/Transform", VECTORS, 0, [&]()
+        {
+            Vector3Array::Transform(a1, m, aresult);
+            Consume(aresult.X()[0]);
+        });
+
+        bench.Run("SimpleMath/Vector3Array/Lerp", VECTORS, 0, [&]()
+        {
+            Vector3Array::Lerp(a1, a2, 0.25f, aresult);
+            Consume(aresult.X()[0]);
+        });
+
+        bench.Run("SimpleMath/Vector3Array/AddScaled", VECTORS, 0, [&]()
+        {
+            aresult.AddScaled(a2, 1.f / 60.f);
+            Consume(aresult.X()[0]);
+        });
+
+        std::vector<Matrix> m1(MATRICES), m2(MATRICES), mresult(MATRICES);
+        for (size_t j = 0; j < MATRICES; ++j)
+        {
+            m1[j] = Matrix::CreateFromYawPitchRoll(random.NextFloat(0.f, XM_2PI), random.NextFloat(0.f, XM_2PI), random.NextFloat(0.f, XM_2PI));
+            m2[j] = Matrix::CreateTranslation(v1[j]);
+        }
+
+        bench.Run("SimpleMath/Matrix/Multiply/Array", MATRICES, 0, [&]()
+        {
+            Matrix::Multiply(&m1.front(), &m2.front(), MATRICES, &mresult.front());
+            Consume(mresult.back()._41);
+        });
+
+        std::vector<Quaternion> q1(TRANSFORMS), q2(TRANSFORMS), qresult(TRANSFORMS);
+        TransformArray t1(TRANSFORMS), t2(TRANSFORMS), tresult(TRANSFORMS);
+        for (size_t j = 0; j < TRANSFORMS; ++j)
+        {
+            q1[j] = Quaternion::CreateFromYawPitchRoll(random.NextFloat(0.f, XM_2PI), random.NextFloat(0.f, XM_2PI), random.NextFloat(0.f, XM_2PI));
+            q2[j] = Quaternion::CreateFromYawPitchRoll(random.NextFloat(0.f, XM_2PI), random.NextFloat(0.f, XM_2PI), random.NextFloat(0.f, XM_2PI));
+
+            t1.Set(j, Vector3::One, q1[j], v1[j]);
+            t2.Set(j, Vector3::One, q2[j], v2[j]);
+        }
+
+        bench.Run("SimpleMath/Quaternion/Lerp/Array", TRANSFORMS, 0, [&]()
+        {
+            Quaternion::Lerp(&q1.front(), &q2.front(), TRANSFORMS, 0.25f, &qresult.front());
+            Consume(qresult.back().w);
+        });
+
+        bench.Run("SimpleMath/Quaternion/Slerp/Array", TRANSFORMS, 0, [&]()
+        {
+            Quaternion::Slerp(&q1.front(), &q2.front(), TRANSFORMS, 0.25f, &qresult.front());
+            Consume(qresult.back().w);
+        });
+
+        bench.Run("SimpleMath/TransformArray/Slerp", TRANSFORMS, 0, [&]()
+        {
+            TransformArray::Slerp(t1, t2, 0.25f, tresult);
+            Consume(tresult.GetTranslation(0).x);
+        });
+
+        bench.Run("SimpleMath/TransformArray/GetMatrices", TRANSFORMS, 0, [&]()
+        {
+            tresult.GetMatrices(&mresult.front(), TRANSFORMS);
+            Consume(mresult.back()._41);
+        });
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    int samples = DEFAULT_SAMPLES;
+    const wchar_t* outputFile = nullptr;
+
+    for (int iArg = 1; iArg < argc; ++iArg)
+    {
+        const wchar_t* pArg = argv[iArg];
+
+        if (!_wcsnicmp(pArg, L"/samples:", 9) || !_wcsnicmp(pArg, L"-samples:", 9))
+        {
+            samples = _wtoi(pArg + 9);
+            if (samples <= 0)
+            {
+                wprintf(L"Invalid value for samples: %ls\n", pArg + 9);
+                return 1;
+            }
+        }
+        else if (('/' == pArg[0]) || ('-' == pArg[0]))
+        {
+            wprintf(L"Usage: benchmarks [/samples:<n>] [<output.json>]\n");
+            return 1;
+        }
+        else
+        {
+            outputFile = pArg;
+        }
+    }
+
+    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(hr))
+    {
+        wprintf(L"Failed to initialize COM (%08X)\n", hr);
+        return 1;
+    }
+
+    int nReturn = 0;
+
+    try
+    {
+        ComPtr<ID3D11Device> device;
+        ComPtr<ID3D11DeviceContext> context;
+        ThrowIfFailed(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION,
+                                        &device, nullptr, &context));
+
+        CD3D11_TEXTURE2D_DESC rtDesc(DXGI_FORMAT_B8G8R8A8_UNORM, RENDER_TARGET_WIDTH, RENDER_TARGET_HEIGHT, 1, 1, D3D11_BIND_RENDER_TARGET);
+
+        ComPtr<ID3D11Texture2D> renderTarget;
+        ThrowIfFailed(device->CreateTexture2D(&rtDesc, nullptr, &renderTarget));
+
+        ComPtr<ID3D11RenderTargetView> renderTargetView;
+        ThrowIfFailed(device->CreateRenderTargetView(renderTarget.Get(), nullptr, &renderTargetView));
+
+        context->OMSetRenderTargets(1, renderTargetView.GetAddressOf(), nullptr);
+
+        CD3D11_VIEWPORT viewport(0.f, 0.f, float(RENDER_TARGET_WIDTH), float(RENDER_TARGET_HEIGHT));
+        context->RSSetViewports(1, &viewport);
+
+        CD3D11_QUERY_DESC queryDesc(D3D11_QUERY_EVENT);
+
+        ComPtr<ID3D11Query> query;
+        ThrowIfFailed(device->CreateQuery(&queryDesc, &query));
+
+        Benchmarks bench(context.Get(), query.Get(), samples);
+
+        RunSpriteBatch(bench, device.Get(), context.Get());
+        RunSpriteFont(bench, device.Get(), context.Get());
+        RunModel(bench, device.Get(), context.Get());
+        RunBasicEffect(bench, device.Get(), context.Get());
+        RunTextureLoaders(bench, device.Get());
+        RunAudioEngine(bench);
+        RunSimpleMath(bench);
+
+        if (outputFile)
+        {
+            FILE* file = nullptr;
+            if (_wfopen_s(&file, outputFile, L"wt") || !file)
+            {
+                wprintf(L"Failed to open %ls for writing\n", outputFile);
+                nReturn = 1;
+            }
+            else
+            {
+                bench.Write(file, "WARP");
+                fclose(file);
+            }
+        }
+        else
+        {
+            bench.Write(stdout, "WARP");
+        }
+    }
+    catch (std::exception&)
+    {
+        wprintf(L"Benchmark failed\n");
+        nReturn = 1;
+    }
+
+    CoUninitialize();
+
+    return nReturn;
+}
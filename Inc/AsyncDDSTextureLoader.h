@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------
+// File: AsyncDDSTextureLoader.h
+//
+// Background loading of DDS textures, using a small pool of worker threads and the
+// free-threaded device
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "DDSTextureLoader.h"
+
+// VS 2010/2012 do not support =default =delete
+#ifndef DIRECTX_CTOR_DEFAULT
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#define DIRECTX_CTOR_DEFAULT {}
+#define DIRECTX_CTOR_DELETE ;
+#else
+#define DIRECTX_CTOR_DEFAULT =default;
+#define DIRECTX_CTOR_DELETE =delete;
+#endif
+#endif
+
+#include <functional>
+#include <memory>
+
+// VS 2010 doesn't support explicit calling convention for std::function
+#ifndef DIRECTX_STD_CALLCONV
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+#define DIRECTX_STD_CALLCONV
+#else
+#define DIRECTX_STD_CALLCONV __cdecl
+#endif
+#endif
+
+
+namespace DirectX
+{
+    // Files are read with overlapped I/O and created on a pool of background worker threads, using the
+    // free-threaded device. No device context is used, so mipmaps cannot be auto-generated. Requests are
+    // serviced in priority order (highest first) and can be cancelled.
+    enum DDS_LOAD_STATUS
+    {
+        DDS_LOAD_PENDING   = 0,
+        DDS_LOAD_LOADING   = 1,
+        DDS_LOAD_COMPLETE  = 2,
+        DDS_LOAD_FAILED    = 3,
+        DDS_LOAD_CANCELLED = 4,
+    };
+
+    class AsyncDDSTextureLoader
+    {
+    public:
+        // Invoked once per request on whichever thread completes it, usually a worker. Cancelled requests report E_ABORT.
+        typedef std::function<void DIRECTX_STD_CALLCONV(HRESULT hr, _In_opt_ ID3D11Resource* texture, _In_opt_ ID3D11ShaderResourceView* textureView, DDS_ALPHA_MODE alphaMode)> Callback;
+
+        // Opaque ticket for a queued load, which stays valid after the loader is destroyed.
+        class Request;
+
+        typedef std::shared_ptr<Request> RequestHandle;
+
+        explicit AsyncDDSTextureLoader(_In_ ID3D11Device* device, size_t workerCount = 2);
+        AsyncDDSTextureLoader(AsyncDDSTextureLoader&& moveFrom);
+        AsyncDDSTextureLoader& operator= (AsyncDDSTextureLoader&& moveFrom);
+        virtual ~AsyncDDSTextureLoader();
+
+        RequestHandle __cdecl Load(_In_z_ const wchar_t* szFileName, _In_opt_ Callback callback = nullptr, int priority = 0);
+
+        RequestHandle __cdecl LoadEx(_In_z_ const wchar_t* szFileName,
+                                     _In_ size_t maxsize,
+                                     _In_ D3D11_USAGE usage,
+                                     _In_ unsigned int bindFlags,
+                                     _In_ unsigned int cpuAccessFlags,
+                                     _In_ unsigned int miscFlags,
+                                     _In_ bool forceSRGB,
+                                     _In_opt_ Callback callback = nullptr,
+                                     int priority = 0);
+
+        // Requests that are still queued are cancelled immediately. Those already loading stop at the next read.
+        void __cdecl Cancel(_In_ RequestHandle const& request);
+        void __cdecl CancelAll();
+
+        static DDS_LOAD_STATUS __cdecl GetStatus(_In_ RequestHandle const& request);
+
+        // Blocks until the request has finished. Returns false on timeout.
+        static bool __cdecl Wait(_In_ RequestHandle const& request, unsigned long timeoutMilliseconds = 0xFFFFFFFF);
+
+        // Returns E_PENDING until the request has finished, then the load result.
+        static HRESULT __cdecl GetResult(_In_ RequestHandle const& request,
+                                         _Outptr_opt_ ID3D11Resource** texture,
+                                         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
+                                         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr);
+
+        size_t __cdecl GetPendingCount() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        AsyncDDSTextureLoader(AsyncDDSTextureLoader const&) DIRECTX_CTOR_DELETE
+        AsyncDDSTextureLoader& operator= (AsyncDDSTextureLoader const&) DIRECTX_CTOR_DELETE
+    };
+}
@@ -100,18 +100,25 @@ namespace DirectX
     #endif
 
     class SoundEffectInstance;
+    class SoundStreamInstance;
+    class DynamicSoundEffectInstance;
+    class WaveBankReader;
+    struct AudioListener;
+    struct AudioEmitter;
 
     //----------------------------------------------------------------------------------
     struct AudioStatistics
     {
         size_t  playingOneShots;        // Number of one-shot sounds currently playing
         size_t  playingInstances;       // Number of sound effect instances currently playing
+        size_t  virtualInstances;       // Number of sound effect instances playing without a voice (see SetMaxAudibleInstances)
         size_t  allocatedInstances;     // Number of SoundEffectInstance allocated
         size_t  allocatedVoices;        // Number of XAudio2 voices allocated (standard, 3D, one-shots, and idle one-shots) 
         size_t  allocatedVoices3d;      // Number of XAudio2 voices allocated for 3D
         size_t  allocatedVoicesOneShot; // Number of XAudio2 voices allocated for one-shot sounds
         size_t  allocatedVoicesIdle;    // Number of XAudio2 voices allocated for one-shot sounds but not currently in use
         size_t  audioBytes;             // Total wave data (in bytes) in SoundEffects and in-memory WaveBanks
+        size_t  streamingBytes;         // Total read buffer memory (in bytes) held by SoundStreamInstances
 #if defined(_XBOX_ONE) && defined(_TITLE)
         size_t  xmaAudioBytes;          // Total wave data (in bytes) in SoundEffects and in-memory WaveBanks allocated with ApuAlloc
 #endif
@@ -145,6 +152,19 @@ namespace DirectX
             // Contribute to statistics request
     };
 
+    //----------------------------------------------------------------------------------
+    class IVirtualVoice
+    {
+    public:
+        virtual bool __cdecl GetAudibility( _Out_ int& priority, _Out_ float& audibility ) = 0;
+            // Returns false if no voice is currently needed (i.e. stopped)
+
+        virtual bool __cdecl IsVirtual() const = 0;
+
+        virtual void __cdecl SetVirtual( bool isvirtual ) = 0;
+            // Releases the source voice while tracking the play position, or reacquires a voice and resumes from it
+    };
+
     //----------------------------------------------------------------------------------
     enum AUDIO_ENGINE_FLAGS
     {
@@ -157,6 +177,8 @@ namespace DirectX
         AudioEngine_Debug               = 0x10000,
         AudioEngine_ThrowOnNoAudioHW    = 0x20000,
         AudioEngine_DisableVoiceReuse   = 0x40000,
+        AudioEngine_UseAudioThread      = 0x80000,
+        AudioEngine_NormalizePCM        = 0x100000,
     };
 
     inline AUDIO_ENGINE_FLAGS operator|(AUDIO_ENGINE_FLAGS a, AUDIO_ENGINE_FLAGS b) { return static_cast<AUDIO_ENGINE_FLAGS>( static_cast<int>(a) | static_cast<int>(b) ); }
@@ -231,6 +253,7 @@ namespace DirectX
 
         bool __cdecl Update();
             // Performs per-frame processing for the audio engine, returns false if in 'silent mode'
+            // Note: with AudioEngine_UseAudioThread this processing happens on the audio thread, and Update only reports status
 
         bool __cdecl Reset( _In_opt_ const WAVEFORMATEX* wfx = nullptr, _In_opt_z_ const wchar_t* deviceId = nullptr );
             // Reset audio engine from critical error/silent mode using a new device; can also 'migrate' the graph
@@ -252,6 +275,10 @@ namespace DirectX
         void __cdecl SetMasteringLimit( int release, int loudness );
             // Sets the mastering volume limiter properties (if active)
 
+        void __cdecl Apply3D( const AudioListener& listener, _In_reads_(count) SoundEffectInstance* const* instances, _In_reads_(count) const AudioEmitter* emitters, size_t count );
+        void __cdecl Apply3D( const AudioListener& listener, _In_reads_(count) DynamicSoundEffectInstance* const* instances, _In_reads_(count) const AudioEmitter* emitters, size_t count );
+            // Applies 3D positional audio to many instances, skipping unchanged ones and committing all changes together
+
         AudioStatistics __cdecl GetStatistics() const;
             // Gathers audio engine statistics
 
@@ -270,6 +297,9 @@ namespace DirectX
         bool __cdecl IsCriticalError() const;
             // Returns true if the audio graph is halted due to a critical error (which also places the engine into 'silent mode')
 
+        AUDIO_ENGINE_FLAGS __cdecl GetFlags() const;
+            // Returns the flags the audio engine was created with
+
         // Voice pool management.
         void __cdecl SetDefaultSampleRate( int sampleRate );
             // Sample rate for voices in the reuse pool (defaults to 44100)
@@ -281,6 +311,24 @@ namespace DirectX
         void __cdecl TrimVoicePool();
             // Releases any currently unused voices
 
+        void __cdecl SetMaxVoicePoolPerFormat( size_t maxIdle );
+            // Maximum number of idle one-shot voices kept for reuse per format (defaults to no limit)
+            // Note: completed one-shots over this limit are destroyed rather than pooled
+
+        void __cdecl SetMaxAudibleInstances( size_t maxAudible );
+            // Maximum number of playing SoundEffectInstances given a source voice (defaults to no limit)
+            // Note: the rest play 'virtually' and resume at the right position once they rank by priority, then audibility
+
+        // Audio thread
+        typedef void (__cdecl *AudioCommand)( _In_opt_ void* context, float value );
+
+        void __cdecl Post( _In_ AudioCommand command, _In_opt_ void* context, float value = 0.f );
+            // Queues a command to run on the audio thread ahead of its next update (runs immediately without an audio thread)
+            // Note: instance methods can also be called directly from any thread, but then wait for an audio thread update in progress
+
+        bool __cdecl IsUsingAudioThread() const;
+            // Returns true if the engine was created with AudioEngine_UseAudioThread
+
         // Internal-use functions
         void __cdecl AllocateVoice( _In_ const WAVEFORMATEX* wfx, SOUND_EFFECT_INSTANCE_FLAGS flags, bool oneshot, _Outptr_result_maybenull_ IXAudio2SourceVoice** voice );
 
@@ -290,6 +338,16 @@ namespace DirectX
         void __cdecl RegisterNotify( _In_ IVoiceNotify* notify, bool usesUpdate );
         void __cdecl UnregisterNotify( _In_ IVoiceNotify* notify, bool usesOneShots, bool usesUpdate );
 
+        void __cdecl RegisterVirtualVoice( _In_ IVirtualVoice* voice );
+        void __cdecl UnregisterVirtualVoice( _In_ IVirtualVoice* voice );
+
+        bool __cdecl ReserveAudibleVoice();
+            // Returns false if an instance starting to play should start as a virtual voice
+
+        void __cdecl Lock();
+        void __cdecl Unlock();
+            // Held by instance methods so they are serialized with the audio thread (may be taken recursively)
+
         // XAudio2 interface access
         IXAudio2* __cdecl GetInterface() const;
         IXAudio2MasteringVoice* __cdecl GetMasterVoice() const;
@@ -321,7 +379,8 @@ namespace DirectX
     class WaveBank
     {
     public:
-        WaveBank( _In_ AudioEngine* engine, _In_z_ const wchar_t* wbFileName );
+        WaveBank( _In_ AudioEngine* engine, _In_z_ const wchar_t* wbFileName, bool memoryMapped = false );
+            // memoryMapped maps in-memory wave data from the file rather than reading it into the heap
 
         WaveBank(WaveBank&& moveFrom);
         WaveBank& operator= (WaveBank&& moveFrom);
@@ -336,9 +395,20 @@ namespace DirectX
         std::unique_ptr<SoundEffectInstance> __cdecl CreateInstance( int index, SOUND_EFFECT_INSTANCE_FLAGS flags = SoundEffectInstance_Default );
         std::unique_ptr<SoundEffectInstance> __cdecl CreateInstance( _In_z_ const char* name, SOUND_EFFECT_INSTANCE_FLAGS flags = SoundEffectInstance_Default );
 
+        std::unique_ptr<SoundStreamInstance> __cdecl CreateStreamInstance( int index, SOUND_EFFECT_INSTANCE_FLAGS flags = SoundEffectInstance_Default );
+        std::unique_ptr<SoundStreamInstance> __cdecl CreateStreamInstance( _In_z_ const char* name, SOUND_EFFECT_INSTANCE_FLAGS flags = SoundEffectInstance_Default );
+            // Streaming wave banks only; the wave is read from disk as it plays
+
         bool __cdecl IsPrepared() const;
         bool __cdecl IsInUse() const;
         bool __cdecl IsStreamingBank() const;
+        bool __cdecl IsMemoryMapped() const;
+
+        float __cdecl GetPrepareProgress() const;
+            // Returns 0 to 1 as the wave data is read from disk
+
+        void __cdecl SetPreparedCallback( _In_opt_ std::function<void DIRECTX_STD_CALLCONV(WaveBank*)> callback );
+            // Called once from AudioEngine::Update when the wave bank is prepared
 
         size_t __cdecl GetSampleSizeInBytes( int index ) const;
             // Returns size of wave audio data
@@ -371,8 +441,12 @@ namespace DirectX
 
         // Private interface
         void __cdecl UnregisterInstance( _In_ SoundEffectInstance* instance );
+        void __cdecl UnregisterInstance( _In_ SoundStreamInstance* instance );
+
+        const WaveBankReader& __cdecl GetReader() const;
 
         friend class SoundEffectInstance;
+        friend class SoundStreamInstance;
     };
 
 
@@ -380,7 +454,8 @@ namespace DirectX
     class SoundEffect
     {
     public:
-        SoundEffect( _In_ AudioEngine* engine, _In_z_ const wchar_t* waveFileName );
+        SoundEffect( _In_ AudioEngine* engine, _In_z_ const wchar_t* waveFileName, bool memoryMapped = false );
+            // memoryMapped plays the wave data directly from a read-only view of the file instead of a copy
 
         SoundEffect( _In_ AudioEngine* engine, _Inout_ std::unique_ptr<uint8_t[]>& wavData,
                      _In_ const WAVEFORMATEX* wfx, _In_reads_bytes_(audioBytes) const uint8_t* startAudio, size_t audioBytes );
@@ -633,8 +708,16 @@ namespace DirectX
         void __cdecl SetPan( float pan );
 
         void __cdecl Apply3D( const AudioListener& listener, const AudioEmitter& emitter );
+        bool __cdecl Apply3D( const AudioListener& listener, const AudioEmitter& emitter, uint32_t operationSet );
+            // Defers changes to an XAudio2 operation set, and skips them if the 3D inputs are unchanged
+            // Returns true if changes were made that need IXAudio2::CommitChanges
+
+        void __cdecl SetPriority( int priority );
+        int __cdecl GetPriority() const;
+            // Higher priority instances keep their voice first when the engine limits audible instances
 
         bool __cdecl IsLooped() const;
+        bool __cdecl IsVirtual() const;
 
         SoundState __cdecl GetState();
 
@@ -660,6 +743,53 @@ namespace DirectX
     };
 
 
+    //----------------------------------------------------------------------------------
+    class SoundStreamInstance
+    {
+    public:
+        SoundStreamInstance(SoundStreamInstance&& moveFrom);
+        SoundStreamInstance& operator= (SoundStreamInstance&& moveFrom);
+        virtual ~SoundStreamInstance();
+
+        void __cdecl Play( bool loop = false );
+        void __cdecl Stop( bool immediate = true );
+        void __cdecl Pause();
+        void __cdecl Resume();
+
+        void __cdecl SetVolume( float volume );
+        void __cdecl SetPitch( float pitch );
+        void __cdecl SetPan( float pan );
+
+        void __cdecl Apply3D( const AudioListener& listener, const AudioEmitter& emitter );
+
+        bool __cdecl IsLooped() const;
+
+        SoundState __cdecl GetState();
+
+        // Notifications.
+        void __cdecl OnDestroyParent();
+
+        static const size_t BufferCount = 3;
+        static const size_t BufferSize = 65536;
+            // Ring of sector-aligned read buffers, each holding about BufferSize bytes of wave data
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Private constructors
+        SoundStreamInstance( _In_ AudioEngine* engine, _In_ WaveBank* waveBank, int index, SOUND_EFFECT_INSTANCE_FLAGS flags );
+
+        friend std::unique_ptr<SoundStreamInstance> __cdecl WaveBank::CreateStreamInstance( int, SOUND_EFFECT_INSTANCE_FLAGS );
+
+        // Prevent copying.
+        SoundStreamInstance(SoundStreamInstance const&) DIRECTX_CTOR_DELETE
+        SoundStreamInstance& operator= (SoundStreamInstance const&) DIRECTX_CTOR_DELETE
+    };
+
+
     //----------------------------------------------------------------------------------
     class DynamicSoundEffectInstance
     {
@@ -682,10 +812,19 @@ namespace DirectX
         void __cdecl SetPan( float pan );
 
         void __cdecl Apply3D( const AudioListener& listener, const AudioEmitter& emitter );
+        bool __cdecl Apply3D( const AudioListener& listener, const AudioEmitter& emitter, uint32_t operationSet );
+            // Defers changes to an XAudio2 operation set, and skips them if the 3D inputs are unchanged
 
         void __cdecl SubmitBuffer( _In_reads_bytes_(audioBytes) const uint8_t* pAudioData, size_t audioBytes );
         void __cdecl SubmitBuffer( _In_reads_bytes_(audioBytes) const uint8_t* pAudioData, uint32_t offset, size_t audioBytes );
 
+        void __cdecl SetBufferFill( _In_opt_ std::function<size_t DIRECTX_STD_CALLCONV(DynamicSoundEffectInstance*, uint8_t*, size_t)> fillBuffer, size_t bufferBytes = 0 );
+            // Uses a ring of aligned buffers owned by the instance, which fillBuffer writes in place and returns the bytes written (0 for none yet)
+            // Note: bufferBytes defaults to 10 ms of audio; set while no buffers are pending, and don't mix with SubmitBuffer
+
+        void __cdecl SetTargetLatency( uint32_t latencyMS );
+            // Sets how much audio the buffer ring keeps queued, which picks the number of buffers in flight (defaults to 3 buffers)
+
         SoundState __cdecl GetState();
 
         size_t __cdecl GetSampleDuration( size_t bytes ) const;
@@ -38,7 +38,8 @@ namespace DirectX
     class CommonStates
     {
     public:
-        explicit CommonStates(_In_ ID3D11Device* device);
+        // Set createAll to make every built-in state now, rather than on first use.
+        explicit CommonStates(_In_ ID3D11Device* device, bool createAll = false);
         CommonStates(CommonStates&& moveFrom);
         CommonStates& operator= (CommonStates&& moveFrom);
         virtual ~CommonStates();
@@ -68,6 +69,13 @@ namespace DirectX
         ID3D11SamplerState* __cdecl AnisotropicWrap() const;
         ID3D11SamplerState* __cdecl AnisotropicClamp() const;
 
+        // Custom states, cached by their full description and shared per device. Looking up a state that
+        // already exists takes no lock. The objects are owned by the cache, like the built-in states above.
+        ID3D11BlendState* __cdecl GetBlendState(D3D11_BLEND_DESC const& desc) const;
+        ID3D11DepthStencilState* __cdecl GetDepthStencilState(D3D11_DEPTH_STENCIL_DESC const& desc) const;
+        ID3D11RasterizerState* __cdecl GetRasterizerState(D3D11_RASTERIZER_DESC const& desc) const;
+        ID3D11SamplerState* __cdecl GetSamplerState(D3D11_SAMPLER_DESC const& desc) const;
+
     private:
         // Private implementation.
         class Impl;
@@ -31,6 +31,20 @@
 #include <stdint.h>
 #pragma warning(pop)
 
+#include <memory>
+
+// VS 2010/2012 do not support =default =delete
+#ifndef DIRECTX_CTOR_DEFAULT
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#define DIRECTX_CTOR_DEFAULT {}
+#define DIRECTX_CTOR_DELETE ;
+#else
+#define DIRECTX_CTOR_DEFAULT =default;
+#define DIRECTX_CTOR_DELETE =delete;
+#endif
+#endif
+
+
 namespace DirectX
 {
     enum DDS_ALPHA_MODE
@@ -115,7 +129,8 @@ namespace DirectX
                                                 _In_ bool forceSRGB,
                                                 _Outptr_opt_ ID3D11Resource** texture,
                                                 _Outptr_opt_ ID3D11ShaderResourceView** textureView,
-                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+                                                _In_ bool memoryMapped = false
                                               );
 
     // Extended version with optional auto-gen mipmap support
@@ -155,6 +170,52 @@ namespace DirectX
                                                 _In_ bool forceSRGB,
                                                 _Outptr_opt_ ID3D11Resource** texture,
                                                 _Outptr_opt_ ID3D11ShaderResourceView** textureView,
-                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+                                                _In_ bool memoryMapped = false
                                               );
+
+
+    // Streams the mip levels of a 2D DDS texture, texture array, or cubemap. The full mip chain is created up
+    // front (less any levels larger than maxsize), but only the smallest levels are loaded. More detailed levels
+    // are uploaded by Update once requested, and SetResourceMinLOD stops the GPU from sampling levels that are
+    // not loaded yet. The file stays memory-mapped for the lifetime of the object, so data that is never
+    // requested is never read from disk.
+    class DDSStreamingTexture
+    {
+    public:
+        DDSStreamingTexture(_In_ ID3D11Device* device,
+                            _In_ ID3D11DeviceContext* context,
+                            _In_z_ const wchar_t* szFileName,
+                            size_t initialMips = 1,
+                            size_t maxsize = 0,
+                            bool forceSRGB = false);
+
+        DDSStreamingTexture(DDSStreamingTexture&& moveFrom);
+        DDSStreamingTexture& operator= (DDSStreamingTexture&& moveFrom);
+        virtual ~DDSStreamingTexture();
+
+        // Sets the most detailed mip level that should be resident (0 is the full size texture).
+        void __cdecl SetRequestedLOD(size_t mostDetailedMip);
+
+        // Uploads pending levels, smallest first, spending at most maxBytes (0 for no limit) apart from always
+        // making some progress. Returns true once the requested level is resident.
+        bool __cdecl Update(_In_ ID3D11DeviceContext* context, size_t maxBytes = 0);
+
+        size_t __cdecl GetRequestedLOD() const;
+        size_t __cdecl GetResidentLOD() const;
+        size_t __cdecl GetMipLevels() const;
+
+        ID3D11Resource* __cdecl GetTexture() const;
+        ID3D11ShaderResourceView* __cdecl GetShaderResourceView() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        DDSStreamingTexture(DDSStreamingTexture const&) DIRECTX_CTOR_DELETE
+        DDSStreamingTexture& operator= (DDSStreamingTexture const&) DIRECTX_CTOR_DELETE
+    };
 }
\ No newline at end of file
@@ -31,7 +31,18 @@
 #endif
 
 #include <DirectXMath.h>
+#include <functional>
 #include <memory>
+#include <vector>
+
+// VS 2010 doesn't support explicit calling convention for std::function
+#ifndef DIRECTX_STD_CALLCONV
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+#define DIRECTX_STD_CALLCONV
+#else
+#define DIRECTX_STD_CALLCONV __cdecl
+#endif
+#endif
 
 #pragma warning(push)
 #pragma warning(disable : 4481)
@@ -118,9 +129,150 @@ namespace DirectX
     };
 
 
+    // Abstract interface for effects which support hardware instancing
+    class IEffectInstancing
+    {
+    public:
+        virtual ~IEffectInstancing() { }
+
+        // When enabled, the vertex shader reads a per-instance transform (semantic INSTMATRIX0-2, the first three
+        // columns of the matrix) from the input layout, which is applied before the effect's world matrix.
+        virtual void __cdecl SetInstancingEnabled(bool value) = 0;
+    };
+
+
+    // Abstract interface for effects which can draw depth alone, for shadow maps and depth prepasses
+    class IEffectDepthOnly
+    {
+    public:
+        virtual ~IEffectDepthOnly() { }
+
+        // Swaps in the cheapest shaders that still write the same depth, skipping lighting, fog, and textures. Alpha
+        // tested effects keep the alpha test, while the others bind no pixel shader, so their color output is undefined.
+        virtual void __cdecl SetDepthOnly(bool value) = 0;
+    };
+
+
+    // Abstract interface for effects which can be copied
+    class IEffectClone
+    {
+    public:
+        virtual ~IEffectClone() { }
+
+        // The copy has the same settings and shares shaders and textures, but has its own parameter state and
+        // constant buffers, so the two can be used from different threads and device contexts at the same time.
+        virtual std::shared_ptr<IEffect> __cdecl Clone() const = 0;
+    };
+
+
+    // One shader created by an effect type, as reported by IEffectShaderWarmUp.
+    struct EffectShaderCreation
+    {
+        int permutation;        // The effect permutation which first needed the shader.
+        bool pixelShader;
+        bool warmUp;            // False if it was created on demand while drawing, which can cause a hitch.
+        double milliseconds;
+    };
+
+
+    // Abstract interface for effects which can create their shaders ahead of first use
+    class IEffectShaderWarmUp
+    {
+    public:
+        virtual ~IEffectShaderWarmUp() { }
+
+        // Creates the shaders for the current settings, or for every permutation the device supports. Safe to call on a
+        // background thread at load. Shaders are shared by all effects of the same type on a device, and kept while any exists.
+        virtual void __cdecl WarmUpShaders(bool allPermutations = false) = 0;
+
+        // Lists every shader created so far by this type of effect on this device.
+        virtual void __cdecl GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const = 0;
+    };
+
+
+    // Opt-in shared constant buffer ring. While one is attached to a device context, the built-in effects applied on that
+    // context copy their constants into it and bind them with VSSetConstantBuffers1 offsets, rather than each mapping its own
+    // constant buffer with DISCARD. Needs the Direct3D 11.1 runtime with constant buffer offsetting; without it IsActive
+    // returns false and effects keep their own buffers. DGSLEffect always uses its own buffers.
+    class EffectConstantRing
+    {
+    public:
+        explicit EffectConstantRing(_In_ ID3D11DeviceContext* deviceContext, size_t sizeInBytes = DefaultSize);
+        EffectConstantRing(EffectConstantRing&& moveFrom);
+        EffectConstantRing& operator= (EffectConstantRing&& moveFrom);
+        virtual ~EffectConstantRing();
+
+        bool __cdecl IsActive() const;
+
+        // Starts over with a fresh buffer. Call at the start of each command list when attached to a deferred context.
+        void __cdecl Reset();
+
+        static const size_t DefaultSize = 4 * 1024 * 1024;
+
+        // Private implementation.
+        class Impl;
+
+    private:
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        EffectConstantRing(EffectConstantRing const&) DIRECTX_CTOR_DELETE
+        EffectConstantRing& operator= (EffectConstantRing const&) DIRECTX_CTOR_DELETE
+    };
+
+
+    // Point light for LightGrid. Falls off smoothly to nothing at range.
+    struct PointLight
+    {
+        XMFLOAT3 position;
+        float range;
+        XMFLOAT3 diffuseColor;
+        XMFLOAT3 specularColor;
+    };
+
+
+    // Sorts point lights into 16x16 pixel screen tiles with a compute shader, so BasicEffect::SetLightGrid
+    // only shades each pixel with the lights that can reach its tile. Call Update once per frame with the
+    // camera, before drawing. Requires Feature Level 11.0, and a perspective projection.
+    class LightGrid
+    {
+    public:
+        static const size_t DefaultMaxLights = 1024;
+        static const size_t DefaultMaxLightsPerTile = 64;
+
+        static const UINT TileSize = 16;
+        static const size_t MaxLightsPerTileLimit = 256;
+
+        LightGrid(_In_ ID3D11Device* device, size_t maxLights = DefaultMaxLights, size_t maxLightsPerTile = DefaultMaxLightsPerTile);
+        LightGrid(LightGrid&& moveFrom);
+        LightGrid& operator= (LightGrid&& moveFrom);
+        virtual ~LightGrid();
+
+        // Uploads the lights and rebuilds every tile's list. Lights past maxLightsPerTile in a tile are dropped.
+        void XM_CALLCONV Update(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) PointLight const* lights, size_t count,
+                                FXMMATRIX view, CXMMATRIX projection, UINT width, UINT height);
+
+        ID3D11ShaderResourceView* __cdecl GetLightBuffer() const;
+        ID3D11ShaderResourceView* __cdecl GetTileBuffer() const;
+        UINT __cdecl GetTileCountX() const;
+        UINT __cdecl GetTileLightStride() const;
+        size_t __cdecl GetMaxLights() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        LightGrid(LightGrid const&) DIRECTX_CTOR_DELETE
+        LightGrid& operator= (LightGrid const&) DIRECTX_CTOR_DELETE
+    };
+
+
     //----------------------------------------------------------------------------------
     // Built-in shader supports optional texture mapping, vertex coloring, directional lighting, and fog.
-    class BasicEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectFog
+    class BasicEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectFog, public IEffectInstancing, public IEffectDepthOnly, public IEffectClone, public IEffectShaderWarmUp
     {
     public:
         explicit BasicEffect(_In_ ID3D11Device* device);
@@ -133,6 +285,13 @@ namespace DirectX
 
         void __cdecl GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
 
+        // IEffectClone methods.
+        std::shared_ptr<IEffect> __cdecl Clone() const override;
+
+        // IEffectShaderWarmUp methods.
+        void __cdecl WarmUpShaders(bool allPermutations = false) override;
+        void __cdecl GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const override;
+
         // Camera settings.
         void XM_CALLCONV SetWorld(FXMMATRIX value) override;
         void XM_CALLCONV SetView(FXMMATRIX value) override;
@@ -170,6 +329,16 @@ namespace DirectX
         // Texture setting.
         void __cdecl SetTextureEnabled(bool value);
         void __cdecl SetTexture(_In_opt_ ID3D11ShaderResourceView* value);
+
+        // Instancing setting.
+        void __cdecl SetInstancingEnabled(bool value) override;
+
+        // Tiled point lights, added to the directional lights when lighting is enabled. Forces per-pixel lighting.
+        // The grid must outlive its use by the effect, and be updated for the render target being drawn.
+        void __cdecl SetLightGrid(_In_opt_ LightGrid const* value);
+
+        // Depth only setting.
+        void __cdecl SetDepthOnly(bool value) override;
         
     private:
         // Private implementation.
@@ -177,6 +346,9 @@ namespace DirectX
 
         std::unique_ptr<Impl> pImpl;
 
+        // Used by Clone.
+        explicit BasicEffect(std::unique_ptr<Impl>&& impl);
+
         // Prevent copying.
         BasicEffect(BasicEffect const&) DIRECTX_CTOR_DELETE
         BasicEffect& operator= (BasicEffect const&) DIRECTX_CTOR_DELETE
@@ -185,7 +357,7 @@ namespace DirectX
 
 
     // Built-in shader supports per-pixel alpha testing.
-    class AlphaTestEffect : public IEffect, public IEffectMatrices, public IEffectFog
+    class AlphaTestEffect : public IEffect, public IEffectMatrices, public IEffectFog, public IEffectDepthOnly, public IEffectClone, public IEffectShaderWarmUp
     {
     public:
         explicit AlphaTestEffect(_In_ ID3D11Device* device);
@@ -198,6 +370,13 @@ namespace DirectX
 
         void __cdecl GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
 
+        // IEffectClone methods.
+        std::shared_ptr<IEffect> __cdecl Clone() const override;
+
+        // IEffectShaderWarmUp methods.
+        void __cdecl WarmUpShaders(bool allPermutations = false) override;
+        void __cdecl GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const override;
+
         // Camera settings.
         void XM_CALLCONV SetWorld(FXMMATRIX value) override;
         void XM_CALLCONV SetView(FXMMATRIX value) override;
@@ -223,12 +402,18 @@ namespace DirectX
         void __cdecl SetAlphaFunction(D3D11_COMPARISON_FUNC value);
         void __cdecl SetReferenceAlpha(int value);
 
+        // Depth only setting.
+        void __cdecl SetDepthOnly(bool value) override;
+
     private:
         // Private implementation.
         class Impl;
 
         std::unique_ptr<Impl> pImpl;
 
+        // Used by Clone.
+        explicit AlphaTestEffect(std::unique_ptr<Impl>&& impl);
+
         // Prevent copying.
         AlphaTestEffect(AlphaTestEffect const&) DIRECTX_CTOR_DELETE
         AlphaTestEffect& operator= (AlphaTestEffect const&) DIRECTX_CTOR_DELETE
@@ -237,7 +422,7 @@ namespace DirectX
 
 
     // Built-in shader supports two layer multitexturing (eg. for lightmaps or detail textures).
-    class DualTextureEffect : public IEffect, public IEffectMatrices, public IEffectFog
+    class DualTextureEffect : public IEffect, public IEffectMatrices, public IEffectFog, public IEffectDepthOnly, public IEffectClone, public IEffectShaderWarmUp
     {
     public:
         explicit DualTextureEffect(_In_ ID3D11Device* device);
@@ -250,6 +435,13 @@ namespace DirectX
 
         void __cdecl GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
 
+        // IEffectClone methods.
+        std::shared_ptr<IEffect> __cdecl Clone() const override;
+
+        // IEffectShaderWarmUp methods.
+        void __cdecl WarmUpShaders(bool allPermutations = false) override;
+        void __cdecl GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const override;
+
         // Camera settings.
         void XM_CALLCONV SetWorld(FXMMATRIX value) override;
         void XM_CALLCONV SetView(FXMMATRIX value) override;
@@ -271,6 +463,9 @@ namespace DirectX
         // Texture settings.
         void __cdecl SetTexture(_In_opt_ ID3D11ShaderResourceView* value);
         void __cdecl SetTexture2(_In_opt_ ID3D11ShaderResourceView* value);
+
+        // Depth only setting.
+        void __cdecl SetDepthOnly(bool value) override;
         
     private:
         // Private implementation.
@@ -278,6 +473,9 @@ namespace DirectX
 
         std::unique_ptr<Impl> pImpl;
 
+        // Used by Clone.
+        explicit DualTextureEffect(std::unique_ptr<Impl>&& impl);
+
         // Prevent copying.
         DualTextureEffect(DualTextureEffect const&) DIRECTX_CTOR_DELETE
         DualTextureEffect& operator= (DualTextureEffect const&) DIRECTX_CTOR_DELETE
@@ -286,7 +484,7 @@ namespace DirectX
 
 
     // Built-in shader supports cubic environment mapping.
-    class EnvironmentMapEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectFog
+    class EnvironmentMapEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectFog, public IEffectClone, public IEffectShaderWarmUp
     {
     public:
         explicit EnvironmentMapEffect(_In_ ID3D11Device* device);
@@ -299,6 +497,13 @@ namespace DirectX
 
         void __cdecl GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
 
+        // IEffectClone methods.
+        std::shared_ptr<IEffect> __cdecl Clone() const override;
+
+        // IEffectShaderWarmUp methods.
+        void __cdecl WarmUpShaders(bool allPermutations = false) override;
+        void __cdecl GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const override;
+
         // Camera settings.
         void XM_CALLCONV SetWorld(FXMMATRIX value) override;
         void XM_CALLCONV SetView(FXMMATRIX value) override;
@@ -332,6 +537,9 @@ namespace DirectX
         void __cdecl SetEnvironmentMapAmount(float value);
         void XM_CALLCONV SetEnvironmentMapSpecular(FXMVECTOR value);
         void __cdecl SetFresnelFactor(float value);
+
+        // Picks a blurrier mip of a prefiltered cubemap for rougher surfaces: 0 samples as before, 1 the smallest mip.
+        void __cdecl SetEnvironmentMapRoughness(float value);
         
     private:
         // Private implementation.
@@ -339,6 +547,9 @@ namespace DirectX
 
         std::unique_ptr<Impl> pImpl;
 
+        // Used by Clone.
+        explicit EnvironmentMapEffect(std::unique_ptr<Impl>&& impl);
+
         // Unsupported interface methods.
         void __cdecl SetLightingEnabled(bool value) override;
         void __cdecl SetPerPixelLighting(bool value) override;
@@ -350,9 +561,57 @@ namespace DirectX
     };
 
 
+    // Dynamic cubemaps for EnvironmentMapEffect. Each Update renders at most facesPerFrame cube faces, working
+    // round-robin through the probes, and prefilters a probe's mips for SetEnvironmentMapRoughness once all six
+    // of its faces are done. Probes only change when complete, so a half-rendered probe is never seen.
+    //
+    // Faces are drawn with left-handed views to match the cubemap layout, which mirrors right-handed scenes,
+    // so draw those with the opposite cull mode. Prefiltering uses a compute shader at Feature Level 11.0 and
+    // above, and falls back to GenerateMips below that.
+    class ReflectionProbes
+    {
+    public:
+        static const UINT DefaultResolution = 128;
+        static const UINT DefaultFacesPerFrame = 2;
+
+        typedef std::function<void DIRECTX_STD_CALLCONV(ID3D11DeviceContext* deviceContext, size_t probe, CXMMATRIX view, CXMMATRIX projection)> DrawCallback;
+
+        ReflectionProbes(_In_ ID3D11Device* device, size_t probeCount, UINT resolution = DefaultResolution, DXGI_FORMAT format = DXGI_FORMAT_R16G16B16A16_FLOAT);
+        ReflectionProbes(ReflectionProbes&& moveFrom);
+        ReflectionProbes& operator= (ReflectionProbes&& moveFrom);
+        virtual ~ReflectionProbes();
+
+        // Renders the next faces within the per-frame budget. The render targets and viewports are restored afterwards.
+        void __cdecl Update(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw);
+
+        // Renders and prefilters every probe at once, for example after loading a level.
+        void __cdecl UpdateAll(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw);
+
+        // Probe settings.
+        void XM_CALLCONV SetProbePosition(size_t probe, FXMVECTOR value);
+        void __cdecl SetClipPlanes(float nearPlane, float farPlane);
+        void XM_CALLCONV SetClearColor(FXMVECTOR value);
+        void __cdecl SetFacesPerFrame(UINT value);
+
+        ID3D11ShaderResourceView* __cdecl GetProbe(size_t probe) const;
+        size_t __cdecl GetProbeCount() const;
+        UINT __cdecl GetMipLevels() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        ReflectionProbes(ReflectionProbes const&) DIRECTX_CTOR_DELETE
+        ReflectionProbes& operator= (ReflectionProbes const&) DIRECTX_CTOR_DELETE
+    };
+
+
 
     // Built-in shader supports skinned animation.
-    class SkinnedEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectFog, public IEffectSkinning
+    class SkinnedEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectFog, public IEffectSkinning, public IEffectClone, public IEffectShaderWarmUp
     {
     public:
         explicit SkinnedEffect(_In_ ID3D11Device* device);
@@ -365,6 +624,13 @@ namespace DirectX
 
         void __cdecl GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
 
+        // IEffectClone methods.
+        std::shared_ptr<IEffect> __cdecl Clone() const override;
+
+        // IEffectShaderWarmUp methods.
+        void __cdecl WarmUpShaders(bool allPermutations = false) override;
+        void __cdecl GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const override;
+
         // Camera settings.
         void XM_CALLCONV SetWorld(FXMMATRIX value) override;
         void XM_CALLCONV SetView(FXMMATRIX value) override;
@@ -403,12 +669,19 @@ namespace DirectX
         void __cdecl SetBoneTransforms(_In_reads_(count) XMMATRIX const* value, size_t count) override;
         void __cdecl ResetBoneTransforms() override;
 
+        // Reads bones from a buffer instead of the MaxBones constant palette, starting at firstBone (Feature Level 10.0 or greater).
+        // Pass null to go back to SetBoneTransforms. See BoneBuffer.
+        void __cdecl SetBoneBuffer(_In_opt_ ID3D11ShaderResourceView* value, size_t firstBone = 0, bool dualQuaternion = false);
+
     private:
         // Private implementation.
         class Impl;
 
         std::unique_ptr<Impl> pImpl;
 
+        // Used by Clone.
+        explicit SkinnedEffect(std::unique_ptr<Impl>&& impl);
+
         // Unsupported interface method.
         void __cdecl SetLightingEnabled(bool value) override;
 
@@ -417,11 +690,41 @@ namespace DirectX
         SkinnedEffect& operator= (SkinnedEffect const&) DIRECTX_CTOR_DELETE
     };
 
+
+
+    // Dynamic bone palette for SkinnedEffect::SetBoneBuffer, with no limit on the number of bones. Write the
+    // bones of every instance with one SetBoneTransforms call per frame, then point each effect at its own range.
+    class BoneBuffer
+    {
+    public:
+        BoneBuffer(_In_ ID3D11Device* device, size_t maxBones, bool dualQuaternion = false);
+        BoneBuffer(BoneBuffer&& moveFrom);
+        BoneBuffer& operator= (BoneBuffer&& moveFrom);
+        virtual ~BoneBuffer();
+
+        // Replaces the whole buffer contents. Dual quaternion buffers only keep the rotation and translation of each matrix.
+        void __cdecl SetBoneTransforms(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) XMMATRIX const* value, size_t count);
+
+        ID3D11ShaderResourceView* __cdecl GetShaderResourceView() const;
+        size_t __cdecl GetMaxBones() const;
+        bool __cdecl IsDualQuaternion() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        BoneBuffer(BoneBuffer const&) DIRECTX_CTOR_DELETE
+        BoneBuffer& operator= (BoneBuffer const&) DIRECTX_CTOR_DELETE
+    };
+
     
 
     //----------------------------------------------------------------------------------
     // Built-in effect for Visual Studio Shader Designer (DGSL) shaders
-    class DGSLEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectSkinning
+    class DGSLEffect : public IEffect, public IEffectMatrices, public IEffectLights, public IEffectSkinning, public IEffectInstancing, public IEffectClone, public IEffectShaderWarmUp
     {
     public:
         explicit DGSLEffect( _In_ ID3D11Device* device, _In_opt_ ID3D11PixelShader* pixelShader = nullptr,
@@ -435,6 +738,13 @@ namespace DirectX
 
         void __cdecl GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength) override;
 
+        // IEffectClone methods.
+        std::shared_ptr<IEffect> __cdecl Clone() const override;
+
+        // IEffectShaderWarmUp methods.
+        void __cdecl WarmUpShaders(bool allPermutations = false) override;
+        void __cdecl GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const override;
+
         // Camera settings.
         void XM_CALLCONV SetWorld(FXMMATRIX value) override;
         void XM_CALLCONV SetView(FXMMATRIX value) override;
@@ -483,12 +793,18 @@ namespace DirectX
         void __cdecl SetBoneTransforms(_In_reads_(count) XMMATRIX const* value, size_t count) override;
         void __cdecl ResetBoneTransforms() override;
 
+        // Instancing setting (not supported together with skinning).
+        void __cdecl SetInstancingEnabled(bool value) override;
+
     private:
         // Private implementation.
         class Impl;
 
         std::unique_ptr<Impl> pImpl;
 
+        // Used by Clone.
+        explicit DGSLEffect(std::unique_ptr<Impl>&& impl);
+
         // Unsupported interface methods.
         void __cdecl SetPerPixelLighting(bool value) override;
 
@@ -36,6 +36,16 @@
 #endif
 #endif
 
+// VS 2010 doesn't support explicit calling convention for std::function
+#ifndef DIRECTX_STD_CALLCONV
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+#define DIRECTX_STD_CALLCONV
+#else
+#define DIRECTX_STD_CALLCONV __cdecl
+#endif
+#endif
+
+#include <functional>
 #include <memory>
 
 #pragma warning(push)
@@ -228,6 +238,33 @@ namespace DirectX
         void __cdecl Suspend();
         void __cdecl Resume();
 
+        // Read every player's gamepad on a background thread (XInput only), so GetState just copies the latest sample and
+        // never waits on the driver. The callbacks run on that thread, for connection changes and for any button press or
+        // release. The real rate is limited by the system timer resolution. Returns false on platforms which already read
+        // gamepads without blocking.
+        typedef std::function<void DIRECTX_STD_CALLCONV(int player, bool connected)> ConnectionCallback;
+        typedef std::function<void DIRECTX_STD_CALLCONV(int player, const State& state, const ButtonStateTracker& buttons)> ButtonCallback;
+
+        bool __cdecl StartPolling( unsigned int samplesPerSecond = 250,
+                                   _In_opt_ ConnectionCallback onConnection = nullptr, _In_opt_ ButtonCallback onButtons = nullptr );
+        void __cdecl StopPolling();
+        bool __cdecl IsPolling() const;
+
+        // State of a gamepad when the polling thread saw it change, timed with QueryPerformanceCounter.
+        struct Sample
+        {
+            uint64_t    time;
+            State       state;
+        };
+
+        // Number of changes kept for each player. Older ones are dropped if GetStateHistory isn't called often enough.
+        static const size_t HISTORY_SIZE = 256;
+
+        // While polling, take the changes seen since the last call, oldest first. If there are more than maxSamples, the rest
+        // are kept for the next call. A disconnect is reported as a sample with connected set to false.
+        size_t __cdecl GetStateHistory( int player, _Out_writes_(maxSamples) Sample* samples, size_t maxSamples,
+                                        DeadZone deadZoneMode = DEAD_ZONE_INDEPENDENT_AXES );
+
     private:
         // Private implementation.
         class Impl;
@@ -23,6 +23,12 @@
 #include <DirectXColors.h>
 #include <functional>
 #include <memory>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable: 4005)
+#include <stdint.h>
+#pragma warning(pop)
 
 // VS 2010 doesn't support explicit calling convention for std::function
 #ifndef DIRECTX_STD_CALLCONV
@@ -54,6 +60,7 @@ namespace DirectX
     #endif
 
     class IEffect;
+    struct VertexPositionNormalTexture;
 
     class GeometricPrimitive
     {
@@ -73,10 +80,23 @@ namespace DirectX
         static std::unique_ptr<GeometricPrimitive> __cdecl CreateIcosahedron  (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
         static std::unique_ptr<GeometricPrimitive> __cdecl CreateTeapot       (_In_ ID3D11DeviceContext* deviceContext, float size = 1, size_t tessellation = 8, bool rhcoords = true);
 
+        // Geometry generation for the high detail shapes, which the factory methods above also use. The outputs are sized
+        // up front and filled in parallel, with 32 bit indices so the tessellation is not limited to 65535 vertices.
+        // The factory methods switch to a 32 bit index buffer when needed, which requires Feature Level 9.2 or greater.
+        static void __cdecl ComputeGeoSphere(std::vector<VertexPositionNormalTexture>& vertices, std::vector<uint32_t>& indices, float diameter = 1, size_t tessellation = 3, bool rhcoords = true);
+        static void __cdecl ComputeTorus    (std::vector<VertexPositionNormalTexture>& vertices, std::vector<uint32_t>& indices, float diameter = 1, float thickness = 0.333f, size_t tessellation = 32, bool rhcoords = true);
+        static void __cdecl ComputeTeapot   (std::vector<VertexPositionNormalTexture>& vertices, std::vector<uint32_t>& indices, float size = 1, size_t tessellation = 8, bool rhcoords = true);
+
         // Draw the primitive.
         void XM_CALLCONV Draw(FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, FXMVECTOR color = Colors::White, _In_opt_ ID3D11ShaderResourceView* texture = nullptr, bool wireframe = false,
                               _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
 
+        // Draw many copies of the primitive with one instanced draw call. Colors may be null to draw them all in white.
+        // Requires Feature Level 9.3 or greater, and falls back to drawing the copies one at a time on lower levels.
+        void XM_CALLCONV DrawInstanced(_In_reads_(count) XMMATRIX const* worlds, _In_reads_opt_(count) XMFLOAT4 const* colors, size_t count,
+                                       CXMMATRIX view, CXMMATRIX projection, _In_opt_ ID3D11ShaderResourceView* texture = nullptr, bool wireframe = false,
+                                       _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
+
         // Draw the primitive using a custom effect.
         void __cdecl Draw( _In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha = false, bool wireframe = false,
                            _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
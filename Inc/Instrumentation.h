@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// File: Instrumentation.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#pragma warning(push)
+#pragma warning(disable : 4005)
+#include <stdint.h>
+#pragma warning(pop)
+
+
+namespace DirectX
+{
+    // Which part of the toolkit an instrumentation event came from.
+    enum InstrumentationCategory
+    {
+        InstrumentationCategory_TextureLoader,
+        InstrumentationCategory_EffectFactory,
+        InstrumentationCategory_SpriteBatch,
+        InstrumentationCategory_Model,
+        InstrumentationCategory_Audio,
+    };
+
+
+    // Describes a timed toolkit call. name is the entry point, and detail is a file or effect name where there is
+    // one. size is in bytes and count is the number of items (sprites, meshes, voices) the call worked on; either
+    // is zero if it does not apply. The strings are only valid for the duration of the callback.
+    struct InstrumentationEvent
+    {
+        InstrumentationCategory category;
+        wchar_t const* name;
+        wchar_t const* detail;
+        size_t size;
+        size_t count;
+    };
+
+
+    // Called as each event begins and again as it ends, possibly on any thread that uses the toolkit. Sizes and
+    // counts that are only known once the work is done are filled in by the end call. Forward the events to ETW,
+    // a profiler, or a log.
+    typedef void (__cdecl *InstrumentationCallback)(_In_opt_ void* userContext, _In_ InstrumentationEvent const* event, bool begin);
+
+
+    namespace Internal
+    {
+        struct InstrumentationSettings
+        {
+            InstrumentationCallback callback;
+            void* userContext;
+            bool gpuEvents;
+        };
+
+        // Defined here rather than in a library, so DirectXTK and DirectXTKAudio share one setting.
+        __declspec(selectany) InstrumentationSettings g_instrumentation = { nullptr, nullptr, false };
+    }
+
+
+    // Instrumentation is off by default, and then costs a test at each entry point, plus a store for entry points
+    // that report a size once their work is done. Defining DIRECTX_NO_INSTRUMENTATION when building the toolkit
+    // removes the events entirely. Settings are not synchronized, so change them while no other thread is inside
+    // the toolkit.
+    inline void __cdecl SetInstrumentationCallback(_In_opt_ InstrumentationCallback callback, _In_opt_ void* userContext = nullptr)
+    {
+        Internal::g_instrumentation.userContext = userContext;
+        Internal::g_instrumentation.callback = callback;
+    }
+
+
+    // Also wraps events that record GPU work in ID3DUserDefinedAnnotation markers, so they show up in PIX
+    // and graphics debugger captures.
+    inline void __cdecl SetInstrumentationGpuEvents(bool enable)
+    {
+        Internal::g_instrumentation.gpuEvents = enable;
+    }
+}
@@ -36,6 +36,17 @@
 
 #include <wrl\client.h>
 
+// VS 2010/2012 do not support =default =delete
+#ifndef DIRECTX_CTOR_DEFAULT
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#define DIRECTX_CTOR_DEFAULT {}
+#define DIRECTX_CTOR_DELETE ;
+#else
+#define DIRECTX_CTOR_DEFAULT =default;
+#define DIRECTX_CTOR_DELETE =delete;
+#endif
+#endif
+
 // VS 2010 doesn't support explicit calling convention for std::function
 #ifndef DIRECTX_STD_CALLCONV
 #if defined(_MSC_VER) && (_MSC_VER < 1700)
@@ -45,6 +56,10 @@
 #endif
 #endif
 
+#pragma warning(push)
+#pragma warning(disable : 4481)
+// VS 2010 considers 'override' to be a extension, but it's part of C++11 as of VS 2012
+
 namespace DirectX
 {
     #if (DIRECTX_MATH_VERSION < 305) && !defined(XM_CALLCONV)
@@ -57,6 +72,74 @@ namespace DirectX
     class IEffectFactory;
     class CommonStates;
     class ModelMesh;
+    class BoundingVolumeHierarchy;
+
+    //----------------------------------------------------------------------------------
+    // Supplies the memory the model loaders use. Objects are the Model and ModelMeshPart instances, and each ModelMesh
+    // together with its shared_ptr control block, and are freed when they are destroyed. Scratch blocks hold temporary
+    // data, and are all freed before the load returns.
+    class IModelAllocator
+    {
+    public:
+        virtual ~IModelAllocator() {}
+
+        virtual void* __cdecl AllocateObject( size_t size ) = 0;
+        virtual void __cdecl FreeObject( _In_ void* ptr, size_t size ) = 0;
+
+        virtual void* __cdecl AllocateScratch( size_t size ) = 0;
+        virtual void __cdecl FreeScratch( _In_ void* ptr, size_t size ) = 0;
+    };
+
+
+    // Pools model objects by size, and keeps scratch blocks between loads, so loading many models makes few heap
+    // allocations. It can be shared by loads on different threads, and must outlive the models created through it.
+    class ModelAllocator : public IModelAllocator
+    {
+    public:
+        ModelAllocator();
+        ModelAllocator(ModelAllocator&& moveFrom);
+        ModelAllocator& operator= (ModelAllocator&& moveFrom);
+        virtual ~ModelAllocator();
+
+        // IModelAllocator methods.
+        virtual void* __cdecl AllocateObject( size_t size ) override;
+        virtual void __cdecl FreeObject( _In_ void* ptr, size_t size ) override;
+
+        virtual void* __cdecl AllocateScratch( size_t size ) override;
+        virtual void __cdecl FreeScratch( _In_ void* ptr, size_t size ) override;
+
+        // Frees the scratch blocks kept for reuse. Object pool pages are only freed with the allocator.
+        void __cdecl Trim();
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        ModelAllocator(ModelAllocator const&) DIRECTX_CTOR_DELETE
+        ModelAllocator& operator= (ModelAllocator const&) DIRECTX_CTOR_DELETE
+    };
+
+    //----------------------------------------------------------------------------------
+    // Description of the material a loader created a part's effect from, kept so the model can be cooked
+    struct ModelMaterial
+    {
+        ModelMaterial();
+
+        std::wstring    name;
+        std::wstring    texture;
+        bool            perVertexColor;
+        bool            enableSkinning;
+        float           specularPower;
+        float           alpha;
+        XMFLOAT3        ambientColor;
+        XMFLOAT3        diffuseColor;
+        XMFLOAT3        specularColor;
+        XMFLOAT3        emissiveColor;
+    };
+
 
     //----------------------------------------------------------------------------------
     // Each mesh part is a submesh with a single effect
@@ -76,6 +159,7 @@ namespace DirectX
         Microsoft::WRL::ComPtr<ID3D11Buffer>                    vertexBuffer;
         std::shared_ptr<IEffect>                                effect;
         std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>>  vbDecl;
+        std::shared_ptr<ModelMaterial>                          material;
         bool                                                    isAlpha;
 
         typedef std::vector<std::unique_ptr<ModelMeshPart>> Collection;
@@ -84,11 +168,25 @@ namespace DirectX
         void __cdecl Draw( _In_ ID3D11DeviceContext* deviceContext, _In_ IEffect* ieffect, _In_ ID3D11InputLayout* iinputLayout,
                            _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr ) const;
 
+        // Draw many instances of the mesh part, with per-instance transforms read from instanceBuffer (bound to slot 1)
+        void __cdecl DrawInstanced( _In_ ID3D11DeviceContext* deviceContext, _In_ IEffect* ieffect, _In_ ID3D11InputLayout* iinputLayout,
+                                    _In_ ID3D11Buffer* instanceBuffer, UINT instanceStride, UINT instanceCount, UINT startInstance = 0,
+                                    _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr ) const;
+
         // Create input layout for drawing with a custom effect.
         void __cdecl CreateInputLayout( _In_ ID3D11Device* d3dDevice, _In_ IEffect* ieffect, _Outptr_ ID3D11InputLayout** iinputLayout );
 
+        // Create input layout for instanced drawing, which adds the per-instance transform (the effect must have instancing enabled).
+        void __cdecl CreateInstancedInputLayout( _In_ ID3D11Device* d3dDevice, _In_ IEffect* ieffect, _Outptr_ ID3D11InputLayout** iinputLayout );
+
         // Change effect used by part and regenerate input layout (be sure to call Model::Modified as well)
         void __cdecl ModifyEffect( _In_ ID3D11Device* d3dDevice, _In_ std::shared_ptr<IEffect>& ieffect, bool isalpha = false );
+
+        // Parts are allocated from an IModelAllocator when created with new (allocator), otherwise from the heap.
+        static void* __cdecl operator new( size_t size );
+        static void* __cdecl operator new( size_t size, _In_opt_ IModelAllocator* allocator );
+        static void __cdecl operator delete( void* ptr );
+        static void __cdecl operator delete( void* ptr, _In_opt_ IModelAllocator* allocator );
     };
 
 
@@ -117,6 +215,51 @@ namespace DirectX
     };
 
 
+    //----------------------------------------------------------------------------------
+    // Vertex cache results of the optional optimizeMesh load step. ACMR is the average number of vertices transformed
+    // per triangle with a 16 entry FIFO post-transform cache: 3 is the worst case, and well ordered meshes get near 0.7.
+    struct ModelOptimizationStatistics
+    {
+        ModelOptimizationStatistics() :
+            triangles(0),
+            acmrBefore(0),
+            acmrAfter(0)
+        { }
+
+        size_t  triangles;
+        float   acmrBefore;
+        float   acmrAfter;
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // Per-instance vertex buffer and instanced input layouts used by Model::DrawInstanced. Keep one for each thread or
+    // deferred context that draws instanced models, so that concurrent draws, even of the same model, never share one.
+    class ModelInstanceCache
+    {
+    public:
+        ModelInstanceCache();
+        ModelInstanceCache(ModelInstanceCache&& moveFrom);
+        ModelInstanceCache& operator= (ModelInstanceCache&& moveFrom);
+        virtual ~ModelInstanceCache();
+
+        // Release the buffer and input layouts, which are otherwise kept until the cache is destroyed.
+        void __cdecl Clear();
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        friend class Model;
+
+        // Prevent copying.
+        ModelInstanceCache(ModelInstanceCache const&) DIRECTX_CTOR_DELETE
+        ModelInstanceCache& operator= (ModelInstanceCache const&) DIRECTX_CTOR_DELETE
+    };
+
+
     //----------------------------------------------------------------------------------
     // A model consists of one or more meshes
     class Model
@@ -125,35 +268,405 @@ namespace DirectX
         ModelMesh::Collection   meshes;
         std::wstring            name;
 
+        // Filled in by the loaders when optimizeMesh is set, so you can tell whether baking the result offline is worthwhile.
+        ModelOptimizationStatistics optimizationStatistics;
+
         // Draw all the meshes in the model
         void XM_CALLCONV Draw( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
                                bool wireframe = false, _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr ) const;
 
+        // Draw only the meshes whose bounds intersect the view frustum
+        void XM_CALLCONV DrawCulled( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                                     bool wireframe = false, _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr ) const;
+
+        // Draw many copies of the model in one pass using hardware instancing, one for each world matrix. Parts whose effect
+        // does not support instancing (see IEffectInstancing), or that are skinned, are drawn once per copy instead. The
+        // transforms and input layouts are kept in the cache, which must not be used by another thread at the same time.
+        void XM_CALLCONV DrawInstanced( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, ModelInstanceCache& cache,
+                                        _In_reads_(count) XMMATRIX const* worlds, size_t count,
+                                        CXMMATRIX view, CXMMATRIX projection,
+                                        bool wireframe = false, _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr ) const;
+
         // Notify model that effects, parts list, or mesh list has changed
         void __cdecl Modified() { mEffectCache.clear(); }
 
         // Update all effects used by the model
         void __cdecl UpdateEffects( _In_ std::function<void DIRECTX_STD_CALLCONV(IEffect*)> setEffect );
 
-        // Loads a model from a Visual Studio Starter Kit .CMO file
+        // Copy the model with its own clones of the effects (see IEffectClone), sharing the buffers and input layouts. Each
+        // copy can then be drawn on a different deferred context at the same time as the others.
+        std::unique_ptr<Model> __cdecl CloneWithEffects() const;
+
+        // Write the model in the cooked format read by CreateFromCooked. Buffers are read back through the immediate
+        // context. Parts without a ModelMaterial (such as those given a custom effect) get a default BasicEffect on load.
+        void __cdecl SaveToCooked( _In_ ID3D11DeviceContext* deviceContext, _In_z_ const wchar_t* szFileName ) const;
+
+        // Loads a model from a Visual Studio Starter Kit .CMO file. With mergeBuffers, all the geometry is packed into one
+        // vertex buffer per vertex stride and one index buffer per index format, using startIndex and vertexOffset to find each part.
+        // With packVertices, vertices are converted to the VertexTypes.h *Packed formats on load, if the device supports them.
+        // With optimizeMesh, triangle lists are reordered for the vertex cache and overdraw, and vertices for fetch locality.
+        // Each loader takes an optional allocator for the model objects and its temporary buffers (see IModelAllocator).
         static std::unique_ptr<Model> __cdecl CreateFromCMO( _In_ ID3D11Device* d3dDevice, _In_reads_bytes_(dataSize) const uint8_t* meshData, size_t dataSize,
-                                                             _In_ IEffectFactory& fxFactory, bool ccw = true, bool pmalpha = false );
+                                                             _In_ IEffectFactory& fxFactory, bool ccw = true, bool pmalpha = false, bool mergeBuffers = false, bool packVertices = false, bool optimizeMesh = false,
+                                                             _In_opt_ IModelAllocator* allocator = nullptr );
         static std::unique_ptr<Model> __cdecl CreateFromCMO( _In_ ID3D11Device* d3dDevice, _In_z_ const wchar_t* szFileName,
-                                                             _In_ IEffectFactory& fxFactory, bool ccw = true, bool pmalpha = false );
+                                                             _In_ IEffectFactory& fxFactory, bool ccw = true, bool pmalpha = false, bool mergeBuffers = false, bool packVertices = false, bool optimizeMesh = false,
+                                                             _In_opt_ IModelAllocator* allocator = nullptr );
 
-        // Loads a model from a DirectX SDK .SDKMESH file
+        // Loads a model from a DirectX SDK .SDKMESH file, optionally merging buffers, packing vertices and optimizing as for CreateFromCMO
         static std::unique_ptr<Model> __cdecl CreateFromSDKMESH( _In_ ID3D11Device* d3dDevice, _In_reads_bytes_(dataSize) const uint8_t* meshData, _In_ size_t dataSize,
-                                                                 _In_ IEffectFactory& fxFactory, bool ccw = false, bool pmalpha = false );
+                                                                 _In_ IEffectFactory& fxFactory, bool ccw = false, bool pmalpha = false, bool mergeBuffers = false, bool packVertices = false, bool optimizeMesh = false,
+                                                                 _In_opt_ IModelAllocator* allocator = nullptr );
         static std::unique_ptr<Model> __cdecl CreateFromSDKMESH( _In_ ID3D11Device* d3dDevice, _In_z_ const wchar_t* szFileName,
-                                                                 _In_ IEffectFactory& fxFactory, bool ccw = false, bool pmalpha = false );
+                                                                 _In_ IEffectFactory& fxFactory, bool ccw = false, bool pmalpha = false, bool mergeBuffers = false, bool packVertices = false, bool optimizeMesh = false,
+                                                                 _In_opt_ IModelAllocator* allocator = nullptr );
 
-        // Loads a model from a .VBO file
+        // Loads a model written by SaveToCooked. The file holds the final buffer contents and input layouts, so loading
+        // is a single read followed by CreateBuffer on each blob in place.
+        static std::unique_ptr<Model> __cdecl CreateFromCooked( _In_ ID3D11Device* d3dDevice, _In_reads_bytes_(dataSize) const uint8_t* meshData, size_t dataSize,
+                                                                _In_ IEffectFactory& fxFactory, _In_opt_ IModelAllocator* allocator = nullptr );
+        static std::unique_ptr<Model> __cdecl CreateFromCooked( _In_ ID3D11Device* d3dDevice, _In_z_ const wchar_t* szFileName,
+                                                                _In_ IEffectFactory& fxFactory, _In_opt_ IModelAllocator* allocator = nullptr );
+
+        // Loads a model from a .VBO file, optionally packing vertices and optimizing as for CreateFromCMO
         static std::unique_ptr<Model> __cdecl CreateFromVBO( _In_ ID3D11Device* d3dDevice, _In_reads_bytes_(dataSize) const uint8_t* meshData, _In_ size_t dataSize,
-                                                             _In_opt_ std::shared_ptr<IEffect> ieffect = nullptr, bool ccw = false, bool pmalpha = false );
+                                                             _In_opt_ std::shared_ptr<IEffect> ieffect = nullptr, bool ccw = false, bool pmalpha = false, bool packVertices = false, bool optimizeMesh = false,
+                                                             _In_opt_ IModelAllocator* allocator = nullptr );
         static std::unique_ptr<Model> __cdecl CreateFromVBO( _In_ ID3D11Device* d3dDevice, _In_z_ const wchar_t* szFileName, 
-                                                             _In_opt_ std::shared_ptr<IEffect> ieffect = nullptr, bool ccw = false, bool pmalpha = false );
+                                                             _In_opt_ std::shared_ptr<IEffect> ieffect = nullptr, bool ccw = false, bool pmalpha = false, bool packVertices = false, bool optimizeMesh = false,
+                                                             _In_opt_ IModelAllocator* allocator = nullptr );
+
+        // Models are allocated from an IModelAllocator when created with new (allocator), otherwise from the heap.
+        static void* __cdecl operator new( size_t size );
+        static void* __cdecl operator new( size_t size, _In_opt_ IModelAllocator* allocator );
+        static void __cdecl operator delete( void* ptr );
+        static void __cdecl operator delete( void* ptr, _In_opt_ IModelAllocator* allocator );
 
     private:
         std::set<IEffect*>  mEffectCache;
     };
- }
\ No newline at end of file
+
+
+    //----------------------------------------------------------------------------------
+    // Chooses between versions of a model with decreasing detail, based on how large it appears on screen
+    class ModelLOD
+    {
+    public:
+        ModelLOD();
+
+        // Add the next, less detailed level. It is used while the projected bounding sphere is at least minScreenSize
+        // (a fraction of the viewport height), and the last level is used for anything smaller. Load every level with
+        // the same effect factory so they share effects and textures.
+        void __cdecl AddLevel( _In_ std::shared_ptr<Model> model, float minScreenSize );
+
+        // Fraction by which the size must pass a threshold before changing level, to stop flickering at the boundary.
+        void __cdecl SetHysteresis( float value ) { mHysteresis = value; }
+
+        // Level to draw for an instance. Pass the level used last frame (or -1) for hysteresis.
+        size_t XM_CALLCONV SelectLevel( FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, size_t previousLevel = size_t(-1) ) const;
+
+        // Projected size of the bounding sphere as a fraction of the viewport height.
+        float XM_CALLCONV GetScreenSize( FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection ) const;
+
+        // Select a level and draw it. If level is given, it supplies the previous level and receives the new one.
+        void XM_CALLCONV Draw( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                               _Inout_opt_ size_t* level = nullptr,
+                               bool wireframe = false, _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr ) const;
+
+        // Update each effect used by any level once
+        void __cdecl UpdateEffects( _In_ std::function<void DIRECTX_STD_CALLCONV(IEffect*)> setEffect );
+
+        size_t __cdecl GetLevelCount() const { return mLevels.size(); }
+        Model* __cdecl GetLevel( size_t index ) const { return mLevels[ index ].model.get(); }
+
+    private:
+        struct Level
+        {
+            std::shared_ptr<Model>  model;
+            float                   minScreenSize;
+        };
+
+        std::vector<Level>  mLevels;
+        BoundingSphere      mBounds;
+        float               mHysteresis;
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // Tests model and mesh bounds against a view frustum, which is built once from the camera and shared by every test
+    class ModelCuller
+    {
+    public:
+        ModelCuller( CXMMATRIX view, CXMMATRIX projection );
+
+        void XM_CALLCONV SetCamera( FXMMATRIX view, CXMMATRIX projection );
+
+        // Could any of this mesh or model be inside the frustum? Relies on ModelMesh::boundingSphere and boundingBox being set.
+        bool XM_CALLCONV IsVisible( const ModelMesh& mesh, FXMMATRIX world ) const;
+        bool XM_CALLCONV IsVisible( const Model& model, FXMMATRIX world ) const;
+
+        // Test many model instances in one pass, setting visible[i] for each one that may be seen. Returns the visible count.
+        size_t __cdecl Cull( _In_reads_(count) Model const* const* models, _In_reads_(count) XMMATRIX const* worlds, size_t count,
+                             _Out_writes_(count) bool* visible ) const;
+
+        // Test every instance in a hierarchy built from models (see BoundingVolumeHierarchy::Build), setting visible[i] for each
+        // instance with a mesh that may be seen. Returns the visible count.
+        size_t __cdecl Cull( const BoundingVolumeHierarchy& bvh, _Out_writes_(bvh.GetInstanceCount()) bool* visible ) const;
+
+        // World space frustum.
+        const BoundingFrustum& __cdecl GetFrustum() const { return mFrustum; }
+
+    private:
+        BoundingFrustum mFrustum;
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // Skips models hidden behind others, using hardware occlusion queries on their bounding boxes. Each frame, Draw the scene
+    // through it, then call IssueQueries once the opaque geometry is in the depth buffer. Results are read back by the Draw
+    // calls of a later frame without waiting for the GPU, so a model that comes into view appears a frame or two late.
+    class ModelOcclusionCuller
+    {
+    public:
+        static const size_t DefaultMaxQueries = 4096;
+
+        // With predicated set, hidden models are skipped by the GPU through ID3D11Predicate instead, with no readback at all.
+        ModelOcclusionCuller( _In_ ID3D11Device* device, size_t maxQueries = DefaultMaxQueries, bool predicated = false );
+        ModelOcclusionCuller( ModelOcclusionCuller&& moveFrom );
+        ModelOcclusionCuller& operator= ( ModelOcclusionCuller&& moveFrom );
+        virtual ~ModelOcclusionCuller();
+
+        // Draws the model unless the latest result for id says it is hidden, and queues its bounding box for IssueQueries.
+        // The id names one model instance from frame to frame, and must be less than maxQueries. Returns false if skipped.
+        bool XM_CALLCONV Draw( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, size_t id, const Model& model,
+                               FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                               bool wireframe = false, _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
+
+        // Draws each queued bounding box inside its own query, testing depth without writing color or depth. Boxes that
+        // cross the near plane are taken as visible without a query. Changes the render states, like the other Draw methods.
+        void XM_CALLCONV IssueQueries( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, FXMMATRIX view, CXMMATRIX projection );
+
+        // Was id hidden at the latest result? Always false in predicated mode.
+        bool __cdecl IsOccluded( size_t id ) const;
+
+        // Forget every result, for example after a camera cut.
+        void __cdecl Reset();
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        ModelOcclusionCuller( ModelOcclusionCuller const& ) DIRECTX_CTOR_DELETE
+        ModelOcclusionCuller& operator= ( ModelOcclusionCuller const& ) DIRECTX_CTOR_DELETE
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // Bounding box tree for culling and picking over many meshes or triangles. It is built with the surface area heuristic
+    // and stored four children to a node, so each step of a query tests four boxes at once.
+    class BoundingVolumeHierarchy
+    {
+    public:
+        BoundingVolumeHierarchy();
+        BoundingVolumeHierarchy(BoundingVolumeHierarchy&& moveFrom);
+        BoundingVolumeHierarchy& operator= (BoundingVolumeHierarchy&& moveFrom);
+        virtual ~BoundingVolumeHierarchy();
+
+        // Build over arbitrary boxes. Query results are indices into the boxes array.
+        void __cdecl Build( _In_reads_(count) const BoundingBox* boxes, size_t count );
+
+        // Build over every mesh of many model instances, using ModelMesh::boundingBox moved by each world matrix. Each result
+        // is one mesh, which GetInstance and GetMesh map back to the models array and Model::meshes.
+        void __cdecl Build( _In_reads_(count) Model const* const* models, _In_reads_(count) XMMATRIX const* worlds, size_t count );
+
+        // Build over a triangle list, for exact picking against a mesh the application keeps on the CPU. Results are triangle indices.
+        void __cdecl Build( _In_reads_(vertexCount) const XMFLOAT3* positions, size_t vertexCount,
+                            _In_reads_(triangleCount * 3) const uint16_t* indices, size_t triangleCount );
+        void __cdecl Build( _In_reads_(vertexCount) const XMFLOAT3* positions, size_t vertexCount,
+                            _In_reads_(triangleCount * 3) const uint32_t* indices, size_t triangleCount );
+
+        // Update the node bounds after things have moved, keeping the tree layout. This is much faster than a rebuild, but
+        // queries slow down as things drift far from where they were at build time. Arguments must match the last Build.
+        void __cdecl Refit( _In_reads_(count) const BoundingBox* boxes, size_t count );
+        void __cdecl Refit( _In_reads_(count) Model const* const* models, _In_reads_(count) XMMATRIX const* worlds, size_t count );
+        void __cdecl Refit( _In_reads_(vertexCount) const XMFLOAT3* positions, size_t vertexCount );
+
+        // Find everything that could be inside the frustum, appending to results. Returns the number found.
+        size_t __cdecl Query( const BoundingFrustum& frustum, std::vector<uint32_t>& results ) const;
+
+        // Find everything intersecting the box, appending to results. Returns the number found.
+        size_t __cdecl Query( const BoundingBox& box, std::vector<uint32_t>& results ) const;
+
+        // Find the closest hit along a ray (direction must be normalized). Box and model builds hit the item bounds,
+        // and triangle builds hit the triangles themselves. Result is set to the index of the item hit.
+        bool XM_CALLCONV Intersects( FXMVECTOR origin, FXMVECTOR direction, _Out_ float& dist, _Out_ uint32_t& result ) const;
+
+        size_t __cdecl GetItemCount() const;
+        size_t __cdecl GetNodeCount() const;
+
+        // Bounds of one item, as given to the last Build or Refit.
+        BoundingBox __cdecl GetItemBounds( uint32_t item ) const;
+
+        // For model builds, the instance (index into the models array) and the mesh (index into Model::meshes) of an item.
+        size_t __cdecl GetInstanceCount() const;
+        size_t __cdecl GetInstance( uint32_t item ) const;
+        size_t __cdecl GetMesh( uint32_t item ) const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        BoundingVolumeHierarchy(BoundingVolumeHierarchy const&) DIRECTX_CTOR_DELETE
+        BoundingVolumeHierarchy& operator= (BoundingVolumeHierarchy const&) DIRECTX_CTOR_DELETE
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // Gathers mesh parts from any number of models, then draws them sorted to avoid redundant state changes
+    class ModelRenderQueue
+    {
+    public:
+        ModelRenderQueue();
+        ModelRenderQueue(ModelRenderQueue&& moveFrom);
+        ModelRenderQueue& operator= (ModelRenderQueue&& moveFrom);
+        virtual ~ModelRenderQueue();
+
+        // Queue all the meshes in a model, or a single mesh. These are referenced rather than copied, so must stay alive until Draw.
+        void XM_CALLCONV Add( const Model& model, FXMMATRIX world );
+        void XM_CALLCONV Add( const ModelMesh& mesh, FXMMATRIX world );
+
+        // Queue only the meshes of a model which may be visible.
+        void XM_CALLCONV Add( const Model& model, FXMMATRIX world, const ModelCuller& culler );
+
+        // Draw everything queued, then empty the queue. Opaque parts are sorted by render state, effect, input layout
+        // and buffers, then alpha parts are drawn afterwards in the order they were queued. The custom state hook is
+        // called after each effect Apply, and since it may change anything, all state is bound again afterwards.
+        void XM_CALLCONV Draw( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, CXMMATRIX view, CXMMATRIX projection,
+                               bool wireframe = false, _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
+
+        // Empty the queue without drawing.
+        void __cdecl Clear();
+
+        size_t __cdecl GetCount() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        ModelRenderQueue(ModelRenderQueue const&) DIRECTX_CTOR_DELETE
+        ModelRenderQueue& operator= (ModelRenderQueue const&) DIRECTX_CTOR_DELETE
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // Loads models on a pool of background worker threads, using the free-threaded device. A model is published as
+    // soon as its vertex and index buffers exist, with a white placeholder standing in for each texture, and its
+    // textures are then loaded through the effect factory on the same workers. Call Update once per frame on the
+    // rendering thread to attach textures that have finished. Effects are not shared with other models (textures
+    // still are). The workers call the effect factory at the same time as each other and as the application, without
+    // any locking of their own, so it must be free threaded, as EffectFactory and DGSLEffectFactory are.
+    enum MODEL_LOAD_STATUS
+    {
+        MODEL_LOAD_PENDING  = 0,
+        MODEL_LOAD_LOADING  = 1,
+        MODEL_LOAD_READY    = 2,    // Drawable, with textures still loading or waiting for Update.
+        MODEL_LOAD_COMPLETE = 3,
+        MODEL_LOAD_FAILED   = 4,
+    };
+
+    class AsyncModelLoader
+    {
+    public:
+        // Opaque ticket for a queued load, which stays valid after the loader is destroyed.
+        class Request;
+
+        typedef std::shared_ptr<Request> RequestHandle;
+
+        AsyncModelLoader(_In_ ID3D11Device* device, IEffectFactory& fxFactory, size_t workerCount = 2);
+        AsyncModelLoader(AsyncModelLoader&& moveFrom);
+        AsyncModelLoader& operator= (AsyncModelLoader&& moveFrom);
+        virtual ~AsyncModelLoader();
+
+        RequestHandle __cdecl LoadSDKMESH( _In_z_ const wchar_t* szFileName, bool ccw = false, bool pmalpha = false );
+        RequestHandle __cdecl LoadCMO( _In_z_ const wchar_t* szFileName, bool ccw = true, bool pmalpha = false );
+
+        // Attach any textures that have finished loading. Call on the thread which draws the models.
+        // Returns the number of requests that became MODEL_LOAD_COMPLETE.
+        size_t __cdecl Update();
+
+        static MODEL_LOAD_STATUS __cdecl GetStatus( _In_ RequestHandle const& request );
+
+        // Blocks until the model can be drawn, or the load has failed. Returns false on timeout.
+        static bool __cdecl Wait( _In_ RequestHandle const& request, unsigned long timeoutMilliseconds = 0xFFFFFFFF );
+
+        // Returns E_PENDING until the model can be drawn, then the load result.
+        static HRESULT __cdecl GetResult( _In_ RequestHandle const& request, _Out_ std::shared_ptr<Model>* model );
+
+        // Number of requests still queued, or with the model or its textures loading.
+        size_t __cdecl GetPendingCount() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        AsyncModelLoader(AsyncModelLoader const&) DIRECTX_CTOR_DELETE
+        AsyncModelLoader& operator= (AsyncModelLoader const&) DIRECTX_CTOR_DELETE
+    };
+
+
+
+    //----------------------------------------------------------------------------------
+    // Skins the vertices of a mesh part once, using stream output, into a VertexPositionNormalTexture buffer which
+    // can then be drawn by any number of later passes with a non-skinned effect such as BasicEffect. The whole of the
+    // part's vertex buffer is skinned, so the part's index buffer, startIndex, and vertexOffset still apply. The part
+    // must have a vbDecl with BLENDINDICES and BLENDWEIGHT elements. Requires Feature Level 10.0 or greater.
+    class ModelPreSkinner
+    {
+    public:
+        explicit ModelPreSkinner(_In_ ID3D11Device* device);
+        ModelPreSkinner(ModelPreSkinner&& moveFrom);
+        ModelPreSkinner& operator= (ModelPreSkinner&& moveFrom);
+        virtual ~ModelPreSkinner();
+
+        // Bone settings, as for SkinnedEffect.
+        void __cdecl SetWeightsPerVertex(int value);
+        void __cdecl SetBoneTransforms(_In_reads_(count) XMMATRIX const* value, size_t count);
+        void __cdecl SetBoneBuffer(_In_opt_ ID3D11ShaderResourceView* value, size_t firstBone = 0, bool dualQuaternion = false);
+
+        // Writes the skinned vertices to outputBuffer. Changes the input assembler, vertex, geometry, and pixel
+        // shader, depth stencil, and stream output state.
+        void __cdecl Skin( _In_ ID3D11DeviceContext* deviceContext, ModelMeshPart const& part, _In_ ID3D11Buffer* outputBuffer );
+
+        // Creates a buffer large enough to hold the skinned vertices of the part.
+        static void __cdecl CreateOutputBuffer( _In_ ID3D11Device* device, ModelMeshPart const& part, _Outptr_ ID3D11Buffer** outputBuffer );
+
+        // Draws the part from its skinned vertices. iinputLayout must be created from VertexPositionNormalTexture::InputElements.
+        static void __cdecl Draw( _In_ ID3D11DeviceContext* deviceContext, ModelMeshPart const& part, _In_ ID3D11Buffer* skinnedBuffer,
+                                  _In_ IEffect* ieffect, _In_ ID3D11InputLayout* iinputLayout,
+                                  _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        ModelPreSkinner(ModelPreSkinner const&) DIRECTX_CTOR_DELETE
+        ModelPreSkinner& operator= (ModelPreSkinner const&) DIRECTX_CTOR_DELETE
+    };
+ }
+
+#pragma warning(pop)
@@ -41,6 +41,68 @@
 
 namespace DirectX
 {
+    // Counters describing the work PrimitiveBatch submitted, and why batches were split.
+    struct PrimitiveBatchStatistics
+    {
+        size_t drawCalls;           // Number of draw calls issued.
+        size_t vertices;            // Number of vertices drawn.
+        size_t indices;             // Number of indices drawn.
+        size_t maps;                // Number of dynamic vertex or index buffer Map calls.
+        size_t discards;            // How many of those maps wrapped around using D3D11_MAP_WRITE_DISCARD.
+        size_t ringWaits;           // Times ring buffer mode had to wait for the GPU before reusing a segment.
+        size_t topologySplits;      // Batches ended by a topology change, indexed/non-indexed change, or strip topology.
+        size_t bufferSplits;        // Batches ended because the vertex or index buffer was full.
+        double gpuMilliseconds;     // Total GPU time of the completed timing measurements (see SetGpuTiming).
+        size_t gpuTimings;          // Number of completed timing measurements included in gpuMilliseconds.
+    };
+
+
+    namespace Internal
+    {
+        class PrimitiveBatchBase;
+    }
+
+
+    // Shared per-frame vertex and index memory for PrimitiveBatch instances recording on deferred contexts. The heap
+    // maps its buffers once per frame on the immediate context, and each batch created with it takes chunks from
+    // them, so batches own no buffers and never map anything themselves. Worker threads can then each fill their own
+    // batch at the same time. Call EndFrame after every batch using the heap has called End, and before executing
+    // the command lists they recorded. The heap must outlive the batches that use it.
+    class PrimitiveBatchHeap
+    {
+    public:
+        static const size_t DefaultVertexBytes = 4 * 1024 * 1024;
+        static const size_t DefaultIndexBytes = 1024 * 1024;
+
+        explicit PrimitiveBatchHeap(_In_ ID3D11DeviceContext* immediateContext, size_t vertexBytes = DefaultVertexBytes, size_t indexBytes = DefaultIndexBytes);
+        PrimitiveBatchHeap(PrimitiveBatchHeap&& moveFrom);
+        PrimitiveBatchHeap& operator= (PrimitiveBatchHeap&& moveFrom);
+        virtual ~PrimitiveBatchHeap();
+
+        // Maps the buffers with D3D11_MAP_WRITE_DISCARD, making the whole heap available again.
+        void __cdecl BeginFrame();
+
+        // Unmaps the buffers, so the command lists drawing from them can be executed.
+        void __cdecl EndFrame();
+
+        // How much of the heap has been handed out this frame, for tuning its size.
+        size_t __cdecl GetVertexBytesUsed() const;
+        size_t __cdecl GetIndexBytesUsed() const;
+
+        // Private implementation (opaque outside of PrimitiveBatch).
+        class Impl;
+
+    private:
+        std::unique_ptr<Impl> pImpl;
+
+        friend class Internal::PrimitiveBatchBase;
+
+        // Prevent copying.
+        PrimitiveBatchHeap(PrimitiveBatchHeap const&) DIRECTX_CTOR_DELETE
+        PrimitiveBatchHeap& operator= (PrimitiveBatchHeap const&) DIRECTX_CTOR_DELETE
+    };
+
+
     namespace Internal
     {
         // Base class, not to be used directly: clients should access this via the derived PrimitiveBatch<T>.
@@ -48,6 +110,7 @@ namespace DirectX
         {
         protected:
             PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize);
+            PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, _In_ PrimitiveBatchHeap* heap, size_t maxIndices, size_t maxVertices, size_t vertexSize);
             PrimitiveBatchBase(PrimitiveBatchBase&& moveFrom);
             PrimitiveBatchBase& operator= (PrimitiveBatchBase&& moveFrom);
             virtual ~PrimitiveBatchBase();
@@ -57,9 +120,24 @@ namespace DirectX
             void __cdecl Begin();
             void __cdecl End();
 
+            // Statistics accumulate until reset, so call ResetStatistics once per frame to get per-frame counts.
+            PrimitiveBatchStatistics __cdecl GetStatistics() const;
+            void __cdecl ResetStatistics();
+
+            // GPU timing wraps each Begin/End pair in timestamp queries. Results arrive a few frames late,
+            // as they are read back without stalling. Only supported on the immediate context.
+            void __cdecl SetGpuTiming( bool enable );
+
+            // Ring buffer mode is for very large buffers. Instead of discarding them each time they fill, it keeps
+            // appending with D3D11_MAP_WRITE_NO_OVERWRITE, splitting each buffer into quarters and only waiting
+            // on an event query before overwriting a quarter the GPU may still be reading. Each draw must fit in
+            // a quarter of the buffers. Only supported on the immediate context.
+            void __cdecl SetRingBufferMode( bool enable );
+
         protected:
             // Internal, untyped drawing method.
             void __cdecl Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint16_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
+            void __cdecl Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint32_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
 
         private:
             // Private implementation.
@@ -81,10 +159,17 @@ namespace DirectX
         static const size_t DefaultBatchSize = 2048;
 
     public:
+        // Batches with more than 65536 vertices store 32 bit indices.
         PrimitiveBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices = DefaultBatchSize * 3, size_t maxVertices = DefaultBatchSize)
           : PrimitiveBatchBase(deviceContext, maxIndices, maxVertices, sizeof(TVertex))
         { }
 
+        // Draws from chunks of a shared heap rather than buffers of its own. The context must be deferred, and
+        // maxIndices and maxVertices set the size of each chunk, which is the most a single batch can hold.
+        PrimitiveBatch(_In_ ID3D11DeviceContext* deviceContext, _In_ PrimitiveBatchHeap* heap, size_t maxIndices = DefaultBatchSize * 3, size_t maxVertices = DefaultBatchSize)
+          : PrimitiveBatchBase(deviceContext, heap, maxIndices, maxVertices, sizeof(TVertex))
+        { }
+
         PrimitiveBatch(PrimitiveBatch&& moveFrom)
           : PrimitiveBatchBase(std::move(moveFrom))
         { }
@@ -118,6 +203,17 @@ namespace DirectX
         }
 
 
+        // 32 bit indices, for primitives with more than 65536 vertices.
+        void __cdecl DrawIndexed(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(indexCount) uint32_t const* indices, size_t indexCount, _In_reads_(vertexCount) TVertex const* vertices, size_t vertexCount)
+        {
+            void* mappedVertices;
+
+            PrimitiveBatchBase::Draw(topology, true, indices, indexCount, vertexCount, &mappedVertices);
+
+            memcpy(mappedVertices, vertices, vertexCount * sizeof(TVertex));
+        }
+
+
         void __cdecl DrawLine(TVertex const& v1, TVertex const& v2)
         {
             TVertex* mappedVertices;
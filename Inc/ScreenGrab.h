@@ -35,6 +35,18 @@
 #pragma warning(pop)
 
 #include <functional>
+#include <memory>
+
+// VS 2010/2012 do not support =default =delete
+#ifndef DIRECTX_CTOR_DEFAULT
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#define DIRECTX_CTOR_DEFAULT {}
+#define DIRECTX_CTOR_DELETE ;
+#else
+#define DIRECTX_CTOR_DEFAULT =default;
+#define DIRECTX_CTOR_DELETE =delete;
+#endif
+#endif
 
 // VS 2010 doesn't support explicit calling convention for std::function
 #ifndef DIRECTX_STD_CALLCONV
@@ -61,4 +73,116 @@ namespace DirectX
                                           _In_opt_ std::function<void DIRECTX_STD_CALLCONV(IPropertyBag2*)> setCustomProps = nullptr );
 
 #endif
+
+    // Asynchronous version: each capture is copied into one of a small ring of staging textures, then Update maps
+    // those the GPU has finished with (using D3D11_MAP_FLAG_DO_NOT_WAIT) and hands the pixels to a background
+    // thread, which writes the file. The CPU never waits for the GPU, so captures do not cause a hitch. Capture,
+    // Update, and Flush must all be called with the immediate context.
+    class AsyncScreenGrab
+    {
+    public:
+        // Invoked on the background thread once the file has been written, or has failed.
+        typedef std::function<void DIRECTX_STD_CALLCONV(HRESULT hr, _In_z_ LPCWSTR fileName)> Callback;
+
+        explicit AsyncScreenGrab(_In_ ID3D11Device* device, size_t ringSize = 3);
+        AsyncScreenGrab(AsyncScreenGrab&& moveFrom);
+        AsyncScreenGrab& operator= (AsyncScreenGrab&& moveFrom);
+        virtual ~AsyncScreenGrab();
+
+        // Each returns S_FALSE, dropping the capture, if every staging texture is still in flight. For WIC
+        // files, setCustomProps is also invoked on the background thread.
+        HRESULT __cdecl CaptureDDS( _In_ ID3D11DeviceContext* pContext,
+                                    _In_ ID3D11Resource* pSource,
+                                    _In_z_ LPCWSTR fileName,
+                                    _In_opt_ Callback callback = nullptr );
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+
+        HRESULT __cdecl CaptureWIC( _In_ ID3D11DeviceContext* pContext,
+                                    _In_ ID3D11Resource* pSource,
+                                    _In_ REFGUID guidContainerFormat,
+                                    _In_z_ LPCWSTR fileName,
+                                    _In_opt_ const GUID* targetFormat = nullptr,
+                                    _In_opt_ std::function<void DIRECTX_STD_CALLCONV(IPropertyBag2*)> setCustomProps = nullptr,
+                                    _In_opt_ Callback callback = nullptr );
+
+#endif
+
+        // Call once per frame: reads back whichever captures the GPU has finished, without waiting for the rest.
+        void __cdecl Update(_In_ ID3D11DeviceContext* pContext);
+
+        // Reads back every outstanding capture, waiting for the GPU if need be, then waits for all the files to be written.
+        void __cdecl Flush(_In_ ID3D11DeviceContext* pContext);
+
+        // Captures that have been queued but not yet written.
+        size_t __cdecl GetPendingCount() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        AsyncScreenGrab(AsyncScreenGrab const&) DIRECTX_CTOR_DELETE
+        AsyncScreenGrab& operator= (AsyncScreenGrab const&) DIRECTX_CTOR_DELETE
+    };
+
+
+    // Continuous capture of frames that all share one size and format, for video or regression runs. The staging
+    // textures, CPU frame buffers, and (for raw output) the file handle are created once and reused, and frames
+    // go through a queue to background writer threads.
+    enum SCREEN_CAPTURE_OUTPUT
+    {
+        SCREEN_CAPTURE_RAW = 0,             // Every frame appended to fileName, tightly packed with no header
+        SCREEN_CAPTURE_DDS_SEQUENCE = 1,    // One .dds file per frame
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+        SCREEN_CAPTURE_WIC_SEQUENCE = 2,    // One WIC file per frame, in the given container format (PNG by default)
+#endif
+    };
+
+    class ScreenCaptureSession
+    {
+    public:
+        // For image sequences the frame number is inserted before the extension of fileName (frame.png -> frame00000.png).
+        // Raw output is written by a single thread so frames stay in order, while sequences use writerCount threads.
+        ScreenCaptureSession(_In_ ID3D11Device* device,
+                             UINT width,
+                             UINT height,
+                             DXGI_FORMAT format,
+                             SCREEN_CAPTURE_OUTPUT output,
+                             _In_z_ LPCWSTR fileName,
+                             _In_opt_ const GUID* guidContainerFormat = nullptr,
+                             size_t ringSize = 4,
+                             size_t writerCount = 2);
+
+        ScreenCaptureSession(ScreenCaptureSession&& moveFrom);
+        ScreenCaptureSession& operator= (ScreenCaptureSession&& moveFrom);
+        virtual ~ScreenCaptureSession();
+
+        // Reads back finished frames, then queues this one. The source must match the session's size and format
+        // (MSAA sources are resolved). Returns S_FALSE, counting a dropped frame, if the GPU or the writers are too
+        // far behind. Must be called with the immediate context.
+        HRESULT __cdecl CaptureFrame(_In_ ID3D11DeviceContext* pContext, _In_ ID3D11Resource* pSource);
+
+        // Reads back and writes every outstanding frame, waiting as needed.
+        void __cdecl Flush(_In_ ID3D11DeviceContext* pContext);
+
+        size_t __cdecl GetFrameCount() const;
+        size_t __cdecl GetDroppedFrameCount() const;
+        size_t __cdecl GetWrittenFrameCount() const;
+
+        // S_OK, or the first error hit while writing frames.
+        HRESULT __cdecl GetWriteStatus() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        ScreenCaptureSession(ScreenCaptureSession const&) DIRECTX_CTOR_DELETE
+        ScreenCaptureSession& operator= (ScreenCaptureSession const&) DIRECTX_CTOR_DELETE
+    };
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+//--------------------------------------------------------------------------------------
+// File: ShapeBatch.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+#include <d3d11_x.h>
+#else
+#include <d3d11_1.h>
+#endif
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <memory>
+
+// VS 2010/2012 do not support =default =delete
+#ifndef DIRECTX_CTOR_DEFAULT
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#define DIRECTX_CTOR_DEFAULT {}
+#define DIRECTX_CTOR_DELETE ;
+#else
+#define DIRECTX_CTOR_DEFAULT =default;
+#define DIRECTX_CTOR_DELETE =delete;
+#endif
+#endif
+
+#pragma warning(push)
+#pragma warning(disable: 4005)
+#include <stdint.h>
+#pragma warning(pop)
+
+
+namespace DirectX
+{
+    #if (DIRECTX_MATH_VERSION < 305) && !defined(XM_CALLCONV)
+    #define XM_CALLCONV __fastcall
+    typedef const XMVECTOR& HXMVECTOR;
+    typedef const XMMATRIX& FXMMATRIX;
+    #endif
+
+    // Draws many copies of a few fixed shapes, such as debug bounding volumes, using one instanced draw per shape.
+    // The shape geometry lives in static buffers, so each Draw call only records a transform and a color, in place of
+    // the full set of vertices PrimitiveBatch would generate.
+    //
+    // Like PrimitiveBatch, ShapeBatch does not set any shaders or state. Use a BasicEffect with both vertex color
+    // and instancing enabled, and an input layout made from ShapeBatch::InputElements: the per-instance color
+    // feeds the effect's vertex color input. Requires Feature Level 9.3 or greater.
+    class ShapeBatch
+    {
+    public:
+        // Built-in unit shapes, drawn as line lists. Further shapes can be added with AddShape.
+        enum Shape
+        {
+            Shape_Box,      // Edges of the cube from -1 to 1 on each axis.
+            Shape_Sphere,   // Three unit circles, one around each axis.
+            Shape_Ring,     // Unit circle in the XZ plane.
+
+            Shape_BuiltInCount,
+        };
+
+        explicit ShapeBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxInstances = DefaultMaxInstances);
+        ShapeBatch(ShapeBatch&& moveFrom);
+        ShapeBatch& operator= (ShapeBatch&& moveFrom);
+        virtual ~ShapeBatch();
+
+        // Adds a custom shape, returning the index to pass to Draw. Cannot be called inside a Begin/End pair.
+        size_t __cdecl AddShape(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(vertexCount) XMFLOAT3 const* positions, size_t vertexCount,
+                                _In_reads_(indexCount) uint16_t const* indices, size_t indexCount);
+
+        // Begin/End a batch. Instances are collected per shape, then End issues one DrawIndexedInstanced per shape used.
+        void __cdecl Begin();
+        void __cdecl End();
+
+        // Draws the unit shape with the given world transform (affine only) and color.
+        void XM_CALLCONV Draw(size_t shape, FXMMATRIX transform, FXMVECTOR color);
+
+        // Helpers for the usual bounding volumes.
+        void XM_CALLCONV Draw(BoundingBox const& box, FXMVECTOR color);
+        void XM_CALLCONV Draw(BoundingOrientedBox const& box, FXMVECTOR color);
+        void XM_CALLCONV Draw(BoundingSphere const& sphere, FXMVECTOR color);
+
+        // Input layout: SV_Position from slot 0, then INSTMATRIX0-2 and COLOR per instance from slot 1.
+        static const int InputElementCount = 5;
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+
+        static const size_t DefaultMaxInstances = 4096;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        ShapeBatch(ShapeBatch const&) DIRECTX_CTOR_DELETE
+        ShapeBatch& operator= (ShapeBatch const&) DIRECTX_CTOR_DELETE
+    };
+}
@@ -14,7 +14,9 @@
 #pragma once
 
 #include <functional>
+#include <malloc.h>
 #include <memory.h>
+#include <memory>
 
 #include <DirectXMath.h>
 #include <DirectXPackedVector.h>
@@ -191,6 +193,7 @@ struct Vector3 : public XMFLOAT3
 
     static void Lerp( const Vector3& v1, const Vector3& v2, float t, Vector3& result );
     static Vector3 Lerp( const Vector3& v1, const Vector3& v2, float t );
+    static void Lerp( _In_reads_(count) const Vector3* v1array, _In_reads_(count) const Vector3* v2array, size_t count, float t, _Out_writes_(count) Vector3* resultArray );
 
     static void SmoothStep( const Vector3& v1, const Vector3& v2, float t, Vector3& result );
     static Vector3 SmoothStep( const Vector3& v1, const Vector3& v2, float t );
@@ -473,6 +476,9 @@ struct Matrix : public XMFLOAT4X4
     static void Transform( const Matrix& M, const Quaternion& rotation, Matrix& result );
     static Matrix Transform( const Matrix& M, const Quaternion& rotation );
 
+    static void Multiply( _In_reads_(count) const Matrix* marray, size_t count, const Matrix& M, _Out_writes_(count) Matrix* resultArray );
+    static void Multiply( _In_reads_(count) const Matrix* m1array, _In_reads_(count) const Matrix* m2array, size_t count, _Out_writes_(count) Matrix* resultArray );
+
     // Constants
     static const Matrix Identity;
 };
@@ -584,9 +590,11 @@ struct Quaternion : public XMFLOAT4
 
     static void Lerp( const Quaternion& q1, const Quaternion& q2, float t, Quaternion& result );
     static Quaternion Lerp( const Quaternion& q1, const Quaternion& q2, float t );
+    static void Lerp( _In_reads_(count) const Quaternion* q1array, _In_reads_(count) const Quaternion* q2array, size_t count, float t, _Out_writes_(count) Quaternion* resultArray );
 
     static void Slerp( const Quaternion& q1, const Quaternion& q2, float t, Quaternion& result );
     static Quaternion Slerp( const Quaternion& q1, const Quaternion& q2, float t );
+    static void Slerp( _In_reads_(count) const Quaternion* q1array, _In_reads_(count) const Quaternion* q2array, size_t count, float t, _Out_writes_(count) Quaternion* resultArray );
 
     static void Concatenate( const Quaternion& q1, const Quaternion& q2, Quaternion& result );
     static Quaternion Concatenate( const Quaternion& q1, const Quaternion& q2 );
@@ -713,6 +721,142 @@ public:
     bool Intersects( const Plane& plane, _Out_ float& Dist ) const;
 };
 
+//------------------------------------------------------------------------------
+// Structure-of-arrays storage for bulk Vector3 math
+class Vector3Array
+{
+public:
+    // Reference to one element, so array[i].x and array[i] = v work in place
+    struct Element
+    {
+        float& x;
+        float& y;
+        float& z;
+
+        Element( float& _x, float& _y, float& _z ) : x(_x), y(_y), z(_z) {}
+
+        operator Vector3() const { return Vector3( x, y, z ); }
+
+        Element& operator= ( const Vector3& V ) { x = V.x; y = V.y; z = V.z; return *this; }
+        Element& operator= ( const Element& E ) { x = E.x; y = E.y; z = E.z; return *this; }
+        Element& operator+= ( const Vector3& V ) { x += V.x; y += V.y; z += V.z; return *this; }
+        Element& operator-= ( const Vector3& V ) { x -= V.x; y -= V.y; z -= V.z; return *this; }
+        Element& operator*= ( float S ) { x *= S; y *= S; z *= S; return *this; }
+    };
+
+    Vector3Array() : mCount(0), mCapacity(0) {}
+    explicit Vector3Array( size_t count );
+    Vector3Array( _In_reads_(count) const Vector3* varray, size_t count );
+
+    Vector3Array( const Vector3Array& other );
+    Vector3Array( Vector3Array&& other );
+
+    Vector3Array& operator= ( const Vector3Array& other );
+    Vector3Array& operator= ( Vector3Array&& other );
+
+    size_t Count() const { return mCount; }
+
+    // Keeps existing elements, new elements are zero
+    void Resize( size_t count );
+
+    // Element access
+    Element operator[] ( size_t index );
+    Vector3 operator[] ( size_t index ) const;
+
+    // Component streams are 16-byte aligned and padded to a multiple of 4 elements.
+    // The values of the padding elements are unspecified.
+    float* X() { return mData.get(); }
+    float* Y() { return mData.get() + mCapacity; }
+    float* Z() { return mData.get() + mCapacity * 2; }
+
+    const float* X() const { return mData.get(); }
+    const float* Y() const { return mData.get() + mCapacity; }
+    const float* Z() const { return mData.get() + mCapacity * 2; }
+
+    // Conversion to and from arrays of Vector3, for use with the array versions of Vector3 methods
+    void Load( _In_reads_(count) const Vector3* varray, size_t count );
+    void Store( _Out_writes_(count) Vector3* resultArray, size_t count ) const;
+
+    // Bulk operations, four elements at a time. Arguments must be the same size.
+    Vector3Array& operator+= ( const Vector3Array& V );
+    Vector3Array& operator-= ( const Vector3Array& V );
+    Vector3Array& operator*= ( float S );
+
+    // this += V * S, such as integrating velocities
+    void AddScaled( const Vector3Array& V, float S );
+
+    // Results may be the same object as an input
+    static void Lerp( const Vector3Array& v1, const Vector3Array& v2, float t, Vector3Array& result );
+    static void Transform( const Vector3Array& v, const Matrix& m, Vector3Array& result );
+    static void TransformNormal( const Vector3Array& v, const Matrix& m, Vector3Array& result );
+
+private:
+    struct aligned_deleter { void operator()(void* p) { _aligned_free(p); } };
+
+    std::unique_ptr<float[], aligned_deleter> mData;
+    size_t mCount;
+    size_t mCapacity;
+};
+
+//------------------------------------------------------------------------------
+// Structure-of-arrays storage for scale/rotation/translation transforms, such as
+// animation poses
+class TransformArray
+{
+public:
+    TransformArray() : mCount(0), mCapacity(0) {}
+    explicit TransformArray( size_t count );
+
+    TransformArray( const TransformArray& other );
+    TransformArray( TransformArray&& other );
+
+    TransformArray& operator= ( const TransformArray& other );
+    TransformArray& operator= ( TransformArray&& other );
+
+    size_t Count() const { return mCount; }
+
+    // Keeps existing elements, new elements are the identity transform
+    void Resize( size_t count );
+
+    // Element access
+    void Set( size_t index, const Vector3& scale, const Quaternion& rotation, const Vector3& translation );
+    void Get( size_t index, Vector3& scale, Quaternion& rotation, Vector3& translation ) const;
+
+    void SetScale( size_t index, const Vector3& scale );
+    void SetRotation( size_t index, const Quaternion& rotation );
+    void SetTranslation( size_t index, const Vector3& translation );
+
+    Vector3 GetScale( size_t index ) const;
+    Quaternion GetRotation( size_t index ) const;
+    Vector3 GetTranslation( size_t index ) const;
+
+    Matrix GetMatrix( size_t index ) const;
+
+    // Builds scale * rotation * translation matrices four at a time. The XMMATRIX
+    // version writes 16-byte aligned results suitable for IEffectSkinning::SetBoneTransforms.
+    void GetMatrices( _Out_writes_(count) XMMATRIX* result, size_t count ) const;
+    void GetMatrices( _Out_writes_(count) Matrix* result, size_t count ) const;
+
+    // Pose blending, four transforms at a time. Rotations use normalized lerp or slerp.
+    // Arguments must be the same size, and the result may be the same object as an input.
+    static void Lerp( const TransformArray& t1, const TransformArray& t2, float t, TransformArray& result );
+    static void Slerp( const TransformArray& t1, const TransformArray& t2, float t, TransformArray& result );
+
+private:
+    enum STREAM { SX, SY, SZ, RX, RY, RZ, RW, TX, TY, TZ, STREAM_COUNT };
+
+    float* Stream( STREAM s ) { return mData.get() + mCapacity * s; }
+    const float* Stream( STREAM s ) const { return mData.get() + mCapacity * s; }
+
+    void ComposeMatrices( size_t index, _Out_writes_(4) XMMATRIX* result ) const;
+
+    struct aligned_deleter { void operator()(void* p) { _aligned_free(p); } };
+
+    std::unique_ptr<float[], aligned_deleter> mData;
+    size_t mCount;
+    size_t mCapacity;
+};
+
 #include "SimpleMath.inl"
 
 }; // namespace SimpleMath
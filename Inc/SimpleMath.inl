@@ -920,6 +920,30 @@ inline Vector3 Vector3::Lerp( const Vector3& v1, const Vector3& v2, float t )
     return result;
 }
 
+inline void Vector3::Lerp( const Vector3* v1array, const Vector3* v2array, size_t count, float t, Vector3* resultArray )
+{
+    using namespace DirectX;
+
+    // Lerp is component-wise, so the arrays are processed as packed floats four at a time
+    auto a = reinterpret_cast<const float*>( v1array );
+    auto b = reinterpret_cast<const float*>( v2array );
+    auto r = reinterpret_cast<float*>( resultArray );
+
+    size_t n = count * 3;
+    size_t i = 0;
+    for( ; i + 4 <= n; i += 4 )
+    {
+        XMVECTOR x1 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( a + i ) );
+        XMVECTOR x2 = XMLoadFloat4( reinterpret_cast<const XMFLOAT4*>( b + i ) );
+        XMStoreFloat4( reinterpret_cast<XMFLOAT4*>( r + i ), XMVectorLerp( x1, x2, t ) );
+    }
+
+    for( ; i < n; ++i )
+    {
+        r[ i ] = a[ i ] + t * ( b[ i ] - a[ i ] );
+    }
+}
+
 inline void Vector3::SmoothStep( const Vector3& v1, const Vector3& v2, float t, Vector3& result )
 {
     using namespace DirectX;
@@ -2541,6 +2565,30 @@ inline Matrix Matrix::Transform( const Matrix& M, const Quaternion& rotation )
     return result;
 }
 
+inline void Matrix::Multiply( const Matrix* marray, size_t count, const Matrix& M, Matrix* resultArray )
+{
+    using namespace DirectX;
+    XMMATRIX m2 = XMLoadFloat4x4( &M );
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        XMMATRIX m1 = XMLoadFloat4x4( &marray[ i ] );
+        XMStoreFloat4x4( &resultArray[ i ], XMMatrixMultiply( m1, m2 ) );
+    }
+}
+
+inline void Matrix::Multiply( const Matrix* m1array, const Matrix* m2array, size_t count, Matrix* resultArray )
+{
+    using namespace DirectX;
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        XMMATRIX m1 = XMLoadFloat4x4( &m1array[ i ] );
+        XMMATRIX m2 = XMLoadFloat4x4( &m2array[ i ] );
+        XMStoreFloat4x4( &resultArray[ i ], XMMatrixMultiply( m1, m2 ) );
+    }
+}
+
 
 /****************************************************************************
  *
@@ -2977,6 +3025,58 @@ inline Quaternion Quaternion::Lerp( const Quaternion& q1, const Quaternion& q2,
     return result;
 }
 
+inline void Quaternion::Lerp( const Quaternion* q1array, const Quaternion* q2array, size_t count, float t, Quaternion* resultArray )
+{
+    using namespace DirectX;
+    XMVECTOR tv = XMVectorReplicate( t );
+    XMVECTOR t1v = XMVectorReplicate( 1.f - t );
+
+    // Four quaternions at a time, transposed so each vector holds one component
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4 )
+    {
+        XMMATRIX Q0 = XMMatrixTranspose( XMMATRIX( XMLoadFloat4( &q1array[i] ), XMLoadFloat4( &q1array[i + 1] ),
+                                                   XMLoadFloat4( &q1array[i + 2] ), XMLoadFloat4( &q1array[i + 3] ) ) );
+        XMMATRIX Q1 = XMMatrixTranspose( XMMATRIX( XMLoadFloat4( &q2array[i] ), XMLoadFloat4( &q2array[i + 1] ),
+                                                   XMLoadFloat4( &q2array[i + 2] ), XMLoadFloat4( &q2array[i + 3] ) ) );
+
+        XMVECTOR dot = XMVectorMultiply( Q0.r[0], Q1.r[0] );
+        dot = XMVectorMultiplyAdd( Q0.r[1], Q1.r[1], dot );
+        dot = XMVectorMultiplyAdd( Q0.r[2], Q1.r[2], dot );
+        dot = XMVectorMultiplyAdd( Q0.r[3], Q1.r[3], dot );
+
+        XMVECTOR t2v = XMVectorSelect( tv, XMVectorNegate( tv ), XMVectorLess( dot, XMVectorZero() ) );
+
+        XMMATRIX R;
+        R.r[0] = XMVectorMultiplyAdd( Q1.r[0], t2v, XMVectorMultiply( Q0.r[0], t1v ) );
+        R.r[1] = XMVectorMultiplyAdd( Q1.r[1], t2v, XMVectorMultiply( Q0.r[1], t1v ) );
+        R.r[2] = XMVectorMultiplyAdd( Q1.r[2], t2v, XMVectorMultiply( Q0.r[2], t1v ) );
+        R.r[3] = XMVectorMultiplyAdd( Q1.r[3], t2v, XMVectorMultiply( Q0.r[3], t1v ) );
+
+        XMVECTOR lengthSq = XMVectorMultiply( R.r[0], R.r[0] );
+        lengthSq = XMVectorMultiplyAdd( R.r[1], R.r[1], lengthSq );
+        lengthSq = XMVectorMultiplyAdd( R.r[2], R.r[2], lengthSq );
+        lengthSq = XMVectorMultiplyAdd( R.r[3], R.r[3], lengthSq );
+
+        XMVECTOR invLength = XMVectorReciprocalSqrt( lengthSq );
+        R.r[0] = XMVectorMultiply( R.r[0], invLength );
+        R.r[1] = XMVectorMultiply( R.r[1], invLength );
+        R.r[2] = XMVectorMultiply( R.r[2], invLength );
+        R.r[3] = XMVectorMultiply( R.r[3], invLength );
+
+        R = XMMatrixTranspose( R );
+        XMStoreFloat4( &resultArray[i], R.r[0] );
+        XMStoreFloat4( &resultArray[i + 1], R.r[1] );
+        XMStoreFloat4( &resultArray[i + 2], R.r[2] );
+        XMStoreFloat4( &resultArray[i + 3], R.r[3] );
+    }
+
+    for( ; i < count; ++i )
+    {
+        Lerp( q1array[i], q2array[i], t, resultArray[i] );
+    }
+}
+
 inline void Quaternion::Slerp( const Quaternion& q1, const Quaternion& q2, float t, Quaternion& result )
 {
     using namespace DirectX;
@@ -2996,6 +3096,64 @@ inline Quaternion Quaternion::Slerp( const Quaternion& q1, const Quaternion& q2,
     return result;
 }
 
+inline void Quaternion::Slerp( const Quaternion* q1array, const Quaternion* q2array, size_t count, float t, Quaternion* resultArray )
+{
+    using namespace DirectX;
+    static const XMVECTORF32 OneMinusEpsilon = { 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f };
+
+    XMVECTOR tv = XMVectorReplicate( t );
+    XMVECTOR t1v = XMVectorReplicate( 1.f - t );
+
+    // Four quaternions at a time, transposed so each vector holds one component
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4 )
+    {
+        XMMATRIX Q0 = XMMatrixTranspose( XMMATRIX( XMLoadFloat4( &q1array[i] ), XMLoadFloat4( &q1array[i + 1] ),
+                                                   XMLoadFloat4( &q1array[i + 2] ), XMLoadFloat4( &q1array[i + 3] ) ) );
+        XMMATRIX Q1 = XMMatrixTranspose( XMMATRIX( XMLoadFloat4( &q2array[i] ), XMLoadFloat4( &q2array[i + 1] ),
+                                                   XMLoadFloat4( &q2array[i + 2] ), XMLoadFloat4( &q2array[i + 3] ) ) );
+
+        XMVECTOR cosOmega = XMVectorMultiply( Q0.r[0], Q1.r[0] );
+        cosOmega = XMVectorMultiplyAdd( Q0.r[1], Q1.r[1], cosOmega );
+        cosOmega = XMVectorMultiplyAdd( Q0.r[2], Q1.r[2], cosOmega );
+        cosOmega = XMVectorMultiplyAdd( Q0.r[3], Q1.r[3], cosOmega );
+
+        XMVECTOR sign = XMVectorSelect( g_XMOne, g_XMNegativeOne, XMVectorLess( cosOmega, XMVectorZero() ) );
+        cosOmega = XMVectorMultiply( cosOmega, sign );
+
+        XMVECTOR sinOmega = XMVectorSqrt( XMVectorNegativeMultiplySubtract( cosOmega, cosOmega, g_XMOne ) );
+        XMVECTOR omega = XMVectorATan2( sinOmega, cosOmega );
+        XMVECTOR invSinOmega = XMVectorReciprocal( sinOmega );
+
+        XMVECTOR s0 = XMVectorMultiply( XMVectorSin( XMVectorMultiply( t1v, omega ) ), invSinOmega );
+        XMVECTOR s1 = XMVectorMultiply( XMVectorSin( XMVectorMultiply( tv, omega ) ), invSinOmega );
+
+        // Nearly identical rotations use linear interpolation, matching XMQuaternionSlerp
+        XMVECTOR control = XMVectorLess( cosOmega, OneMinusEpsilon );
+        s0 = XMVectorSelect( t1v, s0, control );
+        s1 = XMVectorMultiply( XMVectorSelect( tv, s1, control ), sign );
+
+        XMMATRIX R;
+        R.r[0] = XMVectorMultiplyAdd( Q1.r[0], s1, XMVectorMultiply( Q0.r[0], s0 ) );
+        R.r[1] = XMVectorMultiplyAdd( Q1.r[1], s1, XMVectorMultiply( Q0.r[1], s0 ) );
+        R.r[2] = XMVectorMultiplyAdd( Q1.r[2], s1, XMVectorMultiply( Q0.r[2], s0 ) );
+        R.r[3] = XMVectorMultiplyAdd( Q1.r[3], s1, XMVectorMultiply( Q0.r[3], s0 ) );
+
+        R = XMMatrixTranspose( R );
+        XMStoreFloat4( &resultArray[i], R.r[0] );
+        XMStoreFloat4( &resultArray[i + 1], R.r[1] );
+        XMStoreFloat4( &resultArray[i + 2], R.r[2] );
+        XMStoreFloat4( &resultArray[i + 3], R.r[3] );
+    }
+
+    for( ; i < count; ++i )
+    {
+        XMVECTOR Q0 = XMLoadFloat4( &q1array[i] );
+        XMVECTOR Q1 = XMLoadFloat4( &q2array[i] );
+        XMStoreFloat4( &resultArray[i], XMQuaternionSlerp( Q0, Q1, t ) );
+    }
+}
+
 inline void Quaternion::Concatenate( const Quaternion& q1, const Quaternion& q2, Quaternion& result )
 {
     using namespace DirectX;
@@ -3407,3 +3565,96 @@ inline bool Ray::Intersects( const Plane& plane, _Out_ float& Dist ) const
         }
     }
 }
+
+
+/****************************************************************************
+ *
+ * Vector3Array
+ *
+ ****************************************************************************/
+
+inline Vector3Array::Element Vector3Array::operator[] ( size_t index )
+{
+    return Element( X()[ index ], Y()[ index ], Z()[ index ] );
+}
+
+inline Vector3 Vector3Array::operator[] ( size_t index ) const
+{
+    return Vector3( X()[ index ], Y()[ index ], Z()[ index ] );
+}
+
+
+/****************************************************************************
+ *
+ * TransformArray
+ *
+ ****************************************************************************/
+
+inline void TransformArray::Set( size_t index, const Vector3& scale, const Quaternion& rotation, const Vector3& translation )
+{
+    SetScale( index, scale );
+    SetRotation( index, rotation );
+    SetTranslation( index, translation );
+}
+
+inline void TransformArray::Get( size_t index, Vector3& scale, Quaternion& rotation, Vector3& translation ) const
+{
+    scale = GetScale( index );
+    rotation = GetRotation( index );
+    translation = GetTranslation( index );
+}
+
+inline void TransformArray::SetScale( size_t index, const Vector3& scale )
+{
+    Stream( SX )[ index ] = scale.x;
+    Stream( SY )[ index ] = scale.y;
+    Stream( SZ )[ index ] = scale.z;
+}
+
+inline void TransformArray::SetRotation( size_t index, const Quaternion& rotation )
+{
+    Stream( RX )[ index ] = rotation.x;
+    Stream( RY )[ index ] = rotation.y;
+    Stream( RZ )[ index ] = rotation.z;
+    Stream( RW )[ index ] = rotation.w;
+}
+
+inline void TransformArray::SetTranslation( size_t index, const Vector3& translation )
+{
+    Stream( TX )[ index ] = translation.x;
+    Stream( TY )[ index ] = translation.y;
+    Stream( TZ )[ index ] = translation.z;
+}
+
+inline Vector3 TransformArray::GetScale( size_t index ) const
+{
+    return Vector3( Stream( SX )[ index ], Stream( SY )[ index ], Stream( SZ )[ index ] );
+}
+
+inline Quaternion TransformArray::GetRotation( size_t index ) const
+{
+    return Quaternion( Stream( RX )[ index ], Stream( RY )[ index ], Stream( RZ )[ index ], Stream( RW )[ index ] );
+}
+
+inline Vector3 TransformArray::GetTranslation( size_t index ) const
+{
+    return Vector3( Stream( TX )[ index ], Stream( TY )[ index ], Stream( TZ )[ index ] );
+}
+
+inline Matrix TransformArray::GetMatrix( size_t index ) const
+{
+    using namespace DirectX;
+    Vector3 scale = GetScale( index );
+    Quaternion rotation = GetRotation( index );
+    Vector3 translation = GetTranslation( index );
+
+    XMVECTOR S = XMLoadFloat3( &scale );
+    XMVECTOR R = XMLoadFloat4( &rotation );
+    XMVECTOR T = XMLoadFloat3( &translation );
+
+    XMMATRIX M = XMMatrixMultiply( XMMatrixMultiply( XMMatrixScalingFromVector( S ), XMMatrixRotationQuaternion( R ) ), XMMatrixTranslationFromVector( T ) );
+
+    Matrix result;
+    XMStoreFloat4x4( &result, M );
+    return result;
+}
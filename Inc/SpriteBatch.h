@@ -70,6 +70,49 @@ namespace DirectX
         SpriteEffects_FlipBoth = SpriteEffects_FlipHorizontally | SpriteEffects_FlipVertically,
     };
 
+
+    // Counters describing the work SpriteBatch submitted, and how it was split into draw calls.
+    struct SpriteBatchStatistics
+    {
+        size_t sprites;             // Number of sprites sent to the GPU.
+        size_t drawCalls;           // Number of draw calls issued.
+        size_t maps;                // Number of dynamic vertex or instance buffer Map calls.
+        size_t discards;            // How many of those maps wrapped around using D3D11_MAP_WRITE_DISCARD.
+        size_t textureSplits;       // Batches ended because the next sprite needed a texture that wasn't bound.
+        size_t bufferSplits;        // Batches ended because the dynamic buffer (or shared index buffer) was full.
+        size_t immediateDraws;      // Draw calls issued one sprite at a time by SpriteSortMode_Immediate.
+        size_t bufferGrowths;       // Times the dynamic buffer ring was doubled to stay within SetMaxDiscardsPerFrame.
+        double gpuMilliseconds;     // Total GPU time of the completed timing measurements (see SetGpuTiming).
+        size_t gpuTimings;          // Number of completed timing measurements included in gpuMilliseconds.
+    };
+
+
+    // Immutable list of sprites recorded by SpriteBatch::EndSpriteList, for fast replay.
+    class SpriteList
+    {
+    public:
+        SpriteList(SpriteList&& moveFrom);
+        SpriteList& operator= (SpriteList&& moveFrom);
+        virtual ~SpriteList();
+
+        size_t __cdecl GetSpriteCount() const;
+        size_t __cdecl GetBatchCount() const;
+
+        // Private implementation (opaque outside of SpriteBatch).
+        class Impl;
+
+    private:
+        SpriteList();
+
+        std::unique_ptr<Impl> pImpl;
+
+        friend class SpriteBatch;
+
+        // Prevent copying.
+        SpriteList(SpriteList const&) DIRECTX_CTOR_DELETE
+        SpriteList& operator= (SpriteList const&) DIRECTX_CTOR_DELETE
+    };
+
     
     class SpriteBatch
     {
@@ -84,6 +127,12 @@ namespace DirectX
                                _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomShaders = nullptr, FXMMATRIX transformMatrix = MatrixIdentity);
         void __cdecl End();
 
+        // Ends a batch by baking the queued sprites into a static vertex buffer instead of drawing them.
+        // DrawSpriteList then replays the result (outside of Begin/End) with no per-sprite CPU work,
+        // using the render states from the original Begin call and the current rotation and viewport.
+        std::unique_ptr<SpriteList> __cdecl EndSpriteList();
+        void XM_CALLCONV DrawSpriteList(_In_ SpriteList const* spriteList, FXMMATRIX transformMatrix = MatrixIdentity);
+
         // Draw overloads specifying position, origin and scale as XMFLOAT2.
         void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, XMFLOAT2 const& position, FXMVECTOR color = Colors::White);
         void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, XMFLOAT2 const& position, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color = Colors::White, float rotation = 0, XMFLOAT2 const& origin = Float2Zero, float scale = 1, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
@@ -98,6 +147,11 @@ namespace DirectX
         void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, RECT const& destinationRectangle, FXMVECTOR color = Colors::White);
         void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, RECT const& destinationRectangle, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color = Colors::White, float rotation = 0, XMFLOAT2 const& origin = Float2Zero, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
 
+        // Draws a run of sprites from one texture that share position, color, rotation, scale, effects and depth,
+        // each with its own source rectangle and an offset that is added to origin. This is much cheaper than calling
+        // Draw for each one, and is what SpriteFont uses to draw prepared text layouts.
+        void XM_CALLCONV DrawSprites(_In_ ID3D11ShaderResourceView* texture, size_t count, _In_reads_(count) RECT const* sourceRectangles, _In_reads_(count) XMFLOAT2 const* origins, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
+
         // Rotation mode to be applied to the sprite transformation
         void __cdecl SetRotation( DXGI_MODE_ROTATION mode );
         DXGI_MODE_ROTATION __cdecl GetRotation() const;
@@ -105,6 +159,51 @@ namespace DirectX
         // Set viewport for sprite transformation
         void __cdecl SetViewport( const D3D11_VIEWPORT& viewPort );
 
+        // The device context this batch draws with.
+        ID3D11DeviceContext* __cdecl GetDeviceContext() const;
+
+        // Instanced rendering uploads one record per sprite and expands quads in the vertex shader.
+        // Requires feature level 10.0 or better, otherwise the CPU vertex path is used. Not compatible
+        // with custom vertex shaders set via the setCustomShaders callback (custom pixel shaders are fine).
+        void __cdecl SetInstancing( bool enable );
+        bool __cdecl GetInstancing() const;
+
+        // Parallel batching sorts with a stable radix sort (sprites with equal keys keep their submission
+        // order) and, for large batches, spreads sorting and vertex generation across worker threads.
+        void __cdecl SetParallelBatching( bool enable );
+
+        // Multi-texture batching binds up to this many textures at once and picks one per sprite in the
+        // shader, so switching between them doesn't split the batch. Requires instancing (there is no
+        // effect on the CPU vertex path) and is not compatible with custom pixel shaders. 1 disables it.
+        static const size_t MaxBatchTextures = 8;
+
+        void __cdecl SetBatchTextureCount( size_t count );
+
+        // Statistics accumulate until reset, so call ResetStatistics once per frame to get per-frame counts.
+        SpriteBatchStatistics __cdecl GetStatistics() const;
+        void __cdecl ResetStatistics();
+
+        // GPU timing wraps each End (or DrawSpriteList) in timestamp queries. Results arrive a few frames
+        // late, as they are read back without stalling. Only supported on the immediate context.
+        void __cdecl SetGpuTiming( bool enable );
+
+        // The dynamic vertex buffer is a ring shared by every SpriteBatch on the same device context. Each time it
+        // fills up it wraps using D3D11_MAP_WRITE_DISCARD, which can stall drivers that rename buffers poorly if it
+        // happens many times per frame. These settings apply to the whole context. Sizes are in sprites, from
+        // 2048 (the default) to 65536.
+        void __cdecl SetBufferRingSize( size_t spriteCount );
+        size_t __cdecl GetBufferRingSize() const;
+
+        // Once a frame has wrapped the ring this many times, further wraps double its size instead. 0 means no limit.
+        void __cdecl SetMaxDiscardsPerFrame( size_t maxDiscards );
+
+        // Adaptive mode grows the ring at the end of each frame to fit the most sprites drawn in any frame so far.
+        void __cdecl SetAdaptiveBufferRing( bool enable );
+
+        // Marks the end of a frame for the discard limit and adaptive sizing. Call once per frame, on any one of
+        // the SpriteBatch instances using each device context.
+        void __cdecl EndFrame();
+
     private:
         // Private implementation.
         class Impl;
@@ -29,6 +29,9 @@
 
 namespace DirectX
 {
+    class TextLayout;
+
+
     class SpriteFont
     {
     public:
@@ -38,6 +41,11 @@ namespace DirectX
         SpriteFont(_In_ ID3D11Device* device, _In_reads_bytes_(dataSize) uint8_t const* dataBlob, _In_ size_t dataSize);
         SpriteFont(_In_ ID3D11ShaderResourceView* texture, _In_reads_(glyphCount) Glyph const* glyphs, _In_ size_t glyphCount, _In_ float lineSpacing);
 
+        // Streaming fonts keep their glyphs in system memory and copy them into a GPU atlas of the given size as they are drawn,
+        // through the device context of the SpriteBatch drawing them. They can be drawn from several threads at once.
+        SpriteFont(_In_ ID3D11Device* device, _In_z_ wchar_t const* fileName, size_t atlasWidth, size_t atlasHeight);
+        SpriteFont(_In_ ID3D11Device* device, _In_reads_bytes_(dataSize) uint8_t const* dataBlob, _In_ size_t dataSize, size_t atlasWidth, size_t atlasHeight);
+
         SpriteFont(SpriteFont&& moveFrom);
         SpriteFont& operator= (SpriteFont&& moveFrom);
         virtual ~SpriteFont();
@@ -57,6 +65,16 @@ namespace DirectX
 
         bool __cdecl ContainsCharacter(wchar_t character) const;
 
+        // Spacing adjustment DrawString and MeasureString apply between two characters. Only fonts written in
+        // the version 2 .spritefont format carry kerning pairs; for any other font this is always zero.
+        float __cdecl GetKerning(wchar_t first, wchar_t second) const;
+
+        bool __cdecl IsStreaming() const;
+
+        // Streaming fonts never evict glyphs drawn since the last EndFrame, as they may still be queued in a SpriteBatch.
+        // With deferred contexts, call this once the command lists drawing the frame have been executed.
+        void __cdecl EndFrame();
+
 
         // Describes a single character glyph.
         struct Glyph
@@ -69,16 +87,57 @@ namespace DirectX
         };
 
 
-    private:
-        // Private implementation.
+        // Private implementation (opaque outside of SpriteFont).
         class Impl;
 
+    private:
         std::unique_ptr<Impl> pImpl;
 
         static const XMFLOAT2 Float2Zero;
 
+        friend class TextLayout;
+
         // Prevent copying.
         SpriteFont(SpriteFont const&) DIRECTX_CTOR_DELETE
         SpriteFont& operator= (SpriteFont const&) DIRECTX_CTOR_DELETE
     };
+
+
+    // Caches the glyph layout of a string, for text that is drawn many times without changing. Glyph lookup
+    // and layout only happen when the text, effects, or font settings change, and drawing submits every glyph
+    // to SpriteBatch in one call. The SpriteFont must outlive any layouts created from it.
+    class TextLayout
+    {
+    public:
+        explicit TextLayout(_In_ SpriteFont const* font, _In_opt_z_ wchar_t const* text = nullptr, SpriteEffects effects = SpriteEffects_None);
+
+        TextLayout(TextLayout&& moveFrom);
+        TextLayout& operator= (TextLayout&& moveFrom);
+        virtual ~TextLayout();
+
+        // Lays out new text. Does nothing if the text and effects match the current layout.
+        void __cdecl SetText(_In_z_ wchar_t const* text, SpriteEffects effects = SpriteEffects_None);
+
+        void XM_CALLCONV Draw(_In_ SpriteBatch* spriteBatch, XMFLOAT2 const& position, FXMVECTOR color = Colors::White, float rotation = 0, XMFLOAT2 const& origin = Float2Zero, float scale = 1, float layerDepth = 0);
+        void XM_CALLCONV Draw(_In_ SpriteBatch* spriteBatch, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, float layerDepth = 0);
+
+        // Same result as SpriteFont::MeasureString, but computed when the text was laid out.
+        XMVECTOR XM_CALLCONV Measure() const;
+
+        size_t __cdecl GetGlyphCount() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        SpriteFont const* mFont;
+
+        static const XMFLOAT2 Float2Zero;
+
+        // Prevent copying.
+        TextLayout(TextLayout const&) DIRECTX_CTOR_DELETE
+        TextLayout& operator= (TextLayout const&) DIRECTX_CTOR_DELETE
+    };
 }
@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------------------
+// File: TextureCache.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+#include <d3d11_x.h>
+#else
+#include <d3d11_1.h>
+#endif
+
+// VS 2010/2012 do not support =default =delete
+#ifndef DIRECTX_CTOR_DEFAULT
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#define DIRECTX_CTOR_DEFAULT {}
+#define DIRECTX_CTOR_DELETE ;
+#else
+#define DIRECTX_CTOR_DEFAULT =default;
+#define DIRECTX_CTOR_DELETE =delete;
+#endif
+#endif
+
+#include <memory>
+
+
+namespace DirectX
+{
+    // Loads textures from .dds files (using DDSTextureLoader) or other image files (using WICTextureLoader),
+    // sharing each load between everyone who asks for it. All TextureCache instances created for the same
+    // device share one underlying cache, which EffectFactory and DGSLEffectFactory also use, so a texture
+    // referenced by several models and by sprite code is only loaded once.
+    //
+    // Entries are keyed by the full path and the load options. The cache only holds on to textures that
+    // nobody else is using while it is within its memory budget, evicting the least recently used first.
+    class TextureCache
+    {
+    public:
+        explicit TextureCache(_In_ ID3D11Device* device);
+        TextureCache(TextureCache&& moveFrom);
+        TextureCache& operator= (TextureCache&& moveFrom);
+        virtual ~TextureCache();
+
+        // If a device context is provided, mipmaps are auto-generated where the loaders support it.
+        void __cdecl CreateTexture(_In_z_ const wchar_t* fileName, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView, size_t maxsize = 0, bool forceSRGB = false);
+
+        // Memory use is estimated from each texture's format, size, and mip count.
+        void __cdecl SetMemoryBudget(size_t bytes);
+        size_t __cdecl GetMemoryBudget() const;
+        size_t __cdecl GetMemoryUsage() const;
+
+        // Evicts every texture that is not in use outside the cache.
+        void __cdecl Trim();
+
+        // Forgets every texture, including those still in use elsewhere.
+        void __cdecl ReleaseCache();
+
+        static const size_t DefaultMemoryBudget = 256 * 1024 * 1024;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::shared_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        TextureCache(TextureCache const&) DIRECTX_CTOR_DELETE
+        TextureCache& operator= (TextureCache const&) DIRECTX_CTOR_DELETE
+    };
+}
@@ -20,6 +20,7 @@
 #endif
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 
 namespace DirectX
@@ -328,4 +329,87 @@ namespace DirectX
         static const int InputElementCount = 7;
         static const D3D11_INPUT_ELEMENT_DESC InputElements[InputElementCount];
     };
+
+
+    // Packed form of VertexPositionNormalTexture: half4 position (w = 1), SNORM8 normal, and half2 texture
+    // coordinates, for 16 bytes in place of 32. The input assembler expands these back to float, so they work
+    // with the same effects as the full precision type. Requires Feature Level 10.0 or greater.
+    struct VertexPositionNormalTexturePacked
+    {
+        VertexPositionNormalTexturePacked()
+        { }
+
+        VertexPositionNormalTexturePacked(FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
+        {
+            Set( position, normal, textureCoordinate );
+        }
+
+        explicit VertexPositionNormalTexturePacked(VertexPositionNormalTexture const& vertex)
+        {
+            Set( XMLoadFloat3( &vertex.position ), XMLoadFloat3( &vertex.normal ), XMLoadFloat2( &vertex.textureCoordinate ) );
+        }
+
+        void XM_CALLCONV Set( FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate );
+
+        PackedVector::XMHALF4 position;
+        PackedVector::XMBYTEN4 normal;
+        PackedVector::XMHALF2 textureCoordinate;
+
+        static const int InputElementCount = 3;
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+    };
+
+
+    // Packed form of VertexPositionNormalTangentColorTexture: half4 position, SNORM8 normal and tangent (the
+    // tangent w keeps its sign), RGBA color, and half2 texture coordinates, for 24 bytes in place of 52.
+    // Requires Feature Level 10.0 or greater.
+    struct VertexPositionNormalTangentColorTexturePacked
+    {
+        VertexPositionNormalTangentColorTexturePacked()
+        { }
+
+        VertexPositionNormalTangentColorTexturePacked(FXMVECTOR position, FXMVECTOR normal, FXMVECTOR tangent, uint32_t rgba, CXMVECTOR textureCoordinate)
+          : color(rgba)
+        {
+            Set( position, normal, tangent, textureCoordinate );
+        }
+
+        explicit VertexPositionNormalTangentColorTexturePacked(VertexPositionNormalTangentColorTexture const& vertex)
+          : color(vertex.color)
+        {
+            Set( XMLoadFloat3( &vertex.position ), XMLoadFloat3( &vertex.normal ), XMLoadFloat4( &vertex.tangent ), XMLoadFloat2( &vertex.textureCoordinate ) );
+        }
+
+        void XM_CALLCONV Set( FXMVECTOR position, FXMVECTOR normal, FXMVECTOR tangent, CXMVECTOR textureCoordinate );
+
+        PackedVector::XMHALF4 position;
+        PackedVector::XMBYTEN4 normal;
+        PackedVector::XMBYTEN4 tangent;
+        uint32_t color;
+        PackedVector::XMHALF2 textureCoordinate;
+
+        static const int InputElementCount = 5;
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+    };
+
+
+    // Packed form of VertexPositionNormalTangentColorTextureSkinning, 32 bytes in place of 60.
+    // Requires Feature Level 10.0 or greater.
+    struct VertexPositionNormalTangentColorTextureSkinningPacked : public VertexPositionNormalTangentColorTexturePacked
+    {
+        VertexPositionNormalTangentColorTextureSkinningPacked()
+        { }
+
+        explicit VertexPositionNormalTangentColorTextureSkinningPacked(VertexPositionNormalTangentColorTextureSkinning const& vertex)
+          : VertexPositionNormalTangentColorTexturePacked(vertex),
+            indices(vertex.indices),
+            weights(vertex.weights)
+        { }
+
+        uint32_t indices;
+        uint32_t weights;
+
+        static const int InputElementCount = 7;
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+    };
 }
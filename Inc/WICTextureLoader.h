@@ -37,6 +37,19 @@
 #include <d3d11_1.h>
 #endif
 
+// VS 2010/2012 do not support =default =delete
+#ifndef DIRECTX_CTOR_DEFAULT
+#if defined(_MSC_VER) && (_MSC_VER < 1800)
+#define DIRECTX_CTOR_DEFAULT {}
+#define DIRECTX_CTOR_DELETE ;
+#else
+#define DIRECTX_CTOR_DEFAULT =default;
+#define DIRECTX_CTOR_DELETE =delete;
+#endif
+#endif
+
+#include <memory>
+
 #pragma warning(push)
 #pragma warning(disable : 4005)
 #include <stdint.h>
@@ -151,4 +164,53 @@ namespace DirectX
                                                 _Out_opt_ ID3D11Resource** texture,
                                                 _Out_opt_ ID3D11ShaderResourceView** textureView
                                             );
+
+    // Batched version: images are decoded and converted on a pool of background worker threads, and their
+    // textures are created there with the free-threaded device. Mipmap generation is left for Submit, which
+    // records GenerateMips for every texture in the batch on a single context (immediate or deferred), so
+    // loading many images no longer serializes on the immediate context.
+    class WICTextureBatch
+    {
+    public:
+        explicit WICTextureBatch(_In_ ID3D11Device* device, size_t workerCount = 2);
+        WICTextureBatch(WICTextureBatch&& moveFrom);
+        WICTextureBatch& operator= (WICTextureBatch&& moveFrom);
+        virtual ~WICTextureBatch();
+
+        // Both return the index to pass to GetResult. Memory images must stay valid until Wait returns.
+        size_t __cdecl AddFile(_In_z_ const wchar_t* szFileName, size_t maxsize = 0, bool forceSRGB = false, bool generateMips = true);
+
+        size_t __cdecl AddMemory(_In_reads_bytes_(wicDataSize) const uint8_t* wicData,
+                                 _In_ size_t wicDataSize,
+                                 size_t maxsize = 0,
+                                 bool forceSRGB = false,
+                                 bool generateMips = true);
+
+        // Blocks until every image added so far has been decoded and its texture created.
+        void __cdecl Wait();
+
+        // Waits, then records GenerateMips for each texture that still needs it. Returns how many were recorded.
+        // Mipmapped textures should not be sampled until this work has been executed.
+        size_t __cdecl Submit(_In_ ID3D11DeviceContext* deviceContext);
+
+        // Returns E_PENDING until the image has been decoded, then the load result.
+        HRESULT __cdecl GetResult(size_t index,
+                                  _Outptr_opt_ ID3D11Resource** texture,
+                                  _Outptr_opt_ ID3D11ShaderResourceView** textureView) const;
+
+        size_t __cdecl GetCount() const;
+
+        // Waits, then forgets every image so the batch can be reused.
+        void __cdecl Clear();
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        WICTextureBatch(WICTextureBatch const&) DIRECTX_CTOR_DELETE
+        WICTextureBatch& operator= (WICTextureBatch const&) DIRECTX_CTOR_DELETE
+    };
 }
\ No newline at end of file
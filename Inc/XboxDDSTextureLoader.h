@@ -58,4 +58,43 @@ namespace Xbox
                                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
                                               _In_ bool forceSRGB = false
                                             );
+
+    // Placement versions: rather than allocating graphics memory per texture, the tiled data is copied into
+    // the caller's pool at grfxPool + poolOffset. The pool must be graphics memory (i.e. D3DAllocateGraphicsMemory)
+    // and stay allocated until the texture is released. Use GetDDSTextureMemoryRequirements to find out how much
+    // room the texture needs and how the offset must be aligned.
+    HRESULT __cdecl CreateDDSTextureFromMemory( _In_ ID3D11DeviceX* d3dDevice,
+                                                _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                                _In_ size_t ddsDataSize,
+                                                _Outptr_opt_ ID3D11Resource** texture,
+                                                _Outptr_opt_ ID3D11ShaderResourceView** textureView,
+                                                _Inout_updates_bytes_(poolSize) void* grfxPool,
+                                                _In_ size_t poolSize,
+                                                _In_ size_t poolOffset,
+                                                _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+                                                _In_ bool forceSRGB = false
+                                               );
+
+    HRESULT __cdecl CreateDDSTextureFromFile( _In_ ID3D11DeviceX* d3dDevice,
+                                              _In_z_ const wchar_t* szFileName,
+                                              _Outptr_opt_ ID3D11Resource** texture,
+                                              _Outptr_opt_ ID3D11ShaderResourceView** textureView,
+                                              _Inout_updates_bytes_(poolSize) void* grfxPool,
+                                              _In_ size_t poolSize,
+                                              _In_ size_t poolOffset,
+                                              _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+                                              _In_ bool forceSRGB = false
+                                            );
+
+    // Returns the graphics memory size and alignment needed to place a texture. The file version only reads the headers.
+    HRESULT __cdecl GetDDSTextureMemoryRequirements( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                                     _In_ size_t ddsDataSize,
+                                                     _Out_ size_t* sizeBytes,
+                                                     _Out_ size_t* alignmentBytes
+                                                   );
+
+    HRESULT __cdecl GetDDSTextureMemoryRequirements( _In_z_ const wchar_t* szFileName,
+                                                     _Out_ size_t* sizeBytes,
+                                                     _Out_ size_t* alignmentBytes
+                                                   );
 }
\ No newline at end of file
@@ -32,6 +32,8 @@ public class BitmapImporter : IFontImporter
 
         public float LineSpacing { get; private set; }
 
+        public IEnumerable<KerningPair> KerningPairs { get { return Enumerable.Empty<KerningPair>(); } }
+
 
         public void Import(CommandLineOptions options)
         {
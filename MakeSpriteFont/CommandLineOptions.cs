@@ -21,6 +21,7 @@ public enum TextureFormat
         Rgba32,
         Bgra4444,
         CompressedMono,
+        CompressedMonoBC7,
     }
 
 
@@ -66,6 +67,11 @@ public class CommandLineOptions
         public TextureFormat TextureFormat = TextureFormat.Auto;
 
 
+        // Which version of the spritefont binary to write. Version 2 adds kerning pairs and a precomputed
+        // glyph lookup table, but can only be read by a DirectXTK runtime that knows about it.
+        public int FormatVersion = 1;
+
+
         // By default, font textures use premultiplied alpha format. Set this if you want interpolative alpha instead.
         public bool NoPremultiply = false;
 
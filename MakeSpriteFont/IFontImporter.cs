@@ -21,5 +21,7 @@ public interface IFontImporter
         IEnumerable<Glyph> Glyphs { get; }
 
         float LineSpacing { get; }
+
+        IEnumerable<KerningPair> KerningPairs { get; }
     }
 }
@@ -0,0 +1,34 @@
+// DirectXTK MakeSpriteFont tool
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+
+namespace MakeSpriteFont
+{
+    // Spacing adjustment applied between two specific characters.
+    public class KerningPair
+    {
+        // Constructor.
+        public KerningPair(char first, char second, float amount)
+        {
+            this.First = first;
+            this.Second = second;
+            this.Amount = amount;
+        }
+
+
+        // The pair of characters, in the order they appear in the text.
+        public char First;
+        public char Second;
+
+
+        // Horizontal adjustment in pixels. Negative moves the second character closer to the first.
+        public float Amount;
+    }
+}
@@ -50,9 +50,15 @@ static void MakeSpriteFont(CommandLineOptions options)
             // Import.
             Console.WriteLine("Importing {0}", options.SourceFont);
 
+            if (options.FormatVersion != 1 && options.FormatVersion != 2)
+            {
+                throw new Exception("FormatVersion must be 1 or 2.");
+            }
+
             float lineSpacing;
+            KerningPair[] kerningPairs;
 
-            Glyph[] glyphs = ImportFont(options, out lineSpacing);
+            Glyph[] glyphs = ImportFont(options, out lineSpacing, out kerningPairs);
 
             // Optimize.
             Console.WriteLine("Cropping glyph borders");
@@ -119,11 +125,11 @@ static void MakeSpriteFont(CommandLineOptions options)
 
             Console.WriteLine("Writing {0} ({1} format)", options.OutputFile, options.TextureFormat);
 
-            SpriteFontWriter.WriteSpriteFont(options, glyphs, lineSpacing, bitmap);
+            SpriteFontWriter.WriteSpriteFont(options, glyphs, lineSpacing, kerningPairs, bitmap);
         }
 
 
-        static Glyph[] ImportFont(CommandLineOptions options, out float lineSpacing)
+        static Glyph[] ImportFont(CommandLineOptions options, out float lineSpacing, out KerningPair[] kerningPairs)
         {
             // Which importer knows how to read this source font?
             IFontImporter importer;
@@ -146,6 +152,14 @@ static Glyph[] ImportFont(CommandLineOptions options, out float lineSpacing)
 
             lineSpacing = importer.LineSpacing;
 
+            // Sorted so the runtime can binary search them, keeping one entry per pair.
+            kerningPairs = importer.KerningPairs
+                                   .GroupBy(pair => new { pair.First, pair.Second })
+                                   .Select(group => group.First())
+                                   .OrderBy(pair => pair.First)
+                                   .ThenBy(pair => pair.Second)
+                                   .ToArray();
+
             var glyphs = importer.Glyphs
                                  .OrderBy(glyph => glyph.Character)
                                  .ToArray();
@@ -10,7 +10,9 @@
 // http://go.microsoft.com/fwlink/?LinkId=248929
 
 using System;
+using System.Collections.Generic;
 using System.IO;
+using System.Linq;
 using System.Drawing;
 using System.Drawing.Imaging;
 
@@ -20,30 +22,45 @@ namespace MakeSpriteFont
     public static class SpriteFontWriter
     {
         const string spriteFontMagic = "DXTKfont";
+        const string spriteFontMagicV2 = "DXTKfnt2";
 
         const int DXGI_FORMAT_R8G8B8A8_UNORM = 28;
         const int DXGI_FORMAT_B4G4R4A4_UNORM = 115;
         const int DXGI_FORMAT_BC2_UNORM = 74;
+        const int DXGI_FORMAT_BC7_UNORM = 98;
 
+        // Must match the glyph lookup table in SpriteFont.cpp.
+        const int GlyphPageSize = 256;
+        const int GlyphPageCount = 256;
+        const uint MissingGlyph = 0xFFFFFFFF;
 
+
+        // Version 2 files add the kerning pairs and glyph lookup table after the font properties. Everything
+        // else is laid out as in version 1, including the texture, which was already stored ready to create.
         [System.Diagnostics.CodeAnalysis.SuppressMessage("Microsoft.Usage", "CA2202:Do not dispose objects multiple times")]
-        public static void WriteSpriteFont(CommandLineOptions options, Glyph[] glyphs, float lineSpacing, Bitmap bitmap)
+        public static void WriteSpriteFont(CommandLineOptions options, Glyph[] glyphs, float lineSpacing, KerningPair[] kerningPairs, Bitmap bitmap)
         {
             using (FileStream file = File.OpenWrite(options.OutputFile))
             using (BinaryWriter writer = new BinaryWriter(file))
             {
-                WriteMagic(writer);
+                WriteMagic(writer, (options.FormatVersion >= 2) ? spriteFontMagicV2 : spriteFontMagic);
                 WriteGlyphs(writer, glyphs);
 
                 writer.Write(lineSpacing);
                 writer.Write(options.DefaultCharacter);
+
+                if (options.FormatVersion >= 2)
+                {
+                    WriteKerningPairs(writer, kerningPairs);
+                    WriteGlyphPages(writer, glyphs);
+                }
                 
                 WriteBitmap(writer, options, bitmap);
             }
         }
 
 
-        static void WriteMagic(BinaryWriter writer)
+        static void WriteMagic(BinaryWriter writer, string spriteFontMagic)
         {
             foreach (char magic in spriteFontMagic)
             {
@@ -72,6 +89,54 @@ static void WriteGlyphs(BinaryWriter writer, Glyph[] glyphs)
         }
 
 
+        static void WriteKerningPairs(BinaryWriter writer, KerningPair[] kerningPairs)
+        {
+            writer.Write(kerningPairs.Length);
+
+            foreach (KerningPair pair in kerningPairs)
+            {
+                writer.Write((int)pair.First);
+                writer.Write((int)pair.Second);
+                writer.Write(pair.Amount);
+            }
+        }
+
+
+        // Writes the same two-level table SpriteFont builds when loading a version 1 file: a page index for
+        // each block of 256 characters, then the pages of glyph indices, with page 0 shared by empty blocks.
+        static void WriteGlyphPages(BinaryWriter writer, Glyph[] glyphs)
+        {
+            var pageMap = new int[GlyphPageCount];
+            var pages = new List<uint>(Enumerable.Repeat(MissingGlyph, GlyphPageSize));
+
+            for (int i = 0; i < glyphs.Length; i++)
+            {
+                int character = glyphs[i].Character;
+                int block = character / GlyphPageSize;
+
+                if (pageMap[block] == 0)
+                {
+                    pageMap[block] = pages.Count;
+                    pages.AddRange(Enumerable.Repeat(MissingGlyph, GlyphPageSize));
+                }
+
+                pages[pageMap[block] + character % GlyphPageSize] = (uint)i;
+            }
+
+            foreach (int page in pageMap)
+            {
+                writer.Write(page);
+            }
+
+            writer.Write(pages.Count);
+
+            foreach (uint entry in pages)
+            {
+                writer.Write(entry);
+            }
+        }
+
+
         static void WriteBitmap(BinaryWriter writer, CommandLineOptions options, Bitmap bitmap)
         {
             writer.Write(bitmap.Width);
@@ -91,6 +156,10 @@ static void WriteBitmap(BinaryWriter writer, CommandLineOptions options, Bitmap
                     WriteCompressedMono(writer, bitmap, options);
                     break;
                 
+                case TextureFormat.CompressedMonoBC7:
+                    WriteCompressedMonoBC7(writer, bitmap, options);
+                    break;
+                
                 default:
                     throw new NotSupportedException();
             }
@@ -268,5 +337,148 @@ static void CompressBlock(BinaryWriter writer, BitmapUtils.PixelAccessor bitmapD
             // Output the RGB bit mask.
             writer.Write(rgbBits);
         }
+
+
+        // Writes a monochromatic font texture using BC7, which needs a Feature Level 11.0 device. It takes the same
+        // space as CompressedMono, but gives the antialiased edges 16 grey levels rather than 4.
+        static void WriteCompressedMonoBC7(BinaryWriter writer, Bitmap bitmap, CommandLineOptions options)
+        {
+            if ((bitmap.Width & 3) != 0 ||
+                (bitmap.Height & 3) != 0)
+            {
+                throw new ArgumentException("Block compression requires texture size to be a multiple of 4.");
+            }
+
+            writer.Write(DXGI_FORMAT_BC7_UNORM);
+
+            writer.Write(bitmap.Width * 4);
+            writer.Write(bitmap.Height / 4);
+
+            using (var bitmapData = new BitmapUtils.PixelAccessor(bitmap, ImageLockMode.ReadOnly))
+            {
+                for (int y = 0; y < bitmap.Height; y += 4)
+                {
+                    for (int x = 0; x < bitmap.Width; x += 4)
+                    {
+                        CompressBlockBC7(writer, bitmapData, x, y, options);
+                    }
+                }
+            }
+        }
+
+
+        // The same trick as CompressBlock, using BC7 mode 6: a single pair of RGBA endpoints fixed at black and
+        // white, with a 4 bit index per pixel shared by every channel. Those indices select from 16 evenly spread
+        // weights, so RGB and alpha always match and fully solid or empty pixels are exact. Without premultiplied
+        // alpha, RGB stays white while alpha ramps, except that the shared endpoint parity bit makes the transparent
+        // end 254 rather than 255, which is invisible at zero alpha.
+
+        static readonly int[] bc7Weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        static void CompressBlockBC7(BinaryWriter writer, BitmapUtils.PixelAccessor bitmapData, int blockX, int blockY, CommandLineOptions options)
+        {
+            var indices = new int[16];
+
+            for (int y = 0; y < 4; y++)
+            {
+                for (int x = 0; x < 4; x++)
+                {
+                    int value = bitmapData[blockX + x, blockY + y].A;
+
+                    // Pick the weight whose interpolated value is closest to the source.
+                    int best = 0;
+                    int bestError = int.MaxValue;
+
+                    for (int i = 0; i < 16; i++)
+                    {
+                        int error = Math.Abs((255 * bc7Weights[i] + 32) / 64 - value);
+
+                        if (error < bestError)
+                        {
+                            best = i;
+                            bestError = error;
+                        }
+                    }
+
+                    indices[y * 4 + x] = best;
+                }
+            }
+
+            // Endpoints are 7 bits per channel plus a parity bit shared by the whole endpoint.
+            int rgb0 = options.NoPremultiply ? 127 : 0;
+            int rgb1 = 127;
+            int alpha0 = 0;
+            int alpha1 = 127;
+            int parity0 = 0;
+            int parity1 = 1;
+
+            // The first index is stored without its top bit, which must be zero. Swapping the
+            // endpoints and inverting every index gives the same result, because the weights are symmetric.
+            if (indices[0] >= 8)
+            {
+                Swap(ref rgb0, ref rgb1);
+                Swap(ref alpha0, ref alpha1);
+                Swap(ref parity0, ref parity1);
+
+                for (int i = 0; i < 16; i++)
+                {
+                    indices[i] = 15 - indices[i];
+                }
+            }
+
+            ulong low = 0;
+            ulong high = 0;
+            int position = 0;
+
+            // Mode 6 is identified by six zero bits followed by a one.
+            WriteBits(ref low, ref high, ref position, 1 << 6, 7);
+
+            // R0, R1, G0, G1, B0, B1.
+            for (int channel = 0; channel < 3; channel++)
+            {
+                WriteBits(ref low, ref high, ref position, rgb0, 7);
+                WriteBits(ref low, ref high, ref position, rgb1, 7);
+            }
+
+            WriteBits(ref low, ref high, ref position, alpha0, 7);
+            WriteBits(ref low, ref high, ref position, alpha1, 7);
+
+            WriteBits(ref low, ref high, ref position, parity0, 1);
+            WriteBits(ref low, ref high, ref position, parity1, 1);
+
+            for (int i = 0; i < 16; i++)
+            {
+                WriteBits(ref low, ref high, ref position, indices[i], (i == 0) ? 3 : 4);
+            }
+
+            writer.Write(low);
+            writer.Write(high);
+        }
+
+
+        // Appends bits to a 128 bit block, least significant first.
+        static void WriteBits(ref ulong low, ref ulong high, ref int position, int value, int count)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (((value >> i) & 1) != 0)
+                {
+                    if (position < 64)
+                        low |= 1UL << position;
+                    else
+                        high |= 1UL << (position - 64);
+                }
+
+                position++;
+            }
+        }
+
+
+        static void Swap(ref int a, ref int b)
+        {
+            int temp = a;
+            a = b;
+            b = temp;
+        }
     }
 }
@@ -28,6 +28,8 @@ public class TrueTypeImporter : IFontImporter
 
         public float LineSpacing { get; private set; }
 
+        public IEnumerable<KerningPair> KerningPairs { get; private set; }
+
 
         // Size of the temp surface used for GDI+ rasterization.
         const int MaxGlyphSize = 1024;
@@ -82,6 +84,9 @@ public void Import(CommandLineOptions options)
 
                 // Store the font height.
                 LineSpacing = font.GetHeight();
+
+                // Keep the kerning pairs between characters we included.
+                KerningPairs = GetKerningPairs(new HashSet<char>(characters), font, graphics);
             }
         }
 
@@ -224,7 +229,66 @@ static Glyph ImportGlyph(char character, Font font, Brush brush, StringFormat st
         }
 
 
-        // Interop to the native GDI GetCharABCWidthsFloat method.
+        // Queries the kerning table, in pixels since the font is sized in pixels.
+        static List<KerningPair> GetKerningPairs(HashSet<char> characters, Font font, Graphics graphics)
+        {
+            var pairs = new List<KerningPair>();
+
+            // Look up the native device context and font handles.
+            IntPtr hdc = graphics.GetHdc();
+
+            try
+            {
+                IntPtr hFont = font.ToHfont();
+
+                try
+                {
+                    // Select our font into the DC.
+                    IntPtr oldFont = NativeMethods.SelectObject(hdc, hFont);
+
+                    try
+                    {
+                        // Ask how many pairs there are, then read them all.
+                        uint count = NativeMethods.GetKerningPairs(hdc, 0, null);
+
+                        if (count > 0)
+                        {
+                            var result = new NativeMethods.KerningPair[count];
+
+                            count = NativeMethods.GetKerningPairs(hdc, count, result);
+
+                            for (int i = 0; i < count; i++)
+                            {
+                                char first = (char)result[i].First;
+                                char second = (char)result[i].Second;
+
+                                if (result[i].Amount != 0 && characters.Contains(first) && characters.Contains(second))
+                                {
+                                    pairs.Add(new KerningPair(first, second, result[i].Amount));
+                                }
+                            }
+                        }
+                    }
+                    finally
+                    {
+                        NativeMethods.SelectObject(hdc, oldFont);
+                    }
+                }
+                finally
+                {
+                    NativeMethods.DeleteObject(hFont);
+                }
+            }
+            finally
+            {
+                graphics.ReleaseHdc(hdc);
+            }
+
+            return pairs;
+        }
+
+
+        // Interop to the native GDI GetCharABCWidthsFloat and GetKerningPairs methods.
         static class NativeMethods
         {
             [DllImport("gdi32.dll")]
@@ -236,6 +300,9 @@ static class NativeMethods
             [DllImport("gdi32.dll", CharSet = CharSet.Unicode)]
             public static extern bool GetCharABCWidthsFloat(IntPtr hdc, uint iFirstChar, uint iLastChar, [Out] ABCFloat[] lpABCF);
 
+            [DllImport("gdi32.dll", CharSet = CharSet.Unicode, EntryPoint = "GetKerningPairsW")]
+            public static extern uint GetKerningPairs(IntPtr hdc, uint nPairs, [Out] KerningPair[] lpkrnpair);
+
 
             [StructLayout(LayoutKind.Sequential)]
             public struct ABCFloat
@@ -244,6 +311,15 @@ public struct ABCFloat
                 public float B;
                 public float C;
             }
+
+
+            [StructLayout(LayoutKind.Sequential)]
+            public struct KerningPair
+            {
+                public ushort First;
+                public ushort Second;
+                public int Amount;
+            }
         }
     }
 }
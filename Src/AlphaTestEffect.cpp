@@ -51,6 +51,7 @@ public:
     int referenceAlpha;
 
     bool vertexColorEnabled;
+    bool depthOnly;
 
     EffectColor color;
 
@@ -142,7 +143,8 @@ AlphaTestEffect::Impl::Impl(_In_ ID3D11Device* device)
   : EffectBase(device),
     alphaFunction(D3D11_COMPARISON_GREATER),
     referenceAlpha(0),
-    vertexColorEnabled(false)
+    vertexColorEnabled(false),
+    depthOnly(false)
 {
     static_assert( _countof(EffectBase<AlphaTestEffectTraits>::VertexShaderIndices) == AlphaTestEffectTraits::ShaderPermutationCount, "array/max mismatch" );
     static_assert( _countof(EffectBase<AlphaTestEffectTraits>::VertexShaderBytecode) == AlphaTestEffectTraits::VertexShaderCount, "array/max mismatch" );
@@ -155,8 +157,8 @@ int AlphaTestEffect::Impl::GetCurrentShaderPermutation() const
 {
     int permutation = 0;
 
-    // Use optimized shaders if fog is disabled.
-    if (!fog.enabled)
+    // Use optimized shaders if fog is disabled. These already do nothing but the alpha test, so depth only passes use them too.
+    if (!fog.enabled || depthOnly)
     {
         permutation += 1;
     }
@@ -299,6 +301,13 @@ AlphaTestEffect& AlphaTestEffect::operator= (AlphaTestEffect&& moveFrom)
 }
 
 
+// Private constructor, used by Clone.
+AlphaTestEffect::AlphaTestEffect(std::unique_ptr<Impl>&& impl)
+  : pImpl(std::move(impl))
+{
+}
+
+
 // Public destructor.
 AlphaTestEffect::~AlphaTestEffect()
 {
@@ -317,6 +326,26 @@ void AlphaTestEffect::GetVertexShaderBytecode(_Out_ void const** pShaderByteCode
 }
 
 
+std::shared_ptr<IEffect> AlphaTestEffect::Clone() const
+{
+    std::unique_ptr<Impl> impl(new Impl(*pImpl));
+
+    return std::shared_ptr<IEffect>(new AlphaTestEffect(std::move(impl)));
+}
+
+
+void AlphaTestEffect::WarmUpShaders(bool allPermutations)
+{
+    pImpl->WarmUpShaders(allPermutations ? -1 : pImpl->GetCurrentShaderPermutation());
+}
+
+
+void AlphaTestEffect::GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const
+{
+    pImpl->GetShaderCreationStats(stats);
+}
+
+
 void XM_CALLCONV AlphaTestEffect::SetWorld(FXMMATRIX value)
 {
     pImpl->matrices.world = value;
@@ -415,3 +444,9 @@ void AlphaTestEffect::SetReferenceAlpha(int value)
 
     pImpl->dirtyFlags |= EffectDirtyFlags::AlphaTest;
 }
+
+
+void AlphaTestEffect::SetDepthOnly(bool value)
+{
+    pImpl->depthOnly = value;
+}
@@ -0,0 +1,673 @@
+//--------------------------------------------------------------------------------------
+// File: AsyncDDSTextureLoader.cpp
+//
+// Background loading of DDS textures, using a small pool of worker threads and the
+// free-threaded device
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+
+#include "AsyncDDSTextureLoader.h"
+
+#include "dds.h"
+#include "PlatformHelpers.h"
+
+#include <ppl.h>
+#include <queue>
+
+using namespace DirectX;
+
+
+// Reads a whole file, keeping several overlapped reads in flight, and stopping early if the request is cancelled.
+static HRESULT ReadFileOverlapped( _In_z_ const wchar_t* fileName,
+                                   std::unique_ptr<uint8_t[]>& data,
+                                   _Out_ size_t* dataSize,
+                                   _In_ volatile LONG* cancelled
+                                 )
+{
+    *dataSize = 0;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    CREATEFILE2_EXTENDED_PARAMETERS params = { sizeof(CREATEFILE2_EXTENDED_PARAMETERS), FILE_ATTRIBUTE_NORMAL, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, 0, nullptr, nullptr };
+
+    ScopedHandle hFile( safe_handle( CreateFile2( fileName,
+                                                  GENERIC_READ,
+                                                  FILE_SHARE_READ,
+                                                  OPEN_EXISTING,
+                                                  &params ) ) );
+#else
+    ScopedHandle hFile( safe_handle( CreateFileW( fileName,
+                                                  GENERIC_READ,
+                                                  FILE_SHARE_READ,
+                                                  nullptr,
+                                                  OPEN_EXISTING,
+                                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                                                  nullptr ) ) );
+#endif
+
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Get the file size
+    LARGE_INTEGER FileSize = { 0 };
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_STANDARD_INFO fileInfo;
+    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+    FileSize = fileInfo.EndOfFile;
+#else
+    GetFileSizeEx( hFile.get(), &FileSize );
+#endif
+
+    // File is too big for 32-bit allocation, so reject read
+    if (FileSize.HighPart > 0)
+    {
+        return E_FAIL;
+    }
+
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if (FileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    {
+        return E_FAIL;
+    }
+
+    // create enough space for the file data
+    data.reset( new (std::nothrow) uint8_t[ FileSize.LowPart ] );
+    if (!data)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    static const DWORD ChunkSize = 1024 * 1024;
+    static const size_t MaxReadsInFlight = 4;
+
+    OVERLAPPED overlapped[MaxReadsInFlight];
+    DWORD requested[MaxReadsInFlight];
+    ScopedHandle events[MaxReadsInFlight];
+
+    for (size_t i = 0; i < MaxReadsInFlight; i++)
+    {
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+        events[i].reset( CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE ) );
+#else
+        events[i].reset( CreateEvent( nullptr, TRUE, FALSE, nullptr ) );
+#endif
+
+        if ( !events[i] )
+        {
+            return HRESULT_FROM_WIN32( GetLastError() );
+        }
+    }
+
+    HRESULT hr = S_OK;
+    DWORD issued = 0;
+    size_t first = 0;
+    size_t inFlight = 0;
+
+    for (;;)
+    {
+        // Keep the queue of reads topped up.
+        while (SUCCEEDED(hr) && inFlight < MaxReadsInFlight && issued < FileSize.LowPart)
+        {
+            if (*cancelled)
+            {
+                hr = E_ABORT;
+                break;
+            }
+
+            size_t slot = (first + inFlight) % MaxReadsInFlight;
+            DWORD bytes = std::min( ChunkSize, FileSize.LowPart - issued );
+
+            memset( &overlapped[slot], 0, sizeof(OVERLAPPED) );
+            overlapped[slot].Offset = issued;
+            overlapped[slot].hEvent = events[slot].get();
+
+            if (!ReadFile( hFile.get(), data.get() + issued, bytes, nullptr, &overlapped[slot] ))
+            {
+                DWORD error = GetLastError();
+
+                if (error != ERROR_IO_PENDING)
+                {
+                    hr = HRESULT_FROM_WIN32( error );
+                    break;
+                }
+            }
+
+            requested[slot] = bytes;
+            issued += bytes;
+            inFlight++;
+        }
+
+        if (!inFlight)
+            break;
+
+        if (FAILED(hr))
+        {
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+            CancelIoEx( hFile.get(), nullptr );
+#else
+            CancelIo( hFile.get() );
+#endif
+        }
+
+        // Outstanding reads must always be drained, even after a failure, before the buffer can be released.
+        DWORD bytesRead = 0;
+
+        if (!GetOverlappedResult( hFile.get(), &overlapped[first], &bytesRead, TRUE ))
+        {
+            if (SUCCEEDED(hr))
+                hr = HRESULT_FROM_WIN32( GetLastError() );
+        }
+        else if (bytesRead < requested[first] && SUCCEEDED(hr))
+        {
+            hr = E_FAIL;
+        }
+
+        first = (first + 1) % MaxReadsInFlight;
+        inFlight--;
+    }
+
+    if (FAILED(hr))
+    {
+        data.reset();
+        return hr;
+    }
+
+    *dataSize = FileSize.LowPart;
+
+    return S_OK;
+}
+
+
+// A single queued load, shared between the loader and the caller's RequestHandle.
+class AsyncDDSTextureLoader::Request
+{
+public:
+    Request()
+      : maxsize(0),
+        usage(D3D11_USAGE_DEFAULT),
+        bindFlags(D3D11_BIND_SHADER_RESOURCE),
+        cpuAccessFlags(0),
+        miscFlags(0),
+        forceSRGB(false),
+        priority(0),
+        sequence(0),
+        status(DDS_LOAD_PENDING),
+        cancelled(0),
+        result(E_PENDING),
+        alphaMode(DDS_ALPHA_MODE_UNKNOWN)
+    { }
+
+    // Load parameters.
+    std::wstring fileName;
+    size_t maxsize;
+    D3D11_USAGE usage;
+    unsigned int bindFlags;
+    unsigned int cpuAccessFlags;
+    unsigned int miscFlags;
+    bool forceSRGB;
+    Callback callback;
+    int priority;
+    uint64_t sequence;
+
+    // Results. Status moves out of DDS_LOAD_PENDING under the loader lock, and all other
+    // fields are written before the final status is published.
+    volatile LONG status;
+    volatile LONG cancelled;
+    HRESULT result;
+    Microsoft::WRL::ComPtr<ID3D11Resource> texture;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureView;
+    DDS_ALPHA_MODE alphaMode;
+    ScopedHandle completeEvent;
+
+
+    // Publishes the result, runs the callback, and releases any waiters.
+    void Finish(HRESULT hr, DDS_LOAD_STATUS finalStatus)
+    {
+        result = hr;
+        InterlockedExchange(&status, finalStatus);
+
+        if (callback)
+        {
+            callback(hr, texture.Get(), textureView.Get(), alphaMode);
+
+            // Release anything captured by the callback.
+            callback = nullptr;
+        }
+
+        SetEvent(completeEvent.get());
+    }
+};
+
+
+// Orders the queue by priority, then first-come first-served.
+struct RequestOrder
+{
+    bool operator() (AsyncDDSTextureLoader::RequestHandle const& left, AsyncDDSTextureLoader::RequestHandle const& right) const
+    {
+        if (left->priority != right->priority)
+            return left->priority < right->priority;
+
+        return left->sequence > right->sequence;
+    }
+};
+
+
+// Internal AsyncDDSTextureLoader implementation class.
+class AsyncDDSTextureLoader::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device, size_t workerCount);
+    ~Impl();
+
+    RequestHandle Enqueue(RequestHandle request);
+    void Cancel(RequestHandle const& request);
+    void CancelAll();
+
+    Microsoft::WRL::ComPtr<ID3D11Device> mDevice;
+    size_t mMaxWorkers;
+
+    // Guards everything below.
+    mutable std::mutex mMutex;
+
+    std::priority_queue<RequestHandle, std::vector<RequestHandle>, RequestOrder> mQueue;
+    std::vector<RequestHandle> mLoading;
+    size_t mPendingCount;
+    size_t mWorkerCount;
+    uint64_t mNextSequence;
+
+    Concurrency::task_group mWorkers;
+
+private:
+    void WorkerLoop();
+    void Process(_In_ Request* request);
+};
+
+
+AsyncDDSTextureLoader::Impl::Impl(_In_ ID3D11Device* device, size_t workerCount)
+  : mDevice(device),
+    mMaxWorkers(workerCount),
+    mPendingCount(0),
+    mWorkerCount(0),
+    mNextSequence(0)
+{
+    if (!device)
+        throw std::exception("Direct3D device cannot be null");
+
+    if (!workerCount)
+        throw std::exception("AsyncDDSTextureLoader needs at least one worker");
+}
+
+
+// Outstanding requests are cancelled, and the destructor waits for the workers to stop.
+AsyncDDSTextureLoader::Impl::~Impl()
+{
+    CancelAll();
+
+    mWorkers.wait();
+}
+
+
+// Adds a request to the queue, starting another worker if there is room for one.
+AsyncDDSTextureLoader::RequestHandle AsyncDDSTextureLoader::Impl::Enqueue(RequestHandle request)
+{
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    request->completeEvent.reset( CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE ) );
+#else
+    request->completeEvent.reset( CreateEvent( nullptr, TRUE, FALSE, nullptr ) );
+#endif
+
+    if (!request->completeEvent)
+        throw std::exception("CreateEvent");
+
+    bool startWorker = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        request->sequence = mNextSequence++;
+
+        mQueue.push(request);
+        mPendingCount++;
+
+        if (mWorkerCount < mMaxWorkers)
+        {
+            mWorkerCount++;
+            startWorker = true;
+        }
+    }
+
+    if (startWorker)
+    {
+        mWorkers.run([this]()
+        {
+            WorkerLoop();
+        });
+    }
+
+    return request;
+}
+
+
+// Queued requests finish straight away. Loading ones are flagged, and stop at their next read.
+void AsyncDDSTextureLoader::Impl::Cancel(RequestHandle const& request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (request->status != DDS_LOAD_PENDING)
+        {
+            InterlockedExchange(&request->cancelled, 1);
+            return;
+        }
+
+        // Leave it in the queue: the workers skip anything that is no longer pending.
+        request->result = E_ABORT;
+        InterlockedExchange(&request->status, DDS_LOAD_CANCELLED);
+        mPendingCount--;
+    }
+
+    // Run the callback outside the lock, in case it queues more work.
+    request->Finish(E_ABORT, DDS_LOAD_CANCELLED);
+}
+
+
+void AsyncDDSTextureLoader::Impl::CancelAll()
+{
+    std::vector<RequestHandle> cancelled;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        while (!mQueue.empty())
+        {
+            auto request = mQueue.top();
+            mQueue.pop();
+
+            if (request->status == DDS_LOAD_PENDING)
+            {
+                request->result = E_ABORT;
+                InterlockedExchange(&request->status, DDS_LOAD_CANCELLED);
+                cancelled.push_back(request);
+            }
+        }
+
+        mPendingCount = 0;
+
+        for (auto it = mLoading.cbegin(); it != mLoading.cend(); ++it)
+        {
+            InterlockedExchange(&(*it)->cancelled, 1);
+        }
+    }
+
+    for (auto it = cancelled.cbegin(); it != cancelled.cend(); ++it)
+    {
+        (*it)->Finish(E_ABORT, DDS_LOAD_CANCELLED);
+    }
+}
+
+
+// Each worker keeps taking the highest priority request until the queue is empty.
+void AsyncDDSTextureLoader::Impl::WorkerLoop()
+{
+    for (;;)
+    {
+        RequestHandle request;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            while (!mQueue.empty())
+            {
+                auto next = mQueue.top();
+                mQueue.pop();
+
+                if (next->status == DDS_LOAD_PENDING)
+                {
+                    request = next;
+                    break;
+                }
+            }
+
+            if (!request)
+            {
+                mWorkerCount--;
+                return;
+            }
+
+            InterlockedExchange(&request->status, DDS_LOAD_LOADING);
+            mPendingCount--;
+
+            mLoading.push_back(request);
+        }
+
+        Process(request.get());
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mLoading.erase(std::find(mLoading.begin(), mLoading.end(), request));
+        }
+    }
+}
+
+
+// Reads the file and creates the texture on the calling (worker) thread.
+void AsyncDDSTextureLoader::Impl::Process(_In_ Request* request)
+{
+    std::unique_ptr<uint8_t[]> ddsData;
+    size_t ddsDataSize = 0;
+
+    HRESULT hr = ReadFileOverlapped( request->fileName.c_str(), ddsData, &ddsDataSize, &request->cancelled );
+
+    if (SUCCEEDED(hr))
+    {
+        if (request->cancelled)
+        {
+            hr = E_ABORT;
+        }
+        else
+        {
+            // A view can only be created if the texture is bound as a shader resource.
+            bool wantView = (request->bindFlags & D3D11_BIND_SHADER_RESOURCE) != 0;
+
+            hr = CreateDDSTextureFromMemoryEx( mDevice.Get(),
+                                               ddsData.get(), ddsDataSize,
+                                               request->maxsize,
+                                               request->usage,
+                                               request->bindFlags,
+                                               request->cpuAccessFlags,
+                                               request->miscFlags,
+                                               request->forceSRGB,
+                                               request->texture.GetAddressOf(),
+                                               wantView ? request->textureView.GetAddressOf() : nullptr,
+                                               &request->alphaMode );
+        }
+    }
+
+    ddsData.reset();
+
+    if (FAILED(hr))
+    {
+        request->texture.Reset();
+        request->textureView.Reset();
+    }
+
+    request->Finish(hr, SUCCEEDED(hr) ? DDS_LOAD_COMPLETE : ((hr == E_ABORT) ? DDS_LOAD_CANCELLED : DDS_LOAD_FAILED));
+}
+
+
+// Public constructor.
+AsyncDDSTextureLoader::AsyncDDSTextureLoader(_In_ ID3D11Device* device, size_t workerCount)
+  : pImpl(new Impl(device, workerCount))
+{
+}
+
+
+// Move constructor.
+AsyncDDSTextureLoader::AsyncDDSTextureLoader(AsyncDDSTextureLoader&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+AsyncDDSTextureLoader& AsyncDDSTextureLoader::operator= (AsyncDDSTextureLoader&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+AsyncDDSTextureLoader::~AsyncDDSTextureLoader()
+{
+}
+
+
+_Use_decl_annotations_
+AsyncDDSTextureLoader::RequestHandle AsyncDDSTextureLoader::Load( const wchar_t* fileName, Callback callback, int priority )
+{
+    return LoadEx( fileName, 0, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, false, callback, priority );
+}
+
+
+_Use_decl_annotations_
+AsyncDDSTextureLoader::RequestHandle AsyncDDSTextureLoader::LoadEx( const wchar_t* fileName,
+                                                                    size_t maxsize,
+                                                                    D3D11_USAGE usage,
+                                                                    unsigned int bindFlags,
+                                                                    unsigned int cpuAccessFlags,
+                                                                    unsigned int miscFlags,
+                                                                    bool forceSRGB,
+                                                                    Callback callback,
+                                                                    int priority )
+{
+    if (!fileName)
+        throw std::exception("File name cannot be null");
+
+    RequestHandle request(new Request());
+
+    request->fileName = fileName;
+    request->maxsize = maxsize;
+    request->usage = usage;
+    request->bindFlags = bindFlags;
+    request->cpuAccessFlags = cpuAccessFlags;
+    request->miscFlags = miscFlags;
+    request->forceSRGB = forceSRGB;
+    request->callback = callback;
+    request->priority = priority;
+
+    return pImpl->Enqueue(request);
+}
+
+
+_Use_decl_annotations_
+void AsyncDDSTextureLoader::Cancel( RequestHandle const& request )
+{
+    if (request)
+    {
+        pImpl->Cancel(request);
+    }
+}
+
+
+void AsyncDDSTextureLoader::CancelAll()
+{
+    pImpl->CancelAll();
+}
+
+
+_Use_decl_annotations_
+DDS_LOAD_STATUS AsyncDDSTextureLoader::GetStatus( RequestHandle const& request )
+{
+    if (!request)
+        return DDS_LOAD_FAILED;
+
+    return static_cast<DDS_LOAD_STATUS>(request->status);
+}
+
+
+_Use_decl_annotations_
+bool AsyncDDSTextureLoader::Wait( RequestHandle const& request, unsigned long timeoutMilliseconds )
+{
+    if (!request)
+        return true;
+
+    return WaitForSingleObjectEx( request->completeEvent.get(), timeoutMilliseconds, FALSE ) == WAIT_OBJECT_0;
+}
+
+
+_Use_decl_annotations_
+HRESULT AsyncDDSTextureLoader::GetResult( RequestHandle const& request,
+                                          ID3D11Resource** texture,
+                                          ID3D11ShaderResourceView** textureView,
+                                          DDS_ALPHA_MODE* alphaMode )
+{
+    if ( texture )
+    {
+        *texture = nullptr;
+    }
+    if ( textureView )
+    {
+        *textureView = nullptr;
+    }
+    if ( alphaMode )
+    {
+        *alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+    }
+
+    if (!request)
+    {
+        return E_INVALIDARG;
+    }
+
+    LONG status = request->status;
+
+    if (status == DDS_LOAD_PENDING || status == DDS_LOAD_LOADING)
+    {
+        return E_PENDING;
+    }
+
+    if (SUCCEEDED(request->result))
+    {
+        if (texture)
+        {
+            request->texture.CopyTo(texture);
+        }
+
+        if (textureView)
+        {
+            request->textureView.CopyTo(textureView);
+        }
+
+        if (alphaMode)
+        {
+            *alphaMode = request->alphaMode;
+        }
+    }
+
+    return request->result;
+}
+
+
+size_t AsyncDDSTextureLoader::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->mMutex);
+
+    return pImpl->mPendingCount;
+}
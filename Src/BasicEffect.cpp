@@ -31,6 +31,18 @@ struct BasicEffectConstants
     XMVECTOR eyePosition;
 
     XMVECTOR fogColor;
+
+    uint32_t tileCountX;
+    uint32_t tileLightStride;
+    uint32_t tilePadding[2];
+};
+
+static_assert( ( sizeof(BasicEffectConstants) % 16 ) == 0, "CB size not padded correctly" );
+
+
+// Per-object constant buffer layout, bound to slot 1 of the vertex shader. Must match the shader!
+struct BasicEffectObjectConstants
+{
     XMVECTOR fogVector;
 
     XMMATRIX world;
@@ -38,7 +50,7 @@ struct BasicEffectConstants
     XMMATRIX worldViewProj;
 };
 
-static_assert( ( sizeof(BasicEffectConstants) % 16 ) == 0, "CB size not padded correctly" );
+static_assert( ( sizeof(BasicEffectObjectConstants) % 16 ) == 0, "CB size not padded correctly" );
 
 
 // Traits type describes our characteristics to the EffectBase template.
@@ -46,9 +58,9 @@ struct BasicEffectTraits
 {
     typedef BasicEffectConstants ConstantBufferType;
 
-    static const int VertexShaderCount = 20;
-    static const int PixelShaderCount = 10;
-    static const int ShaderPermutationCount = 32;
+    static const int VertexShaderCount = 40;
+    static const int PixelShaderCount = 13;
+    static const int ShaderPermutationCount = 82;
 };
 
 
@@ -57,17 +69,30 @@ class BasicEffect::Impl : public EffectBase<BasicEffectTraits>
 {
 public:
     Impl(_In_ ID3D11Device* device);
+    Impl(Impl const& other);
 
     bool lightingEnabled;
     bool preferPerPixelLighting;
     bool vertexColorEnabled;
     bool textureEnabled;
+    bool instancingEnabled;
+    bool depthOnly;
+
+    LightGrid const* lightGrid;
 
     EffectLights lights;
 
+    BasicEffectObjectConstants objectConstants;
+
     int GetCurrentShaderPermutation() const;
 
     void Apply(_In_ ID3D11DeviceContext* deviceContext);
+
+private:
+    ConstantBuffer<BasicEffectObjectConstants> mObjectConstantBuffer;
+
+    // Prevent assignment.
+    Impl& operator= (Impl const&) DIRECTX_CTOR_DELETE
 };
 
 
@@ -98,6 +123,30 @@ namespace
     #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicPixelLightingVc.inc"
     #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicPixelLightingTx.inc"
     #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicPixelLightingTxVc.inc"
+    
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicNoFogInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicVcInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicVcNoFogInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicTxInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicTxNoFogInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicTxVcInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicTxVcNoFogInst.inc"
+    
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicVertexLightingInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicVertexLightingVcInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicVertexLightingTxInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicVertexLightingTxVcInst.inc"
+    
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicOneLightInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicOneLightVcInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicOneLightTxInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicOneLightTxVcInst.inc"
+    
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicPixelLightingInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicPixelLightingVcInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicPixelLightingTxInst.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_VSBasicPixelLightingTxVcInst.inc"
 
     #include "Shaders/Compiled/XboxOneBasicEffect_PSBasic.inc"
     #include "Shaders/Compiled/XboxOneBasicEffect_PSBasicNoFog.inc"
@@ -111,6 +160,9 @@ namespace
 
     #include "Shaders/Compiled/XboxOneBasicEffect_PSBasicPixelLighting.inc"
     #include "Shaders/Compiled/XboxOneBasicEffect_PSBasicPixelLightingTx.inc"
+
+    #include "Shaders/Compiled/XboxOneBasicEffect_PSBasicPixelLightingTiled.inc"
+    #include "Shaders/Compiled/XboxOneBasicEffect_PSBasicPixelLightingTxTiled.inc"
 #else
     #include "Shaders/Compiled/BasicEffect_VSBasic.inc"
     #include "Shaders/Compiled/BasicEffect_VSBasicNoFog.inc"
@@ -135,6 +187,30 @@ namespace
     #include "Shaders/Compiled/BasicEffect_VSBasicPixelLightingVc.inc"
     #include "Shaders/Compiled/BasicEffect_VSBasicPixelLightingTx.inc"
     #include "Shaders/Compiled/BasicEffect_VSBasicPixelLightingTxVc.inc"
+    
+    #include "Shaders/Compiled/BasicEffect_VSBasicInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicNoFogInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicVcInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicVcNoFogInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicTxInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicTxNoFogInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicTxVcInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicTxVcNoFogInst.inc"
+    
+    #include "Shaders/Compiled/BasicEffect_VSBasicVertexLightingInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicVertexLightingVcInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicVertexLightingTxInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicVertexLightingTxVcInst.inc"
+    
+    #include "Shaders/Compiled/BasicEffect_VSBasicOneLightInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicOneLightVcInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicOneLightTxInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicOneLightTxVcInst.inc"
+    
+    #include "Shaders/Compiled/BasicEffect_VSBasicPixelLightingInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicPixelLightingVcInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicPixelLightingTxInst.inc"
+    #include "Shaders/Compiled/BasicEffect_VSBasicPixelLightingTxVcInst.inc"
 
     #include "Shaders/Compiled/BasicEffect_PSBasic.inc"
     #include "Shaders/Compiled/BasicEffect_PSBasicNoFog.inc"
@@ -148,6 +224,9 @@ namespace
 
     #include "Shaders/Compiled/BasicEffect_PSBasicPixelLighting.inc"
     #include "Shaders/Compiled/BasicEffect_PSBasicPixelLightingTx.inc"
+
+    #include "Shaders/Compiled/BasicEffect_PSBasicPixelLightingTiled.inc"
+    #include "Shaders/Compiled/BasicEffect_PSBasicPixelLightingTxTiled.inc"
 #endif
 }
 
@@ -177,6 +256,30 @@ const ShaderBytecode EffectBase<BasicEffectTraits>::VertexShaderBytecode[] =
     { BasicEffect_VSBasicPixelLightingVc,    sizeof(BasicEffect_VSBasicPixelLightingVc)    },
     { BasicEffect_VSBasicPixelLightingTx,    sizeof(BasicEffect_VSBasicPixelLightingTx)    },
     { BasicEffect_VSBasicPixelLightingTxVc,  sizeof(BasicEffect_VSBasicPixelLightingTxVc)  },
+    
+    { BasicEffect_VSBasicInst,                    sizeof(BasicEffect_VSBasicInst)                   },
+    { BasicEffect_VSBasicNoFogInst,               sizeof(BasicEffect_VSBasicNoFogInst)              },
+    { BasicEffect_VSBasicVcInst,                  sizeof(BasicEffect_VSBasicVcInst)                 },
+    { BasicEffect_VSBasicVcNoFogInst,             sizeof(BasicEffect_VSBasicVcNoFogInst)            },
+    { BasicEffect_VSBasicTxInst,                  sizeof(BasicEffect_VSBasicTxInst)                 },
+    { BasicEffect_VSBasicTxNoFogInst,             sizeof(BasicEffect_VSBasicTxNoFogInst)            },
+    { BasicEffect_VSBasicTxVcInst,                sizeof(BasicEffect_VSBasicTxVcInst)               },
+    { BasicEffect_VSBasicTxVcNoFogInst,           sizeof(BasicEffect_VSBasicTxVcNoFogInst)          },
+    
+    { BasicEffect_VSBasicVertexLightingInst,      sizeof(BasicEffect_VSBasicVertexLightingInst)     },
+    { BasicEffect_VSBasicVertexLightingVcInst,    sizeof(BasicEffect_VSBasicVertexLightingVcInst)   },
+    { BasicEffect_VSBasicVertexLightingTxInst,    sizeof(BasicEffect_VSBasicVertexLightingTxInst)   },
+    { BasicEffect_VSBasicVertexLightingTxVcInst,  sizeof(BasicEffect_VSBasicVertexLightingTxVcInst) },
+    
+    { BasicEffect_VSBasicOneLightInst,            sizeof(BasicEffect_VSBasicOneLightInst)           },
+    { BasicEffect_VSBasicOneLightVcInst,          sizeof(BasicEffect_VSBasicOneLightVcInst)         },
+    { BasicEffect_VSBasicOneLightTxInst,          sizeof(BasicEffect_VSBasicOneLightTxInst)         },
+    { BasicEffect_VSBasicOneLightTxVcInst,        sizeof(BasicEffect_VSBasicOneLightTxVcInst)       },
+    
+    { BasicEffect_VSBasicPixelLightingInst,       sizeof(BasicEffect_VSBasicPixelLightingInst)      },
+    { BasicEffect_VSBasicPixelLightingVcInst,     sizeof(BasicEffect_VSBasicPixelLightingVcInst)    },
+    { BasicEffect_VSBasicPixelLightingTxInst,     sizeof(BasicEffect_VSBasicPixelLightingTxInst)    },
+    { BasicEffect_VSBasicPixelLightingTxVcInst,   sizeof(BasicEffect_VSBasicPixelLightingTxVcInst)  },
 };
 
 
@@ -217,6 +320,63 @@ const int EffectBase<BasicEffectTraits>::VertexShaderIndices[] =
     18,     // pixel lighting + texture, no fog
     19,     // pixel lighting + texture + vertex color
     19,     // pixel lighting + texture + vertex color, no fog
+
+    20,     // basic, instancing
+    21,     // no fog, instancing
+    22,     // vertex color, instancing
+    23,     // vertex color, no fog, instancing
+    24,     // texture, instancing
+    25,     // texture, no fog, instancing
+    26,     // texture + vertex color, instancing
+    27,     // texture + vertex color, no fog, instancing
+    
+    28,     // vertex lighting, instancing
+    28,     // vertex lighting, no fog, instancing
+    29,     // vertex lighting + vertex color, instancing
+    29,     // vertex lighting + vertex color, no fog, instancing
+    30,     // vertex lighting + texture, instancing
+    30,     // vertex lighting + texture, no fog, instancing
+    31,     // vertex lighting + texture + vertex color, instancing
+    31,     // vertex lighting + texture + vertex color, no fog, instancing
+    
+    32,     // one light, instancing
+    32,     // one light, no fog, instancing
+    33,     // one light + vertex color, instancing
+    33,     // one light + vertex color, no fog, instancing
+    34,     // one light + texture, instancing
+    34,     // one light + texture, no fog, instancing
+    35,     // one light + texture + vertex color, instancing
+    35,     // one light + texture + vertex color, no fog, instancing
+    
+    36,     // pixel lighting, instancing
+    36,     // pixel lighting, no fog, instancing
+    37,     // pixel lighting + vertex color, instancing
+    37,     // pixel lighting + vertex color, no fog, instancing
+    38,     // pixel lighting + texture, instancing
+    38,     // pixel lighting + texture, no fog, instancing
+    39,     // pixel lighting + texture + vertex color, instancing
+    39,     // pixel lighting + texture + vertex color, no fog, instancing
+
+    16,     // tiled lighting
+    16,     // tiled lighting, no fog
+    17,     // tiled lighting + vertex color
+    17,     // tiled lighting + vertex color, no fog
+    18,     // tiled lighting + texture
+    18,     // tiled lighting + texture, no fog
+    19,     // tiled lighting + texture + vertex color
+    19,     // tiled lighting + texture + vertex color, no fog
+
+    36,     // tiled lighting, instancing
+    36,     // tiled lighting, no fog, instancing
+    37,     // tiled lighting + vertex color, instancing
+    37,     // tiled lighting + vertex color, no fog, instancing
+    38,     // tiled lighting + texture, instancing
+    38,     // tiled lighting + texture, no fog, instancing
+    39,     // tiled lighting + texture + vertex color, instancing
+    39,     // tiled lighting + texture + vertex color, no fog, instancing
+
+    1,      // depth only
+    21,     // depth only, instancing
 };
 
 
@@ -234,6 +394,11 @@ const ShaderBytecode EffectBase<BasicEffectTraits>::PixelShaderBytecode[] =
 
     { BasicEffect_PSBasicPixelLighting,         sizeof(BasicEffect_PSBasicPixelLighting)         },
     { BasicEffect_PSBasicPixelLightingTx,       sizeof(BasicEffect_PSBasicPixelLightingTx)       },
+
+    { BasicEffect_PSBasicPixelLightingTiled,    sizeof(BasicEffect_PSBasicPixelLightingTiled)    },
+    { BasicEffect_PSBasicPixelLightingTxTiled,  sizeof(BasicEffect_PSBasicPixelLightingTxTiled)  },
+
+    { nullptr,                                  0                                                },
 };
 
 
@@ -274,6 +439,63 @@ const int EffectBase<BasicEffectTraits>::PixelShaderIndices[] =
     9,      // pixel lighting + texture, no fog
     9,      // pixel lighting + texture + vertex color
     9,      // pixel lighting + texture + vertex color, no fog
+
+    0,      // basic, instancing
+    1,      // no fog, instancing
+    0,      // vertex color, instancing
+    1,      // vertex color, no fog, instancing
+    2,      // texture, instancing
+    3,      // texture, no fog, instancing
+    2,      // texture + vertex color, instancing
+    3,      // texture + vertex color, no fog, instancing
+    
+    4,      // vertex lighting, instancing
+    5,      // vertex lighting, no fog, instancing
+    4,      // vertex lighting + vertex color, instancing
+    5,      // vertex lighting + vertex color, no fog, instancing
+    6,      // vertex lighting + texture, instancing
+    7,      // vertex lighting + texture, no fog, instancing
+    6,      // vertex lighting + texture + vertex color, instancing
+    7,      // vertex lighting + texture + vertex color, no fog, instancing
+    
+    4,      // one light, instancing
+    5,      // one light, no fog, instancing
+    4,      // one light + vertex color, instancing
+    5,      // one light + vertex color, no fog, instancing
+    6,      // one light + texture, instancing
+    7,      // one light + texture, no fog, instancing
+    6,      // one light + texture + vertex color, instancing
+    7,      // one light + texture + vertex color, no fog, instancing
+    
+    8,      // pixel lighting, instancing
+    8,      // pixel lighting, no fog, instancing
+    8,      // pixel lighting + vertex color, instancing
+    8,      // pixel lighting + vertex color, no fog, instancing
+    9,      // pixel lighting + texture, instancing
+    9,      // pixel lighting + texture, no fog, instancing
+    9,      // pixel lighting + texture + vertex color, instancing
+    9,      // pixel lighting + texture + vertex color, no fog, instancing
+
+    10,     // tiled lighting
+    10,     // tiled lighting, no fog
+    10,     // tiled lighting + vertex color
+    10,     // tiled lighting + vertex color, no fog
+    11,     // tiled lighting + texture
+    11,     // tiled lighting + texture, no fog
+    11,     // tiled lighting + texture + vertex color
+    11,     // tiled lighting + texture + vertex color, no fog
+
+    10,     // tiled lighting, instancing
+    10,     // tiled lighting, no fog, instancing
+    10,     // tiled lighting + vertex color, instancing
+    10,     // tiled lighting + vertex color, no fog, instancing
+    11,     // tiled lighting + texture, instancing
+    11,     // tiled lighting + texture, no fog, instancing
+    11,     // tiled lighting + texture + vertex color, instancing
+    11,     // tiled lighting + texture + vertex color, no fog, instancing
+
+    12,     // depth only
+    12,     // depth only, instancing
 };
 
 
@@ -287,7 +509,11 @@ BasicEffect::Impl::Impl(_In_ ID3D11Device* device)
     lightingEnabled(false),
     preferPerPixelLighting(false),
     vertexColorEnabled(false),
-    textureEnabled(false)
+    textureEnabled(false),
+    instancingEnabled(false),
+    depthOnly(false),
+    lightGrid(nullptr),
+    mObjectConstantBuffer(device)
 {
     static_assert( _countof(EffectBase<BasicEffectTraits>::VertexShaderIndices) == BasicEffectTraits::ShaderPermutationCount, "array/max mismatch" );
     static_assert( _countof(EffectBase<BasicEffectTraits>::VertexShaderBytecode) == BasicEffectTraits::VertexShaderCount, "array/max mismatch" );
@@ -295,11 +521,39 @@ BasicEffect::Impl::Impl(_In_ ID3D11Device* device)
     static_assert( _countof(EffectBase<BasicEffectTraits>::PixelShaderIndices) == BasicEffectTraits::ShaderPermutationCount, "array/max mismatch" );
 
     lights.InitializeConstants(constants.specularColorAndPower, constants.lightDirection, constants.lightDiffuseColor, constants.lightSpecularColor);
+
+    ZeroMemory(&objectConstants, sizeof(objectConstants));
+}
+
+
+// Copy constructor, used by Clone. The copy gets its own per-object constant buffer too.
+BasicEffect::Impl::Impl(Impl const& other)
+  : EffectBase(other),
+    lightingEnabled(other.lightingEnabled),
+    preferPerPixelLighting(other.preferPerPixelLighting),
+    vertexColorEnabled(other.vertexColorEnabled),
+    textureEnabled(other.textureEnabled),
+    instancingEnabled(other.instancingEnabled),
+    depthOnly(other.depthOnly),
+    lightGrid(other.lightGrid),
+    lights(other.lights),
+    objectConstants(other.objectConstants)
+{
+    Microsoft::WRL::ComPtr<ID3D11Device> device;
+    other.mObjectConstantBuffer.GetBuffer()->GetDevice(&device);
+
+    mObjectConstantBuffer.Create(device.Get());
 }
 
 
 int BasicEffect::Impl::GetCurrentShaderPermutation() const
 {
+    // Depth only passes just need the position, and no pixel shader.
+    if (depthOnly)
+    {
+        return instancingEnabled ? 81 : 80;
+    }
+
     int permutation = 0;
 
     // Use optimized shaders if fog is disabled.
@@ -320,6 +574,19 @@ int BasicEffect::Impl::GetCurrentShaderPermutation() const
         permutation += 4;
     }
 
+    if (lightingEnabled && lightGrid)
+    {
+        // Pixel lighting that adds the light grid's point lights, after all the other shaders.
+        permutation += 64;
+
+        if (instancingEnabled)
+        {
+            permutation += 8;
+        }
+
+        return permutation;
+    }
+
     if (lightingEnabled)
     {
         if (preferPerPixelLighting)
@@ -339,6 +606,12 @@ int BasicEffect::Impl::GetCurrentShaderPermutation() const
         }
     }
 
+    // Take the per-instance world transforms from a second vertex buffer?
+    if (instancingEnabled)
+    {
+        permutation += 32;
+    }
+
     return permutation;
 }
 
@@ -347,19 +620,51 @@ int BasicEffect::Impl::GetCurrentShaderPermutation() const
 void BasicEffect::Impl::Apply(_In_ ID3D11DeviceContext* deviceContext)
 {
     // Compute derived parameter values.
-    matrices.SetConstants(dirtyFlags, constants.worldViewProj);
+    matrices.SetConstants(dirtyFlags, objectConstants.worldViewProj);
 
-    fog.SetConstants(dirtyFlags, matrices.worldView, constants.fogVector);
+    fog.SetConstants(dirtyFlags, matrices.worldView, objectConstants.fogVector);
             
-    lights.SetConstants(dirtyFlags, matrices, constants.world, constants.worldInverseTranspose, constants.eyePosition, constants.diffuseColor, constants.emissiveColor, lightingEnabled);
+    lights.SetConstants(dirtyFlags, matrices, objectConstants.world, objectConstants.worldInverseTranspose, constants.eyePosition, constants.diffuseColor, constants.emissiveColor, lightingEnabled);
+
+    // A new world matrix only touches the per-object constants, so ApplyShaders leaves the main buffer alone unless something
+    // else changed. Dynamic buffers have undefined contents at the start of each command list, so deferred contexts always write it.
+    if ((dirtyFlags & EffectDirtyFlags::ObjectConstantBuffer) || deviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+    {
+        mObjectConstantBuffer.SetData(deviceContext, objectConstants);
+
+        dirtyFlags &= ~EffectDirtyFlags::ObjectConstantBuffer;
+    }
+
+    ID3D11Buffer* objectBuffer = mObjectConstantBuffer.GetBuffer();
+
+    deviceContext->VSSetConstantBuffers(1, 1, &objectBuffer);
 
     // Set the texture.
-    if (textureEnabled)
+    if (textureEnabled && !depthOnly)
     {
         ID3D11ShaderResourceView* textures[1] = { texture.Get() };
 
         deviceContext->PSSetShaderResources(0, 1, textures);
     }
+
+    // Set the light grid, picking up any change in its size since the last draw.
+    if (lightingEnabled && lightGrid && !depthOnly)
+    {
+        UINT tileCountX = lightGrid->GetTileCountX();
+        UINT tileLightStride = lightGrid->GetTileLightStride();
+
+        if (constants.tileCountX != tileCountX || constants.tileLightStride != tileLightStride)
+        {
+            constants.tileCountX = tileCountX;
+            constants.tileLightStride = tileLightStride;
+
+            dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
+        }
+
+        ID3D11ShaderResourceView* buffers[2] = { lightGrid->GetLightBuffer(), lightGrid->GetTileBuffer() };
+
+        deviceContext->PSSetShaderResources(1, 2, buffers);
+    }
     
     // Set shaders and constant buffers.
     ApplyShaders(deviceContext, GetCurrentShaderPermutation());
@@ -388,6 +693,13 @@ BasicEffect& BasicEffect::operator= (BasicEffect&& moveFrom)
 }
 
 
+// Private constructor, used by Clone.
+BasicEffect::BasicEffect(std::unique_ptr<Impl>&& impl)
+  : pImpl(std::move(impl))
+{
+}
+
+
 // Public destructor.
 BasicEffect::~BasicEffect()
 {
@@ -406,6 +718,26 @@ void BasicEffect::GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _O
 }
 
 
+std::shared_ptr<IEffect> BasicEffect::Clone() const
+{
+    std::unique_ptr<Impl> impl(new Impl(*pImpl));
+
+    return std::shared_ptr<IEffect>(new BasicEffect(std::move(impl)));
+}
+
+
+void BasicEffect::WarmUpShaders(bool allPermutations)
+{
+    pImpl->WarmUpShaders(allPermutations ? -1 : pImpl->GetCurrentShaderPermutation());
+}
+
+
+void BasicEffect::GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const
+{
+    pImpl->GetShaderCreationStats(stats);
+}
+
+
 void XM_CALLCONV BasicEffect::SetWorld(FXMMATRIX value)
 {
     pImpl->matrices.world = value;
@@ -585,3 +917,21 @@ void BasicEffect::SetTexture(_In_opt_ ID3D11ShaderResourceView* value)
 {
     pImpl->texture = value;
 }
+
+
+void BasicEffect::SetInstancingEnabled(bool value)
+{
+    pImpl->instancingEnabled = value;
+}
+
+
+void BasicEffect::SetLightGrid(_In_opt_ LightGrid const* value)
+{
+    pImpl->lightGrid = value;
+}
+
+
+void BasicEffect::SetDepthOnly(bool value)
+{
+    pImpl->depthOnly = value;
+}
@@ -18,20 +18,119 @@
 using namespace DirectX;
 
 
+namespace
+{
+    // Below this size, setting up a mapping costs more than copying the data.
+    const DWORD MapThreshold = 64 * 1024;
+
+
+    // Opens a file for reading and gets its size, rejecting files too big for a 32-bit allocation.
+    HRESULT OpenFileForRead(_In_z_ wchar_t const* fileName, DWORD flags, _Inout_ ScopedHandle& hFile, _Out_ DWORD* fileSize)
+    {
+        *fileSize = 0;
+
+        // Open the file.
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+        CREATEFILE2_EXTENDED_PARAMETERS params = { sizeof(CREATEFILE2_EXTENDED_PARAMETERS), FILE_ATTRIBUTE_NORMAL, flags };
+
+        hFile.reset(safe_handle(CreateFile2(fileName, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, flags ? &params : nullptr)));
+#else
+        hFile.reset(safe_handle(CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | flags, nullptr)));
+#endif
+
+        if (!hFile)
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        // Get the file size.
+        LARGE_INTEGER size = { 0 };
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+        FILE_STANDARD_INFO fileInfo;
+
+        if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        size = fileInfo.EndOfFile;
+#else
+        GetFileSizeEx(hFile.get(), &size);
+#endif
+
+        // File is too big for 32-bit allocation, so reject read.
+        if (size.HighPart > 0)
+            return E_FAIL;
+
+        *fileSize = size.LowPart;
+
+        return S_OK;
+    }
+
+
+    // Reads an opened file into memory.
+    HRESULT ReadFileData(_In_ HANDLE hFile, DWORD fileSize, _Inout_ std::unique_ptr<uint8_t[]>& data)
+    {
+        // Create enough space for the file data.
+        data.reset(new uint8_t[fileSize]);
+
+        if (!data)
+            return E_OUTOFMEMORY;
+
+        // Read the data in.
+        DWORD bytesRead = 0;
+
+        if (!ReadFile(hFile, data.get(), fileSize, &bytesRead, nullptr))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        if (bytesRead < fileSize)
+            return E_FAIL;
+
+        return S_OK;
+    }
+
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    // State of one overlapped read, owned by the thread pool completion callback once the read is queued.
+    struct AsyncRead
+    {
+        AsyncRead()
+          : io(nullptr),
+            fileSize(0)
+        {
+            memset(&overlapped, 0, sizeof(overlapped));
+        }
+
+        ~AsyncRead()
+        {
+            if (io)
+                CloseThreadpoolIo(io);
+        }
+
+        ScopedHandle file;
+        PTP_IO io;
+        OVERLAPPED overlapped;
+        DWORD fileSize;
+        BinaryReader::FileData data;
+        BinaryReader::ReadCallback callback;
+    };
+#endif
+}
+
+
 // Constructor reads from the filesystem.
 BinaryReader::BinaryReader(_In_z_ wchar_t const* fileName)
 {
-    size_t dataSize;
-
-    HRESULT hr = ReadEntireFile(fileName, mOwnedData, &dataSize);
+    HRESULT hr = LoadEntireFile(fileName, mFile);
     if ( FAILED(hr) )
     {
         DebugTrace( "BinaryReader failed (%08X) to load '%ls'\n", hr, fileName );
         throw std::exception( "BinaryReader" );
     }
 
-    mPos = mOwnedData.get();
-    mEnd = mOwnedData.get() + dataSize;
+    mPos = mFile.get();
+    mEnd = mFile.get() + mFile.size();
 }
 
 
@@ -46,54 +145,213 @@ BinaryReader::BinaryReader(_In_reads_bytes_(dataSize) uint8_t const* dataBlob, s
 // Reads from the filesystem into memory.
 HRESULT BinaryReader::ReadEntireFile(_In_z_ wchar_t const* fileName, _Inout_ std::unique_ptr<uint8_t[]>& data, _Out_ size_t* dataSize)
 {
-    // Open the file.
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
-    ScopedHandle hFile(safe_handle(CreateFile2(fileName, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr)));
+    *dataSize = 0;
+
+    ScopedHandle hFile;
+    DWORD fileSize;
+
+    HRESULT hr = OpenFileForRead(fileName, 0, hFile, &fileSize);
+    if (FAILED(hr))
+        return hr;
+
+    hr = ReadFileData(hFile.get(), fileSize, data);
+    if (FAILED(hr))
+        return hr;
+
+    *dataSize = fileSize;
+
+    return S_OK;
+}
+
+
+// Maps larger files into memory, and reads smaller ones.
+HRESULT BinaryReader::LoadEntireFile(_In_z_ wchar_t const* fileName, _Inout_ FileData& data)
+{
+    data.reset();
+
+    ScopedHandle hFile;
+    DWORD fileSize;
+
+    HRESULT hr = OpenFileForRead(fileName, 0, hFile, &fileSize);
+    if (FAILED(hr))
+        return hr;
+
+    if (fileSize < MapThreshold)
+    {
+        hr = ReadFileData(hFile.get(), fileSize, data.mOwnedData);
+        if (FAILED(hr))
+            return hr;
+
+        data.mData = data.mOwnedData.get();
+        data.mSize = fileSize;
+
+        return S_OK;
+    }
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+    ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+#else
+    ScopedHandle hMapping(CreateFileMappingFromApp(hFile.get(), nullptr, PAGE_READONLY, 0, nullptr));
+#endif
+
+    if (!hMapping)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+    data.mView.reset(MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0));
 #else
-    ScopedHandle hFile(safe_handle(CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)));
+    data.mView.reset(MapViewOfFileFromApp(hMapping.get(), FILE_MAP_READ, 0, 0));
 #endif
 
-    if (!hFile)
+    if (!data.mView)
         return HRESULT_FROM_WIN32(GetLastError());
 
-    // Get the file size.
-    LARGE_INTEGER fileSize = { 0 };
+    // The view keeps the file mapping alive, so both handles can be closed on return.
+    data.mData = static_cast<uint8_t const*>(data.mView.get());
+    data.mSize = fileSize;
+
+    return S_OK;
+}
+
 
 #if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
-    FILE_STANDARD_INFO fileInfo;
 
-    if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+// Thread pool completion for ReadEntireFileAsync.
+static VOID CALLBACK ReadEntireFileCompleted(PTP_CALLBACK_INSTANCE, PVOID context, PVOID, ULONG ioResult, ULONG_PTR bytesTransferred, PTP_IO)
+{
+    std::unique_ptr<AsyncRead> read(static_cast<AsyncRead*>(context));
+
+    HRESULT hr = S_OK;
+
+    if (ioResult != NO_ERROR)
     {
-        return HRESULT_FROM_WIN32(GetLastError());
+        hr = HRESULT_FROM_WIN32(ioResult);
+    }
+    else if (bytesTransferred < read->fileSize)
+    {
+        hr = E_FAIL;
     }
 
-    fileSize = fileInfo.EndOfFile;
-#else
-    GetFileSizeEx(hFile.get(), &fileSize);
+    if (FAILED(hr))
+    {
+        read->data.reset();
+    }
+
+    // Exceptions can't propagate into the thread pool.
+    try
+    {
+        read->callback(hr, read->data);
+    }
+    catch (std::exception&)
+    {
+        DebugTrace( "ERROR: BinaryReader read completion callback failed\n" );
+    }
+}
+
 #endif
 
-    // File is too big for 32-bit allocation, so reject read.
-    if (fileSize.HighPart > 0)
-        return E_FAIL;
 
-    // Create enough space for the file data.
-    data.reset(new uint8_t[fileSize.LowPart]);
+// Queues an overlapped read of the whole file, completed on the thread pool.
+HRESULT BinaryReader::ReadEntireFileAsync(_In_z_ wchar_t const* fileName, ReadCallback callback)
+{
+    if (!callback)
+        return E_INVALIDARG;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    std::unique_ptr<AsyncRead> read(new AsyncRead());
+
+    HRESULT hr = OpenFileForRead(fileName, FILE_FLAG_OVERLAPPED, read->file, &read->fileSize);
+    if (FAILED(hr))
+        return hr;
 
-    if (!data)
+    read->data.mOwnedData.reset(new uint8_t[read->fileSize]);
+    if (!read->data.mOwnedData)
         return E_OUTOFMEMORY;
 
-    // Read the data in.
-    DWORD bytesRead = 0;
+    read->data.mData = read->data.mOwnedData.get();
+    read->data.mSize = read->fileSize;
 
-    if (!ReadFile(hFile.get(), data.get(), fileSize.LowPart, &bytesRead, nullptr))
-    {
+    read->callback = callback;
+
+    read->io = CreateThreadpoolIo(read->file.get(), ReadEntireFileCompleted, read.get(), nullptr);
+    if (!read->io)
         return HRESULT_FROM_WIN32(GetLastError());
+
+    StartThreadpoolIo(read->io);
+
+    if (!ReadFile(read->file.get(), read->data.mOwnedData.get(), read->fileSize, nullptr, &read->overlapped))
+    {
+        DWORD error = GetLastError();
+        if (error != ERROR_IO_PENDING)
+        {
+            CancelThreadpoolIo(read->io);
+            return HRESULT_FROM_WIN32(error);
+        }
     }
 
-    if (bytesRead < fileSize.LowPart)
-        return E_FAIL;
+    // Even when ReadFile finishes at once the completion is still queued, so the callback now owns the read.
+    read.release();
+
+    return S_OK;
+#else
+    FileData data;
+
+    HRESULT hr = ReadEntireFile(fileName, data.mOwnedData, &data.mSize);
+    if (FAILED(hr))
+        return hr;
+
+    data.mData = data.mOwnedData.get();
+
+    callback(S_OK, data);
 
-    *dataSize = bytesRead;
-    
     return S_OK;
+#endif
+}
+
+
+//--------------------------------------------------------------------------------------
+// BinaryReader::FileData
+//--------------------------------------------------------------------------------------
+
+BinaryReader::FileData::FileData()
+  : mData(nullptr),
+    mSize(0)
+{
+}
+
+
+// Move constructor.
+BinaryReader::FileData::FileData(FileData&& moveFrom)
+  : mOwnedData(std::move(moveFrom.mOwnedData)),
+    mView(std::move(moveFrom.mView)),
+    mData(moveFrom.mData),
+    mSize(moveFrom.mSize)
+{
+    moveFrom.mData = nullptr;
+    moveFrom.mSize = 0;
+}
+
+
+// Move assignment.
+BinaryReader::FileData& BinaryReader::FileData::operator= (FileData&& moveFrom)
+{
+    mOwnedData = std::move(moveFrom.mOwnedData);
+    mView = std::move(moveFrom.mView);
+    mData = moveFrom.mData;
+    mSize = moveFrom.mSize;
+
+    moveFrom.mData = nullptr;
+    moveFrom.mSize = 0;
+
+    return *this;
+}
+
+
+// Releases the buffer or unmaps the view.
+void BinaryReader::FileData::reset()
+{
+    mOwnedData.reset();
+    mView.reset();
+    mData = nullptr;
+    mSize = 0;
 }
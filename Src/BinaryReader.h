@@ -15,6 +15,7 @@
 
 #include <memory>
 #include <exception>
+#include <functional>
 #include <type_traits>
 
 #include "PlatformHelpers.h"
@@ -26,6 +27,40 @@ namespace DirectX
     class BinaryReader
     {
     public:
+        // Contents of a whole file, either mapped into memory or read into a buffer.
+        class FileData
+        {
+        public:
+            FileData();
+            FileData(FileData&& moveFrom);
+            FileData& operator= (FileData&& moveFrom);
+
+            uint8_t const* get() const { return mData; }
+            size_t size() const { return mSize; }
+
+            bool IsMapped() const { return mView.get() != nullptr; }
+
+            void reset();
+
+        private:
+            friend class BinaryReader;
+
+            struct mapped_view_closer { void operator()(void* p) { if (p) UnmapViewOfFile(p); } };
+
+            std::unique_ptr<uint8_t[]> mOwnedData;
+            std::unique_ptr<void, mapped_view_closer> mView;
+            uint8_t const* mData;
+            size_t mSize;
+
+            // Prevent copying.
+            FileData(FileData const&) DIRECTX_CTOR_DELETE
+            FileData& operator= (FileData const&) DIRECTX_CTOR_DELETE
+        };
+
+        // Called when an asynchronous read finishes. The data may be moved out to keep it past the callback.
+        typedef std::function<void(HRESULT hr, FileData& data)> ReadCallback;
+
+
         explicit BinaryReader(_In_z_ wchar_t const* fileName);
         BinaryReader(_In_reads_bytes_(dataSize) uint8_t const* dataBlob, size_t dataSize);
 
@@ -58,13 +93,21 @@ namespace DirectX
         // Lower level helper reads directly from the filesystem into memory.
         static HRESULT ReadEntireFile(_In_z_ wchar_t const* fileName, _Inout_ std::unique_ptr<uint8_t[]>& data, _Out_ size_t* dataSize);
 
+        // Loads a whole file without copying it, by mapping it into memory, unless it is small enough that a plain read is cheaper.
+        static HRESULT LoadEntireFile(_In_z_ wchar_t const* fileName, _Inout_ FileData& data);
+
+        // Starts reading a whole file with overlapped I/O, and returns once the read is queued. The callback runs on a thread
+        // pool thread when the read completes, and is not called if this returns a failure. Before Windows Vista the file
+        // is read before returning, and the callback runs on the calling thread.
+        static HRESULT ReadEntireFileAsync(_In_z_ wchar_t const* fileName, ReadCallback callback);
+
 
     private:
         // The data currently being read.
         uint8_t const* mPos;
         uint8_t const* mEnd;
 
-        std::unique_ptr<uint8_t[]> mOwnedData;
+        FileData mFile;
 
 
         // Prevent copying.
@@ -0,0 +1,1117 @@
+//--------------------------------------------------------------------------------------
+// File: BoundingVolumeHierarchy.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Model.h"
+
+#include <float.h>
+
+using namespace DirectX;
+
+
+namespace
+{
+    const uint32_t LeafNode = 0xffffffff;
+
+    // Build limits. The depth limit bounds the traversal stack, so it is enforced even if leaves must grow past MaxLeafItems.
+    const uint32_t BinCount = 16;
+    const uint32_t MaxLeafItems = 4;
+    const uint32_t MaxDepth = 64;
+    const size_t StackSize = 3 * MaxDepth + 4;
+
+    // Cost of visiting a node relative to testing one item, for the surface area heuristic.
+    const float TraversalCost = 0.5f;
+
+
+    // Binary tree used during the build, which is then collapsed into four-wide nodes.
+    struct BuildNode
+    {
+        XMFLOAT3 minimum;
+        XMFLOAT3 maximum;
+        uint32_t left;
+        uint32_t right;
+        uint32_t first;
+        uint32_t count;
+    };
+
+
+    inline float HalfSurfaceArea( FXMVECTOR minimum, FXMVECTOR maximum )
+    {
+        XMVECTOR size = XMVectorMax( XMVectorSubtract( maximum, minimum ), g_XMZero );
+        XMVECTOR rotated = XMVectorSwizzle<1, 2, 0, 3>( size );
+
+        return XMVectorGetX( XMVector3Dot( size, rotated ) );
+    }
+
+
+    inline float HalfSurfaceArea( const BuildNode& node )
+    {
+        return HalfSurfaceArea( XMLoadFloat3( &node.minimum ), XMLoadFloat3( &node.maximum ) );
+    }
+
+
+    inline void GetMinMax( const BoundingBox& box, XMVECTOR& minimum, XMVECTOR& maximum )
+    {
+        XMVECTOR center = XMLoadFloat3( &box.Center );
+        XMVECTOR extents = XMLoadFloat3( &box.Extents );
+
+        minimum = XMVectorSubtract( center, extents );
+        maximum = XMVectorAdd( center, extents );
+    }
+
+
+    // Plane splatted across the four lanes, along with which bounds give the nearest and farthest corners.
+    struct LanePlane
+    {
+        XMVECTOR a, b, c, d;
+        int nearX, nearY, nearZ;
+    };
+
+
+    void SetupLanePlane( FXMVECTOR plane, LanePlane& result )
+    {
+        result.a = XMVectorSplatX( plane );
+        result.b = XMVectorSplatY( plane );
+        result.c = XMVectorSplatZ( plane );
+        result.d = XMVectorSplatW( plane );
+
+        // Frustum planes face outwards, so the corner least far along the normal is the one most likely inside.
+        result.nearX = ( XMVectorGetX( plane ) > 0 ) ? 0 : 3;
+        result.nearY = ( XMVectorGetY( plane ) > 0 ) ? 1 : 4;
+        result.nearZ = ( XMVectorGetZ( plane ) > 0 ) ? 2 : 5;
+    }
+}
+
+
+// Internal BoundingVolumeHierarchy implementation class.
+class BoundingVolumeHierarchy::Impl
+{
+public:
+    enum ItemType
+    {
+        Boxes,
+        Meshes,
+        Triangles,
+    };
+
+    // Four children, with their bounds stored by component (min x, y, z then max x, y, z) so each can be loaded into a
+    // vector and tested together. Children that are leaves have child set to LeafNode and index a range of mOrder.
+    // Internal children also record the range covered by their subtree, so a node wholly inside a query can be added at once.
+    struct Node
+    {
+        XMFLOAT4 bounds[6];
+        uint32_t child[4];
+        uint32_t first[4];
+        uint32_t count[4];
+    };
+
+    Impl()
+      : mType( Boxes ),
+        mInstanceCount( 0 ),
+        mVertexCount( 0 )
+    {
+    }
+
+    void BuildTree();
+    void RefitTree();
+
+    void SetMeshBounds( Model const* const* models, XMMATRIX const* worlds, size_t count, bool refit );
+    void SetTriangleBounds( const XMFLOAT3* positions );
+
+    template<typename index_t>
+    void SetTriangles( const XMFLOAT3* positions, size_t vertexCount, const index_t* indices, size_t triangleCount );
+
+    bool TestItem( uint32_t item, const BoundingFrustum& frustum ) const;
+    bool TestItem( uint32_t item, const BoundingBox& box ) const;
+    bool XM_CALLCONV TestItem( uint32_t item, FXMVECTOR origin, FXMVECTOR direction, float& dist ) const;
+
+    void AddRange( uint32_t first, uint32_t count, std::vector<uint32_t>& results ) const;
+
+    ItemType                    mType;
+    std::vector<BoundingBox>    mItems;
+    std::vector<uint32_t>       mOrder;
+    std::vector<Node>           mNodes;
+
+    size_t                      mInstanceCount;
+    std::vector<uint32_t>       mItemInstance;
+    std::vector<uint32_t>       mItemMesh;
+
+    size_t                      mVertexCount;
+    std::vector<XMFLOAT3>       mPositions;
+    std::vector<uint32_t>       mIndices;
+
+private:
+    uint32_t BuildRecursive( std::vector<BuildNode>& nodes, const std::vector<XMFLOAT3>& centroids, uint32_t first, uint32_t count, uint32_t depth );
+    uint32_t Collapse( const std::vector<BuildNode>& nodes, uint32_t index );
+};
+
+
+// Recursively splits mOrder[first, first + count) using a binned surface area heuristic, returning the new build node.
+uint32_t BoundingVolumeHierarchy::Impl::BuildRecursive( std::vector<BuildNode>& nodes, const std::vector<XMFLOAT3>& centroids, uint32_t first, uint32_t count, uint32_t depth )
+{
+    XMVECTOR boundsMin = g_XMFltMax;
+    XMVECTOR boundsMax = XMVectorNegate( g_XMFltMax );
+    XMVECTOR centroidMin = boundsMin;
+    XMVECTOR centroidMax = boundsMax;
+
+    for( uint32_t i = first; i < first + count; ++i )
+    {
+        uint32_t item = mOrder[ i ];
+
+        XMVECTOR minimum, maximum;
+        GetMinMax( mItems[ item ], minimum, maximum );
+
+        boundsMin = XMVectorMin( boundsMin, minimum );
+        boundsMax = XMVectorMax( boundsMax, maximum );
+
+        XMVECTOR centroid = XMLoadFloat3( &centroids[ item ] );
+
+        centroidMin = XMVectorMin( centroidMin, centroid );
+        centroidMax = XMVectorMax( centroidMax, centroid );
+    }
+
+    uint32_t index = static_cast<uint32_t>( nodes.size() );
+
+    BuildNode node;
+    XMStoreFloat3( &node.minimum, boundsMin );
+    XMStoreFloat3( &node.maximum, boundsMax );
+    node.left = LeafNode;
+    node.right = LeafNode;
+    node.first = first;
+    node.count = count;
+
+    nodes.push_back( node );
+
+    if ( count <= 1 || depth >= MaxDepth )
+        return index;
+
+    // Bin along the axis where the centroids are most spread out.
+    XMFLOAT3 cmin, cmax;
+    XMStoreFloat3( &cmin, centroidMin );
+    XMStoreFloat3( &cmax, centroidMax );
+
+    float extent[3] = { cmax.x - cmin.x, cmax.y - cmin.y, cmax.z - cmin.z };
+    float start[3] = { cmin.x, cmin.y, cmin.z };
+
+    int axis = 0;
+
+    if ( extent[1] > extent[axis] )
+        axis = 1;
+
+    if ( extent[2] > extent[axis] )
+        axis = 2;
+
+    uint32_t split = first + count / 2;
+
+    if ( extent[axis] > 0 )
+    {
+        uint32_t binItems[ BinCount ] = { 0 };
+        XMVECTOR binMin[ BinCount ];
+        XMVECTOR binMax[ BinCount ];
+
+        for( uint32_t i = 0; i < BinCount; ++i )
+        {
+            binMin[ i ] = g_XMFltMax;
+            binMax[ i ] = XMVectorNegate( g_XMFltMax );
+        }
+
+        float scale = float( BinCount ) / extent[axis];
+
+        for( uint32_t i = first; i < first + count; ++i )
+        {
+            uint32_t item = mOrder[ i ];
+
+            const float* centroid = &centroids[ item ].x;
+
+            uint32_t bin = std::min( static_cast<uint32_t>( ( centroid[axis] - start[axis] ) * scale ), BinCount - 1 );
+
+            XMVECTOR minimum, maximum;
+            GetMinMax( mItems[ item ], minimum, maximum );
+
+            binMin[ bin ] = XMVectorMin( binMin[ bin ], minimum );
+            binMax[ bin ] = XMVectorMax( binMax[ bin ], maximum );
+            ++binItems[ bin ];
+        }
+
+        // Sweep from the right to find the cost of everything after each split plane, then from the left to pick the best.
+        float rightCost[ BinCount ];
+
+        XMVECTOR sweepMin = g_XMFltMax;
+        XMVECTOR sweepMax = XMVectorNegate( g_XMFltMax );
+        uint32_t sweepItems = 0;
+
+        for( uint32_t i = BinCount - 1; i > 0; --i )
+        {
+            sweepMin = XMVectorMin( sweepMin, binMin[ i ] );
+            sweepMax = XMVectorMax( sweepMax, binMax[ i ] );
+            sweepItems += binItems[ i ];
+
+            rightCost[ i ] = sweepItems ? HalfSurfaceArea( sweepMin, sweepMax ) * float( sweepItems ) : 0;
+        }
+
+        sweepMin = g_XMFltMax;
+        sweepMax = XMVectorNegate( g_XMFltMax );
+        sweepItems = 0;
+
+        float bestCost = FLT_MAX;
+        uint32_t bestBin = 0;
+
+        for( uint32_t i = 0; i < BinCount - 1; ++i )
+        {
+            sweepMin = XMVectorMin( sweepMin, binMin[ i ] );
+            sweepMax = XMVectorMax( sweepMax, binMax[ i ] );
+            sweepItems += binItems[ i ];
+
+            if ( !sweepItems || sweepItems == count )
+                continue;
+
+            float cost = HalfSurfaceArea( sweepMin, sweepMax ) * float( sweepItems ) + rightCost[ i + 1 ];
+
+            if ( cost < bestCost )
+            {
+                bestCost = cost;
+                bestBin = i;
+            }
+        }
+
+        float area = HalfSurfaceArea( boundsMin, boundsMax );
+
+        if ( count <= MaxLeafItems && area * float( count ) <= area * TraversalCost + bestCost )
+            return index;
+
+        if ( bestCost < FLT_MAX )
+        {
+            auto middle = std::partition( mOrder.begin() + first, mOrder.begin() + first + count, [&]( uint32_t item ) -> bool
+            {
+                const float* centroid = &centroids[ item ].x;
+
+                uint32_t bin = std::min( static_cast<uint32_t>( ( centroid[axis] - start[axis] ) * scale ), BinCount - 1 );
+
+                return bin <= bestBin;
+            });
+
+            split = static_cast<uint32_t>( middle - mOrder.begin() );
+        }
+    }
+    else if ( count <= MaxLeafItems )
+    {
+        // Everything is in the same place, so splitting gains nothing.
+        return index;
+    }
+
+    uint32_t left = BuildRecursive( nodes, centroids, first, split - first, depth + 1 );
+    uint32_t right = BuildRecursive( nodes, centroids, split, first + count - split, depth + 1 );
+
+    nodes[ index ].left = left;
+    nodes[ index ].right = right;
+
+    return index;
+}
+
+
+// Turns an internal build node into a four-wide node, pulling up the grandchildren with the largest bounds.
+uint32_t BoundingVolumeHierarchy::Impl::Collapse( const std::vector<BuildNode>& nodes, uint32_t index )
+{
+    uint32_t children[4] = { nodes[ index ].left, nodes[ index ].right, 0, 0 };
+    uint32_t childCount = 2;
+
+    if ( nodes[ index ].left == LeafNode )
+    {
+        // Leaf root.
+        children[0] = index;
+        childCount = 1;
+    }
+
+    while( childCount < 4 )
+    {
+        int best = -1;
+        float bestArea = -1;
+
+        for( uint32_t i = 0; i < childCount; ++i )
+        {
+            const BuildNode& child = nodes[ children[ i ] ];
+
+            if ( child.left != LeafNode )
+            {
+                float area = HalfSurfaceArea( child );
+
+                if ( area > bestArea )
+                {
+                    bestArea = area;
+                    best = static_cast<int>( i );
+                }
+            }
+        }
+
+        if ( best < 0 )
+            break;
+
+        const BuildNode& expand = nodes[ children[ best ] ];
+
+        children[ best ] = expand.left;
+        children[ childCount++ ] = expand.right;
+    }
+
+    uint32_t result = static_cast<uint32_t>( mNodes.size() );
+
+    Node node;
+
+    for( uint32_t i = 0; i < 4; ++i )
+    {
+        node.child[ i ] = LeafNode;
+        node.first[ i ] = 0;
+        node.count[ i ] = 0;
+    }
+
+    // Unused children get inverted bounds, which every query rejects.
+    for( uint32_t i = 0; i < 3; ++i )
+    {
+        XMStoreFloat4( &node.bounds[ i ], g_XMFltMax );
+        XMStoreFloat4( &node.bounds[ i + 3 ], XMVectorNegate( g_XMFltMax ) );
+    }
+
+    for( uint32_t i = 0; i < childCount; ++i )
+    {
+        const BuildNode& child = nodes[ children[ i ] ];
+
+        (&node.bounds[0].x)[ i ] = child.minimum.x;
+        (&node.bounds[1].x)[ i ] = child.minimum.y;
+        (&node.bounds[2].x)[ i ] = child.minimum.z;
+        (&node.bounds[3].x)[ i ] = child.maximum.x;
+        (&node.bounds[4].x)[ i ] = child.maximum.y;
+        (&node.bounds[5].x)[ i ] = child.maximum.z;
+
+        node.first[ i ] = child.first;
+        node.count[ i ] = child.count;
+    }
+
+    mNodes.push_back( node );
+
+    // Children are added after their parent, which lets RefitTree work backwards through the array.
+    for( uint32_t i = 0; i < childCount; ++i )
+    {
+        if ( nodes[ children[ i ] ].left != LeafNode )
+        {
+            uint32_t child = Collapse( nodes, children[ i ] );
+
+            mNodes[ result ].child[ i ] = child;
+        }
+    }
+
+    return result;
+}
+
+
+void BoundingVolumeHierarchy::Impl::BuildTree()
+{
+    mNodes.clear();
+    mOrder.clear();
+
+    if ( mItems.empty() )
+        return;
+
+    uint32_t count = static_cast<uint32_t>( mItems.size() );
+
+    mOrder.resize( count );
+
+    std::vector<XMFLOAT3> centroids( count );
+
+    for( uint32_t i = 0; i < count; ++i )
+    {
+        mOrder[ i ] = i;
+        centroids[ i ] = mItems[ i ].Center;
+    }
+
+    std::vector<BuildNode> nodes;
+    nodes.reserve( count * 2 );
+
+    uint32_t root = BuildRecursive( nodes, centroids, 0, count, 0 );
+
+    mNodes.reserve( nodes.size() / 2 + 1 );
+
+    Collapse( nodes, root );
+}
+
+
+// Recomputes the bounds from the items upwards, children first.
+void BoundingVolumeHierarchy::Impl::RefitTree()
+{
+    for( size_t index = mNodes.size(); index > 0; --index )
+    {
+        Node& node = mNodes[ index - 1 ];
+
+        for( uint32_t i = 0; i < 4; ++i )
+        {
+            if ( !node.count[ i ] )
+                continue;
+
+            XMVECTOR boundsMin = g_XMFltMax;
+            XMVECTOR boundsMax = XMVectorNegate( g_XMFltMax );
+
+            if ( node.child[ i ] == LeafNode )
+            {
+                for( uint32_t j = node.first[ i ]; j < node.first[ i ] + node.count[ i ]; ++j )
+                {
+                    XMVECTOR minimum, maximum;
+                    GetMinMax( mItems[ mOrder[ j ] ], minimum, maximum );
+
+                    boundsMin = XMVectorMin( boundsMin, minimum );
+                    boundsMax = XMVectorMax( boundsMax, maximum );
+                }
+            }
+            else
+            {
+                // Reduce the four children of the child node.
+                const Node& child = mNodes[ node.child[ i ] ];
+
+                XMVECTOR minX = XMLoadFloat4( &child.bounds[0] );
+                XMVECTOR minY = XMLoadFloat4( &child.bounds[1] );
+                XMVECTOR minZ = XMLoadFloat4( &child.bounds[2] );
+                XMVECTOR maxX = XMLoadFloat4( &child.bounds[3] );
+                XMVECTOR maxY = XMLoadFloat4( &child.bounds[4] );
+                XMVECTOR maxZ = XMLoadFloat4( &child.bounds[5] );
+
+                XMMATRIX mins( minX, minY, minZ, g_XMFltMax );
+                mins = XMMatrixTranspose( mins );
+                XMMATRIX maxs( maxX, maxY, maxZ, XMVectorNegate( g_XMFltMax ) );
+                maxs = XMMatrixTranspose( maxs );
+
+                boundsMin = XMVectorMin( XMVectorMin( mins.r[0], mins.r[1] ), XMVectorMin( mins.r[2], mins.r[3] ) );
+                boundsMax = XMVectorMax( XMVectorMax( maxs.r[0], maxs.r[1] ), XMVectorMax( maxs.r[2], maxs.r[3] ) );
+            }
+
+            XMFLOAT3 minimum, maximum;
+            XMStoreFloat3( &minimum, boundsMin );
+            XMStoreFloat3( &maximum, boundsMax );
+
+            (&node.bounds[0].x)[ i ] = minimum.x;
+            (&node.bounds[1].x)[ i ] = minimum.y;
+            (&node.bounds[2].x)[ i ] = minimum.z;
+            (&node.bounds[3].x)[ i ] = maximum.x;
+            (&node.bounds[4].x)[ i ] = maximum.y;
+            (&node.bounds[5].x)[ i ] = maximum.z;
+        }
+    }
+}
+
+
+void BoundingVolumeHierarchy::Impl::SetMeshBounds( Model const* const* models, XMMATRIX const* worlds, size_t count, bool refit )
+{
+    if ( count && ( !models || !worlds ) )
+        throw std::exception("Models and world matrices cannot be null");
+
+    if ( refit && ( mType != Meshes || count != mInstanceCount ) )
+        throw std::exception("BoundingVolumeHierarchy::Refit arguments must match the last Build");
+
+    size_t item = 0;
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        if ( !models[ i ] )
+            throw std::exception("Models cannot be null");
+
+        const Model& model = *models[ i ];
+
+        for( size_t j = 0; j < model.meshes.size(); ++j )
+        {
+            auto mesh = model.meshes[ j ].get();
+            assert( mesh != 0 );
+
+            BoundingBox box;
+            mesh->boundingBox.Transform( box, worlds[ i ] );
+
+            if ( refit )
+            {
+                if ( item >= mItems.size() || mItemInstance[ item ] != i || mItemMesh[ item ] != j )
+                    throw std::exception("BoundingVolumeHierarchy::Refit arguments must match the last Build");
+
+                mItems[ item ] = box;
+            }
+            else
+            {
+                if ( mItems.size() >= UINT32_MAX )
+                    throw std::out_of_range("Too many meshes");
+
+                mItems.push_back( box );
+                mItemInstance.push_back( static_cast<uint32_t>( i ) );
+                mItemMesh.push_back( static_cast<uint32_t>( j ) );
+            }
+
+            ++item;
+        }
+    }
+
+    if ( refit && item != mItems.size() )
+        throw std::exception("BoundingVolumeHierarchy::Refit arguments must match the last Build");
+}
+
+
+void BoundingVolumeHierarchy::Impl::SetTriangleBounds( const XMFLOAT3* positions )
+{
+    size_t triangleCount = mIndices.size() / 3;
+
+    for( size_t i = 0; i < triangleCount; ++i )
+    {
+        XMVECTOR v0 = XMLoadFloat3( &positions[ mIndices[ i * 3 ] ] );
+        XMVECTOR v1 = XMLoadFloat3( &positions[ mIndices[ i * 3 + 1 ] ] );
+        XMVECTOR v2 = XMLoadFloat3( &positions[ mIndices[ i * 3 + 2 ] ] );
+
+        XMVECTOR minimum = XMVectorMin( v0, XMVectorMin( v1, v2 ) );
+        XMVECTOR maximum = XMVectorMax( v0, XMVectorMax( v1, v2 ) );
+
+        BoundingBox::CreateFromPoints( mItems[ i ], minimum, maximum );
+    }
+}
+
+
+template<typename index_t>
+void BoundingVolumeHierarchy::Impl::SetTriangles( const XMFLOAT3* positions, size_t vertexCount, const index_t* indices, size_t triangleCount )
+{
+    if ( triangleCount && ( !positions || !indices ) )
+        throw std::exception("Positions and indices cannot be null");
+
+    if ( triangleCount >= UINT32_MAX / 3 )
+        throw std::out_of_range("Too many triangles");
+
+    mType = Triangles;
+    mVertexCount = vertexCount;
+    mPositions.assign( positions, positions + vertexCount );
+    mIndices.resize( triangleCount * 3 );
+
+    for( size_t i = 0; i < triangleCount * 3; ++i )
+    {
+        if ( indices[ i ] >= vertexCount )
+            throw std::out_of_range("Triangle index out of range");
+
+        mIndices[ i ] = indices[ i ];
+    }
+
+    mItems.resize( triangleCount );
+
+    SetTriangleBounds( positions );
+}
+
+
+bool BoundingVolumeHierarchy::Impl::TestItem( uint32_t item, const BoundingFrustum& frustum ) const
+{
+    if ( mType == Triangles )
+    {
+        XMVECTOR v0 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 ] ] );
+        XMVECTOR v1 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 + 1 ] ] );
+        XMVECTOR v2 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 + 2 ] ] );
+
+        return frustum.Intersects( v0, v1, v2 );
+    }
+
+    return frustum.Intersects( mItems[ item ] );
+}
+
+
+bool BoundingVolumeHierarchy::Impl::TestItem( uint32_t item, const BoundingBox& box ) const
+{
+    if ( mType == Triangles )
+    {
+        XMVECTOR v0 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 ] ] );
+        XMVECTOR v1 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 + 1 ] ] );
+        XMVECTOR v2 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 + 2 ] ] );
+
+        return box.Intersects( v0, v1, v2 );
+    }
+
+    return box.Intersects( mItems[ item ] );
+}
+
+
+bool XM_CALLCONV BoundingVolumeHierarchy::Impl::TestItem( uint32_t item, FXMVECTOR origin, FXMVECTOR direction, float& dist ) const
+{
+    if ( mType == Triangles )
+    {
+        XMVECTOR v0 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 ] ] );
+        XMVECTOR v1 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 + 1 ] ] );
+        XMVECTOR v2 = XMLoadFloat3( &mPositions[ mIndices[ item * 3 + 2 ] ] );
+
+        return TriangleTests::Intersects( origin, direction, v0, v1, v2, dist );
+    }
+
+    return mItems[ item ].Intersects( origin, direction, dist );
+}
+
+
+void BoundingVolumeHierarchy::Impl::AddRange( uint32_t first, uint32_t count, std::vector<uint32_t>& results ) const
+{
+    results.insert( results.end(), mOrder.begin() + first, mOrder.begin() + first + count );
+}
+
+
+//--------------------------------------------------------------------------------------
+// BoundingVolumeHierarchy
+//--------------------------------------------------------------------------------------
+
+// Public constructor.
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+  : pImpl(new Impl())
+{
+}
+
+
+// Move constructor.
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(BoundingVolumeHierarchy&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+BoundingVolumeHierarchy& BoundingVolumeHierarchy::operator= (BoundingVolumeHierarchy&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+}
+
+
+_Use_decl_annotations_
+void BoundingVolumeHierarchy::Build( const BoundingBox* boxes, size_t count )
+{
+    if ( count && !boxes )
+        throw std::exception("Boxes cannot be null");
+
+    if ( count >= UINT32_MAX )
+        throw std::out_of_range("Too many boxes");
+
+    std::unique_ptr<Impl> impl( new Impl() );
+
+    impl->mItems.assign( boxes, boxes + count );
+    impl->BuildTree();
+
+    pImpl = std::move( impl );
+}
+
+
+_Use_decl_annotations_
+void BoundingVolumeHierarchy::Build( Model const* const* models, XMMATRIX const* worlds, size_t count )
+{
+    std::unique_ptr<Impl> impl( new Impl() );
+
+    impl->mType = Impl::Meshes;
+    impl->mInstanceCount = count;
+    impl->SetMeshBounds( models, worlds, count, false );
+    impl->BuildTree();
+
+    pImpl = std::move( impl );
+}
+
+
+_Use_decl_annotations_
+void BoundingVolumeHierarchy::Build( const XMFLOAT3* positions, size_t vertexCount, const uint16_t* indices, size_t triangleCount )
+{
+    std::unique_ptr<Impl> impl( new Impl() );
+
+    impl->SetTriangles( positions, vertexCount, indices, triangleCount );
+    impl->BuildTree();
+
+    pImpl = std::move( impl );
+}
+
+
+_Use_decl_annotations_
+void BoundingVolumeHierarchy::Build( const XMFLOAT3* positions, size_t vertexCount, const uint32_t* indices, size_t triangleCount )
+{
+    std::unique_ptr<Impl> impl( new Impl() );
+
+    impl->SetTriangles( positions, vertexCount, indices, triangleCount );
+    impl->BuildTree();
+
+    pImpl = std::move( impl );
+}
+
+
+_Use_decl_annotations_
+void BoundingVolumeHierarchy::Refit( const BoundingBox* boxes, size_t count )
+{
+    if ( pImpl->mType != Impl::Boxes || count != pImpl->mItems.size() )
+        throw std::exception("BoundingVolumeHierarchy::Refit arguments must match the last Build");
+
+    if ( count && !boxes )
+        throw std::exception("Boxes cannot be null");
+
+    std::copy( boxes, boxes + count, pImpl->mItems.begin() );
+
+    pImpl->RefitTree();
+}
+
+
+_Use_decl_annotations_
+void BoundingVolumeHierarchy::Refit( Model const* const* models, XMMATRIX const* worlds, size_t count )
+{
+    pImpl->SetMeshBounds( models, worlds, count, true );
+
+    pImpl->RefitTree();
+}
+
+
+_Use_decl_annotations_
+void BoundingVolumeHierarchy::Refit( const XMFLOAT3* positions, size_t vertexCount )
+{
+    if ( pImpl->mType != Impl::Triangles || vertexCount != pImpl->mVertexCount )
+        throw std::exception("BoundingVolumeHierarchy::Refit arguments must match the last Build");
+
+    if ( vertexCount && !positions )
+        throw std::exception("Positions cannot be null");
+
+    pImpl->mPositions.assign( positions, positions + vertexCount );
+    pImpl->SetTriangleBounds( positions );
+
+    pImpl->RefitTree();
+}
+
+
+size_t BoundingVolumeHierarchy::Query( const BoundingFrustum& frustum, std::vector<uint32_t>& results ) const
+{
+    if ( pImpl->mNodes.empty() )
+        return 0;
+
+    size_t initialSize = results.size();
+
+    XMVECTOR planes[6];
+    frustum.GetPlanes( &planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5] );
+
+    LanePlane lanePlanes[6];
+
+    for( size_t i = 0; i < 6; ++i )
+    {
+        SetupLanePlane( planes[ i ], lanePlanes[ i ] );
+    }
+
+    uint32_t stack[ StackSize ];
+    size_t stackSize = 0;
+
+    stack[ stackSize++ ] = 0;
+
+    while( stackSize )
+    {
+        const Impl::Node& node = pImpl->mNodes[ stack[ --stackSize ] ];
+
+        XMVECTOR bounds[6];
+
+        for( size_t i = 0; i < 6; ++i )
+        {
+            bounds[ i ] = XMLoadFloat4( &node.bounds[ i ] );
+        }
+
+        // A child is outside if its nearest corner is in front of any plane, and wholly inside if even its farthest corner is behind them all.
+        XMVECTOR outside = XMVectorFalseInt();
+        XMVECTOR partial = XMVectorFalseInt();
+
+        for( size_t i = 0; i < 6; ++i )
+        {
+            const LanePlane& p = lanePlanes[ i ];
+
+            XMVECTOR nearDist = XMVectorMultiplyAdd( bounds[ p.nearX ], p.a,
+                                XMVectorMultiplyAdd( bounds[ p.nearY ], p.b,
+                                XMVectorMultiplyAdd( bounds[ p.nearZ ], p.c, p.d ) ) );
+
+            XMVECTOR farDist = XMVectorMultiplyAdd( bounds[ ( p.nearX + 3 ) % 6 ], p.a,
+                               XMVectorMultiplyAdd( bounds[ ( p.nearY + 3 ) % 6 ], p.b,
+                               XMVectorMultiplyAdd( bounds[ ( p.nearZ + 3 ) % 6 ], p.c, p.d ) ) );
+
+            outside = XMVectorOrInt( outside, XMVectorGreater( nearDist, g_XMZero ) );
+            partial = XMVectorOrInt( partial, XMVectorGreater( farDist, g_XMZero ) );
+        }
+
+        uint32_t outsideMask[4];
+        uint32_t partialMask[4];
+        XMStoreInt4( outsideMask, outside );
+        XMStoreInt4( partialMask, partial );
+
+        for( uint32_t i = 0; i < 4; ++i )
+        {
+            if ( !node.count[ i ] || outsideMask[ i ] )
+                continue;
+
+            if ( !partialMask[ i ] )
+            {
+                pImpl->AddRange( node.first[ i ], node.count[ i ], results );
+            }
+            else if ( node.child[ i ] != LeafNode )
+            {
+                assert( stackSize < StackSize );
+                stack[ stackSize++ ] = node.child[ i ];
+            }
+            else
+            {
+                for( uint32_t j = node.first[ i ]; j < node.first[ i ] + node.count[ i ]; ++j )
+                {
+                    uint32_t item = pImpl->mOrder[ j ];
+
+                    if ( pImpl->TestItem( item, frustum ) )
+                        results.push_back( item );
+                }
+            }
+        }
+    }
+
+    return results.size() - initialSize;
+}
+
+
+size_t BoundingVolumeHierarchy::Query( const BoundingBox& box, std::vector<uint32_t>& results ) const
+{
+    if ( pImpl->mNodes.empty() )
+        return 0;
+
+    size_t initialSize = results.size();
+
+    XMVECTOR queryMin, queryMax;
+    GetMinMax( box, queryMin, queryMax );
+
+    XMVECTOR minX = XMVectorSplatX( queryMin );
+    XMVECTOR minY = XMVectorSplatY( queryMin );
+    XMVECTOR minZ = XMVectorSplatZ( queryMin );
+    XMVECTOR maxX = XMVectorSplatX( queryMax );
+    XMVECTOR maxY = XMVectorSplatY( queryMax );
+    XMVECTOR maxZ = XMVectorSplatZ( queryMax );
+
+    uint32_t stack[ StackSize ];
+    size_t stackSize = 0;
+
+    stack[ stackSize++ ] = 0;
+
+    while( stackSize )
+    {
+        const Impl::Node& node = pImpl->mNodes[ stack[ --stackSize ] ];
+
+        XMVECTOR childMinX = XMLoadFloat4( &node.bounds[0] );
+        XMVECTOR childMinY = XMLoadFloat4( &node.bounds[1] );
+        XMVECTOR childMinZ = XMLoadFloat4( &node.bounds[2] );
+        XMVECTOR childMaxX = XMLoadFloat4( &node.bounds[3] );
+        XMVECTOR childMaxY = XMLoadFloat4( &node.bounds[4] );
+        XMVECTOR childMaxZ = XMLoadFloat4( &node.bounds[5] );
+
+        XMVECTOR overlap = XMVectorAndInt( XMVectorAndInt( XMVectorLessOrEqual( childMinX, maxX ), XMVectorGreaterOrEqual( childMaxX, minX ) ),
+                           XMVectorAndInt( XMVectorAndInt( XMVectorLessOrEqual( childMinY, maxY ), XMVectorGreaterOrEqual( childMaxY, minY ) ),
+                                           XMVectorAndInt( XMVectorLessOrEqual( childMinZ, maxZ ), XMVectorGreaterOrEqual( childMaxZ, minZ ) ) ) );
+
+        XMVECTOR inside = XMVectorAndInt( XMVectorAndInt( XMVectorGreaterOrEqual( childMinX, minX ), XMVectorLessOrEqual( childMaxX, maxX ) ),
+                          XMVectorAndInt( XMVectorAndInt( XMVectorGreaterOrEqual( childMinY, minY ), XMVectorLessOrEqual( childMaxY, maxY ) ),
+                                          XMVectorAndInt( XMVectorGreaterOrEqual( childMinZ, minZ ), XMVectorLessOrEqual( childMaxZ, maxZ ) ) ) );
+
+        uint32_t overlapMask[4];
+        uint32_t insideMask[4];
+        XMStoreInt4( overlapMask, overlap );
+        XMStoreInt4( insideMask, inside );
+
+        for( uint32_t i = 0; i < 4; ++i )
+        {
+            if ( !node.count[ i ] || !overlapMask[ i ] )
+                continue;
+
+            if ( insideMask[ i ] )
+            {
+                pImpl->AddRange( node.first[ i ], node.count[ i ], results );
+            }
+            else if ( node.child[ i ] != LeafNode )
+            {
+                assert( stackSize < StackSize );
+                stack[ stackSize++ ] = node.child[ i ];
+            }
+            else
+            {
+                for( uint32_t j = node.first[ i ]; j < node.first[ i ] + node.count[ i ]; ++j )
+                {
+                    uint32_t item = pImpl->mOrder[ j ];
+
+                    if ( pImpl->TestItem( item, box ) )
+                        results.push_back( item );
+                }
+            }
+        }
+    }
+
+    return results.size() - initialSize;
+}
+
+
+_Use_decl_annotations_
+bool XM_CALLCONV BoundingVolumeHierarchy::Intersects( FXMVECTOR origin, FXMVECTOR direction, float& dist, uint32_t& result ) const
+{
+    dist = 0;
+    result = 0;
+
+    if ( pImpl->mNodes.empty() )
+        return false;
+
+    // Keep the reciprocal finite for axis aligned rays, so the slab tests never multiply zero by infinity.
+    XMVECTOR tiny = XMVectorReplicate( 1e-20f );
+    XMVECTOR safeDirection = XMVectorSelect( direction, tiny, XMVectorLess( XMVectorAbs( direction ), tiny ) );
+    XMVECTOR invDirection = XMVectorReciprocal( safeDirection );
+
+    XMVECTOR originX = XMVectorSplatX( origin );
+    XMVECTOR originY = XMVectorSplatY( origin );
+    XMVECTOR originZ = XMVectorSplatZ( origin );
+    XMVECTOR invX = XMVectorSplatX( invDirection );
+    XMVECTOR invY = XMVectorSplatY( invDirection );
+    XMVECTOR invZ = XMVectorSplatZ( invDirection );
+
+    // Choosing which side is entered by the sign of the direction means inverted (unused) bounds are always missed.
+    int nearX = ( XMVectorGetX( safeDirection ) >= 0 ) ? 0 : 3;
+    int nearY = ( XMVectorGetY( safeDirection ) >= 0 ) ? 1 : 4;
+    int nearZ = ( XMVectorGetZ( safeDirection ) >= 0 ) ? 2 : 5;
+
+    float bestDist = FLT_MAX;
+    bool hit = false;
+
+    struct StackEntry
+    {
+        uint32_t node;
+        float dist;
+    };
+
+    StackEntry stack[ StackSize ];
+    size_t stackSize = 0;
+
+    StackEntry root = { 0, 0 };
+    stack[ stackSize++ ] = root;
+
+    while( stackSize )
+    {
+        StackEntry entry = stack[ --stackSize ];
+
+        if ( entry.dist > bestDist )
+            continue;
+
+        const Impl::Node& node = pImpl->mNodes[ entry.node ];
+
+        XMVECTOR nearTX = XMVectorMultiply( XMVectorSubtract( XMLoadFloat4( &node.bounds[ nearX ] ), originX ), invX );
+        XMVECTOR nearTY = XMVectorMultiply( XMVectorSubtract( XMLoadFloat4( &node.bounds[ nearY ] ), originY ), invY );
+        XMVECTOR nearTZ = XMVectorMultiply( XMVectorSubtract( XMLoadFloat4( &node.bounds[ nearZ ] ), originZ ), invZ );
+        XMVECTOR farTX = XMVectorMultiply( XMVectorSubtract( XMLoadFloat4( &node.bounds[ ( nearX + 3 ) % 6 ] ), originX ), invX );
+        XMVECTOR farTY = XMVectorMultiply( XMVectorSubtract( XMLoadFloat4( &node.bounds[ ( nearY + 3 ) % 6 ] ), originY ), invY );
+        XMVECTOR farTZ = XMVectorMultiply( XMVectorSubtract( XMLoadFloat4( &node.bounds[ ( nearZ + 3 ) % 6 ] ), originZ ), invZ );
+
+        XMVECTOR tnear = XMVectorMax( XMVectorMax( nearTX, nearTY ), XMVectorMax( nearTZ, g_XMZero ) );
+        XMVECTOR tfar = XMVectorMin( XMVectorMin( farTX, farTY ), XMVectorMin( farTZ, XMVectorReplicate( bestDist ) ) );
+
+        uint32_t hitMask[4];
+        XMStoreInt4( hitMask, XMVectorLessOrEqual( tnear, tfar ) );
+
+        XMFLOAT4 childDist;
+        XMStoreFloat4( &childDist, tnear );
+
+        // Visit the children nearest first: leaves are tested now, and internal nodes are pushed so the nearest pops first.
+        uint32_t order[4];
+        uint32_t orderCount = 0;
+
+        for( uint32_t i = 0; i < 4; ++i )
+        {
+            if ( !node.count[ i ] || !hitMask[ i ] )
+                continue;
+
+            uint32_t j = orderCount++;
+
+            while( j > 0 && (&childDist.x)[ order[ j - 1 ] ] > (&childDist.x)[ i ] )
+            {
+                order[ j ] = order[ j - 1 ];
+                --j;
+            }
+
+            order[ j ] = i;
+        }
+
+        for( uint32_t k = 0; k < orderCount; ++k )
+        {
+            uint32_t i = order[ k ];
+
+            if ( node.child[ i ] != LeafNode || (&childDist.x)[ i ] > bestDist )
+                continue;
+
+            for( uint32_t j = node.first[ i ]; j < node.first[ i ] + node.count[ i ]; ++j )
+            {
+                uint32_t item = pImpl->mOrder[ j ];
+
+                float itemDist;
+                if ( pImpl->TestItem( item, origin, direction, itemDist ) && itemDist < bestDist )
+                {
+                    bestDist = itemDist;
+                    result = item;
+                    hit = true;
+                }
+            }
+        }
+
+        for( uint32_t k = orderCount; k > 0; --k )
+        {
+            uint32_t i = order[ k - 1 ];
+
+            if ( node.child[ i ] == LeafNode || (&childDist.x)[ i ] > bestDist )
+                continue;
+
+            assert( stackSize < StackSize );
+
+            StackEntry child = { node.child[ i ], (&childDist.x)[ i ] };
+            stack[ stackSize++ ] = child;
+        }
+    }
+
+    if ( hit )
+        dist = bestDist;
+
+    return hit;
+}
+
+
+size_t BoundingVolumeHierarchy::GetItemCount() const
+{
+    return pImpl->mItems.size();
+}
+
+
+size_t BoundingVolumeHierarchy::GetNodeCount() const
+{
+    return pImpl->mNodes.size();
+}
+
+
+BoundingBox BoundingVolumeHierarchy::GetItemBounds( uint32_t item ) const
+{
+    assert( item < pImpl->mItems.size() );
+
+    return pImpl->mItems[ item ];
+}
+
+
+size_t BoundingVolumeHierarchy::GetInstanceCount() const
+{
+    return pImpl->mInstanceCount;
+}
+
+
+size_t BoundingVolumeHierarchy::GetInstance( uint32_t item ) const
+{
+    assert( item < pImpl->mItemInstance.size() );
+
+    return pImpl->mItemInstance[ item ];
+}
+
+
+size_t BoundingVolumeHierarchy::GetMesh( uint32_t item ) const
+{
+    assert( item < pImpl->mItemMesh.size() );
+
+    return pImpl->mItemMesh[ item ];
+}
@@ -21,6 +21,286 @@ using namespace DirectX;
 using namespace Microsoft::WRL;
 
 
+namespace
+{
+    // Canonical form of a state description, with every field widened to 32 bits so that padding
+    // bytes in the D3D structures never reach the hash or the comparison.
+    template<size_t N>
+    struct StateKey
+    {
+        uint32_t data[N];
+        size_t hash;
+
+        void ComputeHash()
+        {
+            // FNV-1a.
+            hash = 2166136261U;
+
+            for (size_t i = 0; i < N; i++)
+            {
+                hash = (hash ^ data[i]) * 16777619U;
+            }
+        }
+
+        bool operator== (StateKey const& other) const
+        {
+            return hash == other.hash && memcmp(data, other.data, sizeof(data)) == 0;
+        }
+    };
+
+
+    template<typename T>
+    uint32_t PackField(T value)
+    {
+        static_assert(sizeof(T) <= sizeof(uint32_t), "field too large");
+
+        uint32_t result = 0;
+        memcpy(&result, &value, sizeof(T));
+        return result;
+    }
+
+
+    typedef StateKey<2 + 8 * D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT> BlendStateKey;
+    typedef StateKey<14> DepthStencilStateKey;
+    typedef StateKey<10> RasterizerStateKey;
+    typedef StateKey<13> SamplerStateKey;
+
+
+    BlendStateKey MakeKey(D3D11_BLEND_DESC const& desc)
+    {
+        BlendStateKey key;
+        uint32_t* dest = key.data;
+
+        *dest++ = PackField(desc.AlphaToCoverageEnable);
+        *dest++ = PackField(desc.IndependentBlendEnable);
+
+        for (size_t i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+        {
+            auto& target = desc.RenderTarget[i];
+
+            *dest++ = PackField(target.BlendEnable);
+            *dest++ = PackField(target.SrcBlend);
+            *dest++ = PackField(target.DestBlend);
+            *dest++ = PackField(target.BlendOp);
+            *dest++ = PackField(target.SrcBlendAlpha);
+            *dest++ = PackField(target.DestBlendAlpha);
+            *dest++ = PackField(target.BlendOpAlpha);
+            *dest++ = PackField(target.RenderTargetWriteMask);
+        }
+
+        key.ComputeHash();
+        return key;
+    }
+
+
+    void PackStencilOp(uint32_t*& dest, D3D11_DEPTH_STENCILOP_DESC const& desc)
+    {
+        *dest++ = PackField(desc.StencilFailOp);
+        *dest++ = PackField(desc.StencilDepthFailOp);
+        *dest++ = PackField(desc.StencilPassOp);
+        *dest++ = PackField(desc.StencilFunc);
+    }
+
+
+    DepthStencilStateKey MakeKey(D3D11_DEPTH_STENCIL_DESC const& desc)
+    {
+        DepthStencilStateKey key;
+        uint32_t* dest = key.data;
+
+        *dest++ = PackField(desc.DepthEnable);
+        *dest++ = PackField(desc.DepthWriteMask);
+        *dest++ = PackField(desc.DepthFunc);
+        *dest++ = PackField(desc.StencilEnable);
+        *dest++ = PackField(desc.StencilReadMask);
+        *dest++ = PackField(desc.StencilWriteMask);
+
+        PackStencilOp(dest, desc.FrontFace);
+        PackStencilOp(dest, desc.BackFace);
+
+        key.ComputeHash();
+        return key;
+    }
+
+
+    RasterizerStateKey MakeKey(D3D11_RASTERIZER_DESC const& desc)
+    {
+        RasterizerStateKey key;
+        uint32_t* dest = key.data;
+
+        *dest++ = PackField(desc.FillMode);
+        *dest++ = PackField(desc.CullMode);
+        *dest++ = PackField(desc.FrontCounterClockwise);
+        *dest++ = PackField(desc.DepthBias);
+        *dest++ = PackField(desc.DepthBiasClamp);
+        *dest++ = PackField(desc.SlopeScaledDepthBias);
+        *dest++ = PackField(desc.DepthClipEnable);
+        *dest++ = PackField(desc.ScissorEnable);
+        *dest++ = PackField(desc.MultisampleEnable);
+        *dest++ = PackField(desc.AntialiasedLineEnable);
+
+        key.ComputeHash();
+        return key;
+    }
+
+
+    SamplerStateKey MakeKey(D3D11_SAMPLER_DESC const& desc)
+    {
+        SamplerStateKey key;
+        uint32_t* dest = key.data;
+
+        *dest++ = PackField(desc.Filter);
+        *dest++ = PackField(desc.AddressU);
+        *dest++ = PackField(desc.AddressV);
+        *dest++ = PackField(desc.AddressW);
+        *dest++ = PackField(desc.MipLODBias);
+        *dest++ = PackField(desc.MaxAnisotropy);
+        *dest++ = PackField(desc.ComparisonFunc);
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            *dest++ = PackField(desc.BorderColor[i]);
+        }
+
+        *dest++ = PackField(desc.MinLOD);
+        *dest++ = PackField(desc.MaxLOD);
+
+        key.ComputeHash();
+        return key;
+    }
+
+
+    HRESULT CreateState(_In_ ID3D11Device* device, D3D11_BLEND_DESC const& desc, _Out_ ID3D11BlendState** pResult)
+    {
+        return device->CreateBlendState(&desc, pResult);
+    }
+
+    HRESULT CreateState(_In_ ID3D11Device* device, D3D11_DEPTH_STENCIL_DESC const& desc, _Out_ ID3D11DepthStencilState** pResult)
+    {
+        return device->CreateDepthStencilState(&desc, pResult);
+    }
+
+    HRESULT CreateState(_In_ ID3D11Device* device, D3D11_RASTERIZER_DESC const& desc, _Out_ ID3D11RasterizerState** pResult)
+    {
+        return device->CreateRasterizerState(&desc, pResult);
+    }
+
+    HRESULT CreateState(_In_ ID3D11Device* device, D3D11_SAMPLER_DESC const& desc, _Out_ ID3D11SamplerState** pResult)
+    {
+        return device->CreateSamplerState(&desc, pResult);
+    }
+
+
+    // Hash table of state objects keyed by their full description. Entries are only ever pushed onto the
+    // front of a chain, and live as long as the cache, so lookups walk the chains without taking the lock.
+    template<typename TDesc, typename TState, typename TKey>
+    class StateCache
+    {
+    public:
+        StateCache()
+        {
+            memset(const_cast<Node**>(mBuckets), 0, sizeof(mBuckets));
+        }
+
+        ~StateCache()
+        {
+            for (size_t i = 0; i < BucketCount; i++)
+            {
+                Node* node = mBuckets[i];
+
+                while (node)
+                {
+                    Node* next = node->next;
+                    delete node;
+                    node = next;
+                }
+            }
+        }
+
+
+        TState* Get(_In_ ID3D11Device* device, TDesc const& desc)
+        {
+            TKey key = MakeKey(desc);
+
+            auto& bucket = mBuckets[key.hash % BucketCount];
+
+            TState* result = Find(bucket, key);
+
+            if (!result)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                result = Find(bucket, key);
+
+                if (!result)
+                {
+                    std::unique_ptr<Node> node(new Node(key));
+
+                    ThrowIfFailed(
+                        CreateState(device, desc, node->state.GetAddressOf())
+                    );
+
+                    SetDebugObjectName(node->state.Get(), "DirectXTK:CommonStates");
+
+                    result = node->state.Get();
+
+                    // Fully build the node before publishing it to readers.
+                    node->next = bucket;
+
+                    MemoryBarrier();
+
+                    bucket = node.release();
+                }
+            }
+
+            return result;
+        }
+
+
+    private:
+        static const size_t BucketCount = 64;
+
+        struct Node
+        {
+            explicit Node(TKey const& key)
+              : next(nullptr),
+                key(key)
+            { }
+
+            Node* volatile next;
+            TKey key;
+            ComPtr<TState> state;
+        };
+
+
+        static TState* Find(Node* volatile const& bucket, TKey const& key)
+        {
+            Node* node = bucket;
+
+            MemoryBarrier();
+
+            while (node)
+            {
+                if (node->key == key)
+                    return node->state.Get();
+
+                node = node->next;
+
+                MemoryBarrier();
+            }
+
+            return nullptr;
+        }
+
+
+        Node* volatile mBuckets[BucketCount];
+
+        // Only held while creating a new state, and separate from CommonStates::Impl::mutex so the
+        // built-in states can be created through the cache from inside DemandCreate.
+        std::mutex mMutex;
+    };
+}
+
+
 // Internal state object implementation class. Only one of these helpers is allocated
 // per D3D device, even if there are multiple public facing CommonStates instances.
 class CommonStates::Impl
@@ -58,6 +338,11 @@ public:
     ComPtr<ID3D11SamplerState> anisotropicWrap;
     ComPtr<ID3D11SamplerState> anisotropicClamp;
 
+    StateCache<D3D11_BLEND_DESC, ID3D11BlendState, BlendStateKey> blendStates;
+    StateCache<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState, DepthStencilStateKey> depthStencilStates;
+    StateCache<D3D11_RASTERIZER_DESC, ID3D11RasterizerState, RasterizerStateKey> rasterizerStates;
+    StateCache<D3D11_SAMPLER_DESC, ID3D11SamplerState, SamplerStateKey> samplerStates;
+
     std::mutex mutex;
 
     static SharedResourcePool<ID3D11Device*, Impl> instancePool;
@@ -83,12 +368,11 @@ HRESULT CommonStates::Impl::CreateBlendState(D3D11_BLEND srcBlend, D3D11_BLEND d
 
     desc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
-    HRESULT hr = device->CreateBlendState(&desc, pResult);
+    // Go through the cache, so a custom state with the same description shares this object.
+    *pResult = blendStates.Get(device.Get(), desc);
+    (*pResult)->AddRef();
 
-    if (SUCCEEDED(hr))
-        SetDebugObjectName(*pResult, "DirectXTK:CommonStates");
-
-    return hr;
+    return S_OK;
 }
 
 
@@ -113,12 +397,11 @@ HRESULT CommonStates::Impl::CreateDepthStencilState(bool enable, bool writeEnabl
 
     desc.BackFace = desc.FrontFace;
 
-    HRESULT hr = device->CreateDepthStencilState(&desc, pResult);
-
-    if (SUCCEEDED(hr))
-        SetDebugObjectName(*pResult, "DirectXTK:CommonStates");
+    // Go through the cache, so a custom state with the same description shares this object.
+    *pResult = depthStencilStates.Get(device.Get(), desc);
+    (*pResult)->AddRef();
 
-    return hr;
+    return S_OK;
 }
 
 
@@ -133,12 +416,11 @@ HRESULT CommonStates::Impl::CreateRasterizerState(D3D11_CULL_MODE cullMode, D3D1
     desc.DepthClipEnable = true;
     desc.MultisampleEnable = true;
 
-    HRESULT hr = device->CreateRasterizerState(&desc, pResult);
+    // Go through the cache, so a custom state with the same description shares this object.
+    *pResult = rasterizerStates.Get(device.Get(), desc);
+    (*pResult)->AddRef();
 
-    if (SUCCEEDED(hr))
-        SetDebugObjectName(*pResult, "DirectXTK:CommonStates");
-
-    return hr;
+    return S_OK;
 }
 
 
@@ -159,12 +441,11 @@ HRESULT CommonStates::Impl::CreateSamplerState(D3D11_FILTER filter, D3D11_TEXTUR
     desc.MaxLOD = FLT_MAX;
     desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
 
-    HRESULT hr = device->CreateSamplerState(&desc, pResult);
-
-    if (SUCCEEDED(hr))
-        SetDebugObjectName(*pResult, "DirectXTK:CommonStates");
+    // Go through the cache, so a custom state with the same description shares this object.
+    *pResult = samplerStates.Get(device.Get(), desc);
+    (*pResult)->AddRef();
 
-    return hr;
+    return S_OK;
 }
 
 
@@ -173,9 +454,33 @@ HRESULT CommonStates::Impl::CreateSamplerState(D3D11_FILTER filter, D3D11_TEXTUR
 //--------------------------------------------------------------------------------------
 
 // Public constructor.
-CommonStates::CommonStates(_In_ ID3D11Device* device)
+CommonStates::CommonStates(_In_ ID3D11Device* device, bool createAll)
   : pImpl(Impl::instancePool.DemandCreate(device))
 {
+    if (createAll)
+    {
+        // Create every built-in state up front, so none are created during gameplay.
+        Opaque();
+        AlphaBlend();
+        Additive();
+        NonPremultiplied();
+
+        DepthNone();
+        DepthDefault();
+        DepthRead();
+
+        CullNone();
+        CullClockwise();
+        CullCounterClockwise();
+        Wireframe();
+
+        PointWrap();
+        PointClamp();
+        LinearWrap();
+        LinearClamp();
+        AnisotropicWrap();
+        AnisotropicClamp();
+    }
 }
 
 
@@ -367,3 +672,31 @@ ID3D11SamplerState* CommonStates::AnisotropicClamp() const
         return pImpl->CreateSamplerState(D3D11_FILTER_ANISOTROPIC, D3D11_TEXTURE_ADDRESS_CLAMP, pResult);
     });
 }
+
+
+//--------------------------------------------------------------------------------------
+// Custom states
+//--------------------------------------------------------------------------------------
+
+ID3D11BlendState* CommonStates::GetBlendState(D3D11_BLEND_DESC const& desc) const
+{
+    return pImpl->blendStates.Get(pImpl->device.Get(), desc);
+}
+
+
+ID3D11DepthStencilState* CommonStates::GetDepthStencilState(D3D11_DEPTH_STENCIL_DESC const& desc) const
+{
+    return pImpl->depthStencilStates.Get(pImpl->device.Get(), desc);
+}
+
+
+ID3D11RasterizerState* CommonStates::GetRasterizerState(D3D11_RASTERIZER_DESC const& desc) const
+{
+    return pImpl->rasterizerStates.Get(pImpl->device.Get(), desc);
+}
+
+
+ID3D11SamplerState* CommonStates::GetSamplerState(D3D11_SAMPLER_DESC const& desc) const
+{
+    return pImpl->samplerStates.Get(pImpl->device.Get(), desc);
+}
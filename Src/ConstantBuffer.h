@@ -67,7 +67,7 @@ namespace DirectX
 
 
         // Looks up the underlying D3D constant buffer.
-        ID3D11Buffer* GetBuffer()
+        ID3D11Buffer* GetBuffer() const
         {
             return mConstantBuffer.Get();
         }
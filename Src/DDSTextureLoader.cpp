@@ -25,9 +25,67 @@
 #include "dds.h"
 #include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
+#include "ScopedInstrumentationEvent.h"
 
 using namespace DirectX;
 
+//--------------------------------------------------------------------------------------
+// Validates the headers of a DDS file already in memory, and locates the pixel data
+//--------------------------------------------------------------------------------------
+static HRESULT ParseDDSFileData( _In_reads_bytes_(ddsDataSize) uint8_t* ddsData,
+                                 size_t ddsDataSize,
+                                 DDS_HEADER** header,
+                                 uint8_t** bitData,
+                                 size_t* bitSize
+                               )
+{
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if (ddsDataSize < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
+    {
+        return E_FAIL;
+    }
+
+    // DDS files always start with the same magic number ("DDS ")
+    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData );
+    if (dwMagicNumber != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto hdr = reinterpret_cast<DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+
+    // Verify header to validate DDS file
+    if (hdr->size != sizeof(DDS_HEADER) ||
+        hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    // Check for DX10 extension
+    bool bDXT10Header = false;
+    if ((hdr->ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC( 'D', 'X', '1', '0' ) == hdr->ddspf.fourCC))
+    {
+        // Must be long enough for both headers and magic value
+        if (ddsDataSize < ( sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10) ) )
+        {
+            return E_FAIL;
+        }
+
+        bDXT10Header = true;
+    }
+
+    // setup the pointers in the process request
+    *header = hdr;
+    ptrdiff_t offset = sizeof( uint32_t ) + sizeof( DDS_HEADER )
+                       + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
+    *bitData = ddsData + offset;
+    *bitSize = ddsDataSize - offset;
+
+    return S_OK;
+}
+
+
 //--------------------------------------------------------------------------------------
 static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
                                         std::unique_ptr<uint8_t[]>& ddsData,
@@ -113,46 +171,129 @@ static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
         return E_FAIL;
     }
 
-    // DDS files always start with the same magic number ("DDS ")
-    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData.get() );
-    if (dwMagicNumber != DDS_MAGIC)
+    return ParseDDSFileData( ddsData.get(), FileSize.LowPart, header, bitData, bitSize );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Maps the file into memory instead of reading it, so the texture is created straight
+// from the file cache pages without an intermediate heap copy
+//--------------------------------------------------------------------------------------
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+
+namespace
+{
+    struct mapped_view_closer { void operator()(void* p) { if (p) UnmapViewOfFile(p); } };
+
+    typedef std::unique_ptr<void, mapped_view_closer> ScopedMappedView;
+}
+
+static HRESULT MapTextureDataFromFile( _In_z_ const wchar_t* fileName,
+                                       ScopedMappedView& ddsView,
+                                       DDS_HEADER** header,
+                                       uint8_t** bitData,
+                                       size_t* bitSize
+                                     )
+{
+    if (!header || !bitData || !bitSize)
     {
-        return E_FAIL;
+        return E_POINTER;
+    }
+
+    // open the file
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile( safe_handle( CreateFile2( fileName,
+                                                  GENERIC_READ,
+                                                  FILE_SHARE_READ,
+                                                  OPEN_EXISTING,
+                                                  nullptr ) ) );
+#else
+    ScopedHandle hFile( safe_handle( CreateFileW( fileName,
+                                                  GENERIC_READ,
+                                                  FILE_SHARE_READ,
+                                                  nullptr,
+                                                  OPEN_EXISTING,
+                                                  FILE_ATTRIBUTE_NORMAL,
+                                                  nullptr ) ) );
+#endif
+
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
     }
 
-    auto hdr = reinterpret_cast<DDS_HEADER*>( ddsData.get() + sizeof( uint32_t ) );
+    // Get the file size
+    LARGE_INTEGER FileSize = { 0 };
 
-    // Verify header to validate DDS file
-    if (hdr->size != sizeof(DDS_HEADER) ||
-        hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_STANDARD_INFO fileInfo;
+    if ( !GetFileInformationByHandleEx( hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo) ) )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+    FileSize = fileInfo.EndOfFile;
+#else
+    GetFileSizeEx( hFile.get(), &FileSize );
+#endif
+
+    // File is too big for a 32-bit view, so reject it
+    if (FileSize.HighPart > 0)
     {
         return E_FAIL;
     }
 
-    // Check for DX10 extension
-    bool bDXT10Header = false;
-    if ((hdr->ddspf.flags & DDS_FOURCC) &&
-        (MAKEFOURCC( 'D', 'X', '1', '0' ) == hdr->ddspf.fourCC))
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if (FileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) ) )
     {
-        // Must be long enough for both headers and magic value
-        if (FileSize.LowPart < ( sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_DXT10) ) )
-        {
-            return E_FAIL;
-        }
+        return E_FAIL;
+    }
 
-        bDXT10Header = true;
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+    ScopedHandle hMapping( CreateFileMappingW( hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr ) );
+#else
+    ScopedHandle hMapping( CreateFileMappingFromApp( hFile.get(), nullptr, PAGE_READONLY, 0, nullptr ) );
+#endif
+
+    if ( !hMapping )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
     }
 
-    // setup the pointers in the process request
-    *header = hdr;
-    ptrdiff_t offset = sizeof( uint32_t ) + sizeof( DDS_HEADER )
-                       + (bDXT10Header ? sizeof( DDS_HEADER_DXT10 ) : 0);
-    *bitData = ddsData.get() + offset;
-    *bitSize = FileSize.LowPart - offset;
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+    ddsView.reset( MapViewOfFile( hMapping.get(), FILE_MAP_READ, 0, 0, 0 ) );
+#else
+    ddsView.reset( MapViewOfFileFromApp( hMapping.get(), FILE_MAP_READ, 0, 0 ) );
+#endif
 
-    return S_OK;
+    if ( !ddsView )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // The view keeps the file mapping alive, so both handles can be closed on return
+    return ParseDDSFileData( static_cast<uint8_t*>( ddsView.get() ), FileSize.LowPart, header, bitData, bitSize );
+}
+
+#else
+
+// Windows Phone 8.0 has no file mapping API for apps, so a mapped load falls back to a regular read
+namespace
+{
+    typedef std::unique_ptr<uint8_t[]> ScopedMappedView;
+}
+
+static HRESULT MapTextureDataFromFile( _In_z_ const wchar_t* fileName,
+                                       ScopedMappedView& ddsView,
+                                       DDS_HEADER** header,
+                                       uint8_t** bitData,
+                                       size_t* bitSize
+                                     )
+{
+    return LoadTextureDataFromFile( fileName, ddsView, header, bitData, bitSize );
 }
 
+#endif // !WINAPI_FAMILY || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+
 
 //--------------------------------------------------------------------------------------
 // Return the BPP for a particular format
@@ -1041,27 +1182,28 @@ static HRESULT CreateD3DResources( _In_ ID3D11Device* d3dDevice,
 }
 
 
-//--------------------------------------------------------------------------------------
-static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
-                                     _In_opt_ ID3D11DeviceContext* d3dContext,
-#if defined(_XBOX_ONE) && defined(_TITLE)
-                                     _In_opt_ ID3D11DeviceX* d3dDeviceX,
-                                     _In_opt_ ID3D11DeviceContextX* d3dContextX,
-#endif
-                                     _In_ const DDS_HEADER* header,
-                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
-                                     _In_ size_t bitSize,
-                                     _In_ size_t maxsize,
-                                     _In_ D3D11_USAGE usage,
-                                     _In_ unsigned int bindFlags,
-                                     _In_ unsigned int cpuAccessFlags,
-                                     _In_ unsigned int miscFlags,
-                                     _In_ bool forceSRGB,
-                                     _Outptr_opt_ ID3D11Resource** texture,
-                                     _Outptr_opt_ ID3D11ShaderResourceView** textureView )
+namespace
 {
-    HRESULT hr = S_OK;
+    struct DDSTextureInfo
+    {
+        uint32_t resDim;
+        UINT width;
+        UINT height;
+        UINT depth;
+        size_t mipCount;
+        UINT arraySize;
+        DXGI_FORMAT format;
+        bool isCubeMap;
+    };
+}
 
+
+//--------------------------------------------------------------------------------------
+// Decodes and validates the texture description from a DDS header
+//--------------------------------------------------------------------------------------
+static HRESULT GetTextureInfo( _In_ const DDS_HEADER* header,
+                               _Out_ DDSTextureInfo* info )
+{
     UINT width = header->width;
     UINT height = header->height;
     UINT depth = header->depth;
@@ -1228,6 +1370,54 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    info->resDim = resDim;
+    info->width = width;
+    info->height = height;
+    info->depth = depth;
+    info->mipCount = mipCount;
+    info->arraySize = arraySize;
+    info->format = format;
+    info->isCubeMap = isCubeMap;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
+                                     _In_opt_ ID3D11DeviceContext* d3dContext,
+#if defined(_XBOX_ONE) && defined(_TITLE)
+                                     _In_opt_ ID3D11DeviceX* d3dDeviceX,
+                                     _In_opt_ ID3D11DeviceContextX* d3dContextX,
+#endif
+                                     _In_ const DDS_HEADER* header,
+                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
+                                     _In_ size_t bitSize,
+                                     _In_ size_t maxsize,
+                                     _In_ D3D11_USAGE usage,
+                                     _In_ unsigned int bindFlags,
+                                     _In_ unsigned int cpuAccessFlags,
+                                     _In_ unsigned int miscFlags,
+                                     _In_ bool forceSRGB,
+                                     _Outptr_opt_ ID3D11Resource** texture,
+                                     _Outptr_opt_ ID3D11ShaderResourceView** textureView )
+{
+    DDSTextureInfo info;
+    HRESULT hr = GetTextureInfo( header, &info );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    UINT width = info.width;
+    UINT height = info.height;
+    UINT depth = info.depth;
+    uint32_t resDim = info.resDim;
+    UINT arraySize = info.arraySize;
+    DXGI_FORMAT format = info.format;
+    bool isCubeMap = info.isCubeMap;
+    size_t mipCount = info.mipCount;
+
     bool autogen = false;
     if ( mipCount == 1 && d3dContext != 0 && textureView != 0 ) // Must have context and shader-view to auto generate mipmaps
     {
@@ -1782,7 +1972,8 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
                                              bool forceSRGB,
                                              ID3D11Resource** texture,
                                              ID3D11ShaderResourceView** textureView,
-                                             DDS_ALPHA_MODE* alphaMode )
+                                             DDS_ALPHA_MODE* alphaMode,
+                                             bool memoryMapped )
 {
     if ( texture )
     {
@@ -1802,22 +1993,33 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
         return E_INVALIDARG;
     }
 
+    ScopedInstrumentationEvent event( InstrumentationCategory_TextureLoader, L"CreateDDSTextureFromFileEx", fileName );
+
     DDS_HEADER* header = nullptr;
     uint8_t* bitData = nullptr;
     size_t bitSize = 0;
 
     std::unique_ptr<uint8_t[]> ddsData;
-    HRESULT hr = LoadTextureDataFromFile( fileName,
-                                          ddsData,
-                                          &header,
-                                          &bitData,
-                                          &bitSize
-                                        );
+    ScopedMappedView ddsView;
+    HRESULT hr = memoryMapped ? MapTextureDataFromFile( fileName,
+                                                        ddsView,
+                                                        &header,
+                                                        &bitData,
+                                                        &bitSize
+                                                      )
+                              : LoadTextureDataFromFile( fileName,
+                                                         ddsData,
+                                                         &header,
+                                                         &bitData,
+                                                         &bitSize
+                                                       );
     if (FAILED(hr))
     {
         return hr;
     }
 
+    event.SetSize( bitSize );
+
     hr = CreateTextureFromDDS( d3dDevice, nullptr,
 #if defined(_XBOX_ONE) && defined(_TITLE)
                                nullptr, nullptr,
@@ -1907,7 +2109,8 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
                                              bool forceSRGB,
                                              ID3D11Resource** texture,
                                              ID3D11ShaderResourceView** textureView,
-                                             DDS_ALPHA_MODE* alphaMode )
+                                             DDS_ALPHA_MODE* alphaMode,
+                                             bool memoryMapped )
 {
     if ( texture )
     {
@@ -1927,22 +2130,33 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
         return E_INVALIDARG;
     }
 
+    ScopedInstrumentationEvent event( InstrumentationCategory_TextureLoader, L"CreateDDSTextureFromFileEx", fileName, 0, 0, d3dContext );
+
     DDS_HEADER* header = nullptr;
     uint8_t* bitData = nullptr;
     size_t bitSize = 0;
 
     std::unique_ptr<uint8_t[]> ddsData;
-    HRESULT hr = LoadTextureDataFromFile( fileName,
-                                          ddsData,
-                                          &header,
-                                          &bitData,
-                                          &bitSize
-                                        );
+    ScopedMappedView ddsView;
+    HRESULT hr = memoryMapped ? MapTextureDataFromFile( fileName,
+                                                        ddsView,
+                                                        &header,
+                                                        &bitData,
+                                                        &bitSize
+                                                      )
+                              : LoadTextureDataFromFile( fileName,
+                                                         ddsData,
+                                                         &header,
+                                                         &bitData,
+                                                         &bitSize
+                                                       );
     if (FAILED(hr))
     {
         return hr;
     }
 
+    event.SetSize( bitSize );
+
     hr = CreateTextureFromDDS( d3dDevice, d3dContext,
 #if defined(_XBOX_ONE) && defined(_TITLE)
                                d3dDevice, d3dContext,
@@ -2014,3 +2228,229 @@ HRESULT DirectX::CreateDDSTextureFromFileEx( ID3D11Device* d3dDevice,
 
     return hr;
 }
+
+
+//--------------------------------------------------------------------------------------
+// Mip streaming
+//--------------------------------------------------------------------------------------
+
+// Internal DDSStreamingTexture implementation class.
+class DDSStreamingTexture::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context, _In_z_ const wchar_t* fileName, size_t initialMips, size_t maxsize, bool forceSRGB);
+
+    bool Update(_In_ ID3D11DeviceContext* context, size_t maxBytes);
+
+    // The file stays mapped, so levels are only paged in from disk when they are uploaded.
+    ScopedMappedView mDDSView;
+
+    Microsoft::WRL::ComPtr<ID3D11Resource> mTexture;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mTextureView;
+
+    size_t mMipLevels;
+    size_t mArraySize;
+
+    // Source data for each subresource, in D3D11CalcSubresource order.
+    std::vector<D3D11_SUBRESOURCE_DATA> mInitData;
+
+    // Levels from mLoadedLOD down to the smallest have been uploaded, but the GPU is only
+    // allowed to sample from mResidentLOD down. mRequestedLOD is where we're heading.
+    size_t mLoadedLOD;
+    size_t mResidentLOD;
+    size_t mRequestedLOD;
+
+private:
+    void UploadLevel(_In_ ID3D11DeviceContext* context, size_t mip);
+};
+
+
+DDSStreamingTexture::Impl::Impl(_In_ ID3D11Device* device, _In_ ID3D11DeviceContext* context, _In_z_ const wchar_t* fileName, size_t initialMips, size_t maxsize, bool forceSRGB)
+{
+    if (!device || !context)
+        throw std::exception("Direct3D device and context cannot be null");
+
+    DDS_HEADER* header = nullptr;
+    uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+
+    ThrowIfFailed(
+        MapTextureDataFromFile( fileName, mDDSView, &header, &bitData, &bitSize )
+    );
+
+    DDSTextureInfo info;
+
+    ThrowIfFailed(
+        GetTextureInfo( header, &info )
+    );
+
+    // Volume and 1D textures are rarely big enough to be worth streaming.
+    if (info.resDim != D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+        throw std::exception("DDSStreamingTexture only supports 2D textures");
+
+    // Find the source of every subresource, dropping any levels larger than maxsize.
+    std::vector<D3D11_SUBRESOURCE_DATA> initData(info.mipCount * info.arraySize);
+
+    size_t twidth = 0;
+    size_t theight = 0;
+    size_t tdepth = 0;
+    size_t skipMip = 0;
+
+    ThrowIfFailed(
+        FillInitData( info.width, info.height, info.depth, info.mipCount, info.arraySize, info.format, maxsize, bitSize, bitData,
+                      twidth, theight, tdepth, skipMip, &initData.front() )
+    );
+
+    mMipLevels = info.mipCount - skipMip;
+    mArraySize = info.arraySize;
+
+    initData.resize(mMipLevels * mArraySize);
+    mInitData.swap(initData);
+
+    // Create the full mip chain without any contents; levels are filled in with UpdateSubresource.
+    ThrowIfFailed(
+        CreateD3DResources( device, info.resDim, twidth, theight, tdepth, mMipLevels, mArraySize, info.format,
+                            D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, forceSRGB, info.isCubeMap,
+                            nullptr, &mTexture, &mTextureView )
+    );
+
+    SetDebugObjectName(mTexture.Get(),     "DDSStreamingTexture");
+    SetDebugObjectName(mTextureView.Get(), "DDSStreamingTexture");
+
+    // Start with nothing resident, then load the requested number of the smallest levels.
+    mLoadedLOD = mMipLevels;
+    mResidentLOD = mMipLevels;
+    mRequestedLOD = mMipLevels - std::min(std::max<size_t>(initialMips, 1), mMipLevels);
+
+    Update(context, 0);
+}
+
+
+// Uploads pending levels, smallest first, until the requested LOD is resident or the byte budget is spent.
+bool DDSStreamingTexture::Impl::Update(_In_ ID3D11DeviceContext* context, size_t maxBytes)
+{
+    // Levels that were uploaded before come back just by moving the clamp.
+    size_t clamp = std::max(mRequestedLOD, mLoadedLOD);
+
+    if (clamp != mResidentLOD)
+    {
+        mResidentLOD = clamp;
+
+        context->SetResourceMinLOD(mTexture.Get(), static_cast<float>(mResidentLOD));
+    }
+
+    size_t uploaded = 0;
+
+    while (mLoadedLOD > mRequestedLOD)
+    {
+        size_t mip = mLoadedLOD - 1;
+
+        size_t levelBytes = 0;
+
+        for (size_t item = 0; item < mArraySize; item++)
+        {
+            levelBytes += mInitData[item * mMipLevels + mip].SysMemSlicePitch;
+        }
+
+        // Always make progress, even if one level is larger than the whole budget.
+        if (maxBytes && uploaded && uploaded + levelBytes > maxBytes)
+            break;
+
+        UploadLevel(context, mip);
+
+        uploaded += levelBytes;
+    }
+
+    return mResidentLOD == mRequestedLOD;
+}
+
+
+// Copies one mip level of every array item, then lets the GPU start sampling it.
+void DDSStreamingTexture::Impl::UploadLevel(_In_ ID3D11DeviceContext* context, size_t mip)
+{
+    for (size_t item = 0; item < mArraySize; item++)
+    {
+        auto const& source = mInitData[item * mMipLevels + mip];
+
+        UINT subresource = D3D11CalcSubresource(static_cast<UINT>(mip), static_cast<UINT>(item), static_cast<UINT>(mMipLevels));
+
+        context->UpdateSubresource(mTexture.Get(), subresource, nullptr, source.pSysMem, source.SysMemPitch, source.SysMemSlicePitch);
+    }
+
+    mLoadedLOD = mip;
+    mResidentLOD = mip;
+
+    context->SetResourceMinLOD(mTexture.Get(), static_cast<float>(mip));
+}
+
+
+// Public constructor.
+_Use_decl_annotations_
+DDSStreamingTexture::DDSStreamingTexture(ID3D11Device* device, ID3D11DeviceContext* context, const wchar_t* fileName, size_t initialMips, size_t maxsize, bool forceSRGB)
+  : pImpl(new Impl(device, context, fileName, initialMips, maxsize, forceSRGB))
+{
+}
+
+
+// Move constructor.
+DDSStreamingTexture::DDSStreamingTexture(DDSStreamingTexture&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+DDSStreamingTexture& DDSStreamingTexture::operator= (DDSStreamingTexture&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+DDSStreamingTexture::~DDSStreamingTexture()
+{
+}
+
+
+void DDSStreamingTexture::SetRequestedLOD(size_t mostDetailedMip)
+{
+    pImpl->mRequestedLOD = std::min(mostDetailedMip, pImpl->mMipLevels - 1);
+}
+
+
+_Use_decl_annotations_
+bool DDSStreamingTexture::Update(ID3D11DeviceContext* context, size_t maxBytes)
+{
+    return pImpl->Update(context, maxBytes);
+}
+
+
+size_t DDSStreamingTexture::GetRequestedLOD() const
+{
+    return pImpl->mRequestedLOD;
+}
+
+
+size_t DDSStreamingTexture::GetResidentLOD() const
+{
+    return pImpl->mResidentLOD;
+}
+
+
+size_t DDSStreamingTexture::GetMipLevels() const
+{
+    return pImpl->mMipLevels;
+}
+
+
+ID3D11Resource* DDSStreamingTexture::GetTexture() const
+{
+    return pImpl->mTexture.Get();
+}
+
+
+ID3D11ShaderResourceView* DDSStreamingTexture::GetShaderResourceView() const
+{
+    return pImpl->mTextureView.Get();
+}
@@ -116,7 +116,7 @@ __declspec(align(16)) struct DGSLEffectConstants
 
 struct DGSLEffectTraits
 {
-    static const int VertexShaderCount = 8;
+    static const int VertexShaderCount = 10;
     static const int PixelShaderCount = 12;
 
     static const ShaderBytecode VertexShaderBytecode[VertexShaderCount];
@@ -137,6 +137,8 @@ namespace
     #include "Shaders/Compiled/XboxOneDGSLEffect_main2BonesVc.inc"
     #include "Shaders/Compiled/XboxOneDGSLEffect_main4Bones.inc"
     #include "Shaders/Compiled/XboxOneDGSLEffect_main4BonesVc.inc"
+    #include "Shaders/Compiled/XboxOneDGSLEffect_mainInst.inc"
+    #include "Shaders/Compiled/XboxOneDGSLEffect_mainVcInst.inc"
 
     // PS
     #include "Shaders/Compiled/XboxOneDGSLUnlit_main.inc"
@@ -164,6 +166,8 @@ namespace
     #include "Shaders/Compiled/DGSLEffect_main2BonesVc.inc"
     #include "Shaders/Compiled/DGSLEffect_main4Bones.inc"
     #include "Shaders/Compiled/DGSLEffect_main4BonesVc.inc"
+    #include "Shaders/Compiled/DGSLEffect_mainInst.inc"
+    #include "Shaders/Compiled/DGSLEffect_mainVcInst.inc"
 
     // PS
     #include "Shaders/Compiled/DGSLUnlit_main.inc"
@@ -195,6 +199,8 @@ const ShaderBytecode DGSLEffectTraits::VertexShaderBytecode[] =
     { DGSLEffect_main2BonesVc, sizeof(DGSLEffect_main2BonesVc) },
     { DGSLEffect_main4Bones, sizeof(DGSLEffect_main4Bones) },
     { DGSLEffect_main4BonesVc, sizeof(DGSLEffect_main4BonesVc) },
+    { DGSLEffect_mainInst, sizeof(DGSLEffect_mainInst) },
+    { DGSLEffect_mainVcInst, sizeof(DGSLEffect_mainVcInst) },
 };
 
 
@@ -227,6 +233,7 @@ public:
         textureEnabled(false),
         specularEnabled(false),
         alphaDiscardEnabled(false),
+        instancingEnabled(false),
         weightsPerVertex( enableSkinning ? 4 : 0 ),
         mPixelShader( pixelShader ),
         mCBMaterial( device ),
@@ -273,6 +280,48 @@ public:
         }
     }
 
+    // Copy constructor, used by Clone. Shaders and textures are shared, but the copy has its own constant buffers.
+    Impl( Impl const& other ) :
+        constants( other.constants ),
+        world( other.world ),
+        view( other.view ),
+        projection( other.projection ),
+        dirtyFlags( INT_MAX ),
+        vertexColorEnabled( other.vertexColorEnabled ),
+        textureEnabled( other.textureEnabled ),
+        specularEnabled( other.specularEnabled ),
+        alphaDiscardEnabled( other.alphaDiscardEnabled ),
+        instancingEnabled( other.instancingEnabled ),
+        weightsPerVertex( other.weightsPerVertex ),
+        mPixelShader( other.mPixelShader ),
+        mDeviceResources( other.mDeviceResources )
+    {
+        for( int i = 0; i < MaxDirectionalLights; ++i )
+        {
+            lightEnabled[i] = other.lightEnabled[i];
+            lightDiffuseColor[i] = other.lightDiffuseColor[i];
+            lightSpecularColor[i] = other.lightSpecularColor[i];
+        }
+
+        for( int i = 0; i < MaxTextures; ++i )
+        {
+            textures[i] = other.textures[i];
+        }
+
+        Microsoft::WRL::ComPtr<ID3D11Device> device;
+        other.mCBMaterial.GetBuffer()->GetDevice( &device );
+
+        mCBMaterial.Create( device.Get() );
+        mCBLight.Create( device.Get() );
+        mCBObject.Create( device.Get() );
+        mCBMisc.Create( device.Get() );
+
+        if ( other.mCBBone.GetBuffer() )
+        {
+            mCBBone.Create( device.Get() );
+        }
+    }
+
     // Methods
     void Apply( _In_ ID3D11DeviceContext* deviceContext );
     void GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength);
@@ -296,6 +345,7 @@ public:
     bool textureEnabled;
     bool specularEnabled;
     bool alphaDiscardEnabled;
+    bool instancingEnabled;
     int weightsPerVertex;
 
 private:
@@ -309,6 +359,9 @@ private:
     int GetCurrentVSPermutation() const;
     int GetCurrentPSPermutation() const;
 
+    void WarmUpShaders( bool allPermutations );
+    void GetShaderCreationStats( std::vector<EffectShaderCreation>& stats ) const { mDeviceResources->GetShaderCreations(stats); }
+
     // Only one of these helpers is allocated per D3D device, even if there are multiple effect instances.
     class DeviceResources : protected EffectDeviceResources
     {
@@ -316,21 +369,23 @@ private:
         DeviceResources(_In_ ID3D11Device* device) : EffectDeviceResources(device) {}
 
         // Gets or lazily creates the vertex shader.
-        ID3D11VertexShader* GetVertexShader( int permutation )
+        ID3D11VertexShader* GetVertexShader( int permutation, bool warmUp = false )
         {
             assert( permutation < DGSLEffectTraits::VertexShaderCount );
 
-            return DemandCreateVertexShader(mVertexShaders[permutation], DGSLEffectTraits::VertexShaderBytecode[permutation]);
+            return DemandCreateVertexShader(mVertexShaders[permutation], DGSLEffectTraits::VertexShaderBytecode[permutation], permutation, warmUp);
         }
 
         // Gets or lazily creates the specified pixel shader permutation.
-        ID3D11PixelShader* GetPixelShader( int permutation )
+        ID3D11PixelShader* GetPixelShader( int permutation, bool warmUp = false )
         {
             assert( permutation < DGSLEffectTraits::PixelShaderCount );
 
-            return DemandCreatePixelShader(mPixelShaders[permutation], DGSLEffectTraits::PixelShaderBytecode[permutation]);
+            return DemandCreatePixelShader(mPixelShaders[permutation], DGSLEffectTraits::PixelShaderBytecode[permutation], permutation, warmUp);
         }
 
+        void GetShaderCreations( std::vector<EffectShaderCreation>& result ) { EffectDeviceResources::GetShaderCreations(result); }
+
         // Gets or lazily creates the default texture
         ID3D11ShaderResourceView* GetDefaultTexture() { return EffectDeviceResources::GetDefaultTexture(); }
 
@@ -397,6 +452,13 @@ void DGSLEffect::Impl::Apply( _In_ ID3D11DeviceContext* deviceContext )
         dirtyFlags |= EffectDirtyFlags::ConstantBufferObject;
     }
 
+    // Dynamic buffers have undefined contents at the start of each command list, so deferred contexts always write them.
+    if ( deviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED )
+    {
+        dirtyFlags |= EffectDirtyFlags::ConstantBufferMaterial | EffectDirtyFlags::ConstantBufferLight | EffectDirtyFlags::ConstantBufferObject
+                      | EffectDirtyFlags::ConstantBufferMisc | EffectDirtyFlags::ConstantBufferBones;
+    }
+
     // Make sure the constant buffers are up to date.
     if (dirtyFlags & EffectDirtyFlags::ConstantBufferMaterial)
     {
@@ -464,6 +526,33 @@ void DGSLEffect::Impl::Apply( _In_ ID3D11DeviceContext* deviceContext )
 }
 
 
+// Creates shaders ahead of first use.
+void DGSLEffect::Impl::WarmUpShaders( bool allPermutations )
+{
+    if ( !allPermutations )
+    {
+        mDeviceResources->GetVertexShader( GetCurrentVSPermutation(), true );
+
+        if ( !mPixelShader )
+        {
+            mDeviceResources->GetPixelShader( GetCurrentPSPermutation(), true );
+        }
+
+        return;
+    }
+
+    for( int i = 0; i < DGSLEffectTraits::VertexShaderCount; ++i )
+    {
+        mDeviceResources->GetVertexShader( i, true );
+    }
+
+    for( int i = 0; i < DGSLEffectTraits::PixelShaderCount; ++i )
+    {
+        mDeviceResources->GetPixelShader( i, true );
+    }
+}
+
+
 void DGSLEffect::Impl::GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Out_ size_t* pByteCodeLength)
 {
     int permutation = GetCurrentVSPermutation();
@@ -481,7 +570,12 @@ int DGSLEffect::Impl::GetCurrentVSPermutation() const
 {
     int permutation = (vertexColorEnabled) ? 1 : 0;
 
-    if( weightsPerVertex > 0 )
+    if ( instancingEnabled )
+    {
+        // Instanced shaders follow the skinned ones (the two can't be combined)
+        permutation += 8;
+    }
+    else if( weightsPerVertex > 0 )
     {
         // Evaluate 1, 2, or 4 weights per vertex?
         permutation += 2;
@@ -543,6 +637,13 @@ DGSLEffect& DGSLEffect::operator= (DGSLEffect&& moveFrom)
 }
 
 
+// Used by Clone
+DGSLEffect::DGSLEffect(std::unique_ptr<Impl>&& impl)
+    : pImpl(std::move(impl))
+{
+}
+
+
 DGSLEffect::~DGSLEffect()
 {
 }
@@ -561,6 +662,26 @@ void DGSLEffect::GetVertexShaderBytecode(_Out_ void const** pShaderByteCode, _Ou
 }
 
 
+std::shared_ptr<IEffect> DGSLEffect::Clone() const
+{
+    std::unique_ptr<Impl> impl(new Impl(*pImpl));
+
+    return std::shared_ptr<IEffect>(new DGSLEffect(std::move(impl)));
+}
+
+
+void DGSLEffect::WarmUpShaders(bool allPermutations)
+{
+    pImpl->WarmUpShaders(allPermutations);
+}
+
+
+void DGSLEffect::GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const
+{
+    pImpl->GetShaderCreationStats(stats);
+}
+
+
 // Camera settings
 void XM_CALLCONV DGSLEffect::SetWorld(FXMMATRIX value)
 {
@@ -882,3 +1003,13 @@ void DGSLEffect::ResetBoneTransforms()
 
     pImpl->dirtyFlags |= EffectDirtyFlags::ConstantBufferBones;
 }
+
+
+// Instancing setting
+void DGSLEffect::SetInstancingEnabled(bool value)
+{
+    if ( value && pImpl->weightsPerVertex )
+        throw std::exception("Instancing is not supported for skinned effects");
+
+    pImpl->instancingEnabled = value;
+}
@@ -15,8 +15,11 @@
 #include "Effects.h"
 #include "DemandCreate.h"
 #include "SharedResourcePool.h"
+#include "FactoryCache.h"
+#include "ScopedInstrumentationEvent.h"
 
 #include "DDSTextureLoader.h"
+#include "TextureCache.h"
 
 #include <string.h>
 
@@ -36,7 +39,13 @@ class DGSLEffectFactory::Impl
 {
 public:
     Impl(_In_ ID3D11Device* device)
-      : device(device), mSharing(true)
+      : device(device),
+        mEffectCache(false),
+        mEffectCacheSkinning(false),
+        mTextureCache(true),
+        mSharedTextures(device),
+        mShaderCache(true),
+        mSharing(true)
     { *mPath = 0; }
 
     std::shared_ptr<IEffect> CreateEffect( _In_ DGSLEffectFactory* factory, _In_ const IEffectFactory::EffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext );
@@ -52,15 +61,23 @@ public:
     WCHAR mPath[MAX_PATH];
 
 private:
+    std::shared_ptr<IEffect> MakeEffect( _In_ DGSLEffectFactory* factory, _In_ const IEffectFactory::EffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext );
+    std::shared_ptr<IEffect> MakeDGSLEffect( _In_ DGSLEffectFactory* factory, _In_ const DGSLEffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext );
+    void LoadTexture( _In_z_ const WCHAR* name, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView );
+    void LoadPixelShader( _In_z_ const WCHAR* name, _Outptr_ ID3D11PixelShader** pixelShader );
+
     ComPtr<ID3D11Device> device;
 
-    typedef std::map< std::wstring, std::shared_ptr<IEffect> > EffectCache;
-    typedef std::map< std::wstring, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> > TextureCache;
-    typedef std::map< std::wstring, Microsoft::WRL::ComPtr<ID3D11PixelShader> > ShaderCache;
+    typedef FactoryCache< std::shared_ptr<IEffect> > EffectCache;
+    typedef FactoryCache< Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> > TextureCache;
+    typedef FactoryCache< Microsoft::WRL::ComPtr<ID3D11PixelShader> > ShaderCache;
 
     EffectCache  mEffectCache;
     EffectCache  mEffectCacheSkinning;
     TextureCache mTextureCache;
+
+    // Loads shared with everything else using a TextureCache on this device.
+    DirectX::TextureCache mSharedTextures;
     ShaderCache  mShaderCache;
 
     bool mSharing;
@@ -78,24 +95,21 @@ std::shared_ptr<IEffect> DGSLEffectFactory::Impl::CreateEffect( DGSLEffectFactor
 {
     if ( mSharing && info.name && *info.name )
     {
-        if ( info.enableSkinning )
-        {
-            auto it = mEffectCacheSkinning.find( info.name );
-            if ( it != mEffectCacheSkinning.end() )
-            {
-                return it->second;
-            }
-        }
-        else
+        auto& cache = ( info.enableSkinning ) ? mEffectCacheSkinning : mEffectCache;
+
+        return cache.GetOrCreate( info.name, [&]() -> std::shared_ptr<IEffect>
         {
-            auto it = mEffectCache.find( info.name );
-            if ( it != mEffectCache.end() )
-            {
-                return it->second;
-            }
-        }
+            return MakeEffect( factory, info, deviceContext );
+        });
     }
 
+    return MakeEffect( factory, info, deviceContext );
+}
+
+
+_Use_decl_annotations_
+std::shared_ptr<IEffect> DGSLEffectFactory::Impl::MakeEffect( DGSLEffectFactory* factory, const DGSLEffectFactory::EffectInfo& info, ID3D11DeviceContext* deviceContext )
+{
     std::shared_ptr<DGSLEffect> effect = std::make_shared<DGSLEffect>( device.Get(), nullptr, info.enableSkinning );
 
     effect->EnableDefaultLighting();
@@ -137,19 +151,6 @@ std::shared_ptr<IEffect> DGSLEffectFactory::Impl::CreateEffect( DGSLEffectFactor
         effect->SetTextureEnabled(true);
     }
 
-    if ( mSharing && info.name && *info.name )
-    {
-        std::lock_guard<std::mutex> lock(mutex);
-        if ( info.enableSkinning )
-        {
-            mEffectCacheSkinning.insert( EffectCache::value_type( info.name, effect ) );
-        }
-        else
-        {
-            mEffectCache.insert( EffectCache::value_type( info.name, effect ) );
-        }
-    }
-
     return effect;
 }
 
@@ -159,24 +160,21 @@ std::shared_ptr<IEffect> DGSLEffectFactory::Impl::CreateDGSLEffect( DGSLEffectFa
 {
     if ( mSharing && info.name && *info.name )
     {
-        if ( info.enableSkinning )
-        {
-            auto it = mEffectCacheSkinning.find( info.name );
-            if ( it != mEffectCacheSkinning.end() )
-            {
-                return it->second;
-            }
-        }
-        else
+        auto& cache = ( info.enableSkinning ) ? mEffectCacheSkinning : mEffectCache;
+
+        return cache.GetOrCreate( info.name, [&]() -> std::shared_ptr<IEffect>
         {
-            auto it = mEffectCache.find( info.name );
-            if ( it != mEffectCache.end() )
-            {
-                return it->second;
-            }
-        }
+            return MakeDGSLEffect( factory, info, deviceContext );
+        });
     }
 
+    return MakeDGSLEffect( factory, info, deviceContext );
+}
+
+
+_Use_decl_annotations_
+std::shared_ptr<IEffect> DGSLEffectFactory::Impl::MakeDGSLEffect( DGSLEffectFactory* factory, const DGSLEffectFactory::DGSLEffectInfo& info, ID3D11DeviceContext* deviceContext )
+{
     std::shared_ptr<DGSLEffect> effect;
 
     bool lighting = true;
@@ -298,19 +296,6 @@ std::shared_ptr<IEffect> DGSLEffectFactory::Impl::CreateDGSLEffect( DGSLEffectFa
         }
     }
 
-    if ( mSharing && info.name && *info.name )
-    {
-        std::lock_guard<std::mutex> lock(mutex);
-        if ( info.enableSkinning )
-        {
-            mEffectCacheSkinning.insert( EffectCache::value_type( info.name, effect ) );
-        }
-        else
-        {
-            mEffectCache.insert( EffectCache::value_type( info.name, effect ) );
-        }
-    }
-
     return effect;
 }
 
@@ -321,24 +306,40 @@ void DGSLEffectFactory::Impl::CreateTexture( const WCHAR* name, ID3D11DeviceCont
     if ( !name || !textureView )
         throw std::exception("invalid arguments");
 
+    if ( mSharing && *name )
+    {
+        auto srv = mTextureCache.GetOrCreate( name, [&]() -> ComPtr<ID3D11ShaderResourceView>
+        {
+            ComPtr<ID3D11ShaderResourceView> result;
+            LoadTexture( name, deviceContext, &result );
+            return result;
+        });
+
+        *textureView = srv.Detach();
+    }
+    else
+    {
+        LoadTexture( name, deviceContext, textureView );
+    }
+}
+
+_Use_decl_annotations_
+void DGSLEffectFactory::Impl::LoadTexture( const WCHAR* name, ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView** textureView )
+{
 #if defined(_XBOX_ONE) && defined(_TITLE)
     UNREFERENCED_PARAMETER(deviceContext);
 #endif
 
-    auto it = mTextureCache.find( name );
+    WCHAR fullName[MAX_PATH] = {0};
+    wcscpy_s( fullName, mPath );
+    wcscat_s( fullName, name );
 
-    if ( mSharing && it != mTextureCache.end() )
+    if ( mSharing )
     {
-        ID3D11ShaderResourceView* srv = it->second.Get();
-        srv->AddRef();
-        *textureView = srv;
+        mSharedTextures.CreateTexture( fullName, deviceContext, textureView );
     }
     else
     {
-        WCHAR fullName[MAX_PATH] = {0};
-        wcscpy_s( fullName, mPath );
-        wcscat_s( fullName, name );
-
 #if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
         WCHAR ext[_MAX_EXT];
         _wsplitpath_s( name, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT );
@@ -382,12 +383,6 @@ void DGSLEffectFactory::Impl::CreateTexture( const WCHAR* name, ID3D11DeviceCont
             throw std::exception( "CreateDDSTextureFromFile" );
         }
 #endif
-
-        if ( mSharing && *name && it == mTextureCache.end() )
-        {   
-            std::lock_guard<std::mutex> lock(mutex);
-            mTextureCache.insert( TextureCache::value_type( name, *textureView ) );
-        }
     }
 }
 
@@ -398,52 +393,53 @@ void DGSLEffectFactory::Impl::CreatePixelShader( const WCHAR* name, ID3D11PixelS
     if ( !name || !pixelShader )
         throw std::exception("invalid arguments");
 
-    auto it = mShaderCache.find( name );
-
-    if ( mSharing && it != mShaderCache.end() )
+    if ( mSharing && *name )
     {
-        ID3D11PixelShader* ps = it->second.Get();
-        ps->AddRef();
-        *pixelShader = ps;
+        auto ps = mShaderCache.GetOrCreate( name, [&]() -> ComPtr<ID3D11PixelShader>
+        {
+            ComPtr<ID3D11PixelShader> result;
+            LoadPixelShader( name, &result );
+            return result;
+        });
+
+        *pixelShader = ps.Detach();
     }
     else
     {
-        WCHAR fullName[MAX_PATH]={0};
-        wcscpy_s( fullName, mPath );
-        wcscat_s( fullName, name );
+        LoadPixelShader( name, pixelShader );
+    }
+}
 
-        size_t dataSize = 0;
-        std::unique_ptr<uint8_t[]> data;
-        HRESULT hr = BinaryReader::ReadEntireFile( fullName, data, &dataSize );
-        if ( FAILED(hr) )
-        {
-            DebugTrace( "CreatePixelShader failed (%08X) to load shader file '%ls'\n", hr, fullName );
-            throw std::exception( "CreatePixelShader" );
-        }
-       
-        ThrowIfFailed(
-            device->CreatePixelShader( data.get(), dataSize, nullptr, pixelShader ) );
 
-        if ( mSharing && *name && it == mShaderCache.end() )
-        {   
-            std::lock_guard<std::mutex> lock(mutex);
-            mShaderCache.insert( ShaderCache::value_type( name, *pixelShader ) );
-        }
+_Use_decl_annotations_
+void DGSLEffectFactory::Impl::LoadPixelShader( const WCHAR* name, ID3D11PixelShader** pixelShader )
+{
+    WCHAR fullName[MAX_PATH]={0};
+    wcscpy_s( fullName, mPath );
+    wcscat_s( fullName, name );
+
+    BinaryReader::FileData data;
+    HRESULT hr = BinaryReader::LoadEntireFile( fullName, data );
+    if ( FAILED(hr) )
+    {
+        DebugTrace( "CreatePixelShader failed (%08X) to load shader file '%ls'\n", hr, fullName );
+        throw std::exception( "CreatePixelShader" );
     }
+
+    ThrowIfFailed(
+        device->CreatePixelShader( data.get(), data.size(), nullptr, pixelShader ) );
 }
 
 
 void DGSLEffectFactory::Impl::ReleaseCache()
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    mEffectCache.clear();
-    mEffectCacheSkinning.clear();
-    mTextureCache.clear();
-    mShaderCache.clear();
+    mEffectCache.Clear();
+    mEffectCacheSkinning.Clear();
+    mTextureCache.Clear();
+    mShaderCache.Clear();
 }
 
 
-
 //--------------------------------------------------------------------------------------
 // DGSLEffectFactory
 //--------------------------------------------------------------------------------------
@@ -474,6 +470,8 @@ DGSLEffectFactory& DGSLEffectFactory::operator= (DGSLEffectFactory&& moveFrom)
 _Use_decl_annotations_
 std::shared_ptr<IEffect> DGSLEffectFactory::CreateEffect( const EffectInfo& info, ID3D11DeviceContext* deviceContext )
 {
+    ScopedInstrumentationEvent event( InstrumentationCategory_EffectFactory, L"DGSLEffectFactory::CreateEffect", info.name );
+
     return pImpl->CreateEffect( this, info, deviceContext );
 }
 
@@ -488,6 +486,8 @@ void DGSLEffectFactory::CreateTexture( const WCHAR* name, ID3D11DeviceContext* d
 _Use_decl_annotations_
 std::shared_ptr<IEffect> DGSLEffectFactory::CreateDGSLEffect( const DGSLEffectInfo& info, ID3D11DeviceContext* deviceContext )
 {
+    ScopedInstrumentationEvent event( InstrumentationCategory_EffectFactory, L"DGSLEffectFactory::CreateDGSLEffect", info.name );
+
     return pImpl->CreateDGSLEffect( this, info, deviceContext );
 }
 
@@ -36,8 +36,8 @@ struct DualTextureEffectTraits
     typedef DualTextureEffectConstants ConstantBufferType;
 
     static const int VertexShaderCount = 4;
-    static const int PixelShaderCount = 2;
-    static const int ShaderPermutationCount = 4;
+    static const int PixelShaderCount = 3;
+    static const int ShaderPermutationCount = 5;
 };
 
 
@@ -48,6 +48,7 @@ public:
     Impl(_In_ ID3D11Device* device);
 
     bool vertexColorEnabled;
+    bool depthOnly;
     
     EffectColor color;
 
@@ -98,6 +99,7 @@ const int EffectBase<DualTextureEffectTraits>::VertexShaderIndices[] =
     1,      // no fog
     2,      // vertex color
     3,      // vertex color, no fog
+    1,      // depth only
 };
 
 
@@ -105,6 +107,7 @@ const ShaderBytecode EffectBase<DualTextureEffectTraits>::PixelShaderBytecode[]
 {
     { DualTextureEffect_PSDualTexture,        sizeof(DualTextureEffect_PSDualTexture)        },
     { DualTextureEffect_PSDualTextureNoFog,   sizeof(DualTextureEffect_PSDualTextureNoFog)   },
+    { nullptr,                                0                                              },
 
 };
 
@@ -115,6 +118,7 @@ const int EffectBase<DualTextureEffectTraits>::PixelShaderIndices[] =
     1,      // no fog
     0,      // vertex color
     1,      // vertex color, no fog
+    2,      // depth only
 };
 
 
@@ -125,7 +129,8 @@ SharedResourcePool<ID3D11Device*, EffectBase<DualTextureEffectTraits>::DeviceRes
 // Constructor.
 DualTextureEffect::Impl::Impl(_In_ ID3D11Device* device)
   : EffectBase(device),
-    vertexColorEnabled(false)
+    vertexColorEnabled(false),
+    depthOnly(false)
 {
     static_assert( _countof(EffectBase<DualTextureEffectTraits>::VertexShaderIndices) == DualTextureEffectTraits::ShaderPermutationCount, "array/max mismatch" );
     static_assert( _countof(EffectBase<DualTextureEffectTraits>::VertexShaderBytecode) == DualTextureEffectTraits::VertexShaderCount, "array/max mismatch" );
@@ -136,6 +141,12 @@ DualTextureEffect::Impl::Impl(_In_ ID3D11Device* device)
 
 int DualTextureEffect::Impl::GetCurrentShaderPermutation() const
 {
+    // Depth only passes skip both textures, with no pixel shader.
+    if (depthOnly)
+    {
+        return 4;
+    }
+
     int permutation = 0;
 
     // Use optimized shaders if fog is disabled.
@@ -200,6 +211,13 @@ DualTextureEffect& DualTextureEffect::operator= (DualTextureEffect&& moveFrom)
 }
 
 
+// Private constructor, used by Clone.
+DualTextureEffect::DualTextureEffect(std::unique_ptr<Impl>&& impl)
+  : pImpl(std::move(impl))
+{
+}
+
+
 // Public destructor.
 DualTextureEffect::~DualTextureEffect()
 {
@@ -218,6 +236,26 @@ void DualTextureEffect::GetVertexShaderBytecode(_Out_ void const** pShaderByteCo
 }
 
 
+std::shared_ptr<IEffect> DualTextureEffect::Clone() const
+{
+    std::unique_ptr<Impl> impl(new Impl(*pImpl));
+
+    return std::shared_ptr<IEffect>(new DualTextureEffect(std::move(impl)));
+}
+
+
+void DualTextureEffect::WarmUpShaders(bool allPermutations)
+{
+    pImpl->WarmUpShaders(allPermutations ? -1 : pImpl->GetCurrentShaderPermutation());
+}
+
+
+void DualTextureEffect::GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const
+{
+    pImpl->GetShaderCreationStats(stats);
+}
+
+
 void XM_CALLCONV DualTextureEffect::SetWorld(FXMMATRIX value)
 {
     pImpl->matrices.world = value;
@@ -306,3 +344,9 @@ void DualTextureEffect::SetTexture2(_In_opt_ ID3D11ShaderResourceView* value)
 {
     pImpl->texture2 = value;
 }
+
+
+void DualTextureEffect::SetDepthOnly(bool value)
+{
+    pImpl->depthOnly = value;
+}
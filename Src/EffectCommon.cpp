@@ -39,7 +39,7 @@ _Use_decl_annotations_ void EffectMatrices::SetConstants(int& dirtyFlags, XMMATR
         worldViewProjConstant = XMMatrixTranspose(XMMatrixMultiply(worldView, projection));
                 
         dirtyFlags &= ~EffectDirtyFlags::WorldViewProj;
-        dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
+        dirtyFlags |= EffectDirtyFlags::ObjectConstantBuffer;
     }
 }
 
@@ -86,7 +86,7 @@ void XM_CALLCONV EffectFog::SetConstants(int& dirtyFlags, FXMMATRIX worldView, X
             }
 
             dirtyFlags &= ~(EffectDirtyFlags::FogVector | EffectDirtyFlags::FogEnable);
-            dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
+            dirtyFlags |= EffectDirtyFlags::ObjectConstantBuffer;
         }
     }
     else
@@ -97,7 +97,7 @@ void XM_CALLCONV EffectFog::SetConstants(int& dirtyFlags, FXMMATRIX worldView, X
             fogVectorConstant = g_XMZero;
 
             dirtyFlags &= ~EffectDirtyFlags::FogEnable;
-            dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
+            dirtyFlags |= EffectDirtyFlags::ObjectConstantBuffer;
         }
     }
 }
@@ -182,7 +182,7 @@ _Use_decl_annotations_ void EffectLights::SetConstants(int& dirtyFlags, EffectMa
             worldInverseTransposeConstant[2] = worldInverse.r[2];
 
             dirtyFlags &= ~EffectDirtyFlags::WorldInverseTranspose;
-            dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
+            dirtyFlags |= EffectDirtyFlags::ObjectConstantBuffer;
         }
 
         // Eye position vector.
@@ -366,36 +366,92 @@ void EffectLights::EnableDefaultLighting(_In_ IEffectLights* effect)
 }
 
 
+namespace
+{
+    // Measures how long the creation of one shader takes, and records it.
+    class ShaderCreationTimer
+    {
+    public:
+        ShaderCreationTimer()
+        {
+            QueryPerformanceCounter(&mStart);
+        }
+
+        void Record(std::vector<EffectShaderCreation>& creations, int permutation, bool pixelShader, bool warmUp)
+        {
+            LARGE_INTEGER end;
+            LARGE_INTEGER frequency;
+
+            QueryPerformanceCounter(&end);
+            QueryPerformanceFrequency(&frequency);
+
+            EffectShaderCreation creation;
+
+            creation.permutation = permutation;
+            creation.pixelShader = pixelShader;
+            creation.warmUp = warmUp;
+            creation.milliseconds = static_cast<double>(end.QuadPart - mStart.QuadPart) * 1000.0 / static_cast<double>(frequency.QuadPart);
+
+            creations.push_back(creation);
+        }
+
+    private:
+        LARGE_INTEGER mStart;
+    };
+}
+
+
 // Gets or lazily creates the specified vertex shader permutation.
-ID3D11VertexShader* EffectDeviceResources::DemandCreateVertexShader(_Inout_ ComPtr<ID3D11VertexShader>& vertexShader, ShaderBytecode const& bytecode)
+ID3D11VertexShader* EffectDeviceResources::DemandCreateVertexShader(_Inout_ ComPtr<ID3D11VertexShader>& vertexShader, ShaderBytecode const& bytecode, int permutation, bool warmUp)
 {
     return DemandCreate(vertexShader, mMutex, [&](ID3D11VertexShader** pResult) -> HRESULT
     {
+        ShaderCreationTimer timer;
+
         HRESULT hr = mDevice->CreateVertexShader(bytecode.code, bytecode.length, nullptr, pResult);
 
         if (SUCCEEDED(hr))
+        {
             SetDebugObjectName(*pResult, "DirectXTK:Effect");
 
+            timer.Record(mShaderCreations, permutation, false, warmUp);
+        }
+
         return hr;
     });
 }
 
 
 // Gets or lazily creates the specified pixel shader permutation.
-ID3D11PixelShader* EffectDeviceResources::DemandCreatePixelShader(_Inout_ ComPtr<ID3D11PixelShader>& pixelShader, ShaderBytecode const& bytecode)
+ID3D11PixelShader* EffectDeviceResources::DemandCreatePixelShader(_Inout_ ComPtr<ID3D11PixelShader>& pixelShader, ShaderBytecode const& bytecode, int permutation, bool warmUp)
 {
     return DemandCreate(pixelShader, mMutex, [&](ID3D11PixelShader** pResult) -> HRESULT
     {
+        ShaderCreationTimer timer;
+
         HRESULT hr = mDevice->CreatePixelShader(bytecode.code, bytecode.length, nullptr, pResult);
 
         if (SUCCEEDED(hr))
+        {
             SetDebugObjectName(*pResult, "DirectXTK:Effect");
 
+            timer.Record(mShaderCreations, permutation, true, warmUp);
+        }
+
         return hr;
     });
 }
 
 
+// Copies the list of shaders created so far.
+void EffectDeviceResources::GetShaderCreations(std::vector<EffectShaderCreation>& result)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    result = mShaderCreations;
+}
+
+
 // Gets or lazily creates the default texture
 ID3D11ShaderResourceView* EffectDeviceResources::GetDefaultTexture()
 {
@@ -436,3 +492,206 @@ ID3D11ShaderResourceView* EffectDeviceResources::GetDefaultTexture()
         return hr;
     });
 }
+
+
+//--------------------------------------------------------------------------------------
+// EffectConstantRing
+//--------------------------------------------------------------------------------------
+
+namespace
+{
+    // Device context private data holding the attached EffectConstantRing::Impl pointer.
+    const GUID ConstantRingPrivateDataGuid = { 0x9c68a248, 0xf7da, 0x408c, { 0xa3, 0x61, 0xfb, 0xf4, 0x39, 0xfe, 0x24, 0xa5 } };
+
+    // Constant buffer offsets and sizes are in units of 16 constants (256 bytes).
+    const size_t ConstantRingAlignment = 256;
+
+    // Large enough for any one constant buffer.
+    const size_t MinConstantRingSize = D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16;
+}
+
+
+volatile LONG EffectConstantRing::Impl::sAttachedCount = 0;
+volatile LONG EffectConstantRing::Impl::sNextGeneration = 0;
+
+
+_Use_decl_annotations_
+EffectConstantRing::Impl::Impl(ID3D11DeviceContext* deviceContext, size_t sizeInBytes)
+  : active(false),
+    generation(InterlockedIncrement(&sNextGeneration)),
+    mDeviceContext(deviceContext),
+    mSize(0),
+    mPosition(0)
+{
+    if (sizeInBytes < MinConstantRingSize || sizeInBytes > UINT32_MAX)
+        throw std::out_of_range("sizeInBytes parameter out of range");
+
+    // Offsets need the 11.1 runtime, and NO_OVERWRITE maps of constant buffers are only allowed where it says so.
+    if (FAILED(mDeviceContext.As(&mDeviceContext1)))
+        return;
+
+    ComPtr<ID3D11Device> device;
+    deviceContext->GetDevice(&device);
+
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+
+    if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)))
+        || !options.ConstantBufferOffsetting
+        || !options.MapNoOverwriteOnDynamicConstantBuffer)
+    {
+        mDeviceContext1.Reset();
+        return;
+    }
+
+    mSize = (sizeInBytes / ConstantRingAlignment) * ConstantRingAlignment;
+
+    D3D11_BUFFER_DESC desc = { 0 };
+
+    desc.ByteWidth = static_cast<UINT>(mSize);
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    ThrowIfFailed(
+        device->CreateBuffer(&desc, nullptr, &mBuffer)
+    );
+
+    SetDebugObjectName(mBuffer.Get(), "DirectXTK:EffectConstantRing");
+
+    // Attach to the context.
+    Impl* self = this;
+
+    UINT size = sizeof(self);
+    Impl* existing = nullptr;
+
+    if (SUCCEEDED(deviceContext->GetPrivateData(ConstantRingPrivateDataGuid, &size, &existing)) && existing)
+        throw std::exception("An EffectConstantRing is already attached to this device context");
+
+    ThrowIfFailed(
+        deviceContext->SetPrivateData(ConstantRingPrivateDataGuid, sizeof(self), &self)
+    );
+
+    InterlockedIncrement(&sAttachedCount);
+
+    active = true;
+}
+
+
+EffectConstantRing::Impl::~Impl()
+{
+    if (active)
+    {
+        mDeviceContext->SetPrivateData(ConstantRingPrivateDataGuid, 0, nullptr);
+
+        InterlockedDecrement(&sAttachedCount);
+    }
+}
+
+
+_Use_decl_annotations_
+EffectConstantRing::Impl* EffectConstantRing::Impl::Find(ID3D11DeviceContext* deviceContext)
+{
+    // Skip the lookup entirely when no ring is in use.
+    if (!sAttachedCount)
+        return nullptr;
+
+    Impl* ring = nullptr;
+    UINT size = sizeof(ring);
+
+    if (FAILED(deviceContext->GetPrivateData(ConstantRingPrivateDataGuid, &size, &ring)) || size != sizeof(ring))
+        return nullptr;
+
+    return ring;
+}
+
+
+_Use_decl_annotations_
+void EffectConstantRing::Impl::Allocate(void const* data, size_t sizeInBytes, UINT* firstConstant, UINT* numConstants)
+{
+    assert(active);
+
+    size_t alignedSize = (sizeInBytes + ConstantRingAlignment - 1) & ~(ConstantRingAlignment - 1);
+
+    // Wrap around to a fresh buffer when full. DISCARD gives us new memory, leaving the GPU reading the old copy.
+    D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+
+    if (mPosition == 0 || mPosition + alignedSize > mSize)
+    {
+        Reset();
+
+        mapType = D3D11_MAP_WRITE_DISCARD;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+    ThrowIfFailed(
+        mDeviceContext->Map(mBuffer.Get(), 0, mapType, 0, &mappedResource)
+    );
+
+    memcpy(static_cast<uint8_t*>(mappedResource.pData) + mPosition, data, sizeInBytes);
+
+    mDeviceContext->Unmap(mBuffer.Get(), 0);
+
+    *firstConstant = static_cast<UINT>(mPosition / 16);
+    *numConstants = static_cast<UINT>(alignedSize / 16);
+
+    mPosition += alignedSize;
+}
+
+
+void EffectConstantRing::Impl::Bind(UINT firstConstant, UINT numConstants)
+{
+    ID3D11Buffer* buffer = mBuffer.Get();
+
+    mDeviceContext1->VSSetConstantBuffers1(0, 1, &buffer, &firstConstant, &numConstants);
+    mDeviceContext1->PSSetConstantBuffers1(0, 1, &buffer, &firstConstant, &numConstants);
+}
+
+
+void EffectConstantRing::Impl::Reset()
+{
+    mPosition = 0;
+
+    generation = InterlockedIncrement(&sNextGeneration);
+}
+
+
+// Public constructor.
+_Use_decl_annotations_
+EffectConstantRing::EffectConstantRing(ID3D11DeviceContext* deviceContext, size_t sizeInBytes)
+  : pImpl(new Impl(deviceContext, sizeInBytes))
+{
+}
+
+
+// Move constructor.
+EffectConstantRing::EffectConstantRing(EffectConstantRing&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+EffectConstantRing& EffectConstantRing::operator= (EffectConstantRing&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+EffectConstantRing::~EffectConstantRing()
+{
+}
+
+
+bool EffectConstantRing::IsActive() const
+{
+    return pImpl->active;
+}
+
+
+void EffectConstantRing::Reset()
+{
+    pImpl->Reset();
+}
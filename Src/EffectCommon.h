@@ -41,6 +41,10 @@ namespace DirectX
         const int FogVector             = 0x20;
         const int FogEnable             = 0x40;
         const int AlphaTest             = 0x80;
+
+        // Set in place of ConstantBuffer for the values derived from the world matrix. Effects that keep these in
+        // a buffer of their own upload it first, and ApplyShaders treats whatever is left like ConstantBuffer.
+        const int ObjectConstantBuffer  = 0x100;
     }
 
 
@@ -130,18 +134,59 @@ namespace DirectX
           : mDevice(device)
         { }
 
-        ID3D11VertexShader* DemandCreateVertexShader(_Inout_ Microsoft::WRL::ComPtr<ID3D11VertexShader>& vertexShader, ShaderBytecode const& bytecode);
-        ID3D11PixelShader * DemandCreatePixelShader (_Inout_ Microsoft::WRL::ComPtr<ID3D11PixelShader> & pixelShader,  ShaderBytecode const& bytecode);
+        ID3D11VertexShader* DemandCreateVertexShader(_Inout_ Microsoft::WRL::ComPtr<ID3D11VertexShader>& vertexShader, ShaderBytecode const& bytecode, int permutation, bool warmUp);
+        ID3D11PixelShader * DemandCreatePixelShader (_Inout_ Microsoft::WRL::ComPtr<ID3D11PixelShader> & pixelShader,  ShaderBytecode const& bytecode, int permutation, bool warmUp);
         ID3D11ShaderResourceView* GetDefaultTexture();
 
+        void GetShaderCreations(std::vector<EffectShaderCreation>& result);
+
     protected:
         Microsoft::WRL::ComPtr<ID3D11Device> mDevice;
         Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mDefaultTexture;
 
+        // Every shader created so far, guarded by mMutex.
+        std::vector<EffectShaderCreation> mShaderCreations;
+
         std::mutex mMutex;
     };
 
 
+    // EffectConstantRing implementation, found through the private data of the device context it is attached to.
+    class EffectConstantRing::Impl
+    {
+    public:
+        Impl(_In_ ID3D11DeviceContext* deviceContext, size_t sizeInBytes);
+        ~Impl();
+
+        // Returns the active ring attached to the device context, if there is one.
+        static Impl* Find(_In_ ID3D11DeviceContext* deviceContext);
+
+        // Copies constants into the ring, returning their location in shader constants (16 bytes each).
+        void Allocate(_In_reads_bytes_(sizeInBytes) void const* data, size_t sizeInBytes, _Out_ UINT* firstConstant, _Out_ UINT* numConstants);
+
+        // Binds a previous allocation to slot 0 of the vertex and pixel shader.
+        void Bind(UINT firstConstant, UINT numConstants);
+
+        void Reset();
+
+        bool active;
+
+        // Changes whenever the ring moves on to a fresh buffer, which invalidates earlier allocations. Unique across all rings.
+        LONG generation;
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext> mDeviceContext;
+        Microsoft::WRL::ComPtr<ID3D11DeviceContext1> mDeviceContext1;
+        Microsoft::WRL::ComPtr<ID3D11Buffer> mBuffer;
+
+        size_t mSize;
+        size_t mPosition;
+
+        static volatile LONG sAttachedCount;
+        static volatile LONG sNextGeneration;
+    };
+
+
     // Templated base class provides functionality common to all the built-in effects.
     template<typename Traits>
     class EffectBase : public AlignedNew<typename Traits::ConstantBufferType>
@@ -151,12 +196,36 @@ namespace DirectX
         EffectBase(_In_ ID3D11Device* device)
           : dirtyFlags(INT_MAX),
             mConstantBuffer(device),
+            mConstantBufferStale(false),
+            mRingGeneration(0),
+            mRingFirstConstant(0),
+            mRingNumConstants(0),
             mDeviceResources(deviceResourcesPool.DemandCreate(device))
         {
             ZeroMemory(&constants, sizeof(constants));
         }
 
 
+        // Copy constructor, used by Clone. Shaders and textures are shared, but the copy has its own constant buffer.
+        EffectBase(EffectBase const& other)
+          : constants(other.constants),
+            matrices(other.matrices),
+            fog(other.fog),
+            texture(other.texture),
+            dirtyFlags(INT_MAX),
+            mConstantBufferStale(false),
+            mRingGeneration(0),
+            mRingFirstConstant(0),
+            mRingNumConstants(0),
+            mDeviceResources(other.mDeviceResources)
+        {
+            Microsoft::WRL::ComPtr<ID3D11Device> device;
+            other.mConstantBuffer.GetBuffer()->GetDevice(&device);
+
+            mConstantBuffer.Create(device.Get());
+        }
+
+
         // Fields.
         typename Traits::ConstantBufferType constants;
 
@@ -191,12 +260,34 @@ namespace DirectX
             deviceContext->VSSetShader(vertexShader, nullptr, 0);
             deviceContext->PSSetShader(pixelShader, nullptr, 0);
 
-            // Make sure the constant buffer is up to date.
-            if (dirtyFlags & EffectDirtyFlags::ConstantBuffer)
+            // Use the shared constant ring, if one is attached to this context.
+            auto ring = EffectConstantRing::Impl::Find(deviceContext);
+
+            if (ring)
+            {
+                // Constants already in the ring can be reused until it moves on to a fresh buffer.
+                if ((dirtyFlags & (EffectDirtyFlags::ConstantBuffer | EffectDirtyFlags::ObjectConstantBuffer)) || ring->generation != mRingGeneration)
+                {
+                    ring->Allocate(&constants, sizeof(constants), &mRingFirstConstant, &mRingNumConstants);
+
+                    mRingGeneration = ring->generation;
+
+                    dirtyFlags &= ~(EffectDirtyFlags::ConstantBuffer | EffectDirtyFlags::ObjectConstantBuffer);
+                    mConstantBufferStale = true;
+                }
+
+                ring->Bind(mRingFirstConstant, mRingNumConstants);
+                return;
+            }
+
+            // Make sure the constant buffer is up to date. Dynamic buffers have undefined contents at the start of each
+            // command list, so deferred contexts always write it.
+            if ((dirtyFlags & (EffectDirtyFlags::ConstantBuffer | EffectDirtyFlags::ObjectConstantBuffer)) || mConstantBufferStale || deviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
             {
                 mConstantBuffer.SetData(deviceContext, constants);
      
-                dirtyFlags &= ~EffectDirtyFlags::ConstantBuffer;
+                dirtyFlags &= ~(EffectDirtyFlags::ConstantBuffer | EffectDirtyFlags::ObjectConstantBuffer);
+                mConstantBufferStale = false;
             }
 
             // Set the constant buffer.
@@ -211,6 +302,36 @@ namespace DirectX
         ID3D11ShaderResourceView* GetDefaultTexture() { return mDeviceResources->GetDefaultTexture(); }
 
 
+        // Creates the shaders for one permutation ahead of first use, or for all of them if permutation is -1.
+        void WarmUpShaders(int permutation)
+        {
+            int first = (permutation < 0) ? 0 : permutation;
+            int last = (permutation < 0) ? Traits::ShaderPermutationCount : (permutation + 1);
+
+            for (int i = first; i < last; i++)
+            {
+                try
+                {
+                    mDeviceResources->GetVertexShader(i, true);
+                    mDeviceResources->GetPixelShader(i, true);
+                }
+                catch (std::exception&)
+                {
+                    // Some permutations need a higher feature level, so skip those when warming up everything.
+                    if (permutation >= 0)
+                        throw;
+                }
+            }
+        }
+
+
+        // Lists the shaders created for this effect type on this device.
+        void GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const
+        {
+            mDeviceResources->GetShaderCreations(stats);
+        }
+
+
     protected:
         // Static arrays hold all the precompiled shader permutations.
         static const ShaderBytecode VertexShaderBytecode[Traits::VertexShaderCount];
@@ -223,6 +344,14 @@ namespace DirectX
         // D3D constant buffer holds a copy of the same data as the public 'constants' field.
         ConstantBuffer<typename Traits::ConstantBufferType> mConstantBuffer;
 
+        // Set when the latest constants went to an EffectConstantRing rather than mConstantBuffer.
+        bool mConstantBufferStale;
+
+        // Where the latest constants are in the ring.
+        LONG mRingGeneration;
+        UINT mRingFirstConstant;
+        UINT mRingNumConstants;
+
         // Only one of these helpers is allocated per D3D device, even if there are multiple effect instances.
         class DeviceResources : protected EffectDeviceResources
         {
@@ -233,23 +362,29 @@ namespace DirectX
 
         
             // Gets or lazily creates the specified vertex shader permutation.
-            ID3D11VertexShader* GetVertexShader(int permutation)
+            ID3D11VertexShader* GetVertexShader(int permutation, bool warmUp = false)
             {
                 int shaderIndex = VertexShaderIndices[permutation];
 
-                return DemandCreateVertexShader(mVertexShaders[shaderIndex], VertexShaderBytecode[shaderIndex]);
+                return DemandCreateVertexShader(mVertexShaders[shaderIndex], VertexShaderBytecode[shaderIndex], permutation, warmUp);
             }
 
 
-            // Gets or lazily creates the specified pixel shader permutation.
-            ID3D11PixelShader* GetPixelShader(int permutation)
+            // Gets or lazily creates the specified pixel shader permutation. Depth only permutations have no pixel shader.
+            ID3D11PixelShader* GetPixelShader(int permutation, bool warmUp = false)
             {
                 int shaderIndex = PixelShaderIndices[permutation];
 
-                return DemandCreatePixelShader(mPixelShaders[shaderIndex], PixelShaderBytecode[shaderIndex]);
+                if (!PixelShaderBytecode[shaderIndex].code)
+                    return nullptr;
+
+                return DemandCreatePixelShader(mPixelShaders[shaderIndex], PixelShaderBytecode[shaderIndex], permutation, warmUp);
             }
 
 
+            void GetShaderCreations(std::vector<EffectShaderCreation>& result) { EffectDeviceResources::GetShaderCreations(result); }
+
+
             // Gets or lazily creates the default texture
             ID3D11ShaderResourceView* GetDefaultTexture() { return EffectDeviceResources::GetDefaultTexture(); }
 
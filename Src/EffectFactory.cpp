@@ -15,8 +15,11 @@
 #include "Effects.h"
 #include "DemandCreate.h"
 #include "SharedResourcePool.h"
+#include "FactoryCache.h"
+#include "ScopedInstrumentationEvent.h"
 
 #include "DDSTextureLoader.h"
+#include "TextureCache.h"
 
 #if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
 #include "WICTextureLoader.h"
@@ -32,7 +35,12 @@ class EffectFactory::Impl
 {
 public:
     Impl(_In_ ID3D11Device* device)
-      : device(device), mSharing(true)
+      : device(device),
+        mEffectCache(false),
+        mEffectCacheSkinning(false),
+        mTextureCache(true),
+        mSharedTextures(device),
+        mSharing(true)
     { *mPath = 0; }
 
     std::shared_ptr<IEffect> CreateEffect( _In_ IEffectFactory* factory, _In_ const IEffectFactory::EffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext );
@@ -46,15 +54,22 @@ public:
     WCHAR mPath[MAX_PATH];
 
 private:
+    std::shared_ptr<IEffect> CreateSkinnedEffect( _In_ IEffectFactory* factory, _In_ const IEffectFactory::EffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext );
+    std::shared_ptr<IEffect> CreateBasicEffect( _In_ IEffectFactory* factory, _In_ const IEffectFactory::EffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext );
+    void LoadTexture( _In_z_ const WCHAR* name, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView );
+
     ComPtr<ID3D11Device> device;
 
-    typedef std::map< std::wstring, std::shared_ptr<IEffect> > EffectCache;
-    typedef std::map< std::wstring, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> > TextureCache;
+    typedef FactoryCache< std::shared_ptr<IEffect> > EffectCache;
+    typedef FactoryCache< Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> > TextureCache;
 
     EffectCache  mEffectCache;
     EffectCache  mEffectCacheSkinning;
     TextureCache mTextureCache;
 
+    // Loads shared with everything else using a TextureCache on this device.
+    DirectX::TextureCache mSharedTextures;
+
     bool mSharing;
 
     std::mutex mutex;
@@ -73,122 +88,120 @@ std::shared_ptr<IEffect> EffectFactory::Impl::CreateEffect( IEffectFactory* fact
         // SkinnedEffect
         if ( mSharing && info.name && *info.name )
         {
-            auto it = mEffectCacheSkinning.find( info.name );
-            if ( mSharing && it != mEffectCacheSkinning.end() )
+            return mEffectCacheSkinning.GetOrCreate( info.name, [&]() -> std::shared_ptr<IEffect>
             {
-                return it->second;
-            }
+                return CreateSkinnedEffect( factory, info, deviceContext );
+            });
         }
 
-        std::shared_ptr<SkinnedEffect> effect = std::make_shared<SkinnedEffect>( device.Get() );
-
-        effect->EnableDefaultLighting();
-
-        effect->SetAlpha( info.alpha );
-
-        // Skinned Effect does not have an ambient material color, or per-vertex color support
-
-        XMVECTOR color = XMLoadFloat3( &info.diffuseColor );
-        effect->SetDiffuseColor( color );
-
-        if ( info.specularColor.x != 0 || info.specularColor.y != 0 || info.specularColor.z != 0 )
-        {
-            color = XMLoadFloat3( &info.specularColor );
-            effect->SetSpecularColor( color );
-            effect->SetSpecularPower( info.specularPower );
-        }
-        else
+        return CreateSkinnedEffect( factory, info, deviceContext );
+    }
+    else
+    {
+        // BasicEffect
+        if ( mSharing && info.name && *info.name )
         {
-            effect->DisableSpecular();
+            return mEffectCache.GetOrCreate( info.name, [&]() -> std::shared_ptr<IEffect>
+            {
+                return CreateBasicEffect( factory, info, deviceContext );
+            });
         }
 
-        if ( info.emissiveColor.x != 0 || info.emissiveColor.y != 0 || info.emissiveColor.z != 0 )
-        {
-            color = XMLoadFloat3( &info.emissiveColor );
-            effect->SetEmissiveColor( color );
-        }
+        return CreateBasicEffect( factory, info, deviceContext );
+    }
+}
 
-        if ( info.texture && *info.texture )
-        {
-            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+_Use_decl_annotations_
+std::shared_ptr<IEffect> EffectFactory::Impl::CreateSkinnedEffect( IEffectFactory* factory, const IEffectFactory::EffectInfo& info, ID3D11DeviceContext* deviceContext )
+{
+    std::shared_ptr<SkinnedEffect> effect = std::make_shared<SkinnedEffect>( device.Get() );
 
-            factory->CreateTexture( info.texture, deviceContext, &srv );
+    effect->EnableDefaultLighting();
 
-            effect->SetTexture( srv.Get() );
-        }
+    effect->SetAlpha( info.alpha );
 
-        if ( mSharing && info.name && *info.name )
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            mEffectCacheSkinning.insert( EffectCache::value_type( info.name, effect) );
-        }
+    // Skinned Effect does not have an ambient material color, or per-vertex color support
 
-        return effect;
+    XMVECTOR color = XMLoadFloat3( &info.diffuseColor );
+    effect->SetDiffuseColor( color );
+
+    if ( info.specularColor.x != 0 || info.specularColor.y != 0 || info.specularColor.z != 0 )
+    {
+        color = XMLoadFloat3( &info.specularColor );
+        effect->SetSpecularColor( color );
+        effect->SetSpecularPower( info.specularPower );
     }
     else
     {
-        // BasicEffect
-        if ( mSharing && info.name && *info.name )
-        {
-            auto it = mEffectCache.find( info.name );
-            if ( mSharing && it != mEffectCache.end() )
-            {
-                return it->second;
-            }
-        }
+        effect->DisableSpecular();
+    }
 
-        std::shared_ptr<BasicEffect> effect = std::make_shared<BasicEffect>( device.Get() );
+    if ( info.emissiveColor.x != 0 || info.emissiveColor.y != 0 || info.emissiveColor.z != 0 )
+    {
+        color = XMLoadFloat3( &info.emissiveColor );
+        effect->SetEmissiveColor( color );
+    }
 
-        effect->EnableDefaultLighting();
-        effect->SetLightingEnabled(true);
+    if ( info.texture && *info.texture )
+    {
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
 
-        effect->SetAlpha( info.alpha );
+        factory->CreateTexture( info.texture, deviceContext, &srv );
 
-        if ( info.perVertexColor )
-        {
-            effect->SetVertexColorEnabled( true );
-        }
+        effect->SetTexture( srv.Get() );
+    }
+
+    return effect;
+}
 
-        // Basic Effect does not have an ambient material color
+_Use_decl_annotations_
+std::shared_ptr<IEffect> EffectFactory::Impl::CreateBasicEffect( IEffectFactory* factory, const IEffectFactory::EffectInfo& info, ID3D11DeviceContext* deviceContext )
+{
+    std::shared_ptr<BasicEffect> effect = std::make_shared<BasicEffect>( device.Get() );
 
-        XMVECTOR color = XMLoadFloat3( &info.diffuseColor );
-        effect->SetDiffuseColor( color );
+    effect->EnableDefaultLighting();
+    effect->SetLightingEnabled(true);
 
-        if ( info.specularColor.x != 0 || info.specularColor.y != 0 || info.specularColor.z != 0 )
-        {
-            color = XMLoadFloat3( &info.specularColor );
-            effect->SetSpecularColor( color );
-            effect->SetSpecularPower( info.specularPower );
-        }
-        else
-        {
-            effect->DisableSpecular();
-        }
+    effect->SetAlpha( info.alpha );
 
-        if ( info.emissiveColor.x != 0 || info.emissiveColor.y != 0 || info.emissiveColor.z != 0 )
-        {
-            color = XMLoadFloat3( &info.emissiveColor );
-            effect->SetEmissiveColor( color );
-        }
+    if ( info.perVertexColor )
+    {
+        effect->SetVertexColorEnabled( true );
+    }
 
-        if ( info.texture && *info.texture )
-        {
-            Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+    // Basic Effect does not have an ambient material color
 
-            factory->CreateTexture( info.texture, deviceContext, &srv );
+    XMVECTOR color = XMLoadFloat3( &info.diffuseColor );
+    effect->SetDiffuseColor( color );
 
-            effect->SetTexture( srv.Get() );
-            effect->SetTextureEnabled( true );
-        }
+    if ( info.specularColor.x != 0 || info.specularColor.y != 0 || info.specularColor.z != 0 )
+    {
+        color = XMLoadFloat3( &info.specularColor );
+        effect->SetSpecularColor( color );
+        effect->SetSpecularPower( info.specularPower );
+    }
+    else
+    {
+        effect->DisableSpecular();
+    }
 
-        if ( mSharing && info.name && *info.name )
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            mEffectCache.insert( EffectCache::value_type( info.name, effect) );
-        }
+    if ( info.emissiveColor.x != 0 || info.emissiveColor.y != 0 || info.emissiveColor.z != 0 )
+    {
+        color = XMLoadFloat3( &info.emissiveColor );
+        effect->SetEmissiveColor( color );
+    }
+
+    if ( info.texture && *info.texture )
+    {
+        Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+
+        factory->CreateTexture( info.texture, deviceContext, &srv );
 
-        return effect;
+        effect->SetTexture( srv.Get() );
+        effect->SetTextureEnabled( true );
     }
+
+    return effect;
 }
 
 _Use_decl_annotations_
@@ -197,24 +210,40 @@ void EffectFactory::Impl::CreateTexture( const WCHAR* name, ID3D11DeviceContext*
     if ( !name || !textureView )
         throw std::exception("invalid arguments");
 
+    if ( mSharing && *name )
+    {
+        auto srv = mTextureCache.GetOrCreate( name, [&]() -> ComPtr<ID3D11ShaderResourceView>
+        {
+            ComPtr<ID3D11ShaderResourceView> result;
+            LoadTexture( name, deviceContext, &result );
+            return result;
+        });
+
+        *textureView = srv.Detach();
+    }
+    else
+    {
+        LoadTexture( name, deviceContext, textureView );
+    }
+}
+
+_Use_decl_annotations_
+void EffectFactory::Impl::LoadTexture( const WCHAR* name, ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView** textureView )
+{
 #if defined(_XBOX_ONE) && defined(_TITLE)
     UNREFERENCED_PARAMETER(deviceContext);
 #endif
 
-    auto it = mTextureCache.find( name );
+    WCHAR fullName[MAX_PATH]={0};
+    wcscpy_s( fullName, mPath );
+    wcscat_s( fullName, name );
 
-    if ( mSharing && it != mTextureCache.end() )
+    if ( mSharing )
     {
-        ID3D11ShaderResourceView* srv = it->second.Get();
-        srv->AddRef();
-        *textureView = srv;
+        mSharedTextures.CreateTexture( fullName, deviceContext, textureView );
     }
     else
     {
-        WCHAR fullName[MAX_PATH]={0};
-        wcscpy_s( fullName, mPath );
-        wcscat_s( fullName, name );
-
 #if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
         WCHAR ext[_MAX_EXT];
         _wsplitpath_s( name, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT );
@@ -258,21 +287,14 @@ void EffectFactory::Impl::CreateTexture( const WCHAR* name, ID3D11DeviceContext*
             throw std::exception( "CreateDDSTextureFromFile" );
         }
 #endif
-
-        if ( mSharing && *name && it == mTextureCache.end() )
-        {   
-            std::lock_guard<std::mutex> lock(mutex);
-            mTextureCache.insert( TextureCache::value_type( name, *textureView ) );
-        }
     }
 }
 
 void EffectFactory::Impl::ReleaseCache()
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    mEffectCache.clear();
-    mEffectCacheSkinning.clear();
-    mTextureCache.clear();
+    mEffectCache.Clear();
+    mEffectCacheSkinning.Clear();
+    mTextureCache.Clear();
 }
 
 
@@ -305,6 +327,8 @@ EffectFactory& EffectFactory::operator= (EffectFactory&& moveFrom)
 _Use_decl_annotations_
 std::shared_ptr<IEffect> EffectFactory::CreateEffect( const EffectInfo& info, ID3D11DeviceContext* deviceContext )
 {
+    ScopedInstrumentationEvent event( InstrumentationCategory_EffectFactory, L"EffectFactory::CreateEffect", info.name );
+
     return pImpl->CreateEffect( this, info, deviceContext );
 }
 
@@ -24,7 +24,8 @@ struct EnvironmentMapEffectConstants
     XMVECTOR environmentMapSpecular;
     float environmentMapAmount;
     float fresnelFactor;
-    float pad[2];
+    float environmentMapLod;
+    float pad;
 
     XMVECTOR diffuseColor;
     XMVECTOR emissiveColor;
@@ -68,9 +69,13 @@ public:
     EffectLights lights;
 
     ComPtr<ID3D11ShaderResourceView> environmentMap;
+    UINT environmentMapMipLevels;
+    float environmentMapRoughness;
 
     int GetCurrentShaderPermutation() const;
 
+    void SetEnvironmentMapLod();
+
     void Apply(_In_ ID3D11DeviceContext* deviceContext);
 };
 
@@ -173,7 +178,9 @@ SharedResourcePool<ID3D11Device*, EffectBase<EnvironmentMapEffectTraits>::Device
 EnvironmentMapEffect::Impl::Impl(_In_ ID3D11Device* device)
   : EffectBase(device),
     fresnelEnabled(true),
-    specularEnabled(false)
+    specularEnabled(false),
+    environmentMapMipLevels(1),
+    environmentMapRoughness(0)
 {
     static_assert( _countof(EffectBase<EnvironmentMapEffectTraits>::VertexShaderIndices) == EnvironmentMapEffectTraits::ShaderPermutationCount, "array/max mismatch" );
     static_assert( _countof(EffectBase<EnvironmentMapEffectTraits>::VertexShaderBytecode) == EnvironmentMapEffectTraits::VertexShaderCount, "array/max mismatch" );
@@ -220,6 +227,15 @@ int EnvironmentMapEffect::Impl::GetCurrentShaderPermutation() const
 }
 
 
+// Roughness spans the whole mip chain, so the same value works for any size of cubemap.
+void EnvironmentMapEffect::Impl::SetEnvironmentMapLod()
+{
+    constants.environmentMapLod = environmentMapRoughness * static_cast<float>(environmentMapMipLevels - 1);
+
+    dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
+}
+
+
 // Sets our state onto the D3D device.
 void EnvironmentMapEffect::Impl::Apply(_In_ ID3D11DeviceContext* deviceContext)
 {
@@ -266,6 +282,13 @@ EnvironmentMapEffect& EnvironmentMapEffect::operator= (EnvironmentMapEffect&& mo
 }
 
 
+// Private constructor, used by Clone.
+EnvironmentMapEffect::EnvironmentMapEffect(std::unique_ptr<Impl>&& impl)
+  : pImpl(std::move(impl))
+{
+}
+
+
 // Public destructor.
 EnvironmentMapEffect::~EnvironmentMapEffect()
 {
@@ -284,6 +307,26 @@ void EnvironmentMapEffect::GetVertexShaderBytecode(_Out_ void const** pShaderByt
 }
 
 
+std::shared_ptr<IEffect> EnvironmentMapEffect::Clone() const
+{
+    std::unique_ptr<Impl> impl(new Impl(*pImpl));
+
+    return std::shared_ptr<IEffect>(new EnvironmentMapEffect(std::move(impl)));
+}
+
+
+void EnvironmentMapEffect::WarmUpShaders(bool allPermutations)
+{
+    pImpl->WarmUpShaders(allPermutations ? -1 : pImpl->GetCurrentShaderPermutation());
+}
+
+
+void EnvironmentMapEffect::GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const
+{
+    pImpl->GetShaderCreationStats(stats);
+}
+
+
 void XM_CALLCONV EnvironmentMapEffect::SetWorld(FXMMATRIX value)
 {
     pImpl->matrices.world = value;
@@ -432,6 +475,49 @@ void EnvironmentMapEffect::SetTexture(_In_opt_ ID3D11ShaderResourceView* value)
 void EnvironmentMapEffect::SetEnvironmentMap(_In_opt_ ID3D11ShaderResourceView* value)
 {
     pImpl->environmentMap = value;
+
+    // Remember how many mips the view has, for SetEnvironmentMapRoughness.
+    UINT mipLevels = 1;
+
+    if (value)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
+        value->GetDesc(&viewDesc);
+
+        if (viewDesc.ViewDimension == D3D11_SRV_DIMENSION_TEXTURECUBE)
+        {
+            mipLevels = viewDesc.TextureCube.MipLevels;
+
+            // -1 means every mip from MostDetailedMip down.
+            if (mipLevels == UINT(-1))
+            {
+                ComPtr<ID3D11Resource> resource;
+                value->GetResource(&resource);
+
+                ComPtr<ID3D11Texture2D> texture;
+                if (SUCCEEDED(resource.As(&texture)))
+                {
+                    D3D11_TEXTURE2D_DESC textureDesc;
+                    texture->GetDesc(&textureDesc);
+
+                    mipLevels = textureDesc.MipLevels - viewDesc.TextureCube.MostDetailedMip;
+                }
+                else
+                {
+                    mipLevels = 1;
+                }
+            }
+        }
+    }
+
+    if (!mipLevels)
+        mipLevels = 1;
+
+    if (mipLevels != pImpl->environmentMapMipLevels)
+    {
+        pImpl->environmentMapMipLevels = mipLevels;
+        pImpl->SetEnvironmentMapLod();
+    }
 }
 
 
@@ -461,3 +547,11 @@ void EnvironmentMapEffect::SetFresnelFactor(float value)
 
     pImpl->dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
 }
+
+
+void EnvironmentMapEffect::SetEnvironmentMapRoughness(float value)
+{
+    pImpl->environmentMapRoughness = std::min(std::max(value, 0.f), 1.f);
+
+    pImpl->SetEnvironmentMapLod();
+}
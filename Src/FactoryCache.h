@@ -0,0 +1,373 @@
+//--------------------------------------------------------------------------------------
+// File: FactoryCache.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "PlatformHelpers.h"
+
+#include <string>
+#include <vector>
+
+
+namespace DirectX
+{
+    // Name keyed cache used by the effect factories. Lookups of entries that already exist take no lock: the table is
+    // a fixed array of singly linked chains that are only ever pushed onto, so readers can walk them while a writer
+    // adds to the front. Clear swaps in an empty table and frees the old one once every reader that might still be
+    // walking it has left, which is tracked by a pair of reader counts flipped on each clear.
+    //
+    // Names are hashed once per lookup. Caches of file paths fold them to lower case with forward slashes turned into
+    // backslashes, while other names must match exactly. Each name is only created once: the first thread to miss
+    // inserts a pending entry and runs the create function, while any other thread asking for the same name waits for
+    // it to finish rather than creating a duplicate. If that creation fails, its entry is unlinked so the next lookup
+    // tries again.
+    template<typename T>
+    class FactoryCache
+    {
+    public:
+        explicit FactoryCache(bool foldPaths)
+          : mTable(new Table()),
+            mEpoch(0),
+            mFoldPaths(foldPaths)
+        {
+            mReaders[0] = 0;
+            mReaders[1] = 0;
+        }
+
+        ~FactoryCache()
+        {
+            delete mTable;
+        }
+
+
+        // Returns the entry for name, calling T createFunc() to make it on a miss.
+        template<typename TCreateFunc>
+        T GetOrCreate(_In_z_ const wchar_t* name, TCreateFunc createFunc)
+        {
+            std::wstring key;
+            size_t hash = MakeKey(name, key);
+
+            for (;;)
+            {
+                ReadGuard guard(*this);
+
+                Node* node = Find(mTable, hash, key);
+
+                if (!node)
+                {
+                    bool inserted = false;
+                    Table* table;
+
+                    {
+                        std::lock_guard<std::mutex> lock(mMutex);
+
+                        // Check again now we hold the lock, in case another thread got in first.
+                        table = mTable;
+
+                        node = Find(table, hash, key);
+
+                        if (!node)
+                        {
+                            node = Insert(table, hash, key);
+                            inserted = true;
+                        }
+                    }
+
+                    if (inserted)
+                    {
+                        return Create(table, node, createFunc);
+                    }
+                }
+
+                if (node->state == State_Pending)
+                {
+                    WaitForSingleObjectEx(node->readyEvent.get(), INFINITE, FALSE);
+                }
+
+                MemoryBarrier();
+
+                if (node->state == State_Ready)
+                {
+                    return node->value;
+                }
+
+                // The thread creating this entry failed, so go round again and try to create it ourselves.
+            }
+        }
+
+
+        // Drops every entry. Waits for any lookups or creations that are still using the old entries.
+        void Clear()
+        {
+            std::lock_guard<std::mutex> syncLock(mSyncMutex);
+
+            Table* oldTable;
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                oldTable = mTable;
+
+                Table* newTable = new Table();
+
+                MemoryBarrier();
+
+                mTable = newTable;
+            }
+
+            // Readers from now on go to the other count, so this one can only fall.
+            LONG oldEpoch = InterlockedIncrement(&mEpoch) - 1;
+
+            while (mReaders[oldEpoch & 1] != 0)
+            {
+                SwitchToThread();
+            }
+
+            delete oldTable;
+        }
+
+
+    private:
+        static const size_t BucketCount = 1024;
+
+        enum State
+        {
+            State_Pending,
+            State_Ready,
+            State_Failed,
+        };
+
+
+        struct Node
+        {
+            Node(size_t hash, std::wstring const& key)
+              : next(nullptr),
+                hash(hash),
+                key(key),
+                state(State_Pending)
+            { }
+
+            Node* volatile next;
+            size_t hash;
+            std::wstring key;
+            T value;
+            volatile LONG state;
+            ScopedHandle readyEvent;
+        };
+
+
+        struct Table
+        {
+            Table()
+            {
+                memset(const_cast<Node**>(buckets), 0, sizeof(buckets));
+            }
+
+            ~Table()
+            {
+                for (size_t i = 0; i < BucketCount; i++)
+                {
+                    Node* node = buckets[i];
+
+                    while (node)
+                    {
+                        Node* next = node->next;
+                        delete node;
+                        node = next;
+                    }
+                }
+
+                for (auto it = retired.begin(); it != retired.end(); ++it)
+                {
+                    delete *it;
+                }
+            }
+
+            Node* volatile buckets[BucketCount];
+
+            // Failed entries unlinked from their bucket. Readers may still be looking at them, so they are only
+            // freed along with the table, once no reader can be left.
+            std::vector<Node*> retired;
+        };
+
+
+        // Holds off Clear from freeing the table while we look at it. If the epoch flips between reading it and
+        // registering, back out and retry, so a reader is always counted against the epoch it saw the table in.
+        class ReadGuard
+        {
+        public:
+            explicit ReadGuard(FactoryCache& cache)
+              : mReaders(nullptr)
+            {
+                for (;;)
+                {
+                    LONG epoch = cache.mEpoch;
+
+                    mReaders = &cache.mReaders[epoch & 1];
+
+                    InterlockedIncrement(mReaders);
+
+                    if (cache.mEpoch == epoch)
+                        break;
+
+                    InterlockedDecrement(mReaders);
+                }
+            }
+
+            ~ReadGuard()
+            {
+                InterlockedDecrement(mReaders);
+            }
+
+        private:
+            volatile LONG* mReaders;
+
+            ReadGuard(ReadGuard const&) DIRECTX_CTOR_DELETE
+            ReadGuard& operator= (ReadGuard const&) DIRECTX_CTOR_DELETE
+        };
+
+
+        size_t MakeKey(_In_z_ const wchar_t* name, std::wstring& key) const
+        {
+            key = name;
+
+            // FNV-1a.
+            size_t hash = 2166136261U;
+
+            for (auto it = key.begin(); it != key.end(); ++it)
+            {
+                if (mFoldPaths)
+                {
+                    *it = (*it == L'/') ? L'\\' : towlower(*it);
+                }
+
+                hash = (hash ^ static_cast<size_t>(*it)) * 16777619U;
+            }
+
+            return hash;
+        }
+
+
+        static Node* Find(_In_ Table* table, size_t hash, std::wstring const& key)
+        {
+            Node* node = table->buckets[hash % BucketCount];
+
+            MemoryBarrier();
+
+            while (node)
+            {
+                if (node->hash == hash && node->key == key)
+                    return node;
+
+                node = node->next;
+
+                MemoryBarrier();
+            }
+
+            return nullptr;
+        }
+
+
+        // Called with mMutex held. The node is fully built before it is linked in, so readers never see it half done.
+        static Node* Insert(_In_ Table* table, size_t hash, std::wstring const& key)
+        {
+            std::unique_ptr<Node> node(new Node(hash, key));
+
+            #if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+                node->readyEvent.reset(CreateEventEx(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE));
+            #else
+                node->readyEvent.reset(CreateEvent(nullptr, TRUE, FALSE, nullptr));
+            #endif
+
+            if (!node->readyEvent)
+                throw std::exception("CreateEvent");
+
+            auto& bucket = table->buckets[hash % BucketCount];
+
+            node->next = bucket;
+
+            MemoryBarrier();
+
+            bucket = node.get();
+
+            return node.release();
+        }
+
+
+        // Called with mMutex held. Takes a failed node out of its bucket, leaving its own next pointer alone so any
+        // reader that is standing on it can still walk past. Clear cannot free the table meanwhile, as the creating
+        // thread's ReadGuard is still held.
+        static void Unlink(_In_ Table* table, _In_ Node* node)
+        {
+            // Make room first, so the node is never left unlinked but not retired.
+            table->retired.reserve(table->retired.size() + 1);
+
+            Node* volatile* link = &table->buckets[node->hash % BucketCount];
+
+            while (*link != node)
+            {
+                assert(*link != nullptr);
+                link = &(*link)->next;
+            }
+
+            *link = node->next;
+
+            table->retired.push_back(node);
+        }
+
+
+        // Runs outside mMutex so creations of different names can overlap, and so createFunc may use other caches.
+        template<typename TCreateFunc>
+        T Create(_In_ Table* table, _In_ Node* node, TCreateFunc& createFunc)
+        {
+            try
+            {
+                node->value = createFunc();
+            }
+            catch (...)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+
+                    Unlink(table, node);
+                }
+
+                InterlockedExchange(&node->state, State_Failed);
+                SetEvent(node->readyEvent.get());
+                throw;
+            }
+
+            InterlockedExchange(&node->state, State_Ready);
+            SetEvent(node->readyEvent.get());
+
+            return node->value;
+        }
+
+
+        Table* volatile mTable;
+
+        volatile LONG mEpoch;
+        volatile LONG mReaders[2];
+
+        bool mFoldPaths;
+
+        // Serializes inserts. Clear also takes mSyncMutex so only one clear at a time waits on the reader counts.
+        std::mutex mMutex;
+        std::mutex mSyncMutex;
+
+
+        // Prevent copying.
+        FactoryCache(FactoryCache const&) DIRECTX_CTOR_DELETE
+        FactoryCache& operator= (FactoryCache const&) DIRECTX_CTOR_DELETE
+    };
+}
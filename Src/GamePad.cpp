@@ -130,6 +130,26 @@ public:
     {
     }
 
+    bool StartPolling( unsigned int, ConnectionCallback&, ButtonCallback& )
+    {
+        // This API already reports gamepads without blocking, so there is nothing to move to another thread.
+        return false;
+    }
+
+    void StopPolling()
+    {
+    }
+
+    bool IsPolling() const
+    {
+        return false;
+    }
+
+    size_t GetStateHistory( int, Sample*, size_t, DeadZone )
+    {
+        return 0;
+    }
+
 private:
     static GamePad::Impl* s_gamePad;
 };
@@ -389,6 +409,26 @@ public:
         SetEvent( s_changed );
     }
 
+    bool StartPolling( unsigned int, ConnectionCallback&, ButtonCallback& )
+    {
+        // This API already reports gamepads without blocking, so there is nothing to move to another thread.
+        return false;
+    }
+
+    void StopPolling()
+    {
+    }
+
+    bool IsPolling() const
+    {
+        return false;
+    }
+
+    size_t GetStateHistory( int, Sample*, size_t, DeadZone )
+    {
+        return 0;
+    }
+
 private:
     void ScanGamePads()
     {
@@ -544,6 +584,26 @@ public:
     {
     }
 
+    bool StartPolling( unsigned int, ConnectionCallback&, ButtonCallback& )
+    {
+        // This API already reports gamepads without blocking, so there is nothing to move to another thread.
+        return false;
+    }
+
+    void StopPolling()
+    {
+    }
+
+    bool IsPolling() const
+    {
+        return false;
+    }
+
+    size_t GetStateHistory( int, Sample*, size_t, DeadZone )
+    {
+        return 0;
+    }
+
 private:
     static GamePad::Impl* s_gamePad;
 };
@@ -559,12 +619,24 @@ GamePad::Impl* GamePad::Impl::s_gamePad = nullptr;
 
 #include <xinput.h>
 
+#if !defined(_MSC_VER) || (_MSC_VER >= 1700)
+#include <thread>
+#endif
+
 static_assert( GamePad::MAX_PLAYER_COUNT == XUSER_MAX_COUNT, "xinput.h mismatch" );
+static_assert( ( GamePad::HISTORY_SIZE & ( GamePad::HISTORY_SIZE - 1 ) ) == 0, "History ring must be a power of 2" );
 
 class GamePad::Impl
 {
 public:
-    Impl()
+    Impl() :
+        mPolling( false ),
+        mPollInterval( 0 ),
+        mThreadQuit( nullptr ),
+        mFirstSample( nullptr )
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+        , mThread( nullptr )
+#endif
     {
         for( int j = 0; j < XUSER_MAX_COUNT; ++j )
         {
@@ -575,6 +647,9 @@ public:
         mSuspended = false;
 #endif
 
+        memset( mSnapshots, 0, sizeof(mSnapshots) );
+        memset( (void*)mSequence, 0, sizeof(mSequence) );
+
         if ( s_gamePad )
         {
             throw std::exception( "GamePad is a singleton" );
@@ -585,11 +660,19 @@ public:
 
     ~Impl()
     {
+        StopPolling();
+
         s_gamePad = nullptr;
     }
 
     void GetState( int player, _Out_ State& state, DeadZone deadZoneMode )
     {
+        if ( mPolling )
+        {
+            GetPolledState( player, state, deadZoneMode );
+            return;
+        }
+
         if ( !ThrottleRetry(player) )
         {
 #if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
@@ -611,45 +694,7 @@ public:
             {
                 mConnected[ player ] = true;
 
-                state.connected = true;
-                state.packet = xstate.dwPacketNumber;
-
-                WORD xbuttons = xstate.Gamepad.wButtons;
-                state.buttons.a = (xbuttons & XINPUT_GAMEPAD_A) != 0;
-                state.buttons.b = (xbuttons & XINPUT_GAMEPAD_B) != 0;
-                state.buttons.x = (xbuttons & XINPUT_GAMEPAD_X) != 0;
-                state.buttons.y = (xbuttons & XINPUT_GAMEPAD_Y) != 0;
-                state.buttons.leftStick = (xbuttons & XINPUT_GAMEPAD_LEFT_THUMB) != 0;
-                state.buttons.rightStick = (xbuttons & XINPUT_GAMEPAD_RIGHT_THUMB) != 0;
-                state.buttons.leftShoulder = (xbuttons & XINPUT_GAMEPAD_LEFT_SHOULDER) != 0;
-                state.buttons.rightShoulder = (xbuttons & XINPUT_GAMEPAD_RIGHT_SHOULDER) != 0;
-                state.buttons.back = (xbuttons & XINPUT_GAMEPAD_BACK) != 0;
-                state.buttons.start = (xbuttons & XINPUT_GAMEPAD_START) != 0;
-
-                state.dpad.up = (xbuttons & XINPUT_GAMEPAD_DPAD_UP) != 0;
-                state.dpad.down = (xbuttons & XINPUT_GAMEPAD_DPAD_DOWN) != 0;
-                state.dpad.right = (xbuttons & XINPUT_GAMEPAD_DPAD_RIGHT) != 0;
-                state.dpad.left = (xbuttons & XINPUT_GAMEPAD_DPAD_LEFT) != 0;
-
-                if ( deadZoneMode == DEAD_ZONE_NONE )
-                {
-                    state.triggers.left = ApplyLinearDeadZone( float(xstate.Gamepad.bLeftTrigger), 255.f, 0.f );
-                    state.triggers.right = ApplyLinearDeadZone( float(xstate.Gamepad.bRightTrigger), 255.f, 0.f );
-                }
-                else
-                {
-                    state.triggers.left = ApplyLinearDeadZone( float(xstate.Gamepad.bLeftTrigger), 255.f, float(XINPUT_GAMEPAD_TRIGGER_THRESHOLD) );
-                    state.triggers.right = ApplyLinearDeadZone( float(xstate.Gamepad.bRightTrigger), 255.f, float(XINPUT_GAMEPAD_TRIGGER_THRESHOLD) );
-                }
-            
-                ApplyStickDeadZone( float(xstate.Gamepad.sThumbLX), float(xstate.Gamepad.sThumbLY),
-                                    deadZoneMode, 32767.f, float(XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE),
-                                    state.thumbSticks.leftX, state.thumbSticks.leftY );
-
-                ApplyStickDeadZone( float(xstate.Gamepad.sThumbRX), float(xstate.Gamepad.sThumbRY),
-                                    deadZoneMode, 32767.f, float(XINPUT_GAMEPAD_RIGHT_THUMB_DEADZONE),
-                                    state.thumbSticks.rightX, state.thumbSticks.rightY );
-
+                ConvertState( xstate, deadZoneMode, state );
                 return;
             }
         }
@@ -659,17 +704,17 @@ public:
 
     void GetCapabilities( int player, _Out_ Capabilities& caps )
     {
-        if ( !ThrottleRetry(player) )
+        if ( CanRead(player) )
         {
             XINPUT_CAPABILITIES xcaps;
             DWORD result = XInputGetCapabilities( DWORD(player), 0, &xcaps );
             if ( result == ERROR_DEVICE_NOT_CONNECTED )
             {
-                ClearSlot( player, GetTickCount64() );
+                MarkDisconnected( player );
             }
             else
             {
-                mConnected[ player ] = true;
+                MarkConnected( player );
 
                 caps.connected = true;
                 caps.id = uint64_t( player );
@@ -700,7 +745,7 @@ public:
 
     bool SetVibration( int player, float leftMotor, float rightMotor, float leftTrigger, float rightTrigger )
     {
-        if ( ThrottleRetry(player) )
+        if ( !CanRead(player) )
         {
             return false;
         }
@@ -715,7 +760,7 @@ public:
         mRightMotor[ player ] = rightMotor;
 
         if ( mSuspended )
-            return mConnected[ player ];
+            return IsConnected( player );
 #endif
 
         XINPUT_VIBRATION xvibration;
@@ -724,12 +769,12 @@ public:
         DWORD result = XInputSetState( DWORD(player), &xvibration );
         if ( result == ERROR_DEVICE_NOT_CONNECTED )
         {
-            ClearSlot( player, GetTickCount64() );
+            MarkDisconnected( player );
             return false;
         }
         else
         {
-            mConnected[ player ] = true;
+            MarkConnected( player );
             return (result == ERROR_SUCCESS);
         }
     }
@@ -742,9 +787,9 @@ public:
         // For XInput 9.1.0, we have to emulate the behavior of XInputEnable( FALSE )
         if ( !mSuspended )
         {
-            for( size_t j = 0; j < XUSER_MAX_COUNT; ++j )
+            for( int j = 0; j < XUSER_MAX_COUNT; ++j )
             {
-                if ( mConnected[ j ] )
+                if ( IsConnected( j ) )
                 {
                     XINPUT_VIBRATION xvibration;
                     xvibration.wLeftMotorSpeed = xvibration.wRightMotorSpeed = 0;
@@ -767,7 +812,7 @@ public:
         {
             for( int j = 0; j < XUSER_MAX_COUNT; ++j )
             {
-                if ( mConnected[ j ] )
+                if ( IsConnected( j ) )
                 {
                     XINPUT_VIBRATION xvibration;
                     xvibration.wLeftMotorSpeed = WORD( mLeftMotor[ j ] * 0xFFFF );
@@ -775,7 +820,7 @@ public:
                     DWORD result = XInputSetState( DWORD(j), &xvibration );
                     if ( result == ERROR_DEVICE_NOT_CONNECTED )
                     {
-                        ClearSlot( j, GetTickCount64() );
+                        MarkDisconnected( j );
                     }
                 }
             }
@@ -785,6 +830,151 @@ public:
 #endif
     }
 
+    bool StartPolling( unsigned int samplesPerSecond, ConnectionCallback& onConnection, ButtonCallback& onButtons )
+    {
+        if ( !samplesPerSecond || samplesPerSecond > 1000 )
+            throw std::out_of_range( "GamePad polling rate must be from 1 to 1000 samples per second" );
+
+        StopPolling();
+
+        mPollInterval = 1000 / samplesPerSecond;
+        mOnConnection = onConnection;
+        mOnButtons = onButtons;
+
+        memset( mSnapshots, 0, sizeof(mSnapshots) );
+        memset( (void*)mSequence, 0, sizeof(mSequence) );
+        memset( (void*)mHistoryHead, 0, sizeof(mHistoryHead) );
+        memset( mHistoryTail, 0, sizeof(mHistoryTail) );
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+        mThreadQuit = CreateEventEx( nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE );
+        mFirstSample = CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE );
+#else
+        mThreadQuit = CreateEvent( nullptr, FALSE, FALSE, nullptr );
+        mFirstSample = CreateEvent( nullptr, TRUE, FALSE, nullptr );
+#endif
+        if ( !mThreadQuit || !mFirstSample )
+        {
+            StopPolling();
+            throw std::exception( "CreateEvent" );
+        }
+
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+        mThread = CreateThread( nullptr, 0, PollingThreadProc, this, 0, nullptr );
+        if ( !mThread )
+        {
+            StopPolling();
+            throw std::exception( "CreateThread" );
+        }
+#else
+        mThread = std::thread( &GamePad::Impl::PollingThread, this );
+#endif
+
+        mPolling = true;
+
+        // Wait for every slot to be read once, so GetState doesn't report the gamepads as disconnected in the meantime.
+        (void)WaitForSingleObjectEx( mFirstSample, INFINITE, FALSE );
+
+        return true;
+    }
+
+    void StopPolling()
+    {
+        if ( mPolling )
+        {
+            SetEvent( mThreadQuit );
+
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+            WaitForSingleObject( mThread, INFINITE );
+            CloseHandle( mThread );
+            mThread = nullptr;
+#else
+            mThread.join();
+#endif
+
+            mPolling = false;
+
+            // The slots weren't tracked while polling, so check them all again.
+            for( int j = 0; j < XUSER_MAX_COUNT; ++j )
+            {
+                ClearSlot( j, 0 );
+            }
+        }
+
+        if ( mThreadQuit )
+        {
+            CloseHandle( mThreadQuit );
+            mThreadQuit = nullptr;
+        }
+
+        if ( mFirstSample )
+        {
+            CloseHandle( mFirstSample );
+            mFirstSample = nullptr;
+        }
+
+        mOnConnection = nullptr;
+        mOnButtons = nullptr;
+    }
+
+    bool IsPolling() const
+    {
+        return mPolling;
+    }
+
+    size_t GetStateHistory( int player, _Out_writes_(maxSamples) Sample* samples, size_t maxSamples, DeadZone deadZoneMode )
+    {
+        if ( !mPolling || ( player < 0 ) || ( player >= XUSER_MAX_COUNT ) || !samples )
+            return 0;
+
+        size_t count = 0;
+        ULONG tail = mHistoryTail[ player ];
+
+        while( count < maxSamples )
+        {
+            ULONG head = static_cast<ULONG>( InterlockedCompareExchange( &mHistoryHead[ player ], 0, 0 ) );
+            if ( head == tail )
+                break;
+
+            // Anything older than the ring has already been overwritten, and the slot at head - HISTORY_SIZE
+            // is the one the thread writes next, so the oldest entry that can still be read is one newer.
+            if ( head - tail >= HISTORY_SIZE )
+                tail = head - static_cast<ULONG>( HISTORY_SIZE - 1 );
+
+            HistoryEntry entry = mHistory[ player ][ tail & ( HISTORY_SIZE - 1 ) ];
+
+            MemoryBarrier();
+
+            // The thread may have started writing over this entry while it was being copied. Skip ahead to
+            // the oldest entry it has not reached, so each retry makes progress.
+            ULONG newHead = static_cast<ULONG>( mHistoryHead[ player ] );
+
+            if ( newHead - tail >= HISTORY_SIZE )
+            {
+                tail = newHead - static_cast<ULONG>( HISTORY_SIZE - 1 );
+                continue;
+            }
+
+            samples[ count ].time = entry.time;
+
+            if ( entry.connected )
+            {
+                ConvertState( entry.state, deadZoneMode, samples[ count ].state );
+            }
+            else
+            {
+                memset( &samples[ count ].state, 0, sizeof(State) );
+            }
+
+            ++tail;
+            ++count;
+        }
+
+        mHistoryTail[ player ] = tail;
+
+        return count;
+    }
+
 private:
     bool        mConnected[ XUSER_MAX_COUNT ];
     ULONGLONG   mLastReadTime[ XUSER_MAX_COUNT ];
@@ -796,8 +986,280 @@ private:
     bool        mSuspended;
 #endif
 
+    // Background polling. Each player has two snapshots: the thread fills the one not published by mSequence, then
+    // publishes it, so GetState only retries if the thread published again while it was copying.
+    struct Snapshot
+    {
+        bool            connected;
+        XINPUT_STATE    state;
+    };
+
+    bool                mPolling;
+    DWORD               mPollInterval;
+    HANDLE              mThreadQuit;
+    HANDLE              mFirstSample;
+    ConnectionCallback  mOnConnection;
+    ButtonCallback      mOnButtons;
+    Snapshot            mSnapshots[ XUSER_MAX_COUNT ][ 2 ];
+    volatile LONG       mSequence[ XUSER_MAX_COUNT ];
+
+    // Every state change seen by the thread, for GetStateHistory. The thread advances mHistoryHead after writing each
+    // entry, and the reader keeps its own position in mHistoryTail.
+    struct HistoryEntry
+    {
+        uint64_t        time;
+        bool            connected;
+        XINPUT_STATE    state;
+    };
+
+    HistoryEntry        mHistory[ XUSER_MAX_COUNT ][ HISTORY_SIZE ];
+    volatile LONG       mHistoryHead[ XUSER_MAX_COUNT ];
+    ULONG               mHistoryTail[ XUSER_MAX_COUNT ];
+
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+    HANDLE              mThread;
+#else
+    std::thread         mThread;
+#endif
+
     static GamePad::Impl* s_gamePad;
 
+    static void ConvertState( const XINPUT_STATE& xstate, DeadZone deadZoneMode, _Out_ State& state )
+    {
+        state.connected = true;
+        state.packet = xstate.dwPacketNumber;
+
+        WORD xbuttons = xstate.Gamepad.wButtons;
+        state.buttons.a = (xbuttons & XINPUT_GAMEPAD_A) != 0;
+        state.buttons.b = (xbuttons & XINPUT_GAMEPAD_B) != 0;
+        state.buttons.x = (xbuttons & XINPUT_GAMEPAD_X) != 0;
+        state.buttons.y = (xbuttons & XINPUT_GAMEPAD_Y) != 0;
+        state.buttons.leftStick = (xbuttons & XINPUT_GAMEPAD_LEFT_THUMB) != 0;
+        state.buttons.rightStick = (xbuttons & XINPUT_GAMEPAD_RIGHT_THUMB) != 0;
+        state.buttons.leftShoulder = (xbuttons & XINPUT_GAMEPAD_LEFT_SHOULDER) != 0;
+        state.buttons.rightShoulder = (xbuttons & XINPUT_GAMEPAD_RIGHT_SHOULDER) != 0;
+        state.buttons.back = (xbuttons & XINPUT_GAMEPAD_BACK) != 0;
+        state.buttons.start = (xbuttons & XINPUT_GAMEPAD_START) != 0;
+
+        state.dpad.up = (xbuttons & XINPUT_GAMEPAD_DPAD_UP) != 0;
+        state.dpad.down = (xbuttons & XINPUT_GAMEPAD_DPAD_DOWN) != 0;
+        state.dpad.right = (xbuttons & XINPUT_GAMEPAD_DPAD_RIGHT) != 0;
+        state.dpad.left = (xbuttons & XINPUT_GAMEPAD_DPAD_LEFT) != 0;
+
+        if ( deadZoneMode == DEAD_ZONE_NONE )
+        {
+            state.triggers.left = ApplyLinearDeadZone( float(xstate.Gamepad.bLeftTrigger), 255.f, 0.f );
+            state.triggers.right = ApplyLinearDeadZone( float(xstate.Gamepad.bRightTrigger), 255.f, 0.f );
+        }
+        else
+        {
+            state.triggers.left = ApplyLinearDeadZone( float(xstate.Gamepad.bLeftTrigger), 255.f, float(XINPUT_GAMEPAD_TRIGGER_THRESHOLD) );
+            state.triggers.right = ApplyLinearDeadZone( float(xstate.Gamepad.bRightTrigger), 255.f, float(XINPUT_GAMEPAD_TRIGGER_THRESHOLD) );
+        }
+
+        ApplyStickDeadZone( float(xstate.Gamepad.sThumbLX), float(xstate.Gamepad.sThumbLY),
+                            deadZoneMode, 32767.f, float(XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE),
+                            state.thumbSticks.leftX, state.thumbSticks.leftY );
+
+        ApplyStickDeadZone( float(xstate.Gamepad.sThumbRX), float(xstate.Gamepad.sThumbRY),
+                            deadZoneMode, 32767.f, float(XINPUT_GAMEPAD_RIGHT_THUMB_DEADZONE),
+                            state.thumbSticks.rightX, state.thumbSticks.rightY );
+    }
+
+    void ReadSnapshot( int player, _Out_ Snapshot& snapshot ) const
+    {
+        for(;;)
+        {
+            LONG sequence = InterlockedCompareExchange( const_cast<volatile LONG*>( &mSequence[ player ] ), 0, 0 );
+
+            snapshot = mSnapshots[ player ][ sequence & 1 ];
+
+            MemoryBarrier();
+
+            if ( mSequence[ player ] == sequence )
+                return;
+        }
+    }
+
+    void WriteSnapshot( int player, const Snapshot& snapshot )
+    {
+        LONG sequence = mSequence[ player ] + 1;
+
+        mSnapshots[ player ][ sequence & 1 ] = snapshot;
+
+        InterlockedExchange( &mSequence[ player ], sequence );
+    }
+
+    void WriteHistory( int player, const Snapshot& snapshot, uint64_t time )
+    {
+        ULONG head = static_cast<ULONG>( mHistoryHead[ player ] );
+
+        HistoryEntry& entry = mHistory[ player ][ head & ( HISTORY_SIZE - 1 ) ];
+        entry.time = time;
+        entry.connected = snapshot.connected;
+        entry.state = snapshot.state;
+
+        InterlockedExchange( &mHistoryHead[ player ], static_cast<LONG>( head + 1 ) );
+    }
+
+    void GetPolledState( int player, _Out_ State& state, DeadZone deadZoneMode ) const
+    {
+        if ( ( player >= 0 ) && ( player < XUSER_MAX_COUNT ) )
+        {
+            Snapshot snapshot;
+            ReadSnapshot( player, snapshot );
+
+            if ( snapshot.connected )
+            {
+#if (_WIN32_WINNT < _WIN32_WINNT_WIN8)
+                if ( mSuspended )
+                {
+                    memset( &state, 0, sizeof(State) );
+                    state.connected = true;
+                    return;
+                }
+#endif
+
+                ConvertState( snapshot.state, deadZoneMode, state );
+                return;
+            }
+        }
+
+        memset( &state, 0, sizeof(State) );
+    }
+
+#if defined(_MSC_VER) && (_MSC_VER < 1700)
+    static DWORD WINAPI PollingThreadProc( LPVOID param )
+    {
+        static_cast<GamePad::Impl*>( param )->PollingThread();
+        return 0;
+    }
+#endif
+
+    void PollingThread()
+    {
+        bool connected[ XUSER_MAX_COUNT ] = { false };
+        ULONGLONG retryTime[ XUSER_MAX_COUNT ] = { 0 };
+        WORD lastButtons[ XUSER_MAX_COUNT ] = { 0 };
+        DWORD lastPacket[ XUSER_MAX_COUNT ] = { 0 };
+        ButtonStateTracker trackers[ XUSER_MAX_COUNT ];
+
+        bool firstSample = true;
+
+        for(;;)
+        {
+            ULONGLONG time = GetTickCount64();
+
+            for( int j = 0; j < XUSER_MAX_COUNT; ++j )
+            {
+                // Reading an empty slot makes XInput enumerate devices, so those are still only checked about once a second.
+                if ( !connected[ j ] && time < retryTime[ j ] )
+                    continue;
+
+                Snapshot snapshot;
+                snapshot.connected = ( XInputGetState( DWORD(j), &snapshot.state ) == ERROR_SUCCESS );
+
+                LARGE_INTEGER sampleTime;
+                QueryPerformanceCounter( &sampleTime );
+
+                if ( !snapshot.connected )
+                {
+                    memset( &snapshot.state, 0, sizeof(XINPUT_STATE) );
+                    retryTime[ j ] = time + 1000;
+
+                    if ( !connected[ j ] )
+                        continue;
+                }
+
+                WriteSnapshot( j, snapshot );
+
+                // The packet number only changes when the gamepad state does, so the history holds just the changes.
+                if ( snapshot.connected != connected[ j ] || snapshot.state.dwPacketNumber != lastPacket[ j ] )
+                {
+                    lastPacket[ j ] = snapshot.state.dwPacketNumber;
+
+                    WriteHistory( j, snapshot, static_cast<uint64_t>( sampleTime.QuadPart ) );
+                }
+
+                // Exceptions can't propagate out of the thread, so report them and keep polling
+                try
+                {
+                    if ( snapshot.connected != connected[ j ] )
+                    {
+                        connected[ j ] = snapshot.connected;
+                        lastButtons[ j ] = 0;
+                        trackers[ j ].Reset();
+
+                        if ( mOnConnection )
+                            mOnConnection( j, snapshot.connected );
+                    }
+
+                    if ( snapshot.connected && snapshot.state.Gamepad.wButtons != lastButtons[ j ] )
+                    {
+                        lastButtons[ j ] = snapshot.state.Gamepad.wButtons;
+
+                        State state;
+                        ConvertState( snapshot.state, DEAD_ZONE_INDEPENDENT_AXES, state );
+
+                        trackers[ j ].Update( state );
+
+                        if ( mOnButtons )
+                            mOnButtons( j, state, trackers[ j ] );
+                    }
+                }
+                catch( std::exception& e )
+                {
+#ifndef _DEBUG
+                    UNREFERENCED_PARAMETER(e);
+#endif
+                    DebugTrace( "ERROR: GamePad polling callback failed (%s)\n", e.what() );
+                }
+            }
+
+            if ( firstSample )
+            {
+                SetEvent( mFirstSample );
+                firstSample = false;
+            }
+
+            if ( WaitForSingleObjectEx( mThreadQuit, mPollInterval, FALSE ) != WAIT_TIMEOUT )
+                break;
+        }
+    }
+
+    // While polling, the thread's snapshots say which gamepads are connected rather than the throttled slot state.
+    bool IsConnected( int player ) const
+    {
+        if ( mPolling )
+        {
+            Snapshot snapshot;
+            ReadSnapshot( player, snapshot );
+            return snapshot.connected;
+        }
+
+        return mConnected[ player ];
+    }
+
+    bool CanRead( int player )
+    {
+        if ( mPolling )
+            return ( player >= 0 ) && ( player < XUSER_MAX_COUNT ) && IsConnected( player );
+
+        return !ThrottleRetry( player );
+    }
+
+    void MarkConnected( int player )
+    {
+        if ( !mPolling )
+            mConnected[ player ] = true;
+    }
+
+    void MarkDisconnected( int player )
+    {
+        if ( !mPolling )
+            ClearSlot( player, GetTickCount64() );
+    }
+
     bool ThrottleRetry( int player )
     {
         // This function minimizes a potential performance issue with XInput on Windows when
@@ -907,6 +1369,31 @@ void GamePad::Resume()
 }
 
 
+bool GamePad::StartPolling( unsigned int samplesPerSecond, ConnectionCallback onConnection, ButtonCallback onButtons )
+{
+    return pImpl->StartPolling( samplesPerSecond, onConnection, onButtons );
+}
+
+
+void GamePad::StopPolling()
+{
+    pImpl->StopPolling();
+}
+
+
+bool GamePad::IsPolling() const
+{
+    return pImpl->IsPolling();
+}
+
+
+_Use_decl_annotations_
+size_t GamePad::GetStateHistory( int player, Sample* samples, size_t maxSamples, DeadZone deadZoneMode )
+{
+    return pImpl->GetStateHistory( player, samples, maxSamples, deadZoneMode );
+}
+
+
 //======================================================================================
 // ButtonStateTracker
 //======================================================================================
@@ -21,6 +21,7 @@
 #include "Bezier.h"
 #include <vector>
 #include <map>
+#include <ppl.h>
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -57,8 +58,20 @@ namespace
     };
 
 
+    // 32 bit indices, used while generating the high detail shapes.
+    typedef std::vector<uint32_t> IndexCollection32;
+
+
+    void CheckIndexOverflow32(size_t value)
+    {
+        if (value >= UINT32_MAX)
+            throw std::exception("Index value out of range: cannot tesselate primitive so finely");
+    }
+
+
     // Helper for flipping winding of geometric primitives for LH vs. RH coords
-    static void ReverseWinding( IndexCollection& indices, VertexCollection& vertices )
+    template<typename TIndexCollection>
+    static void ReverseWinding( TIndexCollection& indices, VertexCollection& vertices )
     {
         assert( (indices.size() % 3) == 0 );
         for( auto it = indices.begin(); it != indices.end(); it += 3 )
@@ -116,6 +129,160 @@ namespace
 
         SetDebugObjectName(*pInputLayout, "DirectXTK:GeometricPrimitive");
     }
+
+
+    // Per-instance data for instanced drawing: the first three columns of the world matrix, then the color.
+    struct PrimitiveInstance
+    {
+        XMFLOAT4 column[3];
+        XMFLOAT4 color;
+    };
+
+    const D3D11_INPUT_ELEMENT_DESC s_instancedElements[] =
+    {
+        { "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "NORMAL",      0, DXGI_FORMAT_R32G32B32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "TEXCOORD",    0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+        { "INSTMATRIX",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,                            D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTMATRIX",  1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16,                           D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTMATRIX",  2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32,                           D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "COLOR",       0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48,                           D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    };
+
+
+    // Helper for creating the input layout used by instanced drawing, where the instance color feeds the vertex color input.
+    static void CreateInstancedInputLayout(_In_ ID3D11Device* device, IEffect* effect, _Outptr_ ID3D11InputLayout** pInputLayout)
+    {
+        assert( pInputLayout != 0 );
+
+        void const* shaderByteCode;
+        size_t byteCodeLength;
+
+        effect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
+
+        ThrowIfFailed(
+            device->CreateInputLayout(s_instancedElements,
+                                      _countof(s_instancedElements),
+                                      shaderByteCode, byteCodeLength,
+                                      pInputLayout)
+        );
+
+        SetDebugObjectName(*pInputLayout, "DirectXTK:GeometricPrimitive");
+    }
+
+
+    // Identifies the shape and creation parameters of a primitive, so identical primitives can share buffers.
+    struct GeometryKey
+    {
+        GeometryKey(int shape, float param1, float param2, size_t tessellation, bool rhcoords)
+          : shape(shape),
+            param1(param1),
+            param2(param2),
+            tessellation(tessellation),
+            rhcoords(rhcoords)
+        { }
+
+        int shape;
+        float param1;
+        float param2;
+        size_t tessellation;
+        bool rhcoords;
+
+        bool operator< (GeometryKey const& other) const
+        {
+            if (shape != other.shape) return shape < other.shape;
+            if (param1 != other.param1) return param1 < other.param1;
+            if (param2 != other.param2) return param2 < other.param2;
+            if (tessellation != other.tessellation) return tessellation < other.tessellation;
+            return rhcoords < other.rhcoords;
+        }
+    };
+
+    enum GeometryShape
+    {
+        GeometryShape_Cube,
+        GeometryShape_Sphere,
+        GeometryShape_GeoSphere,
+        GeometryShape_Cylinder,
+        GeometryShape_Cone,
+        GeometryShape_Torus,
+        GeometryShape_Tetrahedron,
+        GeometryShape_Octahedron,
+        GeometryShape_Dodecahedron,
+        GeometryShape_Icosahedron,
+        GeometryShape_Teapot,
+    };
+
+
+    // Vertex and index buffers for one set of creation parameters, shared by every primitive created with them.
+    struct Geometry
+    {
+        ComPtr<ID3D11Buffer> vertexBuffer;
+        ComPtr<ID3D11Buffer> indexBuffer;
+
+        UINT indexCount;
+        DXGI_FORMAT indexFormat;
+    };
+
+
+    // Only one of these is allocated per D3D device. Entries are weak, so the buffers go away with the last
+    // primitive using them.
+    class GeometryCache
+    {
+    public:
+        explicit GeometryCache(_In_ ID3D11Device*)
+        { }
+
+        std::shared_ptr<Geometry> Find(GeometryKey const& key)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            auto pos = mEntries.find(key);
+
+            return (pos != mEntries.end()) ? pos->second.lock() : nullptr;
+        }
+
+        // If another thread created the same geometry first, returns that one instead.
+        std::shared_ptr<Geometry> Insert(GeometryKey const& key, std::shared_ptr<Geometry> const& geometry)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            auto pos = mEntries.find(key);
+
+            if (pos != mEntries.end())
+            {
+                auto existing = pos->second.lock();
+
+                if (existing)
+                    return existing;
+
+                pos->second = geometry;
+            }
+            else
+            {
+                // Take the chance to drop entries whose primitives have all been destroyed.
+                for (auto it = mEntries.begin(); it != mEntries.end(); )
+                {
+                    if (it->second.expired())
+                        it = mEntries.erase(it);
+                    else
+                        ++it;
+                }
+
+                mEntries.insert(std::make_pair(key, geometry));
+            }
+
+            return geometry;
+        }
+
+    private:
+        std::map<GeometryKey, std::weak_ptr<Geometry>> mEntries;
+        std::mutex mMutex;
+
+        // Prevent copying.
+        GeometryCache(GeometryCache const&) DIRECTX_CTOR_DELETE
+        GeometryCache& operator= (GeometryCache const&) DIRECTX_CTOR_DELETE
+    };
 }
 
 
@@ -123,19 +290,28 @@ namespace
 class GeometricPrimitive::Impl
 {
 public:
-    void Initialize(_In_ ID3D11DeviceContext* deviceContext, VertexCollection& vertices, IndexCollection& indices, bool rhcoords );
+    bool InitializeFromCache(_In_ ID3D11DeviceContext* deviceContext, GeometryKey const& key);
+    void Initialize(_In_ ID3D11DeviceContext* deviceContext, GeometryKey const& key, VertexCollection& vertices, IndexCollection& indices, bool rhcoords );
+    void Initialize(_In_ ID3D11DeviceContext* deviceContext, GeometryKey const& key, VertexCollection& vertices, IndexCollection32& indices, bool rhcoords );
 
     void XM_CALLCONV Draw(FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, FXMVECTOR color, _In_opt_ ID3D11ShaderResourceView* texture, bool wireframe, _In_opt_ std::function<void()> setCustomState);
 
+    void XM_CALLCONV DrawInstanced(_In_reads_(count) XMMATRIX const* worlds, _In_reads_opt_(count) XMFLOAT4 const* colors, size_t count, CXMMATRIX view, CXMMATRIX projection,
+                                   _In_opt_ ID3D11ShaderResourceView* texture, bool wireframe, _In_opt_ std::function<void()> setCustomState);
+
     void Draw(_In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, _In_opt_ std::function<void()> setCustomState);
 
     void CreateInputLayout(_In_ IEffect* effect, _Outptr_ ID3D11InputLayout** inputLayout);
 
 private:
-    ComPtr<ID3D11Buffer> mVertexBuffer;
-    ComPtr<ID3D11Buffer> mIndexBuffer;
+    template<typename TIndexCollection>
+    void CreateGeometry(_In_ ID3D11DeviceContext* deviceContext, GeometryKey const& key, VertexCollection const& vertices, TIndexCollection const& indices, DXGI_FORMAT indexFormat);
+
+    void PrepareForDrawing(_In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, _In_opt_ ID3D11Buffer* instanceBuffer, bool alpha, bool wireframe, std::function<void()>& setCustomState);
 
-    UINT mIndexCount;
+    // Possibly shared with other primitives created with the same parameters.
+    std::shared_ptr<Geometry> mGeometry;
+    std::shared_ptr<GeometryCache> mGeometryCache;
 
     // Only one of these helpers is allocated per D3D device context, even if there are multiple GeometricPrimitive instances.
     class SharedResources
@@ -151,6 +327,14 @@ private:
         ComPtr<ID3D11InputLayout> inputLayoutTextured;
         ComPtr<ID3D11InputLayout> inputLayoutUntextured;
 
+        // Only created on Feature Level 9.3 or greater, which instancing requires.
+        ComPtr<ID3D11InputLayout> inputLayoutInstancedTextured;
+        ComPtr<ID3D11InputLayout> inputLayoutInstancedUntextured;
+
+        // Grown as needed by DrawInstanced.
+        ComPtr<ID3D11Buffer> instanceBuffer;
+        size_t instanceBufferCount;
+
         std::unique_ptr<CommonStates> stateObjects;
     };
 
@@ -159,6 +343,7 @@ private:
     std::shared_ptr<SharedResources> mResources;
 
     static SharedResourcePool<ID3D11DeviceContext*, SharedResources> sharedResourcesPool;
+    static SharedResourcePool<ID3D11Device*, GeometryCache> geometryCachePool;
 };
 
 
@@ -166,9 +351,14 @@ private:
 SharedResourcePool<ID3D11DeviceContext*, GeometricPrimitive::Impl::SharedResources> GeometricPrimitive::Impl::sharedResourcesPool;
 
 
+// Global pool of per-device geometry caches.
+SharedResourcePool<ID3D11Device*, GeometryCache> GeometricPrimitive::Impl::geometryCachePool;
+
+
 // Per-device-context constructor.
 GeometricPrimitive::Impl::SharedResources::SharedResources(_In_ ID3D11DeviceContext* deviceContext)
-  : deviceContext(deviceContext)
+  : deviceContext(deviceContext),
+    instanceBufferCount(0)
 {
     ComPtr<ID3D11Device> device;
     deviceContext->GetDevice(&device);
@@ -187,6 +377,21 @@ GeometricPrimitive::Impl::SharedResources::SharedResources(_In_ ID3D11DeviceCont
 
     effect->SetTextureEnabled(false);
     ::CreateInputLayout(device.Get(), effect.get(), &inputLayoutUntextured);
+
+    if (device->GetFeatureLevel() >= D3D_FEATURE_LEVEL_9_3)
+    {
+        effect->SetVertexColorEnabled(true);
+        effect->SetInstancingEnabled(true);
+
+        effect->SetTextureEnabled(true);
+        ::CreateInstancedInputLayout(device.Get(), effect.get(), &inputLayoutInstancedTextured);
+
+        effect->SetTextureEnabled(false);
+        ::CreateInstancedInputLayout(device.Get(), effect.get(), &inputLayoutInstancedUntextured);
+
+        effect->SetVertexColorEnabled(false);
+        effect->SetInstancingEnabled(false);
+    }
 }
 
 
@@ -225,9 +430,29 @@ void GeometricPrimitive::Impl::SharedResources::PrepareForRendering(bool alpha,
 }
 
 
+// Looks for existing buffers created with the same parameters, returning false if the geometry must be generated.
+_Use_decl_annotations_
+bool GeometricPrimitive::Impl::InitializeFromCache(ID3D11DeviceContext* deviceContext, GeometryKey const& key)
+{
+    ComPtr<ID3D11Device> device;
+    deviceContext->GetDevice(&device);
+
+    mGeometryCache = geometryCachePool.DemandCreate(device.Get());
+
+    mGeometry = mGeometryCache->Find(key);
+
+    if ( !mGeometry )
+        return false;
+
+    mResources = sharedResourcesPool.DemandCreate(deviceContext);
+
+    return true;
+}
+
+
 // Initializes a geometric primitive instance that will draw the specified vertex and index data.
 _Use_decl_annotations_
-void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, VertexCollection& vertices, IndexCollection& indices, bool rhcoords)
+void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, GeometryKey const& key, VertexCollection& vertices, IndexCollection& indices, bool rhcoords)
 {
     if ( vertices.size() >= USHRT_MAX )
         throw std::exception("Too many vertices for 16-bit index buffer");
@@ -235,15 +460,60 @@ void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, Ve
     if ( !rhcoords )
         ReverseWinding( indices, vertices );
 
+    CreateGeometry( deviceContext, key, vertices, indices, DXGI_FORMAT_R16_UINT );
+}
+
+
+// Initializes from 32 bit indices, which are narrowed to 16 bits if the vertices fit.
+_Use_decl_annotations_
+void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, GeometryKey const& key, VertexCollection& vertices, IndexCollection32& indices, bool rhcoords)
+{
+    if ( vertices.size() < USHRT_MAX )
+    {
+        IndexCollection narrowIndices;
+        narrowIndices.reserve( indices.size() );
+
+        for ( auto it = indices.cbegin(); it != indices.cend(); ++it )
+        {
+            narrowIndices.push_back( *it );
+        }
+
+        Initialize( deviceContext, key, vertices, narrowIndices, rhcoords );
+        return;
+    }
+
+    ComPtr<ID3D11Device> device;
+    deviceContext->GetDevice(&device);
+
+    if ( device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_2 )
+        throw std::exception("32-bit index buffers require Feature Level 9.2 or greater");
+
+    if ( !rhcoords )
+        ReverseWinding( indices, vertices );
+
+    CreateGeometry( deviceContext, key, vertices, indices, DXGI_FORMAT_R32_UINT );
+}
+
+
+// Creates the vertex and index buffers, unless another thread already made them for the same parameters.
+template<typename TIndexCollection>
+void GeometricPrimitive::Impl::CreateGeometry(_In_ ID3D11DeviceContext* deviceContext, GeometryKey const& key, VertexCollection const& vertices, TIndexCollection const& indices, DXGI_FORMAT indexFormat)
+{
     mResources = sharedResourcesPool.DemandCreate(deviceContext);
 
     ComPtr<ID3D11Device> device;
     deviceContext->GetDevice(&device);
 
-    CreateBuffer(device.Get(), vertices, D3D11_BIND_VERTEX_BUFFER, &mVertexBuffer);
-    CreateBuffer(device.Get(), indices, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
+    auto geometry = std::make_shared<Geometry>();
 
-    mIndexCount = static_cast<UINT>( indices.size() );
+    CreateBuffer(device.Get(), vertices, D3D11_BIND_VERTEX_BUFFER, &geometry->vertexBuffer);
+    CreateBuffer(device.Get(), indices, D3D11_BIND_INDEX_BUFFER, &geometry->indexBuffer);
+
+    geometry->indexCount = static_cast<UINT>( indices.size() );
+    geometry->indexFormat = indexFormat;
+
+    assert( mGeometryCache != 0 );
+    mGeometry = mGeometryCache->Insert(key, geometry);
 }
 
 
@@ -274,6 +544,9 @@ void XM_CALLCONV GeometricPrimitive::Impl::Draw(FXMMATRIX world, CXMMATRIX view,
     float alpha = XMVectorGetW(color);
 
     // Set effect parameters.
+    effect->SetVertexColorEnabled(false);
+    effect->SetInstancingEnabled(false);
+
     effect->SetWorld(world);
     effect->SetView(view);
     effect->SetProjection(projection);
@@ -285,9 +558,138 @@ void XM_CALLCONV GeometricPrimitive::Impl::Draw(FXMMATRIX world, CXMMATRIX view,
 }
 
 
+// Draws many copies of the primitive with one DrawIndexedInstanced call.
+_Use_decl_annotations_
+void XM_CALLCONV GeometricPrimitive::Impl::DrawInstanced(XMMATRIX const* worlds, XMFLOAT4 const* colors, size_t count, CXMMATRIX view, CXMMATRIX projection,
+                                                         ID3D11ShaderResourceView* texture, bool wireframe, std::function<void()> setCustomState)
+{
+    if ( !count )
+        return;
+
+    if ( !worlds )
+        throw std::exception("Instance world matrices cannot be null");
+
+    if ( count > UINT32_MAX / sizeof(PrimitiveInstance) )
+        throw std::out_of_range("Too many instances");
+
+    assert( mResources != 0 );
+
+    // Below Feature Level 9.3 there is no instancing, so draw the copies one at a time.
+    if ( !mResources->inputLayoutInstancedUntextured )
+    {
+        for ( size_t i = 0; i < count; ++i )
+        {
+            XMVECTOR color = colors ? XMLoadFloat4( &colors[i] ) : Colors::White;
+
+            Draw( worlds[i], view, projection, color, texture, wireframe, setCustomState );
+        }
+
+        return;
+    }
+
+    auto deviceContext = mResources->deviceContext.Get();
+    assert( deviceContext != 0 );
+
+    // Upload the transforms and colors.
+    if ( !mResources->instanceBuffer || mResources->instanceBufferCount < count )
+    {
+        ComPtr<ID3D11Device> device;
+        deviceContext->GetDevice( &device );
+
+        CD3D11_BUFFER_DESC desc( static_cast<UINT>( count * sizeof(PrimitiveInstance) ), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE );
+
+        mResources->instanceBuffer.Reset();
+        mResources->instanceBufferCount = 0;
+
+        ThrowIfFailed(
+            device->CreateBuffer( &desc, nullptr, &mResources->instanceBuffer )
+        );
+
+        SetDebugObjectName( mResources->instanceBuffer.Get(), "DirectXTK:GeometricPrimitive" );
+
+        mResources->instanceBufferCount = count;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+
+    ThrowIfFailed(
+        deviceContext->Map( mResources->instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped )
+    );
+
+    auto instances = reinterpret_cast<PrimitiveInstance*>( mapped.pData );
+
+    bool alpha = false;
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        XMMATRIX transpose = XMMatrixTranspose( worlds[i] );
+
+        XMStoreFloat4( &instances[i].column[0], transpose.r[0] );
+        XMStoreFloat4( &instances[i].column[1], transpose.r[1] );
+        XMStoreFloat4( &instances[i].column[2], transpose.r[2] );
+
+        // Premultiply, to match what BasicEffect does with its alpha setting.
+        XMVECTOR color = colors ? XMLoadFloat4( &colors[i] ) : Colors::White;
+        float a = XMVectorGetW( color );
+
+        XMStoreFloat4( &instances[i].color, XMVectorSelect( XMVectorReplicate( a ), XMVectorScale( color, a ), g_XMSelect1110 ) );
+
+        if ( a < 1.f )
+            alpha = true;
+    }
+
+    deviceContext->Unmap( mResources->instanceBuffer.Get(), 0 );
+
+    // Set effect parameters. The per-instance transform does all the work, so the world matrix is left as identity.
+    auto effect = mResources->effect.get();
+    assert( effect != 0 );
+
+    ID3D11InputLayout *inputLayout;
+    if ( texture )
+    {
+        effect->SetTextureEnabled(true);
+        effect->SetTexture(texture);
+
+        inputLayout = mResources->inputLayoutInstancedTextured.Get();
+    }
+    else
+    {
+        effect->SetTextureEnabled(false);
+
+        inputLayout = mResources->inputLayoutInstancedUntextured.Get();
+    }
+
+    effect->SetVertexColorEnabled(true);
+    effect->SetInstancingEnabled(true);
+
+    effect->SetWorld(XMMatrixIdentity());
+    effect->SetView(view);
+    effect->SetProjection(projection);
+
+    effect->SetDiffuseColor(Colors::White);
+    effect->SetAlpha(1.f);
+
+    PrepareForDrawing( effect, inputLayout, mResources->instanceBuffer.Get(), alpha, wireframe, setCustomState );
+
+    assert( mGeometry != 0 );
+    deviceContext->DrawIndexedInstanced(mGeometry->indexCount, static_cast<UINT>( count ), 0, 0, 0);
+}
+
+
 // Draw the primitive using a custom effect.
 _Use_decl_annotations_
 void GeometricPrimitive::Impl::Draw(IEffect* effect, ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, std::function<void()> setCustomState )
+{
+    PrepareForDrawing( effect, inputLayout, nullptr, alpha, wireframe, setCustomState );
+
+    assert( mGeometry != 0 );
+    mResources->deviceContext->DrawIndexed(mGeometry->indexCount, 0, 0);
+}
+
+
+// Sets the state, effect, and buffers for drawing, with the per-instance data in slot 1 if there is any.
+_Use_decl_annotations_
+void GeometricPrimitive::Impl::PrepareForDrawing(IEffect* effect, ID3D11InputLayout* inputLayout, ID3D11Buffer* instanceBuffer, bool alpha, bool wireframe, std::function<void()>& setCustomState )
 {
     assert( mResources != 0 );
     auto deviceContext = mResources->deviceContext.Get();
@@ -305,13 +707,15 @@ void GeometricPrimitive::Impl::Draw(IEffect* effect, ID3D11InputLayout* inputLay
     effect->Apply(deviceContext);
 
     // Set the vertex and index buffer.
-    auto vertexBuffer = mVertexBuffer.Get();
-    UINT vertexStride = sizeof(VertexPositionNormalTexture);
-    UINT vertexOffset = 0;
+    assert( mGeometry != 0 );
 
-    deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+    ID3D11Buffer* vertexBuffers[2] = { mGeometry->vertexBuffer.Get(), instanceBuffer };
+    UINT vertexStrides[2] = { sizeof(VertexPositionNormalTexture), sizeof(PrimitiveInstance) };
+    UINT vertexOffsets[2] = { 0, 0 };
 
-    deviceContext->IASetIndexBuffer(mIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    deviceContext->IASetVertexBuffers(0, instanceBuffer ? 2 : 1, vertexBuffers, vertexStrides, vertexOffsets);
+
+    deviceContext->IASetIndexBuffer(mGeometry->indexBuffer.Get(), mGeometry->indexFormat, 0);
 
     // Hook lets the caller replace our shaders or state settings with whatever else they see fit.
     if (setCustomState)
@@ -319,10 +723,7 @@ void GeometricPrimitive::Impl::Draw(IEffect* effect, ID3D11InputLayout* inputLay
         setCustomState();
     }
 
-    // Draw the primitive.
     deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-    deviceContext->DrawIndexed(mIndexCount, 0, 0);
 }
 
 
@@ -369,6 +770,14 @@ void XM_CALLCONV GeometricPrimitive::Draw(FXMMATRIX world, CXMMATRIX view, CXMMA
 }
 
 
+_Use_decl_annotations_
+void XM_CALLCONV GeometricPrimitive::DrawInstanced(XMMATRIX const* worlds, XMFLOAT4 const* colors, size_t count, CXMMATRIX view, CXMMATRIX projection,
+                                                   ID3D11ShaderResourceView* texture, bool wireframe, std::function<void()> setCustomState)
+{
+    pImpl->DrawInstanced(worlds, colors, count, view, projection, texture, wireframe, setCustomState);
+}
+
+
 _Use_decl_annotations_
 void GeometricPrimitive::Draw(IEffect* effect, ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, std::function<void()> setCustomState )
 {
@@ -390,6 +799,14 @@ void GeometricPrimitive::CreateInputLayout(IEffect* effect, ID3D11InputLayout**
 // Creates a cube primitive.
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Cube, size, 0, 0, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     // A cube has six faces, each one pointing in a different direction.
     const int FaceCount = 6;
 
@@ -445,9 +862,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11De
     }
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, rhcoords);
 
     return primitive;
 }
@@ -461,6 +876,14 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11De
 // Creates a sphere primitive.
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(_In_ ID3D11DeviceContext* deviceContext, float diameter, size_t tessellation, bool rhcoords)
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Sphere, diameter, 0, tessellation, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     VertexCollection vertices;
     IndexCollection indices;
 
@@ -523,9 +946,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(_In_ ID3D11
     }
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, rhcoords);
 
     return primitive;
 }
@@ -535,16 +956,19 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(_In_ ID3D11
 // Geodesic sphere
 //--------------------------------------------------------------------------------------
 
-// Creates a geosphere primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3D11DeviceContext* deviceContext, float diameter, size_t tessellation, bool rhcoords)
+// Computes the vertices and 32 bit indices of a geosphere.
+void GeometricPrimitive::ComputeGeoSphere(std::vector<VertexPositionNormalTexture>& vertices, std::vector<uint32_t>& indices, float diameter, size_t tessellation, bool rhcoords)
 {
+    vertices.clear();
+    indices.clear();
+
     // An undirected edge between two vertices, represented by a pair of indexes into a vertex array.
     // Becuse this edge is undirected, (a,b) is the same as (b,a).
-    typedef std::pair<uint16_t, uint16_t> UndirectedEdge;
+    typedef std::pair<uint32_t, uint32_t> UndirectedEdge;
 
     // Makes an undirected edge. Rather than overloading comparison operators to give us the (a,b)==(b,a) property,
     // we'll just ensure that the larger of the two goes first. This'll simplify things greatly.
-    auto makeUndirectedEdge = [](uint16_t a, uint16_t b)
+    auto makeUndirectedEdge = [](uint32_t a, uint32_t b)
     {
         return std::make_pair(std::max(a, b), std::min(a, b));
     };
@@ -552,7 +976,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
     // Key: an edge
     // Value: the index of the vertex which lies midway between the two vertices pointed to by the key value
     // This map is used to avoid duplicating vertices when subdividing triangles along edges.
-    typedef std::map<UndirectedEdge, uint16_t> EdgeSubdivisionMap;
+    typedef std::map<UndirectedEdge, uint32_t> EdgeSubdivisionMap;
 
 
     static const XMFLOAT3 OctahedronVertices[] =
@@ -565,7 +989,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
         XMFLOAT3(-1,  0,  0), // 4 left
         XMFLOAT3( 0, -1,  0), // 5 bottom
     };
-    static const uint16_t OctahedronIndices[] =
+    static const uint32_t OctahedronIndices[] =
     {
         0, 1, 2, // top front-right face
         0, 2, 3, // top back-right face
@@ -583,14 +1007,26 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
 
     std::vector<XMFLOAT3> vertexPositions(std::begin(OctahedronVertices), std::end(OctahedronVertices));
 
-    IndexCollection indices;
-    indices.insert(indices.begin(), std::begin(OctahedronIndices), std::end(OctahedronIndices));
+    indices.assign(std::begin(OctahedronIndices), std::end(OctahedronIndices));
+
+    // Each subdivision splits every triangle in four, adding one vertex per edge, which leaves 4^(n+1) + 2 vertices.
+    size_t finalVertexCount = 4;
+
+    for (size_t i = 0; i < tessellation; ++i)
+    {
+        if (finalVertexCount > UINT32_MAX / 4)
+            throw std::out_of_range("tesselation parameter out of range");
+
+        finalVertexCount *= 4;
+    }
+
+    vertexPositions.reserve(finalVertexCount + 2);
 
     // We know these values by looking at the above index list for the octahedron. Despite the subdivisions that are
     // about to go on, these values aren't ever going to change because the vertices don't move around in the array.
     // We'll need these values later on to fix the singularities that show up at the poles.
-    const uint16_t northPoleIndex = 0;
-    const uint16_t southPoleIndex = 5;
+    const uint32_t northPoleIndex = 0;
+    const uint32_t southPoleIndex = 5;
     
     for (size_t iSubdivision = 0; iSubdivision < tessellation; ++iSubdivision)
     {
@@ -600,7 +1036,8 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
         EdgeSubdivisionMap subdividedEdges;
 
         // The new index collection after subdivision.
-        IndexCollection newIndices;
+        IndexCollection32 newIndices;
+        newIndices.reserve(indices.size() * 4);
 
         const size_t triangleCount = indices.size() / 3;
         for (size_t iTriangle = 0; iTriangle < triangleCount; ++iTriangle)
@@ -609,20 +1046,20 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             // The winding order of the triangles we output are the same as the winding order of the inputs.
 
             // Indices of the vertices making up this triangle
-            uint16_t iv0 = indices[iTriangle*3+0];
-            uint16_t iv1 = indices[iTriangle*3+1];
-            uint16_t iv2 = indices[iTriangle*3+2];
+            uint32_t iv0 = indices[iTriangle*3+0];
+            uint32_t iv1 = indices[iTriangle*3+1];
+            uint32_t iv2 = indices[iTriangle*3+2];
             
             // Get the new vertices
             XMFLOAT3 v01; // vertex on the midpoint of v0 and v1
             XMFLOAT3 v12; // ditto v1 and v2
             XMFLOAT3 v20; // ditto v2 and v0
-            uint16_t iv01; // index of v01
-            uint16_t iv12; // index of v12
-            uint16_t iv20; // index of v20
+            uint32_t iv01; // index of v01
+            uint32_t iv12; // index of v12
+            uint32_t iv20; // index of v20
 
             // Function that, when given the index of two vertices, creates a new vertex at the midpoint of those vertices.
-            auto divideEdge = [&](uint16_t i0, uint16_t i1, XMFLOAT3& outVertex, uint16_t& outIndex)
+            auto divideEdge = [&](uint32_t i0, uint32_t i1, XMFLOAT3& outVertex, uint32_t& outIndex)
             {
                 const UndirectedEdge edge = makeUndirectedEdge(i0, i1);
 
@@ -647,8 +1084,8 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
                         )
                     );
 
-                    outIndex = static_cast<uint16_t>( vertexPositions.size() );
-                    CheckIndexOverflow(outIndex);
+                    CheckIndexOverflow32(vertexPositions.size());
+                    outIndex = static_cast<uint32_t>( vertexPositions.size() );
                     vertexPositions.push_back(outVertex);
 
                     // Now add it to the map.
@@ -669,7 +1106,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             //     /b\c/d\
             // v2 o---o---o v1
             //       v12
-            const uint16_t indicesToAdd[] =
+            const uint32_t indicesToAdd[] =
             {
                  iv0, iv01, iv20, // a
                 iv20, iv12,  iv2, // b
@@ -682,12 +1119,12 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
         indices = std::move(newIndices);
     }
 
-    // Now that we've completed subdivision, fill in the final vertex collection
-    VertexCollection vertices;
-    vertices.reserve(vertexPositions.size());
-    for (auto it = vertexPositions.begin(); it != vertexPositions.end(); ++it)
+    // Now that we've completed subdivision, fill in the final vertex collection. Each vertex is independent of the others.
+    vertices.resize(vertexPositions.size());
+
+    Concurrency::parallel_for(size_t(0), vertexPositions.size(), [&](size_t i)
     {
-        auto vertexValue = *it;
+        auto vertexValue = vertexPositions[i];
 
         auto normal = XMVector3Normalize(XMLoadFloat3(&vertexValue));
         auto pos = XMVectorScale(normal, radius);
@@ -703,8 +1140,8 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
         float v = latitude / XM_PI;
 
         auto texcoord = XMVectorSet(1.0f - u, v, 0.0f, 0.0f);
-        vertices.push_back(VertexPositionNormalTexture(pos, normal, texcoord));
-    }
+        vertices[i] = VertexPositionNormalTexture(pos, normal, texcoord);
+    });
 
     // There are a couple of fixes to do. One is a texture coordinate wraparound fixup. At some point, there will be
     // a set of triangles somewhere in the mesh with texture coordinates such that the wraparound across 0.0/1.0
@@ -728,7 +1165,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
         if (isOnPrimeMeridian)
         {
             size_t newIndex = vertices.size(); // the index of this vertex that we're about to add
-            CheckIndexOverflow(newIndex);
+            CheckIndexOverflow32(newIndex);
 
             // copy this vertex, correct the texture coordinate, and add the vertex
             VertexPositionNormalTexture v = vertices[i];
@@ -738,9 +1175,9 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             // Now find all the triangles which contain this vertex and update them if necessary
             for (size_t j = 0; j < indices.size(); j += 3)
             {
-                uint16_t* triIndex0 = &indices[j+0];
-                uint16_t* triIndex1 = &indices[j+1];
-                uint16_t* triIndex2 = &indices[j+2];
+                uint32_t* triIndex0 = &indices[j+0];
+                uint32_t* triIndex1 = &indices[j+1];
+                uint32_t* triIndex2 = &indices[j+2];
 
                 if (*triIndex0 == i)
                 {
@@ -774,7 +1211,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
                     abs(v0.textureCoordinate.x - v2.textureCoordinate.x) > 0.5f)
                 {
                     // yep; replace the specified index to point to the new, corrected vertex
-                    *triIndex0 = static_cast<uint16_t>(newIndex);
+                    *triIndex0 = static_cast<uint32_t>(newIndex);
                 }
             }
         }
@@ -795,9 +1232,9 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             // These pointers point to the three indices which make up this triangle. pPoleIndex is the pointer to the
             // entry in the index array which represents the pole index, and the other two pointers point to the other
             // two indices making up this triangle.
-            uint16_t* pPoleIndex;
-            uint16_t* pOtherIndex0;
-            uint16_t* pOtherIndex1;
+            uint32_t* pPoleIndex;
+            uint32_t* pOtherIndex0;
+            uint32_t* pOtherIndex1;
             if (indices[i + 0] == poleIndex)
             {
                 pPoleIndex = &indices[i + 0];
@@ -836,9 +1273,9 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             }
             else
             {
-                CheckIndexOverflow(vertices.size());
+                CheckIndexOverflow32(vertices.size());
 
-                *pPoleIndex = static_cast<uint16_t>(vertices.size());
+                *pPoleIndex = static_cast<uint32_t>(vertices.size());
                 vertices.push_back(newPoleVertex);
             }
         }
@@ -847,10 +1284,30 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
     fixPole(northPoleIndex);
     fixPole(southPoleIndex);
 
-    // Create the primitive object.
+    if ( !rhcoords )
+        ReverseWinding( indices, vertices );
+}
+
+
+// Creates a geosphere primitive.
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3D11DeviceContext* deviceContext, float diameter, size_t tessellation, bool rhcoords)
+{
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_GeoSphere, diameter, 0, tessellation, rhcoords);
+
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
+    VertexCollection vertices;
+    IndexCollection32 indices;
+
+    ComputeGeoSphere(vertices, indices, diameter, tessellation, rhcoords);
+
+    // Create the primitive object. The winding has already been set up for rhcoords.
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, true);
+
     return primitive;
 }
 
@@ -930,6 +1387,14 @@ static void CreateCylinderCap(VertexCollection& vertices, IndexCollection& indic
 // Creates a cylinder primitive.
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCylinder(_In_ ID3D11DeviceContext* deviceContext, float height, float diameter, size_t tessellation, bool rhcoords)
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Cylinder, height, diameter, tessellation, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     VertexCollection vertices;
     IndexCollection indices;
 
@@ -971,9 +1436,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCylinder(_In_ ID3D
     CreateCylinderCap(vertices, indices, tessellation, height, radius, false);
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, rhcoords);
 
     return primitive;
 }
@@ -982,6 +1445,14 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCylinder(_In_ ID3D
 // Creates a cone primitive.
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(_In_ ID3D11DeviceContext* deviceContext, float diameter, float height, size_t tessellation, bool rhcoords)
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Cone, diameter, height, tessellation, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     VertexCollection vertices;
     IndexCollection indices;
 
@@ -1024,9 +1495,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(_In_ ID3D11De
     CreateCylinderCap(vertices, indices, tessellation, height, radius, false);
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, rhcoords);
 
     return primitive;
 }
@@ -1036,19 +1505,24 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(_In_ ID3D11De
 // Torus
 //--------------------------------------------------------------------------------------
 
-// Creates a torus primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11DeviceContext* deviceContext, float diameter, float thickness, size_t tessellation, bool rhcoords)
+// Computes the vertices and 32 bit indices of a torus. Each ring around the main axis is generated in parallel.
+void GeometricPrimitive::ComputeTorus(std::vector<VertexPositionNormalTexture>& vertices, std::vector<uint32_t>& indices, float diameter, float thickness, size_t tessellation, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
-
     if (tessellation < 3)
         throw std::out_of_range("tesselation parameter out of range");
 
     size_t stride = tessellation + 1;
 
+    if (stride > 65536)
+        throw std::out_of_range("tesselation parameter out of range");
+
+    CheckIndexOverflow32(stride * stride);
+
+    vertices.resize(stride * stride);
+    indices.resize(stride * stride * 6);
+
     // First we loop around the main ring of the torus.
-    for (size_t i = 0; i <= tessellation; i++)
+    Concurrency::parallel_for(size_t(0), stride, [&](size_t i)
     {
         float u = (float)i / tessellation;
 
@@ -1076,26 +1550,49 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11D
             position = XMVector3Transform(position, transform);
             normal = XMVector3TransformNormal(normal, transform);
 
-            vertices.push_back(VertexPositionNormalTexture(position, normal, textureCoordinate));
+            size_t vertex = i * stride + j;
+
+            vertices[vertex] = VertexPositionNormalTexture(position, normal, textureCoordinate);
 
             // And create indices for two triangles.
             size_t nextI = (i + 1) % stride;
             size_t nextJ = (j + 1) % stride;
 
-            indices.push_back(i * stride + j);
-            indices.push_back(i * stride + nextJ);
-            indices.push_back(nextI * stride + j);
+            uint32_t* output = &indices[vertex * 6];
 
-            indices.push_back(i * stride + nextJ);
-            indices.push_back(nextI * stride + nextJ);
-            indices.push_back(nextI * stride + j);
+            output[0] = static_cast<uint32_t>(i * stride + j);
+            output[1] = static_cast<uint32_t>(i * stride + nextJ);
+            output[2] = static_cast<uint32_t>(nextI * stride + j);
+
+            output[3] = static_cast<uint32_t>(i * stride + nextJ);
+            output[4] = static_cast<uint32_t>(nextI * stride + nextJ);
+            output[5] = static_cast<uint32_t>(nextI * stride + j);
         }
-    }
+    });
+
+    if ( !rhcoords )
+        ReverseWinding( indices, vertices );
+}
+
+
+// Creates a torus primitive.
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11DeviceContext* deviceContext, float diameter, float thickness, size_t tessellation, bool rhcoords)
+{
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Torus, diameter, thickness, tessellation, rhcoords);
 
-    // Create the primitive object.
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
+    VertexCollection vertices;
+    IndexCollection32 indices;
+
+    ComputeTorus(vertices, indices, diameter, thickness, tessellation, rhcoords);
+
+    // Create the primitive object. The winding has already been set up for rhcoords.
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, true);
 
     return primitive;
 }
@@ -1107,6 +1604,14 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11D
 
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Tetrahedron, size, 0, 0, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     VertexCollection vertices;
     IndexCollection indices;
 
@@ -1156,9 +1661,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ I
     assert( indices.size() == 4*3 );
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, !rhcoords);
 
     return primitive;
 }
@@ -1170,6 +1673,14 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ I
 
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords )
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Octahedron, size, 0, 0, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     VertexCollection vertices;
     IndexCollection indices;
 
@@ -1225,9 +1736,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID
     assert( indices.size() == 8*3 );
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, !rhcoords);
 
     return primitive;
 }
@@ -1239,6 +1748,14 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID
 
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords )
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Dodecahedron, size, 0, 0, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     VertexCollection vertices;
     IndexCollection indices;
 
@@ -1359,9 +1876,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_
     assert( indices.size() == 12*3*3 );
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, !rhcoords);
 
     return primitive;
 }
@@ -1373,6 +1888,14 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_
 
 std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateIcosahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords )
 {
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Icosahedron, size, 0, 0, rhcoords);
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
     VertexCollection vertices;
     IndexCollection indices;
 
@@ -1449,9 +1972,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateIcosahedron(_In_ I
     assert( indices.size() == 20*3 );
 
     // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, !rhcoords);
 
     return primitive;
 }
@@ -1468,46 +1989,54 @@ namespace
 }
 
 
-// Tessellates the specified bezier patch.
-static void XM_CALLCONV TessellatePatch(VertexCollection& vertices, IndexCollection& indices, TeapotPatch const& patch, size_t tessellation, FXMVECTOR scale, bool isMirrored)
+// One of the mirrored copies of a teapot patch, with where its output goes.
+struct TeapotPatchInstance
+{
+    TeapotPatch const* patch;
+    XMFLOAT3 scale;
+    bool isMirrored;
+};
+
+
+// Tessellates the specified bezier patch into its own range of the pre-sized outputs.
+static void TessellatePatch(VertexPositionNormalTexture* vertices, uint32_t* indices, size_t vbase, TeapotPatchInstance const& instance, size_t tessellation)
 {
     // Look up the 16 control points for this patch.
     XMVECTOR controlPoints[16];
 
+    XMVECTOR scale = XMLoadFloat3(&instance.scale);
+
     for (int i = 0; i < 16; i++)
     {
-        controlPoints[i] = TeapotControlPoints[patch.indices[i]] * scale;
+        controlPoints[i] = TeapotControlPoints[instance.patch->indices[i]] * scale;
     }
 
     // Create the index data.
-    size_t vbase = vertices.size();
-    Bezier::CreatePatchIndices(tessellation, isMirrored, [&](size_t index)
+    Bezier::CreatePatchIndices(tessellation, instance.isMirrored, [&](size_t index)
     {
-        indices.push_back(vbase + index);
+        *indices++ = static_cast<uint32_t>(vbase + index);
     });
 
     // Create the vertex data.
-    Bezier::CreatePatchVertices(controlPoints, tessellation, isMirrored, [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
+    Bezier::CreatePatchVertices(controlPoints, tessellation, instance.isMirrored, [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
     {
-        vertices.push_back(VertexPositionNormalTexture(position, normal, textureCoordinate));
+        *vertices++ = VertexPositionNormalTexture(position, normal, textureCoordinate);
     });
 }
 
-        
-// Creates a teapot primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTeapot(_In_ ID3D11DeviceContext* deviceContext, float size, size_t tessellation, bool rhcoords)
-{
-    VertexCollection vertices;
-    IndexCollection indices;
 
-    if (tessellation < 1)
+// Computes the vertices and 32 bit indices of a teapot. Each patch is tessellated in parallel.
+void GeometricPrimitive::ComputeTeapot(std::vector<VertexPositionNormalTexture>& vertices, std::vector<uint32_t>& indices, float size, size_t tessellation, bool rhcoords)
+{
+    if (tessellation < 1 || tessellation >= 65536)
         throw std::out_of_range("tesselation parameter out of range");
 
-    XMVECTOR scaleVector = XMVectorReplicate(size);
+    XMFLOAT3 scale(size, size, size);
+    XMFLOAT3 scaleNegateX(-size, size, size);
+    XMFLOAT3 scaleNegateZ(size, size, -size);
+    XMFLOAT3 scaleNegateXZ(-size, size, -size);
 
-    XMVECTOR scaleNegateX = scaleVector * g_XMNegateX;
-    XMVECTOR scaleNegateZ = scaleVector * g_XMNegateZ;
-    XMVECTOR scaleNegateXZ = scaleVector * g_XMNegateX * g_XMNegateZ;
+    std::vector<TeapotPatchInstance> instances;
 
     for (int i = 0; i < sizeof(TeapotPatches) / sizeof(TeapotPatches[0]); i++)
     {
@@ -1515,23 +2044,62 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTeapot(_In_ ID3D11
 
         // Because the teapot is symmetrical from left to right, we only store
         // data for one side, then tessellate each patch twice, mirroring in X.
-        TessellatePatch(vertices, indices, patch, tessellation, scaleVector, false);
-        TessellatePatch(vertices, indices, patch, tessellation, scaleNegateX, true);
+        TeapotPatchInstance plain = { &patch, scale, false };
+        TeapotPatchInstance mirrorX = { &patch, scaleNegateX, true };
+
+        instances.push_back(plain);
+        instances.push_back(mirrorX);
 
         if (patch.mirrorZ)
         {
             // Some parts of the teapot (the body, lid, and rim, but not the
             // handle or spout) are also symmetrical from front to back, so
             // we tessellate them four times, mirroring in Z as well as X.
-            TessellatePatch(vertices, indices, patch, tessellation, scaleNegateZ, true);
-            TessellatePatch(vertices, indices, patch, tessellation, scaleNegateXZ, false);
+            TeapotPatchInstance mirrorZ = { &patch, scaleNegateZ, true };
+            TeapotPatchInstance mirrorXZ = { &patch, scaleNegateXZ, false };
+
+            instances.push_back(mirrorZ);
+            instances.push_back(mirrorXZ);
         }
     }
 
-    // Create the primitive object.
+    // Every patch has the same number of vertices and indices, so each knows where its output goes.
+    size_t verticesPerPatch = (tessellation + 1) * (tessellation + 1);
+    size_t indicesPerPatch = tessellation * tessellation * 6;
+
+    CheckIndexOverflow32(verticesPerPatch * instances.size());
+
+    vertices.resize(verticesPerPatch * instances.size());
+    indices.resize(indicesPerPatch * instances.size());
+
+    Concurrency::parallel_for(size_t(0), instances.size(), [&](size_t i)
+    {
+        TessellatePatch(&vertices[i * verticesPerPatch], &indices[i * indicesPerPatch], i * verticesPerPatch, instances[i], tessellation);
+    });
+
+    if ( !rhcoords )
+        ReverseWinding( indices, vertices );
+}
+
+        
+// Creates a teapot primitive.
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTeapot(_In_ ID3D11DeviceContext* deviceContext, float size, size_t tessellation, bool rhcoords)
+{
+    // Reuse the buffers of an identical primitive if there is one.
+    GeometryKey key(GeometryShape_Teapot, size, 0, tessellation, rhcoords);
+
     std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+
+    if (primitive->pImpl->InitializeFromCache(deviceContext, key))
+        return primitive;
+
+    VertexCollection vertices;
+    IndexCollection32 indices;
+
+    ComputeTeapot(vertices, indices, size, tessellation, rhcoords);
+
+    // Create the primitive object. The winding has already been set up for rhcoords.
+    primitive->pImpl->Initialize(deviceContext, key, vertices, indices, true);
 
     return primitive;
 }
@@ -0,0 +1,158 @@
+//--------------------------------------------------------------------------------------
+// File: GpuTimer.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+
+
+namespace DirectX
+{
+    // Measures GPU time between Start and Stop using timestamp queries. Results are read back
+    // a few frames later without stalling, so TryResolve only returns measurements that the
+    // GPU has already finished. Query results can only be read on the immediate context, so
+    // this does nothing when used with a deferred context.
+    class GpuTimer
+    {
+    public:
+        GpuTimer()
+          : mFirst(0),
+            mPending(0),
+            mTiming(false)
+        { }
+
+
+        // Marks the start of a measurement.
+        void Start(_In_ ID3D11DeviceContext* deviceContext)
+        {
+            // If the GPU is too far behind, skip this measurement rather than waiting.
+            mTiming = (mPending < MaxPending) && (deviceContext->GetType() == D3D11_DEVICE_CONTEXT_IMMEDIATE);
+
+            if (!mTiming)
+                return;
+
+            auto& measurement = mMeasurements[(mFirst + mPending) % MaxPending];
+
+            if (!measurement.disjoint)
+            {
+                CreateQueries(deviceContext, measurement);
+            }
+
+            deviceContext->Begin(measurement.disjoint.Get());
+            deviceContext->End(measurement.start.Get());
+        }
+
+
+        // Marks the end of a measurement.
+        void Stop(_In_ ID3D11DeviceContext* deviceContext)
+        {
+            if (!mTiming)
+                return;
+
+            auto& measurement = mMeasurements[(mFirst + mPending) % MaxPending];
+
+            deviceContext->End(measurement.stop.Get());
+            deviceContext->End(measurement.disjoint.Get());
+
+            mPending++;
+            mTiming = false;
+        }
+
+
+        // Returns the oldest finished measurement, if there is one. Call repeatedly to drain them all.
+        bool TryResolve(_In_ ID3D11DeviceContext* deviceContext, _Out_ double* milliseconds)
+        {
+            *milliseconds = 0;
+
+            while (mPending > 0)
+            {
+                auto& measurement = mMeasurements[mFirst];
+
+                D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+                UINT64 startTime;
+                UINT64 stopTime;
+
+                if (deviceContext->GetData(measurement.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+                    deviceContext->GetData(measurement.start.Get(), &startTime, sizeof(startTime), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+                    deviceContext->GetData(measurement.stop.Get(), &stopTime, sizeof(stopTime), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+                {
+                    return false;
+                }
+
+                mFirst = (mFirst + 1) % MaxPending;
+                mPending--;
+
+                // Timestamps are meaningless if the GPU clock changed during the measurement.
+                if (disjoint.Disjoint || !disjoint.Frequency)
+                    continue;
+
+                *milliseconds = static_cast<double>(stopTime - startTime) * 1000.0 / static_cast<double>(disjoint.Frequency);
+
+                return true;
+            }
+
+            return false;
+        }
+
+
+    private:
+        struct Measurement
+        {
+            Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+            Microsoft::WRL::ComPtr<ID3D11Query> start;
+            Microsoft::WRL::ComPtr<ID3D11Query> stop;
+        };
+
+        static void CreateQueries(_In_ ID3D11DeviceContext* deviceContext, Measurement& measurement)
+        {
+            Microsoft::WRL::ComPtr<ID3D11Device> device;
+
+            deviceContext->GetDevice(&device);
+
+            D3D11_QUERY_DESC desc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+
+            ThrowIfFailed(
+                device->CreateQuery(&desc, &measurement.disjoint)
+            );
+
+            desc.Query = D3D11_QUERY_TIMESTAMP;
+
+            ThrowIfFailed(
+                device->CreateQuery(&desc, &measurement.start)
+            );
+
+            ThrowIfFailed(
+                device->CreateQuery(&desc, &measurement.stop)
+            );
+
+            SetDebugObjectName(measurement.disjoint.Get(), "DirectXTK:GpuTimer");
+            SetDebugObjectName(measurement.start.Get(),    "DirectXTK:GpuTimer");
+            SetDebugObjectName(measurement.stop.Get(),     "DirectXTK:GpuTimer");
+        }
+
+        // How many measurements can be in flight before new ones are skipped.
+        static const size_t MaxPending = 4;
+
+        Measurement mMeasurements[MaxPending];
+
+        size_t mFirst;
+        size_t mPending;
+        bool mTiming;
+
+
+        // Prevent copying.
+        GpuTimer(GpuTimer const&) DIRECTX_CTOR_DELETE
+        GpuTimer& operator= (GpuTimer const&) DIRECTX_CTOR_DELETE
+    };
+}
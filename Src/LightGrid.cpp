@@ -0,0 +1,328 @@
+//--------------------------------------------------------------------------------------
+// File: LightGrid.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Effects.h"
+#include "ConstantBuffer.h"
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+
+// Constant buffer layout. Must match the shader!
+struct LightGridConstants
+{
+    XMMATRIX view;
+    XMMATRIX inverseProjection;
+    uint32_t tileCount[2];
+    float screenSize[2];
+    uint32_t lightCount;
+    uint32_t maxLightsPerTile;
+    uint32_t padding[2];
+};
+
+static_assert( ( sizeof(LightGridConstants) % 16 ) == 0, "CB size not padded correctly" );
+
+
+// Include the precompiled shader code.
+namespace
+{
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    #include "Shaders/Compiled/XboxOneLightGrid_CSBuildLightGrid.inc"
+#else
+    #include "Shaders/Compiled/LightGrid_CSBuildLightGrid.inc"
+#endif
+}
+
+
+// Internal LightGrid implementation class.
+class LightGrid::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device, size_t maxLights, size_t maxLightsPerTile);
+
+    void XM_CALLCONV Update(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) PointLight const* lights, size_t count,
+                            FXMMATRIX view, CXMMATRIX projection, UINT width, UINT height);
+
+    ComPtr<ID3D11Buffer> lightBuffer;
+    ComPtr<ID3D11ShaderResourceView> lightView;
+
+    ComPtr<ID3D11Buffer> tileBuffer;
+    ComPtr<ID3D11ShaderResourceView> tileView;
+    ComPtr<ID3D11UnorderedAccessView> tileAccessView;
+
+    size_t maxLights;
+    UINT tileLightStride;
+    UINT tileCountX;
+
+private:
+    void CreateTileBuffer(UINT tileCount);
+
+    ComPtr<ID3D11Device> mDevice;
+    ComPtr<ID3D11ComputeShader> mComputeShader;
+    ConstantBuffer<LightGridConstants> mConstantBuffer;
+
+    UINT mTileCapacity;
+};
+
+
+LightGrid::Impl::Impl(_In_ ID3D11Device* device, size_t maxLights, size_t maxLightsPerTile)
+  : maxLights(maxLights),
+    tileLightStride(static_cast<UINT>(maxLightsPerTile + 1)),
+    tileCountX(0),
+    mDevice(device),
+    mTileCapacity(0)
+{
+    if (!maxLights || maxLights > (UINT32_MAX / (3 * sizeof(XMFLOAT4))))
+        throw std::out_of_range("maxLights parameter out of range");
+
+    if (!maxLightsPerTile || maxLightsPerTile > MaxLightsPerTileLimit)
+        throw std::out_of_range("maxLightsPerTile parameter out of range");
+
+    if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0)
+        throw std::exception("LightGrid requires Feature Level 11.0 or greater");
+
+    ThrowIfFailed(
+        device->CreateComputeShader(LightGrid_CSBuildLightGrid, sizeof(LightGrid_CSBuildLightGrid), nullptr, &mComputeShader)
+    );
+
+    SetDebugObjectName(mComputeShader.Get(), "DirectXTK:LightGrid");
+
+    mConstantBuffer.Create(device);
+
+    // Three float4 per light: position and range, diffuse color, specular color.
+    UINT elementCount = static_cast<UINT>(maxLights * 3);
+
+    D3D11_BUFFER_DESC bufferDesc = {0};
+
+    bufferDesc.ByteWidth = elementCount * sizeof(XMFLOAT4);
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    ThrowIfFailed(
+        device->CreateBuffer(&bufferDesc, nullptr, &lightBuffer)
+    );
+
+    SetDebugObjectName(lightBuffer.Get(), "DirectXTK:LightGrid");
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+
+    viewDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    viewDesc.Buffer.FirstElement = 0;
+    viewDesc.Buffer.NumElements = elementCount;
+
+    ThrowIfFailed(
+        device->CreateShaderResourceView(lightBuffer.Get(), &viewDesc, &lightView)
+    );
+
+    SetDebugObjectName(lightView.Get(), "DirectXTK:LightGrid");
+}
+
+
+// Grows the per-tile list buffer to hold at least this many tiles. It never shrinks, so resizing back and forth is free.
+void LightGrid::Impl::CreateTileBuffer(UINT tileCount)
+{
+    if (tileCount > (UINT32_MAX / (tileLightStride * sizeof(uint32_t))))
+        throw std::out_of_range("Render target too large for LightGrid");
+
+    UINT elementCount = tileCount * tileLightStride;
+
+    tileAccessView.Reset();
+    tileView.Reset();
+    tileBuffer.Reset();
+
+    D3D11_BUFFER_DESC bufferDesc = {0};
+
+    bufferDesc.ByteWidth = elementCount * sizeof(uint32_t);
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+    ThrowIfFailed(
+        mDevice->CreateBuffer(&bufferDesc, nullptr, &tileBuffer)
+    );
+
+    SetDebugObjectName(tileBuffer.Get(), "DirectXTK:LightGrid");
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+
+    viewDesc.Format = DXGI_FORMAT_R32_UINT;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    viewDesc.Buffer.FirstElement = 0;
+    viewDesc.Buffer.NumElements = elementCount;
+
+    ThrowIfFailed(
+        mDevice->CreateShaderResourceView(tileBuffer.Get(), &viewDesc, &tileView)
+    );
+
+    SetDebugObjectName(tileView.Get(), "DirectXTK:LightGrid");
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC accessDesc = {};
+
+    accessDesc.Format = DXGI_FORMAT_R32_UINT;
+    accessDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    accessDesc.Buffer.FirstElement = 0;
+    accessDesc.Buffer.NumElements = elementCount;
+
+    ThrowIfFailed(
+        mDevice->CreateUnorderedAccessView(tileBuffer.Get(), &accessDesc, &tileAccessView)
+    );
+
+    SetDebugObjectName(tileAccessView.Get(), "DirectXTK:LightGrid");
+
+    mTileCapacity = tileCount;
+}
+
+
+void XM_CALLCONV LightGrid::Impl::Update(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) PointLight const* lights, size_t count,
+                                          FXMMATRIX view, CXMMATRIX projection, UINT width, UINT height)
+{
+    if (count > maxLights)
+        throw std::out_of_range("count parameter out of range");
+
+    if (!width || !height)
+        throw std::out_of_range("Render target size out of range");
+
+    UINT tilesX = (width + TileSize - 1) / TileSize;
+    UINT tilesY = (height + TileSize - 1) / TileSize;
+
+    if (tilesX * tilesY > mTileCapacity)
+    {
+        CreateTileBuffer(tilesX * tilesY);
+    }
+
+    tileCountX = tilesX;
+
+    // Upload the lights.
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+    ThrowIfFailed(
+        deviceContext->Map(lightBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)
+    );
+
+    auto dest = static_cast<XMFLOAT4*>(mappedResource.pData);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& light = lights[i];
+
+        *dest++ = XMFLOAT4(light.position.x, light.position.y, light.position.z, light.range);
+        *dest++ = XMFLOAT4(light.diffuseColor.x, light.diffuseColor.y, light.diffuseColor.z, 0);
+        *dest++ = XMFLOAT4(light.specularColor.x, light.specularColor.y, light.specularColor.z, 0);
+    }
+
+    deviceContext->Unmap(lightBuffer.Get(), 0);
+
+    // Set the culling parameters.
+    LightGridConstants constants;
+
+    constants.view = XMMatrixTranspose(view);
+    constants.inverseProjection = XMMatrixTranspose(XMMatrixInverse(nullptr, projection));
+    constants.tileCount[0] = tilesX;
+    constants.tileCount[1] = tilesY;
+    constants.screenSize[0] = static_cast<float>(width);
+    constants.screenSize[1] = static_cast<float>(height);
+    constants.lightCount = static_cast<uint32_t>(count);
+    constants.maxLightsPerTile = tileLightStride - 1;
+    constants.padding[0] = constants.padding[1] = 0;
+
+    mConstantBuffer.SetData(deviceContext, constants);
+
+    // Build the tile lists, one thread group per tile.
+    ID3D11Buffer* constantBuffer = mConstantBuffer.GetBuffer();
+    ID3D11ShaderResourceView* lightViews[1] = { lightView.Get() };
+    ID3D11UnorderedAccessView* tileAccessViews[1] = { tileAccessView.Get() };
+
+    deviceContext->CSSetShader(mComputeShader.Get(), nullptr, 0);
+    deviceContext->CSSetConstantBuffers(0, 1, &constantBuffer);
+    deviceContext->CSSetShaderResources(0, 1, lightViews);
+    deviceContext->CSSetUnorderedAccessViews(0, 1, tileAccessViews, nullptr);
+
+    deviceContext->Dispatch(tilesX, tilesY, 1);
+
+    // Unbind, so the tile buffer can be read by the pixel shaders.
+    ID3D11ShaderResourceView* nullViews[1] = { nullptr };
+    ID3D11UnorderedAccessView* nullAccessViews[1] = { nullptr };
+
+    deviceContext->CSSetShaderResources(0, 1, nullViews);
+    deviceContext->CSSetUnorderedAccessViews(0, 1, nullAccessViews, nullptr);
+    deviceContext->CSSetShader(nullptr, nullptr, 0);
+}
+
+
+// Public constructor.
+LightGrid::LightGrid(_In_ ID3D11Device* device, size_t maxLights, size_t maxLightsPerTile)
+  : pImpl(new Impl(device, maxLights, maxLightsPerTile))
+{
+}
+
+
+// Move constructor.
+LightGrid::LightGrid(LightGrid&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+LightGrid& LightGrid::operator= (LightGrid&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+LightGrid::~LightGrid()
+{
+}
+
+
+void XM_CALLCONV LightGrid::Update(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) PointLight const* lights, size_t count,
+                                   FXMMATRIX view, CXMMATRIX projection, UINT width, UINT height)
+{
+    pImpl->Update(deviceContext, lights, count, view, projection, width, height);
+}
+
+
+ID3D11ShaderResourceView* LightGrid::GetLightBuffer() const
+{
+    return pImpl->lightView.Get();
+}
+
+
+ID3D11ShaderResourceView* LightGrid::GetTileBuffer() const
+{
+    return pImpl->tileView.Get();
+}
+
+
+UINT LightGrid::GetTileCountX() const
+{
+    return pImpl->tileCountX;
+}
+
+
+UINT LightGrid::GetTileLightStride() const
+{
+    return pImpl->tileLightStride;
+}
+
+
+size_t LightGrid::GetMaxLights() const
+{
+    return pImpl->maxLights;
+}
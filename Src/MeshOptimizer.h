@@ -0,0 +1,456 @@
+//--------------------------------------------------------------------------------------
+// File: MeshOptimizer.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+#include "PlatformHelpers.h"
+
+#include <algorithm>
+#include <vector>
+
+
+namespace DirectX
+{
+    // Used by the model loaders for the optional optimizeMesh step. Each triangle list is reordered for the
+    // post-transform vertex cache with Tom Forsyth's linear-speed algorithm, then split into clusters wherever
+    // the cache starts cold, and the clusters sorted outside-in to reduce overdraw (after Sander, Nehab and
+    // Barczak). VertexRemap then renumbers the vertices in the order they are first used, so fetches walk the
+    // vertex buffer forwards.
+    //
+    // ACMR before and after is measured with a FIFO cache of FifoCacheSize entries, and summed over every
+    // triangle list the optimizer sees.
+    class MeshOptimizer
+    {
+    public:
+        // Cache size used to measure ACMR, and the larger LRU cache the Forsyth scoring models.
+        static const size_t FifoCacheSize = 16;
+        static const size_t LruCacheSize = 32;
+
+        MeshOptimizer()
+          : mTriangles(0),
+            mMissesBefore(0),
+            mMissesAfter(0)
+        { }
+
+
+        // Reorders one triangle list in place. Positions and normals are float3 read at the given byte stride.
+        // Without normals the overdraw pass is skipped, so only the vertex cache order is applied.
+        template<typename TIndex>
+        void OptimizeFaces(_Inout_updates_(indexCount) TIndex* indices, size_t indexCount, size_t vertexCount,
+                           _In_ const uint8_t* positions, _In_opt_ const uint8_t* normals, size_t stride)
+        {
+            size_t triangleCount = indexCount / 3;
+
+            if (!triangleCount)
+                return;
+
+            std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+
+            for (auto it = source.cbegin(); it != source.cend(); ++it)
+            {
+                if (*it >= vertexCount)
+                    throw std::exception("Invalid index found");
+            }
+
+            mTriangles += triangleCount;
+            mMissesBefore += CountCacheMisses(source, vertexCount);
+
+            std::vector<uint32_t> result;
+
+            ReorderForVertexCache(source, vertexCount, result);
+
+            if (normals)
+            {
+                SortClustersForOverdraw(result, vertexCount, positions, normals, stride);
+            }
+
+            mMissesAfter += CountCacheMisses(result, vertexCount);
+
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                indices[i] = static_cast<TIndex>(result[i]);
+            }
+        }
+
+
+        void GetStatistics(ModelOptimizationStatistics& stats) const
+        {
+            stats.triangles = mTriangles;
+            stats.acmrBefore = mTriangles ? static_cast<float>(mMissesBefore) / static_cast<float>(mTriangles) : 0.f;
+            stats.acmrAfter = mTriangles ? static_cast<float>(mMissesAfter) / static_cast<float>(mTriangles) : 0.f;
+        }
+
+
+        // Renumbers the vertices of one vertex buffer in order of first use. Every index range that points into the
+        // buffer must go through RemapIndices exactly once, then RemapVertices moves the vertex data to match.
+        class VertexRemap
+        {
+        public:
+            explicit VertexRemap(size_t vertexCount)
+              : mRemap(vertexCount, UINT32_MAX),
+                mNext(0)
+            { }
+
+            template<typename TIndex>
+            void RemapIndices(_Inout_updates_(indexCount) TIndex* indices, size_t indexCount)
+            {
+                for (size_t i = 0; i < indexCount; ++i)
+                {
+                    size_t v = indices[i];
+
+                    if (v >= mRemap.size())
+                        throw std::exception("Invalid index found");
+
+                    if (mRemap[v] == UINT32_MAX)
+                    {
+                        mRemap[v] = mNext++;
+                    }
+
+                    indices[i] = static_cast<TIndex>(mRemap[v]);
+                }
+            }
+
+            // Vertices that no index used keep their relative order at the end of the buffer.
+            void RemapVertices(_Inout_ uint8_t* vertices, size_t stride)
+            {
+                for (auto it = mRemap.begin(); it != mRemap.end(); ++it)
+                {
+                    if (*it == UINT32_MAX)
+                    {
+                        *it = mNext++;
+                    }
+                }
+
+                size_t bytes = stride * mRemap.size();
+
+                std::unique_ptr<uint8_t[]> copy(new uint8_t[bytes]);
+
+                memcpy(copy.get(), vertices, bytes);
+
+                for (size_t v = 0; v < mRemap.size(); ++v)
+                {
+                    memcpy(vertices + mRemap[v] * stride, copy.get() + v * stride, stride);
+                }
+            }
+
+        private:
+            std::vector<uint32_t> mRemap;
+            uint32_t mNext;
+        };
+
+
+    private:
+        // FIFO cache simulation, counting the vertices each triangle has to transform.
+        static size_t CountCacheMisses(std::vector<uint32_t> const& indices, size_t vertexCount)
+        {
+            std::vector<size_t> cacheTime(vertexCount, 0);
+
+            size_t time = FifoCacheSize + 1;
+            size_t misses = 0;
+
+            for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+            {
+                if (time - cacheTime[*it] > FifoCacheSize)
+                {
+                    cacheTime[*it] = time++;
+                    ++misses;
+                }
+            }
+
+            return misses;
+        }
+
+
+        static float VertexScore(int cachePosition, uint32_t liveTriangles)
+        {
+            if (!liveTriangles)
+                return -1.f;
+
+            float score = 0.f;
+
+            if (cachePosition >= 0)
+            {
+                // Vertices of the last triangle get a fixed score, so the next triangle isn't forced to share an edge.
+                if (cachePosition < 3)
+                {
+                    score = 0.75f;
+                }
+                else
+                {
+                    score = 1.f - static_cast<float>(cachePosition - 3) / static_cast<float>(LruCacheSize - 3);
+                    score = powf(score, 1.5f);
+                }
+            }
+
+            // Favor vertices with few triangles left, so they get finished off rather than stranded.
+            score += 2.f / sqrtf(static_cast<float>(liveTriangles));
+
+            return score;
+        }
+
+
+        static void ReorderForVertexCache(std::vector<uint32_t> const& indices, size_t vertexCount, std::vector<uint32_t>& result)
+        {
+            size_t triangleCount = indices.size() / 3;
+
+            // The triangles still to emit for each vertex, as a range of one shared array.
+            std::vector<uint32_t> liveTriangles(vertexCount, 0);
+
+            for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+            {
+                liveTriangles[*it]++;
+            }
+
+            std::vector<uint32_t> firstTriangle(vertexCount, 0);
+
+            for (size_t v = 1; v < vertexCount; ++v)
+            {
+                firstTriangle[v] = firstTriangle[v - 1] + liveTriangles[v - 1];
+            }
+
+            std::vector<uint32_t> vertexTriangles(indices.size());
+
+            {
+                std::vector<uint32_t> fill(firstTriangle);
+
+                for (size_t i = 0; i < indices.size(); ++i)
+                {
+                    vertexTriangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+                }
+            }
+
+            std::vector<int> cachePosition(vertexCount, -1);
+            std::vector<float> vertexScore(vertexCount);
+
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                vertexScore[v] = VertexScore(-1, liveTriangles[v]);
+            }
+
+            std::vector<float> triangleScore(triangleCount);
+            std::vector<uint8_t> emitted(triangleCount, 0);
+
+            size_t best = 0;
+
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+                if (triangleScore[t] > triangleScore[best])
+                    best = t;
+            }
+
+            uint32_t cache[LruCacheSize + 3];
+            size_t cacheCount = 0;
+
+            size_t deadEndCursor = 0;
+
+            result.clear();
+            result.reserve(indices.size());
+
+            for (;;)
+            {
+                emitted[best] = 1;
+
+                const uint32_t* triangle = &indices[best * 3];
+
+                result.insert(result.end(), triangle, triangle + 3);
+
+                if (result.size() == indices.size())
+                    break;
+
+                // Take the triangle off each of its vertices' live lists.
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    uint32_t v = triangle[k];
+
+                    auto begin = vertexTriangles.begin() + firstTriangle[v];
+                    auto end = begin + liveTriangles[v];
+
+                    auto it = std::find(begin, end, static_cast<uint32_t>(best));
+
+                    assert(it != end);
+
+                    std::iter_swap(it, end - 1);
+                    liveTriangles[v]--;
+                }
+
+                // Move its vertices to the front of the LRU cache.
+                uint32_t newCache[LruCacheSize + 3];
+                size_t newCount = 0;
+
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    newCache[newCount++] = triangle[k];
+                }
+
+                for (size_t i = 0; i < cacheCount; ++i)
+                {
+                    uint32_t v = cache[i];
+
+                    if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                        newCache[newCount++] = v;
+                }
+
+                for (size_t i = 0; i < newCount; ++i)
+                {
+                    uint32_t v = newCache[i];
+
+                    cachePosition[v] = (i < LruCacheSize) ? static_cast<int>(i) : -1;
+                    vertexScore[v] = VertexScore(cachePosition[v], liveTriangles[v]);
+                }
+
+                // Rescore the triangles touching the cache, and take the best of them next.
+                float bestScore = -1.f;
+                bool found = false;
+
+                for (size_t i = 0; i < newCount; ++i)
+                {
+                    uint32_t v = newCache[i];
+
+                    auto begin = vertexTriangles.cbegin() + firstTriangle[v];
+                    auto end = begin + liveTriangles[v];
+
+                    for (auto it = begin; it != end; ++it)
+                    {
+                        size_t t = *it;
+
+                        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+                        if (triangleScore[t] > bestScore)
+                        {
+                            bestScore = triangleScore[t];
+                            best = t;
+                            found = true;
+                        }
+                    }
+                }
+
+                cacheCount = std::min(newCount, LruCacheSize);
+                memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+                if (!found)
+                {
+                    // Nothing left next to the cache, so carry on with the first triangle not yet emitted.
+                    while (emitted[deadEndCursor])
+                    {
+                        ++deadEndCursor;
+                    }
+
+                    best = deadEndCursor;
+                }
+            }
+        }
+
+
+        // Clusters start wherever the FIFO simulation misses all three vertices of a triangle, so moving them around
+        // costs little cache efficiency. Clusters facing away from the mesh center are drawn first, as they are the
+        // most likely to occlude the rest.
+        static void SortClustersForOverdraw(std::vector<uint32_t>& indices, size_t vertexCount,
+                                            _In_ const uint8_t* positions, _In_ const uint8_t* normals, size_t stride)
+        {
+            struct Cluster
+            {
+                size_t start;
+                size_t count;
+                float sortKey;
+            };
+
+            std::vector<Cluster> clusters;
+
+            {
+                std::vector<size_t> cacheTime(vertexCount, 0);
+
+                size_t time = FifoCacheSize + 1;
+
+                for (size_t i = 0; i < indices.size(); i += 3)
+                {
+                    size_t misses = 0;
+
+                    for (size_t k = 0; k < 3; ++k)
+                    {
+                        uint32_t v = indices[i + k];
+
+                        if (time - cacheTime[v] > FifoCacheSize)
+                        {
+                            cacheTime[v] = time++;
+                            ++misses;
+                        }
+                    }
+
+                    if (misses == 3 || clusters.empty())
+                    {
+                        Cluster cluster = { i, 0, 0.f };
+                        clusters.push_back(cluster);
+                    }
+
+                    clusters.back().count += 3;
+                }
+            }
+
+            if (clusters.size() < 2)
+                return;
+
+            XMVECTOR meshCenter = XMVectorZero();
+
+            for (auto it = indices.cbegin(); it != indices.cend(); ++it)
+            {
+                meshCenter += XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + *it * stride));
+            }
+
+            meshCenter /= static_cast<float>(indices.size());
+
+            for (auto it = clusters.begin(); it != clusters.end(); ++it)
+            {
+                XMVECTOR center = XMVectorZero();
+                XMVECTOR normal = XMVectorZero();
+
+                for (size_t i = it->start; i < it->start + it->count; ++i)
+                {
+                    center += XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + indices[i] * stride));
+                    normal += XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(normals + indices[i] * stride));
+                }
+
+                center /= static_cast<float>(it->count);
+
+                it->sortKey = XMVectorGetX(XMVector3Dot(center - meshCenter, XMVector3Normalize(normal)));
+            }
+
+            std::stable_sort(clusters.begin(), clusters.end(), [](Cluster const& a, Cluster const& b)
+            {
+                return a.sortKey > b.sortKey;
+            });
+
+            std::vector<uint32_t> sorted;
+            sorted.reserve(indices.size());
+
+            for (auto it = clusters.cbegin(); it != clusters.cend(); ++it)
+            {
+                sorted.insert(sorted.end(), indices.begin() + it->start, indices.begin() + it->start + it->count);
+            }
+
+            indices.swap(sorted);
+        }
+
+
+        size_t mTriangles;
+        size_t mMissesBefore;
+        size_t mMissesAfter;
+
+
+        // Prevent copying.
+        MeshOptimizer(MeshOptimizer const&) DIRECTX_CTOR_DELETE
+        MeshOptimizer& operator= (MeshOptimizer const&) DIRECTX_CTOR_DELETE
+    };
+}
@@ -18,13 +18,48 @@
 #include "DirectXHelpers.h"
 #include "Effects.h"
 #include "PlatformHelpers.h"
+#include "ScopedInstrumentationEvent.h"
 
 using namespace DirectX;
+using Microsoft::WRL::ComPtr;
 
 #ifndef _CPPRTTI 
 #error Model requires RTTI
 #endif
 
+namespace
+{
+    // Per-instance transform used by instanced drawing: the first three columns of the world matrix.
+    struct ModelInstance
+    {
+        XMFLOAT4 column[3];
+    };
+
+    const D3D11_INPUT_ELEMENT_DESC s_instanceElements[] =
+    {
+        { "INSTMATRIX", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTMATRIX", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        { "INSTMATRIX", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    };
+}
+
+//--------------------------------------------------------------------------------------
+// ModelMaterial
+//--------------------------------------------------------------------------------------
+
+ModelMaterial::ModelMaterial() :
+    perVertexColor(false),
+    enableSkinning(false),
+    specularPower(0),
+    alpha(1.f),
+    ambientColor(0, 0, 0),
+    diffuseColor(0, 0, 0),
+    specularColor(0, 0, 0),
+    emissiveColor(0, 0, 0)
+{
+}
+
+
 //--------------------------------------------------------------------------------------
 // ModelMeshPart
 //--------------------------------------------------------------------------------------
@@ -70,6 +105,37 @@ void ModelMeshPart::Draw( ID3D11DeviceContext* deviceContext, IEffect* ieffect,
 }
 
 
+_Use_decl_annotations_
+void ModelMeshPart::DrawInstanced( ID3D11DeviceContext* deviceContext, IEffect* ieffect, ID3D11InputLayout* iinputLayout,
+                                   ID3D11Buffer* instanceBuffer, UINT instanceStride, UINT instanceCount, UINT startInstance,
+                                   std::function<void()> setCustomState ) const
+{
+    deviceContext->IASetInputLayout( iinputLayout );
+
+    ID3D11Buffer* vbs[2] = { vertexBuffer.Get(), instanceBuffer };
+    UINT vbStrides[2] = { vertexStride, instanceStride };
+    UINT vbOffsets[2] = { 0, 0 };
+    deviceContext->IASetVertexBuffers( 0, 2, vbs, vbStrides, vbOffsets );
+
+    // Note that if indexFormat is DXGI_FORMAT_R32_UINT, this model mesh part requires a Feature Level 9.2 or greater device
+    deviceContext->IASetIndexBuffer( indexBuffer.Get(), indexFormat, 0 );
+
+    assert( ieffect != 0 );
+    ieffect->Apply( deviceContext );
+
+    // Hook lets the caller replace our shaders or state settings with whatever else they see fit.
+    if ( setCustomState )
+    {
+        setCustomState();
+    }
+
+    // Draw the primitive.
+    deviceContext->IASetPrimitiveTopology( primitiveType );
+
+    deviceContext->DrawIndexedInstanced( indexCount, instanceCount, startIndex, vertexOffset, startInstance );
+}
+
+
 _Use_decl_annotations_
 void ModelMeshPart::CreateInputLayout( ID3D11Device* d3dDevice, IEffect* ieffect, ID3D11InputLayout** iinputLayout )
 {
@@ -93,6 +159,33 @@ void ModelMeshPart::CreateInputLayout( ID3D11Device* d3dDevice, IEffect* ieffect
 }
 
 
+_Use_decl_annotations_
+void ModelMeshPart::CreateInstancedInputLayout( ID3D11Device* d3dDevice, IEffect* ieffect, ID3D11InputLayout** iinputLayout )
+{
+    if ( !vbDecl || vbDecl->empty() )
+        throw std::exception("Model mesh part missing vertex buffer input elements data");
+
+    // The per-instance transform comes from a second vertex buffer.
+    std::vector<D3D11_INPUT_ELEMENT_DESC> decl( vbDecl->cbegin(), vbDecl->cend() );
+    decl.insert( decl.end(), s_instanceElements, s_instanceElements + _countof(s_instanceElements) );
+
+    void const* shaderByteCode;
+    size_t byteCodeLength;
+
+    assert( ieffect != 0 );
+    ieffect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
+
+    assert( d3dDevice != 0 );
+
+    ThrowIfFailed(
+        d3dDevice->CreateInputLayout(&decl.front(),
+                                     static_cast<UINT>( decl.size() ),
+                                     shaderByteCode, byteCodeLength,
+                                     iinputLayout )
+    );
+}
+
+
 _Use_decl_annotations_
 void ModelMeshPart::ModifyEffect( ID3D11Device* d3dDevice, std::shared_ptr<IEffect>& ieffect, bool isalpha )
 {
@@ -186,6 +279,16 @@ void XM_CALLCONV ModelMesh::Draw( ID3D11DeviceContext* deviceContext,
 {
     assert( deviceContext != 0 );
 
+    // Consecutive parts often share an input layout and buffers (always the buffers, for models loaded with
+    // mergeBuffers), so these are only bound when they change. The custom state hook may bind its own, so
+    // everything is rebound for each part when there is one.
+    ID3D11InputLayout* currentLayout = nullptr;
+    ID3D11Buffer* currentVB = nullptr;
+    ID3D11Buffer* currentIB = nullptr;
+    UINT currentStride = 0;
+    DXGI_FORMAT currentFormat = DXGI_FORMAT_UNKNOWN;
+    D3D_PRIMITIVE_TOPOLOGY currentTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
     for ( auto it = meshParts.cbegin(); it != meshParts.cend(); ++it )
     {
         auto part = (*it).get();
@@ -205,8 +308,177 @@ void XM_CALLCONV ModelMesh::Draw( ID3D11DeviceContext* deviceContext,
             imatrices->SetProjection( projection );
         }
 
-        part->Draw( deviceContext, part->effect.get(), part->inputLayout.Get(), setCustomState );
+        if ( setCustomState )
+        {
+            part->Draw( deviceContext, part->effect.get(), part->inputLayout.Get(), setCustomState );
+            continue;
+        }
+
+        if ( part->inputLayout.Get() != currentLayout )
+        {
+            currentLayout = part->inputLayout.Get();
+            deviceContext->IASetInputLayout( currentLayout );
+        }
+
+        if ( part->vertexBuffer.Get() != currentVB || part->vertexStride != currentStride )
+        {
+            currentVB = part->vertexBuffer.Get();
+            currentStride = part->vertexStride;
+
+            UINT vbOffset = 0;
+            deviceContext->IASetVertexBuffers( 0, 1, &currentVB, &currentStride, &vbOffset );
+        }
+
+        if ( part->indexBuffer.Get() != currentIB || part->indexFormat != currentFormat )
+        {
+            currentIB = part->indexBuffer.Get();
+            currentFormat = part->indexFormat;
+
+            // Note that if indexFormat is DXGI_FORMAT_R32_UINT, this model mesh part requires a Feature Level 9.2 or greater device
+            deviceContext->IASetIndexBuffer( currentIB, currentFormat, 0 );
+        }
+
+        assert( part->effect != 0 );
+        part->effect->Apply( deviceContext );
+
+        if ( part->primitiveType != currentTopology )
+        {
+            currentTopology = part->primitiveType;
+            deviceContext->IASetPrimitiveTopology( currentTopology );
+        }
+
+        deviceContext->DrawIndexed( part->indexCount, part->startIndex, part->vertexOffset );
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// ModelInstanceCache
+//--------------------------------------------------------------------------------------
+
+// Internal ModelInstanceCache implementation class.
+class ModelInstanceCache::Impl
+{
+public:
+    Impl()
+      : instanceBufferCount(0)
+    { }
+
+    ID3D11InputLayout* GetInputLayout( _In_ ID3D11Device* device, _In_ ModelMeshPart* part, _In_ IEffect* effect );
+
+    void UploadTransforms( _In_ ID3D11DeviceContext* deviceContext, _In_ ID3D11Device* device, _In_reads_(count) XMMATRIX const* worlds, size_t count );
+
+    // An instanced layout only depends on the part's vertex declaration and the effect's vertex shader. The entry keeps
+    // the declaration alive, so its address cannot be reused by another part while the layout is cached here.
+    struct LayoutEntry
+    {
+        std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> vbDecl;
+        ComPtr<ID3D11InputLayout> inputLayout;
+    };
+
+    typedef std::pair<std::vector<D3D11_INPUT_ELEMENT_DESC> const*, void const*> LayoutKey;
+
+    std::map<LayoutKey, LayoutEntry> inputLayouts;
+
+    // Per-instance transforms, grown as needed.
+    ComPtr<ID3D11Buffer> instanceBuffer;
+    size_t instanceBufferCount;
+};
+
+
+_Use_decl_annotations_
+ID3D11InputLayout* ModelInstanceCache::Impl::GetInputLayout( ID3D11Device* device, ModelMeshPart* part, IEffect* effect )
+{
+    void const* shaderByteCode;
+    size_t byteCodeLength;
+
+    effect->GetVertexShaderBytecode( &shaderByteCode, &byteCodeLength );
+
+    auto& entry = inputLayouts[ LayoutKey( part->vbDecl.get(), shaderByteCode ) ];
+
+    if ( !entry.inputLayout )
+    {
+        part->CreateInstancedInputLayout( device, effect, &entry.inputLayout );
+        entry.vbDecl = part->vbDecl;
+    }
+
+    return entry.inputLayout.Get();
+}
+
+
+_Use_decl_annotations_
+void ModelInstanceCache::Impl::UploadTransforms( ID3D11DeviceContext* deviceContext, ID3D11Device* device, XMMATRIX const* worlds, size_t count )
+{
+    if ( !instanceBuffer || instanceBufferCount < count )
+    {
+        CD3D11_BUFFER_DESC desc( static_cast<UINT>( count * sizeof(ModelInstance) ), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE );
+
+        instanceBuffer.Reset();
+        instanceBufferCount = 0;
+
+        ThrowIfFailed(
+            device->CreateBuffer( &desc, nullptr, &instanceBuffer )
+        );
+
+        SetDebugObjectName( instanceBuffer.Get(), "ModelInstances" );
+
+        instanceBufferCount = count;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+
+    ThrowIfFailed(
+        deviceContext->Map( instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped )
+    );
+
+    auto instances = reinterpret_cast<ModelInstance*>( mapped.pData );
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        XMMATRIX transpose = XMMatrixTranspose( worlds[i] );
+
+        XMStoreFloat4( &instances[i].column[0], transpose.r[0] );
+        XMStoreFloat4( &instances[i].column[1], transpose.r[1] );
+        XMStoreFloat4( &instances[i].column[2], transpose.r[2] );
     }
+
+    deviceContext->Unmap( instanceBuffer.Get(), 0 );
+}
+
+
+// Public constructor.
+ModelInstanceCache::ModelInstanceCache()
+  : pImpl(new Impl())
+{
+}
+
+
+// Move constructor.
+ModelInstanceCache::ModelInstanceCache(ModelInstanceCache&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+ModelInstanceCache& ModelInstanceCache::operator= (ModelInstanceCache&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+ModelInstanceCache::~ModelInstanceCache()
+{
+}
+
+
+void ModelInstanceCache::Clear()
+{
+    pImpl->inputLayouts.clear();
+    pImpl->instanceBuffer.Reset();
+    pImpl->instanceBufferCount = 0;
 }
 
 
@@ -221,12 +493,52 @@ void XM_CALLCONV Model::Draw( ID3D11DeviceContext* deviceContext, CommonStates&
 {
     assert( deviceContext != 0 );
 
+    ScopedInstrumentationEvent event( InstrumentationCategory_Model, L"Model::Draw", name.c_str(), 0, meshes.size(), deviceContext );
+
+    // Draw opaque parts
+    for( auto it = meshes.cbegin(); it != meshes.cend(); ++it )
+    {
+        auto mesh = it->get();
+        assert( mesh != 0 );
+
+        mesh->PrepareForRendering( deviceContext, states, false, wireframe );
+
+        mesh->Draw( deviceContext, world, view, projection, false, setCustomState );
+    }
+
+    // Draw alpha parts
+    for( auto it = meshes.cbegin(); it != meshes.cend(); ++it )
+    {
+        auto mesh = it->get();
+        assert( mesh != 0 );
+
+        mesh->PrepareForRendering( deviceContext, states, true, wireframe );
+
+        mesh->Draw( deviceContext, world, view, projection, true, setCustomState );
+    }
+}
+
+
+_Use_decl_annotations_
+void XM_CALLCONV Model::DrawCulled( ID3D11DeviceContext* deviceContext, CommonStates& states,
+                                    FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                                    bool wireframe, std::function<void()> setCustomState ) const
+{
+    assert( deviceContext != 0 );
+
+    ScopedInstrumentationEvent event( InstrumentationCategory_Model, L"Model::DrawCulled", name.c_str(), 0, meshes.size(), deviceContext );
+
+    ModelCuller culler( view, projection );
+
     // Draw opaque parts
     for( auto it = meshes.cbegin(); it != meshes.cend(); ++it )
     {
         auto mesh = it->get();
         assert( mesh != 0 );
 
+        if ( !culler.IsVisible( *mesh, world ) )
+            continue;
+
         mesh->PrepareForRendering( deviceContext, states, false, wireframe );
 
         mesh->Draw( deviceContext, world, view, projection, false, setCustomState );
@@ -238,6 +550,9 @@ void XM_CALLCONV Model::Draw( ID3D11DeviceContext* deviceContext, CommonStates&
         auto mesh = it->get();
         assert( mesh != 0 );
 
+        if ( !culler.IsVisible( *mesh, world ) )
+            continue;
+
         mesh->PrepareForRendering( deviceContext, states, true, wireframe );
 
         mesh->Draw( deviceContext, world, view, projection, true, setCustomState );
@@ -245,6 +560,121 @@ void XM_CALLCONV Model::Draw( ID3D11DeviceContext* deviceContext, CommonStates&
 }
 
 
+// Skinned vertices can't also take a per-instance transform, since the bone palette is per-draw.
+static bool IsSkinnedPart( _In_ ModelMeshPart const* part )
+{
+    if ( !part->vbDecl )
+        return false;
+
+    for ( auto it = part->vbDecl->cbegin(); it != part->vbDecl->cend(); ++it )
+    {
+        if ( _stricmp( it->SemanticName, "BLENDINDICES" ) == 0 )
+            return true;
+    }
+
+    return false;
+}
+
+
+_Use_decl_annotations_
+void XM_CALLCONV Model::DrawInstanced( ID3D11DeviceContext* deviceContext, CommonStates& states, ModelInstanceCache& cache,
+                                       XMMATRIX const* worlds, size_t count,
+                                       CXMMATRIX view, CXMMATRIX projection,
+                                       bool wireframe, std::function<void()> setCustomState ) const
+{
+    assert( deviceContext != 0 );
+
+    if ( !count )
+        return;
+
+    if ( !worlds )
+        throw std::exception("Instance world matrices cannot be null");
+
+    ScopedInstrumentationEvent event( InstrumentationCategory_Model, L"Model::DrawInstanced", name.c_str(), 0, count, deviceContext );
+
+    if ( count > UINT32_MAX / sizeof(ModelInstance) )
+        throw std::out_of_range("Too many instances");
+
+    ComPtr<ID3D11Device> device;
+    deviceContext->GetDevice( &device );
+
+    // Instanced input layouts require Feature Level 9.3 or greater
+    bool canInstance = ( device->GetFeatureLevel() >= D3D_FEATURE_LEVEL_9_3 );
+
+    auto& instanceCache = *cache.pImpl;
+
+    if ( canInstance )
+    {
+        // Upload all the transforms once, to be shared by every mesh part.
+        instanceCache.UploadTransforms( deviceContext, device.Get(), worlds, count );
+    }
+
+    // Draw opaque parts, then alpha parts
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        bool alpha = ( pass > 0 );
+
+        for( auto mit = meshes.cbegin(); mit != meshes.cend(); ++mit )
+        {
+            auto mesh = mit->get();
+            assert( mesh != 0 );
+
+            mesh->PrepareForRendering( deviceContext, states, alpha, wireframe );
+
+            for ( auto it = mesh->meshParts.cbegin(); it != mesh->meshParts.cend(); ++it )
+            {
+                auto part = it->get();
+                assert( part != 0 );
+
+                if ( part->isAlpha != alpha )
+                    continue;
+
+                auto effect = part->effect.get();
+                assert( effect != 0 );
+
+                auto imatrices = dynamic_cast<IEffectMatrices*>( effect );
+                auto iinstancing = dynamic_cast<IEffectInstancing*>( effect );
+
+                if ( canInstance && iinstancing && !IsSkinnedPart( part ) )
+                {
+                    // The per-instance transform does all the work, so the effect's own world matrix is left as identity
+                    if ( imatrices )
+                    {
+                        imatrices->SetWorld( XMMatrixIdentity() );
+                        imatrices->SetView( view );
+                        imatrices->SetProjection( projection );
+                    }
+
+                    iinstancing->SetInstancingEnabled( true );
+
+                    auto inputLayout = instanceCache.GetInputLayout( device.Get(), part, effect );
+
+                    part->DrawInstanced( deviceContext, effect, inputLayout,
+                                         instanceCache.instanceBuffer.Get(), sizeof(ModelInstance), static_cast<UINT>( count ), 0, setCustomState );
+
+                    iinstancing->SetInstancingEnabled( false );
+                }
+                else
+                {
+                    // Fall back to drawing each copy in turn
+                    for ( size_t i = 0; i < count; ++i )
+                    {
+                        if ( imatrices )
+                        {
+                            imatrices->SetWorld( worlds[i] );
+                            imatrices->SetView( view );
+                            imatrices->SetProjection( projection );
+                        }
+
+                        part->Draw( deviceContext, effect, part->inputLayout.Get(), setCustomState );
+                    }
+                }
+            }
+        }
+    }
+}
+
+
 void Model::UpdateEffects( _In_ std::function<void(IEffect*)> setEffect )
 {
     if ( mEffectCache.empty() )
@@ -270,3 +700,611 @@ void Model::UpdateEffects( _In_ std::function<void(IEffect*)> setEffect )
         setEffect( *it );
     }
 }
+
+
+std::unique_ptr<Model> Model::CloneWithEffects() const
+{
+    std::unique_ptr<Model> model(new Model());
+    model->name = name;
+    model->optimizationStatistics = optimizationStatistics;
+    model->meshes.reserve( meshes.size() );
+
+    // Parts which shared an effect share its clone.
+    std::map<IEffect*, std::shared_ptr<IEffect>> clones;
+
+    for( auto it = meshes.cbegin(); it != meshes.cend(); ++it )
+    {
+        auto source = it->get();
+        assert( source != 0 );
+
+        auto mesh = std::make_shared<ModelMesh>();
+        mesh->boundingSphere = source->boundingSphere;
+        mesh->boundingBox = source->boundingBox;
+        mesh->name = source->name;
+        mesh->ccw = source->ccw;
+        mesh->pmalpha = source->pmalpha;
+        mesh->meshParts.reserve( source->meshParts.size() );
+
+        for( auto jt = source->meshParts.cbegin(); jt != source->meshParts.cend(); ++jt )
+        {
+            std::unique_ptr<ModelMeshPart> part( new ModelMeshPart( **jt ) );
+
+            if ( part->effect )
+            {
+                auto& clone = clones[ part->effect.get() ];
+
+                if ( !clone )
+                {
+                    auto icopy = dynamic_cast<IEffectClone*>( part->effect.get() );
+                    if ( !icopy )
+                        throw std::exception("CloneWithEffects needs effects which support IEffectClone");
+
+                    clone = icopy->Clone();
+                }
+
+                part->effect = clone;
+            }
+
+            mesh->meshParts.push_back( std::move(part) );
+        }
+
+        model->meshes.push_back( mesh );
+    }
+
+    return model;
+}
+
+
+//--------------------------------------------------------------------------------------
+// ModelLOD
+//--------------------------------------------------------------------------------------
+
+ModelLOD::ModelLOD() :
+    mHysteresis(0.1f)
+{
+}
+
+
+void ModelLOD::AddLevel( _In_ std::shared_ptr<Model> model, float minScreenSize )
+{
+    if ( !model )
+        throw std::exception("ModelLOD level cannot be null");
+
+    if ( !mLevels.empty() && minScreenSize > mLevels.back().minScreenSize )
+        throw std::exception("ModelLOD levels must be added from most to least detailed");
+
+    // All levels are selected using the bounds of the most detailed one
+    if ( mLevels.empty() )
+    {
+        bool first = true;
+
+        for( auto it = model->meshes.cbegin(); it != model->meshes.cend(); ++it )
+        {
+            auto mesh = it->get();
+            assert( mesh != 0 );
+
+            if ( first )
+            {
+                mBounds = mesh->boundingSphere;
+                first = false;
+            }
+            else
+            {
+                BoundingSphere::CreateMerged( mBounds, mBounds, mesh->boundingSphere );
+            }
+        }
+    }
+
+    Level level;
+    level.model = model;
+    level.minScreenSize = minScreenSize;
+
+    mLevels.push_back( level );
+}
+
+
+float XM_CALLCONV ModelLOD::GetScreenSize( FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection ) const
+{
+    BoundingSphere sphere;
+    mBounds.Transform( sphere, world );
+
+    // Normalized device coordinates span 2 units, so the projected radius is the diameter's fraction of the viewport height.
+    float scale = XMVectorGetY( projection.r[1] ) * sphere.Radius;
+
+    // A perspective projection divides by view space depth, while an orthographic one does not.
+    if ( XMVectorGetW( projection.r[2] ) != 0.f )
+    {
+        XMVECTOR center = XMVector3TransformCoord( XMLoadFloat3( &sphere.Center ), view );
+
+        float depth = std::max( fabsf( XMVectorGetZ( center ) ), sphere.Radius );
+
+        scale /= depth;
+    }
+
+    return scale;
+}
+
+
+size_t XM_CALLCONV ModelLOD::SelectLevel( FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, size_t previousLevel ) const
+{
+    if ( mLevels.empty() )
+        throw std::exception("ModelLOD has no levels");
+
+    float size = GetScreenSize( world, view, projection );
+
+    size_t last = mLevels.size() - 1;
+
+    size_t level = 0;
+    while ( level < last && size < mLevels[ level ].minScreenSize )
+    {
+        ++level;
+    }
+
+    if ( previousLevel <= last && level != previousLevel )
+    {
+        if ( level < previousLevel )
+        {
+            // Only gain detail once clearly past the threshold of the next more detailed level
+            if ( size < mLevels[ previousLevel - 1 ].minScreenSize * ( 1.f + mHysteresis ) )
+                level = previousLevel;
+        }
+        else
+        {
+            // Only lose detail once clearly below the previous level's threshold
+            if ( size >= mLevels[ previousLevel ].minScreenSize * ( 1.f - mHysteresis ) )
+                level = previousLevel;
+        }
+    }
+
+    return level;
+}
+
+
+_Use_decl_annotations_
+void XM_CALLCONV ModelLOD::Draw( ID3D11DeviceContext* deviceContext, CommonStates& states,
+                                 FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                                 size_t* level, bool wireframe, std::function<void()> setCustomState ) const
+{
+    size_t index = SelectLevel( world, view, projection, ( level ) ? *level : size_t(-1) );
+
+    if ( level )
+    {
+        *level = index;
+    }
+
+    mLevels[ index ].model->Draw( deviceContext, states, world, view, projection, wireframe, setCustomState );
+}
+
+
+void ModelLOD::UpdateEffects( _In_ std::function<void(IEffect*)> setEffect )
+{
+    assert( setEffect != 0 );
+
+    // Levels loaded from the same factory share effects, so only visit each one once
+    std::set<IEffect*> effects;
+
+    for( auto it = mLevels.cbegin(); it != mLevels.cend(); ++it )
+    {
+        it->model->UpdateEffects( [&](IEffect* effect)
+        {
+            effects.insert( effect );
+        });
+    }
+
+    for( auto it = effects.begin(); it != effects.end(); ++it )
+    {
+        setEffect( *it );
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// ModelCuller
+//--------------------------------------------------------------------------------------
+
+ModelCuller::ModelCuller( CXMMATRIX view, CXMMATRIX projection )
+{
+    SetCamera( view, projection );
+}
+
+
+void XM_CALLCONV ModelCuller::SetCamera( FXMMATRIX view, CXMMATRIX projection )
+{
+    // The frustum is built in view space, then moved into world space so mesh bounds only need the world transform.
+    BoundingFrustum viewFrustum;
+    BoundingFrustum::CreateFromMatrix( viewFrustum, projection );
+
+    XMMATRIX viewInverse = XMMatrixInverse( nullptr, view );
+
+    viewFrustum.Transform( mFrustum, viewInverse );
+}
+
+
+bool XM_CALLCONV ModelCuller::IsVisible( const ModelMesh& mesh, FXMMATRIX world ) const
+{
+    // The sphere test is cheapest, so try it first.
+    BoundingSphere sphere;
+    mesh.boundingSphere.Transform( sphere, world );
+
+    ContainmentType result = mFrustum.Contains( sphere );
+
+    if ( result == DISJOINT )
+        return false;
+
+    if ( result == CONTAINS )
+        return true;
+
+    // Only partly inside, so see if the tighter box rules it out.
+    BoundingBox box;
+    mesh.boundingBox.Transform( box, world );
+
+    return mFrustum.Intersects( box );
+}
+
+
+bool XM_CALLCONV ModelCuller::IsVisible( const Model& model, FXMMATRIX world ) const
+{
+    for( auto it = model.meshes.cbegin(); it != model.meshes.cend(); ++it )
+    {
+        auto mesh = it->get();
+        assert( mesh != 0 );
+
+        if ( IsVisible( *mesh, world ) )
+            return true;
+    }
+
+    return false;
+}
+
+
+_Use_decl_annotations_
+size_t ModelCuller::Cull( Model const* const* models, XMMATRIX const* worlds, size_t count, bool* visible ) const
+{
+    assert( models != 0 && worlds != 0 && visible != 0 );
+
+    size_t visibleCount = 0;
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        assert( models[i] != 0 );
+
+        visible[i] = IsVisible( *models[i], worlds[i] );
+
+        if ( visible[i] )
+            ++visibleCount;
+    }
+
+    return visibleCount;
+}
+
+
+_Use_decl_annotations_
+size_t ModelCuller::Cull( const BoundingVolumeHierarchy& bvh, bool* visible ) const
+{
+    assert( visible != 0 );
+
+    size_t count = bvh.GetInstanceCount();
+
+    std::fill( visible, visible + count, false );
+
+    std::vector<uint32_t> meshes;
+    bvh.Query( mFrustum, meshes );
+
+    size_t visibleCount = 0;
+
+    for( auto it = meshes.cbegin(); it != meshes.cend(); ++it )
+    {
+        size_t instance = bvh.GetInstance( *it );
+
+        if ( !visible[ instance ] )
+        {
+            visible[ instance ] = true;
+            ++visibleCount;
+        }
+    }
+
+    return visibleCount;
+}
+
+
+//--------------------------------------------------------------------------------------
+// ModelRenderQueue
+//--------------------------------------------------------------------------------------
+
+// Internal ModelRenderQueue implementation class.
+class ModelRenderQueue::Impl
+{
+public:
+    struct QueuedPart
+    {
+        ModelMeshPart const* part;
+        ModelMesh const* mesh;
+        size_t world;
+    };
+
+    void Add( const ModelMesh& mesh, size_t world );
+
+    void XM_CALLCONV Draw( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, CXMMATRIX view, CXMMATRIX projection,
+                           bool wireframe, std::function<void()>& setCustomState );
+
+    std::vector<QueuedPart> mParts;
+    std::vector<XMFLOAT4X4> mWorlds;
+};
+
+
+void ModelRenderQueue::Impl::Add( const ModelMesh& mesh, size_t world )
+{
+    for ( auto it = mesh.meshParts.cbegin(); it != mesh.meshParts.cend(); ++it )
+    {
+        QueuedPart queued;
+
+        queued.part = it->get();
+        queued.mesh = &mesh;
+        queued.world = world;
+
+        assert( queued.part != 0 );
+
+        mParts.push_back( queued );
+    }
+}
+
+
+// Blend, depth and rasterizer state are the same for every part of a mesh sharing these settings.
+static inline int GetMeshStateBits( ModelMesh const* mesh, bool alpha )
+{
+    return ( alpha ? 1 : 0 ) | ( ( alpha && !mesh->pmalpha ) ? 2 : 0 ) | ( mesh->ccw ? 4 : 0 );
+}
+
+
+void XM_CALLCONV ModelRenderQueue::Impl::Draw( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, CXMMATRIX view, CXMMATRIX projection,
+                                               bool wireframe, std::function<void()>& setCustomState )
+{
+    assert( deviceContext != 0 );
+
+    // Opaque parts go first. Alpha parts keep the order they were queued in, since the caller may have sorted them by depth.
+    auto alphaBegin = std::stable_partition( mParts.begin(), mParts.end(), [](QueuedPart const& x) -> bool
+    {
+        return !x.part->isAlpha;
+    });
+
+    std::sort( mParts.begin(), alphaBegin, [](QueuedPart const& x, QueuedPart const& y) -> bool
+    {
+        int xs = GetMeshStateBits( x.mesh, false );
+        int ys = GetMeshStateBits( y.mesh, false );
+
+        if ( xs != ys )
+            return xs < ys;
+
+        if ( x.part->effect.get() != y.part->effect.get() )
+            return x.part->effect.get() < y.part->effect.get();
+
+        if ( x.part->inputLayout.Get() != y.part->inputLayout.Get() )
+            return x.part->inputLayout.Get() < y.part->inputLayout.Get();
+
+        if ( x.part->vertexBuffer.Get() != y.part->vertexBuffer.Get() )
+            return x.part->vertexBuffer.Get() < y.part->vertexBuffer.Get();
+
+        if ( x.part->indexBuffer.Get() != y.part->indexBuffer.Get() )
+            return x.part->indexBuffer.Get() < y.part->indexBuffer.Get();
+
+        return x.world < y.world;
+    });
+
+    // Track what is currently bound so only the changes need to be set.
+    int currentState = -1;
+    IEffect* currentEffect = nullptr;
+    size_t currentWorld = size_t(-1);
+    ID3D11InputLayout* currentLayout = nullptr;
+    ID3D11Buffer* currentVB = nullptr;
+    UINT currentStride = 0;
+    ID3D11Buffer* currentIB = nullptr;
+    DXGI_FORMAT currentIndexFormat = DXGI_FORMAT_UNKNOWN;
+    D3D_PRIMITIVE_TOPOLOGY currentTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+    for ( auto it = mParts.cbegin(); it != mParts.cend(); ++it )
+    {
+        auto part = it->part;
+        auto mesh = it->mesh;
+
+        int state = GetMeshStateBits( mesh, part->isAlpha );
+
+        if ( state != currentState )
+        {
+            mesh->PrepareForRendering( deviceContext, states, part->isAlpha, wireframe );
+            currentState = state;
+
+            // The hook has to run after our state settings to override them, so the effect is applied again.
+            if ( setCustomState )
+            {
+                currentEffect = nullptr;
+            }
+        }
+
+        auto effect = part->effect.get();
+        assert( effect != 0 );
+
+        // The same effect can be shared by many parts, so it must be applied again whenever the world matrix changes.
+        if ( effect != currentEffect || it->world != currentWorld )
+        {
+            auto imatrices = dynamic_cast<IEffectMatrices*>( effect );
+            if ( imatrices )
+            {
+                if ( effect != currentEffect )
+                {
+                    imatrices->SetView( view );
+                    imatrices->SetProjection( projection );
+                }
+
+                imatrices->SetWorld( XMLoadFloat4x4( &mWorlds[ it->world ] ) );
+            }
+
+            effect->Apply( deviceContext );
+
+            // Hook lets the caller replace our shaders or state settings with whatever else they see fit.
+            if ( setCustomState )
+            {
+                setCustomState();
+
+                // The hook may have changed any state or binding, so none of what we think is bound can be trusted.
+                currentState = -1;
+                currentLayout = nullptr;
+                currentVB = nullptr;
+                currentStride = 0;
+                currentIB = nullptr;
+                currentIndexFormat = DXGI_FORMAT_UNKNOWN;
+                currentTopology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+            }
+
+            currentEffect = effect;
+            currentWorld = it->world;
+        }
+
+        auto inputLayout = part->inputLayout.Get();
+
+        if ( inputLayout != currentLayout )
+        {
+            deviceContext->IASetInputLayout( inputLayout );
+            currentLayout = inputLayout;
+        }
+
+        auto vb = part->vertexBuffer.Get();
+
+        if ( vb != currentVB || part->vertexStride != currentStride )
+        {
+            UINT vbStride = part->vertexStride;
+            UINT vbOffset = 0;
+            deviceContext->IASetVertexBuffers( 0, 1, &vb, &vbStride, &vbOffset );
+
+            currentVB = vb;
+            currentStride = vbStride;
+        }
+
+        auto ib = part->indexBuffer.Get();
+
+        if ( ib != currentIB || part->indexFormat != currentIndexFormat )
+        {
+            deviceContext->IASetIndexBuffer( ib, part->indexFormat, 0 );
+
+            currentIB = ib;
+            currentIndexFormat = part->indexFormat;
+        }
+
+        if ( part->primitiveType != currentTopology )
+        {
+            deviceContext->IASetPrimitiveTopology( part->primitiveType );
+            currentTopology = part->primitiveType;
+        }
+
+        deviceContext->DrawIndexed( part->indexCount, part->startIndex, part->vertexOffset );
+    }
+
+    mParts.clear();
+    mWorlds.clear();
+}
+
+
+// Public constructor.
+ModelRenderQueue::ModelRenderQueue()
+  : pImpl(new Impl())
+{
+}
+
+
+// Move constructor.
+ModelRenderQueue::ModelRenderQueue(ModelRenderQueue&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+ModelRenderQueue& ModelRenderQueue::operator= (ModelRenderQueue&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+ModelRenderQueue::~ModelRenderQueue()
+{
+}
+
+
+void XM_CALLCONV ModelRenderQueue::Add( const Model& model, FXMMATRIX world )
+{
+    size_t index = pImpl->mWorlds.size();
+
+    XMFLOAT4X4 w;
+    XMStoreFloat4x4( &w, world );
+    pImpl->mWorlds.push_back( w );
+
+    for( auto it = model.meshes.cbegin(); it != model.meshes.cend(); ++it )
+    {
+        auto mesh = it->get();
+        assert( mesh != 0 );
+
+        pImpl->Add( *mesh, index );
+    }
+}
+
+
+void XM_CALLCONV ModelRenderQueue::Add( const ModelMesh& mesh, FXMMATRIX world )
+{
+    size_t index = pImpl->mWorlds.size();
+
+    XMFLOAT4X4 w;
+    XMStoreFloat4x4( &w, world );
+    pImpl->mWorlds.push_back( w );
+
+    pImpl->Add( mesh, index );
+}
+
+
+void XM_CALLCONV ModelRenderQueue::Add( const Model& model, FXMMATRIX world, const ModelCuller& culler )
+{
+    size_t index = pImpl->mWorlds.size();
+    bool stored = false;
+
+    for( auto it = model.meshes.cbegin(); it != model.meshes.cend(); ++it )
+    {
+        auto mesh = it->get();
+        assert( mesh != 0 );
+
+        if ( !culler.IsVisible( *mesh, world ) )
+            continue;
+
+        // Only keep the world matrix if something is drawn with it
+        if ( !stored )
+        {
+            XMFLOAT4X4 w;
+            XMStoreFloat4x4( &w, world );
+            pImpl->mWorlds.push_back( w );
+
+            stored = true;
+        }
+
+        pImpl->Add( *mesh, index );
+    }
+}
+
+
+_Use_decl_annotations_
+void XM_CALLCONV ModelRenderQueue::Draw( ID3D11DeviceContext* deviceContext, CommonStates& states, CXMMATRIX view, CXMMATRIX projection,
+                                         bool wireframe, std::function<void()> setCustomState )
+{
+    pImpl->Draw( deviceContext, states, view, projection, wireframe, setCustomState );
+}
+
+
+void ModelRenderQueue::Clear()
+{
+    pImpl->mParts.clear();
+    pImpl->mWorlds.clear();
+}
+
+
+size_t ModelRenderQueue::GetCount() const
+{
+    return pImpl->mParts.size();
+}
@@ -0,0 +1,399 @@
+//--------------------------------------------------------------------------------------
+// File: ModelAllocator.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Model.h"
+#include "ModelAllocator.h"
+
+#include "PlatformHelpers.h"
+
+using namespace DirectX;
+
+
+namespace
+{
+    // Objects remember where they came from in a header ahead of them, so operator delete can return them.
+    struct ObjectHeader
+    {
+        IModelAllocator* allocator;
+        size_t size;
+    };
+
+    // Keeps the object itself 16 byte aligned.
+    const size_t ObjectHeaderSize = 16;
+
+    static_assert(sizeof(ObjectHeader) <= ObjectHeaderSize, "ObjectHeader must fit in ObjectHeaderSize");
+
+
+    void* AllocateWithHeader(size_t size, _In_opt_ IModelAllocator* allocator)
+    {
+        if (size > SIZE_MAX - ObjectHeaderSize)
+            throw std::bad_alloc();
+
+        size += ObjectHeaderSize;
+
+        void* block = allocator ? allocator->AllocateObject(size) : ::operator new(size);
+        if (!block)
+            throw std::bad_alloc();
+
+        auto header = static_cast<ObjectHeader*>(block);
+
+        header->allocator = allocator;
+        header->size = size;
+
+        return static_cast<uint8_t*>(block) + ObjectHeaderSize;
+    }
+
+
+    void FreeWithHeader(_In_opt_ void* ptr)
+    {
+        if (!ptr)
+            return;
+
+        void* block = static_cast<uint8_t*>(ptr) - ObjectHeaderSize;
+
+        auto header = static_cast<ObjectHeader*>(block);
+
+        if (header->allocator)
+        {
+            header->allocator->FreeObject(block, header->size);
+        }
+        else
+        {
+            ::operator delete(block);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// ModelMeshPart and Model allocation
+//--------------------------------------------------------------------------------------
+
+void* ModelMeshPart::operator new(size_t size)
+{
+    return AllocateWithHeader(size, nullptr);
+}
+
+
+void* ModelMeshPart::operator new(size_t size, IModelAllocator* allocator)
+{
+    return AllocateWithHeader(size, allocator);
+}
+
+
+void ModelMeshPart::operator delete(void* ptr)
+{
+    FreeWithHeader(ptr);
+}
+
+
+// Only called when the constructor throws.
+void ModelMeshPart::operator delete(void* ptr, IModelAllocator*)
+{
+    FreeWithHeader(ptr);
+}
+
+
+void* Model::operator new(size_t size)
+{
+    return AllocateWithHeader(size, nullptr);
+}
+
+
+void* Model::operator new(size_t size, IModelAllocator* allocator)
+{
+    return AllocateWithHeader(size, allocator);
+}
+
+
+void Model::operator delete(void* ptr)
+{
+    FreeWithHeader(ptr);
+}
+
+
+// Only called when the constructor throws.
+void Model::operator delete(void* ptr, IModelAllocator*)
+{
+    FreeWithHeader(ptr);
+}
+
+
+//--------------------------------------------------------------------------------------
+// ModelAllocator
+//--------------------------------------------------------------------------------------
+
+// Internal ModelAllocator implementation class.
+class ModelAllocator::Impl
+{
+public:
+    Impl();
+    ~Impl();
+
+    void* AllocateObject(size_t size);
+    void FreeObject(_In_ void* ptr, size_t size);
+
+    void* AllocateScratch(size_t size);
+    void FreeScratch(_In_ void* ptr, size_t size);
+
+    void Trim();
+
+private:
+    // Objects up to MaxPooledSize bytes come from a free list per 16 byte size class, carved out of pages that are
+    // only freed with the allocator. Objects are small and long lived, so pooling them avoids heap fragmentation.
+    static const size_t Granularity = 16;
+    static const size_t MaxPooledSize = 512;
+    static const size_t SizeClassCount = MaxPooledSize / Granularity;
+    static const size_t PageSize = 64 * 1024;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct ScratchBlock
+    {
+        uint8_t* data;
+        size_t size;
+    };
+
+    static size_t SizeClass(size_t size) { return (size + Granularity - 1) / Granularity - 1; }
+
+    std::mutex mMutex;
+
+    FreeBlock* mFreeLists[SizeClassCount];
+    std::vector<std::unique_ptr<uint8_t[]>> mPages;
+    uint8_t* mPageCurrent;
+    size_t mPageRemaining;
+
+    // Scratch blocks returned at the end of a load, kept for the next one, and those handed out to loads now.
+    std::vector<ScratchBlock> mScratch;
+    std::vector<ScratchBlock> mScratchInUse;
+};
+
+
+ModelAllocator::Impl::Impl()
+  : mPageCurrent(nullptr),
+    mPageRemaining(0)
+{
+    memset(mFreeLists, 0, sizeof(mFreeLists));
+}
+
+
+ModelAllocator::Impl::~Impl()
+{
+    Trim();
+}
+
+
+void* ModelAllocator::Impl::AllocateObject(size_t size)
+{
+    if (!size || size > MaxPooledSize)
+        return new uint8_t[size];
+
+    size_t sizeClass = SizeClass(size);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    FreeBlock* block = mFreeLists[sizeClass];
+
+    if (block)
+    {
+        mFreeLists[sizeClass] = block->next;
+
+        return block;
+    }
+
+    // Carve a new block from the current page, starting another when it runs out.
+    size_t blockSize = (sizeClass + 1) * Granularity;
+
+    if (blockSize > mPageRemaining)
+    {
+        mPages.reserve(mPages.size() + 1);
+
+        std::unique_ptr<uint8_t[]> page(new uint8_t[PageSize]);
+
+        mPageCurrent = page.get();
+        mPageRemaining = PageSize;
+
+        mPages.push_back(std::move(page));
+    }
+
+    void* ptr = mPageCurrent;
+
+    mPageCurrent += blockSize;
+    mPageRemaining -= blockSize;
+
+    return ptr;
+}
+
+
+_Use_decl_annotations_
+void ModelAllocator::Impl::FreeObject(void* ptr, size_t size)
+{
+    if (!size || size > MaxPooledSize)
+    {
+        delete[] static_cast<uint8_t*>(ptr);
+        return;
+    }
+
+    auto block = static_cast<FreeBlock*>(ptr);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto& freeList = mFreeLists[SizeClass(size)];
+
+    block->next = freeList;
+    freeList = block;
+}
+
+
+// Reuses the smallest kept block that is big enough, otherwise allocates a new one.
+void* ModelAllocator::Impl::AllocateScratch(size_t size)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mScratchInUse.reserve(mScratchInUse.size() + 1);
+
+    auto best = mScratch.end();
+
+    for (auto it = mScratch.begin(); it != mScratch.end(); ++it)
+    {
+        if (it->size >= size && (best == mScratch.end() || it->size < best->size))
+            best = it;
+    }
+
+    ScratchBlock block;
+
+    if (best != mScratch.end())
+    {
+        block = *best;
+
+        mScratch.erase(best);
+    }
+    else
+    {
+        block.data = new uint8_t[size];
+        block.size = size;
+    }
+
+    mScratchInUse.push_back(block);
+
+    return block.data;
+}
+
+
+// Blocks handed out may be bigger than was asked for, so their real size is looked up rather than taken from the caller.
+_Use_decl_annotations_
+void ModelAllocator::Impl::FreeScratch(void* ptr, size_t)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto it = mScratchInUse.begin(); it != mScratchInUse.end(); ++it)
+    {
+        if (it->data == ptr)
+        {
+            ScratchBlock block = *it;
+
+            mScratchInUse.erase(it);
+
+            // The block is only put back for reuse if there is room to remember it.
+            try
+            {
+                mScratch.push_back(block);
+            }
+            catch (...)
+            {
+                delete[] block.data;
+            }
+
+            return;
+        }
+    }
+
+    DebugTrace("ERROR: ModelAllocator::FreeScratch called with a block it did not allocate\n");
+}
+
+
+void ModelAllocator::Impl::Trim()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (auto it = mScratch.begin(); it != mScratch.end(); ++it)
+    {
+        delete[] it->data;
+    }
+
+    mScratch.clear();
+}
+
+
+// Public constructor.
+ModelAllocator::ModelAllocator()
+  : pImpl(new Impl())
+{
+}
+
+
+// Move constructor.
+ModelAllocator::ModelAllocator(ModelAllocator&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+ModelAllocator& ModelAllocator::operator= (ModelAllocator&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+ModelAllocator::~ModelAllocator()
+{
+}
+
+
+void* ModelAllocator::AllocateObject(size_t size)
+{
+    return pImpl->AllocateObject(size);
+}
+
+
+_Use_decl_annotations_
+void ModelAllocator::FreeObject(void* ptr, size_t size)
+{
+    pImpl->FreeObject(ptr, size);
+}
+
+
+void* ModelAllocator::AllocateScratch(size_t size)
+{
+    return pImpl->AllocateScratch(size);
+}
+
+
+_Use_decl_annotations_
+void ModelAllocator::FreeScratch(void* ptr, size_t size)
+{
+    pImpl->FreeScratch(ptr, size);
+}
+
+
+void ModelAllocator::Trim()
+{
+    pImpl->Trim();
+}
@@ -0,0 +1,229 @@
+//--------------------------------------------------------------------------------------
+// File: ModelAllocator.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+
+#include <exception>
+#include <memory>
+#include <new>
+#include <vector>
+
+
+namespace DirectX
+{
+    // Bump allocator for the temporary buffers of a single load. It lives on the loader's stack, so it only
+    // ever belongs to one thread and needs no locking. Everything it handed out is freed when it is destroyed.
+    // Without an IModelAllocator each buffer is a heap allocation of its own, as it was before allocators.
+    class ScratchArena
+    {
+    public:
+        explicit ScratchArena(_In_opt_ IModelAllocator* allocator)
+          : mAllocator(allocator),
+            mCurrent(nullptr),
+            mRemaining(0)
+        { }
+
+        ~ScratchArena()
+        {
+            for (auto it = mBlocks.rbegin(); it != mBlocks.rend(); ++it)
+            {
+                if (mAllocator)
+                {
+                    mAllocator->FreeScratch(it->data, it->size);
+                }
+                else
+                {
+                    delete[] it->data;
+                }
+            }
+        }
+
+
+        // Returns uninitialized storage for count elements, aligned to 16 bytes when drawn from the allocator.
+        template<typename T>
+        T* Allocate(size_t count)
+        {
+            if (count > SIZE_MAX / sizeof(T))
+                throw std::bad_alloc();
+
+            return static_cast<T*>(AllocateBytes(count * sizeof(T)));
+        }
+
+
+    private:
+        static const size_t BlockSize = 256 * 1024;
+        static const size_t Alignment = 16;
+
+        struct Block
+        {
+            uint8_t* data;
+            size_t size;
+        };
+
+        void* AllocateBytes(size_t size)
+        {
+            if (!mAllocator)
+            {
+                return AddBlock(new uint8_t[size], size);
+            }
+
+            if (size > SIZE_MAX - Alignment)
+                throw std::bad_alloc();
+
+            size = (size + Alignment - 1) & ~(Alignment - 1);
+
+            if (size > mRemaining)
+            {
+                // Large buffers get a block of their own, so the current block stays in use for the small ones.
+                size_t blockSize = (size > BlockSize) ? size : BlockSize;
+
+                uint8_t* block = static_cast<uint8_t*>(mAllocator->AllocateScratch(blockSize));
+                if (!block)
+                    throw std::bad_alloc();
+
+                AddBlock(block, blockSize);
+
+                if (blockSize > size && (blockSize - size) > mRemaining)
+                {
+                    mCurrent = block + size;
+                    mRemaining = blockSize - size;
+                }
+
+                return block;
+            }
+
+            void* ptr = mCurrent;
+
+            mCurrent += size;
+            mRemaining -= size;
+
+            return ptr;
+        }
+
+        void* AddBlock(_In_ uint8_t* data, size_t size)
+        {
+            Block block = { data, size };
+
+            try
+            {
+                mBlocks.push_back(block);
+            }
+            catch (...)
+            {
+                if (mAllocator)
+                {
+                    mAllocator->FreeScratch(data, size);
+                }
+                else
+                {
+                    delete[] data;
+                }
+                throw;
+            }
+
+            return data;
+        }
+
+        IModelAllocator* mAllocator;
+        std::vector<Block> mBlocks;
+        uint8_t* mCurrent;
+        size_t mRemaining;
+
+        // Prevent copying.
+        ScratchArena(ScratchArena const&);
+        ScratchArena& operator= (ScratchArena const&);
+    };
+
+
+    // Standard library allocator that draws objects from an IModelAllocator, used with allocate_shared so each
+    // ModelMesh shares one allocation with its control block.
+    template<typename T>
+    class ModelObjectAllocator
+    {
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef T const* const_pointer;
+        typedef T& reference;
+        typedef T const& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template<typename U>
+        struct rebind
+        {
+            typedef ModelObjectAllocator<U> other;
+        };
+
+        explicit ModelObjectAllocator(_In_ IModelAllocator* allocator) throw()
+          : mAllocator(allocator)
+        { }
+
+        template<typename U>
+        ModelObjectAllocator(ModelObjectAllocator<U> const& other) throw()
+          : mAllocator(other.mAllocator)
+        { }
+
+        pointer allocate(size_type count, const void* = nullptr)
+        {
+            if (count > max_size())
+                throw std::bad_alloc();
+
+            void* ptr = mAllocator->AllocateObject(count * sizeof(T));
+            if (!ptr)
+                throw std::bad_alloc();
+
+            return static_cast<pointer>(ptr);
+        }
+
+        void deallocate(pointer ptr, size_type count)
+        {
+            mAllocator->FreeObject(ptr, count * sizeof(T));
+        }
+
+        void construct(pointer ptr, const_reference value)
+        {
+            new (static_cast<void*>(ptr)) T(value);
+        }
+
+        void destroy(pointer ptr)
+        {
+            ptr->~T();
+        }
+
+        pointer address(reference value) const { return &value; }
+        const_pointer address(const_reference value) const { return &value; }
+
+        size_type max_size() const throw() { return SIZE_MAX / sizeof(T); }
+
+        template<typename U>
+        bool operator== (ModelObjectAllocator<U> const& other) const { return mAllocator == other.mAllocator; }
+
+        template<typename U>
+        bool operator!= (ModelObjectAllocator<U> const& other) const { return mAllocator != other.mAllocator; }
+
+        IModelAllocator* mAllocator;
+    };
+
+
+    // Creates a mesh for a loader, from the allocator when it has one.
+    inline std::shared_ptr<ModelMesh> CreateModelMesh(_In_opt_ IModelAllocator* allocator)
+    {
+        if (!allocator)
+            return std::make_shared<ModelMesh>();
+
+        return std::allocate_shared<ModelMesh>(ModelObjectAllocator<ModelMesh>(allocator));
+    }
+}
@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// File: ModelBufferMerger.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Model.h"
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+
+#include <map>
+
+
+namespace DirectX
+{
+    // Used by the model loaders to pack geometry into one vertex buffer per vertex stride, and one index buffer per
+    // index format. Data is appended while parsing, parts are registered as they are built, and then CreateBuffers
+    // makes the merged buffers and hands them to every registered part.
+    class ModelBufferMerger
+    {
+    public:
+        ModelBufferMerger()
+        { }
+
+
+        // Appends vertex data, returning the base vertex it starts at.
+        uint32_t AddVertices(uint32_t stride, _In_reads_bytes_(bytes) const void* data, size_t bytes)
+        {
+            if (!stride)
+                throw std::exception("Invalid vertex stride");
+
+            auto& stream = mVertices[stride];
+
+            return Append(stream, stride, data, bytes);
+        }
+
+
+        // Appends index data, returning the first index it starts at.
+        uint32_t AddIndices(DXGI_FORMAT format, _In_reads_bytes_(bytes) const void* data, size_t bytes)
+        {
+            assert(format == DXGI_FORMAT_R16_UINT || format == DXGI_FORMAT_R32_UINT);
+
+            auto& stream = mIndices[format];
+
+            return Append(stream, (format == DXGI_FORMAT_R32_UINT) ? 4 : 2, data, bytes);
+        }
+
+
+        // The part is given the buffers matching its vertexStride and indexFormat.
+        void AddPart(_In_ ModelMeshPart* part)
+        {
+            mParts.push_back(part);
+        }
+
+
+        template<UINT TNameLength>
+        void CreateBuffers(_In_ ID3D11Device* device, _In_z_ const char (&debugName)[TNameLength])
+        {
+            std::map<uint32_t, Microsoft::WRL::ComPtr<ID3D11Buffer>> vbs;
+            std::map<DXGI_FORMAT, Microsoft::WRL::ComPtr<ID3D11Buffer>> ibs;
+
+            for (auto it = mVertices.cbegin(); it != mVertices.cend(); ++it)
+            {
+                auto& vb = vbs[it->first];
+
+                CreateBuffer(device, it->second, D3D11_BIND_VERTEX_BUFFER, &vb);
+
+                SetDebugObjectName(vb.Get(), debugName);
+            }
+
+            for (auto it = mIndices.cbegin(); it != mIndices.cend(); ++it)
+            {
+                auto& ib = ibs[it->first];
+
+                CreateBuffer(device, it->second, D3D11_BIND_INDEX_BUFFER, &ib);
+
+                SetDebugObjectName(ib.Get(), debugName);
+            }
+
+            for (auto it = mParts.cbegin(); it != mParts.cend(); ++it)
+            {
+                auto part = *it;
+
+                assert(vbs.find(part->vertexStride) != vbs.end());
+                assert(ibs.find(part->indexFormat) != ibs.end());
+
+                part->vertexBuffer = vbs[part->vertexStride];
+                part->indexBuffer = ibs[part->indexFormat];
+            }
+
+            mVertices.clear();
+            mIndices.clear();
+            mParts.clear();
+        }
+
+
+    private:
+        typedef std::vector<uint8_t> Stream;
+
+        // Each block starts on a whole element, so its base can be expressed as a vertex or index number.
+        static uint32_t Append(Stream& stream, size_t elementSize, _In_reads_bytes_(bytes) const void* data, size_t bytes)
+        {
+            size_t base = (stream.size() + elementSize - 1) / elementSize;
+            size_t start = base * elementSize;
+
+            if (start + bytes > UINT32_MAX)
+                throw std::exception("Merged model buffers are too large");
+
+            stream.resize(start + bytes);
+
+            if (bytes > 0)
+            {
+                memcpy(&stream[start], data, bytes);
+            }
+
+            return static_cast<uint32_t>(base);
+        }
+
+
+        static void CreateBuffer(_In_ ID3D11Device* device, Stream const& stream, unsigned int bindFlags, _Outptr_ ID3D11Buffer** buffer)
+        {
+            D3D11_BUFFER_DESC desc = {0};
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.ByteWidth = static_cast<UINT>(stream.size());
+            desc.BindFlags = bindFlags;
+
+            D3D11_SUBRESOURCE_DATA initData = {0};
+            initData.pSysMem = &stream.front();
+
+            ThrowIfFailed(
+                device->CreateBuffer(&desc, &initData, buffer)
+            );
+        }
+
+
+        std::map<uint32_t, Stream> mVertices;
+        std::map<DXGI_FORMAT, Stream> mIndices;
+        std::vector<ModelMeshPart*> mParts;
+
+
+        // Prevent copying.
+        ModelBufferMerger(ModelBufferMerger const&) DIRECTX_CTOR_DELETE
+        ModelBufferMerger& operator= (ModelBufferMerger const&) DIRECTX_CTOR_DELETE
+    };
+}
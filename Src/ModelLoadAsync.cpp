@@ -0,0 +1,706 @@
+//--------------------------------------------------------------------------------------
+// File: ModelLoadAsync.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Model.h"
+
+#include "Effects.h"
+
+#include "BinaryReader.h"
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+
+#include <ppl.h>
+#include <queue>
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+#ifndef _CPPRTTI
+#error AsyncModelLoader requires RTTI
+#endif
+
+namespace
+{
+    // A texture named by a material, waiting to be attached to its effect.
+    struct PendingTexture
+    {
+        std::shared_ptr<IEffect> effect;
+        int slot;
+        std::wstring name;
+        ComPtr<ID3D11ShaderResourceView> textureView;
+    };
+
+
+    // Binds a texture to whichever slot of a built-in effect it was named for.
+    void SetEffectTexture(_In_ IEffect* effect, int slot, _In_ ID3D11ShaderResourceView* textureView)
+    {
+        auto basic = dynamic_cast<BasicEffect*>(effect);
+        if (basic)
+        {
+            basic->SetTexture(textureView);
+            basic->SetTextureEnabled(true);
+            return;
+        }
+
+        auto skinned = dynamic_cast<SkinnedEffect*>(effect);
+        if (skinned)
+        {
+            skinned->SetTexture(textureView);
+            return;
+        }
+
+        auto dgsl = dynamic_cast<DGSLEffect*>(effect);
+        if (dgsl)
+        {
+            dgsl->SetTexture(slot, textureView);
+            dgsl->SetTextureEnabled(true);
+            return;
+        }
+
+        DebugTrace("AsyncModelLoader cannot set textures on this effect type\n");
+    }
+
+
+    // The effect does not keep its material name, so it is not shared through the factory cache: another model
+    // could be drawing a shared effect while the placeholder is bound here. Textures are still shared.
+    void DeferTextures(_In_ IEffect* effect, std::shared_ptr<IEffect> const& owner, int slot, _In_opt_z_ const WCHAR* name,
+                       _In_ ID3D11ShaderResourceView* placeholder, std::vector<PendingTexture>& pending)
+    {
+        if (!name || !*name)
+            return;
+
+        SetEffectTexture(effect, slot, placeholder);
+
+        PendingTexture texture;
+        texture.effect = owner;
+        texture.slot = slot;
+        texture.name = name;
+
+        pending.push_back(texture);
+    }
+
+
+    // Forwards to the application's factory with the texture names removed, recording them instead. The factory
+    // must be free threaded, since other workers can be calling it at the same time.
+    class DeferredEffectFactory : public IEffectFactory
+    {
+    public:
+        DeferredEffectFactory(IEffectFactory& factory, _In_ ID3D11ShaderResourceView* placeholder, std::vector<PendingTexture>& pending)
+          : mFactory(factory),
+            mPlaceholder(placeholder),
+            mPending(pending)
+        { }
+
+        virtual std::shared_ptr<IEffect> __cdecl CreateEffect( _In_ const EffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext ) override
+        {
+            EffectInfo deferred = info;
+            deferred.name = nullptr;
+            deferred.texture = nullptr;
+
+            auto effect = mFactory.CreateEffect(deferred, deviceContext);
+
+            DeferTextures(effect.get(), effect, 0, info.texture, mPlaceholder, mPending);
+
+            return effect;
+        }
+
+        virtual void __cdecl CreateTexture( _In_z_ const WCHAR* name, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView ) override
+        {
+            mFactory.CreateTexture(name, deviceContext, textureView);
+        }
+
+    private:
+        IEffectFactory& mFactory;
+        ID3D11ShaderResourceView* mPlaceholder;
+        std::vector<PendingTexture>& mPending;
+
+        DeferredEffectFactory& operator= (DeferredEffectFactory const&) DIRECTX_CTOR_DELETE
+    };
+
+
+    // The CMO loader only creates DGSL effects when handed a DGSLEffectFactory, so this one derives from it.
+    class DeferredDGSLEffectFactory : public DGSLEffectFactory
+    {
+    public:
+        DeferredDGSLEffectFactory(_In_ ID3D11Device* device, DGSLEffectFactory& factory, _In_ ID3D11ShaderResourceView* placeholder, std::vector<PendingTexture>& pending)
+          : DGSLEffectFactory(device),
+            mFactory(factory),
+            mPlaceholder(placeholder),
+            mPending(pending)
+        { }
+
+        virtual std::shared_ptr<IEffect> __cdecl CreateEffect( _In_ const EffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext ) override
+        {
+            EffectInfo deferred = info;
+            deferred.name = nullptr;
+            deferred.texture = nullptr;
+
+            auto effect = mFactory.CreateEffect(deferred, deviceContext);
+
+            DeferTextures(effect.get(), effect, 0, info.texture, mPlaceholder, mPending);
+
+            return effect;
+        }
+
+        virtual std::shared_ptr<IEffect> __cdecl CreateDGSLEffect( _In_ const DGSLEffectInfo& info, _In_opt_ ID3D11DeviceContext* deviceContext ) override
+        {
+            DGSLEffectInfo deferred = info;
+            deferred.name = nullptr;
+            deferred.texture = nullptr;
+
+            for (size_t j = 0; j < _countof(deferred.textures); ++j)
+            {
+                deferred.textures[j] = nullptr;
+            }
+
+            auto effect = mFactory.CreateDGSLEffect(deferred, deviceContext);
+
+            DeferTextures(effect.get(), effect, 0, info.texture, mPlaceholder, mPending);
+
+            for (size_t j = 0; j < _countof(info.textures); ++j)
+            {
+                DeferTextures(effect.get(), effect, static_cast<int>(j) + 1, info.textures[j], mPlaceholder, mPending);
+            }
+
+            return effect;
+        }
+
+        virtual void __cdecl CreateTexture( _In_z_ const WCHAR* name, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView ) override
+        {
+            mFactory.CreateTexture(name, deviceContext, textureView);
+        }
+
+        virtual void __cdecl CreatePixelShader( _In_z_ const WCHAR* shader, _Outptr_ ID3D11PixelShader** pixelShader ) override
+        {
+            mFactory.CreatePixelShader(shader, pixelShader);
+        }
+
+    private:
+        DGSLEffectFactory& mFactory;
+        ID3D11ShaderResourceView* mPlaceholder;
+        std::vector<PendingTexture>& mPending;
+
+        DeferredDGSLEffectFactory& operator= (DeferredDGSLEffectFactory const&) DIRECTX_CTOR_DELETE
+    };
+}
+
+
+//--------------------------------------------------------------------------------------
+// AsyncModelLoader
+//--------------------------------------------------------------------------------------
+
+class AsyncModelLoader::Request
+{
+public:
+    Request()
+      : cmo(false),
+        ccw(false),
+        pmalpha(false),
+        status(MODEL_LOAD_PENDING),
+        result(E_PENDING)
+    { }
+
+    // Load parameters.
+    std::wstring fileName;
+    bool cmo;
+    bool ccw;
+    bool pmalpha;
+
+    // File contents, from when the read completes until the worker has created the model.
+    BinaryReader::FileData data;
+
+    // Results. The model and result are written before status moves to MODEL_LOAD_READY or MODEL_LOAD_FAILED,
+    // and the texture views are only touched by the worker until the request is handed to Update.
+    volatile LONG status;
+    HRESULT result;
+    std::shared_ptr<Model> model;
+    std::vector<PendingTexture> textures;
+    ScopedHandle readyEvent;
+};
+
+
+// Internal AsyncModelLoader implementation class.
+class AsyncModelLoader::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device, IEffectFactory& fxFactory, size_t workerCount);
+    ~Impl();
+
+    RequestHandle Enqueue(RequestHandle request);
+    size_t Update();
+
+    ComPtr<ID3D11Device> mDevice;
+    IEffectFactory& mFactory;
+    ComPtr<ID3D11ShaderResourceView> mPlaceholder;
+    size_t mMaxWorkers;
+
+    // Guards everything below.
+    mutable std::mutex mMutex;
+
+    std::queue<RequestHandle> mQueue;
+    std::vector<RequestHandle> mTexturesLoaded;
+    size_t mPendingCount;
+    size_t mWorkerCount;
+    size_t mReadCount;
+    bool mShutdown;
+
+    // Set while no file reads are outstanding.
+    ScopedHandle mReadsIdle;
+
+    Concurrency::task_group mWorkers;
+
+private:
+    void ReadCompleted(RequestHandle const& request, HRESULT hr, BinaryReader::FileData& data);
+    void WorkerLoop();
+    void Process(_In_ Request* request);
+
+    Impl& operator= (Impl const&) DIRECTX_CTOR_DELETE
+};
+
+
+AsyncModelLoader::Impl::Impl(_In_ ID3D11Device* device, IEffectFactory& fxFactory, size_t workerCount)
+  : mDevice(device),
+    mFactory(fxFactory),
+    mMaxWorkers(workerCount),
+    mPendingCount(0),
+    mWorkerCount(0),
+    mReadCount(0),
+    mShutdown(false)
+{
+    if (!device)
+        throw std::exception("Direct3D device cannot be null");
+
+    if (!workerCount)
+        throw std::exception("AsyncModelLoader needs at least one worker");
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    mReadsIdle.reset( CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET | CREATE_EVENT_INITIAL_SET, EVENT_MODIFY_STATE | SYNCHRONIZE ) );
+#else
+    mReadsIdle.reset( CreateEvent( nullptr, TRUE, TRUE, nullptr ) );
+#endif
+
+    if (!mReadsIdle)
+        throw std::exception("CreateEvent");
+
+    // Bound in place of each texture until it has loaded, so materials keep their own color meanwhile.
+    static const uint32_t s_white = 0xFFFFFFFF;
+
+    D3D11_SUBRESOURCE_DATA initData = { &s_white, sizeof(uint32_t), 0 };
+
+    CD3D11_TEXTURE2D_DESC desc(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+
+    ComPtr<ID3D11Texture2D> texture;
+
+    ThrowIfFailed(
+        device->CreateTexture2D(&desc, &initData, &texture)
+    );
+
+    CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(D3D11_SRV_DIMENSION_TEXTURE2D, desc.Format, 0, 1);
+
+    ThrowIfFailed(
+        device->CreateShaderResourceView(texture.Get(), &viewDesc, &mPlaceholder)
+    );
+
+    SetDebugObjectName(texture.Get(), "DirectXTK:AsyncModelLoader");
+    SetDebugObjectName(mPlaceholder.Get(), "DirectXTK:AsyncModelLoader");
+}
+
+
+// Queued requests are dropped, and the destructor waits for the file reads and workers to stop.
+AsyncModelLoader::Impl::~Impl()
+{
+    std::vector<RequestHandle> dropped;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mShutdown = true;
+
+        while (!mQueue.empty())
+        {
+            dropped.push_back(mQueue.front());
+            mQueue.pop();
+        }
+
+        mPendingCount -= dropped.size();
+    }
+
+    for (auto it = dropped.cbegin(); it != dropped.cend(); ++it)
+    {
+        (*it)->result = E_ABORT;
+        InterlockedExchange(&(*it)->status, MODEL_LOAD_FAILED);
+        SetEvent((*it)->readyEvent.get());
+    }
+
+    // Reads still in flight fail with E_ABORT once they complete. Checking the count under the lock
+    // makes sure the last completion has finished with this object.
+    for (;;)
+    {
+        (void)WaitForSingleObjectEx(mReadsIdle.get(), INFINITE, FALSE);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        if (!mReadCount)
+            break;
+    }
+
+    mWorkers.wait();
+}
+
+
+// Starts reading the file. The request joins the worker queue when the read completes, so workers never wait on I/O.
+AsyncModelLoader::RequestHandle AsyncModelLoader::Impl::Enqueue(RequestHandle request)
+{
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    request->readyEvent.reset( CreateEventEx( nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_MODIFY_STATE | SYNCHRONIZE ) );
+#else
+    request->readyEvent.reset( CreateEvent( nullptr, TRUE, FALSE, nullptr ) );
+#endif
+
+    if (!request->readyEvent)
+        throw std::exception("CreateEvent");
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        mPendingCount++;
+
+        if (!mReadCount++)
+            ResetEvent(mReadsIdle.get());
+    }
+
+    HRESULT hr = BinaryReader::ReadEntireFileAsync(request->fileName.c_str(), [this, request](HRESULT hrRead, BinaryReader::FileData& data)
+    {
+        ReadCompleted(request, hrRead, data);
+    });
+
+    if (FAILED(hr))
+    {
+        BinaryReader::FileData none;
+        ReadCompleted(request, hr, none);
+    }
+
+    return request;
+}
+
+
+// Adds a request whose file has been read to the queue, starting another worker if there is room for one.
+// Everything happens under the lock, so the destructor knows this has finished once it sees no reads outstanding.
+void AsyncModelLoader::Impl::ReadCompleted(RequestHandle const& request, HRESULT hr, BinaryReader::FileData& data)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (SUCCEEDED(hr) && mShutdown)
+        hr = E_ABORT;
+
+    if (SUCCEEDED(hr))
+    {
+        request->data = std::move(data);
+
+        mQueue.push(request);
+
+        if (mWorkerCount < mMaxWorkers)
+        {
+            mWorkerCount++;
+
+            mWorkers.run([this]()
+            {
+                WorkerLoop();
+            });
+        }
+    }
+    else
+    {
+        DebugTrace("AsyncModelLoader failed (%08X) reading '%ls'\n", hr, request->fileName.c_str());
+
+        mPendingCount--;
+
+        request->result = hr;
+        InterlockedExchange(&request->status, MODEL_LOAD_FAILED);
+        SetEvent(request->readyEvent.get());
+    }
+
+    if (!--mReadCount)
+        SetEvent(mReadsIdle.get());
+}
+
+
+// Attaches the textures of every request whose loads have finished.
+size_t AsyncModelLoader::Impl::Update()
+{
+    std::vector<RequestHandle> finished;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        finished.swap(mTexturesLoaded);
+    }
+
+    for (auto it = finished.cbegin(); it != finished.cend(); ++it)
+    {
+        auto& textures = (*it)->textures;
+
+        for (auto jt = textures.begin(); jt != textures.end(); ++jt)
+        {
+            // Textures which failed to load keep the placeholder.
+            if (jt->textureView)
+            {
+                SetEffectTexture(jt->effect.get(), jt->slot, jt->textureView.Get());
+            }
+        }
+
+        // The model holds the effects from here on.
+        textures.clear();
+
+        InterlockedExchange(&(*it)->status, MODEL_LOAD_COMPLETE);
+    }
+
+    return finished.size();
+}
+
+
+// Each worker keeps taking requests until the queue is empty.
+void AsyncModelLoader::Impl::WorkerLoop()
+{
+    // WIC textures need COM, and this thread belongs to the PPL scheduler rather than the application.
+    HRESULT hrCOM = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+
+    for (;;)
+    {
+        RequestHandle request;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            if (mQueue.empty())
+            {
+                mWorkerCount--;
+                break;
+            }
+
+            request = mQueue.front();
+            mQueue.pop();
+
+            InterlockedExchange(&request->status, MODEL_LOAD_LOADING);
+        }
+
+        Process(request.get());
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mPendingCount--;
+
+            if (request->status == MODEL_LOAD_READY)
+            {
+                mTexturesLoaded.push_back(request);
+            }
+        }
+    }
+
+    if (SUCCEEDED(hrCOM))
+    {
+        CoUninitialize();
+    }
+}
+
+
+// Creates the model, publishes it, then loads its textures, all on the calling (worker) thread.
+void AsyncModelLoader::Impl::Process(_In_ Request* request)
+{
+    try
+    {
+        std::unique_ptr<Model> model;
+
+        if (request->cmo)
+        {
+            auto dgslFactory = dynamic_cast<DGSLEffectFactory*>(&mFactory);
+            if (dgslFactory)
+            {
+                DeferredDGSLEffectFactory factory(mDevice.Get(), *dgslFactory, mPlaceholder.Get(), request->textures);
+
+                model = Model::CreateFromCMO(mDevice.Get(), request->data.get(), request->data.size(), factory, request->ccw, request->pmalpha);
+            }
+            else
+            {
+                DeferredEffectFactory factory(mFactory, mPlaceholder.Get(), request->textures);
+
+                model = Model::CreateFromCMO(mDevice.Get(), request->data.get(), request->data.size(), factory, request->ccw, request->pmalpha);
+            }
+        }
+        else
+        {
+            DeferredEffectFactory factory(mFactory, mPlaceholder.Get(), request->textures);
+
+            model = Model::CreateFromSDKMESH(mDevice.Get(), request->data.get(), request->data.size(), factory, request->ccw, request->pmalpha);
+        }
+
+        model->name = request->fileName;
+
+        request->data.reset();
+        request->model.reset(model.release());
+    }
+    catch (std::exception const&)
+    {
+        DebugTrace("AsyncModelLoader failed loading '%ls'\n", request->fileName.c_str());
+
+        request->data.reset();
+
+        request->textures.clear();
+        request->model.reset();
+        request->result = E_FAIL;
+        InterlockedExchange(&request->status, MODEL_LOAD_FAILED);
+        SetEvent(request->readyEvent.get());
+        return;
+    }
+
+    request->result = S_OK;
+    InterlockedExchange(&request->status, MODEL_LOAD_READY);
+    SetEvent(request->readyEvent.get());
+
+    // Effects are not touched here, since the application may already be drawing the model.
+    for (auto it = request->textures.begin(); it != request->textures.end(); ++it)
+    {
+        try
+        {
+            mFactory.CreateTexture(it->name.c_str(), nullptr, it->textureView.ReleaseAndGetAddressOf());
+        }
+        catch (std::exception const&)
+        {
+            DebugTrace("AsyncModelLoader failed loading texture '%ls'\n", it->name.c_str());
+
+            it->textureView.Reset();
+        }
+    }
+}
+
+
+// Public constructor.
+AsyncModelLoader::AsyncModelLoader(_In_ ID3D11Device* device, IEffectFactory& fxFactory, size_t workerCount)
+  : pImpl(new Impl(device, fxFactory, workerCount))
+{
+}
+
+
+// Move constructor.
+AsyncModelLoader::AsyncModelLoader(AsyncModelLoader&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+AsyncModelLoader& AsyncModelLoader::operator= (AsyncModelLoader&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+AsyncModelLoader::~AsyncModelLoader()
+{
+}
+
+
+_Use_decl_annotations_
+AsyncModelLoader::RequestHandle AsyncModelLoader::LoadSDKMESH( const wchar_t* szFileName, bool ccw, bool pmalpha )
+{
+    if (!szFileName)
+        throw std::exception("invalid arguments");
+
+    RequestHandle request(new Request());
+
+    request->fileName = szFileName;
+    request->ccw = ccw;
+    request->pmalpha = pmalpha;
+
+    return pImpl->Enqueue(request);
+}
+
+
+_Use_decl_annotations_
+AsyncModelLoader::RequestHandle AsyncModelLoader::LoadCMO( const wchar_t* szFileName, bool ccw, bool pmalpha )
+{
+    if (!szFileName)
+        throw std::exception("invalid arguments");
+
+    RequestHandle request(new Request());
+
+    request->fileName = szFileName;
+    request->cmo = true;
+    request->ccw = ccw;
+    request->pmalpha = pmalpha;
+
+    return pImpl->Enqueue(request);
+}
+
+
+size_t AsyncModelLoader::Update()
+{
+    return pImpl->Update();
+}
+
+
+_Use_decl_annotations_
+MODEL_LOAD_STATUS AsyncModelLoader::GetStatus( RequestHandle const& request )
+{
+    if (!request)
+        return MODEL_LOAD_FAILED;
+
+    return static_cast<MODEL_LOAD_STATUS>(request->status);
+}
+
+
+_Use_decl_annotations_
+bool AsyncModelLoader::Wait( RequestHandle const& request, unsigned long timeoutMilliseconds )
+{
+    if (!request)
+        return true;
+
+    return WaitForSingleObjectEx( request->readyEvent.get(), timeoutMilliseconds, FALSE ) == WAIT_OBJECT_0;
+}
+
+
+_Use_decl_annotations_
+HRESULT AsyncModelLoader::GetResult( RequestHandle const& request, std::shared_ptr<Model>* model )
+{
+    if (!model)
+        return E_INVALIDARG;
+
+    model->reset();
+
+    if (!request)
+        return E_INVALIDARG;
+
+    LONG status = request->status;
+
+    if (status == MODEL_LOAD_PENDING || status == MODEL_LOAD_LOADING)
+        return E_PENDING;
+
+    if (SUCCEEDED(request->result))
+    {
+        *model = request->model;
+    }
+
+    return request->result;
+}
+
+
+size_t AsyncModelLoader::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->mMutex);
+
+    return pImpl->mPendingCount;
+}
@@ -21,6 +21,10 @@
 #include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
 #include "BinaryReader.h"
+#include "MeshOptimizer.h"
+#include "ModelAllocator.h"
+#include "ModelBufferMerger.h"
+#include "VertexPacker.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -176,18 +180,30 @@ struct MaterialRecordCMO
     std::wstring                    pixelShader;
     std::wstring                    texture[VSD3DStarter::MAX_TEXTURE];
     std::shared_ptr<IEffect>        effect;
+    std::shared_ptr<ModelMaterial>  material;
     ComPtr<ID3D11InputLayout>       il;
 };
 
 // Helper for creating a D3D input layout.
-static void CreateInputLayout(_In_ ID3D11Device* device, IEffect* effect, _Out_ ID3D11InputLayout** pInputLayout, bool skinning )
+static void CreateInputLayout(_In_ ID3D11Device* device, IEffect* effect, _Out_ ID3D11InputLayout** pInputLayout, bool skinning, bool packed )
 {
     void const* shaderByteCode;
     size_t byteCodeLength;
 
     effect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
 
-    if ( skinning )
+    if ( packed )
+    {
+        ThrowIfFailed(
+            device->CreateInputLayout( skinning ? VertexPositionNormalTangentColorTextureSkinningPacked::InputElements
+                                                : VertexPositionNormalTangentColorTexturePacked::InputElements,
+                                       skinning ? VertexPositionNormalTangentColorTextureSkinningPacked::InputElementCount
+                                                : VertexPositionNormalTangentColorTexturePacked::InputElementCount,
+                                       shaderByteCode, byteCodeLength,
+                                       pInputLayout)
+        );
+    }
+    else if ( skinning )
     {
         ThrowIfFailed(
             device->CreateInputLayout( VertexPositionNormalTangentColorTextureSkinning::InputElements,
@@ -213,6 +229,8 @@ static void CreateInputLayout(_In_ ID3D11Device* device, IEffect* effect, _Out_
 static INIT_ONCE g_InitOnce = INIT_ONCE_STATIC_INIT;
 static std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> g_vbdecl;
 static std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> g_vbdeclSkinning;
+static std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> g_vbdeclPacked;
+static std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> g_vbdeclSkinningPacked;
 
 static BOOL CALLBACK InitializeDecl( PINIT_ONCE initOnce, PVOID Parameter, PVOID *lpContext )
 {
@@ -225,6 +243,12 @@ static BOOL CALLBACK InitializeDecl( PINIT_ONCE initOnce, PVOID Parameter, PVOID
 
     g_vbdeclSkinning = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>( VertexPositionNormalTangentColorTextureSkinning::InputElements,
            VertexPositionNormalTangentColorTextureSkinning::InputElements + VertexPositionNormalTangentColorTextureSkinning::InputElementCount );
+
+    g_vbdeclPacked = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>( VertexPositionNormalTangentColorTexturePacked::InputElements,
+           VertexPositionNormalTangentColorTexturePacked::InputElements + VertexPositionNormalTangentColorTexturePacked::InputElementCount );
+
+    g_vbdeclSkinningPacked = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>( VertexPositionNormalTangentColorTextureSkinningPacked::InputElements,
+           VertexPositionNormalTangentColorTextureSkinningPacked::InputElements + VertexPositionNormalTangentColorTextureSkinningPacked::InputElementCount );
     return TRUE;
 }
 
@@ -234,7 +258,7 @@ static BOOL CALLBACK InitializeDecl( PINIT_ONCE initOnce, PVOID Parameter, PVOID
 //======================================================================================
 
 _Use_decl_annotations_
-std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, const uint8_t* meshData, size_t dataSize, IEffectFactory& fxFactory, bool ccw, bool pmalpha )
+std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, const uint8_t* meshData, size_t dataSize, IEffectFactory& fxFactory, bool ccw, bool pmalpha, bool mergeBuffers, bool packVertices, bool optimizeMesh, IModelAllocator* allocator )
 {
     if ( !InitOnceExecuteOnce( &g_InitOnce, InitializeDecl, nullptr, nullptr ) )
         throw std::exception("One-time initialization failed");
@@ -244,6 +268,9 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
 
     auto fxFactoryDGSL = dynamic_cast<DGSLEffectFactory*>( &fxFactory );
 
+    // Packed vertices keep the CMO layout of elements, so both the DGSL and basic effects still bind to them.
+    bool packed = packVertices && VertexPacker::IsSupported( d3dDevice );
+
     // Meshes
     auto nMesh = reinterpret_cast<const UINT*>( meshData );
     size_t usedSize = sizeof(UINT);
@@ -253,7 +280,13 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
     if ( !*nMesh )
         throw std::exception("No meshes found");
 
-    std::unique_ptr<Model> model(new Model());
+    std::unique_ptr<Model> model(new (allocator) Model());
+
+    // When merging, every mesh's buffers are packed together, so each file buffer becomes a base vertex or
+    // start index within them.
+    ModelBufferMerger merger;
+
+    MeshOptimizer optimizer;
 
     for( UINT meshIndex = 0; meshIndex < *nMesh; ++meshIndex )
     {
@@ -269,7 +302,7 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
         if ( dataSize < usedSize )
             throw std::exception("End of file");
 
-        auto mesh = std::make_shared<ModelMesh>();
+        auto mesh = CreateModelMesh( allocator );
         mesh->name.assign( meshName, *nName );
         mesh->ccw = ccw;
         mesh->pmalpha = pmalpha;
@@ -384,6 +417,9 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
         std::vector<ComPtr<ID3D11Buffer>> ibs;
         ibs.resize( *nIBs );
 
+        std::vector<uint32_t> ibBase;
+        ibBase.resize( *nIBs );
+
         for( UINT j = 0; j < *nIBs; ++j )
         {
             auto nIndexes = reinterpret_cast<const UINT*>( meshData + usedSize );
@@ -405,24 +441,9 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
             ib.nIndices = *nIndexes;
             ib.ptr = indexes;
             ibData.emplace_back( ib );
-
-            D3D11_BUFFER_DESC desc = {0};
-            desc.Usage = D3D11_USAGE_DEFAULT;
-            desc.ByteWidth = static_cast<UINT>( ibBytes );
-            desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-
-            D3D11_SUBRESOURCE_DATA initData = {0};
-            initData.pSysMem = indexes;
-
-            ThrowIfFailed(
-                d3dDevice->CreateBuffer( &desc, &initData, &ibs[j] )
-                );
-
-            SetDebugObjectName( ibs[j].Get(), "ModelCMO" ); 
         }
 
         assert( ibData.size() == *nIBs );
-        assert( ibs.size() == *nIBs );
 
         // Vertex buffers
         auto nVBs = reinterpret_cast<const UINT*>( meshData + usedSize );
@@ -602,15 +623,116 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
         UNREFERENCED_PARAMETER(bSkeleton);
 #endif
 
+        // Optional mesh optimization reorders copies of the index buffers, and works out the vertex renumbering
+        // to apply once the vertex buffers are built.
+        std::vector<std::vector<USHORT>> ibCopies;
+        std::vector<std::unique_ptr<MeshOptimizer::VertexRemap>> vbRemap;
+
+        if ( optimizeMesh )
+        {
+            ibCopies.resize( *nIBs );
+
+            for( UINT j = 0; j < *nIBs; ++j )
+            {
+                ibCopies[j].assign( ibData[j].ptr, ibData[j].ptr + ibData[j].nIndices );
+                ibData[j].ptr = &ibCopies[j].front();
+            }
+
+            // Vertex fetch order can only change for vertex buffers whose index buffers use no other vertex buffer.
+            std::vector<UINT> ibOwner( *nIBs, UINT(-1) );
+            std::vector<bool> remappable( *nVBs, true );
+
+            for( UINT k = 0; k < *nSubmesh; ++k )
+            {
+                auto& sm = subMesh[ k ];
+
+                if ( (sm.IndexBufferIndex >= *nIBs)
+                     || (sm.VertexBufferIndex >= *nVBs)
+                     || (sm.StartIndex + sm.PrimCount * 3 > ibData[ sm.IndexBufferIndex ].nIndices) )
+                     throw std::exception("Invalid submesh found\n");
+
+                auto& vb = vbData[ sm.VertexBufferIndex ];
+
+                optimizer.OptimizeFaces( &ibCopies[ sm.IndexBufferIndex ][ sm.StartIndex ], sm.PrimCount * 3, vb.nVerts,
+                                         reinterpret_cast<const uint8_t*>( &vb.ptr->position ), reinterpret_cast<const uint8_t*>( &vb.ptr->normal ),
+                                         sizeof(VertexPositionNormalTangentColorTexture) );
+
+                auto& owner = ibOwner[ sm.IndexBufferIndex ];
+
+                if ( owner == UINT(-1) )
+                {
+                    owner = sm.VertexBufferIndex;
+                }
+                else if ( owner != sm.VertexBufferIndex )
+                {
+                    remappable[ owner ] = false;
+                    remappable[ sm.VertexBufferIndex ] = false;
+                }
+            }
+
+            vbRemap.resize( *nVBs );
+
+            for( UINT j = 0; j < *nVBs; ++j )
+            {
+                if ( !remappable[j] )
+                    continue;
+
+                vbRemap[j].reset( new MeshOptimizer::VertexRemap( vbData[j].nVerts ) );
+
+                for( UINT k = 0; k < *nIBs; ++k )
+                {
+                    if ( ibOwner[k] == j )
+                    {
+                        vbRemap[j]->RemapIndices( &ibCopies[k].front(), ibCopies[k].size() );
+                    }
+                }
+            }
+        }
+
+        // Build index buffers
+        for( UINT j = 0; j < *nIBs; ++j )
+        {
+            size_t ibBytes = sizeof(USHORT) * ibData[j].nIndices;
+
+            if ( mergeBuffers )
+            {
+                ibBase[j] = merger.AddIndices( DXGI_FORMAT_R16_UINT, ibData[j].ptr, ibBytes );
+                continue;
+            }
+
+            D3D11_BUFFER_DESC desc = {0};
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.ByteWidth = static_cast<UINT>( ibBytes );
+            desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+            D3D11_SUBRESOURCE_DATA initData = {0};
+            initData.pSysMem = ibData[j].ptr;
+
+            ThrowIfFailed(
+                d3dDevice->CreateBuffer( &desc, &initData, &ibs[j] )
+                );
+
+            SetDebugObjectName( ibs[j].Get(), "ModelCMO" ); 
+        }
+
+        assert( ibs.size() == *nIBs );
+
         bool enableSkinning = ( *nSkinVBs ) != 0;
 
         // Build vertex buffers
         std::vector<ComPtr<ID3D11Buffer>> vbs;
         vbs.resize( *nVBs );
 
+        std::vector<uint32_t> vbBase;
+        vbBase.resize( *nVBs );
+
         const size_t stride = enableSkinning ? sizeof(VertexPositionNormalTangentColorTextureSkinning)
                                              : sizeof(VertexPositionNormalTangentColorTexture);
 
+        const size_t vbStride = !packed ? stride
+                                : enableSkinning ? sizeof(VertexPositionNormalTangentColorTextureSkinningPacked)
+                                                 : sizeof(VertexPositionNormalTangentColorTexturePacked);
+
         for( UINT j = 0; j < *nVBs; ++j )
         {
             size_t nVerts = vbData[ j ].nVerts;
@@ -622,9 +744,15 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
             desc.ByteWidth = static_cast<UINT>( bytes );
             desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
             
-            if ( fxFactoryDGSL && !enableSkinning )
+            if ( fxFactoryDGSL && !enableSkinning && !packed && !optimizeMesh )
             {
                 // Can use CMO vertex data directly
+                if ( mergeBuffers )
+                {
+                    vbBase[j] = merger.AddVertices( static_cast<uint32_t>( stride ), vbData[j].ptr, bytes );
+                    continue;
+                }
+
                 D3D11_SUBRESOURCE_DATA initData = {0};
                 initData.pSysMem = vbData[j].ptr;
 
@@ -634,9 +762,12 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
             }
             else
             {
-                std::unique_ptr<uint8_t> temp( new uint8_t[ bytes + ( sizeof(UINT) * nVerts ) ] );
+                // Temporary buffers for this vertex buffer go back to the allocator before the next.
+                ScratchArena scratch( allocator );
 
-                auto visited = reinterpret_cast<UINT*>( temp.get() + bytes );
+                auto temp = scratch.Allocate<uint8_t>( bytes + ( sizeof(UINT) * nVerts ) );
+
+                auto visited = reinterpret_cast<UINT*>( temp + bytes );
                 memset( visited, 0xff, sizeof(UINT) * nVerts );
 
                 assert( vbData[j].ptr != 0 );
@@ -647,7 +778,7 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
                     auto skinptr = vbData[j].skinPtr;
                     assert( skinptr != 0 );
 
-                    uint8_t* ptr = temp.get();
+                    uint8_t* ptr = temp;
 
                     auto sptr = vbData[j].ptr;
 
@@ -665,7 +796,12 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
                 }
                 else
                 {
-                    memcpy( temp.get(), vbData[j].ptr, bytes );
+                    memcpy( temp, vbData[j].ptr, bytes );
+                }
+
+                if ( optimizeMesh && vbRemap[j] )
+                {
+                    vbRemap[j]->RemapVertices( temp, stride );
                 }
 
                 if ( !fxFactoryDGSL )
@@ -695,7 +831,7 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
                             if ( v >= nVerts )
                                 throw std::exception("Invalid index found\n");
 
-                            auto verts = reinterpret_cast<VertexPositionNormalTangentColorTexture*>( temp.get() + ( v * stride ) );
+                            auto verts = reinterpret_cast<VertexPositionNormalTangentColorTexture*>( temp + ( v * stride ) );
                             if ( visited[v] == UINT(-1) )
                             {
                                 visited[v] = sm.MaterialIndex;
@@ -726,9 +862,47 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
                     }
                 }
 
+                const uint8_t* vbSource = temp;
+
+                uint8_t* packedTemp = nullptr;
+
+                if ( packed )
+                {
+                    size_t packedBytes = vbStride * nVerts;
+
+                    packedTemp = scratch.Allocate<uint8_t>( packedBytes );
+
+                    for( size_t v = 0; v < nVerts; ++v )
+                    {
+                        auto sptr = temp + ( v * stride );
+                        auto dptr = packedTemp + ( v * vbStride );
+
+                        if ( enableSkinning )
+                        {
+                            *reinterpret_cast<VertexPositionNormalTangentColorTextureSkinningPacked*>( dptr ) =
+                                VertexPositionNormalTangentColorTextureSkinningPacked( *reinterpret_cast<const VertexPositionNormalTangentColorTextureSkinning*>( sptr ) );
+                        }
+                        else
+                        {
+                            *reinterpret_cast<VertexPositionNormalTangentColorTexturePacked*>( dptr ) =
+                                VertexPositionNormalTangentColorTexturePacked( *reinterpret_cast<const VertexPositionNormalTangentColorTexture*>( sptr ) );
+                        }
+                    }
+
+                    vbSource = packedTemp;
+                    bytes = packedBytes;
+                    desc.ByteWidth = static_cast<UINT>( bytes );
+                }
+
+                if ( mergeBuffers )
+                {
+                    vbBase[j] = merger.AddVertices( static_cast<uint32_t>( vbStride ), vbSource, bytes );
+                    continue;
+                }
+
                 // Create vertex buffer from temporary buffer
                 D3D11_SUBRESOURCE_DATA initData = {0};
-                initData.pSysMem = temp.get();
+                initData.pSysMem = vbSource;
 
                 ThrowIfFailed(
                     d3dDevice->CreateBuffer( &desc, &initData, &vbs[j] )
@@ -787,7 +961,20 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
                 m.effect = fxFactory.CreateEffect( info, nullptr );
             }
 
-            CreateInputLayout( d3dDevice, m.effect.get(), &m.il, enableSkinning );
+            CreateInputLayout( d3dDevice, m.effect.get(), &m.il, enableSkinning, packed );
+
+            // Kept for SaveToCooked, which does not preserve DGSL pixel shaders or the extra textures.
+            m.material = std::make_shared<ModelMaterial>();
+            m.material->name = m.name;
+            m.material->texture = m.texture[0];
+            m.material->perVertexColor = true;
+            m.material->enableSkinning = enableSkinning;
+            m.material->specularPower = m.pMaterial->SpecularPower;
+            m.material->alpha = m.pMaterial->Diffuse.w;
+            m.material->ambientColor = XMFLOAT3( m.pMaterial->Ambient.x, m.pMaterial->Ambient.y, m.pMaterial->Ambient.z );
+            m.material->diffuseColor = XMFLOAT3( m.pMaterial->Diffuse.x, m.pMaterial->Diffuse.y, m.pMaterial->Diffuse.z );
+            m.material->specularColor = XMFLOAT3( m.pMaterial->Specular.x, m.pMaterial->Specular.y, m.pMaterial->Specular.z );
+            m.material->emissiveColor = XMFLOAT3( m.pMaterial->Emissive.x, m.pMaterial->Emissive.y, m.pMaterial->Emissive.z );
         }
 
         // Build mesh parts
@@ -802,19 +989,29 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
 
             auto& mat = materials[ sm.MaterialIndex ];
 
-            auto part = new ModelMeshPart();
+            auto part = new (allocator) ModelMeshPart();
 
             if ( mat.pMaterial->Diffuse.w < 1 )
                 part->isAlpha = true;
 
             part->indexCount = sm.PrimCount * 3;
-            part->startIndex = sm.StartIndex;
-            part->vertexStride = static_cast<UINT>( stride );
+            part->startIndex = sm.StartIndex + ibBase[ sm.IndexBufferIndex ];
+            part->vertexOffset = vbBase[ sm.VertexBufferIndex ];
+            part->vertexStride = static_cast<UINT>( vbStride );
             part->inputLayout = mat.il;
             part->indexBuffer = ibs[ sm.IndexBufferIndex ];
             part->vertexBuffer = vbs[ sm.VertexBufferIndex ];
             part->effect = mat.effect;
-            part->vbDecl = enableSkinning ? g_vbdeclSkinning : g_vbdecl;
+            part->material = mat.material;
+            if ( packed )
+                part->vbDecl = enableSkinning ? g_vbdeclSkinningPacked : g_vbdeclPacked;
+            else
+                part->vbDecl = enableSkinning ? g_vbdeclSkinning : g_vbdecl;
+
+            if ( mergeBuffers )
+            {
+                merger.AddPart( part );
+            }
 
             mesh->meshParts.emplace_back( part );
         }
@@ -822,24 +1019,37 @@ std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, c
         model->meshes.emplace_back( mesh );
     }
 
+    if ( mergeBuffers )
+    {
+        merger.CreateBuffers( d3dDevice, "ModelCMO" );
+    }
+
+    if ( optimizeMesh )
+    {
+        optimizer.GetStatistics( model->optimizationStatistics );
+
+        DebugTrace( "ModelCMO: %u triangles optimized, ACMR %.3f before and %.3f after\n",
+                    static_cast<unsigned int>( model->optimizationStatistics.triangles ),
+                    model->optimizationStatistics.acmrBefore, model->optimizationStatistics.acmrAfter );
+    }
+
     return model;
 }
 
 
 //--------------------------------------------------------------------------------------
 _Use_decl_annotations_
-std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, const wchar_t* szFileName, IEffectFactory& fxFactory, bool ccw, bool pmalpha )
+std::unique_ptr<Model> DirectX::Model::CreateFromCMO( ID3D11Device* d3dDevice, const wchar_t* szFileName, IEffectFactory& fxFactory, bool ccw, bool pmalpha, bool mergeBuffers, bool packVertices, bool optimizeMesh, IModelAllocator* allocator )
 {
-    size_t dataSize = 0;
-    std::unique_ptr<uint8_t[]> data;
-    HRESULT hr = BinaryReader::ReadEntireFile( szFileName, data, &dataSize );
+    BinaryReader::FileData data;
+    HRESULT hr = BinaryReader::LoadEntireFile( szFileName, data );
     if ( FAILED(hr) )
     {
         DebugTrace( "CreateFromCMO failed (%08X) loading '%ls'\n", hr, szFileName );
         throw std::exception( "CreateFromCMO" );
     }
 
-    auto model = CreateFromCMO( d3dDevice, data.get(), dataSize, fxFactory, ccw, pmalpha );
+    auto model = CreateFromCMO( d3dDevice, data.get(), data.size(), fxFactory, ccw, pmalpha, mergeBuffers, packVertices, optimizeMesh, allocator );
 
     model->name = szFileName;
 
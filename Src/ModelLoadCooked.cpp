@@ -0,0 +1,805 @@
+//--------------------------------------------------------------------------------------
+// File: ModelLoadCooked.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Model.h"
+
+#include "Effects.h"
+
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+#include "BinaryReader.h"
+#include "ModelAllocator.h"
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+
+//--------------------------------------------------------------------------------------
+// Cooked models are written by Model::SaveToCooked. The file is a header, a run of fixed size tables, a string
+// table, and then the vertex and index buffer blobs. Each blob is 16 byte aligned and holds exactly the bytes
+// given to CreateBuffer, and input layouts are stored as D3D11_INPUT_ELEMENT_DESC fields, so nothing needs
+// converting on load. Names are byte offsets into the string table, where offset 0 is the empty string.
+//
+//  Header
+//  Mesh[meshCount]
+//  Part[partCount]
+//  Material[materialCount]
+//  Layout[layoutCount]
+//  Element[elementCount]
+//  Buffer[vertexBufferCount]
+//  Buffer[indexBufferCount]
+//  string table
+//  buffer data, at bufferDataOffset
+//--------------------------------------------------------------------------------------
+
+namespace Cooked
+{
+    const uint32_t Magic = 0x4C444D43; // "CMDL"
+    const uint32_t Version = 1;
+
+    const uint32_t NoMaterial = 0xFFFFFFFF;
+    const uint32_t BufferAlignment = 16;
+
+    enum MeshFlags
+    {
+        Mesh_CCW                = 0x1,
+        Mesh_PremultipliedAlpha = 0x2,
+    };
+
+    enum MaterialFlags
+    {
+        Material_PerVertexColor = 0x1,
+        Material_Skinning       = 0x2,
+    };
+
+#pragma pack(push,4)
+
+    struct Header
+    {
+        uint32_t    magic;
+        uint32_t    version;
+        uint32_t    meshCount;
+        uint32_t    partCount;
+        uint32_t    materialCount;
+        uint32_t    layoutCount;
+        uint32_t    elementCount;
+        uint32_t    vertexBufferCount;
+        uint32_t    indexBufferCount;
+        uint32_t    stringTableSize;
+        uint32_t    bufferDataOffset;
+        uint32_t    bufferDataSize;
+    };
+
+    struct Mesh
+    {
+        uint32_t    name;
+        uint32_t    flags;
+        uint32_t    firstPart;
+        uint32_t    partCount;
+        XMFLOAT3    sphereCenter;
+        float       sphereRadius;
+        XMFLOAT3    boxCenter;
+        XMFLOAT3    boxExtents;
+    };
+
+    struct Part
+    {
+        uint32_t    vertexBuffer;
+        uint32_t    indexBuffer;
+        uint32_t    layout;
+        uint32_t    material;
+        uint32_t    indexCount;
+        uint32_t    startIndex;
+        uint32_t    vertexOffset;
+        uint32_t    vertexStride;
+        uint32_t    primitiveType;
+        uint32_t    indexFormat;
+        uint32_t    isAlpha;
+    };
+
+    struct Material
+    {
+        uint32_t    name;
+        uint32_t    texture;
+        uint32_t    flags;
+        float       specularPower;
+        float       alpha;
+        XMFLOAT3    ambientColor;
+        XMFLOAT3    diffuseColor;
+        XMFLOAT3    specularColor;
+        XMFLOAT3    emissiveColor;
+    };
+
+    struct Layout
+    {
+        uint32_t    firstElement;
+        uint32_t    elementCount;
+    };
+
+    struct Element
+    {
+        uint32_t    semanticName;
+        uint32_t    semanticIndex;
+        uint32_t    format;
+        uint32_t    inputSlot;
+        uint32_t    alignedByteOffset;
+        uint32_t    inputSlotClass;
+        uint32_t    instanceDataStepRate;
+    };
+
+    // Offset from bufferDataOffset, and size in bytes.
+    struct Buffer
+    {
+        uint32_t    offset;
+        uint32_t    size;
+    };
+
+#pragma pack(pop)
+
+}; // namespace
+
+static_assert( sizeof(Cooked::Header) == 48, "Cooked model structure size incorrect" );
+static_assert( sizeof(Cooked::Mesh) == 56, "Cooked model structure size incorrect" );
+static_assert( sizeof(Cooked::Part) == 44, "Cooked model structure size incorrect" );
+static_assert( sizeof(Cooked::Material) == 68, "Cooked model structure size incorrect" );
+static_assert( sizeof(Cooked::Layout) == 8, "Cooked model structure size incorrect" );
+static_assert( sizeof(Cooked::Element) == 28, "Cooked model structure size incorrect" );
+static_assert( sizeof(Cooked::Buffer) == 8, "Cooked model structure size incorrect" );
+
+
+//--------------------------------------------------------------------------------------
+// Writer helpers
+//--------------------------------------------------------------------------------------
+
+namespace
+{
+    // Strings are stored once each. Wide strings are kept 2 byte aligned.
+    class StringTable
+    {
+    public:
+        StringTable()
+          : mData(2, 0)
+        { }
+
+        uint32_t Add( std::wstring const& value )
+        {
+            if ( value.empty() )
+                return 0;
+
+            auto it = mWide.find( value );
+            if ( it != mWide.end() )
+                return it->second;
+
+            if ( mData.size() & 1 )
+                mData.push_back( 0 );
+
+            uint32_t offset = static_cast<uint32_t>( mData.size() );
+
+            auto bytes = reinterpret_cast<const uint8_t*>( value.c_str() );
+            mData.insert( mData.end(), bytes, bytes + ( value.size() + 1 ) * sizeof(wchar_t) );
+
+            mWide[ value ] = offset;
+            return offset;
+        }
+
+        uint32_t Add( _In_z_ const char* value )
+        {
+            if ( !*value )
+                return 0;
+
+            auto it = mNarrow.find( value );
+            if ( it != mNarrow.end() )
+                return it->second;
+
+            uint32_t offset = static_cast<uint32_t>( mData.size() );
+
+            mData.insert( mData.end(), value, value + strlen( value ) + 1 );
+
+            mNarrow[ value ] = offset;
+            return offset;
+        }
+
+        std::vector<uint8_t> const& GetData()
+        {
+            // Keep the tables that follow 4 byte aligned.
+            while ( mData.size() & 3 )
+                mData.push_back( 0 );
+
+            return mData;
+        }
+
+    private:
+        std::vector<uint8_t> mData;
+        std::map<std::wstring, uint32_t> mWide;
+        std::map<std::string, uint32_t> mNarrow;
+    };
+
+
+    template<typename T>
+    uint32_t AddUnique( std::map<T, uint32_t>& index, std::vector<T>& list, T value )
+    {
+        auto it = index.find( value );
+        if ( it != index.end() )
+            return it->second;
+
+        uint32_t result = static_cast<uint32_t>( list.size() );
+
+        index[ value ] = result;
+        list.push_back( value );
+
+        return result;
+    }
+
+
+    // Copies a buffer to the CPU through a staging buffer. Needs the immediate context.
+    void ReadBackBuffer( _In_ ID3D11DeviceContext* deviceContext, _In_ ID3D11Buffer* buffer, std::vector<uint8_t>& data )
+    {
+        D3D11_BUFFER_DESC desc;
+        buffer->GetDesc( &desc );
+
+        ComPtr<ID3D11Device> device;
+        deviceContext->GetDevice( &device );
+
+        D3D11_BUFFER_DESC stagingDesc = {0};
+        stagingDesc.ByteWidth = desc.ByteWidth;
+        stagingDesc.Usage = D3D11_USAGE_STAGING;
+        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+        ComPtr<ID3D11Buffer> staging;
+        ThrowIfFailed(
+            device->CreateBuffer( &stagingDesc, nullptr, &staging )
+            );
+
+        deviceContext->CopyResource( staging.Get(), buffer );
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        ThrowIfFailed(
+            deviceContext->Map( staging.Get(), 0, D3D11_MAP_READ, 0, &mapped )
+            );
+
+        auto bytes = static_cast<const uint8_t*>( mapped.pData );
+        data.assign( bytes, bytes + desc.ByteWidth );
+
+        deviceContext->Unmap( staging.Get(), 0 );
+    }
+
+
+    void AppendBuffers( _In_ ID3D11DeviceContext* deviceContext, std::vector<ID3D11Buffer*> const& buffers,
+                        std::vector<Cooked::Buffer>& table, std::vector<uint8_t>& bufferData )
+    {
+        std::vector<uint8_t> data;
+
+        for( auto it = buffers.cbegin(); it != buffers.cend(); ++it )
+        {
+            ReadBackBuffer( deviceContext, *it, data );
+
+            while ( bufferData.size() % Cooked::BufferAlignment )
+                bufferData.push_back( 0 );
+
+            if ( bufferData.size() + data.size() > UINT32_MAX )
+                throw std::exception("Model too large for the cooked format");
+
+            Cooked::Buffer entry;
+            entry.offset = static_cast<uint32_t>( bufferData.size() );
+            entry.size = static_cast<uint32_t>( data.size() );
+            table.push_back( entry );
+
+            bufferData.insert( bufferData.end(), data.begin(), data.end() );
+        }
+    }
+
+
+    template<typename T>
+    void AppendTable( std::vector<uint8_t>& file, std::vector<T> const& table )
+    {
+        if ( !table.empty() )
+        {
+            auto bytes = reinterpret_cast<const uint8_t*>( &table.front() );
+            file.insert( file.end(), bytes, bytes + table.size() * sizeof(T) );
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void Model::SaveToCooked( ID3D11DeviceContext* deviceContext, const wchar_t* szFileName ) const
+{
+    if ( !deviceContext || !szFileName )
+        throw std::exception("Device context and file name cannot be null");
+
+    if ( deviceContext->GetType() != D3D11_DEVICE_CONTEXT_IMMEDIATE )
+        throw std::exception("SaveToCooked must be given the immediate context, to read back the buffers");
+
+    StringTable strings;
+
+    std::vector<Cooked::Mesh> meshTable;
+    std::vector<Cooked::Part> partTable;
+    std::vector<Cooked::Material> materialTable;
+    std::vector<Cooked::Layout> layoutTable;
+    std::vector<Cooked::Element> elementTable;
+
+    std::map<ID3D11Buffer*, uint32_t> vbIndex;
+    std::map<ID3D11Buffer*, uint32_t> ibIndex;
+    std::map<const std::vector<D3D11_INPUT_ELEMENT_DESC>*, uint32_t> layoutIndex;
+    std::map<const ModelMaterial*, uint32_t> materialIndex;
+
+    std::vector<ID3D11Buffer*> vertexBuffers;
+    std::vector<ID3D11Buffer*> indexBuffers;
+    std::vector<const std::vector<D3D11_INPUT_ELEMENT_DESC>*> layouts;
+    std::vector<const ModelMaterial*> materials;
+
+    for( auto it = meshes.cbegin(); it != meshes.cend(); ++it )
+    {
+        auto mesh = it->get();
+        assert( mesh != 0 );
+
+        Cooked::Mesh cookedMesh;
+        cookedMesh.name = strings.Add( mesh->name );
+        cookedMesh.flags = ( mesh->ccw ? Cooked::Mesh_CCW : 0 ) | ( mesh->pmalpha ? Cooked::Mesh_PremultipliedAlpha : 0 );
+        cookedMesh.firstPart = static_cast<uint32_t>( partTable.size() );
+        cookedMesh.partCount = static_cast<uint32_t>( mesh->meshParts.size() );
+        cookedMesh.sphereCenter = mesh->boundingSphere.Center;
+        cookedMesh.sphereRadius = mesh->boundingSphere.Radius;
+        cookedMesh.boxCenter = mesh->boundingBox.Center;
+        cookedMesh.boxExtents = mesh->boundingBox.Extents;
+        meshTable.push_back( cookedMesh );
+
+        for( auto jt = mesh->meshParts.cbegin(); jt != mesh->meshParts.cend(); ++jt )
+        {
+            auto part = jt->get();
+            assert( part != 0 );
+
+            if ( !part->vertexBuffer || !part->indexBuffer || !part->vbDecl )
+                throw std::exception("SaveToCooked needs every part to have buffers and a vertex declaration");
+
+            Cooked::Part cookedPart;
+            cookedPart.vertexBuffer = AddUnique( vbIndex, vertexBuffers, part->vertexBuffer.Get() );
+            cookedPart.indexBuffer = AddUnique( ibIndex, indexBuffers, part->indexBuffer.Get() );
+            cookedPart.layout = AddUnique( layoutIndex, layouts, const_cast<const std::vector<D3D11_INPUT_ELEMENT_DESC>*>( part->vbDecl.get() ) );
+            cookedPart.material = part->material ? AddUnique( materialIndex, materials, const_cast<const ModelMaterial*>( part->material.get() ) )
+                                                 : Cooked::NoMaterial;
+            cookedPart.indexCount = part->indexCount;
+            cookedPart.startIndex = part->startIndex;
+            cookedPart.vertexOffset = part->vertexOffset;
+            cookedPart.vertexStride = part->vertexStride;
+            cookedPart.primitiveType = static_cast<uint32_t>( part->primitiveType );
+            cookedPart.indexFormat = static_cast<uint32_t>( part->indexFormat );
+            cookedPart.isAlpha = part->isAlpha ? 1 : 0;
+            partTable.push_back( cookedPart );
+        }
+    }
+
+    for( auto it = layouts.cbegin(); it != layouts.cend(); ++it )
+    {
+        Cooked::Layout layout;
+        layout.firstElement = static_cast<uint32_t>( elementTable.size() );
+        layout.elementCount = static_cast<uint32_t>( (*it)->size() );
+        layoutTable.push_back( layout );
+
+        for( auto jt = (*it)->cbegin(); jt != (*it)->cend(); ++jt )
+        {
+            Cooked::Element element;
+            element.semanticName = strings.Add( jt->SemanticName );
+            element.semanticIndex = jt->SemanticIndex;
+            element.format = static_cast<uint32_t>( jt->Format );
+            element.inputSlot = jt->InputSlot;
+            element.alignedByteOffset = jt->AlignedByteOffset;
+            element.inputSlotClass = static_cast<uint32_t>( jt->InputSlotClass );
+            element.instanceDataStepRate = jt->InstanceDataStepRate;
+            elementTable.push_back( element );
+        }
+    }
+
+    for( auto it = materials.cbegin(); it != materials.cend(); ++it )
+    {
+        auto material = *it;
+
+        Cooked::Material cookedMaterial;
+        cookedMaterial.name = strings.Add( material->name );
+        cookedMaterial.texture = strings.Add( material->texture );
+        cookedMaterial.flags = ( material->perVertexColor ? Cooked::Material_PerVertexColor : 0 )
+                               | ( material->enableSkinning ? Cooked::Material_Skinning : 0 );
+        cookedMaterial.specularPower = material->specularPower;
+        cookedMaterial.alpha = material->alpha;
+        cookedMaterial.ambientColor = material->ambientColor;
+        cookedMaterial.diffuseColor = material->diffuseColor;
+        cookedMaterial.specularColor = material->specularColor;
+        cookedMaterial.emissiveColor = material->emissiveColor;
+        materialTable.push_back( cookedMaterial );
+    }
+
+    std::vector<Cooked::Buffer> vbTable;
+    std::vector<Cooked::Buffer> ibTable;
+    std::vector<uint8_t> bufferData;
+
+    AppendBuffers( deviceContext, vertexBuffers, vbTable, bufferData );
+    AppendBuffers( deviceContext, indexBuffers, ibTable, bufferData );
+
+    auto& stringData = strings.GetData();
+
+    // Build the whole file in memory, so it goes out in a single write
+    Cooked::Header header;
+    header.magic = Cooked::Magic;
+    header.version = Cooked::Version;
+    header.meshCount = static_cast<uint32_t>( meshTable.size() );
+    header.partCount = static_cast<uint32_t>( partTable.size() );
+    header.materialCount = static_cast<uint32_t>( materialTable.size() );
+    header.layoutCount = static_cast<uint32_t>( layoutTable.size() );
+    header.elementCount = static_cast<uint32_t>( elementTable.size() );
+    header.vertexBufferCount = static_cast<uint32_t>( vbTable.size() );
+    header.indexBufferCount = static_cast<uint32_t>( ibTable.size() );
+    header.stringTableSize = static_cast<uint32_t>( stringData.size() );
+    header.bufferDataOffset = 0;
+    header.bufferDataSize = static_cast<uint32_t>( bufferData.size() );
+
+    std::vector<uint8_t> file( sizeof(header) );
+
+    AppendTable( file, meshTable );
+    AppendTable( file, partTable );
+    AppendTable( file, materialTable );
+    AppendTable( file, layoutTable );
+    AppendTable( file, elementTable );
+    AppendTable( file, vbTable );
+    AppendTable( file, ibTable );
+    AppendTable( file, stringData );
+
+    while ( file.size() % Cooked::BufferAlignment )
+        file.push_back( 0 );
+
+    if ( file.size() + bufferData.size() > UINT32_MAX )
+        throw std::exception("Model too large for the cooked format");
+
+    header.bufferDataOffset = static_cast<uint32_t>( file.size() );
+    memcpy( &file.front(), &header, sizeof(header) );
+
+    file.insert( file.end(), bufferData.begin(), bufferData.end() );
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile( safe_handle( CreateFile2( szFileName, GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr ) ) );
+#else
+    ScopedHandle hFile( safe_handle( CreateFileW( szFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr ) ) );
+#endif
+    if ( !hFile )
+    {
+        DebugTrace( "SaveToCooked failed (%08X) creating '%ls'\n", HRESULT_FROM_WIN32( GetLastError() ), szFileName );
+        throw std::exception( "SaveToCooked" );
+    }
+
+    DWORD bytesWritten;
+    if ( !WriteFile( hFile.get(), &file.front(), static_cast<DWORD>( file.size() ), &bytesWritten, nullptr )
+         || bytesWritten != file.size() )
+    {
+        DebugTrace( "SaveToCooked failed (%08X) writing '%ls'\n", HRESULT_FROM_WIN32( GetLastError() ), szFileName );
+        throw std::exception( "SaveToCooked" );
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Loader helpers
+//--------------------------------------------------------------------------------------
+
+namespace
+{
+    const wchar_t* GetWideString( _In_reads_bytes_(tableSize) const uint8_t* table, size_t tableSize, uint32_t offset )
+    {
+        if ( ( offset & 1 ) || offset >= tableSize )
+            throw std::exception("Invalid string found");
+
+        auto str = reinterpret_cast<const wchar_t*>( table + offset );
+        size_t maxLength = ( tableSize - offset ) / sizeof(wchar_t);
+
+        if ( wcsnlen( str, maxLength ) >= maxLength )
+            throw std::exception("Invalid string found");
+
+        return str;
+    }
+
+
+    const char* GetString( _In_reads_bytes_(tableSize) const uint8_t* table, size_t tableSize, uint32_t offset )
+    {
+        if ( offset >= tableSize )
+            throw std::exception("Invalid string found");
+
+        auto str = reinterpret_cast<const char*>( table + offset );
+        size_t maxLength = tableSize - offset;
+
+        if ( strnlen( str, maxLength ) >= maxLength )
+            throw std::exception("Invalid string found");
+
+        return str;
+    }
+
+
+    // Input element descriptions hold on to their semantic names, which must outlive the file data.
+    const char* InternSemanticName( _In_z_ const char* name )
+    {
+        static std::set<std::string> names;
+        static std::mutex mutex;
+
+        std::lock_guard<std::mutex> lock( mutex );
+
+        return names.insert( name ).first->c_str();
+    }
+
+
+    template<typename T>
+    const T* GetTable( _In_reads_bytes_(dataSize) const uint8_t* meshData, size_t dataSize, size_t& usedSize, uint32_t count )
+    {
+        auto table = reinterpret_cast<const T*>( meshData + usedSize );
+
+        uint64_t bytes = uint64_t( sizeof(T) ) * count;
+        if ( dataSize < usedSize + bytes )
+            throw std::exception("End of file");
+
+        usedSize += static_cast<size_t>( bytes );
+
+        return table;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+std::unique_ptr<Model> DirectX::Model::CreateFromCooked( ID3D11Device* d3dDevice, const uint8_t* meshData, size_t dataSize, IEffectFactory& fxFactory, IModelAllocator* allocator )
+{
+    if ( !d3dDevice || !meshData )
+        throw std::exception("Device and meshData cannot be null");
+
+    // File Header
+    if ( dataSize < sizeof(Cooked::Header) )
+        throw std::exception("End of file");
+
+    auto header = reinterpret_cast<const Cooked::Header*>( meshData );
+
+    if ( header->magic != Cooked::Magic )
+        throw std::exception("Not a cooked model file");
+
+    if ( header->version != Cooked::Version )
+        throw std::exception("Not a supported cooked model version");
+
+    size_t usedSize = sizeof(Cooked::Header);
+
+    auto meshTable = GetTable<Cooked::Mesh>( meshData, dataSize, usedSize, header->meshCount );
+    auto partTable = GetTable<Cooked::Part>( meshData, dataSize, usedSize, header->partCount );
+    auto materialTable = GetTable<Cooked::Material>( meshData, dataSize, usedSize, header->materialCount );
+    auto layoutTable = GetTable<Cooked::Layout>( meshData, dataSize, usedSize, header->layoutCount );
+    auto elementTable = GetTable<Cooked::Element>( meshData, dataSize, usedSize, header->elementCount );
+    auto vbTable = GetTable<Cooked::Buffer>( meshData, dataSize, usedSize, header->vertexBufferCount );
+    auto ibTable = GetTable<Cooked::Buffer>( meshData, dataSize, usedSize, header->indexBufferCount );
+
+    auto stringTable = GetTable<uint8_t>( meshData, dataSize, usedSize, header->stringTableSize );
+    size_t stringTableSize = header->stringTableSize;
+
+    if ( header->bufferDataOffset < usedSize
+         || ( dataSize < uint64_t( header->bufferDataOffset ) + header->bufferDataSize ) )
+        throw std::exception("End of file");
+
+    auto bufferData = meshData + header->bufferDataOffset;
+
+    // Create the buffers straight from the file data
+    std::vector<ComPtr<ID3D11Buffer>> vbs;
+    vbs.resize( header->vertexBufferCount );
+
+    std::vector<ComPtr<ID3D11Buffer>> ibs;
+    ibs.resize( header->indexBufferCount );
+
+    for( uint32_t j = 0; j < header->vertexBufferCount + header->indexBufferCount; ++j )
+    {
+        bool isVertexBuffer = ( j < header->vertexBufferCount );
+
+        auto& entry = isVertexBuffer ? vbTable[ j ] : ibTable[ j - header->vertexBufferCount ];
+
+        if ( !entry.size || ( header->bufferDataSize < uint64_t( entry.offset ) + entry.size ) )
+            throw std::exception("Invalid buffer found");
+
+        D3D11_BUFFER_DESC desc = {0};
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.ByteWidth = entry.size;
+        desc.BindFlags = isVertexBuffer ? D3D11_BIND_VERTEX_BUFFER : D3D11_BIND_INDEX_BUFFER;
+
+        D3D11_SUBRESOURCE_DATA initData = {0};
+        initData.pSysMem = bufferData + entry.offset;
+
+        auto& buffer = isVertexBuffer ? vbs[ j ] : ibs[ j - header->vertexBufferCount ];
+
+        ThrowIfFailed(
+            d3dDevice->CreateBuffer( &desc, &initData, &buffer )
+            );
+
+        SetDebugObjectName( buffer.Get(), "ModelCooked" );
+    }
+
+    // Vertex declarations
+    std::vector<std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>>> layouts;
+    layouts.reserve( header->layoutCount );
+
+    for( uint32_t j = 0; j < header->layoutCount; ++j )
+    {
+        auto& layout = layoutTable[ j ];
+
+        if ( !layout.elementCount
+             || ( header->elementCount < uint64_t( layout.firstElement ) + layout.elementCount ) )
+            throw std::exception("Invalid layout found");
+
+        auto decl = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>();
+        decl->reserve( layout.elementCount );
+
+        for( uint32_t k = 0; k < layout.elementCount; ++k )
+        {
+            auto& element = elementTable[ layout.firstElement + k ];
+
+            D3D11_INPUT_ELEMENT_DESC desc;
+            desc.SemanticName = InternSemanticName( GetString( stringTable, stringTableSize, element.semanticName ) );
+            desc.SemanticIndex = element.semanticIndex;
+            desc.Format = static_cast<DXGI_FORMAT>( element.format );
+            desc.InputSlot = element.inputSlot;
+            desc.AlignedByteOffset = element.alignedByteOffset;
+            desc.InputSlotClass = static_cast<D3D11_INPUT_CLASSIFICATION>( element.inputSlotClass );
+            desc.InstanceDataStepRate = element.instanceDataStepRate;
+            decl->push_back( desc );
+        }
+
+        layouts.push_back( decl );
+    }
+
+    // Effects, one for each material
+    std::vector<std::shared_ptr<ModelMaterial>> materials;
+    materials.reserve( header->materialCount );
+
+    std::vector<std::shared_ptr<IEffect>> effects;
+    effects.reserve( header->materialCount );
+
+    for( uint32_t j = 0; j < header->materialCount; ++j )
+    {
+        auto& cookedMaterial = materialTable[ j ];
+
+        auto material = std::make_shared<ModelMaterial>();
+        material->name = GetWideString( stringTable, stringTableSize, cookedMaterial.name );
+        material->texture = GetWideString( stringTable, stringTableSize, cookedMaterial.texture );
+        material->perVertexColor = ( cookedMaterial.flags & Cooked::Material_PerVertexColor ) != 0;
+        material->enableSkinning = ( cookedMaterial.flags & Cooked::Material_Skinning ) != 0;
+        material->specularPower = cookedMaterial.specularPower;
+        material->alpha = cookedMaterial.alpha;
+        material->ambientColor = cookedMaterial.ambientColor;
+        material->diffuseColor = cookedMaterial.diffuseColor;
+        material->specularColor = cookedMaterial.specularColor;
+        material->emissiveColor = cookedMaterial.emissiveColor;
+
+        EffectFactory::EffectInfo info;
+        info.name = material->name.c_str();
+        info.perVertexColor = material->perVertexColor;
+        info.enableSkinning = material->enableSkinning;
+        info.specularPower = material->specularPower;
+        info.alpha = material->alpha;
+        info.ambientColor = material->ambientColor;
+        info.diffuseColor = material->diffuseColor;
+        info.specularColor = material->specularColor;
+        info.emissiveColor = material->emissiveColor;
+        info.texture = material->texture.empty() ? nullptr : material->texture.c_str();
+
+        effects.push_back( fxFactory.CreateEffect( info, nullptr ) );
+        materials.push_back( material );
+    }
+
+    // Parts saved without a material get the same default effect as CreateFromVBO
+    std::shared_ptr<IEffect> defaultEffect;
+
+    // Input layouts are shared between parts with the same declaration and effect
+    std::map<std::pair<uint32_t, uint32_t>, ComPtr<ID3D11InputLayout>> inputLayouts;
+
+    std::unique_ptr<Model> model(new (allocator) Model());
+    model->meshes.reserve( header->meshCount );
+
+    for( uint32_t meshIndex = 0; meshIndex < header->meshCount; ++meshIndex )
+    {
+        auto& cookedMesh = meshTable[ meshIndex ];
+
+        if ( header->partCount < uint64_t( cookedMesh.firstPart ) + cookedMesh.partCount )
+            throw std::exception("Invalid mesh found");
+
+        auto mesh = CreateModelMesh( allocator );
+        mesh->name = GetWideString( stringTable, stringTableSize, cookedMesh.name );
+        mesh->ccw = ( cookedMesh.flags & Cooked::Mesh_CCW ) != 0;
+        mesh->pmalpha = ( cookedMesh.flags & Cooked::Mesh_PremultipliedAlpha ) != 0;
+        mesh->boundingSphere.Center = cookedMesh.sphereCenter;
+        mesh->boundingSphere.Radius = cookedMesh.sphereRadius;
+        mesh->boundingBox.Center = cookedMesh.boxCenter;
+        mesh->boundingBox.Extents = cookedMesh.boxExtents;
+
+        mesh->meshParts.reserve( cookedMesh.partCount );
+
+        for( uint32_t j = 0; j < cookedMesh.partCount; ++j )
+        {
+            auto& cookedPart = partTable[ cookedMesh.firstPart + j ];
+
+            if ( cookedPart.vertexBuffer >= header->vertexBufferCount
+                 || cookedPart.indexBuffer >= header->indexBufferCount
+                 || cookedPart.layout >= header->layoutCount
+                 || ( cookedPart.material != Cooked::NoMaterial && cookedPart.material >= header->materialCount ) )
+                throw std::exception("Invalid part found");
+
+            if ( cookedPart.indexFormat != DXGI_FORMAT_R16_UINT && cookedPart.indexFormat != DXGI_FORMAT_R32_UINT )
+                throw std::exception("Invalid index format found");
+
+            std::unique_ptr<ModelMeshPart> part( new (allocator) ModelMeshPart() );
+            part->indexCount = cookedPart.indexCount;
+            part->startIndex = cookedPart.startIndex;
+            part->vertexOffset = cookedPart.vertexOffset;
+            part->vertexStride = cookedPart.vertexStride;
+            part->primitiveType = static_cast<D3D_PRIMITIVE_TOPOLOGY>( cookedPart.primitiveType );
+            part->indexFormat = static_cast<DXGI_FORMAT>( cookedPart.indexFormat );
+            part->isAlpha = ( cookedPart.isAlpha != 0 );
+            part->vertexBuffer = vbs[ cookedPart.vertexBuffer ];
+            part->indexBuffer = ibs[ cookedPart.indexBuffer ];
+            part->vbDecl = layouts[ cookedPart.layout ];
+
+            if ( cookedPart.material != Cooked::NoMaterial )
+            {
+                part->effect = effects[ cookedPart.material ];
+                part->material = materials[ cookedPart.material ];
+            }
+            else
+            {
+                if ( !defaultEffect )
+                {
+                    auto effect = std::make_shared<BasicEffect>( d3dDevice );
+                    effect->EnableDefaultLighting();
+                    effect->SetLightingEnabled( true );
+
+                    defaultEffect = effect;
+                }
+
+                part->effect = defaultEffect;
+            }
+
+            auto& il = inputLayouts[ std::make_pair( cookedPart.layout, cookedPart.material ) ];
+
+            if ( !il )
+            {
+                part->CreateInputLayout( d3dDevice, part->effect.get(), &il );
+
+                SetDebugObjectName( il.Get(), "ModelCooked" );
+            }
+
+            part->inputLayout = il;
+
+            mesh->meshParts.push_back( std::move( part ) );
+        }
+
+        model->meshes.push_back( mesh );
+    }
+
+    return model;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+std::unique_ptr<Model> DirectX::Model::CreateFromCooked( ID3D11Device* d3dDevice, const wchar_t* szFileName, IEffectFactory& fxFactory, IModelAllocator* allocator )
+{
+    BinaryReader::FileData data;
+    HRESULT hr = BinaryReader::LoadEntireFile( szFileName, data );
+    if ( FAILED(hr) )
+    {
+        DebugTrace( "CreateFromCooked failed (%08X) loading '%ls'\n", hr, szFileName );
+        throw std::exception( "CreateFromCooked" );
+    }
+
+    auto model = CreateFromCooked( d3dDevice, data.get(), data.size(), fxFactory, allocator );
+
+    model->name = szFileName;
+
+    return model;
+}
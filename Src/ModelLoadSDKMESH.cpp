@@ -20,6 +20,10 @@
 #include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
 #include "BinaryReader.h"
+#include "MeshOptimizer.h"
+#include "ModelAllocator.h"
+#include "ModelBufferMerger.h"
+#include "VertexPacker.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -372,6 +376,7 @@ static_assert( sizeof(DXUT::SDKANIMATION_FRAME_DATA) == 112, "SDK Mesh structure
 struct MaterialRecordSDKMESH
 {
     std::shared_ptr<IEffect> effect;
+    std::shared_ptr<ModelMaterial> material;
     bool alpha;
 };
 
@@ -412,6 +417,18 @@ static void LoadMaterial( _In_ const DXUT::SDKMESH_MATERIAL& mh,
            
     m.effect = fxFactory.CreateEffect( info, nullptr );
     m.alpha = (info.alpha < 1.f);
+
+    m.material = std::make_shared<ModelMaterial>();
+    m.material->name = matName;
+    m.material->texture = txtName;
+    m.material->perVertexColor = perVertexColor;
+    m.material->enableSkinning = enableSkinning;
+    m.material->specularPower = info.specularPower;
+    m.material->alpha = info.alpha;
+    m.material->ambientColor = info.ambientColor;
+    m.material->diffuseColor = info.diffuseColor;
+    m.material->specularColor = info.specularColor;
+    m.material->emissiveColor = info.emissiveColor;
 }
 
 
@@ -601,6 +618,23 @@ static void GetInputLayoutDesc( _In_reads_(32) const DXUT::D3DVERTEXELEMENT9 dec
 }
 
 // Helper for creating a D3D input layout.
+// Offset of a float3 element in a vertex declaration, or -1 if it has none.
+static int FindFloat3Element( _In_reads_(32) const DXUT::D3DVERTEXELEMENT9 decl[], BYTE usage )
+{
+    for( uint32_t index = 0; index < DXUT::MAX_VERTEX_ELEMENTS; ++index )
+    {
+        if ( decl[index].Usage == 0xFF || decl[index].Type == DXUT::D3DDECLTYPE_UNUSED )
+            break;
+
+        if ( decl[index].Usage == usage && decl[index].UsageIndex == 0 && decl[index].Type == DXUT::D3DDECLTYPE_FLOAT3 )
+            return decl[index].Offset;
+    }
+
+    return -1;
+}
+
+
+//--------------------------------------------------------------------------------------
 static void CreateInputLayout(_In_ ID3D11Device* device, _In_ IEffect* effect, std::vector<D3D11_INPUT_ELEMENT_DESC>& inputDesc, _Out_ ID3D11InputLayout** pInputLayout)
 {
     void const* shaderByteCode;
@@ -624,7 +658,7 @@ static void CreateInputLayout(_In_ ID3D11Device* device, _In_ IEffect* effect, s
 //======================================================================================
 
 _Use_decl_annotations_
-std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevice, const uint8_t* meshData, size_t dataSize, IEffectFactory& fxFactory, bool ccw, bool pmalpha )
+std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevice, const uint8_t* meshData, size_t dataSize, IEffectFactory& fxFactory, bool ccw, bool pmalpha, bool mergeBuffers, bool packVertices, bool optimizeMesh, IModelAllocator* allocator )
 {
     if ( !d3dDevice || !meshData )
         throw std::exception("Device and meshData cannot be null");
@@ -702,6 +736,146 @@ std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevic
         throw std::exception("End of file");
     const uint8_t* bufferData = meshData + bufferDataOffset; 
 
+    // When merging, buffers with the same stride or index format are packed together, so each file buffer
+    // becomes a base vertex or start index within them.
+    ModelBufferMerger merger;
+
+    std::vector<uint32_t> vbBase;
+    vbBase.resize( header->NumVertexBuffers );
+
+    std::vector<uint32_t> ibBase;
+    ibBase.resize( header->NumIndexBuffers );
+
+    // Optional mesh optimization reorders the triangle list subsets in copies of the index buffers, then renumbers
+    // the vertices of each vertex buffer whose index buffers use no other vertex buffer.
+    MeshOptimizer optimizer;
+
+    std::vector<std::vector<uint8_t>> ibCopies;
+    std::vector<std::unique_ptr<MeshOptimizer::VertexRemap>> vbRemap;
+
+    if ( optimizeMesh )
+    {
+        ibCopies.resize( header->NumIndexBuffers );
+
+        for( UINT j=0; j < header->NumIndexBuffers; ++j )
+        {
+            auto& ih = ibArray[j];
+
+            if ( dataSize < ih.DataOffset
+                 || ( dataSize < ih.DataOffset + ih.SizeBytes ) )
+                throw std::exception("End of file");
+
+            if ( ih.IndexType != DXUT::IT_16BIT && ih.IndexType != DXUT::IT_32BIT )
+                throw std::exception("Invalid index buffer type found");
+
+            auto indices = reinterpret_cast<const uint8_t*>( bufferData + (ih.DataOffset - bufferDataOffset) );
+
+            ibCopies[j].assign( indices, indices + ih.SizeBytes );
+        }
+
+        std::vector<UINT> ibOwner( header->NumIndexBuffers, UINT(-1) );
+        std::vector<bool> remappable( header->NumVertexBuffers, true );
+
+        for( UINT meshIndex = 0; meshIndex < header->NumMeshes; ++meshIndex )
+        {
+            auto& mh = meshArray[ meshIndex ];
+
+            if ( !mh.NumSubsets
+                 || !mh.NumVertexBuffers
+                 || mh.IndexBuffer >= header->NumIndexBuffers
+                 || mh.VertexBuffers[0] >= header->NumVertexBuffers )
+                throw std::exception("Invalid mesh found");
+
+            if ( dataSize < mh.SubsetOffset
+                 || (dataSize < mh.SubsetOffset + mh.NumSubsets*sizeof(UINT) ) )
+                throw std::exception("End of file");
+
+            auto& vh = vbArray[ mh.VertexBuffers[0] ];
+
+            if ( dataSize < vh.DataOffset
+                 || ( dataSize < vh.DataOffset + vh.SizeBytes ) )
+                throw std::exception("End of file");
+
+            auto& owner = ibOwner[ mh.IndexBuffer ];
+
+            if ( owner == UINT(-1) )
+            {
+                owner = mh.VertexBuffers[0];
+            }
+            else if ( owner != mh.VertexBuffers[0] )
+            {
+                remappable[ owner ] = false;
+                remappable[ mh.VertexBuffers[0] ] = false;
+            }
+
+            int positionOffset = FindFloat3Element( vh.Decl, DXUT::D3DDECLUSAGE_POSITION );
+            int normalOffset = FindFloat3Element( vh.Decl, DXUT::D3DDECLUSAGE_NORMAL );
+
+            if ( positionOffset < 0 || !vh.StrideBytes )
+                continue;
+
+            auto verts = reinterpret_cast<const uint8_t*>( bufferData + (vh.DataOffset - bufferDataOffset) );
+            size_t nVerts = static_cast<size_t>( vh.SizeBytes / vh.StrideBytes );
+            size_t stride = static_cast<size_t>( vh.StrideBytes );
+
+            auto& ibCopy = ibCopies[ mh.IndexBuffer ];
+            bool use32 = ( ibArray[ mh.IndexBuffer ].IndexType == DXUT::IT_32BIT );
+            size_t nIndices = ibCopy.size() / ( use32 ? sizeof(uint32_t) : sizeof(uint16_t) );
+
+            auto subsets = reinterpret_cast<const UINT*>( meshData + mh.SubsetOffset );
+
+            for( UINT j = 0; j < mh.NumSubsets; ++j )
+            {
+                auto sIndex = subsets[ j ];
+                if ( sIndex >= header->NumTotalSubsets )
+                    throw std::exception("Invalid mesh found");
+
+                auto& subset = subsetArray[ sIndex ];
+
+                if ( subset.PrimitiveType != DXUT::PT_TRIANGLE_LIST || !subset.IndexCount )
+                    continue;
+
+                if ( subset.IndexStart + subset.IndexCount > nIndices )
+                    throw std::exception("Invalid mesh found");
+
+                if ( use32 )
+                {
+                    optimizer.OptimizeFaces( reinterpret_cast<uint32_t*>( &ibCopy.front() ) + subset.IndexStart, static_cast<size_t>( subset.IndexCount ), nVerts,
+                                             verts + positionOffset, ( normalOffset >= 0 ) ? verts + normalOffset : nullptr, stride );
+                }
+                else
+                {
+                    optimizer.OptimizeFaces( reinterpret_cast<uint16_t*>( &ibCopy.front() ) + subset.IndexStart, static_cast<size_t>( subset.IndexCount ), nVerts,
+                                             verts + positionOffset, ( normalOffset >= 0 ) ? verts + normalOffset : nullptr, stride );
+                }
+            }
+        }
+
+        vbRemap.resize( header->NumVertexBuffers );
+
+        for( UINT k = 0; k < header->NumIndexBuffers; ++k )
+        {
+            UINT j = ibOwner[k];
+
+            if ( j == UINT(-1) || !remappable[j] || !vbArray[j].StrideBytes || ibCopies[k].empty() )
+                continue;
+
+            if ( !vbRemap[j] )
+            {
+                vbRemap[j].reset( new MeshOptimizer::VertexRemap( static_cast<size_t>( vbArray[j].SizeBytes / vbArray[j].StrideBytes ) ) );
+            }
+
+            if ( ibArray[k].IndexType == DXUT::IT_32BIT )
+            {
+                vbRemap[j]->RemapIndices( reinterpret_cast<uint32_t*>( &ibCopies[k].front() ), ibCopies[k].size() / sizeof(uint32_t) );
+            }
+            else
+            {
+                vbRemap[j]->RemapIndices( reinterpret_cast<uint16_t*>( &ibCopies[k].front() ), ibCopies[k].size() / sizeof(uint16_t) );
+            }
+        }
+    }
+
     // Create vertex buffers
     std::vector<ComPtr<ID3D11Buffer>> vbs;
     vbs.resize( header->NumVertexBuffers );
@@ -715,6 +889,11 @@ std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevic
     std::vector<bool> enableSkinning;
     enableSkinning.resize( header->NumVertexBuffers );
 
+    std::vector<uint32_t> vbStrides;
+    vbStrides.resize( header->NumVertexBuffers );
+
+    bool packed = packVertices && VertexPacker::IsSupported( d3dDevice );
+
     for( UINT j=0; j < header->NumVertexBuffers; ++j )
     {
         auto& vh = vbArray[j];
@@ -732,9 +911,53 @@ std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevic
 
         auto verts = reinterpret_cast<const uint8_t*>( bufferData + (vh.DataOffset - bufferDataOffset) );
 
+        vbStrides[j] = static_cast<uint32_t>( vh.StrideBytes );
+
+        // Temporary buffers for this vertex buffer go back to the allocator before the next.
+        ScratchArena scratch( allocator );
+
+        if ( optimizeMesh && vbRemap[j] )
+        {
+            auto remappedVerts = scratch.Allocate<uint8_t>( static_cast<size_t>( vh.SizeBytes ) );
+            memcpy( remappedVerts, verts, static_cast<size_t>( vh.SizeBytes ) );
+
+            vbRemap[j]->RemapVertices( remappedVerts, static_cast<size_t>( vh.StrideBytes ) );
+
+            verts = remappedVerts;
+        }
+
+        size_t bytes = static_cast<size_t>( vh.SizeBytes );
+
+        // Any element the packer doesn't know about leaves the buffer as it is in the file.
+        if ( packed && vh.StrideBytes > 0 )
+        {
+            VertexPacker packer( *vbDecls[j].get(), static_cast<size_t>( vh.StrideBytes ) );
+
+            if ( packer.IsPacking() )
+            {
+                size_t nVerts = static_cast<size_t>( vh.SizeBytes / vh.StrideBytes );
+
+                bytes = packer.GetOutputStride() * nVerts;
+
+                auto packedVerts = scratch.Allocate<uint8_t>( bytes );
+
+                packer.Pack( verts, nVerts, packedVerts );
+
+                verts = packedVerts;
+                vbStrides[j] = static_cast<uint32_t>( packer.GetOutputStride() );
+                vbDecls[j] = packer.GetOutputDecl();
+            }
+        }
+
+        if ( mergeBuffers )
+        {
+            vbBase[j] = merger.AddVertices( vbStrides[j], verts, bytes );
+            continue;
+        }
+
         D3D11_BUFFER_DESC desc = {0};
         desc.Usage = D3D11_USAGE_DEFAULT;
-        desc.ByteWidth = static_cast<UINT>( vh.SizeBytes );
+        desc.ByteWidth = static_cast<UINT>( bytes );
         desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 
         D3D11_SUBRESOURCE_DATA initData = {0};
@@ -764,6 +987,18 @@ std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevic
 
         auto indices = reinterpret_cast<const uint8_t*>( bufferData + (ih.DataOffset - bufferDataOffset) );
 
+        if ( optimizeMesh && !ibCopies[j].empty() )
+        {
+            indices = &ibCopies[j].front();
+        }
+
+        if ( mergeBuffers )
+        {
+            ibBase[j] = merger.AddIndices( ( ih.IndexType == DXUT::IT_32BIT ) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT,
+                                           indices, static_cast<size_t>( ih.SizeBytes ) );
+            continue;
+        }
+
         D3D11_BUFFER_DESC desc = {0};
         desc.Usage = D3D11_USAGE_DEFAULT;
         desc.ByteWidth = static_cast<UINT>( ih.SizeBytes );
@@ -783,7 +1018,7 @@ std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevic
     std::vector<MaterialRecordSDKMESH> materials;
     materials.resize( header->NumMaterials );
 
-    std::unique_ptr<Model> model(new Model());
+    std::unique_ptr<Model> model(new (allocator) Model());
     model->meshes.reserve( header->NumMeshes );
 
     for( UINT meshIndex = 0; meshIndex < header->NumMeshes; ++meshIndex )
@@ -813,7 +1048,7 @@ std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevic
             // TODO - auto influences = reinterpret_cast<const UINT*>( meshData + mh.FrameInfluenceOffset );
         }
 
-        auto mesh = std::make_shared<ModelMesh>();
+        auto mesh = CreateModelMesh( allocator );
         WCHAR meshName[ DXUT::MAX_MESH_NAME ];
         MultiByteToWideChar( CP_ACP, MB_PRECOMPOSED, mh.Name, -1, meshName, DXUT::MAX_MESH_NAME );
         mesh->name = meshName;
@@ -871,44 +1106,64 @@ std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevic
             ComPtr<ID3D11InputLayout> il;
             CreateInputLayout( d3dDevice, mat.effect.get(), *vbDecls[ mh.VertexBuffers[0] ].get(), &il );
 
-            auto part = new ModelMeshPart();
+            auto part = new (allocator) ModelMeshPart();
             part->isAlpha = mat.alpha;
 
             part->indexCount = static_cast<uint32_t>( subset.IndexCount );
-            part->startIndex = static_cast<uint32_t>( subset.IndexStart );
-            part->vertexStride = static_cast<uint32_t>( vbArray[ mh.VertexBuffers[0] ].StrideBytes );
+            part->startIndex = static_cast<uint32_t>( subset.IndexStart ) + ibBase[ mh.IndexBuffer ];
+            part->vertexOffset = vbBase[ mh.VertexBuffers[0] ];
+            part->vertexStride = vbStrides[ mh.VertexBuffers[0] ];
             part->indexFormat = ( ibArray[ mh.IndexBuffer ].IndexType == DXUT::IT_32BIT ) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
             part->primitiveType = primType; 
             part->inputLayout = il;
             part->indexBuffer = ibs[ mh.IndexBuffer ];
             part->vertexBuffer = vbs[ mh.VertexBuffers[0] ];
             part->effect = mat.effect;
+            part->material = mat.material;
             part->vbDecl = vbDecls[ mh.VertexBuffers[0] ];
 
+            if ( mergeBuffers )
+            {
+                merger.AddPart( part );
+            }
+
             mesh->meshParts.emplace_back( part );
         }
 
         model->meshes.emplace_back( mesh );
     }
 
+    if ( mergeBuffers )
+    {
+        merger.CreateBuffers( d3dDevice, "ModelSDKMESH" );
+    }
+
+    if ( optimizeMesh )
+    {
+        optimizer.GetStatistics( model->optimizationStatistics );
+
+        DebugTrace( "ModelSDKMESH: %u triangles optimized, ACMR %.3f before and %.3f after\n",
+                    static_cast<unsigned int>( model->optimizationStatistics.triangles ),
+                    model->optimizationStatistics.acmrBefore, model->optimizationStatistics.acmrAfter );
+    }
+
     return model;
 }
 
 
 //--------------------------------------------------------------------------------------
 _Use_decl_annotations_
-std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevice, const wchar_t* szFileName, IEffectFactory& fxFactory, bool ccw, bool pmalpha )
+std::unique_ptr<Model> DirectX::Model::CreateFromSDKMESH( ID3D11Device* d3dDevice, const wchar_t* szFileName, IEffectFactory& fxFactory, bool ccw, bool pmalpha, bool mergeBuffers, bool packVertices, bool optimizeMesh, IModelAllocator* allocator )
 {
-    size_t dataSize = 0;
-    std::unique_ptr<uint8_t[]> data;
-    HRESULT hr = BinaryReader::ReadEntireFile( szFileName, data, &dataSize );
+    BinaryReader::FileData data;
+    HRESULT hr = BinaryReader::LoadEntireFile( szFileName, data );
     if ( FAILED(hr) )
     {
         DebugTrace( "CreateFromSDKMESH failed (%08X) loading '%ls'\n", hr, szFileName );
         throw std::exception( "CreateFromSDKMESH" );
     }
 
-    auto model = CreateFromSDKMESH( d3dDevice, data.get(), dataSize, fxFactory, ccw, pmalpha );
+    auto model = CreateFromSDKMESH( d3dDevice, data.get(), data.size(), fxFactory, ccw, pmalpha, mergeBuffers, packVertices, optimizeMesh, allocator );
 
     model->name = szFileName;
 
@@ -20,6 +20,9 @@
 #include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
 #include "BinaryReader.h"
+#include "MeshOptimizer.h"
+#include "ModelAllocator.h"
+#include "VertexPacker.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -54,6 +57,7 @@ static_assert(sizeof(VertexPositionNormalTexture) == 32, "VBO vertex size mismat
 // Shared VB input element description
 static INIT_ONCE g_InitOnce = INIT_ONCE_STATIC_INIT;
 static std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> g_vbdecl;
+static std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> g_vbdeclPacked;
 
 static BOOL CALLBACK InitializeDecl(PINIT_ONCE initOnce, PVOID Parameter, PVOID *lpContext)
 {
@@ -64,6 +68,9 @@ static BOOL CALLBACK InitializeDecl(PINIT_ONCE initOnce, PVOID Parameter, PVOID
     g_vbdecl = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(VertexPositionNormalTexture::InputElements,
                    VertexPositionNormalTexture::InputElements + VertexPositionNormalTexture::InputElementCount);
 
+    g_vbdeclPacked = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(VertexPositionNormalTexturePacked::InputElements,
+                   VertexPositionNormalTexturePacked::InputElements + VertexPositionNormalTexturePacked::InputElementCount);
+
     return TRUE;
 }
 
@@ -71,7 +78,8 @@ static BOOL CALLBACK InitializeDecl(PINIT_ONCE initOnce, PVOID Parameter, PVOID
 //--------------------------------------------------------------------------------------
 _Use_decl_annotations_
 std::unique_ptr<Model> DirectX::Model::CreateFromVBO(ID3D11Device* d3dDevice, const uint8_t* meshData, size_t dataSize,
-                                                     std::shared_ptr<IEffect> ieffect, bool ccw, bool pmalpha)
+                                                     std::shared_ptr<IEffect> ieffect, bool ccw, bool pmalpha, bool packVertices, bool optimizeMesh,
+                                                     IModelAllocator* allocator)
 {
     if (!InitOnceExecuteOnce(&g_InitOnce, InitializeDecl, nullptr, nullptr))
         throw std::exception("One-time initialization failed");
@@ -99,16 +107,56 @@ std::unique_ptr<Model> DirectX::Model::CreateFromVBO(ID3D11Device* d3dDevice, co
         throw std::exception("End of file");
     auto indices = reinterpret_cast<const uint16_t*>( meshData + sizeof(VBO::header_t) + vertSize );
 
+    // Optimization works on copies, leaving the file data alone.
+    MeshOptimizer optimizer;
+
+    ScratchArena scratch(allocator);
+
+    if (optimizeMesh)
+    {
+        auto optimizedVerts = scratch.Allocate<VertexPositionNormalTexture>(header->numVertices);
+        memcpy(optimizedVerts, verts, vertSize);
+
+        auto optimizedIndices = scratch.Allocate<uint16_t>(header->numIndices);
+        memcpy(optimizedIndices, indices, indexSize);
+
+        optimizer.OptimizeFaces(optimizedIndices, header->numIndices, header->numVertices,
+                                reinterpret_cast<const uint8_t*>(&verts->position), reinterpret_cast<const uint8_t*>(&verts->normal),
+                                sizeof(VertexPositionNormalTexture));
+
+        MeshOptimizer::VertexRemap remap(header->numVertices);
+        remap.RemapIndices(optimizedIndices, header->numIndices);
+        remap.RemapVertices(reinterpret_cast<uint8_t*>(optimizedVerts), sizeof(VertexPositionNormalTexture));
+
+        verts = optimizedVerts;
+        indices = optimizedIndices;
+    }
+
+    bool packed = packVertices && VertexPacker::IsSupported(d3dDevice);
+
     // Create vertex buffer
     ComPtr<ID3D11Buffer> vb;
     {
+        VertexPositionNormalTexturePacked* packedVerts = nullptr;
+
+        if (packed)
+        {
+            packedVerts = scratch.Allocate<VertexPositionNormalTexturePacked>(header->numVertices);
+
+            for (size_t j = 0; j < header->numVertices; ++j)
+            {
+                packedVerts[j] = VertexPositionNormalTexturePacked(verts[j]);
+            }
+        }
+
         D3D11_BUFFER_DESC desc = { 0 };
         desc.Usage = D3D11_USAGE_DEFAULT;
-        desc.ByteWidth = static_cast<UINT>(vertSize);
+        desc.ByteWidth = packed ? static_cast<UINT>(sizeof(VertexPositionNormalTexturePacked) * header->numVertices)
+                                : static_cast<UINT>(vertSize);
         desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 
         D3D11_SUBRESOURCE_DATA initData = { 0 };
-        initData.pSysMem = verts;
+        initData.pSysMem = packed ? static_cast<const void*>(packedVerts) : verts;
 
         ThrowIfFailed(
             d3dDevice->CreateBuffer(&desc, &initData, vb.GetAddressOf())
@@ -153,33 +201,43 @@ std::unique_ptr<Model> DirectX::Model::CreateFromVBO(ID3D11Device* d3dDevice, co
         ieffect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
 
         ThrowIfFailed(
-            d3dDevice->CreateInputLayout(VertexPositionNormalTexture::InputElements,
-            VertexPositionNormalTexture::InputElementCount,
+            d3dDevice->CreateInputLayout(packed ? VertexPositionNormalTexturePacked::InputElements : VertexPositionNormalTexture::InputElements,
+            packed ? VertexPositionNormalTexturePacked::InputElementCount : VertexPositionNormalTexture::InputElementCount,
             shaderByteCode, byteCodeLength,
             il.GetAddressOf()));
 
         SetDebugObjectName(il.Get(), "ModelVBO");
     }
 
-    auto part = new ModelMeshPart();
+    auto part = new (allocator) ModelMeshPart();
     part->indexCount = header->numIndices;
     part->startIndex = 0;
-    part->vertexStride = static_cast<UINT>( sizeof(VertexPositionNormalTexture) );
+    part->vertexStride = packed ? static_cast<UINT>( sizeof(VertexPositionNormalTexturePacked) )
+                                : static_cast<UINT>( sizeof(VertexPositionNormalTexture) );
     part->inputLayout = il;
     part->indexBuffer = ib;
     part->vertexBuffer = vb;
     part->effect = ieffect;
-    part->vbDecl = g_vbdecl;
+    part->vbDecl = packed ? g_vbdeclPacked : g_vbdecl;
 
-    auto mesh = std::make_shared<ModelMesh>();
+    auto mesh = CreateModelMesh(allocator);
     mesh->ccw = ccw;
     mesh->pmalpha = pmalpha;
     BoundingSphere::CreateFromPoints(mesh->boundingSphere, header->numVertices, &verts->position, sizeof(VertexPositionNormalTexture));
     BoundingBox::CreateFromPoints(mesh->boundingBox, header->numVertices, &verts->position, sizeof(VertexPositionNormalTexture));
     mesh->meshParts.emplace_back(part);
 
-    std::unique_ptr<Model> model(new Model());
+    std::unique_ptr<Model> model(new (allocator) Model());
     model->meshes.emplace_back(mesh);
+
+    if (optimizeMesh)
+    {
+        optimizer.GetStatistics(model->optimizationStatistics);
+
+        DebugTrace( "ModelVBO: %u triangles optimized, ACMR %.3f before and %.3f after\n",
+                    static_cast<unsigned int>(model->optimizationStatistics.triangles),
+                    model->optimizationStatistics.acmrBefore, model->optimizationStatistics.acmrAfter );
+    }
  
     return model;
 }
@@ -188,18 +246,18 @@ std::unique_ptr<Model> DirectX::Model::CreateFromVBO(ID3D11Device* d3dDevice, co
 //--------------------------------------------------------------------------------------
 _Use_decl_annotations_
 std::unique_ptr<Model> DirectX::Model::CreateFromVBO(ID3D11Device* d3dDevice, const wchar_t* szFileName,
-                                                     std::shared_ptr<IEffect> ieffect, bool ccw, bool pmalpha)
+                                                     std::shared_ptr<IEffect> ieffect, bool ccw, bool pmalpha, bool packVertices, bool optimizeMesh,
+                                                     IModelAllocator* allocator)
 {
-    size_t dataSize = 0;
-    std::unique_ptr<uint8_t[]> data;
-    HRESULT hr = BinaryReader::ReadEntireFile( szFileName, data, &dataSize );
+    BinaryReader::FileData data;
+    HRESULT hr = BinaryReader::LoadEntireFile( szFileName, data );
     if ( FAILED(hr) )
     {
         DebugTrace( "CreateFromVBO failed (%08X) loading '%ls'\n", hr, szFileName );
         throw std::exception( "CreateFromVBO" );
     }
 
-    auto model = CreateFromVBO( d3dDevice, data.get(), dataSize, ieffect, ccw, pmalpha );
+    auto model = CreateFromVBO( d3dDevice, data.get(), data.size(), ieffect, ccw, pmalpha, packVertices, optimizeMesh, allocator );
 
     model->name = szFileName;
 
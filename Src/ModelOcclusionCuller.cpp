@@ -0,0 +1,467 @@
+//--------------------------------------------------------------------------------------
+// File: ModelOcclusionCuller.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Model.h"
+
+#include "CommonStates.h"
+#include "DirectXHelpers.h"
+#include "Effects.h"
+#include "PlatformHelpers.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+
+namespace
+{
+    // Unit cube from -1 to 1, scaled and moved onto each bounding box.
+    const XMFLOAT3 s_cubeVertices[8] =
+    {
+        XMFLOAT3( -1, -1, -1 ),
+        XMFLOAT3(  1, -1, -1 ),
+        XMFLOAT3( -1,  1, -1 ),
+        XMFLOAT3(  1,  1, -1 ),
+        XMFLOAT3( -1, -1,  1 ),
+        XMFLOAT3(  1, -1,  1 ),
+        XMFLOAT3( -1,  1,  1 ),
+        XMFLOAT3(  1,  1,  1 ),
+    };
+
+    // Drawn without culling, so the winding doesn't matter.
+    const uint16_t s_cubeIndices[36] =
+    {
+        0, 1, 2,  2, 1, 3,
+        4, 6, 5,  5, 6, 7,
+        0, 2, 4,  4, 2, 6,
+        1, 5, 3,  3, 5, 7,
+        0, 4, 1,  1, 4, 5,
+        2, 3, 6,  6, 3, 7,
+    };
+
+    const D3D11_INPUT_ELEMENT_DESC s_cubeElements[] =
+    {
+        { "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    };
+}
+
+
+// Internal ModelOcclusionCuller implementation class.
+class ModelOcclusionCuller::Impl
+{
+public:
+    Impl( _In_ ID3D11Device* device, size_t maxQueries, bool predicated );
+
+    bool XM_CALLCONV Draw( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, size_t id, const Model& model,
+                           FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                           bool wireframe, _In_opt_ std::function<void()> setCustomState );
+
+    void XM_CALLCONV IssueQueries( _In_ ID3D11DeviceContext* deviceContext, CommonStates& states, FXMMATRIX view, CXMMATRIX projection );
+
+    bool IsOccluded( size_t id ) const;
+
+    void Reset();
+
+private:
+    // What is known about one model instance.
+    struct Instance
+    {
+        Instance() : occluded( false ), queryPending( false ), predicateIssued( false ) { }
+
+        ComPtr<ID3D11Query> query;
+        ComPtr<ID3D11Predicate> predicate;
+        bool occluded;
+        bool queryPending;
+        bool predicateIssued;
+    };
+
+    // A bounding box waiting for IssueQueries. The matrix takes the unit cube onto the box in world space.
+    struct QueuedBox
+    {
+        size_t id;
+        XMFLOAT4X4 cubeToWorld;
+    };
+
+    void PollQuery( _In_ ID3D11DeviceContext* deviceContext, Instance& instance );
+
+    ComPtr<ID3D11Device> mDevice;
+
+    size_t mMaxQueries;
+    bool mPredicated;
+
+    std::vector<Instance> mInstances;
+    std::vector<QueuedBox> mQueue;
+
+    // Queries that have been read back, ready for reuse.
+    std::vector<ComPtr<ID3D11Query>> mFreeQueries;
+    size_t mQueryCount;
+
+    // Boxes are drawn with the depth only BasicEffect, so there is no pixel shader.
+    std::unique_ptr<BasicEffect> mEffect;
+    ComPtr<ID3D11InputLayout> mInputLayout;
+    ComPtr<ID3D11Buffer> mVertexBuffer;
+    ComPtr<ID3D11Buffer> mIndexBuffer;
+    ComPtr<ID3D11BlendState> mNoColorWrites;
+};
+
+
+ModelOcclusionCuller::Impl::Impl( _In_ ID3D11Device* device, size_t maxQueries, bool predicated )
+  : mDevice( device ),
+    mMaxQueries( maxQueries ),
+    mPredicated( predicated ),
+    mQueryCount( 0 )
+{
+    if ( !maxQueries )
+        throw std::out_of_range( "maxQueries parameter out of range" );
+
+    mEffect.reset( new BasicEffect( device ) );
+
+    mEffect->SetDepthOnly( true );
+
+    void const* shaderByteCode;
+    size_t byteCodeLength;
+
+    mEffect->GetVertexShaderBytecode( &shaderByteCode, &byteCodeLength );
+
+    ThrowIfFailed(
+        device->CreateInputLayout( s_cubeElements, _countof(s_cubeElements), shaderByteCode, byteCodeLength, &mInputLayout )
+    );
+
+    SetDebugObjectName( mInputLayout.Get(), "DirectXTK:ModelOcclusionCuller" );
+
+    D3D11_BUFFER_DESC bufferDesc = { 0 };
+    D3D11_SUBRESOURCE_DATA dataDesc = { 0 };
+
+    bufferDesc.ByteWidth = sizeof(s_cubeVertices);
+    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+
+    dataDesc.pSysMem = s_cubeVertices;
+
+    ThrowIfFailed(
+        device->CreateBuffer( &bufferDesc, &dataDesc, &mVertexBuffer )
+    );
+
+    SetDebugObjectName( mVertexBuffer.Get(), "DirectXTK:ModelOcclusionCuller" );
+
+    bufferDesc.ByteWidth = sizeof(s_cubeIndices);
+    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+    dataDesc.pSysMem = s_cubeIndices;
+
+    ThrowIfFailed(
+        device->CreateBuffer( &bufferDesc, &dataDesc, &mIndexBuffer )
+    );
+
+    SetDebugObjectName( mIndexBuffer.Get(), "DirectXTK:ModelOcclusionCuller" );
+
+    // CommonStates has no blend state that masks off color, since nothing else needs one.
+    CD3D11_BLEND_DESC blendDesc( D3D11_DEFAULT );
+
+    blendDesc.RenderTarget[0].RenderTargetWriteMask = 0;
+
+    ThrowIfFailed(
+        device->CreateBlendState( &blendDesc, &mNoColorWrites )
+    );
+
+    SetDebugObjectName( mNoColorWrites.Get(), "DirectXTK:ModelOcclusionCuller" );
+}
+
+
+// Picks up a finished query without waiting for the GPU, and puts it back in the pool.
+void ModelOcclusionCuller::Impl::PollQuery( _In_ ID3D11DeviceContext* deviceContext, Instance& instance )
+{
+    if ( !instance.queryPending )
+        return;
+
+    // Results can only be read back through the immediate context.
+    if ( deviceContext->GetType() != D3D11_DEVICE_CONTEXT_IMMEDIATE )
+        return;
+
+    UINT64 samples = 0;
+
+    if ( deviceContext->GetData( instance.query.Get(), &samples, sizeof(samples), D3D11_ASYNC_GETDATA_DONOTFLUSH ) != S_OK )
+        return;
+
+    instance.occluded = ( samples == 0 );
+    instance.queryPending = false;
+
+    mFreeQueries.push_back( instance.query );
+    instance.query.Reset();
+}
+
+
+_Use_decl_annotations_
+bool XM_CALLCONV ModelOcclusionCuller::Impl::Draw( ID3D11DeviceContext* deviceContext, CommonStates& states, size_t id, const Model& model,
+                                                   FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                                                   bool wireframe, std::function<void()> setCustomState )
+{
+    assert( deviceContext != 0 );
+
+    if ( id >= mMaxQueries )
+        throw std::out_of_range( "id parameter out of range" );
+
+    if ( id >= mInstances.size() )
+    {
+        mInstances.resize( id + 1 );
+    }
+
+    auto& instance = mInstances[ id ];
+
+    // Queue the model's bounding box, built from all its meshes in model space.
+    if ( !model.meshes.empty() )
+    {
+        BoundingBox bounds = model.meshes.front()->boundingBox;
+
+        for( auto it = model.meshes.cbegin() + 1; it != model.meshes.cend(); ++it )
+        {
+            BoundingBox::CreateMerged( bounds, bounds, (*it)->boundingBox );
+        }
+
+        XMMATRIX cubeToModel = XMMatrixScaling( bounds.Extents.x, bounds.Extents.y, bounds.Extents.z )
+                             * XMMatrixTranslation( bounds.Center.x, bounds.Center.y, bounds.Center.z );
+
+        QueuedBox box;
+
+        box.id = id;
+        XMStoreFloat4x4( &box.cubeToWorld, XMMatrixMultiply( cubeToModel, world ) );
+
+        mQueue.push_back( box );
+    }
+
+    if ( mPredicated )
+    {
+        // The GPU skips the draw if none of the box passed the depth test when it was last queried.
+        if ( instance.predicateIssued )
+        {
+            deviceContext->SetPredication( instance.predicate.Get(), FALSE );
+        }
+
+        model.Draw( deviceContext, states, world, view, projection, wireframe, setCustomState );
+
+        if ( instance.predicateIssued )
+        {
+            deviceContext->SetPredication( nullptr, FALSE );
+        }
+
+        return true;
+    }
+
+    PollQuery( deviceContext, instance );
+
+    if ( instance.occluded )
+        return false;
+
+    model.Draw( deviceContext, states, world, view, projection, wireframe, setCustomState );
+
+    return true;
+}
+
+
+_Use_decl_annotations_
+void XM_CALLCONV ModelOcclusionCuller::Impl::IssueQueries( ID3D11DeviceContext* deviceContext, CommonStates& states, FXMMATRIX view, CXMMATRIX projection )
+{
+    assert( deviceContext != 0 );
+
+    if ( mQueue.empty() )
+        return;
+
+    XMMATRIX viewProjection = XMMatrixMultiply( view, projection );
+
+    // Test depth without writing it, or any color, on both sides of each box.
+    deviceContext->OMSetBlendState( mNoColorWrites.Get(), nullptr, 0xFFFFFFFF );
+    deviceContext->OMSetDepthStencilState( states.DepthRead(), 0 );
+    deviceContext->RSSetState( states.CullNone() );
+
+    deviceContext->IASetInputLayout( mInputLayout.Get() );
+    deviceContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+
+    UINT stride = sizeof(XMFLOAT3);
+    UINT offset = 0;
+    ID3D11Buffer* vertexBuffer = mVertexBuffer.Get();
+
+    deviceContext->IASetVertexBuffers( 0, 1, &vertexBuffer, &stride, &offset );
+    deviceContext->IASetIndexBuffer( mIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0 );
+
+    mEffect->SetView( view );
+    mEffect->SetProjection( projection );
+
+    for( auto it = mQueue.cbegin(); it != mQueue.cend(); ++it )
+    {
+        auto& instance = mInstances[ it->id ];
+
+        // The same instance may have been drawn more than once this frame, but one query each is enough.
+        if ( instance.queryPending && !mPredicated )
+            continue;
+
+        XMMATRIX cubeToWorld = XMLoadFloat4x4( &it->cubeToWorld );
+
+        // A box crossing the near plane is partly clipped away, so could pass no samples while still in view. Its
+        // corners all have positive clip space z when it is wholly in front.
+        XMMATRIX cubeToClip = XMMatrixMultiply( cubeToWorld, viewProjection );
+
+        bool crossesNearPlane = false;
+
+        for( size_t i = 0; i < _countof(s_cubeVertices); ++i )
+        {
+            XMVECTOR corner = XMVector3Transform( XMLoadFloat3( &s_cubeVertices[ i ] ), cubeToClip );
+
+            if ( XMVectorGetZ( corner ) <= 0 )
+            {
+                crossesNearPlane = true;
+                break;
+            }
+        }
+
+        if ( crossesNearPlane )
+        {
+            // Draw unconditionally until a query can tell again.
+            instance.occluded = false;
+            instance.predicateIssued = false;
+            continue;
+        }
+
+        ID3D11Asynchronous* async;
+
+        if ( mPredicated )
+        {
+            if ( !instance.predicate )
+            {
+                CD3D11_QUERY_DESC queryDesc( D3D11_QUERY_OCCLUSION_PREDICATE, D3D11_QUERY_MISC_PREDICATEHINT );
+
+                ThrowIfFailed(
+                    mDevice->CreatePredicate( &queryDesc, &instance.predicate )
+                );
+
+                SetDebugObjectName( instance.predicate.Get(), "DirectXTK:ModelOcclusionCuller" );
+            }
+
+            async = instance.predicate.Get();
+
+            instance.predicateIssued = true;
+        }
+        else
+        {
+            if ( !mFreeQueries.empty() )
+            {
+                instance.query = mFreeQueries.back();
+                mFreeQueries.pop_back();
+            }
+            else if ( mQueryCount < mMaxQueries )
+            {
+                CD3D11_QUERY_DESC queryDesc( D3D11_QUERY_OCCLUSION );
+
+                ThrowIfFailed(
+                    mDevice->CreateQuery( &queryDesc, &instance.query )
+                );
+
+                SetDebugObjectName( instance.query.Get(), "DirectXTK:ModelOcclusionCuller" );
+
+                ++mQueryCount;
+            }
+            else
+            {
+                // Out of queries, so keep the latest result until one comes back.
+                continue;
+            }
+
+            async = instance.query.Get();
+
+            instance.queryPending = true;
+        }
+
+        mEffect->SetWorld( cubeToWorld );
+        mEffect->Apply( deviceContext );
+
+        deviceContext->Begin( async );
+        deviceContext->DrawIndexed( _countof(s_cubeIndices), 0, 0 );
+        deviceContext->End( async );
+    }
+
+    mQueue.clear();
+}
+
+
+bool ModelOcclusionCuller::Impl::IsOccluded( size_t id ) const
+{
+    if ( id >= mInstances.size() )
+        return false;
+
+    return mInstances[ id ].occluded;
+}
+
+
+// Pending queries are left to finish, then dropped.
+void ModelOcclusionCuller::Impl::Reset()
+{
+    mInstances.clear();
+    mQueue.clear();
+    mFreeQueries.clear();
+    mQueryCount = 0;
+}
+
+
+// Public constructor.
+ModelOcclusionCuller::ModelOcclusionCuller( _In_ ID3D11Device* device, size_t maxQueries, bool predicated )
+  : pImpl( new Impl( device, maxQueries, predicated ) )
+{
+}
+
+
+// Move constructor.
+ModelOcclusionCuller::ModelOcclusionCuller( ModelOcclusionCuller&& moveFrom )
+  : pImpl( std::move( moveFrom.pImpl ) )
+{
+}
+
+
+// Move assignment.
+ModelOcclusionCuller& ModelOcclusionCuller::operator= ( ModelOcclusionCuller&& moveFrom )
+{
+    pImpl = std::move( moveFrom.pImpl );
+    return *this;
+}
+
+
+// Public destructor.
+ModelOcclusionCuller::~ModelOcclusionCuller()
+{
+}
+
+
+_Use_decl_annotations_
+bool XM_CALLCONV ModelOcclusionCuller::Draw( ID3D11DeviceContext* deviceContext, CommonStates& states, size_t id, const Model& model,
+                                             FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection,
+                                             bool wireframe, std::function<void()> setCustomState )
+{
+    return pImpl->Draw( deviceContext, states, id, model, world, view, projection, wireframe, setCustomState );
+}
+
+
+_Use_decl_annotations_
+void XM_CALLCONV ModelOcclusionCuller::IssueQueries( ID3D11DeviceContext* deviceContext, CommonStates& states, FXMMATRIX view, CXMMATRIX projection )
+{
+    pImpl->IssueQueries( deviceContext, states, view, projection );
+}
+
+
+bool ModelOcclusionCuller::IsOccluded( size_t id ) const
+{
+    return pImpl->IsOccluded( id );
+}
+
+
+void ModelOcclusionCuller::Reset()
+{
+    pImpl->Reset();
+}
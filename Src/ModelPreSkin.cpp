@@ -0,0 +1,425 @@
+//--------------------------------------------------------------------------------------
+// File: ModelPreSkin.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Model.h"
+
+#include "AlignedNew.h"
+#include "CommonStates.h"
+#include "ConstantBuffer.h"
+#include "DirectXHelpers.h"
+#include "Effects.h"
+#include "PlatformHelpers.h"
+#include "SharedResourcePool.h"
+#include "VertexTypes.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+
+// Include the precompiled shader code.
+namespace
+{
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinOneBone.inc"
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinTwoBones.inc"
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinFourBones.inc"
+
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinOneBoneBuffer.inc"
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOnePreSkinning_VSPreSkinFourBonesDualQuaternion.inc"
+#else
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinOneBone.inc"
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinTwoBones.inc"
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinFourBones.inc"
+
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinOneBoneBuffer.inc"
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/PreSkinning_VSPreSkinFourBonesDualQuaternion.inc"
+#endif
+
+    struct PreSkinShaderBytecode
+    {
+        void const* code;
+        size_t length;
+    };
+
+    // Indexed by 0, 1, 2 for one, two, or four bones, plus 3 for a bone buffer or 6 for dual quaternions.
+    const PreSkinShaderBytecode PreSkinShaders[] =
+    {
+        { PreSkinning_VSPreSkinOneBone,                  sizeof(PreSkinning_VSPreSkinOneBone)                  },
+        { PreSkinning_VSPreSkinTwoBones,                 sizeof(PreSkinning_VSPreSkinTwoBones)                 },
+        { PreSkinning_VSPreSkinFourBones,                sizeof(PreSkinning_VSPreSkinFourBones)                },
+
+        { PreSkinning_VSPreSkinOneBoneBuffer,            sizeof(PreSkinning_VSPreSkinOneBoneBuffer)            },
+        { PreSkinning_VSPreSkinTwoBonesBuffer,           sizeof(PreSkinning_VSPreSkinTwoBonesBuffer)           },
+        { PreSkinning_VSPreSkinFourBonesBuffer,          sizeof(PreSkinning_VSPreSkinFourBonesBuffer)          },
+
+        { PreSkinning_VSPreSkinOneBoneDualQuaternion,    sizeof(PreSkinning_VSPreSkinOneBoneDualQuaternion)    },
+        { PreSkinning_VSPreSkinTwoBonesDualQuaternion,   sizeof(PreSkinning_VSPreSkinTwoBonesDualQuaternion)   },
+        { PreSkinning_VSPreSkinFourBonesDualQuaternion,  sizeof(PreSkinning_VSPreSkinFourBonesDualQuaternion)  },
+    };
+
+    const int PreSkinShaderCount = _countof(PreSkinShaders);
+
+
+    // Constant buffer layout. Must match the shader!
+    struct PreSkinConstants
+    {
+        XMVECTOR bones[IEffectSkinning::MaxBones][3];
+
+        uint32_t firstBone;
+        uint32_t firstBonePadding[3];
+    };
+
+    static_assert( ( sizeof(PreSkinConstants) % 16 ) == 0, "CB size not padded correctly" );
+
+
+    // Matches the VSOutputPreSkin stream output, which is laid out as VertexPositionNormalTexture.
+    const D3D11_SO_DECLARATION_ENTRY StreamOutputElements[] =
+    {
+        { 0, "POSITION", 0, 0, 3, 0 },
+        { 0, "NORMAL",   0, 0, 3, 0 },
+        { 0, "TEXCOORD", 0, 0, 2, 0 },
+    };
+
+    static_assert( sizeof(VertexPositionNormalTexture) == 32, "stream output layout mismatch" );
+
+
+    // Returns the number of vertices held by the part's vertex buffer.
+    UINT GetVertexCount(ModelMeshPart const& part)
+    {
+        if (!part.vertexBuffer || !part.vertexStride)
+            throw std::exception("ModelMeshPart has no vertex buffer");
+
+        D3D11_BUFFER_DESC desc;
+        part.vertexBuffer->GetDesc(&desc);
+
+        return desc.ByteWidth / part.vertexStride;
+    }
+}
+
+
+// Internal ModelPreSkinner implementation class.
+class ModelPreSkinner::Impl : public AlignedNew<PreSkinConstants>
+{
+public:
+    Impl(_In_ ID3D11Device* device);
+
+    void Skin(_In_ ID3D11DeviceContext* deviceContext, ModelMeshPart const& part, _In_ ID3D11Buffer* outputBuffer);
+
+    PreSkinConstants constants;
+    bool constantsDirty;
+
+    ComPtr<ID3D11ShaderResourceView> boneBuffer;
+    bool dualQuaternion;
+    int weightsPerVertex;
+
+private:
+    ID3D11InputLayout* GetInputLayout(ModelMeshPart const& part);
+
+    // Only one of these helpers is allocated per D3D device, even if there are multiple ModelPreSkinner instances.
+    struct DeviceResources
+    {
+        DeviceResources(_In_ ID3D11Device* device);
+
+        ComPtr<ID3D11VertexShader> vertexShaders[PreSkinShaderCount];
+        ComPtr<ID3D11GeometryShader> streamOutputShaders[PreSkinShaderCount];
+
+        CommonStates stateObjects;
+    };
+
+    ComPtr<ID3D11Device> mDevice;
+    ConstantBuffer<PreSkinConstants> mConstantBuffer;
+
+    // Every shader has the same input signature, so one layout per vertex declaration serves them all.
+    std::map<std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>>, ComPtr<ID3D11InputLayout>> mInputLayouts;
+
+    std::shared_ptr<DeviceResources> mDeviceResources;
+
+    static SharedResourcePool<ID3D11Device*, DeviceResources> deviceResourcesPool;
+};
+
+
+// Global pool of per-device ModelPreSkinner resources.
+SharedResourcePool<ID3D11Device*, ModelPreSkinner::Impl::DeviceResources> ModelPreSkinner::Impl::deviceResourcesPool;
+
+
+ModelPreSkinner::Impl::DeviceResources::DeviceResources(_In_ ID3D11Device* device)
+  : stateObjects(device)
+{
+    // Nothing is rasterized. 10.x feature levels can't say so, but get the same effect with no pixel shader and depth off.
+    UINT rasterizedStream = (device->GetFeatureLevel() >= D3D_FEATURE_LEVEL_11_0) ? D3D11_SO_NO_RASTERIZED_STREAM : 0;
+    UINT stride = sizeof(VertexPositionNormalTexture);
+
+    for (int i = 0; i < PreSkinShaderCount; i++)
+    {
+        ThrowIfFailed(
+            device->CreateVertexShader(PreSkinShaders[i].code, PreSkinShaders[i].length, nullptr, &vertexShaders[i])
+        );
+
+        ThrowIfFailed(
+            device->CreateGeometryShaderWithStreamOutput(PreSkinShaders[i].code, PreSkinShaders[i].length,
+                                                         StreamOutputElements, _countof(StreamOutputElements),
+                                                         &stride, 1, rasterizedStream, nullptr,
+                                                         &streamOutputShaders[i])
+        );
+
+        SetDebugObjectName(vertexShaders[i].Get(),       "DirectXTK:ModelPreSkinner");
+        SetDebugObjectName(streamOutputShaders[i].Get(), "DirectXTK:ModelPreSkinner");
+    }
+}
+
+
+ModelPreSkinner::Impl::Impl(_In_ ID3D11Device* device)
+  : constantsDirty(true),
+    dualQuaternion(false),
+    weightsPerVertex(4),
+    mDevice(device)
+{
+    if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_10_0)
+        throw std::exception("ModelPreSkinner requires Feature Level 10.0 or greater");
+
+    mConstantBuffer.Create(device);
+
+    mDeviceResources = deviceResourcesPool.DemandCreate(device);
+
+    for (size_t i = 0; i < IEffectSkinning::MaxBones; i++)
+    {
+        constants.bones[i][0] = g_XMIdentityR0;
+        constants.bones[i][1] = g_XMIdentityR1;
+        constants.bones[i][2] = g_XMIdentityR2;
+    }
+
+    constants.firstBone = 0;
+}
+
+
+ID3D11InputLayout* ModelPreSkinner::Impl::GetInputLayout(ModelMeshPart const& part)
+{
+    if (!part.vbDecl || part.vbDecl->empty())
+        throw std::exception("ModelMeshPart has no vertex declaration");
+
+    auto& inputLayout = mInputLayouts[part.vbDecl];
+
+    if (!inputLayout)
+    {
+        ThrowIfFailed(
+            mDevice->CreateInputLayout(&part.vbDecl->front(), static_cast<UINT>(part.vbDecl->size()),
+                                       PreSkinShaders[0].code, PreSkinShaders[0].length,
+                                       &inputLayout)
+        );
+
+        SetDebugObjectName(inputLayout.Get(), "DirectXTK:ModelPreSkinner");
+    }
+
+    return inputLayout.Get();
+}
+
+
+void ModelPreSkinner::Impl::Skin(_In_ ID3D11DeviceContext* deviceContext, ModelMeshPart const& part, _In_ ID3D11Buffer* outputBuffer)
+{
+    UINT vertexCount = GetVertexCount(part);
+
+    D3D11_BUFFER_DESC outputDesc;
+    outputBuffer->GetDesc(&outputDesc);
+
+    if (outputDesc.ByteWidth < vertexCount * sizeof(VertexPositionNormalTexture) || !(outputDesc.BindFlags & D3D11_BIND_STREAM_OUTPUT))
+        throw std::exception("Pre-skinning output buffer is too small, or can't be used for stream output");
+
+    // Pick the shader.
+    int shader = (weightsPerVertex == 4) ? 2 : (weightsPerVertex - 1);
+
+    if (boneBuffer)
+    {
+        shader += dualQuaternion ? 6 : 3;
+    }
+
+    // Dynamic buffers have undefined contents at the start of each command list, so deferred contexts always write it.
+    if (constantsDirty || deviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+    {
+        mConstantBuffer.SetData(deviceContext, constants);
+
+        constantsDirty = false;
+    }
+
+    // Set state.
+    deviceContext->IASetInputLayout(GetInputLayout(part));
+
+    auto vb = part.vertexBuffer.Get();
+    UINT vbStride = part.vertexStride;
+    UINT vbOffset = 0;
+    deviceContext->IASetVertexBuffers(0, 1, &vb, &vbStride, &vbOffset);
+
+    deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_POINTLIST);
+
+    ID3D11Buffer* cb = mConstantBuffer.GetBuffer();
+
+    deviceContext->VSSetShader(mDeviceResources->vertexShaders[shader].Get(), nullptr, 0);
+    deviceContext->VSSetConstantBuffers(0, 1, &cb);
+
+    if (boneBuffer)
+    {
+        deviceContext->VSSetShaderResources(0, 1, boneBuffer.GetAddressOf());
+    }
+
+    deviceContext->GSSetShader(mDeviceResources->streamOutputShaders[shader].Get(), nullptr, 0);
+    deviceContext->PSSetShader(nullptr, nullptr, 0);
+    deviceContext->OMSetDepthStencilState(mDeviceResources->stateObjects.DepthNone(), 0);
+
+    UINT soOffset = 0;
+    deviceContext->SOSetTargets(1, &outputBuffer, &soOffset);
+
+    // Each vertex is skinned exactly once, whether or not the part's indices use it.
+    deviceContext->Draw(vertexCount, 0);
+
+    // Unbind, so the output can be used as a vertex buffer.
+    ID3D11Buffer* nullBuffer = nullptr;
+    deviceContext->SOSetTargets(1, &nullBuffer, &soOffset);
+
+    deviceContext->GSSetShader(nullptr, nullptr, 0);
+}
+
+
+// Public constructor.
+ModelPreSkinner::ModelPreSkinner(_In_ ID3D11Device* device)
+  : pImpl(new Impl(device))
+{
+}
+
+
+// Move constructor.
+ModelPreSkinner::ModelPreSkinner(ModelPreSkinner&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+ModelPreSkinner& ModelPreSkinner::operator= (ModelPreSkinner&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+ModelPreSkinner::~ModelPreSkinner()
+{
+}
+
+
+void ModelPreSkinner::SetWeightsPerVertex(int value)
+{
+    if ((value != 1) &&
+        (value != 2) &&
+        (value != 4))
+    {
+        throw std::out_of_range("WeightsPerVertex must be 1, 2, or 4");
+    }
+
+    pImpl->weightsPerVertex = value;
+}
+
+
+_Use_decl_annotations_
+void ModelPreSkinner::SetBoneTransforms(XMMATRIX const* value, size_t count)
+{
+    if (count > IEffectSkinning::MaxBones)
+        throw std::out_of_range("count parameter out of range");
+
+    auto boneConstant = pImpl->constants.bones;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        XMMATRIX boneMatrix = XMMatrixTranspose(value[i]);
+
+        boneConstant[i][0] = boneMatrix.r[0];
+        boneConstant[i][1] = boneMatrix.r[1];
+        boneConstant[i][2] = boneMatrix.r[2];
+    }
+
+    pImpl->constantsDirty = true;
+}
+
+
+_Use_decl_annotations_
+void ModelPreSkinner::SetBoneBuffer(ID3D11ShaderResourceView* value, size_t firstBone, bool dualQuaternion)
+{
+    if (firstBone > UINT32_MAX)
+        throw std::out_of_range("firstBone parameter out of range");
+
+    pImpl->boneBuffer = value;
+    pImpl->dualQuaternion = dualQuaternion;
+
+    pImpl->constants.firstBone = static_cast<uint32_t>(firstBone);
+
+    pImpl->constantsDirty = true;
+}
+
+
+_Use_decl_annotations_
+void ModelPreSkinner::Skin(ID3D11DeviceContext* deviceContext, ModelMeshPart const& part, ID3D11Buffer* outputBuffer)
+{
+    pImpl->Skin(deviceContext, part, outputBuffer);
+}
+
+
+_Use_decl_annotations_
+void ModelPreSkinner::CreateOutputBuffer(ID3D11Device* device, ModelMeshPart const& part, ID3D11Buffer** outputBuffer)
+{
+    D3D11_BUFFER_DESC desc = {0};
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.ByteWidth = GetVertexCount(part) * sizeof(VertexPositionNormalTexture);
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_STREAM_OUTPUT;
+
+    ThrowIfFailed(
+        device->CreateBuffer(&desc, nullptr, outputBuffer)
+    );
+
+    SetDebugObjectName(*outputBuffer, "DirectXTK:ModelPreSkinner");
+}
+
+
+_Use_decl_annotations_
+void ModelPreSkinner::Draw(ID3D11DeviceContext* deviceContext, ModelMeshPart const& part, ID3D11Buffer* skinnedBuffer,
+                           IEffect* ieffect, ID3D11InputLayout* iinputLayout, std::function<void()> setCustomState)
+{
+    deviceContext->IASetInputLayout( iinputLayout );
+
+    UINT vbStride = sizeof(VertexPositionNormalTexture);
+    UINT vbOffset = 0;
+    deviceContext->IASetVertexBuffers( 0, 1, &skinnedBuffer, &vbStride, &vbOffset );
+
+    deviceContext->IASetIndexBuffer( part.indexBuffer.Get(), part.indexFormat, 0 );
+
+    assert( ieffect != 0 );
+    ieffect->Apply( deviceContext );
+
+    if ( setCustomState )
+    {
+        setCustomState();
+    }
+
+    deviceContext->IASetPrimitiveTopology( part.primitiveType );
+
+    deviceContext->DrawIndexed( part.indexCount, part.startIndex, part.vertexOffset );
+}
@@ -78,6 +78,9 @@ namespace std
         mutex& operator= (mutex const&);
     };
 
+    // Critical sections may be entered recursively by the owning thread
+    typedef mutex recursive_mutex;
+
 
     template<typename Mutex>
     class lock_guard
@@ -15,25 +15,103 @@
 #include "PrimitiveBatch.h"
 #include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
+#include "GpuTimer.h"
 
 using namespace DirectX;
 using namespace DirectX::Internal;
 using namespace Microsoft::WRL;
 
 
+// Internal PrimitiveBatchHeap implementation class.
+class PrimitiveBatchHeap::Impl
+{
+public:
+    Impl(_In_ ID3D11DeviceContext* immediateContext, size_t vertexBytes, size_t indexBytes);
+
+    void BeginFrame();
+    void EndFrame();
+
+    // One of the two shared buffers, and how much of it has been handed out this frame.
+    struct Region
+    {
+        Region()
+          : size(0),
+            used(0),
+            data(nullptr)
+        { }
+
+        ComPtr<ID3D11Buffer> buffer;
+        size_t size;
+        size_t used;
+        uint8_t* data;
+    };
+
+    uint8_t* Allocate(Region& region, size_t size, _Out_ UINT* offset);
+    size_t GetBytesUsed(Region const& region);
+    uint32_t GetFrame();
+
+    Region mVertices;
+    Region mIndices;
+
+private:
+    // Keeps every chunk suitably aligned for either index format.
+    static const size_t ChunkAlignment = 16;
+
+    ComPtr<ID3D11DeviceContext> mDeviceContext;
+
+    std::mutex mMutex;
+
+    uint32_t mFrame;
+    bool mMapped;
+};
+
+
 // Internal PrimitiveBatch implementation class.
 class PrimitiveBatchBase::Impl
 {
 public:
-    Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize);
+    Impl(_In_ ID3D11DeviceContext* deviceContext, _In_opt_ PrimitiveBatchHeap::Impl* heap, size_t maxIndices, size_t maxVertices, size_t vertexSize);
 
     void Begin();
     void End();
 
-    void Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint16_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
+    template<typename TIndex>
+    void Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) TIndex const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
+
+    void SetGpuTiming(bool enable);
+    void SetRingBufferMode(bool enable);
+
+    PrimitiveBatchStatistics mStatistics;
 
 private:
+    static const size_t RingSegmentCount = 4;
+
+    // Ring buffer mode splits each buffer into segments, and marks the end of each with an event query
+    // when the batch moves on, so wrapping around only has to wait if the GPU is still a lap behind.
+    struct RingBuffer
+    {
+        RingBuffer()
+          : segmentSize(0),
+            currentSegment(0),
+            primed(false)
+        {
+            memset(pending, 0, sizeof(pending));
+        }
+
+        size_t segmentSize;
+        size_t currentSegment;
+        bool primed;
+
+        ComPtr<ID3D11Query> queries[RingSegmentCount];
+        bool pending[RingSegmentCount];
+    };
+
     void FlushBatch();
+    void LockBuffer(_In_ ID3D11Buffer* buffer, size_t currentPosition, bool discard, _Out_ size_t* basePosition, _Out_ D3D11_MAPPED_SUBRESOURCE* mappedResource);
+    void CreateRingBuffer(_In_ ID3D11Device* device, RingBuffer& ring, size_t maxElements);
+    size_t NextRingSegment(RingBuffer& ring);
+    void AcquireHeapChunk(bool isIndexChunk);
+    void BindHeapChunks();
 
     ComPtr<ID3D11DeviceContext> mDeviceContext;
     ComPtr<ID3D11Buffer> mIndexBuffer;
@@ -43,6 +121,12 @@ private:
     size_t mMaxVertices;
     size_t mVertexSize;
 
+    DXGI_FORMAT mIndexFormat;
+
+    bool mRingBufferMode;
+    RingBuffer mIndexRing;
+    RingBuffer mVertexRing;
+
     bool mInBeginEndPair;
     
     D3D11_PRIMITIVE_TOPOLOGY mCurrentTopology;
@@ -56,6 +140,15 @@ private:
 
     D3D11_MAPPED_SUBRESOURCE mMappedIndices;
     D3D11_MAPPED_SUBRESOURCE mMappedVertices;
+
+    bool mGpuTiming;
+    GpuTimer mGpuTimer;
+
+    // Heap mode draws from chunks of a shared PrimitiveBatchHeap, which are only valid for the frame they came from.
+    PrimitiveBatchHeap::Impl* mHeap;
+    uint32_t mHeapFrame;
+    UINT mIndexChunkOffset;
+    UINT mVertexChunkOffset;
 };
 
 
@@ -78,27 +171,190 @@ static void CreateBuffer(_In_ ID3D11Device* device, size_t bufferSize, D3D11_BIN
 
 
 // Constructor.
-PrimitiveBatchBase::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize)
+PrimitiveBatchHeap::Impl::Impl(_In_ ID3D11DeviceContext* immediateContext, size_t vertexBytes, size_t indexBytes)
+  : mDeviceContext(immediateContext),
+    mFrame(0),
+    mMapped(false)
+{
+    if (immediateContext->GetType() != D3D11_DEVICE_CONTEXT_IMMEDIATE)
+        throw std::exception("PrimitiveBatchHeap requires the immediate context");
+
+    if (!vertexBytes)
+        throw std::exception("Invalid heap size");
+
+    ComPtr<ID3D11Device> device;
+
+    immediateContext->GetDevice(&device);
+
+    mVertices.size = vertexBytes;
+
+    CreateBuffer(device.Get(), vertexBytes, D3D11_BIND_VERTEX_BUFFER, &mVertices.buffer);
+
+    // As with PrimitiveBatch, indexBytes = 0 skips creating the index buffer for heaps only used for non-indexed geometry.
+    if (indexBytes > 0)
+    {
+        mIndices.size = indexBytes;
+
+        CreateBuffer(device.Get(), indexBytes, D3D11_BIND_INDEX_BUFFER, &mIndices.buffer);
+    }
+}
+
+
+// Maps the shared buffers for a new frame.
+void PrimitiveBatchHeap::Impl::BeginFrame()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mMapped)
+        throw std::exception("Cannot nest BeginFrame calls");
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+
+    ThrowIfFailed(
+        mDeviceContext->Map(mVertices.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)
+    );
+
+    mVertices.data = static_cast<uint8_t*>(mapped.pData);
+    mVertices.used = 0;
+
+    if (mIndices.buffer)
+    {
+        HRESULT hr = mDeviceContext->Map(mIndices.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+
+        if (FAILED(hr))
+        {
+            mDeviceContext->Unmap(mVertices.buffer.Get(), 0);
+            mVertices.data = nullptr;
+
+            ThrowIfFailed(hr);
+        }
+
+        mIndices.data = static_cast<uint8_t*>(mapped.pData);
+        mIndices.used = 0;
+    }
+
+    mFrame++;
+    mMapped = true;
+}
+
+
+// Unmaps the shared buffers, after which chunks handed out this frame can no longer be written.
+void PrimitiveBatchHeap::Impl::EndFrame()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mMapped)
+        throw std::exception("BeginFrame must be called before EndFrame");
+
+    mDeviceContext->Unmap(mVertices.buffer.Get(), 0);
+    mVertices.data = nullptr;
+
+    if (mIndices.buffer)
+    {
+        mDeviceContext->Unmap(mIndices.buffer.Get(), 0);
+        mIndices.data = nullptr;
+    }
+
+    mMapped = false;
+}
+
+
+// Hands out a chunk of one of the buffers. Batches only come back for more when a chunk fills up, so a lock is cheap enough.
+uint8_t* PrimitiveBatchHeap::Impl::Allocate(Region& region, size_t size, _Out_ UINT* offset)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mMapped)
+        throw std::exception("PrimitiveBatchHeap::BeginFrame must be called before drawing");
+
+    size_t start = (region.used + ChunkAlignment - 1) & ~(ChunkAlignment - 1);
+
+    if (start > region.size || size > region.size - start)
+    {
+        DebugTrace( "PrimitiveBatchHeap cannot fit a %Iu byte chunk (%Iu of %Iu bytes used this frame)\n", size, region.used, region.size );
+        throw std::exception("PrimitiveBatchHeap is full");
+    }
+
+    region.used = start + size;
+
+    *offset = static_cast<UINT>(start);
+
+    return region.data + start;
+}
+
+
+size_t PrimitiveBatchHeap::Impl::GetBytesUsed(Region const& region)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return region.used;
+}
+
+
+uint32_t PrimitiveBatchHeap::Impl::GetFrame()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    return mFrame;
+}
+
+
+// Constructor.
+PrimitiveBatchBase::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext, _In_opt_ PrimitiveBatchHeap::Impl* heap, size_t maxIndices, size_t maxVertices, size_t vertexSize)
   : mDeviceContext(deviceContext),
     mMaxIndices(maxIndices),
     mMaxVertices(maxVertices),
     mVertexSize(vertexSize),
+    mIndexFormat(DXGI_FORMAT_R16_UINT),
+    mRingBufferMode(false),
     mInBeginEndPair(false),
     mCurrentTopology(D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED),
     mCurrentlyIndexed(false),
     mCurrentIndex(0),
     mCurrentVertex(0),
     mBaseIndex(0),
-    mBaseVertex(0)
+    mBaseVertex(0),
+    mGpuTiming(false),
+    mHeap(heap),
+    mHeapFrame(0),
+    mIndexChunkOffset(0),
+    mVertexChunkOffset(0)
 {
+    memset(&mStatistics, 0, sizeof(mStatistics));
+    memset(&mMappedIndices, 0, sizeof(mMappedIndices));
+    memset(&mMappedVertices, 0, sizeof(mMappedVertices));
+
     ComPtr<ID3D11Device> device;
     
     deviceContext->GetDevice(&device);
 
+    // Batches that can hold more vertices than a 16 bit index can reach use 32 bit indices.
+    if (maxVertices > 65536)
+    {
+        mIndexFormat = DXGI_FORMAT_R32_UINT;
+    }
+
+    // In heap mode the chunks come from the shared buffers, which stay mapped on the immediate context while
+    // batches are drawing, so the batch must record onto a deferred context that is executed after EndFrame.
+    if (heap)
+    {
+        if (deviceContext->GetType() != D3D11_DEVICE_CONTEXT_DEFERRED)
+            throw std::exception("PrimitiveBatch heap mode requires a deferred context");
+
+        size_t indexSize = (mIndexFormat == DXGI_FORMAT_R32_UINT) ? sizeof(uint32_t) : sizeof(uint16_t);
+
+        if (maxVertices * vertexSize > heap->mVertices.size || maxIndices * indexSize > heap->mIndices.size)
+            throw std::exception("PrimitiveBatch chunk size is larger than the heap");
+
+        return;
+    }
+
     // If you only intend to draw non-indexed geometry, specify maxIndices = 0 to skip creating the index buffer.
     if (maxIndices > 0)
     {
-        CreateBuffer(device.Get(), maxIndices * sizeof(uint16_t), D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
+        size_t indexSize = (mIndexFormat == DXGI_FORMAT_R32_UINT) ? sizeof(uint32_t) : sizeof(uint16_t);
+
+        CreateBuffer(device.Get(), maxIndices * indexSize, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
     }
 
     // Create the vertex buffer.
@@ -112,24 +368,59 @@ void PrimitiveBatchBase::Impl::Begin()
     if (mInBeginEndPair)
         throw std::exception("Cannot nest Begin calls");
 
-    // Bind the index buffer.
-    if (mMaxIndices > 0)
+    if (mHeap)
     {
-        mDeviceContext->IASetIndexBuffer(mIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+        uint32_t frame = mHeap->GetFrame();
+
+        if (frame != mHeapFrame)
+        {
+            // Chunks from an earlier frame went away with the heap mapping, so mark them full,
+            // making the first draws take new ones.
+            mHeapFrame = frame;
+            mCurrentIndex = mMaxIndices;
+            mCurrentVertex = mMaxVertices;
+        }
+        else
+        {
+            // Carry on filling this frame's chunks.
+            BindHeapChunks();
+        }
     }
+    else
+    {
+        // Bind the index buffer.
+        if (mMaxIndices > 0)
+        {
+            mDeviceContext->IASetIndexBuffer(mIndexBuffer.Get(), mIndexFormat, 0);
+        }
 
-    // Bind the vertex buffer.
-    auto vertexBuffer = mVertexBuffer.Get();
-    UINT vertexStride = (UINT)mVertexSize;
-    UINT vertexOffset = 0;
+        // Bind the vertex buffer.
+        auto vertexBuffer = mVertexBuffer.Get();
+        UINT vertexStride = (UINT)mVertexSize;
+        UINT vertexOffset = 0;
 
-    mDeviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+        mDeviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
      
-    // If this is a deferred D3D context, reset position so the first Map calls will use D3D11_MAP_WRITE_DISCARD.
-    if (mDeviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+        // If this is a deferred D3D context, reset position so the first Map calls will use D3D11_MAP_WRITE_DISCARD.
+        if (mDeviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+        {
+            mCurrentIndex = 0;
+            mCurrentVertex = 0;
+        }
+    }
+
+    // Collect any completed timing measurements, then start a new one that runs until End.
+    if (mGpuTiming)
     {
-        mCurrentIndex = 0;
-        mCurrentVertex = 0;
+        double milliseconds;
+
+        while (mGpuTimer.TryResolve(mDeviceContext.Get(), &milliseconds))
+        {
+            mStatistics.gpuMilliseconds += milliseconds;
+            mStatistics.gpuTimings++;
+        }
+
+        mGpuTimer.Start(mDeviceContext.Get());
     }
 
     mInBeginEndPair = true;
@@ -144,6 +435,11 @@ void PrimitiveBatchBase::Impl::End()
 
     FlushBatch();
 
+    if (mGpuTiming)
+    {
+        mGpuTimer.Stop(mDeviceContext.Get());
+    }
+
     mInBeginEndPair = false;
 }
 
@@ -170,60 +466,188 @@ static bool CanBatchPrimitives(D3D11_PRIMITIVE_TOPOLOGY topology)
 
 
 // Helper for locking a vertex or index buffer.
-static void LockBuffer(_In_ ID3D11DeviceContext* deviceContext, _In_ ID3D11Buffer* buffer, size_t currentPosition, _Out_ size_t* basePosition, _Out_ D3D11_MAPPED_SUBRESOURCE* mappedResource)
+void PrimitiveBatchBase::Impl::LockBuffer(_In_ ID3D11Buffer* buffer, size_t currentPosition, bool discard, _Out_ size_t* basePosition, _Out_ D3D11_MAPPED_SUBRESOURCE* mappedResource)
 {
-    D3D11_MAP mapType = (currentPosition == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    D3D11_MAP mapType = discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
 
     ThrowIfFailed(
-        deviceContext->Map(buffer, 0, mapType, 0, mappedResource)
+        mDeviceContext->Map(buffer, 0, mapType, 0, mappedResource)
     );
 
+    mStatistics.maps++;
+
+    if (mapType == D3D11_MAP_WRITE_DISCARD)
+    {
+        mStatistics.discards++;
+    }
+
     *basePosition = currentPosition;
 }
 
 
+// Moves a ring buffer on to its next segment, marking the end of the one it leaves, and waiting if the GPU
+// has not yet finished with the next one from the previous lap. Returns the new segment's first element.
+size_t PrimitiveBatchBase::Impl::NextRingSegment(RingBuffer& ring)
+{
+    auto leaving = ring.queries[ring.currentSegment].Get();
+
+    mDeviceContext->End(leaving);
+
+    ring.pending[ring.currentSegment] = true;
+
+    ring.currentSegment = (ring.currentSegment + 1) % RingSegmentCount;
+
+    if (ring.pending[ring.currentSegment])
+    {
+        auto entering = ring.queries[ring.currentSegment].Get();
+
+        if (mDeviceContext->GetData(entering, nullptr, 0, 0) != S_OK)
+        {
+            mStatistics.ringWaits++;
+
+            while (mDeviceContext->GetData(entering, nullptr, 0, 0) == S_FALSE)
+            {
+                SwitchToThread();
+            }
+        }
+
+        ring.pending[ring.currentSegment] = false;
+    }
+
+    return ring.currentSegment * ring.segmentSize;
+}
+
+
+// Takes a fresh chunk from the heap for the index or vertex data, and binds it in place of the old one.
+void PrimitiveBatchBase::Impl::AcquireHeapChunk(bool isIndexChunk)
+{
+    if (isIndexChunk)
+    {
+        size_t indexSize = (mIndexFormat == DXGI_FORMAT_R32_UINT) ? sizeof(uint32_t) : sizeof(uint16_t);
+
+        mMappedIndices.pData = mHeap->Allocate(mHeap->mIndices, mMaxIndices * indexSize, &mIndexChunkOffset);
+    }
+    else
+    {
+        mMappedVertices.pData = mHeap->Allocate(mHeap->mVertices, mMaxVertices * mVertexSize, &mVertexChunkOffset);
+    }
+
+    BindHeapChunks();
+}
+
+
+// Binds the current chunks. Their offsets are applied when binding, so draws see each chunk as starting at zero.
+void PrimitiveBatchBase::Impl::BindHeapChunks()
+{
+    if (mMaxIndices > 0)
+    {
+        mDeviceContext->IASetIndexBuffer(mHeap->mIndices.buffer.Get(), mIndexFormat, mIndexChunkOffset);
+    }
+
+    auto vertexBuffer = mHeap->mVertices.buffer.Get();
+    UINT vertexStride = (UINT)mVertexSize;
+
+    mDeviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &mVertexChunkOffset);
+}
+
+
 // Adds new geometry to the batch.
-void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint16_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices)
+template<typename TIndex>
+void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) TIndex const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices)
 {
     if (isIndexed && !indices)
         throw std::exception("Indices cannot be null");
 
-    if (indexCount >= mMaxIndices)
+    // In ring buffer mode each draw must fit within one segment of the buffers.
+    size_t maxIndices = mRingBufferMode ? mIndexRing.segmentSize : mMaxIndices;
+    size_t maxVertices = mRingBufferMode ? mVertexRing.segmentSize : mMaxVertices;
+
+    if (indexCount >= maxIndices)
         throw std::exception("Too many indices");
 
-    if (vertexCount >= mMaxVertices)
+    if (vertexCount >= maxVertices)
         throw std::exception("Too many vertices");
 
     if (!mInBeginEndPair)
         throw std::exception("Begin must be called before Draw");
 
     // Can we merge this primitive in with an existing batch, or must we flush first?
-    bool wrapIndexBuffer = (mCurrentIndex + indexCount > mMaxIndices);
-    bool wrapVertexBuffer = (mCurrentVertex + vertexCount > mMaxVertices);
+    bool wrapIndexBuffer;
+    bool wrapVertexBuffer;
+
+    if (mRingBufferMode)
+    {
+        wrapIndexBuffer = (mCurrentIndex + indexCount > (mIndexRing.currentSegment + 1) * mIndexRing.segmentSize);
+        wrapVertexBuffer = (mCurrentVertex + vertexCount > (mVertexRing.currentSegment + 1) * mVertexRing.segmentSize);
+    }
+    else
+    {
+        wrapIndexBuffer = (mCurrentIndex + indexCount > mMaxIndices);
+        wrapVertexBuffer = (mCurrentVertex + vertexCount > mMaxVertices);
+    }
 
     if ((topology != mCurrentTopology) ||
         (isIndexed != mCurrentlyIndexed) ||
         !CanBatchPrimitives(topology) ||
         wrapIndexBuffer || wrapVertexBuffer)
     {
+        if (mCurrentTopology != D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED)
+        {
+            if (wrapIndexBuffer || wrapVertexBuffer)
+            {
+                mStatistics.bufferSplits++;
+            }
+            else
+            {
+                mStatistics.topologySplits++;
+            }
+        }
+
         FlushBatch();
     }
 
     if (wrapIndexBuffer)
-        mCurrentIndex = 0;
+    {
+        if (mHeap)
+            AcquireHeapChunk(true);
+
+        mCurrentIndex = mRingBufferMode ? NextRingSegment(mIndexRing) : 0;
+    }
 
     if (wrapVertexBuffer)
-        mCurrentVertex = 0;
+    {
+        if (mHeap)
+            AcquireHeapChunk(false);
 
-    // If we are not already in a batch, lock the buffers.
-    if (mCurrentTopology == D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED)
+        mCurrentVertex = mRingBufferMode ? NextRingSegment(mVertexRing) : 0;
+    }
+
+    // If we are not already in a batch, lock the buffers. Ring buffer mode only discards the very first time,
+    // relying on the segment queries rather than buffer renaming after that. Heap chunks are already mapped.
+    if (mCurrentTopology == D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED && mHeap)
+    {
+        mBaseIndex = mCurrentIndex;
+        mBaseVertex = mCurrentVertex;
+
+        mCurrentTopology = topology;
+        mCurrentlyIndexed = isIndexed;
+    }
+    else if (mCurrentTopology == D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED)
     {
         if (isIndexed)
         {
-            LockBuffer(mDeviceContext.Get(), mIndexBuffer.Get(), mCurrentIndex, &mBaseIndex, &mMappedIndices);
+            bool discard = mRingBufferMode ? !mIndexRing.primed : (mCurrentIndex == 0);
+
+            LockBuffer(mIndexBuffer.Get(), mCurrentIndex, discard, &mBaseIndex, &mMappedIndices);
+
+            mIndexRing.primed = true;
         }
 
-        LockBuffer(mDeviceContext.Get(), mVertexBuffer.Get(), mCurrentVertex, &mBaseVertex, &mMappedVertices);
+        bool discard = mRingBufferMode ? !mVertexRing.primed : (mCurrentVertex == 0);
+
+        LockBuffer(mVertexBuffer.Get(), mCurrentVertex, discard, &mBaseVertex, &mMappedVertices);
+
+        mVertexRing.primed = true;
 
         mCurrentTopology = topology;
         mCurrentlyIndexed = isIndexed;
@@ -232,11 +656,25 @@ void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIn
     // Copy over the index data.
     if (isIndexed)
     {
-        uint16_t* outputIndices = (uint16_t*)mMappedIndices.pData + mCurrentIndex;
-        
-        for (size_t i = 0; i < indexCount; i++)
+        size_t indexOffset = mCurrentVertex - mBaseVertex;
+
+        if (mIndexFormat == DXGI_FORMAT_R32_UINT)
+        {
+            uint32_t* outputIndices = (uint32_t*)mMappedIndices.pData + mCurrentIndex;
+
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                outputIndices[i] = (uint32_t)(indices[i] + indexOffset);
+            }
+        }
+        else
         {
-            outputIndices[i] = (uint16_t)(indices[i] + mCurrentVertex - mBaseVertex);
+            uint16_t* outputIndices = (uint16_t*)mMappedIndices.pData + mCurrentIndex;
+        
+            for (size_t i = 0; i < indexCount; i++)
+            {
+                outputIndices[i] = (uint16_t)(indices[i] + indexOffset);
+            }
         }
  
         mCurrentIndex += indexCount;
@@ -258,14 +696,22 @@ void PrimitiveBatchBase::Impl::FlushBatch()
 
     mDeviceContext->IASetPrimitiveTopology(mCurrentTopology);
 
-    mDeviceContext->Unmap(mVertexBuffer.Get(), 0);
+    if (!mHeap)
+    {
+        mDeviceContext->Unmap(mVertexBuffer.Get(), 0);
+    }
 
     if (mCurrentlyIndexed)
     {
         // Draw indexed geometry.
-        mDeviceContext->Unmap(mIndexBuffer.Get(), 0);
+        if (!mHeap)
+        {
+            mDeviceContext->Unmap(mIndexBuffer.Get(), 0);
+        }
 
         mDeviceContext->DrawIndexed((UINT)(mCurrentIndex - mBaseIndex), (UINT)mBaseIndex, (UINT)mBaseVertex);
+
+        mStatistics.indices += mCurrentIndex - mBaseIndex;
     }
     else
     {
@@ -273,14 +719,94 @@ void PrimitiveBatchBase::Impl::FlushBatch()
         mDeviceContext->Draw((UINT)(mCurrentVertex - mBaseVertex), (UINT)mBaseVertex);
     }
 
+    mStatistics.drawCalls++;
+    mStatistics.vertices += mCurrentVertex - mBaseVertex;
+
     mCurrentTopology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
 }
 
 
+// Enables or disables timestamp queries around each Begin/End pair.
+void PrimitiveBatchBase::Impl::SetGpuTiming(bool enable)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot change GPU timing mode inside a Begin/End pair");
+
+    mGpuTiming = enable;
+}
+
+
+void PrimitiveBatchBase::Impl::CreateRingBuffer(_In_ ID3D11Device* device, RingBuffer& ring, size_t maxElements)
+{
+    ring.segmentSize = maxElements / RingSegmentCount;
+    ring.currentSegment = 0;
+    ring.primed = false;
+
+    for (size_t i = 0; i < RingSegmentCount; i++)
+    {
+        if (!ring.queries[i])
+        {
+            D3D11_QUERY_DESC desc = { D3D11_QUERY_EVENT, 0 };
+
+            ThrowIfFailed(
+                device->CreateQuery(&desc, &ring.queries[i])
+            );
+
+            SetDebugObjectName(ring.queries[i].Get(), "DirectXTK:PrimitiveBatch");
+        }
+
+        ring.pending[i] = false;
+    }
+}
+
+
+// Switches between discarding the buffers each time they fill up, and using them as rings fenced with event queries.
+void PrimitiveBatchBase::Impl::SetRingBufferMode(bool enable)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot change ring buffer mode inside a Begin/End pair");
+
+    if (enable)
+    {
+        if (mDeviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+            throw std::exception("Ring buffer mode requires the immediate context");
+
+        if (mMaxVertices < RingSegmentCount * 2 || (mMaxIndices > 0 && mMaxIndices < RingSegmentCount * 2))
+            throw std::exception("Buffers too small for ring buffer mode");
+
+        ComPtr<ID3D11Device> device;
+
+        mDeviceContext->GetDevice(&device);
+
+        if (mMaxIndices > 0)
+        {
+            CreateRingBuffer(device.Get(), mIndexRing, mMaxIndices);
+        }
+
+        CreateRingBuffer(device.Get(), mVertexRing, mMaxVertices);
+    }
+
+    // Start again from the beginning, so the first map in either mode discards.
+    mRingBufferMode = enable;
+    mCurrentIndex = 0;
+    mCurrentVertex = 0;
+}
+
+
 // Public constructor.
 PrimitiveBatchBase::PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize)
-  : pImpl(new Impl(deviceContext, maxIndices, maxVertices, vertexSize))
+  : pImpl(new Impl(deviceContext, nullptr, maxIndices, maxVertices, vertexSize))
+{
+}
+
+
+// Public constructor, drawing from a shared heap.
+PrimitiveBatchBase::PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, _In_ PrimitiveBatchHeap* heap, size_t maxIndices, size_t maxVertices, size_t vertexSize)
 {
+    if (!heap)
+        throw std::exception("PrimitiveBatchHeap cannot be null");
+
+    pImpl.reset(new Impl(deviceContext, heap->pImpl.get(), maxIndices, maxVertices, vertexSize));
 }
 
 
@@ -321,3 +847,89 @@ void PrimitiveBatchBase::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed,
 {
     pImpl->Draw(topology, isIndexed, indices, indexCount, vertexCount, pMappedVertices);
 }
+
+
+void PrimitiveBatchBase::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint32_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices)
+{
+    pImpl->Draw(topology, isIndexed, indices, indexCount, vertexCount, pMappedVertices);
+}
+
+
+PrimitiveBatchStatistics PrimitiveBatchBase::GetStatistics() const
+{
+    return pImpl->mStatistics;
+}
+
+
+void PrimitiveBatchBase::ResetStatistics()
+{
+    memset(&pImpl->mStatistics, 0, sizeof(pImpl->mStatistics));
+}
+
+
+void PrimitiveBatchBase::SetGpuTiming(bool enable)
+{
+    pImpl->SetGpuTiming(enable);
+}
+
+
+void PrimitiveBatchBase::SetRingBufferMode(bool enable)
+{
+    pImpl->SetRingBufferMode(enable);
+}
+
+
+//--------------------------------------------------------------------------------------
+// PrimitiveBatchHeap
+//--------------------------------------------------------------------------------------
+
+// Public constructor.
+PrimitiveBatchHeap::PrimitiveBatchHeap(_In_ ID3D11DeviceContext* immediateContext, size_t vertexBytes, size_t indexBytes)
+  : pImpl(new Impl(immediateContext, vertexBytes, indexBytes))
+{
+}
+
+
+// Move constructor.
+PrimitiveBatchHeap::PrimitiveBatchHeap(PrimitiveBatchHeap&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+PrimitiveBatchHeap& PrimitiveBatchHeap::operator= (PrimitiveBatchHeap&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+PrimitiveBatchHeap::~PrimitiveBatchHeap()
+{
+}
+
+
+void PrimitiveBatchHeap::BeginFrame()
+{
+    pImpl->BeginFrame();
+}
+
+
+void PrimitiveBatchHeap::EndFrame()
+{
+    pImpl->EndFrame();
+}
+
+
+size_t PrimitiveBatchHeap::GetVertexBytesUsed() const
+{
+    return pImpl->GetBytesUsed(pImpl->mVertices);
+}
+
+
+size_t PrimitiveBatchHeap::GetIndexBytesUsed() const
+{
+    return pImpl->GetBytesUsed(pImpl->mIndices);
+}
@@ -0,0 +1,567 @@
+//--------------------------------------------------------------------------------------
+// File: ReflectionProbes.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "Effects.h"
+#include "ConstantBuffer.h"
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+
+// Constant buffer layout. Must match the shader!
+struct ReflectionProbeConstants
+{
+    float roughness;
+    float sourceTexelSolidAngle;
+    uint32_t destinationSize;
+    uint32_t padding;
+};
+
+static_assert( ( sizeof(ReflectionProbeConstants) % 16 ) == 0, "CB size not padded correctly" );
+
+
+// Include the precompiled shader code.
+namespace
+{
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    #include "Shaders/Compiled/XboxOneReflectionProbes_CSPrefilter.inc"
+#else
+    #include "Shaders/Compiled/ReflectionProbes_CSPrefilter.inc"
+#endif
+
+    // Must match ThreadGroupSize in the shader.
+    const UINT ThreadGroupSize = 8;
+
+    const UINT FaceCount = 6;
+
+    // Look and up directions for each face, in D3D cubemap order.
+    const XMVECTORF32 FaceLook[FaceCount] =
+    {
+        {  1,  0,  0, 0 },
+        { -1,  0,  0, 0 },
+        {  0,  1,  0, 0 },
+        {  0, -1,  0, 0 },
+        {  0,  0,  1, 0 },
+        {  0,  0, -1, 0 },
+    };
+
+    const XMVECTORF32 FaceUp[FaceCount] =
+    {
+        { 0, 1,  0, 0 },
+        { 0, 1,  0, 0 },
+        { 0, 0, -1, 0 },
+        { 0, 0,  1, 0 },
+        { 0, 1,  0, 0 },
+        { 0, 1,  0, 0 },
+    };
+}
+
+
+// Internal ReflectionProbes implementation class.
+class ReflectionProbes::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device, size_t probeCount, UINT resolution, DXGI_FORMAT format);
+
+    void RenderFaces(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw, size_t faceCount);
+
+    struct Probe
+    {
+        ComPtr<ID3D11Texture2D> texture;
+        ComPtr<ID3D11ShaderResourceView> view;
+        std::vector<ComPtr<ID3D11UnorderedAccessView>> mipViews;
+        XMFLOAT3 position;
+    };
+
+    std::vector<Probe> probes;
+
+    UINT mipLevels;
+    float nearPlane;
+    float farPlane;
+    XMFLOAT4 clearColor;
+    UINT facesPerFrame;
+
+    // The probe and face the next RenderFaces call starts at.
+    size_t currentProbe;
+    UINT currentFace;
+
+private:
+    void CreateProbe(_Inout_ Probe& probe);
+    void RenderFace(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw);
+    void Prefilter(_In_ ID3D11DeviceContext* deviceContext, _In_ Probe& probe);
+
+    ComPtr<ID3D11Device> mDevice;
+
+    UINT mResolution;
+    DXGI_FORMAT mFormat;
+    bool mComputePrefilter;
+
+    // Faces are rendered here, so a probe only changes once all six are done.
+    ComPtr<ID3D11Texture2D> mScratchTexture;
+    ComPtr<ID3D11ShaderResourceView> mScratchView;
+    ComPtr<ID3D11RenderTargetView> mScratchFaceViews[FaceCount];
+
+    ComPtr<ID3D11Texture2D> mDepthTexture;
+    ComPtr<ID3D11DepthStencilView> mDepthView;
+
+    // Where the probe in the scratch texture was when its first face was rendered.
+    XMFLOAT3 mScratchPosition;
+
+    ComPtr<ID3D11ComputeShader> mComputeShader;
+    ComPtr<ID3D11SamplerState> mSampler;
+    ConstantBuffer<ReflectionProbeConstants> mConstantBuffer;
+};
+
+
+ReflectionProbes::Impl::Impl(_In_ ID3D11Device* device, size_t probeCount, UINT resolution, DXGI_FORMAT format)
+  : mipLevels(1),
+    nearPlane(0.1f),
+    farPlane(1000.f),
+    clearColor(0, 0, 0, 1),
+    facesPerFrame(DefaultFacesPerFrame),
+    currentProbe(0),
+    currentFace(0),
+    mDevice(device),
+    mResolution(resolution),
+    mFormat(format),
+    mComputePrefilter(false),
+    mScratchPosition(0, 0, 0)
+{
+    if (!probeCount)
+        throw std::out_of_range("probeCount parameter out of range");
+
+    if (!resolution || resolution > D3D11_REQ_TEXTURECUBE_DIMENSION)
+        throw std::out_of_range("resolution parameter out of range");
+
+    UINT formatSupport = 0;
+
+    if (FAILED(device->CheckFormatSupport(format, &formatSupport)))
+        formatSupport = 0;
+
+    const UINT requiredSupport = D3D11_FORMAT_SUPPORT_TEXTURECUBE | D3D11_FORMAT_SUPPORT_RENDER_TARGET | D3D11_FORMAT_SUPPORT_MIP_AUTOGEN;
+
+    if ((formatSupport & requiredSupport) != requiredSupport)
+    {
+        DebugTrace("ERROR: ReflectionProbes needs a format that supports cubemaps, render targets and GenerateMips (%u)\n", format);
+        throw std::exception("ReflectionProbes format not supported");
+    }
+
+    // The compute prefilter writes straight into the probe's mips.
+    mComputePrefilter = (device->GetFeatureLevel() >= D3D_FEATURE_LEVEL_11_0)
+                     && (formatSupport & D3D11_FORMAT_SUPPORT_TYPED_UNORDERED_ACCESS_VIEW);
+
+    for (UINT size = resolution; size > 1; size >>= 1)
+    {
+        ++mipLevels;
+    }
+
+    // Scratch cubemap, with a full mip chain to prefilter from.
+    D3D11_TEXTURE2D_DESC textureDesc = {0};
+
+    textureDesc.Width = resolution;
+    textureDesc.Height = resolution;
+    textureDesc.MipLevels = mipLevels;
+    textureDesc.ArraySize = FaceCount;
+    textureDesc.Format = format;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+    textureDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE | D3D11_RESOURCE_MISC_GENERATE_MIPS;
+
+    ThrowIfFailed(
+        device->CreateTexture2D(&textureDesc, nullptr, &mScratchTexture)
+    );
+
+    SetDebugObjectName(mScratchTexture.Get(), "DirectXTK:ReflectionProbes");
+
+    ThrowIfFailed(
+        device->CreateShaderResourceView(mScratchTexture.Get(), nullptr, &mScratchView)
+    );
+
+    SetDebugObjectName(mScratchView.Get(), "DirectXTK:ReflectionProbes");
+
+    for (UINT face = 0; face < FaceCount; ++face)
+    {
+        D3D11_RENDER_TARGET_VIEW_DESC targetDesc = {};
+
+        targetDesc.Format = format;
+        targetDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
+        targetDesc.Texture2DArray.MipSlice = 0;
+        targetDesc.Texture2DArray.FirstArraySlice = face;
+        targetDesc.Texture2DArray.ArraySize = 1;
+
+        ThrowIfFailed(
+            device->CreateRenderTargetView(mScratchTexture.Get(), &targetDesc, &mScratchFaceViews[face])
+        );
+
+        SetDebugObjectName(mScratchFaceViews[face].Get(), "DirectXTK:ReflectionProbes");
+    }
+
+    // One depth buffer serves every face.
+    D3D11_TEXTURE2D_DESC depthDesc = {0};
+
+    depthDesc.Width = resolution;
+    depthDesc.Height = resolution;
+    depthDesc.MipLevels = 1;
+    depthDesc.ArraySize = 1;
+    depthDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+    depthDesc.SampleDesc.Count = 1;
+    depthDesc.Usage = D3D11_USAGE_DEFAULT;
+    depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+
+    ThrowIfFailed(
+        device->CreateTexture2D(&depthDesc, nullptr, &mDepthTexture)
+    );
+
+    SetDebugObjectName(mDepthTexture.Get(), "DirectXTK:ReflectionProbes");
+
+    ThrowIfFailed(
+        device->CreateDepthStencilView(mDepthTexture.Get(), nullptr, &mDepthView)
+    );
+
+    SetDebugObjectName(mDepthView.Get(), "DirectXTK:ReflectionProbes");
+
+    if (mComputePrefilter)
+    {
+        ThrowIfFailed(
+            device->CreateComputeShader(ReflectionProbes_CSPrefilter, sizeof(ReflectionProbes_CSPrefilter), nullptr, &mComputeShader)
+        );
+
+        SetDebugObjectName(mComputeShader.Get(), "DirectXTK:ReflectionProbes");
+
+        D3D11_SAMPLER_DESC samplerDesc = {};
+
+        samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+        samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+        samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+        samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+        samplerDesc.MaxAnisotropy = 1;
+        samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+        samplerDesc.MaxLOD = FLT_MAX;
+
+        ThrowIfFailed(
+            device->CreateSamplerState(&samplerDesc, &mSampler)
+        );
+
+        SetDebugObjectName(mSampler.Get(), "DirectXTK:ReflectionProbes");
+
+        mConstantBuffer.Create(device);
+    }
+
+    probes.resize(probeCount);
+
+    for (auto it = probes.begin(); it != probes.end(); ++it)
+    {
+        CreateProbe(*it);
+    }
+}
+
+
+// Probes written by the compute shader need UAVs, while the fallback copies the whole scratch texture, so needs a matching one.
+void ReflectionProbes::Impl::CreateProbe(_Inout_ Probe& probe)
+{
+    D3D11_TEXTURE2D_DESC textureDesc;
+    mScratchTexture->GetDesc(&textureDesc);
+
+    if (mComputePrefilter)
+    {
+        textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        textureDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+    }
+
+    ThrowIfFailed(
+        mDevice->CreateTexture2D(&textureDesc, nullptr, &probe.texture)
+    );
+
+    SetDebugObjectName(probe.texture.Get(), "DirectXTK:ReflectionProbes");
+
+    ThrowIfFailed(
+        mDevice->CreateShaderResourceView(probe.texture.Get(), nullptr, &probe.view)
+    );
+
+    SetDebugObjectName(probe.view.Get(), "DirectXTK:ReflectionProbes");
+
+    if (mComputePrefilter)
+    {
+        // Mip 0 is copied rather than filtered, so it has no view.
+        probe.mipViews.resize(mipLevels);
+
+        for (UINT mip = 1; mip < mipLevels; ++mip)
+        {
+            D3D11_UNORDERED_ACCESS_VIEW_DESC accessDesc = {};
+
+            accessDesc.Format = mFormat;
+            accessDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2DARRAY;
+            accessDesc.Texture2DArray.MipSlice = mip;
+            accessDesc.Texture2DArray.FirstArraySlice = 0;
+            accessDesc.Texture2DArray.ArraySize = FaceCount;
+
+            ThrowIfFailed(
+                mDevice->CreateUnorderedAccessView(probe.texture.Get(), &accessDesc, &probe.mipViews[mip])
+            );
+
+            SetDebugObjectName(probe.mipViews[mip].Get(), "DirectXTK:ReflectionProbes");
+        }
+    }
+
+    probe.position = XMFLOAT3(0, 0, 0);
+}
+
+
+// Draws the scene into the next face of the scratch texture.
+void ReflectionProbes::Impl::RenderFace(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw)
+{
+    if (!currentFace)
+    {
+        mScratchPosition = probes[currentProbe].position;
+    }
+
+    ID3D11RenderTargetView* renderTarget = mScratchFaceViews[currentFace].Get();
+
+    deviceContext->OMSetRenderTargets(1, &renderTarget, mDepthView.Get());
+
+    deviceContext->ClearRenderTargetView(renderTarget, &clearColor.x);
+    deviceContext->ClearDepthStencilView(mDepthView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1, 0);
+
+    CD3D11_VIEWPORT viewport(0.f, 0.f, static_cast<float>(mResolution), static_cast<float>(mResolution));
+
+    deviceContext->RSSetViewports(1, &viewport);
+
+    XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&mScratchPosition), FaceLook[currentFace], FaceUp[currentFace]);
+    XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1, nearPlane, farPlane);
+
+    draw(deviceContext, currentProbe, view, projection);
+}
+
+
+// Builds the probe's mips from the finished scratch texture. Each mip is filtered for roughness mip / (mipLevels - 1),
+// matching EnvironmentMapEffect::SetEnvironmentMapRoughness.
+void ReflectionProbes::Impl::Prefilter(_In_ ID3D11DeviceContext* deviceContext, _In_ Probe& probe)
+{
+    deviceContext->OMSetRenderTargets(0, nullptr, nullptr);
+
+    deviceContext->GenerateMips(mScratchView.Get());
+
+    if (!mComputePrefilter)
+    {
+        deviceContext->CopyResource(probe.texture.Get(), mScratchTexture.Get());
+        return;
+    }
+
+    for (UINT face = 0; face < FaceCount; ++face)
+    {
+        UINT subresource = D3D11CalcSubresource(0, face, mipLevels);
+
+        deviceContext->CopySubresourceRegion(probe.texture.Get(), subresource, 0, 0, 0, mScratchTexture.Get(), subresource, nullptr);
+    }
+
+    deviceContext->CSSetShader(mComputeShader.Get(), nullptr, 0);
+
+    ID3D11Buffer* constantBuffer = mConstantBuffer.GetBuffer();
+    ID3D11ShaderResourceView* sourceView = mScratchView.Get();
+    ID3D11SamplerState* sampler = mSampler.Get();
+
+    deviceContext->CSSetConstantBuffers(0, 1, &constantBuffer);
+    deviceContext->CSSetShaderResources(0, 1, &sourceView);
+    deviceContext->CSSetSamplers(0, 1, &sampler);
+
+    ReflectionProbeConstants constants = {};
+
+    constants.sourceTexelSolidAngle = 4 * XM_PI / (FaceCount * static_cast<float>(mResolution) * static_cast<float>(mResolution));
+
+    for (UINT mip = 1; mip < mipLevels; ++mip)
+    {
+        UINT size = std::max(mResolution >> mip, 1u);
+
+        constants.roughness = static_cast<float>(mip) / static_cast<float>(mipLevels - 1);
+        constants.destinationSize = size;
+
+        mConstantBuffer.SetData(deviceContext, constants);
+
+        ID3D11UnorderedAccessView* accessView = probe.mipViews[mip].Get();
+
+        deviceContext->CSSetUnorderedAccessViews(0, 1, &accessView, nullptr);
+
+        UINT groups = (size + ThreadGroupSize - 1) / ThreadGroupSize;
+
+        deviceContext->Dispatch(groups, groups, FaceCount);
+    }
+
+    // Unbind, so the probe can be read by the pixel shaders.
+    ID3D11ShaderResourceView* nullViews[1] = { nullptr };
+    ID3D11UnorderedAccessView* nullAccessViews[1] = { nullptr };
+
+    deviceContext->CSSetShaderResources(0, 1, nullViews);
+    deviceContext->CSSetUnorderedAccessViews(0, 1, nullAccessViews, nullptr);
+    deviceContext->CSSetShader(nullptr, nullptr, 0);
+}
+
+
+// Renders faceCount faces round-robin, prefiltering each probe as it completes.
+void ReflectionProbes::Impl::RenderFaces(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw, size_t faceCount)
+{
+    if (!draw)
+        throw std::exception("ReflectionProbes needs a draw callback");
+
+    if (!faceCount)
+        return;
+
+    // Save the caller's render targets and viewports, to put back afterwards.
+    ComPtr<ID3D11RenderTargetView> savedTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+    ComPtr<ID3D11DepthStencilView> savedDepth;
+
+    {
+        ID3D11RenderTargetView* targets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+        ID3D11DepthStencilView* depth = nullptr;
+
+        deviceContext->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, targets, &depth);
+
+        // OMGetRenderTargets adds a reference, which the ComPtrs take over.
+        for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+        {
+            savedTargets[i].Attach(targets[i]);
+        }
+
+        savedDepth.Attach(depth);
+    }
+
+    D3D11_VIEWPORT savedViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+    UINT savedViewportCount = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+
+    deviceContext->RSGetViewports(&savedViewportCount, savedViewports);
+
+    for (size_t i = 0; i < faceCount; ++i)
+    {
+        RenderFace(deviceContext, draw);
+
+        if (++currentFace == FaceCount)
+        {
+            Prefilter(deviceContext, probes[currentProbe]);
+
+            currentFace = 0;
+            currentProbe = (currentProbe + 1) % probes.size();
+        }
+    }
+
+    ID3D11RenderTargetView* targets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+
+    for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; ++i)
+    {
+        targets[i] = savedTargets[i].Get();
+    }
+
+    deviceContext->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, targets, savedDepth.Get());
+
+    if (savedViewportCount)
+    {
+        deviceContext->RSSetViewports(savedViewportCount, savedViewports);
+    }
+}
+
+
+// Public constructor.
+ReflectionProbes::ReflectionProbes(_In_ ID3D11Device* device, size_t probeCount, UINT resolution, DXGI_FORMAT format)
+  : pImpl(new Impl(device, probeCount, resolution, format))
+{
+}
+
+
+// Move constructor.
+ReflectionProbes::ReflectionProbes(ReflectionProbes&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+ReflectionProbes& ReflectionProbes::operator= (ReflectionProbes&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+ReflectionProbes::~ReflectionProbes()
+{
+}
+
+
+void ReflectionProbes::Update(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw)
+{
+    pImpl->RenderFaces(deviceContext, draw, pImpl->facesPerFrame);
+}
+
+
+void ReflectionProbes::UpdateAll(_In_ ID3D11DeviceContext* deviceContext, DrawCallback const& draw)
+{
+    // Start over at the first face, so no probe keeps faces rendered from an older position.
+    pImpl->currentFace = 0;
+
+    pImpl->RenderFaces(deviceContext, draw, pImpl->probes.size() * FaceCount);
+}
+
+
+void XM_CALLCONV ReflectionProbes::SetProbePosition(size_t probe, FXMVECTOR value)
+{
+    if (probe >= pImpl->probes.size())
+        throw std::out_of_range("probe parameter out of range");
+
+    XMStoreFloat3(&pImpl->probes[probe].position, value);
+}
+
+
+void ReflectionProbes::SetClipPlanes(float nearPlane, float farPlane)
+{
+    if (nearPlane <= 0 || farPlane <= nearPlane)
+        throw std::out_of_range("Clip planes out of range");
+
+    pImpl->nearPlane = nearPlane;
+    pImpl->farPlane = farPlane;
+}
+
+
+void XM_CALLCONV ReflectionProbes::SetClearColor(FXMVECTOR value)
+{
+    XMStoreFloat4(&pImpl->clearColor, value);
+}
+
+
+void ReflectionProbes::SetFacesPerFrame(UINT value)
+{
+    pImpl->facesPerFrame = value;
+}
+
+
+ID3D11ShaderResourceView* ReflectionProbes::GetProbe(size_t probe) const
+{
+    if (probe >= pImpl->probes.size())
+        throw std::out_of_range("probe parameter out of range");
+
+    return pImpl->probes[probe].view.Get();
+}
+
+
+size_t ReflectionProbes::GetProbeCount() const
+{
+    return pImpl->probes.size();
+}
+
+
+UINT ReflectionProbes::GetMipLevels() const
+{
+    return pImpl->mipLevels;
+}
@@ -0,0 +1,117 @@
+//--------------------------------------------------------------------------------------
+// File: ScopedInstrumentationEvent.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Instrumentation.h"
+#include "PlatformHelpers.h"
+
+
+namespace DirectX
+{
+    // Reports an instrumentation event lasting as long as the object, if a callback or GPU events are enabled.
+    // Passing a device context lets the event be marked on the GPU timeline too.
+    class ScopedInstrumentationEvent
+    {
+    public:
+        ScopedInstrumentationEvent(InstrumentationCategory category, _In_z_ wchar_t const* name, _In_opt_z_ wchar_t const* detail = nullptr, size_t size = 0, size_t count = 0, _In_opt_ ID3D11DeviceContext* deviceContext = nullptr)
+          : mActive(false)
+        {
+#ifndef DIRECTX_NO_INSTRUMENTATION
+            auto& settings = Internal::g_instrumentation;
+
+            if (settings.callback || (settings.gpuEvents && deviceContext))
+            {
+                Begin(category, name, detail, size, count, deviceContext);
+            }
+#else
+            UNREFERENCED_PARAMETER( category );
+            UNREFERENCED_PARAMETER( name );
+            UNREFERENCED_PARAMETER( detail );
+            UNREFERENCED_PARAMETER( size );
+            UNREFERENCED_PARAMETER( count );
+            UNREFERENCED_PARAMETER( deviceContext );
+#endif
+        }
+
+        ~ScopedInstrumentationEvent()
+        {
+            if (mActive)
+            {
+                End();
+            }
+        }
+
+        // For sizes and counts that are only known partway through, reported when the event ends.
+        void SetSize(size_t size)   { mEvent.size = size; }
+        void SetCount(size_t count) { mEvent.count = count; }
+
+    private:
+        void Begin(InstrumentationCategory category, _In_z_ wchar_t const* name, _In_opt_z_ wchar_t const* detail, size_t size, size_t count, _In_opt_ ID3D11DeviceContext* deviceContext)
+        {
+            auto& settings = Internal::g_instrumentation;
+
+            mEvent.category = category;
+            mEvent.name = name;
+            mEvent.detail = detail;
+            mEvent.size = size;
+            mEvent.count = count;
+
+            mCallback = settings.callback;
+            mUserContext = settings.userContext;
+            mActive = true;
+
+            if (settings.gpuEvents && deviceContext)
+            {
+                // Only mark the GPU timeline when a tool is listening.
+                if (SUCCEEDED(deviceContext->QueryInterface(IID_PPV_ARGS(mAnnotation.GetAddressOf()))) && !mAnnotation->GetStatus())
+                {
+                    mAnnotation.Reset();
+                }
+
+                if (mAnnotation)
+                {
+                    mAnnotation->BeginEvent(name);
+                }
+            }
+
+            if (mCallback)
+            {
+                mCallback(mUserContext, &mEvent, true);
+            }
+        }
+
+        void End()
+        {
+            if (mCallback)
+            {
+                mCallback(mUserContext, &mEvent, false);
+            }
+
+            if (mAnnotation)
+            {
+                mAnnotation->EndEvent();
+            }
+        }
+
+        bool mActive;
+        InstrumentationEvent mEvent;
+        InstrumentationCallback mCallback;
+        void* mUserContext;
+        Microsoft::WRL::ComPtr<ID3DUserDefinedAnnotation> mAnnotation;
+
+        // Prevent copying.
+        ScopedInstrumentationEvent(ScopedInstrumentationEvent const&);
+        ScopedInstrumentationEvent& operator= (ScopedInstrumentationEvent const&);
+    };
+}
@@ -41,6 +41,9 @@
 #include "dds.h"
 #include "PlatformHelpers.h"
 
+#include <ppl.h>
+#include <queue>
+
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 
@@ -417,10 +420,48 @@ static DXGI_FORMAT EnsureNotTypeless( DXGI_FORMAT fmt )
 
 
 //--------------------------------------------------------------------------------------
-static HRESULT CaptureTexture( _In_ ID3D11DeviceContext* pContext,
-                               _In_ ID3D11Resource* pSource,
-                               _Inout_ D3D11_TEXTURE2D_DESC& desc,
-                               _Inout_ ComPtr<ID3D11Texture2D>& pStaging )
+// Creates a staging texture matching desc, unless pStaging already is one
+static HRESULT EnsureStagingTexture( _In_ ID3D11Device* d3dDevice,
+                                     _In_ const D3D11_TEXTURE2D_DESC& desc,
+                                     _Inout_ ComPtr<ID3D11Texture2D>& pStaging )
+{
+    if ( pStaging )
+    {
+        D3D11_TEXTURE2D_DESC existing;
+        pStaging->GetDesc( &existing );
+
+        if ( existing.Width == desc.Width
+             && existing.Height == desc.Height
+             && existing.MipLevels == desc.MipLevels
+             && existing.ArraySize == desc.ArraySize
+             && existing.Format == desc.Format
+             && existing.MiscFlags == desc.MiscFlags )
+        {
+            return S_OK;
+        }
+
+        pStaging.Reset();
+    }
+
+    HRESULT hr = d3dDevice->CreateTexture2D( &desc, 0, pStaging.GetAddressOf() );
+    if ( FAILED(hr) )
+        return hr;
+
+    assert( pStaging );
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Records the copy of pSource into a staging texture without waiting for it. An existing
+// pStaging is reused if it matches, and if allowSourceStaging is set a source that is already
+// a readable staging texture is used as it is.
+static HRESULT CopyToStaging( _In_ ID3D11DeviceContext* pContext,
+                              _In_ ID3D11Resource* pSource,
+                              _In_ bool allowSourceStaging,
+                              _Inout_ D3D11_TEXTURE2D_DESC& desc,
+                              _Inout_ ComPtr<ID3D11Texture2D>& pStaging )
 {
     if ( !pContext || !pSource )
         return E_INVALIDARG;
@@ -480,15 +521,13 @@ static HRESULT CaptureTexture( _In_ ID3D11DeviceContext* pContext,
         desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
         desc.Usage = D3D11_USAGE_STAGING;
 
-        hr = d3dDevice->CreateTexture2D( &desc, 0, pStaging.GetAddressOf() );
+        hr = EnsureStagingTexture( d3dDevice.Get(), desc, pStaging );
         if ( FAILED(hr) )
             return hr;
 
-        assert( pStaging );
-
         pContext->CopyResource( pStaging.Get(), pTemp.Get() );
     }
-    else if ( (desc.Usage == D3D11_USAGE_STAGING) && (desc.CPUAccessFlags & D3D11_CPU_ACCESS_READ) )
+    else if ( allowSourceStaging && (desc.Usage == D3D11_USAGE_STAGING) && (desc.CPUAccessFlags & D3D11_CPU_ACCESS_READ) )
     {
         // Handle case where the source is already a staging texture we can use directly
         pStaging = pTexture;
@@ -501,17 +540,32 @@ static HRESULT CaptureTexture( _In_ ID3D11DeviceContext* pContext,
         desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
         desc.Usage = D3D11_USAGE_STAGING;
 
-        hr = d3dDevice->CreateTexture2D( &desc, 0, pStaging.GetAddressOf() );
+        hr = EnsureStagingTexture( d3dDevice.Get(), desc, pStaging );
         if ( FAILED(hr) )
             return hr;
 
-        assert( pStaging );
-
         pContext->CopyResource( pStaging.Get(), pSource );
     }
 
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT CaptureTexture( _In_ ID3D11DeviceContext* pContext,
+                               _In_ ID3D11Resource* pSource,
+                               _Inout_ D3D11_TEXTURE2D_DESC& desc,
+                               _Inout_ ComPtr<ID3D11Texture2D>& pStaging )
+{
+    HRESULT hr = CopyToStaging( pContext, pSource, true, desc, pStaging );
+    if ( FAILED(hr) )
+        return hr;
+
 #if defined(_XBOX_ONE) && defined(_TITLE)
 
+    ComPtr<ID3D11Device> d3dDevice;
+    pContext->GetDevice( d3dDevice.GetAddressOf() );
+
     if ( d3dDevice->GetCreationFlags() & D3D11_CREATE_DEVICE_IMMEDIATE_CONTEXT_FAST_SEMANTICS )
     {
         ComPtr<ID3D11DeviceX> d3dDeviceX;
@@ -539,19 +593,12 @@ static HRESULT CaptureTexture( _In_ ID3D11DeviceContext* pContext,
 
 
 //--------------------------------------------------------------------------------------
-HRESULT DirectX::SaveDDSTextureToFile( _In_ ID3D11DeviceContext* pContext,
-                                       _In_ ID3D11Resource* pSource,
-                                       _In_z_ LPCWSTR fileName )
+// Writes the top-level image, either straight from a mapped staging texture or from a CPU copy
+static HRESULT WriteDDSFile( _In_z_ LPCWSTR fileName,
+                             _In_ const D3D11_TEXTURE2D_DESC& desc,
+                             _In_ const uint8_t* srcPixels,
+                             _In_ size_t srcRowPitch )
 {
-    if ( !fileName )
-        return E_INVALIDARG;
-
-    D3D11_TEXTURE2D_DESC desc = { 0 };
-    ComPtr<ID3D11Texture2D> pStaging;
-    HRESULT hr = CaptureTexture( pContext, pSource, desc, pStaging );
-    if ( FAILED(hr) )
-        return hr;
-
     // Create file
 #if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
     ScopedHandle hFile( safe_handle( CreateFile2( fileName, GENERIC_WRITE, 0, CREATE_ALWAYS, 0 ) ) );
@@ -646,33 +693,31 @@ HRESULT DirectX::SaveDDSTextureToFile( _In_ ID3D11DeviceContext* pContext,
     }
 
     // Setup pixels
-    std::unique_ptr<uint8_t[]> pixels( new (std::nothrow) uint8_t[ slicePitch ] );
-    if (!pixels)
-        return E_OUTOFMEMORY;
+    if ( !srcPixels )
+        return E_POINTER;
 
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    hr = pContext->Map( pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped );
-    if ( FAILED(hr) )
-        return hr;
+    std::unique_ptr<uint8_t[]> pixels;
+    const uint8_t* fileData = srcPixels;
 
-    auto sptr = reinterpret_cast<const uint8_t*>( mapped.pData );
-    if ( !sptr )
+    if ( srcRowPitch != rowPitch )
     {
-        pContext->Unmap( pStaging.Get(), 0 );
-        return E_POINTER;
-    }
+        pixels.reset( new (std::nothrow) uint8_t[ slicePitch ] );
+        if (!pixels)
+            return E_OUTOFMEMORY;
 
-    uint8_t* dptr = pixels.get();
+        auto sptr = srcPixels;
+        uint8_t* dptr = pixels.get();
 
-    size_t msize = std::min<size_t>( rowPitch, mapped.RowPitch );
-    for( size_t h = 0; h < rowCount; ++h )
-    {
-        memcpy_s( dptr, rowPitch, sptr, msize );
-        sptr += mapped.RowPitch;
-        dptr += rowPitch;
-    }
+        size_t msize = std::min<size_t>( rowPitch, srcRowPitch );
+        for( size_t h = 0; h < rowCount; ++h )
+        {
+            memcpy_s( dptr, rowPitch, sptr, msize );
+            sptr += srcRowPitch;
+            dptr += rowPitch;
+        }
 
-    pContext->Unmap( pStaging.Get(), 0 );
+        fileData = pixels.get();
+    }
 
     // Write header & pixels
     DWORD bytesWritten;
@@ -682,7 +727,7 @@ HRESULT DirectX::SaveDDSTextureToFile( _In_ ID3D11DeviceContext* pContext,
     if ( bytesWritten != headerSize )
         return E_FAIL;
 
-    if ( !WriteFile( hFile.get(), pixels.get(), static_cast<DWORD>( slicePitch ), &bytesWritten, 0 ) )
+    if ( !WriteFile( hFile.get(), fileData, static_cast<DWORD>( slicePitch ), &bytesWritten, 0 ) )
         return HRESULT_FROM_WIN32( GetLastError() );
 
     if ( bytesWritten != slicePitch )
@@ -692,20 +737,9 @@ HRESULT DirectX::SaveDDSTextureToFile( _In_ ID3D11DeviceContext* pContext,
 }
 
 //--------------------------------------------------------------------------------------
-#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
-
-namespace DirectX
-{
-extern bool _IsWIC2();
-extern IWICImagingFactory* _GetWIC();
-}
-
-HRESULT DirectX::SaveWICTextureToFile( _In_ ID3D11DeviceContext* pContext,
+HRESULT DirectX::SaveDDSTextureToFile( _In_ ID3D11DeviceContext* pContext,
                                        _In_ ID3D11Resource* pSource,
-                                       _In_ REFGUID guidContainerFormat, 
-                                       _In_z_ LPCWSTR fileName,
-                                       _In_opt_ const GUID* targetFormat,
-                                       _In_opt_ std::function<void(IPropertyBag2*)> setCustomProps )
+                                       _In_z_ LPCWSTR fileName )
 {
     if ( !fileName )
         return E_INVALIDARG;
@@ -716,6 +750,39 @@ HRESULT DirectX::SaveWICTextureToFile( _In_ ID3D11DeviceContext* pContext,
     if ( FAILED(hr) )
         return hr;
 
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    hr = pContext->Map( pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped );
+    if ( FAILED(hr) )
+        return hr;
+
+    hr = WriteDDSFile( fileName, desc, reinterpret_cast<const uint8_t*>( mapped.pData ), mapped.RowPitch );
+
+    pContext->Unmap( pStaging.Get(), 0 );
+
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+
+namespace DirectX
+{
+extern bool _IsWIC2();
+extern IWICImagingFactory* _GetWIC();
+}
+
+// Encodes the top-level image, either straight from a mapped staging texture or from a CPU copy
+static HRESULT WriteWICFile( _In_ const D3D11_TEXTURE2D_DESC& desc,
+                             _In_ const uint8_t* srcPixels,
+                             _In_ size_t srcRowPitch,
+                             _In_ REFGUID guidContainerFormat, 
+                             _In_z_ LPCWSTR fileName,
+                             _In_opt_ const GUID* targetFormat,
+                             _In_opt_ std::function<void(IPropertyBag2*)> setCustomProps )
+{
+    if ( !srcPixels )
+        return E_POINTER;
+
     // Determine source format's WIC equivalent
     WICPixelFormatGUID pfGuid;
     bool sRGB = false;
@@ -770,7 +837,7 @@ HRESULT DirectX::SaveWICTextureToFile( _In_ ID3D11DeviceContext* pContext,
         return E_NOINTERFACE;
 
     ComPtr<IWICStream> stream;
-    hr = pWIC->CreateStream( stream.GetAddressOf() );
+    HRESULT hr = pWIC->CreateStream( stream.GetAddressOf() );
     if ( FAILED(hr) )
         return hr;
 
@@ -942,31 +1009,23 @@ HRESULT DirectX::SaveWICTextureToFile( _In_ ID3D11DeviceContext* pContext,
 #endif
     }
 
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    hr = pContext->Map( pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped );
-    if ( FAILED(hr) )
-        return hr;
+    UINT rowPitch = static_cast<UINT>( srcRowPitch );
+    BYTE* pixels = const_cast<BYTE*>( srcPixels );
 
     if ( memcmp( &targetGuid, &pfGuid, sizeof(WICPixelFormatGUID) ) != 0 )
     {
         // Conversion required to write
         ComPtr<IWICBitmap> source;
         hr = pWIC->CreateBitmapFromMemory( desc.Width, desc.Height, pfGuid,
-                                           mapped.RowPitch, mapped.RowPitch * desc.Height,
-                                           reinterpret_cast<BYTE*>( mapped.pData ), source.GetAddressOf() );
+                                           rowPitch, rowPitch * desc.Height,
+                                           pixels, source.GetAddressOf() );
         if ( FAILED(hr) )
-        {
-            pContext->Unmap( pStaging.Get(), 0 );
             return hr;
-        }
 
         ComPtr<IWICFormatConverter> FC;
         hr = pWIC->CreateFormatConverter( FC.GetAddressOf() );
         if ( FAILED(hr) )
-        {
-            pContext->Unmap( pStaging.Get(), 0 );
             return hr;
-        }
 
         BOOL canConvert = FALSE;
         hr = FC->CanConvert( pfGuid, targetGuid, &canConvert );
@@ -977,29 +1036,21 @@ HRESULT DirectX::SaveWICTextureToFile( _In_ ID3D11DeviceContext* pContext,
 
         hr = FC->Initialize( source.Get(), targetGuid, WICBitmapDitherTypeNone, 0, 0, WICBitmapPaletteTypeCustom );
         if ( FAILED(hr) )
-        {
-            pContext->Unmap( pStaging.Get(), 0 );
             return hr;
-        }
 
         WICRect rect = { 0, 0, static_cast<INT>( desc.Width ), static_cast<INT>( desc.Height ) };
         hr = frame->WriteSource( FC.Get(), &rect );
         if ( FAILED(hr) )
-        {
-            pContext->Unmap( pStaging.Get(), 0 );
             return hr;
-        }
     }
     else
     {
         // No conversion required
-        hr = frame->WritePixels( desc.Height, mapped.RowPitch, mapped.RowPitch * desc.Height, reinterpret_cast<BYTE*>( mapped.pData ) );
+        hr = frame->WritePixels( desc.Height, rowPitch, rowPitch * desc.Height, pixels );
         if ( FAILED(hr) )
             return hr;
     }
 
-    pContext->Unmap( pStaging.Get(), 0 );
-
     hr = frame->Commit();
     if ( FAILED(hr) )
         return hr;
@@ -1011,4 +1062,990 @@ HRESULT DirectX::SaveWICTextureToFile( _In_ ID3D11DeviceContext* pContext,
     return S_OK;
 }
 
+HRESULT DirectX::SaveWICTextureToFile( _In_ ID3D11DeviceContext* pContext,
+                                       _In_ ID3D11Resource* pSource,
+                                       _In_ REFGUID guidContainerFormat, 
+                                       _In_z_ LPCWSTR fileName,
+                                       _In_opt_ const GUID* targetFormat,
+                                       _In_opt_ std::function<void(IPropertyBag2*)> setCustomProps )
+{
+    if ( !fileName )
+        return E_INVALIDARG;
+
+    D3D11_TEXTURE2D_DESC desc = { 0 };
+    ComPtr<ID3D11Texture2D> pStaging;
+    HRESULT hr = CaptureTexture( pContext, pSource, desc, pStaging );
+    if ( FAILED(hr) )
+        return hr;
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    hr = pContext->Map( pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped );
+    if ( FAILED(hr) )
+        return hr;
+
+    hr = WriteWICFile( desc, reinterpret_cast<const uint8_t*>( mapped.pData ), mapped.RowPitch,
+                       guidContainerFormat, fileName, targetFormat, setCustomProps );
+
+    pContext->Unmap( pStaging.Get(), 0 );
+
+    return hr;
+}
+
 #endif // !WINAPI_FAMILY || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+
+
+//--------------------------------------------------------------------------------------
+// Asynchronous capture
+//--------------------------------------------------------------------------------------
+
+// Internal AsyncScreenGrab implementation class.
+class AsyncScreenGrab::Impl
+{
+public:
+    // What to write once a capture has been read back.
+    struct Target
+    {
+        Target()
+          : wic(false),
+            hasTargetFormat(false)
+        {
+            memset( &containerFormat, 0, sizeof(GUID) );
+            memset( &targetFormat, 0, sizeof(GUID) );
+        }
+
+        std::wstring fileName;
+        bool wic;
+        GUID containerFormat;
+        GUID targetFormat;
+        bool hasTargetFormat;
+        std::function<void(IPropertyBag2*)> setCustomProps;
+        Callback callback;
+    };
+
+    // One staging texture in the ring, and the capture it currently holds.
+    struct Slot
+    {
+        Slot()
+#if defined(_XBOX_ONE) && defined(_TITLE)
+          : fence(0)
+#endif
+        {
+            memset( &desc, 0, sizeof(desc) );
+        }
+
+        ComPtr<ID3D11Texture2D> staging;
+        D3D11_TEXTURE2D_DESC desc;
+        Target target;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+        UINT64 fence;
+#endif
+    };
+
+    // A read back image waiting for the background thread.
+    struct Job
+    {
+        Job()
+          : rowPitch(0),
+            result(S_OK)
+        {
+            memset( &desc, 0, sizeof(desc) );
+        }
+
+        D3D11_TEXTURE2D_DESC desc;
+        std::unique_ptr<uint8_t[]> pixels;
+        size_t rowPitch;
+        HRESULT result;
+        Target target;
+    };
+
+    Impl(_In_ ID3D11Device* device, size_t ringSize);
+    ~Impl();
+
+    HRESULT Capture(_In_ ID3D11DeviceContext* pContext, _In_ ID3D11Resource* pSource, Target const& target);
+    void ReadBack(_In_ ID3D11DeviceContext* pContext, bool wait);
+
+    ComPtr<ID3D11Device> mDevice;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    // Only set for devices with fast semantics, where Map does not wait for the GPU.
+    ComPtr<ID3D11DeviceX> mDeviceX;
+#endif
+
+    // Captures are written at mHead and read back from mTail, both counted modulo the ring size.
+    std::vector<Slot> mSlots;
+    size_t mHead;
+    size_t mTail;
+
+    volatile LONG mPendingCount;
+
+    Concurrency::task_group mWriters;
+
+private:
+    void Write(Job& job);
+};
+
+
+AsyncScreenGrab::Impl::Impl(_In_ ID3D11Device* device, size_t ringSize)
+  : mDevice(device),
+    mSlots(ringSize),
+    mHead(0),
+    mTail(0),
+    mPendingCount(0)
+{
+    if (!device)
+        throw std::exception("Direct3D device cannot be null");
+
+    if (!ringSize)
+        throw std::exception("AsyncScreenGrab needs at least one staging texture");
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    if (device->GetCreationFlags() & D3D11_CREATE_DEVICE_IMMEDIATE_CONTEXT_FAST_SEMANTICS)
+    {
+        ThrowIfFailed(mDevice.As(&mDeviceX));
+    }
+#endif
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+    // Create the factory now rather than racing to do so on the background threads.
+    (void)_GetWIC();
+#endif
+}
+
+
+// Captures still on the GPU are dropped, since they cannot be read back without a context.
+AsyncScreenGrab::Impl::~Impl()
+{
+    mWriters.wait();
+}
+
+
+// Records the copy into the next free staging texture.
+HRESULT AsyncScreenGrab::Impl::Capture(_In_ ID3D11DeviceContext* pContext, _In_ ID3D11Resource* pSource, Target const& target)
+{
+    if ( !pContext || !pSource || target.fileName.empty() )
+        return E_INVALIDARG;
+
+    if ( mHead - mTail >= mSlots.size() )
+        return S_FALSE;
+
+    Slot& slot = mSlots[ mHead % mSlots.size() ];
+
+    HRESULT hr = CopyToStaging( pContext, pSource, false, slot.desc, slot.staging );
+    if ( FAILED(hr) )
+        return hr;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    if ( mDeviceX )
+    {
+        ComPtr<ID3D11DeviceContextX> d3dContextX;
+        hr = pContext->QueryInterface( __uuidof(ID3D11DeviceContextX), reinterpret_cast<void**>( d3dContextX.GetAddressOf() ) );
+        if ( FAILED(hr) )
+            return hr;
+
+        slot.fence = d3dContextX->InsertFence(0);
+    }
+#endif
+
+    slot.target = target;
+
+    mHead++;
+    InterlockedIncrement( &mPendingCount );
+
+    return S_OK;
+}
+
+
+// Maps captures in the order they were made, stopping at the first one the GPU has not finished unless wait is set.
+void AsyncScreenGrab::Impl::ReadBack(_In_ ID3D11DeviceContext* pContext, bool wait)
+{
+    while ( mTail < mHead )
+    {
+        Slot& slot = mSlots[ mTail % mSlots.size() ];
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+        if ( mDeviceX )
+        {
+            if ( !wait && mDeviceX->IsFencePending( slot.fence ) )
+                break;
+
+            while ( mDeviceX->IsFencePending( slot.fence ) )
+            {
+                SwitchToThread();
+            }
+        }
+#endif
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = pContext->Map( slot.staging.Get(), 0, D3D11_MAP_READ, (wait) ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped );
+        if ( hr == DXGI_ERROR_WAS_STILL_DRAWING )
+        {
+            // Later captures cannot have finished either
+            break;
+        }
+
+        mTail++;
+
+        std::shared_ptr<Job> job( new Job() );
+
+        job->desc = slot.desc;
+        job->target = slot.target;
+
+        // Release anything captured by the callbacks as soon as the job is done with them.
+        slot.target = Target();
+
+        if ( SUCCEEDED(hr) )
+        {
+            size_t slicePitch, rowCount;
+            GetSurfaceInfo( slot.desc.Width, slot.desc.Height, slot.desc.Format, &slicePitch, &job->rowPitch, &rowCount );
+
+            job->pixels.reset( new (std::nothrow) uint8_t[ slicePitch ] );
+
+            auto sptr = reinterpret_cast<const uint8_t*>( mapped.pData );
+
+            if ( !job->pixels )
+            {
+                hr = E_OUTOFMEMORY;
+            }
+            else if ( !sptr )
+            {
+                hr = E_POINTER;
+            }
+            else
+            {
+                uint8_t* dptr = job->pixels.get();
+
+                size_t msize = std::min<size_t>( job->rowPitch, mapped.RowPitch );
+                for( size_t h = 0; h < rowCount; ++h )
+                {
+                    memcpy_s( dptr, job->rowPitch, sptr, msize );
+                    sptr += mapped.RowPitch;
+                    dptr += job->rowPitch;
+                }
+            }
+
+            pContext->Unmap( slot.staging.Get(), 0 );
+        }
+
+        // Failures are also handed on, so the callback reports them from the background thread.
+        job->result = hr;
+
+        mWriters.run([this, job]()
+        {
+            Write(*job);
+        });
+    }
+}
+
+
+// Writes the file on the calling (background) thread.
+void AsyncScreenGrab::Impl::Write(Job& job)
+{
+    HRESULT hr = job.result;
+
+    if ( SUCCEEDED(hr) )
+    {
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+        if ( job.target.wic )
+        {
+            // WIC needs COM, and this thread belongs to the PPL scheduler rather than the application.
+            HRESULT hrCOM = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+
+            hr = WriteWICFile( job.desc, job.pixels.get(), job.rowPitch,
+                               job.target.containerFormat, job.target.fileName.c_str(),
+                               (job.target.hasTargetFormat) ? &job.target.targetFormat : nullptr,
+                               job.target.setCustomProps );
+
+            if ( SUCCEEDED(hrCOM) )
+            {
+                CoUninitialize();
+            }
+        }
+        else
+#endif
+        {
+            hr = WriteDDSFile( job.target.fileName.c_str(), job.desc, job.pixels.get(), job.rowPitch );
+        }
+    }
+
+    job.pixels.reset();
+
+    if ( job.target.callback )
+    {
+        job.target.callback( hr, job.target.fileName.c_str() );
+    }
+
+    InterlockedDecrement( &mPendingCount );
+}
+
+
+// Public constructor.
+AsyncScreenGrab::AsyncScreenGrab(_In_ ID3D11Device* device, size_t ringSize)
+  : pImpl(new Impl(device, ringSize))
+{
+}
+
+
+// Move constructor.
+AsyncScreenGrab::AsyncScreenGrab(AsyncScreenGrab&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+AsyncScreenGrab& AsyncScreenGrab::operator= (AsyncScreenGrab&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+AsyncScreenGrab::~AsyncScreenGrab()
+{
+}
+
+
+_Use_decl_annotations_
+HRESULT AsyncScreenGrab::CaptureDDS( ID3D11DeviceContext* pContext,
+                                     ID3D11Resource* pSource,
+                                     LPCWSTR fileName,
+                                     Callback callback )
+{
+    if ( !fileName )
+        return E_INVALIDARG;
+
+    Impl::Target target;
+    target.fileName = fileName;
+    target.callback = callback;
+
+    return pImpl->Capture( pContext, pSource, target );
+}
+
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+
+_Use_decl_annotations_
+HRESULT AsyncScreenGrab::CaptureWIC( ID3D11DeviceContext* pContext,
+                                     ID3D11Resource* pSource,
+                                     REFGUID guidContainerFormat,
+                                     LPCWSTR fileName,
+                                     const GUID* targetFormat,
+                                     std::function<void(IPropertyBag2*)> setCustomProps,
+                                     Callback callback )
+{
+    if ( !fileName )
+        return E_INVALIDARG;
+
+    Impl::Target target;
+    target.fileName = fileName;
+    target.wic = true;
+    target.containerFormat = guidContainerFormat;
+    target.setCustomProps = setCustomProps;
+    target.callback = callback;
+
+    if ( targetFormat )
+    {
+        target.targetFormat = *targetFormat;
+        target.hasTargetFormat = true;
+    }
+
+    return pImpl->Capture( pContext, pSource, target );
+}
+
+#endif
+
+
+_Use_decl_annotations_
+void AsyncScreenGrab::Update( ID3D11DeviceContext* pContext )
+{
+    if ( !pContext )
+        throw std::exception("Direct3D device context cannot be null");
+
+    pImpl->ReadBack( pContext, false );
+}
+
+
+_Use_decl_annotations_
+void AsyncScreenGrab::Flush( ID3D11DeviceContext* pContext )
+{
+    if ( !pContext )
+        throw std::exception("Direct3D device context cannot be null");
+
+    pImpl->ReadBack( pContext, true );
+
+    pImpl->mWriters.wait();
+}
+
+
+size_t AsyncScreenGrab::GetPendingCount() const
+{
+    return static_cast<size_t>( pImpl->mPendingCount );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Continuous capture
+//--------------------------------------------------------------------------------------
+
+// Inserts the frame number before the extension, so frame.png becomes frame00042.png.
+static std::wstring MakeSequenceName( std::wstring const& fileName, uint32_t frame )
+{
+    wchar_t number[16];
+    swprintf_s( number, L"%05u", frame );
+
+    std::wstring name( fileName );
+
+    size_t dot = name.find_last_of( L'.' );
+    size_t separator = name.find_last_of( L"\\/" );
+
+    if ( dot == std::wstring::npos || ( separator != std::wstring::npos && dot < separator ) )
+    {
+        name += number;
+    }
+    else
+    {
+        name.insert( dot, number );
+    }
+
+    return name;
+}
+
+
+// Internal ScreenCaptureSession implementation class.
+class ScreenCaptureSession::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device,
+         UINT width,
+         UINT height,
+         DXGI_FORMAT format,
+         SCREEN_CAPTURE_OUTPUT output,
+         _In_z_ LPCWSTR fileName,
+         _In_opt_ const GUID* guidContainerFormat,
+         size_t ringSize,
+         size_t writerCount);
+
+    ~Impl();
+
+    HRESULT Capture(_In_ ID3D11DeviceContext* pContext, _In_ ID3D11Resource* pSource);
+    void ReadBack(_In_ ID3D11DeviceContext* pContext, bool wait);
+
+    ComPtr<ID3D11Device> mDevice;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    // Only set for devices with fast semantics, where Map does not wait for the GPU.
+    ComPtr<ID3D11DeviceX> mDeviceX;
+    std::vector<UINT64> mFences;
+#endif
+
+    // Output settings, fixed for the life of the session.
+    D3D11_TEXTURE2D_DESC mDesc;
+    SCREEN_CAPTURE_OUTPUT mOutput;
+    std::wstring mFileName;
+    GUID mContainerFormat;
+    ScopedHandle mRawFile;
+    size_t mFrameSize;
+    size_t mRowPitch;
+    size_t mRowCount;
+
+    // Frames are copied in at mHead and read back from mTail, both counted modulo the ring size.
+    std::vector<ComPtr<ID3D11Texture2D>> mStaging;
+    std::vector<uint32_t> mStagingFrame;
+    ComPtr<ID3D11Texture2D> mResolve;
+    size_t mHead;
+    size_t mTail;
+
+    uint32_t mFrameCount;
+    size_t mDroppedCount;
+    volatile LONG mWrittenCount;
+    volatile LONG mWriteStatus;
+
+    // Allocated up front, so the writers can use them without the lock.
+    std::vector<std::unique_ptr<uint8_t[]>> mBuffers;
+    size_t mMaxWorkers;
+
+    // Guards everything below.
+    std::mutex mMutex;
+
+    std::vector<size_t> mFreeBuffers;
+    std::queue<std::pair<size_t, uint32_t>> mQueue;
+    size_t mWorkerCount;
+
+    Concurrency::task_group mWriters;
+
+private:
+    void WorkerLoop();
+    HRESULT WriteFrame(_In_ const uint8_t* pixels, uint32_t frame);
+};
+
+
+ScreenCaptureSession::Impl::Impl(_In_ ID3D11Device* device,
+                                 UINT width,
+                                 UINT height,
+                                 DXGI_FORMAT format,
+                                 SCREEN_CAPTURE_OUTPUT output,
+                                 _In_z_ LPCWSTR fileName,
+                                 _In_opt_ const GUID* guidContainerFormat,
+                                 size_t ringSize,
+                                 size_t writerCount)
+  : mDevice(device),
+    mDesc(CD3D11_TEXTURE2D_DESC(format, width, height, 1, 1, 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ)),
+    mOutput(output),
+    mFrameSize(0),
+    mRowPitch(0),
+    mRowCount(0),
+    mStaging(ringSize),
+    mStagingFrame(ringSize),
+    mHead(0),
+    mTail(0),
+    mFrameCount(0),
+    mDroppedCount(0),
+    mWrittenCount(0),
+    mWriteStatus(S_OK),
+    mMaxWorkers((output == SCREEN_CAPTURE_RAW) ? 1 : writerCount),
+    mWorkerCount(0)
+{
+    if (!device)
+        throw std::exception("Direct3D device cannot be null");
+
+    if (!fileName)
+        throw std::exception("File name cannot be null");
+
+    if (!width || !height)
+        throw std::exception("Invalid capture size");
+
+    if (!ringSize || !writerCount)
+        throw std::exception("ScreenCaptureSession needs at least one staging texture and writer");
+
+    GetSurfaceInfo( width, height, format, &mFrameSize, &mRowPitch, &mRowCount );
+
+    if (!mFrameSize)
+        throw std::exception("ScreenCaptureSession does not support this format");
+
+    mFileName = fileName;
+    memset( &mContainerFormat, 0, sizeof(GUID) );
+
+    switch (output)
+    {
+    case SCREEN_CAPTURE_RAW:
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+        mRawFile.reset( safe_handle( CreateFile2( fileName, GENERIC_WRITE, 0, CREATE_ALWAYS, nullptr ) ) );
+#else
+        mRawFile.reset( safe_handle( CreateFileW( fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) ) );
+#endif
+        if (!mRawFile)
+            throw std::exception("CreateFile");
+        break;
+
+    case SCREEN_CAPTURE_DDS_SEQUENCE:
+        break;
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+    case SCREEN_CAPTURE_WIC_SEQUENCE:
+        mContainerFormat = (guidContainerFormat) ? *guidContainerFormat : GUID_ContainerFormatPng;
+
+        // Create the factory now rather than racing to do so on the writers.
+        if (!_GetWIC())
+            throw std::exception("WIC imaging factory not available");
+        break;
+#endif
+
+    default:
+        throw std::exception("Unknown ScreenCaptureSession output");
+    }
+
+    for (auto it = mStaging.begin(); it != mStaging.end(); ++it)
+    {
+        ThrowIfFailed(
+            device->CreateTexture2D(&mDesc, nullptr, it->GetAddressOf())
+        );
+
+        SetDebugObjectName(it->Get(), "ScreenCaptureSession");
+    }
+
+    // Enough frame buffers for a full ring plus one being written by each writer.
+    size_t bufferCount = ringSize + mMaxWorkers;
+
+    mBuffers.resize(bufferCount);
+
+    for (size_t i = 0; i < bufferCount; ++i)
+    {
+        mBuffers[i].reset(new uint8_t[mFrameSize]);
+        mFreeBuffers.push_back(i);
+    }
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    mFences.resize(ringSize);
+
+    if (device->GetCreationFlags() & D3D11_CREATE_DEVICE_IMMEDIATE_CONTEXT_FAST_SEMANTICS)
+    {
+        ThrowIfFailed(mDevice.As(&mDeviceX));
+    }
+#endif
+}
+
+
+// Frames still on the GPU are dropped, since they cannot be read back without a context.
+ScreenCaptureSession::Impl::~Impl()
+{
+    mWriters.wait();
+}
+
+
+// Reads back what it can, then records the copy of this frame into the next staging texture.
+HRESULT ScreenCaptureSession::Impl::Capture(_In_ ID3D11DeviceContext* pContext, _In_ ID3D11Resource* pSource)
+{
+    if ( !pContext || !pSource )
+        return E_INVALIDARG;
+
+    ReadBack( pContext, false );
+
+    D3D11_RESOURCE_DIMENSION resType = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+    pSource->GetType( &resType );
+
+    if ( resType != D3D11_RESOURCE_DIMENSION_TEXTURE2D )
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+
+    ComPtr<ID3D11Texture2D> pTexture;
+    HRESULT hr = pSource->QueryInterface( __uuidof(ID3D11Texture2D), reinterpret_cast<void**>( pTexture.GetAddressOf() ) );
+    if ( FAILED(hr) )
+        return hr;
+
+    D3D11_TEXTURE2D_DESC desc;
+    pTexture->GetDesc( &desc );
+
+    if ( desc.Width != mDesc.Width
+         || desc.Height != mDesc.Height
+         || ( desc.Format != mDesc.Format && EnsureNotTypeless( desc.Format ) != mDesc.Format ) )
+    {
+        return E_INVALIDARG;
+    }
+
+    uint32_t frame = mFrameCount++;
+
+    if ( mHead - mTail >= mStaging.size() )
+    {
+        mDroppedCount++;
+        return S_FALSE;
+    }
+
+    size_t slot = mHead % mStaging.size();
+
+    if ( desc.SampleDesc.Count > 1 )
+    {
+        // MSAA content must be resolved before being copied to a staging texture
+        if ( !mResolve )
+        {
+            UINT support = 0;
+            hr = mDevice->CheckFormatSupport( mDesc.Format, &support );
+            if ( FAILED(hr) )
+                return hr;
+
+            if ( !(support & D3D11_FORMAT_SUPPORT_MULTISAMPLE_RESOLVE) )
+                return E_FAIL;
+
+            CD3D11_TEXTURE2D_DESC resolveDesc( desc.Format, desc.Width, desc.Height, 1, 1, 0 );
+
+            hr = mDevice->CreateTexture2D( &resolveDesc, nullptr, mResolve.GetAddressOf() );
+            if ( FAILED(hr) )
+                return hr;
+        }
+
+        pContext->ResolveSubresource( mResolve.Get(), 0, pSource, 0, mDesc.Format );
+        pContext->CopySubresourceRegion( mStaging[ slot ].Get(), 0, 0, 0, 0, mResolve.Get(), 0, nullptr );
+    }
+    else
+    {
+        pContext->CopySubresourceRegion( mStaging[ slot ].Get(), 0, 0, 0, 0, pSource, 0, nullptr );
+    }
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    if ( mDeviceX )
+    {
+        ComPtr<ID3D11DeviceContextX> d3dContextX;
+        hr = pContext->QueryInterface( __uuidof(ID3D11DeviceContextX), reinterpret_cast<void**>( d3dContextX.GetAddressOf() ) );
+        if ( FAILED(hr) )
+            return hr;
+
+        mFences[ slot ] = d3dContextX->InsertFence(0);
+    }
+#endif
+
+    mStagingFrame[ slot ] = frame;
+    mHead++;
+
+    return S_OK;
+}
+
+
+// Maps frames in order, stopping at the first one the GPU has not finished (unless wait is set),
+// or when every frame buffer is still queued for writing.
+void ScreenCaptureSession::Impl::ReadBack(_In_ ID3D11DeviceContext* pContext, bool wait)
+{
+    while ( mTail < mHead )
+    {
+        size_t slot = mTail % mStaging.size();
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+        if ( mDeviceX )
+        {
+            if ( !wait && mDeviceX->IsFencePending( mFences[ slot ] ) )
+                break;
+
+            while ( mDeviceX->IsFencePending( mFences[ slot ] ) )
+            {
+                SwitchToThread();
+            }
+        }
+#endif
+
+        size_t buffer;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            if ( mFreeBuffers.empty() )
+                break;
+
+            buffer = mFreeBuffers.back();
+            mFreeBuffers.pop_back();
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = pContext->Map( mStaging[ slot ].Get(), 0, D3D11_MAP_READ, (wait) ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped );
+
+        if ( FAILED(hr) )
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                mFreeBuffers.push_back( buffer );
+            }
+
+            if ( hr == DXGI_ERROR_WAS_STILL_DRAWING )
+            {
+                // Later frames cannot have finished either
+                break;
+            }
+
+            InterlockedCompareExchange( &mWriteStatus, hr, S_OK );
+            mDroppedCount++;
+            mTail++;
+            continue;
+        }
+
+        auto sptr = reinterpret_cast<const uint8_t*>( mapped.pData );
+        uint8_t* dptr = mBuffers[ buffer ].get();
+
+        size_t msize = std::min<size_t>( mRowPitch, mapped.RowPitch );
+        for( size_t h = 0; h < mRowCount; ++h )
+        {
+            memcpy_s( dptr, mRowPitch, sptr, msize );
+            sptr += mapped.RowPitch;
+            dptr += mRowPitch;
+        }
+
+        pContext->Unmap( mStaging[ slot ].Get(), 0 );
+
+        uint32_t frame = mStagingFrame[ slot ];
+        mTail++;
+
+        bool startWorker = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mQueue.push( std::make_pair( buffer, frame ) );
+
+            if ( mWorkerCount < mMaxWorkers )
+            {
+                mWorkerCount++;
+                startWorker = true;
+            }
+        }
+
+        if ( startWorker )
+        {
+            mWriters.run([this]()
+            {
+                WorkerLoop();
+            });
+        }
+    }
+}
+
+
+// Each writer keeps taking the oldest queued frame until the queue is empty.
+void ScreenCaptureSession::Impl::WorkerLoop()
+{
+    // WIC needs COM, and this thread belongs to the PPL scheduler rather than the application.
+    HRESULT hrCOM = E_FAIL;
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+    if ( mOutput == SCREEN_CAPTURE_WIC_SEQUENCE )
+    {
+        hrCOM = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+    }
+#endif
+
+    for (;;)
+    {
+        std::pair<size_t, uint32_t> item;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            if ( mQueue.empty() )
+            {
+                mWorkerCount--;
+                break;
+            }
+
+            item = mQueue.front();
+            mQueue.pop();
+        }
+
+        HRESULT hr = WriteFrame( mBuffers[ item.first ].get(), item.second );
+
+        if ( SUCCEEDED(hr) )
+        {
+            InterlockedIncrement( &mWrittenCount );
+        }
+        else
+        {
+            InterlockedCompareExchange( &mWriteStatus, hr, S_OK );
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mFreeBuffers.push_back( item.first );
+        }
+    }
+
+    if ( SUCCEEDED(hrCOM) )
+    {
+        CoUninitialize();
+    }
+}
+
+
+HRESULT ScreenCaptureSession::Impl::WriteFrame(_In_ const uint8_t* pixels, uint32_t frame)
+{
+    switch ( mOutput )
+    {
+    case SCREEN_CAPTURE_RAW:
+        {
+            DWORD bytesWritten;
+            if ( !WriteFile( mRawFile.get(), pixels, static_cast<DWORD>( mFrameSize ), &bytesWritten, nullptr ) )
+                return HRESULT_FROM_WIN32( GetLastError() );
+
+            if ( bytesWritten != mFrameSize )
+                return E_FAIL;
+
+            return S_OK;
+        }
+
+    case SCREEN_CAPTURE_DDS_SEQUENCE:
+        return WriteDDSFile( MakeSequenceName( mFileName, frame ).c_str(), mDesc, pixels, mRowPitch );
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+    case SCREEN_CAPTURE_WIC_SEQUENCE:
+        return WriteWICFile( mDesc, pixels, mRowPitch, mContainerFormat, MakeSequenceName( mFileName, frame ).c_str(), nullptr, nullptr );
+#endif
+
+    default:
+        return E_UNEXPECTED;
+    }
+}
+
+
+// Public constructor.
+_Use_decl_annotations_
+ScreenCaptureSession::ScreenCaptureSession(ID3D11Device* device,
+                                           UINT width,
+                                           UINT height,
+                                           DXGI_FORMAT format,
+                                           SCREEN_CAPTURE_OUTPUT output,
+                                           LPCWSTR fileName,
+                                           const GUID* guidContainerFormat,
+                                           size_t ringSize,
+                                           size_t writerCount)
+  : pImpl(new Impl(device, width, height, format, output, fileName, guidContainerFormat, ringSize, writerCount))
+{
+}
+
+
+// Move constructor.
+ScreenCaptureSession::ScreenCaptureSession(ScreenCaptureSession&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+ScreenCaptureSession& ScreenCaptureSession::operator= (ScreenCaptureSession&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+ScreenCaptureSession::~ScreenCaptureSession()
+{
+}
+
+
+_Use_decl_annotations_
+HRESULT ScreenCaptureSession::CaptureFrame( ID3D11DeviceContext* pContext, ID3D11Resource* pSource )
+{
+    return pImpl->Capture( pContext, pSource );
+}
+
+
+_Use_decl_annotations_
+void ScreenCaptureSession::Flush( ID3D11DeviceContext* pContext )
+{
+    if ( !pContext )
+        throw std::exception("Direct3D device context cannot be null");
+
+    for (;;)
+    {
+        pImpl->ReadBack( pContext, true );
+
+        if ( pImpl->mTail == pImpl->mHead )
+            break;
+
+        // Out of frame buffers, so let the writers catch up
+        pImpl->mWriters.wait();
+    }
+
+    pImpl->mWriters.wait();
+}
+
+
+size_t ScreenCaptureSession::GetFrameCount() const
+{
+    return pImpl->mFrameCount;
+}
+
+
+size_t ScreenCaptureSession::GetDroppedFrameCount() const
+{
+    return pImpl->mDroppedCount;
+}
+
+
+size_t ScreenCaptureSession::GetWrittenFrameCount() const
+{
+    return static_cast<size_t>( pImpl->mWrittenCount );
+}
+
+
+HRESULT ScreenCaptureSession::GetWriteStatus() const
+{
+    return static_cast<HRESULT>( pImpl->mWriteStatus );
+}
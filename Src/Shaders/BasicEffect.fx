@@ -12,6 +12,12 @@
 Texture2D<float4> Texture : register(t0);
 sampler Sampler : register(s0);
 
+// Point lights from LightGrid, three float4 each: position and range, diffuse color, specular color.
+Buffer<float4> TiledLights : register(t1);
+
+// For each 16x16 pixel tile, a count followed by the indices of the lights that touch it.
+Buffer<uint> TileLightIndices : register(t2);
+
 
 cbuffer Parameters : register(b0)
 {
@@ -27,11 +33,21 @@ cbuffer Parameters : register(b0)
     float3 EyePosition              : packoffset(c12);
 
     float3 FogColor                 : packoffset(c13);
-    float4 FogVector                : packoffset(c14);
 
-    float4x4 World                  : packoffset(c15);
-    float3x3 WorldInverseTranspose  : packoffset(c19);
-    float4x4 WorldViewProj          : packoffset(c22);
+    uint   TileCountX               : packoffset(c14.x);
+    uint   TileLightStride          : packoffset(c14.y);
+};
+
+
+// Values derived from the world matrix, kept in their own buffer so that drawing many objects
+// with the same view, lights, and material only updates these.
+cbuffer ObjectParameters : register(b1)
+{
+    float4 FogVector                : packoffset(c0);
+
+    float4x4 World                  : packoffset(c1);
+    float3x3 WorldInverseTranspose  : packoffset(c5);
+    float4x4 WorldViewProj          : packoffset(c8);
 };
 
 
@@ -438,3 +454,277 @@ float4 PSBasicPixelLightingTx(PSInputPixelLightingTx pin) : SV_Target0
 
     return color;
 }
+
+
+// Adds the point lights listed for this pixel's tile to the directional lights.
+ColorPair ComputeTiledLights(float3 positionWS, float3 eyeVector, float3 worldNormal, float2 pixel)
+{
+    ColorPair result = ComputeLights(eyeVector, worldNormal, 3);
+
+    uint2 tile = uint2(pixel) / 16;
+    uint first = (tile.y * TileCountX + tile.x) * TileLightStride;
+    uint count = TileLightIndices[first];
+
+    float3 diffuse = 0;
+    float3 specular = 0;
+
+    for (uint i = 0; i < count; i++)
+    {
+        uint light = TileLightIndices[first + 1 + i] * 3;
+
+        float4 positionRange = TiledLights[light];
+
+        float3 toLight = positionRange.xyz - positionWS;
+        float distance = length(toLight);
+        float3 lightVector = toLight / max(distance, 0.0001);
+
+        // Smooth falloff that reaches zero at the light's range, so culling by range is exact.
+        float attenuation = saturate(1 - distance / positionRange.w);
+        attenuation *= attenuation;
+
+        float dotL = dot(lightVector, worldNormal);
+        float dotH = dot(normalize(eyeVector + lightVector), worldNormal);
+
+        float zeroL = step(0, dotL);
+
+        diffuse += TiledLights[light + 1].rgb * (zeroL * dotL * attenuation);
+        specular += TiledLights[light + 2].rgb * (pow(max(dotH, 0) * zeroL, SpecularPower) * attenuation);
+    }
+
+    result.Diffuse += diffuse * DiffuseColor.rgb;
+    result.Specular += specular * SpecularColor;
+
+    return result;
+}
+
+
+// Pixel shader: pixel lighting + tiled point lights.
+float4 PSBasicPixelLightingTiled(PSInputPixelLightingTiled pin) : SV_Target0
+{
+    float4 color = pin.Diffuse;
+
+    float3 eyeVector = normalize(EyePosition - pin.PositionWS.xyz);
+    float3 worldNormal = normalize(pin.NormalWS);
+
+    ColorPair lightResult = ComputeTiledLights(pin.PositionWS.xyz, eyeVector, worldNormal, pin.PositionPS.xy);
+
+    color.rgb *= lightResult.Diffuse;
+
+    AddSpecular(color, lightResult.Specular);
+    ApplyFog(color, pin.PositionWS.w);
+
+    return color;
+}
+
+
+// Pixel shader: pixel lighting + texture + tiled point lights.
+float4 PSBasicPixelLightingTxTiled(PSInputPixelLightingTxTiled pin) : SV_Target0
+{
+    float4 color = Texture.Sample(Sampler, pin.TexCoord) * pin.Diffuse;
+
+    float3 eyeVector = normalize(EyePosition - pin.PositionWS.xyz);
+    float3 worldNormal = normalize(pin.NormalWS);
+
+    ColorPair lightResult = ComputeTiledLights(pin.PositionWS.xyz, eyeVector, worldNormal, pin.PositionPS.xy);
+
+    color.rgb *= lightResult.Diffuse;
+
+    AddSpecular(color, lightResult.Specular);
+    ApplyFog(color, pin.PositionWS.w);
+
+    return color;
+}
+
+
+// Instanced vertex shaders apply each instance's transform, then run the matching shader above.
+
+// Vertex shader: basic, instanced.
+VSOutput VSBasicInst(VSInput vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasic(vin);
+}
+
+
+// Vertex shader: no fog, instanced.
+VSOutputNoFog VSBasicNoFogInst(VSInput vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasicNoFog(vin);
+}
+
+
+// Vertex shader: vertex color, instanced.
+VSOutput VSBasicVcInst(VSInputVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasicVc(vin);
+}
+
+
+// Vertex shader: vertex color, no fog, instanced.
+VSOutputNoFog VSBasicVcNoFogInst(VSInputVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasicVcNoFog(vin);
+}
+
+
+// Vertex shader: texture, instanced.
+VSOutputTx VSBasicTxInst(VSInputTx vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasicTx(vin);
+}
+
+
+// Vertex shader: texture, no fog, instanced.
+VSOutputTxNoFog VSBasicTxNoFogInst(VSInputTx vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasicTxNoFog(vin);
+}
+
+
+// Vertex shader: texture + vertex color, instanced.
+VSOutputTx VSBasicTxVcInst(VSInputTxVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasicTxVc(vin);
+}
+
+
+// Vertex shader: texture + vertex color, no fog, instanced.
+VSOutputTxNoFog VSBasicTxVcNoFogInst(VSInputTxVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+
+    return VSBasicTxVcNoFog(vin);
+}
+
+
+// Vertex shader: vertex lighting, instanced.
+VSOutput VSBasicVertexLightingInst(VSInputNm vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicVertexLighting(vin);
+}
+
+
+// Vertex shader: vertex lighting + vertex color, instanced.
+VSOutput VSBasicVertexLightingVcInst(VSInputNmVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicVertexLightingVc(vin);
+}
+
+
+// Vertex shader: vertex lighting + texture, instanced.
+VSOutputTx VSBasicVertexLightingTxInst(VSInputNmTx vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicVertexLightingTx(vin);
+}
+
+
+// Vertex shader: vertex lighting + texture + vertex color, instanced.
+VSOutputTx VSBasicVertexLightingTxVcInst(VSInputNmTxVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicVertexLightingTxVc(vin);
+}
+
+
+// Vertex shader: one light, instanced.
+VSOutput VSBasicOneLightInst(VSInputNm vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicOneLight(vin);
+}
+
+
+// Vertex shader: one light + vertex color, instanced.
+VSOutput VSBasicOneLightVcInst(VSInputNmVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicOneLightVc(vin);
+}
+
+
+// Vertex shader: one light + texture, instanced.
+VSOutputTx VSBasicOneLightTxInst(VSInputNmTx vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicOneLightTx(vin);
+}
+
+
+// Vertex shader: one light + texture + vertex color, instanced.
+VSOutputTx VSBasicOneLightTxVcInst(VSInputNmTxVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicOneLightTxVc(vin);
+}
+
+
+// Vertex shader: pixel lighting, instanced.
+VSOutputPixelLighting VSBasicPixelLightingInst(VSInputNm vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicPixelLighting(vin);
+}
+
+
+// Vertex shader: pixel lighting + vertex color, instanced.
+VSOutputPixelLighting VSBasicPixelLightingVcInst(VSInputNmVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicPixelLightingVc(vin);
+}
+
+
+// Vertex shader: pixel lighting + texture, instanced.
+VSOutputPixelLightingTx VSBasicPixelLightingTxInst(VSInputNmTx vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicPixelLightingTx(vin);
+}
+
+
+// Vertex shader: pixel lighting + texture + vertex color, instanced.
+VSOutputPixelLightingTx VSBasicPixelLightingTxVcInst(VSInputNmTxVc vin, VSInputInstance inst)
+{
+    vin.Position = ApplyInstanceTransform(vin.Position, inst.Transform);
+    vin.Normal = ApplyInstanceTransformNormal(vin.Normal, inst.Transform);
+
+    return VSBasicPixelLightingTxVc(vin);
+}
@@ -53,6 +53,30 @@ call :CompileShader%1 BasicEffect vs VSBasicPixelLightingVc
 call :CompileShader%1 BasicEffect vs VSBasicPixelLightingTx
 call :CompileShader%1 BasicEffect vs VSBasicPixelLightingTxVc
 
+call :CompileShader93%1 BasicEffect vs VSBasicInst
+call :CompileShader93%1 BasicEffect vs VSBasicNoFogInst
+call :CompileShader93%1 BasicEffect vs VSBasicVcInst
+call :CompileShader93%1 BasicEffect vs VSBasicVcNoFogInst
+call :CompileShader93%1 BasicEffect vs VSBasicTxInst
+call :CompileShader93%1 BasicEffect vs VSBasicTxNoFogInst
+call :CompileShader93%1 BasicEffect vs VSBasicTxVcInst
+call :CompileShader93%1 BasicEffect vs VSBasicTxVcNoFogInst
+
+call :CompileShader93%1 BasicEffect vs VSBasicVertexLightingInst
+call :CompileShader93%1 BasicEffect vs VSBasicVertexLightingVcInst
+call :CompileShader93%1 BasicEffect vs VSBasicVertexLightingTxInst
+call :CompileShader93%1 BasicEffect vs VSBasicVertexLightingTxVcInst
+
+call :CompileShader93%1 BasicEffect vs VSBasicOneLightInst
+call :CompileShader93%1 BasicEffect vs VSBasicOneLightVcInst
+call :CompileShader93%1 BasicEffect vs VSBasicOneLightTxInst
+call :CompileShader93%1 BasicEffect vs VSBasicOneLightTxVcInst
+
+call :CompileShader93%1 BasicEffect vs VSBasicPixelLightingInst
+call :CompileShader93%1 BasicEffect vs VSBasicPixelLightingVcInst
+call :CompileShader93%1 BasicEffect vs VSBasicPixelLightingTxInst
+call :CompileShader93%1 BasicEffect vs VSBasicPixelLightingTxVcInst
+
 call :CompileShader%1 BasicEffect ps PSBasic
 call :CompileShader%1 BasicEffect ps PSBasicNoFog
 call :CompileShader%1 BasicEffect ps PSBasicTx
@@ -66,6 +90,9 @@ call :CompileShader%1 BasicEffect ps PSBasicVertexLightingTxNoFog
 call :CompileShader%1 BasicEffect ps PSBasicPixelLighting
 call :CompileShader%1 BasicEffect ps PSBasicPixelLightingTx
 
+call :CompileShaderSM4%1 BasicEffect ps PSBasicPixelLightingTiled
+call :CompileShaderSM4%1 BasicEffect ps PSBasicPixelLightingTxTiled
+
 call :CompileShader%1 DualTextureEffect vs VSDualTexture
 call :CompileShader%1 DualTextureEffect vs VSDualTextureNoFog
 call :CompileShader%1 DualTextureEffect vs VSDualTextureVc
@@ -96,13 +123,57 @@ call :CompileShader%1 SkinnedEffect vs VSSkinnedPixelLightingOneBone
 call :CompileShader%1 SkinnedEffect vs VSSkinnedPixelLightingTwoBones
 call :CompileShader%1 SkinnedEffect vs VSSkinnedPixelLightingFourBones
 
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedVertexLightingOneBoneBuffer
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedVertexLightingTwoBonesBuffer
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedVertexLightingFourBonesBuffer
+
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedOneLightOneBoneBuffer
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedOneLightTwoBonesBuffer
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedOneLightFourBonesBuffer
+
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedPixelLightingOneBoneBuffer
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedPixelLightingTwoBonesBuffer
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedPixelLightingFourBonesBuffer
+
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedVertexLightingOneBoneDualQuaternion
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedVertexLightingTwoBonesDualQuaternion
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedVertexLightingFourBonesDualQuaternion
+
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedOneLightOneBoneDualQuaternion
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedOneLightTwoBonesDualQuaternion
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedOneLightFourBonesDualQuaternion
+
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedPixelLightingOneBoneDualQuaternion
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedPixelLightingTwoBonesDualQuaternion
+call :CompileShaderSM4%1 SkinnedEffect vs VSSkinnedPixelLightingFourBonesDualQuaternion
+
 call :CompileShader%1 SkinnedEffect ps PSSkinnedVertexLighting
 call :CompileShader%1 SkinnedEffect ps PSSkinnedVertexLightingNoFog
 call :CompileShader%1 SkinnedEffect ps PSSkinnedPixelLighting
 
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinOneBone
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinTwoBones
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinFourBones
+
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinOneBoneBuffer
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinTwoBonesBuffer
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinFourBonesBuffer
+
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinOneBoneDualQuaternion
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinTwoBonesDualQuaternion
+call :CompileShaderSM4%1 PreSkinning vs VSPreSkinFourBonesDualQuaternion
+
+call :CompileShaderSM5%1 LightGrid cs CSBuildLightGrid
+
+call :CompileShaderSM5%1 ReflectionProbes cs CSPrefilter
+
 call :CompileShader%1 SpriteEffect vs SpriteVertexShader
 call :CompileShader%1 SpriteEffect ps SpritePixelShader
 
+call :CompileShaderSM4%1 SpriteEffect vs SpriteVertexShaderInstanced
+call :CompileShaderSM4%1 SpriteEffect vs SpriteVertexShaderInstancedMultiTexture
+call :CompileShaderSM4%1 SpriteEffect ps SpritePixelShaderMultiTexture
+
 call :CompileShader%1 DGSLEffect vs main
 call :CompileShader%1 DGSLEffect vs mainVc
 call :CompileShader%1 DGSLEffect vs main1Bones
@@ -112,6 +183,9 @@ call :CompileShader%1 DGSLEffect vs main2BonesVc
 call :CompileShader%1 DGSLEffect vs main4Bones
 call :CompileShader%1 DGSLEffect vs main4BonesVc
 
+call :CompileShader93%1 DGSLEffect vs mainInst
+call :CompileShader93%1 DGSLEffect vs mainVcInst
+
 call :CompileShaderHLSL%1 DGSLUnlit ps main
 call :CompileShaderHLSL%1 DGSLLambert ps main
 call :CompileShaderHLSL%1 DGSLPhong ps main
@@ -152,6 +226,27 @@ echo %fxc%
 %fxc% || set error=1
 exit /b
 
+:CompileShader93
+set fxc=fxc /nologo %1.fx /T%2_4_0_level_9_3 /Zpc /Qstrip_reflect /Qstrip_debug /E%3 /FhCompiled\%1_%3.inc /Vn%1_%3
+echo.
+echo %fxc%
+%fxc% || set error=1
+exit /b
+
+:CompileShaderSM4
+set fxc=fxc /nologo %1.fx /T%2_4_0 /Zpc /Qstrip_reflect /Qstrip_debug /E%3 /FhCompiled\%1_%3.inc /Vn%1_%3
+echo.
+echo %fxc%
+%fxc% || set error=1
+exit /b
+
+:CompileShaderSM5
+set fxc=fxc /nologo %1.fx /T%2_5_0 /Zpc /Qstrip_reflect /Qstrip_debug /E%3 /FhCompiled\%1_%3.inc /Vn%1_%3
+echo.
+echo %fxc%
+%fxc% || set error=1
+exit /b
+
 :CompileShaderxbox
 set fxc="%DurangoXDK%\xdk\FXC\amd64\FXC.exe" /nologo %1.fx /T%2_5_0 /Zpc /Qstrip_reflect /Qstrip_debug /D__XBOX_DISABLE_SHADER_NAME_EMPLACEMENT /E%3 /FhCompiled\XboxOne%1_%3.inc /Vn%1_%3
 echo.
@@ -166,5 +261,26 @@ echo %fxc%
 %fxc% || set error=1
 exit /b
 
+:CompileShader93xbox
+set fxc="%DurangoXDK%\xdk\FXC\amd64\FXC.exe" /nologo %1.fx /T%2_5_0 /Zpc /Qstrip_reflect /Qstrip_debug /D__XBOX_DISABLE_SHADER_NAME_EMPLACEMENT /E%3 /FhCompiled\XboxOne%1_%3.inc /Vn%1_%3
+echo.
+echo %fxc%
+%fxc% || set error=1
+exit /b
+
+:CompileShaderSM4xbox
+set fxc="%DurangoXDK%\xdk\FXC\amd64\FXC.exe" /nologo %1.fx /T%2_5_0 /Zpc /Qstrip_reflect /Qstrip_debug /D__XBOX_DISABLE_SHADER_NAME_EMPLACEMENT /E%3 /FhCompiled\XboxOne%1_%3.inc /Vn%1_%3
+echo.
+echo %fxc%
+%fxc% || set error=1
+exit /b
+
+:CompileShaderSM5xbox
+set fxc="%DurangoXDK%\xdk\FXC\amd64\FXC.exe" /nologo %1.fx /T%2_5_0 /Zpc /Qstrip_reflect /Qstrip_debug /D__XBOX_DISABLE_SHADER_NAME_EMPLACEMENT /E%3 /FhCompiled\XboxOne%1_%3.inc /Vn%1_%3
+echo.
+echo %fxc%
+%fxc% || set error=1
+exit /b
+
 :needxdk
 echo ERROR: CompileShaders xbox requires the Microsoft Xbox One XDK
\ No newline at end of file
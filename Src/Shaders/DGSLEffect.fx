@@ -291,4 +291,35 @@ V2P main4BonesVc(A2V_WeightsVc vertex)
     result.normal = vertex.normal;
   
     return result;
-}
\ No newline at end of file
+}
+
+
+// Instancing helper: the per-instance transform is applied before LocalToWorld, as the first three columns of the usual row-vector matrix
+struct A2V_Instance
+{
+    float4x3 transform : INSTMATRIX;
+};
+
+void Instance(inout float4 pos, inout float3 normal, inout float4 tangent, float4x3 transform)
+{
+    pos.xyz = mul(pos, transform);
+    normal = mul(normal, (float3x3)transform);
+    tangent.xyz = mul((float3)tangent, (float3x3)transform);
+}
+
+
+// Vertex shader: no per-vertex-color, no skinning, instanced
+V2P mainInst(A2V vertex, A2V_Instance instance)
+{
+    Instance(vertex.pos, vertex.normal, vertex.tangent, instance.transform);
+
+    return main(vertex);
+}
+
+// Vertex shader: per-vertex-color, no skinning, instanced
+V2P mainVcInst(A2V_Vc vertex, A2V_Instance instance)
+{
+    Instance(vertex.pos, vertex.normal, vertex.tangent, instance.transform);
+
+    return mainVc(vertex);
+}
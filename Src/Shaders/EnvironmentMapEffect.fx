@@ -21,6 +21,7 @@ cbuffer Parameters : register(b0)
     float3 EnvironmentMapSpecular   : packoffset(c0);
     float  EnvironmentMapAmount     : packoffset(c1.x);
     float  FresnelFactor            : packoffset(c1.y);
+    float  EnvironmentMapLod        : packoffset(c1.z);
 
     float4 DiffuseColor             : packoffset(c2);
     float3 EmissiveColor            : packoffset(c3);
@@ -116,7 +117,7 @@ VSOutputTxEnvMap VSEnvMapOneLightFresnel(VSInputNmTx vin)
 float4 PSEnvMap(PSInputTxEnvMap pin) : SV_Target0
 {
     float4 color = Texture.Sample(Sampler, pin.TexCoord) * pin.Diffuse;
-    float4 envmap = EnvironmentMap.Sample(EnvMapSampler, pin.EnvCoord) * color.a;
+    float4 envmap = EnvironmentMap.SampleBias(EnvMapSampler, pin.EnvCoord, EnvironmentMapLod) * color.a;
 
     color.rgb = lerp(color.rgb, envmap.rgb, pin.Specular.rgb);
 
@@ -130,7 +131,7 @@ float4 PSEnvMap(PSInputTxEnvMap pin) : SV_Target0
 float4 PSEnvMapNoFog(PSInputTxEnvMap pin) : SV_Target0
 {
     float4 color = Texture.Sample(Sampler, pin.TexCoord) * pin.Diffuse;
-    float4 envmap = EnvironmentMap.Sample(EnvMapSampler, pin.EnvCoord) * color.a;
+    float4 envmap = EnvironmentMap.SampleBias(EnvMapSampler, pin.EnvCoord, EnvironmentMapLod) * color.a;
 
     color.rgb = lerp(color.rgb, envmap.rgb, pin.Specular.rgb);
 
@@ -142,7 +143,7 @@ float4 PSEnvMapNoFog(PSInputTxEnvMap pin) : SV_Target0
 float4 PSEnvMapSpecular(PSInputTxEnvMap pin) : SV_Target0
 {
     float4 color = Texture.Sample(Sampler, pin.TexCoord) * pin.Diffuse;
-    float4 envmap = EnvironmentMap.Sample(EnvMapSampler, pin.EnvCoord) * color.a;
+    float4 envmap = EnvironmentMap.SampleBias(EnvMapSampler, pin.EnvCoord, EnvironmentMapLod) * color.a;
 
     color.rgb = lerp(color.rgb, envmap.rgb, pin.Specular.rgb);
     color.rgb += EnvironmentMapSpecular * envmap.a;
@@ -157,7 +158,7 @@ float4 PSEnvMapSpecular(PSInputTxEnvMap pin) : SV_Target0
 float4 PSEnvMapSpecularNoFog(PSInputTxEnvMap pin) : SV_Target0
 {
     float4 color = Texture.Sample(Sampler, pin.TexCoord) * pin.Diffuse;
-    float4 envmap = EnvironmentMap.Sample(EnvMapSampler, pin.EnvCoord) * color.a;
+    float4 envmap = EnvironmentMap.SampleBias(EnvMapSampler, pin.EnvCoord, EnvironmentMapLod) * color.a;
 
     color.rgb = lerp(color.rgb, envmap.rgb, pin.Specular.rgb);
     color.rgb += EnvironmentMapSpecular * envmap.a;
@@ -0,0 +1,133 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+
+
+// Must match LightGrid::TileSize and LightGrid::MaxLightsPerTileLimit.
+#define TileSize 16
+#define MaxLightsPerTileLimit 256
+
+
+// Three float4 per light: position and range, diffuse color, specular color.
+Buffer<float4> Lights : register(t0);
+
+// For each tile, a count followed by MaxLightsPerTile light indices.
+RWBuffer<uint> TileLights : register(u0);
+
+
+cbuffer Parameters : register(b0)
+{
+    float4x4 View               : packoffset(c0);
+    float4x4 InverseProjection  : packoffset(c4);
+    uint2    TileCount          : packoffset(c8);
+    float2   ScreenSize         : packoffset(c8.z);
+    uint     LightCount         : packoffset(c9.x);
+    uint     MaxLightsPerTile   : packoffset(c9.y);
+};
+
+
+groupshared uint TileLightCount;
+groupshared uint TileLightIndices[MaxLightsPerTileLimit];
+
+
+// Returns the view space point on the far plane under a screen position.
+float3 UnprojectFar(float2 pixel)
+{
+    float2 ndc = float2(pixel.x / ScreenSize.x * 2 - 1, 1 - pixel.y / ScreenSize.y * 2);
+
+    float4 position = mul(float4(ndc, 1, 1), InverseProjection);
+
+    return position.xyz / position.w;
+}
+
+
+// Planes through the eye are flipped so the tile interior is on the positive side, which keeps the
+// test independent of whether the projection is left or right handed.
+float3 SidePlane(float3 a, float3 b, float3 interior)
+{
+    float3 normal = normalize(cross(a, b));
+
+    return (dot(normal, interior) < 0) ? -normal : normal;
+}
+
+
+// Compute shader: one thread group per screen tile, each thread testing a stripe of the lights against
+// the tile's frustum and appending the ones that touch it to the tile's list.
+[numthreads(TileSize, TileSize, 1)]
+void CSBuildLightGrid(uint3 groupId : SV_GroupID, uint threadIndex : SV_GroupIndex)
+{
+    if (threadIndex == 0)
+    {
+        TileLightCount = 0;
+    }
+
+    float2 tileMin = groupId.xy * TileSize;
+    float2 tileMax = min(tileMin + TileSize, ScreenSize);
+
+    float3 topLeft     = UnprojectFar(tileMin);
+    float3 topRight    = UnprojectFar(float2(tileMax.x, tileMin.y));
+    float3 bottomRight = UnprojectFar(tileMax);
+    float3 bottomLeft  = UnprojectFar(float2(tileMin.x, tileMax.y));
+
+    float3 interior = (topLeft + topRight + bottomRight + bottomLeft) * 0.25;
+
+    float3 planes[4];
+
+    planes[0] = SidePlane(topLeft, topRight, interior);
+    planes[1] = SidePlane(topRight, bottomRight, interior);
+    planes[2] = SidePlane(bottomRight, bottomLeft, interior);
+    planes[3] = SidePlane(bottomLeft, topLeft, interior);
+
+    float3 forward = normalize(interior);
+
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint i = threadIndex; i < LightCount; i += TileSize * TileSize)
+    {
+        float4 positionRange = Lights[i * 3];
+
+        float3 positionVS = mul(float4(positionRange.xyz, 1), View).xyz;
+        float range = positionRange.w;
+
+        // Skip lights wholly behind the eye, or wholly outside any side of the tile.
+        bool inside = dot(positionVS, forward) > -range;
+
+        [unroll]
+        for (int p = 0; p < 4; p++)
+        {
+            inside = inside && (dot(positionVS, planes[p]) > -range);
+        }
+
+        if (inside)
+        {
+            uint slot;
+
+            InterlockedAdd(TileLightCount, 1, slot);
+
+            if (slot < MaxLightsPerTile)
+            {
+                TileLightIndices[slot] = i;
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    uint count = min(TileLightCount, MaxLightsPerTile);
+    uint first = (groupId.y * TileCount.x + groupId.x) * (MaxLightsPerTile + 1);
+
+    if (threadIndex == 0)
+    {
+        TileLights[first] = count;
+    }
+
+    for (uint j = threadIndex; j < count; j += TileSize * TileSize)
+    {
+        TileLights[first + 1 + j] = TileLightIndices[j];
+    }
+}
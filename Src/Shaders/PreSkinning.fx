@@ -0,0 +1,127 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+
+
+// Bone palette for the buffer skinning modes. Holds three float4 per bone
+// (the first three columns of each matrix) or two per bone (real and dual quaternion parts).
+Buffer<float4> BoneBuffer : register(t0);
+
+
+cbuffer Parameters : register(b0)
+{
+    float4x3 Bones[72]              : packoffset(c0);
+
+    uint FirstBone                  : packoffset(c216);
+};
+
+
+#include "Structures.fxh"
+#include "Skinning.fxh"
+
+
+// Written to the stream output buffer, matching VertexPositionNormalTexture.
+struct VSOutputPreSkin
+{
+    float3 Position : POSITION;
+    float3 Normal   : NORMAL;
+    float2 TexCoord : TEXCOORD0;
+};
+
+
+VSOutputPreSkin MakeOutput(VSInputNmTxWeights vin)
+{
+    VSOutputPreSkin vout;
+
+    vout.Position = vin.Position.xyz;
+    vout.Normal = normalize(vin.Normal);
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: one bone.
+VSOutputPreSkin VSPreSkinOneBone(VSInputNmTxWeights vin)
+{
+    Skin(vin, 1);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: two bones.
+VSOutputPreSkin VSPreSkinTwoBones(VSInputNmTxWeights vin)
+{
+    Skin(vin, 2);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: four bones.
+VSOutputPreSkin VSPreSkinFourBones(VSInputNmTxWeights vin)
+{
+    Skin(vin, 4);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: one bone, bone buffer.
+VSOutputPreSkin VSPreSkinOneBoneBuffer(VSInputNmTxWeights vin)
+{
+    SkinBuffer(vin, 1);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: two bones, bone buffer.
+VSOutputPreSkin VSPreSkinTwoBonesBuffer(VSInputNmTxWeights vin)
+{
+    SkinBuffer(vin, 2);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: four bones, bone buffer.
+VSOutputPreSkin VSPreSkinFourBonesBuffer(VSInputNmTxWeights vin)
+{
+    SkinBuffer(vin, 4);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: one bone, dual quaternions.
+VSOutputPreSkin VSPreSkinOneBoneDualQuaternion(VSInputNmTxWeights vin)
+{
+    SkinDualQuaternion(vin, 1);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: two bones, dual quaternions.
+VSOutputPreSkin VSPreSkinTwoBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    SkinDualQuaternion(vin, 2);
+
+    return MakeOutput(vin);
+}
+
+
+// Vertex shader: four bones, dual quaternions.
+VSOutputPreSkin VSPreSkinFourBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    SkinDualQuaternion(vin, 4);
+
+    return MakeOutput(vin);
+}
@@ -0,0 +1,113 @@
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+
+
+// Must match the thread group size in ReflectionProbes.cpp.
+#define ThreadGroupSize 8
+
+#define SampleCount 32
+
+#define Pi 3.14159265
+
+
+// The freshly rendered probe, with a full box filtered mip chain.
+TextureCube<float4> Source : register(t0);
+
+// One mip of the probe being prefiltered, as six array slices.
+RWTexture2DArray<float4> Destination : register(u0);
+
+sampler SourceSampler : register(s0);
+
+
+cbuffer Parameters : register(b0)
+{
+    float Roughness             : packoffset(c0.x);
+    float SourceTexelSolidAngle : packoffset(c0.y);
+    uint  DestinationSize       : packoffset(c0.z);
+};
+
+
+// Direction through a texel of a cube face, using the D3D face layout.
+float3 FaceDirection(uint face, float2 uv)
+{
+    switch (face)
+    {
+        case 0:  return float3( 1,     -uv.y, -uv.x);
+        case 1:  return float3(-1,     -uv.y,  uv.x);
+        case 2:  return float3( uv.x,  1,      uv.y);
+        case 3:  return float3( uv.x, -1,     -uv.y);
+        case 4:  return float3( uv.x, -uv.y,  1);
+        default: return float3(-uv.x, -uv.y, -1);
+    }
+}
+
+
+float2 Hammersley(uint i)
+{
+    return float2(float(i) / SampleCount, reversebits(i) * 2.3283064365386963e-10);
+}
+
+
+// GGX distributed half vector around the normal.
+float3 ImportanceSampleGGX(float2 xi, float alpha, float3 normal)
+{
+    float phi = 2 * Pi * xi.x;
+    float cosTheta = sqrt((1 - xi.y) / (1 + (alpha * alpha - 1) * xi.y));
+    float sinTheta = sqrt(1 - cosTheta * cosTheta);
+
+    float3 up = (abs(normal.z) < 0.999) ? float3(0, 0, 1) : float3(1, 0, 0);
+    float3 tangentX = normalize(cross(up, normal));
+    float3 tangentY = cross(normal, tangentX);
+
+    return tangentX * (sinTheta * cos(phi)) + tangentY * (sinTheta * sin(phi)) + normal * cosTheta;
+}
+
+
+// Compute shader: one thread per destination texel, each convolving the source with a GGX lobe of the
+// mip's roughness. Taking the normal as the view direction lets a handful of samples do, because each
+// one reads the source mip whose texels cover the solid angle that sample stands for.
+[numthreads(ThreadGroupSize, ThreadGroupSize, 1)]
+void CSPrefilter(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= DestinationSize || id.y >= DestinationSize)
+        return;
+
+    float2 uv = (id.xy + 0.5) / DestinationSize * 2 - 1;
+    float3 normal = normalize(FaceDirection(id.z, uv));
+
+    float alpha = Roughness * Roughness;
+    float alpha2 = alpha * alpha;
+
+    float4 color = 0;
+    float weight = 0;
+
+    for (uint i = 0; i < SampleCount; i++)
+    {
+        float3 halfVector = ImportanceSampleGGX(Hammersley(i), alpha, normal);
+        float3 lightVector = 2 * dot(normal, halfVector) * halfVector - normal;
+
+        float nDotL = dot(normal, lightVector);
+
+        if (nDotL > 0)
+        {
+            // With the view along the normal, the pdf of the light vector is D / 4.
+            float nDotH = saturate(dot(normal, halfVector));
+            float d = nDotH * nDotH * (alpha2 - 1) + 1;
+            float pdf = alpha2 / (4 * Pi * d * d);
+
+            float sampleSolidAngle = 1 / (SampleCount * pdf + 0.0001);
+            float lod = max(0.5 * log2(sampleSolidAngle / SourceTexelSolidAngle) + 1, 0);
+
+            color += Source.SampleLevel(SourceSampler, lightVector, lod) * nDotL;
+            weight += nDotL;
+        }
+    }
+
+    Destination[id] = color / max(weight, 0.0001);
+}
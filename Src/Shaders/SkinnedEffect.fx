@@ -12,6 +12,10 @@
 Texture2D<float4> Texture : register(t0);
 sampler Sampler : register(s0);
 
+// Bone palette for the buffer skinning modes, read by the vertex shader. Holds three float4 per bone
+// (the first three columns of each matrix) or two per bone (real and dual quaternion parts).
+Buffer<float4> BoneBuffer : register(t0);
+
 
 cbuffer Parameters : register(b0)
 {
@@ -34,27 +38,15 @@ cbuffer Parameters : register(b0)
     float4x4 WorldViewProj          : packoffset(c22);
 
     float4x3 Bones[72]              : packoffset(c26);
+
+    uint FirstBone                  : packoffset(c242);
 };
 
 
 #include "Structures.fxh"
 #include "Common.fxh"
 #include "Lighting.fxh"
-
-
-void Skin(inout VSInputNmTxWeights vin, uniform int boneCount)
-{
-    float4x3 skinning = 0;
-
-    [unroll]
-    for (int i = 0; i < boneCount; i++)
-    {
-        skinning += Bones[vin.Indices[i]] * vin.Weights[i];
-    }
-
-    vin.Position.xyz = mul(vin.Position, skinning);
-    vin.Normal = mul(vin.Normal, (float3x3)skinning);
-}
+#include "Skinning.fxh"
 
 
 // Vertex shader: vertex lighting, one bone.
@@ -204,6 +196,300 @@ VSOutputPixelLightingTx VSSkinnedPixelLightingFourBones(VSInputNmTxWeights vin)
 }
 
 
+// Vertex shader: vertex lighting, one bone, bone buffer.
+VSOutputTx VSSkinnedVertexLightingOneBoneBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinBuffer(vin, 1);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 3);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: vertex lighting, two bones, bone buffer.
+VSOutputTx VSSkinnedVertexLightingTwoBonesBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinBuffer(vin, 2);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 3);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: vertex lighting, four bones, bone buffer.
+VSOutputTx VSSkinnedVertexLightingFourBonesBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinBuffer(vin, 4);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 3);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: one light, one bone, bone buffer.
+VSOutputTx VSSkinnedOneLightOneBoneBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinBuffer(vin, 1);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 1);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: one light, two bones, bone buffer.
+VSOutputTx VSSkinnedOneLightTwoBonesBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinBuffer(vin, 2);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 1);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: one light, four bones, bone buffer.
+VSOutputTx VSSkinnedOneLightFourBonesBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinBuffer(vin, 4);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 1);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: pixel lighting, one bone, bone buffer.
+VSOutputPixelLightingTx VSSkinnedPixelLightingOneBoneBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputPixelLightingTx vout;
+
+    SkinBuffer(vin, 1);
+
+    CommonVSOutputPixelLighting cout = ComputeCommonVSOutputPixelLighting(vin.Position, vin.Normal);
+    SetCommonVSOutputParamsPixelLighting;
+
+    vout.Diffuse = float4(1, 1, 1, DiffuseColor.a);
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: pixel lighting, two bones, bone buffer.
+VSOutputPixelLightingTx VSSkinnedPixelLightingTwoBonesBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputPixelLightingTx vout;
+
+    SkinBuffer(vin, 2);
+
+    CommonVSOutputPixelLighting cout = ComputeCommonVSOutputPixelLighting(vin.Position, vin.Normal);
+    SetCommonVSOutputParamsPixelLighting;
+
+    vout.Diffuse = float4(1, 1, 1, DiffuseColor.a);
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: pixel lighting, four bones, bone buffer.
+VSOutputPixelLightingTx VSSkinnedPixelLightingFourBonesBuffer(VSInputNmTxWeights vin)
+{
+    VSOutputPixelLightingTx vout;
+
+    SkinBuffer(vin, 4);
+
+    CommonVSOutputPixelLighting cout = ComputeCommonVSOutputPixelLighting(vin.Position, vin.Normal);
+    SetCommonVSOutputParamsPixelLighting;
+
+    vout.Diffuse = float4(1, 1, 1, DiffuseColor.a);
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: vertex lighting, one bone, dual quaternions.
+VSOutputTx VSSkinnedVertexLightingOneBoneDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinDualQuaternion(vin, 1);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 3);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: vertex lighting, two bones, dual quaternions.
+VSOutputTx VSSkinnedVertexLightingTwoBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinDualQuaternion(vin, 2);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 3);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: vertex lighting, four bones, dual quaternions.
+VSOutputTx VSSkinnedVertexLightingFourBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinDualQuaternion(vin, 4);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 3);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: one light, one bone, dual quaternions.
+VSOutputTx VSSkinnedOneLightOneBoneDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinDualQuaternion(vin, 1);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 1);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: one light, two bones, dual quaternions.
+VSOutputTx VSSkinnedOneLightTwoBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinDualQuaternion(vin, 2);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 1);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: one light, four bones, dual quaternions.
+VSOutputTx VSSkinnedOneLightFourBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputTx vout;
+
+    SkinDualQuaternion(vin, 4);
+
+    CommonVSOutput cout = ComputeCommonVSOutputWithLighting(vin.Position, vin.Normal, 1);
+    SetCommonVSOutputParams;
+
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: pixel lighting, one bone, dual quaternions.
+VSOutputPixelLightingTx VSSkinnedPixelLightingOneBoneDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputPixelLightingTx vout;
+
+    SkinDualQuaternion(vin, 1);
+
+    CommonVSOutputPixelLighting cout = ComputeCommonVSOutputPixelLighting(vin.Position, vin.Normal);
+    SetCommonVSOutputParamsPixelLighting;
+
+    vout.Diffuse = float4(1, 1, 1, DiffuseColor.a);
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: pixel lighting, two bones, dual quaternions.
+VSOutputPixelLightingTx VSSkinnedPixelLightingTwoBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputPixelLightingTx vout;
+
+    SkinDualQuaternion(vin, 2);
+
+    CommonVSOutputPixelLighting cout = ComputeCommonVSOutputPixelLighting(vin.Position, vin.Normal);
+    SetCommonVSOutputParamsPixelLighting;
+
+    vout.Diffuse = float4(1, 1, 1, DiffuseColor.a);
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
+// Vertex shader: pixel lighting, four bones, dual quaternions.
+VSOutputPixelLightingTx VSSkinnedPixelLightingFourBonesDualQuaternion(VSInputNmTxWeights vin)
+{
+    VSOutputPixelLightingTx vout;
+
+    SkinDualQuaternion(vin, 4);
+
+    CommonVSOutputPixelLighting cout = ComputeCommonVSOutputPixelLighting(vin.Position, vin.Normal);
+    SetCommonVSOutputParamsPixelLighting;
+
+    vout.Diffuse = float4(1, 1, 1, DiffuseColor.a);
+    vout.TexCoord = vin.TexCoord;
+
+    return vout;
+}
+
+
 // Pixel shader: vertex lighting.
 float4 PSSkinnedVertexLighting(PSInputTx pin) : SV_Target0
 {
@@ -32,3 +32,98 @@ float4 SpritePixelShader(float4 color    : COLOR0,
 {
     return Texture.Sample(TextureSampler, texCoord) * color;
 }
+
+
+// Instanced sprite rendering: the CPU writes one record per sprite, and this
+// shader expands it into the four corners of a quad. Requires SV_VertexID, so
+// it is compiled for shader model 4 and only used on feature level 10.0+.
+void ExpandSpriteInstance(uint vertexId, float4 destination, float4 source, float4 originRotationDepth,
+                          out float2 texCoord, out float4 position)
+{
+    // Triangle strip order matches the { 0,0 } { 1,0 } { 0,1 } { 1,1 } corner table used on the CPU.
+    float2 corner = float2(vertexId & 1, vertexId >> 1);
+
+    float2 cornerOffset = (corner - originRotationDepth.xy) * destination.zw;
+
+    float sinRotation, cosRotation;
+
+    sincos(originRotationDepth.z, sinRotation, cosRotation);
+
+    float2 rotated = destination.xy + cornerOffset.x * float2(cosRotation, sinRotation)
+                                    + cornerOffset.y * float2(-sinRotation, cosRotation);
+
+    // Mirroring is folded into the source region by the CPU (negative width/height).
+    texCoord = corner * source.zw + source.xy;
+    position = mul(float4(rotated, originRotationDepth.w, 1), MatrixTransform);
+}
+
+
+void SpriteVertexShaderInstanced(uint   vertexId            : SV_VertexID,
+                                 float4 destination         : SPRITEDESTINATION,
+                                 float4 source              : SPRITESOURCE,
+                                 float4 originRotationDepth : SPRITEORIGINROTATIONDEPTH,
+                                 float4 spriteColor         : SPRITECOLOR,
+                                 out float4 color    : COLOR0,
+                                 out float2 texCoord : TEXCOORD0,
+                                 out float4 position : SV_Position)
+{
+    color = spriteColor;
+
+    ExpandSpriteInstance(vertexId, destination, source, originRotationDepth, texCoord, position);
+}
+
+
+// Multi-texture batching: several textures are bound at once, and each sprite
+// carries the index of the one it uses, so texture changes within that set
+// don't split the batch.
+Texture2D<float4> Texture1 : register(t1);
+Texture2D<float4> Texture2 : register(t2);
+Texture2D<float4> Texture3 : register(t3);
+Texture2D<float4> Texture4 : register(t4);
+Texture2D<float4> Texture5 : register(t5);
+Texture2D<float4> Texture6 : register(t6);
+Texture2D<float4> Texture7 : register(t7);
+
+
+void SpriteVertexShaderInstancedMultiTexture(uint   vertexId            : SV_VertexID,
+                                             float4 destination         : SPRITEDESTINATION,
+                                             float4 source              : SPRITESOURCE,
+                                             float4 originRotationDepth : SPRITEORIGINROTATIONDEPTH,
+                                             float4 spriteColor         : SPRITECOLOR,
+                                             uint   spriteTextureIndex  : SPRITETEXTUREINDEX,
+                                             out float4 color                        : COLOR0,
+                                             out float2 texCoord                     : TEXCOORD0,
+                                             out uint   textureIndex                 : TEXTUREINDEX,
+                                             out float4 position                     : SV_Position)
+{
+    color = spriteColor;
+    textureIndex = spriteTextureIndex;
+
+    ExpandSpriteInstance(vertexId, destination, source, originRotationDepth, texCoord, position);
+}
+
+
+float4 SpritePixelShaderMultiTexture(float4 color    : COLOR0,
+                                     float2 texCoord : TEXCOORD0,
+                                     nointerpolation uint textureIndex : TEXTUREINDEX) : SV_Target0
+{
+    // Gradients are computed outside the branch, as they are undefined inside divergent flow control.
+    float2 dx = ddx(texCoord);
+    float2 dy = ddy(texCoord);
+
+    float4 texel;
+
+    [branch] switch (textureIndex)
+    {
+        case 0:  texel = Texture.SampleGrad (TextureSampler, texCoord, dx, dy); break;
+        case 1:  texel = Texture1.SampleGrad(TextureSampler, texCoord, dx, dy); break;
+        case 2:  texel = Texture2.SampleGrad(TextureSampler, texCoord, dx, dy); break;
+        case 3:  texel = Texture3.SampleGrad(TextureSampler, texCoord, dx, dy); break;
+        case 4:  texel = Texture4.SampleGrad(TextureSampler, texCoord, dx, dy); break;
+        case 5:  texel = Texture5.SampleGrad(TextureSampler, texCoord, dx, dy); break;
+        case 6:  texel = Texture6.SampleGrad(TextureSampler, texCoord, dx, dy); break;
+        default: texel = Texture7.SampleGrad(TextureSampler, texCoord, dx, dy); break;
+    }
+
+    return texel * color;
+}
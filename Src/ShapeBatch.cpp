@@ -0,0 +1,442 @@
+//--------------------------------------------------------------------------------------
+// File: ShapeBatch.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "ShapeBatch.h"
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+
+const D3D11_INPUT_ELEMENT_DESC ShapeBatch::InputElements[] =
+{
+    { "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,  D3D11_INPUT_PER_VERTEX_DATA,   0 },
+    { "INSTMATRIX",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "INSTMATRIX",  1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "INSTMATRIX",  2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "COLOR",       0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+};
+
+
+namespace
+{
+    // Per-instance data: the first three columns of the world matrix, then the color.
+    struct ShapeInstance
+    {
+        XMFLOAT4 column[3];
+        XMFLOAT4 color;
+    };
+
+    static_assert( sizeof(ShapeInstance) == 64, "Instance struct/layout mismatch" );
+
+
+    const size_t CircleSegments = 32;
+
+
+    // Appends a line list circle in the plane of the two axes.
+    void AddCircle(std::vector<XMFLOAT3>& positions, std::vector<uint16_t>& indices, FXMVECTOR axisA, FXMVECTOR axisB)
+    {
+        uint16_t first = static_cast<uint16_t>(positions.size());
+
+        for (size_t i = 0; i < CircleSegments; i++)
+        {
+            float angle = i * XM_2PI / CircleSegments;
+
+            float sin, cos;
+
+            XMScalarSinCos(&sin, &cos, angle);
+
+            XMFLOAT3 position;
+
+            XMStoreFloat3(&position, XMVectorAdd(XMVectorScale(axisA, cos), XMVectorScale(axisB, sin)));
+
+            positions.push_back(position);
+
+            indices.push_back(static_cast<uint16_t>(first + i));
+            indices.push_back(static_cast<uint16_t>(first + (i + 1) % CircleSegments));
+        }
+    }
+}
+
+
+// Internal ShapeBatch implementation class.
+class ShapeBatch::Impl
+{
+public:
+    Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxInstances);
+
+    size_t AddShape(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(vertexCount) XMFLOAT3 const* positions, size_t vertexCount,
+                    _In_reads_(indexCount) uint16_t const* indices, size_t indexCount);
+
+    void Begin();
+    void End();
+
+    void XM_CALLCONV Draw(size_t shape, FXMMATRIX transform, FXMVECTOR color);
+
+private:
+    struct ShapeInfo
+    {
+        D3D11_PRIMITIVE_TOPOLOGY topology;
+        UINT startIndex;
+        UINT indexCount;
+        INT baseVertex;
+
+        // Kept between frames, so drawing the same number of shapes each frame does not allocate.
+        std::vector<ShapeInstance> instances;
+    };
+
+    void CreateShapeBuffers();
+
+    ComPtr<ID3D11DeviceContext> mDeviceContext;
+    ComPtr<ID3D11Buffer> mVertexBuffer;
+    ComPtr<ID3D11Buffer> mIndexBuffer;
+    ComPtr<ID3D11Buffer> mInstanceBuffer;
+
+    std::vector<ShapeInfo> mShapes;
+    std::vector<XMFLOAT3> mPositions;
+    std::vector<uint16_t> mIndices;
+    bool mShapesDirty;
+
+    size_t mMaxInstances;
+    size_t mCurrentInstance;
+    bool mInBeginEndPair;
+};
+
+
+// Constructor.
+ShapeBatch::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxInstances)
+  : mDeviceContext(deviceContext),
+    mShapesDirty(true),
+    mMaxInstances(maxInstances),
+    mCurrentInstance(0),
+    mInBeginEndPair(false)
+{
+    if (!maxInstances || maxInstances > (UINT32_MAX / sizeof(ShapeInstance)))
+        throw std::out_of_range("maxInstances parameter out of range");
+
+    ComPtr<ID3D11Device> device;
+
+    deviceContext->GetDevice(&device);
+
+    if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_3)
+        throw std::exception("ShapeBatch requires Feature Level 9.3 or greater");
+
+    D3D11_BUFFER_DESC desc = { 0 };
+
+    desc.ByteWidth = static_cast<UINT>(maxInstances * sizeof(ShapeInstance));
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    ThrowIfFailed(
+        device->CreateBuffer(&desc, nullptr, &mInstanceBuffer)
+    );
+
+    SetDebugObjectName(mInstanceBuffer.Get(), "DirectXTK:ShapeBatch");
+
+    // Build the built-in shapes, in the order of the Shape enum.
+    std::vector<XMFLOAT3> positions;
+    std::vector<uint16_t> indices;
+
+    static const uint16_t boxEdges[] =
+    {
+        0, 1, 1, 3, 3, 2, 2, 0,
+        4, 5, 5, 7, 7, 6, 6, 4,
+        0, 4, 1, 5, 2, 6, 3, 7,
+    };
+
+    for (int i = 0; i < 8; i++)
+    {
+        positions.push_back(XMFLOAT3((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f));
+    }
+
+    AddShape(D3D11_PRIMITIVE_TOPOLOGY_LINELIST, &positions.front(), positions.size(), boxEdges, _countof(boxEdges));
+
+    positions.clear();
+
+    AddCircle(positions, indices, g_XMIdentityR0, g_XMIdentityR1);
+    AddCircle(positions, indices, g_XMIdentityR1, g_XMIdentityR2);
+    AddCircle(positions, indices, g_XMIdentityR2, g_XMIdentityR0);
+
+    AddShape(D3D11_PRIMITIVE_TOPOLOGY_LINELIST, &positions.front(), positions.size(), &indices.front(), indices.size());
+
+    positions.clear();
+    indices.clear();
+
+    AddCircle(positions, indices, g_XMIdentityR0, g_XMIdentityR2);
+
+    AddShape(D3D11_PRIMITIVE_TOPOLOGY_LINELIST, &positions.front(), positions.size(), &indices.front(), indices.size());
+}
+
+
+// Adds a shape to the CPU copy of the static buffers, which are rebuilt by the next End.
+size_t ShapeBatch::Impl::AddShape(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(vertexCount) XMFLOAT3 const* positions, size_t vertexCount,
+                                  _In_reads_(indexCount) uint16_t const* indices, size_t indexCount)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot add shapes inside a Begin/End pair");
+
+    if (!positions || !indices)
+        throw std::exception("Shape positions and indices cannot be null");
+
+    if (!vertexCount || vertexCount > 65536)
+        throw std::out_of_range("vertexCount parameter out of range");
+
+    if (!indexCount || mIndices.size() + indexCount > UINT32_MAX || mPositions.size() + vertexCount > INT32_MAX)
+        throw std::out_of_range("indexCount parameter out of range");
+
+    ShapeInfo shape;
+
+    shape.topology = topology;
+    shape.startIndex = static_cast<UINT>(mIndices.size());
+    shape.indexCount = static_cast<UINT>(indexCount);
+    shape.baseVertex = static_cast<INT>(mPositions.size());
+
+    mPositions.insert(mPositions.end(), positions, positions + vertexCount);
+    mIndices.insert(mIndices.end(), indices, indices + indexCount);
+
+    mShapes.push_back(shape);
+    mShapesDirty = true;
+
+    return mShapes.size() - 1;
+}
+
+
+void ShapeBatch::Impl::CreateShapeBuffers()
+{
+    ComPtr<ID3D11Device> device;
+
+    mDeviceContext->GetDevice(&device);
+
+    mVertexBuffer.Reset();
+    mIndexBuffer.Reset();
+
+    D3D11_BUFFER_DESC desc = { 0 };
+    D3D11_SUBRESOURCE_DATA data = { 0 };
+
+    desc.ByteWidth = static_cast<UINT>(mPositions.size() * sizeof(XMFLOAT3));
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+
+    data.pSysMem = &mPositions.front();
+
+    ThrowIfFailed(
+        device->CreateBuffer(&desc, &data, &mVertexBuffer)
+    );
+
+    SetDebugObjectName(mVertexBuffer.Get(), "DirectXTK:ShapeBatch");
+
+    desc.ByteWidth = static_cast<UINT>(mIndices.size() * sizeof(uint16_t));
+    desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+    data.pSysMem = &mIndices.front();
+
+    ThrowIfFailed(
+        device->CreateBuffer(&desc, &data, &mIndexBuffer)
+    );
+
+    SetDebugObjectName(mIndexBuffer.Get(), "DirectXTK:ShapeBatch");
+
+    mShapesDirty = false;
+}
+
+
+// Begins a batch of shape drawing operations.
+void ShapeBatch::Impl::Begin()
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot nest Begin calls");
+
+    // Deferred contexts cannot rely on NO_OVERWRITE on D3D11.0, so start each batch with a DISCARD.
+    if (mDeviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+    {
+        mCurrentInstance = 0;
+    }
+
+    mInBeginEndPair = true;
+}
+
+
+// Records one instance of a shape.
+void XM_CALLCONV ShapeBatch::Impl::Draw(size_t shape, FXMMATRIX transform, FXMVECTOR color)
+{
+    if (!mInBeginEndPair)
+        throw std::exception("Begin must be called before Draw");
+
+    if (shape >= mShapes.size())
+        throw std::out_of_range("shape parameter out of range");
+
+    XMMATRIX transpose = XMMatrixTranspose(transform);
+
+    ShapeInstance instance;
+
+    XMStoreFloat4(&instance.column[0], transpose.r[0]);
+    XMStoreFloat4(&instance.column[1], transpose.r[1]);
+    XMStoreFloat4(&instance.column[2], transpose.r[2]);
+    XMStoreFloat4(&instance.color, color);
+
+    mShapes[shape].instances.push_back(instance);
+}
+
+
+// Uploads the recorded instances and draws each shape that was used.
+void ShapeBatch::Impl::End()
+{
+    if (!mInBeginEndPair)
+        throw std::exception("Begin must be called before End");
+
+    mInBeginEndPair = false;
+
+    if (mShapesDirty)
+    {
+        CreateShapeBuffers();
+    }
+
+    ID3D11Buffer* vertexBuffers[2] = { mVertexBuffer.Get(), mInstanceBuffer.Get() };
+    UINT vertexStrides[2] = { sizeof(XMFLOAT3), sizeof(ShapeInstance) };
+    UINT vertexOffsets[2] = { 0, 0 };
+
+    mDeviceContext->IASetVertexBuffers(0, 2, vertexBuffers, vertexStrides, vertexOffsets);
+    mDeviceContext->IASetIndexBuffer(mIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+
+    for (auto it = mShapes.begin(); it != mShapes.end(); ++it)
+    {
+        auto& shape = *it;
+
+        size_t remaining = shape.instances.size();
+
+        if (!remaining)
+            continue;
+
+        mDeviceContext->IASetPrimitiveTopology(shape.topology);
+
+        auto source = &shape.instances.front();
+
+        // Shapes with more instances than fit in the buffer are drawn in several pieces.
+        while (remaining > 0)
+        {
+            if (mCurrentInstance >= mMaxInstances)
+            {
+                mCurrentInstance = 0;
+            }
+
+            size_t count = std::min(remaining, mMaxInstances - mCurrentInstance);
+
+            D3D11_MAP mapType = (mCurrentInstance == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+
+            D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+            ThrowIfFailed(
+                mDeviceContext->Map(mInstanceBuffer.Get(), 0, mapType, 0, &mappedResource)
+            );
+
+            memcpy(static_cast<ShapeInstance*>(mappedResource.pData) + mCurrentInstance, source, count * sizeof(ShapeInstance));
+
+            mDeviceContext->Unmap(mInstanceBuffer.Get(), 0);
+
+            mDeviceContext->DrawIndexedInstanced(shape.indexCount, static_cast<UINT>(count), shape.startIndex, shape.baseVertex, static_cast<UINT>(mCurrentInstance));
+
+            mCurrentInstance += count;
+            source += count;
+            remaining -= count;
+        }
+
+        shape.instances.clear();
+    }
+}
+
+
+// Public constructor.
+ShapeBatch::ShapeBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxInstances)
+  : pImpl(new Impl(deviceContext, maxInstances))
+{
+}
+
+
+// Move constructor.
+ShapeBatch::ShapeBatch(ShapeBatch&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+ShapeBatch& ShapeBatch::operator= (ShapeBatch&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+ShapeBatch::~ShapeBatch()
+{
+}
+
+
+size_t ShapeBatch::AddShape(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(vertexCount) XMFLOAT3 const* positions, size_t vertexCount,
+                            _In_reads_(indexCount) uint16_t const* indices, size_t indexCount)
+{
+    return pImpl->AddShape(topology, positions, vertexCount, indices, indexCount);
+}
+
+
+void ShapeBatch::Begin()
+{
+    pImpl->Begin();
+}
+
+
+void ShapeBatch::End()
+{
+    pImpl->End();
+}
+
+
+void XM_CALLCONV ShapeBatch::Draw(size_t shape, FXMMATRIX transform, FXMVECTOR color)
+{
+    pImpl->Draw(shape, transform, color);
+}
+
+
+void XM_CALLCONV ShapeBatch::Draw(BoundingBox const& box, FXMVECTOR color)
+{
+    XMMATRIX transform = XMMatrixScaling(box.Extents.x, box.Extents.y, box.Extents.z);
+
+    transform.r[3] = XMVectorSelect(g_XMIdentityR3, XMLoadFloat3(&box.Center), g_XMSelect1110);
+
+    pImpl->Draw(Shape_Box, transform, color);
+}
+
+
+void XM_CALLCONV ShapeBatch::Draw(BoundingOrientedBox const& box, FXMVECTOR color)
+{
+    XMMATRIX transform = XMMatrixMultiply(XMMatrixScaling(box.Extents.x, box.Extents.y, box.Extents.z),
+                                          XMMatrixRotationQuaternion(XMLoadFloat4(&box.Orientation)));
+
+    transform.r[3] = XMVectorSelect(g_XMIdentityR3, XMLoadFloat3(&box.Center), g_XMSelect1110);
+
+    pImpl->Draw(Shape_Box, transform, color);
+}
+
+
+void XM_CALLCONV ShapeBatch::Draw(BoundingSphere const& sphere, FXMVECTOR color)
+{
+    XMMATRIX transform = XMMatrixScaling(sphere.Radius, sphere.Radius, sphere.Radius);
+
+    transform.r[3] = XMVectorSelect(g_XMIdentityR3, XMLoadFloat3(&sphere.Center), g_XMSelect1110);
+
+    pImpl->Draw(Shape_Sphere, transform, color);
+}
@@ -37,6 +37,23 @@ namespace DirectX
         // Allocates or looks up the shared TData instance for the specified key.
         std::shared_ptr<TData> DemandCreate(TKey key)
         {
+            // Lock-free fast path, for the usual case of asking for the same key as last time.
+            {
+                FastPathReader reader(*mResourceMap);
+
+                FastEntry* entry = mResourceMap->fastEntry;
+
+                MemoryBarrier();
+
+                if (entry && entry->key == key)
+                {
+                    auto existingValue = entry->value.lock();
+
+                    if (existingValue)
+                        return existingValue;
+                }
+            }
+
             std::lock_guard<std::mutex> lock(mResourceMap->mutex);
 
             // Return an existing instance?
@@ -47,7 +64,11 @@ namespace DirectX
                 auto existingValue = pos->second.lock();
 
                 if (existingValue)
+                {
+                    mResourceMap->SetFastEntry(new FastEntry(key, existingValue));
+
                     return existingValue;
+                }
                 else
                     mResourceMap->erase(pos);
             }
@@ -57,15 +78,104 @@ namespace DirectX
 
             mResourceMap->insert(std::make_pair(key, newValue));
 
+            mResourceMap->SetFastEntry(new FastEntry(key, newValue));
+
             return newValue;
         }
 
 
     private:
+        // Last key resolved. Only holds a weak reference, so it never keeps TData alive. Entries are
+        // immutable once published, and replaced rather than modified.
+        struct FastEntry
+        {
+            FastEntry(TKey key, std::shared_ptr<TData> const& value)
+              : key(key),
+                value(value)
+            { }
+
+            TKey key;
+            std::weak_ptr<TData> value;
+        };
+
+
         // Keep track of all allocated TData instances.
         struct ResourceMap : public std::map<TKey, std::weak_ptr<TData>>
         {
+            ResourceMap()
+              : fastEntry(nullptr),
+                epoch(0)
+            {
+                readers[0] = 0;
+                readers[1] = 0;
+            }
+
+            ~ResourceMap()
+            {
+                delete fastEntry;
+            }
+
+            // Called with the mutex held. Waits for any fast path readers that might still see the old
+            // entry before freeing it: readers count against the epoch they started in, which is flipped here.
+            void SetFastEntry(_In_opt_ FastEntry* newEntry)
+            {
+                FastEntry* oldEntry = fastEntry;
+
+                MemoryBarrier();
+
+                fastEntry = newEntry;
+
+                LONG oldEpoch = InterlockedIncrement(&epoch) - 1;
+
+                while (readers[oldEpoch & 1] != 0)
+                {
+                    SwitchToThread();
+                }
+
+                delete oldEntry;
+            }
+
             std::mutex mutex;
+
+            FastEntry* volatile fastEntry;
+
+            volatile LONG epoch;
+            volatile LONG readers[2];
+        };
+
+
+        // Registers a fast path reader against the current epoch, retrying if it flips while registering.
+        class FastPathReader
+        {
+        public:
+            explicit FastPathReader(ResourceMap& resourceMap)
+              : mReaders(nullptr)
+            {
+                for (;;)
+                {
+                    LONG epoch = resourceMap.epoch;
+
+                    mReaders = &resourceMap.readers[epoch & 1];
+
+                    InterlockedIncrement(mReaders);
+
+                    if (resourceMap.epoch == epoch)
+                        break;
+
+                    InterlockedDecrement(mReaders);
+                }
+            }
+
+            ~FastPathReader()
+            {
+                InterlockedDecrement(mReaders);
+            }
+
+        private:
+            volatile LONG* mReaders;
+
+            FastPathReader(FastPathReader const&) DIRECTX_CTOR_DELETE
+            FastPathReader& operator= (FastPathReader const&) DIRECTX_CTOR_DELETE
         };
         
         std::shared_ptr<ResourceMap> mResourceMap;
@@ -94,6 +204,14 @@ namespace DirectX
                 {
                     mResourceMap->erase(pos);
                 }
+
+                // Drop the fast path entry too, so its weak reference doesn't hold on to our memory.
+                FastEntry* entry = mResourceMap->fastEntry;
+
+                if (entry && entry->key == mKey && entry->value.expired())
+                {
+                    mResourceMap->SetFastEntry(nullptr);
+                }
             }
 
             TKey mKey;
@@ -14,6 +14,8 @@
 #include "pch.h"
 #include "SimpleMath.h"
 
+#include <stdexcept>
+
 namespace DirectX
 {
 
@@ -83,6 +85,581 @@ namespace SimpleMath
 
     const Quaternion Quaternion::Identity = { 0.f, 0.f, 0.f, 1.f };
 #endif
+
+/****************************************************************************
+ *
+ * Structure-of-arrays helpers
+ *
+ ****************************************************************************/
+
+namespace
+{
+    const size_t SOA_LANES = 4;
+
+    inline size_t SoACapacity( size_t count )
+    {
+        return ( count + SOA_LANES - 1 ) & ~( SOA_LANES - 1 );
+    }
+
+    float* AllocateStreams( size_t capacity, size_t streams )
+    {
+        if ( !capacity )
+            return nullptr;
+
+        auto ptr = reinterpret_cast<float*>( _aligned_malloc( sizeof(float) * capacity * streams, 16 ) );
+        if ( !ptr )
+            throw std::bad_alloc();
+
+        return ptr;
+    }
+
+    // Copies the first count elements of each stream, zeroing the rest of the destination
+    void CopyStreams( _Out_writes_(destCapacity * streams) float* dest, size_t destCapacity,
+                      _In_reads_opt_(srcCapacity * streams) const float* src, size_t srcCapacity,
+                      size_t count, size_t streams )
+    {
+        if ( !dest )
+            return;
+
+        for( size_t j = 0; j < streams; ++j )
+        {
+            if ( count > 0 )
+                memcpy( dest + j * destCapacity, src + j * srcCapacity, sizeof(float) * count );
+
+            memset( dest + j * destCapacity + count, 0, sizeof(float) * ( destCapacity - count ) );
+        }
+    }
+
+    // result = a + t * ( b - a ) over a run of aligned floats
+    void LerpStreams( _In_reads_(count) const float* a, _In_reads_(count) const float* b, size_t count, float t, _Out_writes_(count) float* result )
+    {
+        assert( ( count % SOA_LANES ) == 0 );
+
+        for( size_t i = 0; i < count; i += SOA_LANES )
+        {
+            XMVECTOR A = XMLoadFloat4A( reinterpret_cast<const XMFLOAT4A*>( a + i ) );
+            XMVECTOR B = XMLoadFloat4A( reinterpret_cast<const XMFLOAT4A*>( b + i ) );
+            XMStoreFloat4A( reinterpret_cast<XMFLOAT4A*>( result + i ), XMVectorLerp( A, B, t ) );
+        }
+    }
+
+    inline XMVECTOR LoadLanes( _In_reads_(4) const float* ptr )
+    {
+        return XMLoadFloat4A( reinterpret_cast<const XMFLOAT4A*>( ptr ) );
+    }
+
+    inline void StoreLanes( _Out_writes_(4) float* ptr, FXMVECTOR V )
+    {
+        XMStoreFloat4A( reinterpret_cast<XMFLOAT4A*>( ptr ), V );
+    }
+}
+
+
+/****************************************************************************
+ *
+ * Vector3Array
+ *
+ ****************************************************************************/
+
+Vector3Array::Vector3Array( size_t count ) :
+    mCount(0),
+    mCapacity(0)
+{
+    Resize( count );
+}
+
+Vector3Array::Vector3Array( const Vector3* varray, size_t count ) :
+    mCount(0),
+    mCapacity(0)
+{
+    Load( varray, count );
+}
+
+Vector3Array::Vector3Array( const Vector3Array& other ) :
+    mCount(0),
+    mCapacity(0)
+{
+    *this = other;
+}
+
+Vector3Array::Vector3Array( Vector3Array&& other ) :
+    mData( std::move( other.mData ) ),
+    mCount( other.mCount ),
+    mCapacity( other.mCapacity )
+{
+    other.mCount = other.mCapacity = 0;
+}
+
+Vector3Array& Vector3Array::operator= ( const Vector3Array& other )
+{
+    if ( this != &other )
+    {
+        std::unique_ptr<float[], aligned_deleter> data( AllocateStreams( other.mCapacity, 3 ) );
+        if ( data )
+            memcpy( data.get(), other.mData.get(), sizeof(float) * other.mCapacity * 3 );
+
+        mData = std::move( data );
+        mCount = other.mCount;
+        mCapacity = other.mCapacity;
+    }
+
+    return *this;
+}
+
+Vector3Array& Vector3Array::operator= ( Vector3Array&& other )
+{
+    if ( this != &other )
+    {
+        mData = std::move( other.mData );
+        mCount = other.mCount;
+        mCapacity = other.mCapacity;
+
+        other.mCount = other.mCapacity = 0;
+    }
+
+    return *this;
+}
+
+void Vector3Array::Resize( size_t count )
+{
+    size_t capacity = SoACapacity( count );
+    if ( capacity != mCapacity )
+    {
+        std::unique_ptr<float[], aligned_deleter> data( AllocateStreams( capacity, 3 ) );
+        CopyStreams( data.get(), capacity, mData.get(), mCapacity, std::min( mCount, count ), 3 );
+
+        mData = std::move( data );
+        mCapacity = capacity;
+    }
+    else if ( count > mCount )
+    {
+        for( size_t j = 0; j < 3; ++j )
+        {
+            memset( mData.get() + j * mCapacity + mCount, 0, sizeof(float) * ( count - mCount ) );
+        }
+    }
+
+    mCount = count;
+}
+
+void Vector3Array::Load( const Vector3* varray, size_t count )
+{
+    Resize( count );
+
+    float* x = X();
+    float* y = Y();
+    float* z = Z();
+    for( size_t i = 0; i < count; ++i )
+    {
+        x[ i ] = varray[ i ].x;
+        y[ i ] = varray[ i ].y;
+        z[ i ] = varray[ i ].z;
+    }
+}
+
+void Vector3Array::Store( Vector3* resultArray, size_t count ) const
+{
+    count = std::min( count, mCount );
+
+    const float* x = X();
+    const float* y = Y();
+    const float* z = Z();
+    for( size_t i = 0; i < count; ++i )
+    {
+        resultArray[ i ].x = x[ i ];
+        resultArray[ i ].y = y[ i ];
+        resultArray[ i ].z = z[ i ];
+    }
+}
+
+// The three streams are contiguous, so element-wise operations run over all of them in one loop
+Vector3Array& Vector3Array::operator+= ( const Vector3Array& V )
+{
+    if ( V.mCount != mCount )
+        throw std::invalid_argument( "Vector3Array" );
+
+    float* a = mData.get();
+    const float* b = V.mData.get();
+    for( size_t i = 0; i < mCapacity * 3; i += SOA_LANES )
+    {
+        StoreLanes( a + i, XMVectorAdd( LoadLanes( a + i ), LoadLanes( b + i ) ) );
+    }
+
+    return *this;
+}
+
+Vector3Array& Vector3Array::operator-= ( const Vector3Array& V )
+{
+    if ( V.mCount != mCount )
+        throw std::invalid_argument( "Vector3Array" );
+
+    float* a = mData.get();
+    const float* b = V.mData.get();
+    for( size_t i = 0; i < mCapacity * 3; i += SOA_LANES )
+    {
+        StoreLanes( a + i, XMVectorSubtract( LoadLanes( a + i ), LoadLanes( b + i ) ) );
+    }
+
+    return *this;
+}
+
+Vector3Array& Vector3Array::operator*= ( float S )
+{
+    float* a = mData.get();
+    for( size_t i = 0; i < mCapacity * 3; i += SOA_LANES )
+    {
+        StoreLanes( a + i, XMVectorScale( LoadLanes( a + i ), S ) );
+    }
+
+    return *this;
+}
+
+void Vector3Array::AddScaled( const Vector3Array& V, float S )
+{
+    if ( V.mCount != mCount )
+        throw std::invalid_argument( "Vector3Array" );
+
+    XMVECTOR scale = XMVectorReplicate( S );
+
+    float* a = mData.get();
+    const float* b = V.mData.get();
+    for( size_t i = 0; i < mCapacity * 3; i += SOA_LANES )
+    {
+        StoreLanes( a + i, XMVectorMultiplyAdd( LoadLanes( b + i ), scale, LoadLanes( a + i ) ) );
+    }
+}
+
+void Vector3Array::Lerp( const Vector3Array& v1, const Vector3Array& v2, float t, Vector3Array& result )
+{
+    if ( v1.mCount != v2.mCount )
+        throw std::invalid_argument( "Vector3Array" );
+
+    result.Resize( v1.mCount );
+
+    LerpStreams( v1.mData.get(), v2.mData.get(), v1.mCapacity * 3, t, result.mData.get() );
+}
+
+void Vector3Array::Transform( const Vector3Array& v, const Matrix& m, Vector3Array& result )
+{
+    result.Resize( v.mCount );
+
+    XMVECTOR m11 = XMVectorReplicate( m._11 ), m12 = XMVectorReplicate( m._12 ), m13 = XMVectorReplicate( m._13 ), m14 = XMVectorReplicate( m._14 );
+    XMVECTOR m21 = XMVectorReplicate( m._21 ), m22 = XMVectorReplicate( m._22 ), m23 = XMVectorReplicate( m._23 ), m24 = XMVectorReplicate( m._24 );
+    XMVECTOR m31 = XMVectorReplicate( m._31 ), m32 = XMVectorReplicate( m._32 ), m33 = XMVectorReplicate( m._33 ), m34 = XMVectorReplicate( m._34 );
+    XMVECTOR m41 = XMVectorReplicate( m._41 ), m42 = XMVectorReplicate( m._42 ), m43 = XMVectorReplicate( m._43 ), m44 = XMVectorReplicate( m._44 );
+
+    const float* x = v.X();
+    const float* y = v.Y();
+    const float* z = v.Z();
+
+    float* rx = result.X();
+    float* ry = result.Y();
+    float* rz = result.Z();
+
+    for( size_t i = 0; i < v.mCapacity; i += SOA_LANES )
+    {
+        XMVECTOR X = LoadLanes( x + i );
+        XMVECTOR Y = LoadLanes( y + i );
+        XMVECTOR Z = LoadLanes( z + i );
+
+        XMVECTOR RX = XMVectorMultiplyAdd( Z, m31, XMVectorMultiplyAdd( Y, m21, XMVectorMultiplyAdd( X, m11, m41 ) ) );
+        XMVECTOR RY = XMVectorMultiplyAdd( Z, m32, XMVectorMultiplyAdd( Y, m22, XMVectorMultiplyAdd( X, m12, m42 ) ) );
+        XMVECTOR RZ = XMVectorMultiplyAdd( Z, m33, XMVectorMultiplyAdd( Y, m23, XMVectorMultiplyAdd( X, m13, m43 ) ) );
+        XMVECTOR RW = XMVectorMultiplyAdd( Z, m34, XMVectorMultiplyAdd( Y, m24, XMVectorMultiplyAdd( X, m14, m44 ) ) );
+
+        // Same projection as XMVector3TransformCoord
+        StoreLanes( rx + i, XMVectorDivide( RX, RW ) );
+        StoreLanes( ry + i, XMVectorDivide( RY, RW ) );
+        StoreLanes( rz + i, XMVectorDivide( RZ, RW ) );
+    }
+}
+
+void Vector3Array::TransformNormal( const Vector3Array& v, const Matrix& m, Vector3Array& result )
+{
+    result.Resize( v.mCount );
+
+    XMVECTOR m11 = XMVectorReplicate( m._11 ), m12 = XMVectorReplicate( m._12 ), m13 = XMVectorReplicate( m._13 );
+    XMVECTOR m21 = XMVectorReplicate( m._21 ), m22 = XMVectorReplicate( m._22 ), m23 = XMVectorReplicate( m._23 );
+    XMVECTOR m31 = XMVectorReplicate( m._31 ), m32 = XMVectorReplicate( m._32 ), m33 = XMVectorReplicate( m._33 );
+
+    const float* x = v.X();
+    const float* y = v.Y();
+    const float* z = v.Z();
+
+    float* rx = result.X();
+    float* ry = result.Y();
+    float* rz = result.Z();
+
+    for( size_t i = 0; i < v.mCapacity; i += SOA_LANES )
+    {
+        XMVECTOR X = LoadLanes( x + i );
+        XMVECTOR Y = LoadLanes( y + i );
+        XMVECTOR Z = LoadLanes( z + i );
+
+        StoreLanes( rx + i, XMVectorMultiplyAdd( Z, m31, XMVectorMultiplyAdd( Y, m21, XMVectorMultiply( X, m11 ) ) ) );
+        StoreLanes( ry + i, XMVectorMultiplyAdd( Z, m32, XMVectorMultiplyAdd( Y, m22, XMVectorMultiply( X, m12 ) ) ) );
+        StoreLanes( rz + i, XMVectorMultiplyAdd( Z, m33, XMVectorMultiplyAdd( Y, m23, XMVectorMultiply( X, m13 ) ) ) );
+    }
+}
+
+
+/****************************************************************************
+ *
+ * TransformArray
+ *
+ ****************************************************************************/
+
+TransformArray::TransformArray( size_t count ) :
+    mCount(0),
+    mCapacity(0)
+{
+    Resize( count );
+}
+
+TransformArray::TransformArray( const TransformArray& other ) :
+    mCount(0),
+    mCapacity(0)
+{
+    *this = other;
+}
+
+TransformArray::TransformArray( TransformArray&& other ) :
+    mData( std::move( other.mData ) ),
+    mCount( other.mCount ),
+    mCapacity( other.mCapacity )
+{
+    other.mCount = other.mCapacity = 0;
+}
+
+TransformArray& TransformArray::operator= ( const TransformArray& other )
+{
+    if ( this != &other )
+    {
+        std::unique_ptr<float[], aligned_deleter> data( AllocateStreams( other.mCapacity, STREAM_COUNT ) );
+        if ( data )
+            memcpy( data.get(), other.mData.get(), sizeof(float) * other.mCapacity * STREAM_COUNT );
+
+        mData = std::move( data );
+        mCount = other.mCount;
+        mCapacity = other.mCapacity;
+    }
+
+    return *this;
+}
+
+TransformArray& TransformArray::operator= ( TransformArray&& other )
+{
+    if ( this != &other )
+    {
+        mData = std::move( other.mData );
+        mCount = other.mCount;
+        mCapacity = other.mCapacity;
+
+        other.mCount = other.mCapacity = 0;
+    }
+
+    return *this;
+}
+
+void TransformArray::Resize( size_t count )
+{
+    size_t capacity = SoACapacity( count );
+    if ( capacity != mCapacity )
+    {
+        std::unique_ptr<float[], aligned_deleter> data( AllocateStreams( capacity, STREAM_COUNT ) );
+        CopyStreams( data.get(), capacity, mData.get(), mCapacity, std::min( mCount, count ), STREAM_COUNT );
+
+        mData = std::move( data );
+        mCapacity = capacity;
+    }
+
+    for( size_t i = mCount; i < count; ++i )
+    {
+        Set( i, Vector3::One, Quaternion::Identity, Vector3::Zero );
+    }
+
+    mCount = count;
+}
+
+void TransformArray::ComposeMatrices( size_t index, XMMATRIX* result ) const
+{
+    assert( ( index % SOA_LANES ) == 0 );
+
+    XMVECTOR X = LoadLanes( Stream( RX ) + index );
+    XMVECTOR Y = LoadLanes( Stream( RY ) + index );
+    XMVECTOR Z = LoadLanes( Stream( RZ ) + index );
+    XMVECTOR W = LoadLanes( Stream( RW ) + index );
+
+    XMVECTOR X2 = XMVectorAdd( X, X );
+    XMVECTOR Y2 = XMVectorAdd( Y, Y );
+    XMVECTOR Z2 = XMVectorAdd( Z, Z );
+
+    XMVECTOR XX = XMVectorMultiply( X, X2 );
+    XMVECTOR YY = XMVectorMultiply( Y, Y2 );
+    XMVECTOR ZZ = XMVectorMultiply( Z, Z2 );
+    XMVECTOR XY = XMVectorMultiply( X, Y2 );
+    XMVECTOR XZ = XMVectorMultiply( X, Z2 );
+    XMVECTOR YZ = XMVectorMultiply( Y, Z2 );
+    XMVECTOR XW = XMVectorMultiply( W, X2 );
+    XMVECTOR YW = XMVectorMultiply( W, Y2 );
+    XMVECTOR ZW = XMVectorMultiply( W, Z2 );
+
+    // Rotation matrix rows as in XMMatrixRotationQuaternion, scaled per row
+    XMVECTOR scaleX = LoadLanes( Stream( SX ) + index );
+    XMVECTOR scaleY = LoadLanes( Stream( SY ) + index );
+    XMVECTOR scaleZ = LoadLanes( Stream( SZ ) + index );
+
+    XMVECTOR m11 = XMVectorMultiply( XMVectorSubtract( g_XMOne, XMVectorAdd( YY, ZZ ) ), scaleX );
+    XMVECTOR m12 = XMVectorMultiply( XMVectorAdd( XY, ZW ), scaleX );
+    XMVECTOR m13 = XMVectorMultiply( XMVectorSubtract( XZ, YW ), scaleX );
+
+    XMVECTOR m21 = XMVectorMultiply( XMVectorSubtract( XY, ZW ), scaleY );
+    XMVECTOR m22 = XMVectorMultiply( XMVectorSubtract( g_XMOne, XMVectorAdd( XX, ZZ ) ), scaleY );
+    XMVECTOR m23 = XMVectorMultiply( XMVectorAdd( YZ, XW ), scaleY );
+
+    XMVECTOR m31 = XMVectorMultiply( XMVectorAdd( XZ, YW ), scaleZ );
+    XMVECTOR m32 = XMVectorMultiply( XMVectorSubtract( YZ, XW ), scaleZ );
+    XMVECTOR m33 = XMVectorMultiply( XMVectorSubtract( g_XMOne, XMVectorAdd( XX, YY ) ), scaleZ );
+
+    XMVECTOR zero = XMVectorZero();
+
+    // Transposing each group of rows gives that row for each of the four matrices
+    XMMATRIX R0 = XMMatrixTranspose( XMMATRIX( m11, m12, m13, zero ) );
+    XMMATRIX R1 = XMMatrixTranspose( XMMATRIX( m21, m22, m23, zero ) );
+    XMMATRIX R2 = XMMatrixTranspose( XMMATRIX( m31, m32, m33, zero ) );
+    XMMATRIX R3 = XMMatrixTranspose( XMMATRIX( LoadLanes( Stream( TX ) + index ),
+                                               LoadLanes( Stream( TY ) + index ),
+                                               LoadLanes( Stream( TZ ) + index ),
+                                               g_XMOne ) );
+
+    for( size_t j = 0; j < SOA_LANES; ++j )
+    {
+        result[ j ] = XMMATRIX( R0.r[ j ], R1.r[ j ], R2.r[ j ], R3.r[ j ] );
+    }
+}
+
+void TransformArray::GetMatrices( XMMATRIX* result, size_t count ) const
+{
+    count = std::min( count, mCount );
+
+    XMMATRIX group[ SOA_LANES ];
+    for( size_t i = 0; i < count; i += SOA_LANES )
+    {
+        ComposeMatrices( i, group );
+
+        size_t n = std::min( count - i, SOA_LANES );
+        for( size_t j = 0; j < n; ++j )
+        {
+            result[ i + j ] = group[ j ];
+        }
+    }
+}
+
+void TransformArray::GetMatrices( Matrix* result, size_t count ) const
+{
+    count = std::min( count, mCount );
+
+    XMMATRIX group[ SOA_LANES ];
+    for( size_t i = 0; i < count; i += SOA_LANES )
+    {
+        ComposeMatrices( i, group );
+
+        size_t n = std::min( count - i, SOA_LANES );
+        for( size_t j = 0; j < n; ++j )
+        {
+            XMStoreFloat4x4( &result[ i + j ], group[ j ] );
+        }
+    }
+}
+
+void TransformArray::Lerp( const TransformArray& t1, const TransformArray& t2, float t, TransformArray& result )
+{
+    if ( t1.mCount != t2.mCount )
+        throw std::invalid_argument( "TransformArray" );
+
+    result.Resize( t1.mCount );
+
+    const size_t capacity = t1.mCapacity;
+
+    // Scale and translation (three contiguous streams each)
+    LerpStreams( t1.Stream( SX ), t2.Stream( SX ), capacity * 3, t, result.Stream( SX ) );
+    LerpStreams( t1.Stream( TX ), t2.Stream( TX ), capacity * 3, t, result.Stream( TX ) );
+
+    // Rotation, matching Quaternion::Lerp
+    XMVECTOR tv = XMVectorReplicate( t );
+    XMVECTOR t1v = XMVectorReplicate( 1.f - t );
+
+    for( size_t i = 0; i < capacity; i += SOA_LANES )
+    {
+        XMVECTOR X0 = LoadLanes( t1.Stream( RX ) + i ), Y0 = LoadLanes( t1.Stream( RY ) + i ), Z0 = LoadLanes( t1.Stream( RZ ) + i ), W0 = LoadLanes( t1.Stream( RW ) + i );
+        XMVECTOR X1 = LoadLanes( t2.Stream( RX ) + i ), Y1 = LoadLanes( t2.Stream( RY ) + i ), Z1 = LoadLanes( t2.Stream( RZ ) + i ), W1 = LoadLanes( t2.Stream( RW ) + i );
+
+        XMVECTOR dot = XMVectorMultiplyAdd( W0, W1, XMVectorMultiplyAdd( Z0, Z1, XMVectorMultiplyAdd( Y0, Y1, XMVectorMultiply( X0, X1 ) ) ) );
+
+        XMVECTOR t2v = XMVectorSelect( tv, XMVectorNegate( tv ), XMVectorLess( dot, XMVectorZero() ) );
+
+        XMVECTOR X = XMVectorMultiplyAdd( X1, t2v, XMVectorMultiply( X0, t1v ) );
+        XMVECTOR Y = XMVectorMultiplyAdd( Y1, t2v, XMVectorMultiply( Y0, t1v ) );
+        XMVECTOR Z = XMVectorMultiplyAdd( Z1, t2v, XMVectorMultiply( Z0, t1v ) );
+        XMVECTOR W = XMVectorMultiplyAdd( W1, t2v, XMVectorMultiply( W0, t1v ) );
+
+        XMVECTOR lengthSq = XMVectorMultiplyAdd( W, W, XMVectorMultiplyAdd( Z, Z, XMVectorMultiplyAdd( Y, Y, XMVectorMultiply( X, X ) ) ) );
+        XMVECTOR invLength = XMVectorReciprocalSqrt( lengthSq );
+
+        StoreLanes( result.Stream( RX ) + i, XMVectorMultiply( X, invLength ) );
+        StoreLanes( result.Stream( RY ) + i, XMVectorMultiply( Y, invLength ) );
+        StoreLanes( result.Stream( RZ ) + i, XMVectorMultiply( Z, invLength ) );
+        StoreLanes( result.Stream( RW ) + i, XMVectorMultiply( W, invLength ) );
+    }
+}
+
+void TransformArray::Slerp( const TransformArray& t1, const TransformArray& t2, float t, TransformArray& result )
+{
+    if ( t1.mCount != t2.mCount )
+        throw std::invalid_argument( "TransformArray" );
+
+    result.Resize( t1.mCount );
+
+    const size_t capacity = t1.mCapacity;
+
+    // Scale and translation (three contiguous streams each)
+    LerpStreams( t1.Stream( SX ), t2.Stream( SX ), capacity * 3, t, result.Stream( SX ) );
+    LerpStreams( t1.Stream( TX ), t2.Stream( TX ), capacity * 3, t, result.Stream( TX ) );
+
+    // Rotation, matching XMQuaternionSlerp
+    static const XMVECTORF32 OneMinusEpsilon = { 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f, 1.0f - 0.00001f };
+
+    XMVECTOR tv = XMVectorReplicate( t );
+    XMVECTOR t1v = XMVectorReplicate( 1.f - t );
+
+    for( size_t i = 0; i < capacity; i += SOA_LANES )
+    {
+        XMVECTOR X0 = LoadLanes( t1.Stream( RX ) + i ), Y0 = LoadLanes( t1.Stream( RY ) + i ), Z0 = LoadLanes( t1.Stream( RZ ) + i ), W0 = LoadLanes( t1.Stream( RW ) + i );
+        XMVECTOR X1 = LoadLanes( t2.Stream( RX ) + i ), Y1 = LoadLanes( t2.Stream( RY ) + i ), Z1 = LoadLanes( t2.Stream( RZ ) + i ), W1 = LoadLanes( t2.Stream( RW ) + i );
+
+        XMVECTOR cosOmega = XMVectorMultiplyAdd( W0, W1, XMVectorMultiplyAdd( Z0, Z1, XMVectorMultiplyAdd( Y0, Y1, XMVectorMultiply( X0, X1 ) ) ) );
+
+        XMVECTOR sign = XMVectorSelect( g_XMOne, g_XMNegativeOne, XMVectorLess( cosOmega, XMVectorZero() ) );
+        cosOmega = XMVectorMultiply( cosOmega, sign );
+
+        XMVECTOR sinOmega = XMVectorSqrt( XMVectorNegativeMultiplySubtract( cosOmega, cosOmega, g_XMOne ) );
+        XMVECTOR omega = XMVectorATan2( sinOmega, cosOmega );
+        XMVECTOR invSinOmega = XMVectorReciprocal( sinOmega );
+
+        XMVECTOR s0 = XMVectorMultiply( XMVectorSin( XMVectorMultiply( t1v, omega ) ), invSinOmega );
+        XMVECTOR s1 = XMVectorMultiply( XMVectorSin( XMVectorMultiply( tv, omega ) ), invSinOmega );
+
+        XMVECTOR control = XMVectorLess( cosOmega, OneMinusEpsilon );
+        s0 = XMVectorSelect( t1v, s0, control );
+        s1 = XMVectorMultiply( XMVectorSelect( tv, s1, control ), sign );
+
+        StoreLanes( result.Stream( RX ) + i, XMVectorMultiplyAdd( X1, s1, XMVectorMultiply( X0, s0 ) ) );
+        StoreLanes( result.Stream( RY ) + i, XMVectorMultiplyAdd( Y1, s1, XMVectorMultiply( Y0, s0 ) ) );
+        StoreLanes( result.Stream( RZ ) + i, XMVectorMultiplyAdd( Z1, s1, XMVectorMultiply( Z0, s0 ) ) );
+        StoreLanes( result.Stream( RW ) + i, XMVectorMultiplyAdd( W1, s1, XMVectorMultiply( W0, s0 ) ) );
+    }
+}
+
 }
 
 }
\ No newline at end of file
@@ -38,6 +38,9 @@ struct SkinnedEffectConstants
     XMMATRIX worldViewProj;
 
     XMVECTOR bones[SkinnedEffect::MaxBones][3];
+
+    uint32_t firstBone;
+    uint32_t firstBonePadding[3];
 };
 
 static_assert( ( sizeof(SkinnedEffectConstants) % 16 ) == 0, "CB size not padded correctly" );
@@ -48,9 +51,9 @@ struct SkinnedEffectTraits
 {
     typedef SkinnedEffectConstants ConstantBufferType;
 
-    static const int VertexShaderCount = 9;
+    static const int VertexShaderCount = 27;
     static const int PixelShaderCount = 3;
-    static const int ShaderPermutationCount = 18;
+    static const int ShaderPermutationCount = 54;
 };
 
 
@@ -63,6 +66,9 @@ public:
     bool preferPerPixelLighting;
     int weightsPerVertex;
 
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> boneBuffer;
+    bool dualQuaternion;
+
     EffectLights lights;
 
     int GetCurrentShaderPermutation() const;
@@ -87,6 +93,30 @@ namespace
     #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingTwoBones.inc"
     #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingFourBones.inc"
 
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedVertexLightingOneBoneBuffer.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedVertexLightingTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedVertexLightingFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedOneLightOneBoneBuffer.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedOneLightTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedOneLightFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingOneBoneBuffer.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedVertexLightingOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedVertexLightingTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedVertexLightingFourBonesDualQuaternion.inc"
+
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedOneLightOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedOneLightTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedOneLightFourBonesDualQuaternion.inc"
+
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/XboxOneSkinnedEffect_VSSkinnedPixelLightingFourBonesDualQuaternion.inc"
+
     #include "Shaders/Compiled/XboxOneSkinnedEffect_PSSkinnedVertexLighting.inc"
     #include "Shaders/Compiled/XboxOneSkinnedEffect_PSSkinnedVertexLightingNoFog.inc"
     #include "Shaders/Compiled/XboxOneSkinnedEffect_PSSkinnedPixelLighting.inc"
@@ -103,6 +133,30 @@ namespace
     #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingTwoBones.inc"
     #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingFourBones.inc"
 
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedVertexLightingOneBoneBuffer.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedVertexLightingTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedVertexLightingFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedOneLightOneBoneBuffer.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedOneLightTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedOneLightFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingOneBoneBuffer.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingTwoBonesBuffer.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingFourBonesBuffer.inc"
+
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedVertexLightingOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedVertexLightingTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedVertexLightingFourBonesDualQuaternion.inc"
+
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedOneLightOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedOneLightTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedOneLightFourBonesDualQuaternion.inc"
+
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingOneBoneDualQuaternion.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingTwoBonesDualQuaternion.inc"
+    #include "Shaders/Compiled/SkinnedEffect_VSSkinnedPixelLightingFourBonesDualQuaternion.inc"
+
     #include "Shaders/Compiled/SkinnedEffect_PSSkinnedVertexLighting.inc"
     #include "Shaders/Compiled/SkinnedEffect_PSSkinnedVertexLightingNoFog.inc"
     #include "Shaders/Compiled/SkinnedEffect_PSSkinnedPixelLighting.inc"
@@ -123,6 +177,30 @@ const ShaderBytecode EffectBase<SkinnedEffectTraits>::VertexShaderBytecode[] =
     { SkinnedEffect_VSSkinnedPixelLightingOneBone,    sizeof(SkinnedEffect_VSSkinnedPixelLightingOneBone)    },
     { SkinnedEffect_VSSkinnedPixelLightingTwoBones,   sizeof(SkinnedEffect_VSSkinnedPixelLightingTwoBones)   },
     { SkinnedEffect_VSSkinnedPixelLightingFourBones,  sizeof(SkinnedEffect_VSSkinnedPixelLightingFourBones)  },
+
+    { SkinnedEffect_VSSkinnedVertexLightingOneBoneBuffer,            sizeof(SkinnedEffect_VSSkinnedVertexLightingOneBoneBuffer)           },
+    { SkinnedEffect_VSSkinnedVertexLightingTwoBonesBuffer,           sizeof(SkinnedEffect_VSSkinnedVertexLightingTwoBonesBuffer)          },
+    { SkinnedEffect_VSSkinnedVertexLightingFourBonesBuffer,          sizeof(SkinnedEffect_VSSkinnedVertexLightingFourBonesBuffer)         },
+
+    { SkinnedEffect_VSSkinnedOneLightOneBoneBuffer,                  sizeof(SkinnedEffect_VSSkinnedOneLightOneBoneBuffer)                 },
+    { SkinnedEffect_VSSkinnedOneLightTwoBonesBuffer,                 sizeof(SkinnedEffect_VSSkinnedOneLightTwoBonesBuffer)                },
+    { SkinnedEffect_VSSkinnedOneLightFourBonesBuffer,                sizeof(SkinnedEffect_VSSkinnedOneLightFourBonesBuffer)               },
+
+    { SkinnedEffect_VSSkinnedPixelLightingOneBoneBuffer,             sizeof(SkinnedEffect_VSSkinnedPixelLightingOneBoneBuffer)            },
+    { SkinnedEffect_VSSkinnedPixelLightingTwoBonesBuffer,            sizeof(SkinnedEffect_VSSkinnedPixelLightingTwoBonesBuffer)           },
+    { SkinnedEffect_VSSkinnedPixelLightingFourBonesBuffer,           sizeof(SkinnedEffect_VSSkinnedPixelLightingFourBonesBuffer)          },
+
+    { SkinnedEffect_VSSkinnedVertexLightingOneBoneDualQuaternion,    sizeof(SkinnedEffect_VSSkinnedVertexLightingOneBoneDualQuaternion)   },
+    { SkinnedEffect_VSSkinnedVertexLightingTwoBonesDualQuaternion,   sizeof(SkinnedEffect_VSSkinnedVertexLightingTwoBonesDualQuaternion)  },
+    { SkinnedEffect_VSSkinnedVertexLightingFourBonesDualQuaternion,  sizeof(SkinnedEffect_VSSkinnedVertexLightingFourBonesDualQuaternion) },
+
+    { SkinnedEffect_VSSkinnedOneLightOneBoneDualQuaternion,          sizeof(SkinnedEffect_VSSkinnedOneLightOneBoneDualQuaternion)         },
+    { SkinnedEffect_VSSkinnedOneLightTwoBonesDualQuaternion,         sizeof(SkinnedEffect_VSSkinnedOneLightTwoBonesDualQuaternion)        },
+    { SkinnedEffect_VSSkinnedOneLightFourBonesDualQuaternion,        sizeof(SkinnedEffect_VSSkinnedOneLightFourBonesDualQuaternion)       },
+
+    { SkinnedEffect_VSSkinnedPixelLightingOneBoneDualQuaternion,     sizeof(SkinnedEffect_VSSkinnedPixelLightingOneBoneDualQuaternion)    },
+    { SkinnedEffect_VSSkinnedPixelLightingTwoBonesDualQuaternion,    sizeof(SkinnedEffect_VSSkinnedPixelLightingTwoBonesDualQuaternion)   },
+    { SkinnedEffect_VSSkinnedPixelLightingFourBonesDualQuaternion,   sizeof(SkinnedEffect_VSSkinnedPixelLightingFourBonesDualQuaternion)  },
 };
 
 
@@ -148,6 +226,48 @@ const int EffectBase<SkinnedEffectTraits>::VertexShaderIndices[] =
     7,      // pixel lighting, two bones, no fog
     8,      // pixel lighting, four bones
     8,      // pixel lighting, four bones, no fog
+
+    9,      // vertex lighting, one bone, bone buffer
+    9,      // vertex lighting, one bone, bone buffer, no fog
+    10,     // vertex lighting, two bones, bone buffer
+    10,     // vertex lighting, two bones, bone buffer, no fog
+    11,     // vertex lighting, four bones, bone buffer
+    11,     // vertex lighting, four bones, bone buffer, no fog
+    
+    12,     // one light, one bone, bone buffer
+    12,     // one light, one bone, bone buffer, no fog
+    13,     // one light, two bones, bone buffer
+    13,     // one light, two bones, bone buffer, no fog
+    14,     // one light, four bones, bone buffer
+    14,     // one light, four bones, bone buffer, no fog
+    
+    15,     // pixel lighting, one bone, bone buffer
+    15,     // pixel lighting, one bone, bone buffer, no fog
+    16,     // pixel lighting, two bones, bone buffer
+    16,     // pixel lighting, two bones, bone buffer, no fog
+    17,     // pixel lighting, four bones, bone buffer
+    17,     // pixel lighting, four bones, bone buffer, no fog
+
+    18,     // vertex lighting, one bone, dual quaternions
+    18,     // vertex lighting, one bone, dual quaternions, no fog
+    19,     // vertex lighting, two bones, dual quaternions
+    19,     // vertex lighting, two bones, dual quaternions, no fog
+    20,     // vertex lighting, four bones, dual quaternions
+    20,     // vertex lighting, four bones, dual quaternions, no fog
+    
+    21,     // one light, one bone, dual quaternions
+    21,     // one light, one bone, dual quaternions, no fog
+    22,     // one light, two bones, dual quaternions
+    22,     // one light, two bones, dual quaternions, no fog
+    23,     // one light, four bones, dual quaternions
+    23,     // one light, four bones, dual quaternions, no fog
+    
+    24,     // pixel lighting, one bone, dual quaternions
+    24,     // pixel lighting, one bone, dual quaternions, no fog
+    25,     // pixel lighting, two bones, dual quaternions
+    25,     // pixel lighting, two bones, dual quaternions, no fog
+    26,     // pixel lighting, four bones, dual quaternions
+    26,     // pixel lighting, four bones, dual quaternions, no fog
 };
 
 
@@ -181,6 +301,48 @@ const int EffectBase<SkinnedEffectTraits>::PixelShaderIndices[] =
     2,      // pixel lighting, two bones, no fog
     2,      // pixel lighting, four bones
     2,      // pixel lighting, four bones, no fog
+
+    0,      // vertex lighting, one bone, bone buffer
+    1,      // vertex lighting, one bone, bone buffer, no fog
+    0,      // vertex lighting, two bones, bone buffer
+    1,      // vertex lighting, two bones, bone buffer, no fog
+    0,      // vertex lighting, four bones, bone buffer
+    1,      // vertex lighting, four bones, bone buffer, no fog
+    
+    0,      // one light, one bone, bone buffer
+    1,      // one light, one bone, bone buffer, no fog
+    0,      // one light, two bones, bone buffer
+    1,      // one light, two bones, bone buffer, no fog
+    0,      // one light, four bones, bone buffer
+    1,      // one light, four bones, bone buffer, no fog
+    
+    2,      // pixel lighting, one bone, bone buffer
+    2,      // pixel lighting, one bone, bone buffer, no fog
+    2,      // pixel lighting, two bones, bone buffer
+    2,      // pixel lighting, two bones, bone buffer, no fog
+    2,      // pixel lighting, four bones, bone buffer
+    2,      // pixel lighting, four bones, bone buffer, no fog
+
+    0,      // vertex lighting, one bone, dual quaternions
+    1,      // vertex lighting, one bone, dual quaternions, no fog
+    0,      // vertex lighting, two bones, dual quaternions
+    1,      // vertex lighting, two bones, dual quaternions, no fog
+    0,      // vertex lighting, four bones, dual quaternions
+    1,      // vertex lighting, four bones, dual quaternions, no fog
+    
+    0,      // one light, one bone, dual quaternions
+    1,      // one light, one bone, dual quaternions, no fog
+    0,      // one light, two bones, dual quaternions
+    1,      // one light, two bones, dual quaternions, no fog
+    0,      // one light, four bones, dual quaternions
+    1,      // one light, four bones, dual quaternions, no fog
+    
+    2,      // pixel lighting, one bone, dual quaternions
+    2,      // pixel lighting, one bone, dual quaternions, no fog
+    2,      // pixel lighting, two bones, dual quaternions
+    2,      // pixel lighting, two bones, dual quaternions, no fog
+    2,      // pixel lighting, four bones, dual quaternions
+    2,      // pixel lighting, four bones, dual quaternions, no fog
 };
 
 
@@ -192,7 +354,8 @@ SharedResourcePool<ID3D11Device*, EffectBase<SkinnedEffectTraits>::DeviceResourc
 SkinnedEffect::Impl::Impl(_In_ ID3D11Device* device)
   : EffectBase(device),
     preferPerPixelLighting(false),
-    weightsPerVertex(4)
+    weightsPerVertex(4),
+    dualQuaternion(false)
 {
     static_assert( _countof(EffectBase<SkinnedEffectTraits>::VertexShaderIndices) == SkinnedEffectTraits::ShaderPermutationCount, "array/max mismatch" );
     static_assert( _countof(EffectBase<SkinnedEffectTraits>::VertexShaderBytecode) == SkinnedEffectTraits::VertexShaderCount, "array/max mismatch" );
@@ -207,6 +370,8 @@ SkinnedEffect::Impl::Impl(_In_ ID3D11Device* device)
         constants.bones[i][1] = g_XMIdentityR1;
         constants.bones[i][2] = g_XMIdentityR2;
     }
+
+    constants.firstBone = 0;
 }
 
 
@@ -241,6 +406,12 @@ int SkinnedEffect::Impl::GetCurrentShaderPermutation() const
         permutation += 6;
     }
 
+    // Read bones from a buffer rather than the constant buffer palette?
+    if (boneBuffer)
+    {
+        permutation += dualQuaternion ? 36 : 18;
+    }
+
     return permutation;
 }
 
@@ -261,6 +432,12 @@ void SkinnedEffect::Impl::Apply(_In_ ID3D11DeviceContext* deviceContext)
         textures = GetDefaultTexture();
 
     deviceContext->PSSetShaderResources(0, 1, &textures );
+
+    // Set the bone buffer.
+    if (boneBuffer)
+    {
+        deviceContext->VSSetShaderResources(0, 1, boneBuffer.GetAddressOf());
+    }
     
     // Set shaders and constant buffers.
     ApplyShaders(deviceContext, GetCurrentShaderPermutation());
@@ -289,6 +466,13 @@ SkinnedEffect& SkinnedEffect::operator= (SkinnedEffect&& moveFrom)
 }
 
 
+// Private constructor, used by Clone.
+SkinnedEffect::SkinnedEffect(std::unique_ptr<Impl>&& impl)
+  : pImpl(std::move(impl))
+{
+}
+
+
 // Public destructor.
 SkinnedEffect::~SkinnedEffect()
 {
@@ -307,6 +491,26 @@ void SkinnedEffect::GetVertexShaderBytecode(_Out_ void const** pShaderByteCode,
 }
 
 
+std::shared_ptr<IEffect> SkinnedEffect::Clone() const
+{
+    std::unique_ptr<Impl> impl(new Impl(*pImpl));
+
+    return std::shared_ptr<IEffect>(new SkinnedEffect(std::move(impl)));
+}
+
+
+void SkinnedEffect::WarmUpShaders(bool allPermutations)
+{
+    pImpl->WarmUpShaders(allPermutations ? -1 : pImpl->GetCurrentShaderPermutation());
+}
+
+
+void SkinnedEffect::GetShaderCreationStats(std::vector<EffectShaderCreation>& stats) const
+{
+    pImpl->GetShaderCreationStats(stats);
+}
+
+
 void XM_CALLCONV SkinnedEffect::SetWorld(FXMMATRIX value)
 {
     pImpl->matrices.world = value;
@@ -525,3 +729,189 @@ void SkinnedEffect::ResetBoneTransforms()
 
     pImpl->dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
 }
+
+
+void SkinnedEffect::SetBoneBuffer(_In_opt_ ID3D11ShaderResourceView* value, size_t firstBone, bool dualQuaternion)
+{
+    if (firstBone > UINT32_MAX)
+        throw std::out_of_range("firstBone parameter out of range");
+
+    if (value)
+    {
+        Microsoft::WRL::ComPtr<ID3D11Device> device;
+
+        value->GetDevice(&device);
+
+        if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_10_0)
+            throw std::exception("Bone buffers require Feature Level 10.0 or greater");
+    }
+
+    pImpl->boneBuffer = value;
+    pImpl->dualQuaternion = dualQuaternion;
+
+    pImpl->constants.firstBone = static_cast<uint32_t>(firstBone);
+
+    pImpl->dirtyFlags |= EffectDirtyFlags::ConstantBuffer;
+}
+
+
+//--------------------------------------------------------------------------------------
+// BoneBuffer
+//--------------------------------------------------------------------------------------
+
+// Internal BoneBuffer implementation class.
+class BoneBuffer::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device, size_t maxBones, bool dualQuaternion);
+
+    void SetBoneTransforms(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) XMMATRIX const* value, size_t count);
+
+    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+    Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView;
+
+    size_t maxBones;
+    bool dualQuaternion;
+};
+
+
+BoneBuffer::Impl::Impl(_In_ ID3D11Device* device, size_t maxBones, bool dualQuaternion)
+  : maxBones(maxBones),
+    dualQuaternion(dualQuaternion)
+{
+    // Three float4 per matrix, or two per dual quaternion.
+    size_t elementsPerBone = dualQuaternion ? 2 : 3;
+
+    if (!maxBones || maxBones > (UINT32_MAX / (elementsPerBone * sizeof(XMFLOAT4))))
+        throw std::out_of_range("maxBones parameter out of range");
+
+    if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_10_0)
+        throw std::exception("BoneBuffer requires Feature Level 10.0 or greater");
+
+    UINT elementCount = static_cast<UINT>(maxBones * elementsPerBone);
+
+    D3D11_BUFFER_DESC bufferDesc = {0};
+
+    bufferDesc.ByteWidth = elementCount * sizeof(XMFLOAT4);
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    ThrowIfFailed(
+        device->CreateBuffer(&bufferDesc, nullptr, &buffer)
+    );
+
+    SetDebugObjectName(buffer.Get(), "DirectXTK:BoneBuffer");
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+
+    viewDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    viewDesc.Buffer.FirstElement = 0;
+    viewDesc.Buffer.NumElements = elementCount;
+
+    ThrowIfFailed(
+        device->CreateShaderResourceView(buffer.Get(), &viewDesc, &shaderResourceView)
+    );
+
+    SetDebugObjectName(shaderResourceView.Get(), "DirectXTK:BoneBuffer");
+}
+
+
+void BoneBuffer::Impl::SetBoneTransforms(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) XMMATRIX const* value, size_t count)
+{
+    if (count > maxBones)
+        throw std::out_of_range("count parameter out of range");
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+
+    ThrowIfFailed(
+        deviceContext->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)
+    );
+
+    auto dest = static_cast<XMFLOAT4*>(mappedResource.pData);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (dualQuaternion)
+        {
+            XMVECTOR scale;
+            XMVECTOR rotation;
+            XMVECTOR translation;
+
+            if (!XMMatrixDecompose(&scale, &rotation, &translation, value[i]))
+            {
+                rotation = XMQuaternionIdentity();
+                translation = value[i].r[3];
+            }
+
+            // Dual part is half the translation (as a pure quaternion) times the rotation.
+            XMVECTOR dual = XMQuaternionMultiply(rotation, XMVectorSelect(g_XMZero, translation, g_XMSelect1110));
+
+            XMStoreFloat4(dest++, rotation);
+            XMStoreFloat4(dest++, XMVectorScale(dual, 0.5f));
+        }
+        else
+        {
+            XMMATRIX boneMatrix = XMMatrixTranspose(value[i]);
+
+            XMStoreFloat4(dest++, boneMatrix.r[0]);
+            XMStoreFloat4(dest++, boneMatrix.r[1]);
+            XMStoreFloat4(dest++, boneMatrix.r[2]);
+        }
+    }
+
+    deviceContext->Unmap(buffer.Get(), 0);
+}
+
+
+// Public constructor.
+BoneBuffer::BoneBuffer(_In_ ID3D11Device* device, size_t maxBones, bool dualQuaternion)
+  : pImpl(new Impl(device, maxBones, dualQuaternion))
+{
+}
+
+
+// Move constructor.
+BoneBuffer::BoneBuffer(BoneBuffer&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+BoneBuffer& BoneBuffer::operator= (BoneBuffer&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+BoneBuffer::~BoneBuffer()
+{
+}
+
+
+void BoneBuffer::SetBoneTransforms(_In_ ID3D11DeviceContext* deviceContext, _In_reads_(count) XMMATRIX const* value, size_t count)
+{
+    pImpl->SetBoneTransforms(deviceContext, value, count);
+}
+
+
+ID3D11ShaderResourceView* BoneBuffer::GetShaderResourceView() const
+{
+    return pImpl->shaderResourceView.Get();
+}
+
+
+size_t BoneBuffer::GetMaxBones() const
+{
+    return pImpl->maxBones;
+}
+
+
+bool BoneBuffer::IsDualQuaternion() const
+{
+    return pImpl->dualQuaternion;
+}
@@ -16,6 +16,7 @@
 #define NOMINMAX
 #include <algorithm>
 #include <vector>
+#include <ppl.h>
 
 #include "SpriteBatch.h"
 #include "ConstantBuffer.h"
@@ -23,11 +24,42 @@
 #include "VertexTypes.h"
 #include "SharedResourcePool.h"
 #include "AlignedNew.h"
+#include "GpuTimer.h"
+#include "ScopedInstrumentationEvent.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
 
 
+// Internal SpriteList implementation class: the baked output of a recorded Begin/End sequence.
+class SpriteList::Impl
+{
+public:
+    Impl()
+      : spriteCount(0)
+    { }
+
+    // A run of consecutive sprites that share a texture.
+    struct Batch
+    {
+        ComPtr<ID3D11ShaderResourceView> texture;
+        UINT startSprite;
+        UINT spriteCount;
+    };
+
+    ComPtr<ID3D11Buffer> vertexBuffer;
+    std::vector<Batch> batches;
+    size_t spriteCount;
+
+    // Render settings captured from the Begin call.
+    ComPtr<ID3D11BlendState> blendState;
+    ComPtr<ID3D11SamplerState> samplerState;
+    ComPtr<ID3D11DepthStencilState> depthStencilState;
+    ComPtr<ID3D11RasterizerState> rasterizerState;
+    std::function<void()> setCustomShaders;
+};
+
+
 // Internal SpriteBatch implementation class.
 __declspec(align(16)) class SpriteBatch::Impl : public AlignedNew<SpriteBatch::Impl>
 {
@@ -38,6 +70,7 @@ public:
     void End();
 
     void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags);
+    void XM_CALLCONV DrawSprites(_In_ ID3D11ShaderResourceView* texture, size_t count, _In_reads_(count) RECT const* sourceRectangles, _In_reads_(count) XMFLOAT2 const* origins, FXMVECTOR destination, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags);
 
 
     // Info about a single sprite that is waiting to be drawn.
@@ -63,17 +96,81 @@ public:
     bool mSetViewport;
     D3D11_VIEWPORT mViewPort;
 
+    bool mInstancing;
+    bool mParallelBatching;
+    size_t mBatchTextureCount;
+
+    SpriteBatchStatistics mStatistics;
+
+    bool mGpuTiming;
+    GpuTimer mGpuTimer;
+
+    void SetInstancing(bool enable);
+    bool GetInstancing() const;
+    void SetParallelBatching(bool enable);
+    void SetBatchTextureCount(size_t count);
+    void SetGpuTiming(bool enable);
+    void SetBufferRingSize(size_t spriteCount);
+    void SetMaxDiscardsPerFrame(size_t maxDiscards);
+    void SetAdaptiveBufferRing(bool enable);
+    void EndFrame();
+    size_t GetBufferRingSize() const;
+
+    void EndSpriteList(_Inout_ SpriteList::Impl* spriteList);
+    void XM_CALLCONV DrawSpriteList(_In_ SpriteList::Impl const* spriteList, FXMMATRIX transformMatrix);
+
 private:
     // Implementation helper methods.
     void GrowSpriteQueue();
     void PrepareForRendering();
+    void SetRenderStates(_In_opt_ ID3D11BlendState* blendState, _In_opt_ ID3D11SamplerState* samplerState, _In_opt_ ID3D11DepthStencilState* depthStencilState, _In_opt_ ID3D11RasterizerState* rasterizerState);
+    void SetShaders(bool instanced);
+    void BindBuffers(bool instanced);
+    void WrapBufferRing(_Inout_ size_t* bufferPosition, bool instanced);
+    void XM_CALLCONV SetTransform(FXMMATRIX transform);
     void FlushBatch();
+    void FlushMultiTextureBatch();
+    void ResetSpriteQueue();
     void SortSprites();
+    void RadixSortSprites();
     void GrowSortedSprites();
+    void StartGpuTiming();
+    void StopGpuTiming();
 
     void RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_reads_(count) SpriteInfo const* const* sprites, size_t count);
+    void RenderBatchMultiTexture(_In_reads_(textureCount) ID3D11ShaderResourceView* const* textures, size_t textureCount, _In_reads_(count) SpriteInfo const* const* sprites, _In_reads_(count) uint32_t const* textureSlots, size_t count);
+    void RenderBatchInstanced(_In_reads_(count) SpriteInfo const* const* sprites, _In_reads_opt_(count) uint32_t const* textureSlots, size_t count, _In_ XMVECTOR const* textureSizes, _In_ XMVECTOR const* inverseTextureSizes);
 
     static void XM_CALLCONV RenderSprite(_In_ SpriteInfo const* sprite, _Out_cap_c_(VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize);
+    static void XM_CALLCONV RenderSprites4(_In_reads_(4) SpriteInfo const* const* sprites, _Out_cap_c_(VerticesPerSprite * 4) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize);
+    static void XM_CALLCONV RenderSprites(_In_reads_(count) SpriteInfo const* const* sprites, _Out_cap_(count * VerticesPerSprite) VertexPositionColorTexture* vertices, size_t count, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize);
+
+
+    // Per-sprite record consumed by the instanced vertex shader, which expands it into
+    // a quad. Sizes and texture coordinates are already normalized, and mirroring is
+    // folded into the source region, so the shader only needs to do the corner math.
+    struct SpriteInstance
+    {
+        XMFLOAT4 destination;           // x, y, width, height in pixels
+        XMFLOAT4 source;                // u, v, width, height in texture coordinates
+        XMFLOAT4 originRotationDepth;   // origin relative to the sprite size, rotation, depth
+        XMFLOAT4 color;
+
+        static const int InputElementCount = 4;
+        static const D3D11_INPUT_ELEMENT_DESC InputElements[InputElementCount];
+
+        // Multi-texture batching adds a second per-instance stream holding the texture index.
+        static const int MultiTextureInputElementCount = 5;
+        static const D3D11_INPUT_ELEMENT_DESC MultiTextureInputElements[MultiTextureInputElementCount];
+    };
+
+    static void XM_CALLCONV RenderSpriteInstance(_In_ SpriteInfo const* sprite, _Out_ SpriteInstance* instance, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize);
+
+    template<typename TVertex, typename TGenerate>
+    void RenderChunks(_In_reads_(count) SpriteInfo const* const* sprites, _Out_ TVertex* output, size_t outputPerSprite, size_t count, TGenerate generate);
+
+    bool UseInstancing() const;
+    bool UseMultiTexture() const;
 
     static XMVECTOR GetTextureSize(_In_ ID3D11ShaderResourceView* texture);
     XMMATRIX GetViewportTransform(_In_ ID3D11DeviceContext* deviceContext, DXGI_MODE_ROTATION rotation );
@@ -82,10 +179,17 @@ private:
     // Constants.
     static const size_t MaxBatchSize = 2048;
     static const size_t MinBatchSize = 128;
+    static const size_t MaxBufferRingSize = 65536;
     static const size_t InitialQueueSize = 64;
     static const size_t VerticesPerSprite = 4;
     static const size_t IndicesPerSprite = 6;
 
+    // Parallel batching only splits work that is large enough to amortize the task overhead.
+    static const size_t ParallelSortThreshold = 4096;
+    static const size_t ParallelChunkSize = 1024;
+    static const size_t RadixBits = 8;
+    static const size_t RadixBuckets = 1 << RadixBits;
+
 
     // Queue of sprites waiting to be drawn.
     std::unique_ptr<SpriteInfo[]> mSpriteQueue;
@@ -101,6 +205,18 @@ private:
     std::vector<SpriteInfo const*> mSortedSprites;
 
 
+    // Scratch storage for the stable radix sort used when parallel batching is enabled.
+    // Kept from one batch to the next so steady-state sorting does not allocate.
+    std::vector<SpriteInfo const*> mRadixSprites;
+    std::vector<uint64_t> mRadixKeys;
+    std::vector<uint64_t> mRadixKeysScratch;
+    std::vector<size_t> mRadixHistograms;
+
+
+    // Index into the bound texture set for each sorted sprite, used by multi-texture batching.
+    std::vector<uint32_t> mSpriteTextureSlots;
+
+
     // If each SpriteInfo instance held a refcount on its texture, could end up with
     // many redundant AddRef/Release calls on the same object, so instead we use
     // this separate list to hold just a single refcount each time we change texture.
@@ -129,10 +245,18 @@ private:
         ComPtr<ID3D11InputLayout> inputLayout;
         ComPtr<ID3D11Buffer> indexBuffer;
 
+        // Only created if the device supports instanced rendering with SV_VertexID.
+        ComPtr<ID3D11VertexShader> instancedVertexShader;
+        ComPtr<ID3D11InputLayout> instancedInputLayout;
+        ComPtr<ID3D11VertexShader> multiTextureVertexShader;
+        ComPtr<ID3D11PixelShader> multiTexturePixelShader;
+        ComPtr<ID3D11InputLayout> multiTextureInputLayout;
+
         CommonStates stateObjects;
 
     private:
         void CreateShaders(_In_ ID3D11Device* device);
+        void CreateInstancedShaders(_In_ ID3D11Device* device);
         void CreateIndexBuffer(_In_ ID3D11Device* device);
 
         static std::vector<short> CreateIndexValues();
@@ -146,13 +270,31 @@ private:
 
         ComPtr<ID3D11DeviceContext> deviceContext;
         ComPtr<ID3D11Buffer> vertexBuffer;
+        ComPtr<ID3D11Buffer> instanceBuffer;
+        ComPtr<ID3D11Buffer> instanceTextureIndexBuffer;
 
         ConstantBuffer<XMMATRIX> constantBuffer;
 
         size_t vertexBufferPosition;
+        size_t instanceBufferPosition;
+        size_t instanceTextureIndexBufferPosition;
 
         bool inImmediateMode;
 
+        // Size of the dynamic buffer ring in sprites, and the policy used to grow it.
+        size_t ringSize;
+        size_t maxDiscardsPerFrame;
+        bool adaptiveRingSize;
+
+        size_t frameDiscards;
+        size_t frameSprites;
+
+        ID3D11Buffer* GetInstanceBuffer();
+        ID3D11Buffer* GetInstanceTextureIndexBuffer();
+
+        void SetRingSize(size_t spriteCount);
+        void EndFrame();
+
     private:
         void CreateVertexBuffer();
     };
@@ -177,15 +319,41 @@ const XMMATRIX SpriteBatch::MatrixIdentity = XMMatrixIdentity();
 const XMFLOAT2 SpriteBatch::Float2Zero(0, 0);
 
 
+// Vertex struct holding the per-instance data for instanced sprite rendering.
+const D3D11_INPUT_ELEMENT_DESC SpriteBatch::Impl::SpriteInstance::InputElements[] =
+{
+    { "SPRITEDESTINATION",         0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "SPRITESOURCE",              0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "SPRITEORIGINROTATIONDEPTH", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "SPRITECOLOR",               0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+};
+
+
+// Same as above, plus the per-instance texture index stream used by multi-texture batching.
+const D3D11_INPUT_ELEMENT_DESC SpriteBatch::Impl::SpriteInstance::MultiTextureInputElements[] =
+{
+    { "SPRITEDESTINATION",         0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "SPRITESOURCE",              0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "SPRITEORIGINROTATIONDEPTH", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "SPRITECOLOR",               0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+    { "SPRITETEXTUREINDEX",        0, DXGI_FORMAT_R32_UINT,           1, 0,                            D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+};
+
 namespace
 {
     // Include the precompiled shader code.
 #if defined(_XBOX_ONE) && defined(_TITLE)
     #include "Shaders/Compiled/XboxOneSpriteEffect_SpriteVertexShader.inc"
     #include "Shaders/Compiled/XboxOneSpriteEffect_SpritePixelShader.inc"
+    #include "Shaders/Compiled/XboxOneSpriteEffect_SpriteVertexShaderInstanced.inc"
+    #include "Shaders/Compiled/XboxOneSpriteEffect_SpriteVertexShaderInstancedMultiTexture.inc"
+    #include "Shaders/Compiled/XboxOneSpriteEffect_SpritePixelShaderMultiTexture.inc"
 #else
     #include "Shaders/Compiled/SpriteEffect_SpriteVertexShader.inc"
     #include "Shaders/Compiled/SpriteEffect_SpritePixelShader.inc"
+    #include "Shaders/Compiled/SpriteEffect_SpriteVertexShaderInstanced.inc"
+    #include "Shaders/Compiled/SpriteEffect_SpriteVertexShaderInstancedMultiTexture.inc"
+    #include "Shaders/Compiled/SpriteEffect_SpritePixelShaderMultiTexture.inc"
 #endif
 
 
@@ -221,6 +389,12 @@ SpriteBatch::Impl::DeviceResources::DeviceResources(_In_ ID3D11Device* device)
 {
     CreateShaders(device);
     CreateIndexBuffer(device);
+
+    // The instanced vertex shader relies on SV_VertexID, which 9.x feature levels do not support.
+    if (device->GetFeatureLevel() >= D3D_FEATURE_LEVEL_10_0)
+    {
+        CreateInstancedShaders(device);
+    }
 }
 
 
@@ -255,6 +429,54 @@ void SpriteBatch::Impl::DeviceResources::CreateShaders(_In_ ID3D11Device* device
 }
 
 
+// Creates the shaders and input layouts used for instanced sprite rendering.
+void SpriteBatch::Impl::DeviceResources::CreateInstancedShaders(_In_ ID3D11Device* device)
+{
+    ThrowIfFailed(
+        device->CreateVertexShader(SpriteEffect_SpriteVertexShaderInstanced,
+                                   sizeof(SpriteEffect_SpriteVertexShaderInstanced),
+                                   nullptr,
+                                   &instancedVertexShader)
+    );
+
+    ThrowIfFailed(
+        device->CreateInputLayout(SpriteInstance::InputElements,
+                                  SpriteInstance::InputElementCount,
+                                  SpriteEffect_SpriteVertexShaderInstanced,
+                                  sizeof(SpriteEffect_SpriteVertexShaderInstanced),
+                                  &instancedInputLayout)
+    );
+
+    ThrowIfFailed(
+        device->CreateVertexShader(SpriteEffect_SpriteVertexShaderInstancedMultiTexture,
+                                   sizeof(SpriteEffect_SpriteVertexShaderInstancedMultiTexture),
+                                   nullptr,
+                                   &multiTextureVertexShader)
+    );
+
+    ThrowIfFailed(
+        device->CreatePixelShader(SpriteEffect_SpritePixelShaderMultiTexture,
+                                  sizeof(SpriteEffect_SpritePixelShaderMultiTexture),
+                                  nullptr,
+                                  &multiTexturePixelShader)
+    );
+
+    ThrowIfFailed(
+        device->CreateInputLayout(SpriteInstance::MultiTextureInputElements,
+                                  SpriteInstance::MultiTextureInputElementCount,
+                                  SpriteEffect_SpriteVertexShaderInstancedMultiTexture,
+                                  sizeof(SpriteEffect_SpriteVertexShaderInstancedMultiTexture),
+                                  &multiTextureInputLayout)
+    );
+
+    SetDebugObjectName(instancedVertexShader.Get(),    "DirectXTK:SpriteBatch");
+    SetDebugObjectName(instancedInputLayout.Get(),     "DirectXTK:SpriteBatch");
+    SetDebugObjectName(multiTextureVertexShader.Get(), "DirectXTK:SpriteBatch");
+    SetDebugObjectName(multiTexturePixelShader.Get(),  "DirectXTK:SpriteBatch");
+    SetDebugObjectName(multiTextureInputLayout.Get(),  "DirectXTK:SpriteBatch");
+}
+
+
 // Creates the SpriteBatch index buffer.
 void SpriteBatch::Impl::DeviceResources::CreateIndexBuffer(_In_ ID3D11Device* device)
 {
@@ -307,7 +529,14 @@ SpriteBatch::Impl::ContextResources::ContextResources(_In_ ID3D11DeviceContext*
   : deviceContext(deviceContext),
     constantBuffer(GetDevice(deviceContext).Get()),
     vertexBufferPosition(0),
-    inImmediateMode(false)
+    instanceBufferPosition(0),
+    instanceTextureIndexBufferPosition(0),
+    inImmediateMode(false),
+    ringSize(MaxBatchSize),
+    maxDiscardsPerFrame(0),
+    adaptiveRingSize(false),
+    frameDiscards(0),
+    frameSprites(0)
 {
     CreateVertexBuffer();
 }
@@ -318,7 +547,7 @@ void SpriteBatch::Impl::ContextResources::CreateVertexBuffer()
 {
     D3D11_BUFFER_DESC vertexBufferDesc = { 0 };
 
-    vertexBufferDesc.ByteWidth = sizeof(VertexPositionColorTexture) * MaxBatchSize * VerticesPerSprite;
+    vertexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(VertexPositionColorTexture) * ringSize * VerticesPerSprite);
     vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
     vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
@@ -331,10 +560,103 @@ void SpriteBatch::Impl::ContextResources::CreateVertexBuffer()
 }
 
 
+// Lazily creates the SpriteBatch instance buffer, so contexts that never use instancing don't pay for it.
+ID3D11Buffer* SpriteBatch::Impl::ContextResources::GetInstanceBuffer()
+{
+    if (!instanceBuffer)
+    {
+        D3D11_BUFFER_DESC instanceBufferDesc = { 0 };
+
+        instanceBufferDesc.ByteWidth = static_cast<UINT>(sizeof(SpriteInstance) * ringSize);
+        instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        ThrowIfFailed(
+            GetDevice(deviceContext.Get())->CreateBuffer(&instanceBufferDesc, nullptr, &instanceBuffer)
+        );
+
+        SetDebugObjectName(instanceBuffer.Get(), "DirectXTK:SpriteBatch");
+    }
+
+    return instanceBuffer.Get();
+}
+
+
+// Lazily creates the per-instance texture index buffer used by multi-texture batching.
+// This has its own ring position, as instanced batches without texture indices don't advance it.
+ID3D11Buffer* SpriteBatch::Impl::ContextResources::GetInstanceTextureIndexBuffer()
+{
+    if (!instanceTextureIndexBuffer)
+    {
+        D3D11_BUFFER_DESC indexBufferDesc = { 0 };
+
+        indexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * ringSize);
+        indexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        indexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        indexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+        ThrowIfFailed(
+            GetDevice(deviceContext.Get())->CreateBuffer(&indexBufferDesc, nullptr, &instanceTextureIndexBuffer)
+        );
+
+        SetDebugObjectName(instanceTextureIndexBuffer.Get(), "DirectXTK:SpriteBatch");
+    }
+
+    return instanceTextureIndexBuffer.Get();
+}
+
+
+// Replaces the dynamic buffers with ones of a different size. The instance buffers are recreated on demand.
+void SpriteBatch::Impl::ContextResources::SetRingSize(size_t spriteCount)
+{
+    if (spriteCount == ringSize)
+        return;
+
+    ringSize = spriteCount;
+
+    vertexBuffer.Reset();
+    instanceBuffer.Reset();
+    instanceTextureIndexBuffer.Reset();
+
+    // New buffers have no pending GPU reads, so start them with D3D11_MAP_WRITE_DISCARD.
+    vertexBufferPosition = 0;
+    instanceBufferPosition = 0;
+    instanceTextureIndexBufferPosition = 0;
+
+    CreateVertexBuffer();
+}
+
+
+// Applies the adaptive sizing policy, then starts counting afresh for the next frame.
+void SpriteBatch::Impl::ContextResources::EndFrame()
+{
+    // Grow to fit the whole of the busiest frame so far, so it needs at most one wraparound.
+    if (adaptiveRingSize && frameSprites > ringSize)
+    {
+        size_t newSize = ringSize;
+
+        while (newSize < frameSprites && newSize < MaxBufferRingSize)
+        {
+            newSize *= 2;
+        }
+
+        SetRingSize(std::min(newSize, MaxBufferRingSize));
+    }
+
+    frameDiscards = 0;
+    frameSprites = 0;
+}
+
+
 // Per-SpriteBatch constructor.
 SpriteBatch::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext)
   : mRotation( DXGI_MODE_ROTATION_IDENTITY ),
     mSetViewport(false),
+    mInstancing(false),
+    mParallelBatching(false),
+    mBatchTextureCount(1),
+    mGpuTiming(false),
     mSpriteQueueCount(0),
     mSpriteQueueArraySize(0),
     mInBeginEndPair(false),
@@ -343,6 +665,7 @@ SpriteBatch::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext)
     mDeviceResources(deviceResourcesPool.DemandCreate(GetDevice(deviceContext).Get())),
     mContextResources(contextResourcesPool.DemandCreate(deviceContext))
 {
+    memset(&mStatistics, 0, sizeof(mStatistics));
 }
 
 
@@ -366,6 +689,7 @@ void XM_CALLCONV SpriteBatch::Impl::Begin(SpriteSortMode sortMode, _In_opt_ ID3D
         if (mContextResources->inImmediateMode)
             throw std::exception("Only one SpriteBatch at a time can use SpriteSortMode_Immediate");
 
+        StartGpuTiming();
         PrepareForRendering();
 
         mContextResources->inImmediateMode = true;
@@ -381,10 +705,14 @@ void SpriteBatch::Impl::End()
     if (!mInBeginEndPair)
         throw std::exception("Begin must be called before End");
 
+    ScopedInstrumentationEvent event(InstrumentationCategory_SpriteBatch, L"SpriteBatch::End", nullptr, 0, mSpriteQueueCount, mContextResources->deviceContext.Get());
+
     if (mSortMode == SpriteSortMode_Immediate)
     {
         // If we are in immediate mode, sprites have already been drawn.
         mContextResources->inImmediateMode = false;
+
+        StopGpuTiming();
     }
     else
     {
@@ -392,8 +720,10 @@ void SpriteBatch::Impl::End()
         if (mContextResources->inImmediateMode)
             throw std::exception("Cannot end one SpriteBatch while another is using SpriteSortMode_Immediate");
 
+        StartGpuTiming();
         PrepareForRendering();
         FlushBatch();
+        StopGpuTiming();
     }
 
     // Break circular reference chains, in case the state lambda closed
@@ -404,6 +734,160 @@ void SpriteBatch::Impl::End()
 }
 
 
+// Ends a batch, baking the queued sprites into a sprite list instead of drawing them.
+void SpriteBatch::Impl::EndSpriteList(_Inout_ SpriteList::Impl* spriteList)
+{
+    if (!mInBeginEndPair)
+        throw std::exception("Begin must be called before EndSpriteList");
+
+    if (mSortMode == SpriteSortMode_Immediate)
+        throw std::exception("SpriteSortMode_Immediate cannot be recorded into a SpriteList");
+
+    spriteList->blendState = mBlendState;
+    spriteList->samplerState = mSamplerState;
+    spriteList->depthStencilState = mDepthStencilState;
+    spriteList->rasterizerState = mRasterizerState;
+    spriteList->setCustomShaders = mSetCustomShaders;
+
+    mSetCustomShaders = nullptr;
+    mInBeginEndPair = false;
+
+    if (!mSpriteQueueCount)
+        return;
+
+    if (mSpriteQueueCount * VerticesPerSprite > INT32_MAX)
+        throw std::exception("Too many sprites for a SpriteList");
+
+    SortSprites();
+
+    // Generate all the vertices up front, one texture run at a time.
+    std::vector<VertexPositionColorTexture> vertices(mSpriteQueueCount * VerticesPerSprite);
+
+    size_t batchStart = 0;
+
+    while (batchStart < mSpriteQueueCount)
+    {
+        ID3D11ShaderResourceView* texture = mSortedSprites[batchStart]->texture;
+
+        size_t batchEnd = batchStart + 1;
+
+        while (batchEnd < mSpriteQueueCount && mSortedSprites[batchEnd]->texture == texture)
+        {
+            batchEnd++;
+        }
+
+        XMVECTOR textureSize = GetTextureSize(texture);
+        XMVECTOR inverseTextureSize = XMVectorReciprocal(textureSize);
+
+        RenderChunks(&mSortedSprites[batchStart], &vertices[batchStart * VerticesPerSprite], VerticesPerSprite, batchEnd - batchStart, [&](SpriteInfo const* const* chunkSprites, VertexPositionColorTexture* chunkVertices, size_t chunkCount)
+        {
+            RenderSprites(chunkSprites, chunkVertices, chunkCount, textureSize, inverseTextureSize);
+        });
+
+        SpriteList::Impl::Batch batch;
+
+        batch.texture = texture;
+        batch.startSprite = static_cast<UINT>(batchStart);
+        batch.spriteCount = static_cast<UINT>(batchEnd - batchStart);
+
+        spriteList->batches.push_back(batch);
+
+        batchStart = batchEnd;
+    }
+
+    // Bake them into a GPU vertex buffer. This is never updated, so it can be immutable.
+    D3D11_BUFFER_DESC vertexBufferDesc = { 0 };
+
+    vertexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(VertexPositionColorTexture) * vertices.size());
+    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+
+    D3D11_SUBRESOURCE_DATA vertexDataDesc = { 0 };
+
+    vertexDataDesc.pSysMem = &vertices.front();
+
+    ThrowIfFailed(
+        GetDevice(mContextResources->deviceContext.Get())->CreateBuffer(&vertexBufferDesc, &vertexDataDesc, &spriteList->vertexBuffer)
+    );
+
+    SetDebugObjectName(spriteList->vertexBuffer.Get(), "DirectXTK:SpriteList");
+
+    spriteList->spriteCount = mSpriteQueueCount;
+
+    ResetSpriteQueue();
+}
+
+
+// Replays a previously recorded sprite list. No vertex data is generated or uploaded.
+void XM_CALLCONV SpriteBatch::Impl::DrawSpriteList(_In_ SpriteList::Impl const* spriteList, FXMMATRIX transformMatrix)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot draw a SpriteList inside a Begin/End pair");
+
+    if (mContextResources->inImmediateMode)
+        throw std::exception("Cannot draw a SpriteList while another SpriteBatch is using SpriteSortMode_Immediate");
+
+    if (!spriteList->spriteCount)
+        return;
+
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    StartGpuTiming();
+
+    SetRenderStates(spriteList->blendState.Get(), spriteList->samplerState.Get(), spriteList->depthStencilState.Get(), spriteList->rasterizerState.Get());
+    SetShaders(false);
+    SetTransform(transformMatrix);
+
+    auto vertexBuffer = spriteList->vertexBuffer.Get();
+    UINT vertexStride = sizeof(VertexPositionColorTexture);
+    UINT vertexOffset = 0;
+
+    deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+
+    if (spriteList->setCustomShaders)
+    {
+        spriteList->setCustomShaders();
+    }
+
+    for (auto it = spriteList->batches.cbegin(); it != spriteList->batches.cend(); ++it)
+    {
+        auto texture = it->texture.Get();
+
+        deviceContext->PSSetShaderResources(0, 1, &texture);
+
+        if (it != spriteList->batches.cbegin())
+        {
+            mStatistics.textureSplits++;
+        }
+
+        // The shared index buffer only covers MaxBatchSize sprites, so longer runs are split, using
+        // the base vertex location to address the right part of the vertex buffer.
+        UINT start = it->startSprite;
+        UINT remaining = it->spriteCount;
+
+        while (remaining > 0)
+        {
+            UINT batchSize = std::min(remaining, static_cast<UINT>(MaxBatchSize));
+
+            deviceContext->DrawIndexed(static_cast<UINT>(batchSize * IndicesPerSprite), 0, static_cast<INT>(start * VerticesPerSprite));
+
+            mStatistics.drawCalls++;
+            mStatistics.sprites += batchSize;
+
+            start += batchSize;
+            remaining -= batchSize;
+
+            if (remaining > 0)
+            {
+                mStatistics.bufferSplits++;
+            }
+        }
+    }
+
+    StopGpuTiming();
+}
+
+
 // Adds a single sprite to the queue.
 void XM_CALLCONV SpriteBatch::Impl::Draw(_In_ ID3D11ShaderResourceView* texture, FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags)
 {
@@ -458,6 +942,8 @@ void XM_CALLCONV SpriteBatch::Impl::Draw(_In_ ID3D11ShaderResourceView* texture,
     {
         // If we are in immediate mode, draw this sprite straight away.
         RenderBatch(texture, &sprite, 1);
+
+        mStatistics.immediateDraws++;
     }
     else
     {
@@ -476,6 +962,67 @@ void XM_CALLCONV SpriteBatch::Impl::Draw(_In_ ID3D11ShaderResourceView* texture,
 }
 
 
+// Adds a run of sprites that share a texture and all parameters except their source region and origin.
+void XM_CALLCONV SpriteBatch::Impl::DrawSprites(_In_ ID3D11ShaderResourceView* texture, size_t count, _In_reads_(count) RECT const* sourceRectangles, _In_reads_(count) XMFLOAT2 const* origins, FXMVECTOR destination, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags)
+{
+    if (!texture)
+        throw std::exception("Texture cannot be null");
+
+    if (!mInBeginEndPair)
+        throw std::exception("Begin must be called before DrawSprites");
+
+    if (!count)
+        return;
+
+    // Make room for the whole run up front, so the loop below does no checks. The immediate
+    // mode path only ever uses one slot, as each sprite is drawn straight away.
+    bool immediate = (mSortMode == SpriteSortMode_Immediate);
+
+    size_t required = mSpriteQueueCount + (immediate ? 1 : count);
+
+    while (required > mSpriteQueueArraySize)
+    {
+        GrowSpriteQueue();
+    }
+
+    flags |= SpriteInfo::SourceInTexels | SpriteInfo::DestSizeInPixels;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SpriteInfo* sprite = &mSpriteQueue[immediate ? mSpriteQueueCount : mSpriteQueueCount + i];
+
+        XMVECTOR source = LoadRect(&sourceRectangles[i]);
+
+        // Store sprite parameters, converting the destination size from a scale factor to pixels.
+        XMStoreFloat4A(&sprite->source, source);
+        XMStoreFloat4A(&sprite->destination, XMVectorPermute<0, 1, 6, 7>(destination, destination * source));
+        XMStoreFloat4A(&sprite->color, color);
+        XMStoreFloat4A(&sprite->originRotationDepth, originRotationDepth + XMLoadFloat2(&origins[i]));
+
+        sprite->texture = texture;
+        sprite->flags = flags;
+
+        if (immediate)
+        {
+            RenderBatch(texture, &sprite, 1);
+
+            mStatistics.immediateDraws++;
+        }
+    }
+
+    if (!immediate)
+    {
+        mSpriteQueueCount += count;
+
+        // As in Draw, hold a single refcount on the texture for the whole run.
+        if (mSpriteTextureReferences.empty() || texture != mSpriteTextureReferences.back().Get())
+        {
+            mSpriteTextureReferences.emplace_back(texture);
+        }
+    }
+}
+
+
 // Dynamically expands the array used to store pending sprite information.
 void SpriteBatch::Impl::GrowSpriteQueue()
 {
@@ -505,47 +1052,16 @@ void SpriteBatch::Impl::PrepareForRendering()
 {
     auto deviceContext = mContextResources->deviceContext.Get();
 
-    // Set state objects.
-    auto blendState        = mBlendState        ? mBlendState.Get()        : mDeviceResources->stateObjects.AlphaBlend();
-    auto depthStencilState = mDepthStencilState ? mDepthStencilState.Get() : mDeviceResources->stateObjects.DepthNone();
-    auto rasterizerState   = mRasterizerState   ? mRasterizerState.Get()   : mDeviceResources->stateObjects.CullCounterClockwise();
-    auto samplerState      = mSamplerState      ? mSamplerState.Get()      : mDeviceResources->stateObjects.LinearClamp();
-
-    deviceContext->OMSetBlendState(blendState, nullptr, 0xFFFFFFFF);
-    deviceContext->OMSetDepthStencilState(depthStencilState, 0);
-    deviceContext->RSSetState(rasterizerState);
-    deviceContext->PSSetSamplers(0, 1, &samplerState);
-
-    // Set shaders.
-    deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    deviceContext->IASetInputLayout(mDeviceResources->inputLayout.Get());
-    deviceContext->VSSetShader(mDeviceResources->vertexShader.Get(), nullptr, 0);
-    deviceContext->PSSetShader(mDeviceResources->pixelShader.Get(), nullptr, 0);
-
-    // Set the vertex and index buffer.
-    auto vertexBuffer = mContextResources->vertexBuffer.Get();
-    UINT vertexStride = sizeof(VertexPositionColorTexture);
-    UINT vertexOffset = 0;
-
-    deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
-
-    deviceContext->IASetIndexBuffer(mDeviceResources->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-
-    // Set the transform matrix.
-    XMMATRIX transformMatrix = (mRotation == DXGI_MODE_ROTATION_UNSPECIFIED)
-                               ? mTransformMatrix
-                               : ( mTransformMatrix * GetViewportTransform(deviceContext, mRotation) );
-
-    mContextResources->constantBuffer.SetData(deviceContext, transformMatrix);
-
-    ID3D11Buffer* constantBuffer = mContextResources->constantBuffer.GetBuffer();
-
-    deviceContext->VSSetConstantBuffers(0, 1, &constantBuffer);
+    SetRenderStates(mBlendState.Get(), mSamplerState.Get(), mDepthStencilState.Get(), mRasterizerState.Get());
+    SetShaders(UseInstancing());
+    SetTransform(mTransformMatrix);
 
     // If this is a deferred D3D context, reset position so the first Map call will use D3D11_MAP_WRITE_DISCARD.
     if (deviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
     {
         mContextResources->vertexBufferPosition = 0;
+        mContextResources->instanceBufferPosition = 0;
+        mContextResources->instanceTextureIndexBufferPosition = 0;
     }
 
     // Hook lets the caller replace our settings with their own custom shaders.
@@ -556,14 +1072,151 @@ void SpriteBatch::Impl::PrepareForRendering()
 }
 
 
-// Sends queued sprites to the graphics device.
-void SpriteBatch::Impl::FlushBatch()
+// Sets the state objects, substituting our defaults for any that are null.
+void SpriteBatch::Impl::SetRenderStates(_In_opt_ ID3D11BlendState* blendState, _In_opt_ ID3D11SamplerState* samplerState, _In_opt_ ID3D11DepthStencilState* depthStencilState, _In_opt_ ID3D11RasterizerState* rasterizerState)
+{
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    if (!blendState)        blendState        = mDeviceResources->stateObjects.AlphaBlend();
+    if (!depthStencilState) depthStencilState = mDeviceResources->stateObjects.DepthNone();
+    if (!rasterizerState)   rasterizerState   = mDeviceResources->stateObjects.CullCounterClockwise();
+    if (!samplerState)      samplerState      = mDeviceResources->stateObjects.LinearClamp();
+
+    deviceContext->OMSetBlendState(blendState, nullptr, 0xFFFFFFFF);
+    deviceContext->OMSetDepthStencilState(depthStencilState, 0);
+    deviceContext->RSSetState(rasterizerState);
+    deviceContext->PSSetSamplers(0, 1, &samplerState);
+}
+
+
+// Sets the shaders, input layout and dynamic vertex buffers.
+void SpriteBatch::Impl::SetShaders(bool instanced)
+{
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    if (instanced && UseMultiTexture())
+    {
+        // Set shaders. As below, plus a texture index that selects between the bound textures.
+        deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        deviceContext->IASetInputLayout(mDeviceResources->multiTextureInputLayout.Get());
+        deviceContext->VSSetShader(mDeviceResources->multiTextureVertexShader.Get(), nullptr, 0);
+        deviceContext->PSSetShader(mDeviceResources->multiTexturePixelShader.Get(), nullptr, 0);
+    }
+    else if (instanced)
+    {
+        // Set shaders. Each instance is expanded into a 4 vertex triangle strip.
+        deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        deviceContext->IASetInputLayout(mDeviceResources->instancedInputLayout.Get());
+        deviceContext->VSSetShader(mDeviceResources->instancedVertexShader.Get(), nullptr, 0);
+        deviceContext->PSSetShader(mDeviceResources->pixelShader.Get(), nullptr, 0);
+    }
+    else
+    {
+        // Set shaders.
+        deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        deviceContext->IASetInputLayout(mDeviceResources->inputLayout.Get());
+        deviceContext->VSSetShader(mDeviceResources->vertexShader.Get(), nullptr, 0);
+        deviceContext->PSSetShader(mDeviceResources->pixelShader.Get(), nullptr, 0);
+
+        deviceContext->IASetIndexBuffer(mDeviceResources->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    }
+
+    BindBuffers(instanced);
+}
+
+
+// Sets the dynamic vertex buffers. This is split out from SetShaders because growing
+// the buffer ring mid-batch replaces them, without touching any custom shaders.
+void SpriteBatch::Impl::BindBuffers(bool instanced)
+{
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    if (instanced && UseMultiTexture())
+    {
+        // Set the instance and texture index buffers.
+        ID3D11Buffer* instanceBuffers[2] = { mContextResources->GetInstanceBuffer(), mContextResources->GetInstanceTextureIndexBuffer() };
+        UINT instanceStrides[2] = { sizeof(SpriteInstance), sizeof(uint32_t) };
+        UINT instanceOffsets[2] = { 0, 0 };
+
+        deviceContext->IASetVertexBuffers(0, 2, instanceBuffers, instanceStrides, instanceOffsets);
+    }
+    else if (instanced)
+    {
+        // Set the instance buffer.
+        auto instanceBuffer = mContextResources->GetInstanceBuffer();
+        UINT instanceStride = sizeof(SpriteInstance);
+        UINT instanceOffset = 0;
+
+        deviceContext->IASetVertexBuffers(0, 1, &instanceBuffer, &instanceStride, &instanceOffset);
+    }
+    else
+    {
+        // Set the vertex buffer.
+        auto vertexBuffer = mContextResources->vertexBuffer.Get();
+        UINT vertexStride = sizeof(VertexPositionColorTexture);
+        UINT vertexOffset = 0;
+
+        deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+    }
+}
+
+
+// Wraps one of the dynamic buffers back to its start, which means the next Map uses D3D11_MAP_WRITE_DISCARD.
+// Once a frame has used up its discard budget, the ring is doubled in size instead: brand new buffers have
+// nothing in flight, so the driver doesn't need to rename them.
+void SpriteBatch::Impl::WrapBufferRing(_Inout_ size_t* bufferPosition, bool instanced)
+{
+    auto& context = *mContextResources;
+
+    *bufferPosition = 0;
+
+    context.frameDiscards++;
+
+    if (context.maxDiscardsPerFrame > 0 &&
+        context.frameDiscards > context.maxDiscardsPerFrame &&
+        context.ringSize < MaxBufferRingSize)
+    {
+        context.SetRingSize(std::min(context.ringSize * 2, MaxBufferRingSize));
+
+        BindBuffers(instanced);
+
+        mStatistics.bufferGrowths++;
+    }
+}
+
+
+// Sets the transform matrix, combined with the viewport transform for the current rotation mode.
+void XM_CALLCONV SpriteBatch::Impl::SetTransform(FXMMATRIX transform)
+{
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    XMMATRIX transformMatrix = (mRotation == DXGI_MODE_ROTATION_UNSPECIFIED)
+                               ? transform
+                               : ( transform * GetViewportTransform(deviceContext, mRotation) );
+
+    mContextResources->constantBuffer.SetData(deviceContext, transformMatrix);
+
+    ID3D11Buffer* constantBuffer = mContextResources->constantBuffer.GetBuffer();
+
+    deviceContext->VSSetConstantBuffers(0, 1, &constantBuffer);
+}
+
+
+// Sends queued sprites to the graphics device.
+void SpriteBatch::Impl::FlushBatch()
 {
     if (!mSpriteQueueCount)
         return;
 
     SortSprites();
 
+    if (UseMultiTexture())
+    {
+        FlushMultiTextureBatch();
+        ResetSpriteQueue();
+        return;
+    }
+
     // Walk through the sorted sprite list, looking for adjacent entries that share a texture.
     ID3D11ShaderResourceView* batchTexture = nullptr;
     size_t batchStart = 0;
@@ -580,6 +1233,8 @@ void SpriteBatch::Impl::FlushBatch()
             if (pos > batchStart)
             {
                 RenderBatch(batchTexture, &mSortedSprites[batchStart], pos - batchStart);
+
+                mStatistics.textureSplits++;
             }
 
             batchTexture = texture;
@@ -590,7 +1245,62 @@ void SpriteBatch::Impl::FlushBatch()
     // Flush the final batch.
     RenderBatch(batchTexture, &mSortedSprites[batchStart], mSpriteQueueCount - batchStart);
 
-    // Reset the queue.
+    ResetSpriteQueue();
+}
+
+
+// Walks through the sorted sprite list, looking for adjacent entries whose textures all fit in
+// one set of bound textures. Only a texture that doesn't fit causes a flush.
+void SpriteBatch::Impl::FlushMultiTextureBatch()
+{
+    ID3D11ShaderResourceView* textures[MaxBatchTextures];
+    size_t textureCount = 0;
+    size_t batchStart = 0;
+
+    mSpriteTextureSlots.resize(mSpriteQueueCount);
+
+    for (size_t pos = 0; pos < mSpriteQueueCount; pos++)
+    {
+        ID3D11ShaderResourceView* texture = mSortedSprites[pos]->texture;
+
+        _Analysis_assume_(texture != nullptr);
+
+        // Is this texture already part of the set?
+        size_t slot = 0;
+
+        while (slot < textureCount && textures[slot] != texture)
+        {
+            slot++;
+        }
+
+        if (slot == textureCount)
+        {
+            // Flush if there is no room to add it.
+            if (textureCount == mBatchTextureCount)
+            {
+                RenderBatchMultiTexture(textures, textureCount, &mSortedSprites[batchStart], &mSpriteTextureSlots[batchStart], pos - batchStart);
+
+                mStatistics.textureSplits++;
+
+                textureCount = 0;
+                slot = 0;
+                batchStart = pos;
+            }
+
+            textures[textureCount++] = texture;
+        }
+
+        mSpriteTextureSlots[pos] = static_cast<uint32_t>(slot);
+    }
+
+    // Flush the final batch.
+    RenderBatchMultiTexture(textures, textureCount, &mSortedSprites[batchStart], &mSpriteTextureSlots[batchStart], mSpriteQueueCount - batchStart);
+}
+
+
+// Empties the sprite queue after its contents have been drawn or recorded.
+void SpriteBatch::Impl::ResetSpriteQueue()
+{
     mSpriteQueueCount = 0;
     mSpriteTextureReferences.clear();
 
@@ -613,6 +1323,12 @@ void SpriteBatch::Impl::SortSprites()
         GrowSortedSprites();
     }
 
+    if (mParallelBatching && mSortMode != SpriteSortMode_Deferred)
+    {
+        RadixSortSprites();
+        return;
+    }
+
     switch (mSortMode)
     {
         case SpriteSortMode_Texture:
@@ -642,6 +1358,203 @@ void SpriteBatch::Impl::SortSprites()
 }
 
 
+namespace
+{
+    // Maps a float to an unsigned key whose integer ordering matches the float ordering.
+    inline uint64_t FloatSortKey(float value)
+    {
+        // Treat -0 and +0 as equal, the same as the std::sort comparisons do.
+        if (value == 0)
+            value = 0;
+
+        uint32_t bits = *reinterpret_cast<uint32_t const*>(&value);
+
+        uint32_t mask = (bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+
+        return bits ^ mask;
+    }
+}
+
+
+// Stable LSD radix sort of the queued sprites. Unlike std::sort, sprites with identical sort keys
+// always stay in submission order, so results are deterministic. Large queues split each pass
+// into chunks that are histogrammed and scattered in parallel, with chunk order preserved
+// inside each bucket to keep the sort stable.
+void SpriteBatch::Impl::RadixSortSprites()
+{
+    size_t count = mSpriteQueueCount;
+
+    mRadixSprites.resize(count);
+    mRadixKeys.resize(count);
+    mRadixKeysScratch.resize(count);
+
+    // Build the sort keys.
+    size_t keyBits;
+
+    switch (mSortMode)
+    {
+        case SpriteSortMode_Texture:
+            keyBits = sizeof(uintptr_t) * 8;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                mRadixKeys[i] = reinterpret_cast<uintptr_t>(mSortedSprites[i]->texture);
+            }
+            break;
+
+        case SpriteSortMode_BackToFront:
+            keyBits = 32;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                mRadixKeys[i] = ~FloatSortKey(mSortedSprites[i]->originRotationDepth.w) & 0xFFFFFFFF;
+            }
+            break;
+
+        case SpriteSortMode_FrontToBack:
+            keyBits = 32;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                mRadixKeys[i] = FloatSortKey(mSortedSprites[i]->originRotationDepth.w);
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    size_t chunkCount = (count >= ParallelSortThreshold) ? (count + ParallelChunkSize - 1) / ParallelChunkSize : 1;
+    size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    mRadixHistograms.resize(chunkCount * RadixBuckets);
+
+    SpriteInfo const** sourceSprites = mSortedSprites.data();
+    SpriteInfo const** destSprites = mRadixSprites.data();
+
+    uint64_t* sourceKeys = mRadixKeys.data();
+    uint64_t* destKeys = mRadixKeysScratch.data();
+
+    size_t* histograms = mRadixHistograms.data();
+
+    for (size_t shift = 0; shift < keyBits; shift += RadixBits)
+    {
+        // Count how many keys from each chunk fall into each bucket.
+        auto countDigits = [&](size_t chunk)
+        {
+            size_t* histogram = histograms + chunk * RadixBuckets;
+
+            memset(histogram, 0, sizeof(size_t) * RadixBuckets);
+
+            size_t end = std::min(count, (chunk + 1) * chunkSize);
+
+            for (size_t i = chunk * chunkSize; i < end; i++)
+            {
+                histogram[(sourceKeys[i] >> shift) & (RadixBuckets - 1)]++;
+            }
+        };
+
+        if (chunkCount > 1)
+        {
+            Concurrency::parallel_for(size_t(0), chunkCount, countDigits);
+        }
+        else
+        {
+            countDigits(0);
+        }
+
+        // Convert counts to output offsets, ordered by bucket and then by chunk. If every key
+        // has the same digit this pass would not reorder anything, so it can be skipped.
+        size_t offset = 0;
+        bool allSame = false;
+
+        for (size_t bucket = 0; bucket < RadixBuckets && !allSame; bucket++)
+        {
+            size_t bucketStart = offset;
+
+            for (size_t chunk = 0; chunk < chunkCount; chunk++)
+            {
+                size_t& entry = histograms[chunk * RadixBuckets + bucket];
+                size_t n = entry;
+
+                entry = offset;
+                offset += n;
+            }
+
+            allSame = (offset - bucketStart == count);
+        }
+
+        if (allSame)
+            continue;
+
+        // Scatter each chunk to its output location.
+        auto scatter = [&](size_t chunk)
+        {
+            size_t* offsets = histograms + chunk * RadixBuckets;
+
+            size_t end = std::min(count, (chunk + 1) * chunkSize);
+
+            for (size_t i = chunk * chunkSize; i < end; i++)
+            {
+                uint64_t key = sourceKeys[i];
+                size_t dest = offsets[(key >> shift) & (RadixBuckets - 1)]++;
+
+                destKeys[dest] = key;
+                destSprites[dest] = sourceSprites[i];
+            }
+        };
+
+        if (chunkCount > 1)
+        {
+            Concurrency::parallel_for(size_t(0), chunkCount, scatter);
+        }
+        else
+        {
+            scatter(0);
+        }
+
+        std::swap(sourceSprites, destSprites);
+        std::swap(sourceKeys, destKeys);
+    }
+
+    // Make sure the final ordering ends up in mSortedSprites.
+    if (sourceSprites != mSortedSprites.data())
+    {
+        memcpy(mSortedSprites.data(), sourceSprites, sizeof(SpriteInfo const*) * count);
+    }
+}
+
+
+// Begins a GPU timing measurement, first collecting any earlier measurements that have completed.
+void SpriteBatch::Impl::StartGpuTiming()
+{
+    if (!mGpuTiming)
+        return;
+
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    double milliseconds;
+
+    while (mGpuTimer.TryResolve(deviceContext, &milliseconds))
+    {
+        mStatistics.gpuMilliseconds += milliseconds;
+        mStatistics.gpuTimings++;
+    }
+
+    mGpuTimer.Start(deviceContext);
+}
+
+
+// Ends a GPU timing measurement.
+void SpriteBatch::Impl::StopGpuTiming()
+{
+    if (!mGpuTiming)
+        return;
+
+    mGpuTimer.Stop(mContextResources->deviceContext.Get());
+}
+
+
 // Populates the mSortedSprites vector with pointers to individual elements of the mSpriteQueue array.
 void SpriteBatch::Impl::GrowSortedSprites()
 {
@@ -666,65 +1579,429 @@ void SpriteBatch::Impl::RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_
 
     XMVECTOR textureSize = GetTextureSize(texture);
     XMVECTOR inverseTextureSize = XMVectorReciprocal(textureSize);
+
+    if (UseInstancing())
+    {
+        // The multi-texture shaders also read a texture index, which is always the one bound texture here.
+        uint32_t const* textureSlots = nullptr;
+
+        if (UseMultiTexture())
+        {
+            mSpriteTextureSlots.assign(count, 0);
+
+            textureSlots = mSpriteTextureSlots.data();
+        }
+
+        RenderBatchInstanced(sprites, textureSlots, count, &textureSize, &inverseTextureSize);
+        return;
+    }
             
+    while (count > 0)
+    {
+        // How many sprites do we want to draw? The shared index buffer limits how many fit in one draw call.
+        size_t batchSize = std::min(count, MaxBatchSize);
+
+        // How many sprites does the D3D vertex buffer have room for?
+        size_t remainingSpace = mContextResources->ringSize - mContextResources->vertexBufferPosition;
+
+        if (batchSize > remainingSpace)
+        {
+            if (remainingSpace < MinBatchSize)
+            {
+                // If we are out of room, or about to submit an excessively small batch, wrap back to the start of the vertex buffer.
+                WrapBufferRing(&mContextResources->vertexBufferPosition, false);
+            }
+            else
+            {
+                // Take however many sprites fit in what's left of the vertex buffer.
+                batchSize = remainingSpace;
+            }
+        }
+
+        // Lock the vertex buffer.
+        D3D11_MAP mapType = (mContextResources->vertexBufferPosition == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+
+        D3D11_MAPPED_SUBRESOURCE mappedBuffer;
+
+        ThrowIfFailed(
+            deviceContext->Map(mContextResources->vertexBuffer.Get(), 0, mapType, 0, &mappedBuffer)
+        );
+
+        mStatistics.maps++;
+
+        if (mapType == D3D11_MAP_WRITE_DISCARD)
+        {
+            mStatistics.discards++;
+        }
+
+        auto vertices = static_cast<VertexPositionColorTexture*>(mappedBuffer.pData) + mContextResources->vertexBufferPosition * VerticesPerSprite;
+
+        // Generate sprite vertex data.
+        RenderChunks(sprites, vertices, VerticesPerSprite, batchSize, [&](SpriteInfo const* const* chunkSprites, VertexPositionColorTexture* chunkVertices, size_t chunkCount)
+        {
+            RenderSprites(chunkSprites, chunkVertices, chunkCount, textureSize, inverseTextureSize);
+        });
+
+        deviceContext->Unmap(mContextResources->vertexBuffer.Get(), 0);
+
+        // Ok lads, the time has come for us draw ourselves some sprites! The ring can be larger than the
+        // index buffer, so the base vertex location selects where in the vertex buffer this batch lives.
+        UINT indexCount = (UINT)batchSize * IndicesPerSprite;
+        INT baseVertex = (INT)(mContextResources->vertexBufferPosition * VerticesPerSprite);
+
+        deviceContext->DrawIndexed(indexCount, 0, baseVertex);
+
+        mStatistics.drawCalls++;
+        mStatistics.sprites += batchSize;
+
+        mContextResources->frameSprites += batchSize;
+
+        // Advance the buffer position.
+        mContextResources->vertexBufferPosition += batchSize;
+
+        sprites += batchSize;
+        count -= batchSize;
+
+        if (count > 0)
+        {
+            mStatistics.bufferSplits++;
+        }
+    }
+}
+
+
+// Submits a batch of sprites that may use any of the specified textures, drawn with a single set of bindings.
+void SpriteBatch::Impl::RenderBatchMultiTexture(_In_reads_(textureCount) ID3D11ShaderResourceView* const* textures, size_t textureCount, _In_reads_(count) SpriteInfo const* const* sprites, _In_reads_(count) uint32_t const* textureSlots, size_t count)
+{
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    // Draw using the specified textures.
+    deviceContext->PSSetShaderResources(0, static_cast<UINT>(textureCount), textures);
+
+    XMVECTOR textureSizes[MaxBatchTextures];
+    XMVECTOR inverseTextureSizes[MaxBatchTextures];
+
+    for (size_t i = 0; i < textureCount; i++)
+    {
+        textureSizes[i] = GetTextureSize(textures[i]);
+        inverseTextureSizes[i] = XMVectorReciprocal(textureSizes[i]);
+    }
+
+    RenderBatchInstanced(sprites, textureSlots, count, textureSizes, inverseTextureSizes);
+}
+
+
+// Splits vertex generation for a mapped batch into chunks. These run on the Concurrency Runtime
+// worker threads when parallel batching is enabled and the batch is big enough to be worth it.
+// Every chunk writes a disjoint range of the mapped buffer, so the result is identical to
+// generating everything serially, and the caller still issues a single ordered draw.
+template<typename TVertex, typename TGenerate>
+void SpriteBatch::Impl::RenderChunks(_In_reads_(count) SpriteInfo const* const* sprites, _Out_ TVertex* output, size_t outputPerSprite, size_t count, TGenerate generate)
+{
+    if (!mParallelBatching || count < ParallelChunkSize * 2)
+    {
+        generate(sprites, output, count);
+        return;
+    }
+
+    size_t chunkCount = (count + ParallelChunkSize - 1) / ParallelChunkSize;
+
+    Concurrency::parallel_for(size_t(0), chunkCount, [&](size_t chunk)
+    {
+        size_t start = chunk * ParallelChunkSize;
+        size_t chunkSize = std::min(ParallelChunkSize, count - start);
+
+        generate(sprites + start, output + start * outputPerSprite, chunkSize);
+    });
+}
+
+
+// Generates vertex data for a run of sprites, four at a time, then mops up any leftovers.
+void XM_CALLCONV SpriteBatch::Impl::RenderSprites(_In_reads_(count) SpriteInfo const* const* sprites, _Out_cap_(count * VerticesPerSprite) VertexPositionColorTexture* vertices, size_t count, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        RenderSprites4(&sprites[i], vertices, textureSize, inverseTextureSize);
+
+        vertices += VerticesPerSprite * 4;
+    }
+
+    for (; i < count; i++)
+    {
+        RenderSprite(sprites[i], vertices, textureSize, inverseTextureSize);
+
+        vertices += VerticesPerSprite;
+    }
+}
+
+
+// Generates vertex data for drawing four sprites at once. This is a structure-of-arrays
+// version of RenderSprite: each XMVECTOR holds one parameter for four different sprites.
+// It performs exactly the same floating point operations in the same order as the
+// single sprite path, so the two produce bit-identical vertices.
+void XM_CALLCONV SpriteBatch::Impl::RenderSprites4(_In_reads_(4) SpriteInfo const* const* sprites, _Out_cap_c_(VerticesPerSprite * 4) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize)
+{
+    // Load sprite parameters, and transpose them so each vector holds one field from all four sprites.
+    XMMATRIX source = XMMatrixTranspose(XMMATRIX(XMLoadFloat4A(&sprites[0]->source),
+                                                 XMLoadFloat4A(&sprites[1]->source),
+                                                 XMLoadFloat4A(&sprites[2]->source),
+                                                 XMLoadFloat4A(&sprites[3]->source)));
+
+    XMMATRIX destination = XMMatrixTranspose(XMMATRIX(XMLoadFloat4A(&sprites[0]->destination),
+                                                      XMLoadFloat4A(&sprites[1]->destination),
+                                                      XMLoadFloat4A(&sprites[2]->destination),
+                                                      XMLoadFloat4A(&sprites[3]->destination)));
+
+    XMMATRIX originRotationDepth = XMMatrixTranspose(XMMATRIX(XMLoadFloat4A(&sprites[0]->originRotationDepth),
+                                                              XMLoadFloat4A(&sprites[1]->originRotationDepth),
+                                                              XMLoadFloat4A(&sprites[2]->originRotationDepth),
+                                                              XMLoadFloat4A(&sprites[3]->originRotationDepth)));
+
+    XMVECTOR sourceX = source.r[0];
+    XMVECTOR sourceY = source.r[1];
+    XMVECTOR sourceWidth = source.r[2];
+    XMVECTOR sourceHeight = source.r[3];
+
+    XMVECTOR destinationX = destination.r[0];
+    XMVECTOR destinationY = destination.r[1];
+    XMVECTOR destinationWidth = destination.r[2];
+    XMVECTOR destinationHeight = destination.r[3];
+
+    XMVECTOR depth = originRotationDepth.r[3];
+
+    // Build per-lane masks from the sprite flags.
+    XMVECTOR flags = XMVectorSetInt(sprites[0]->flags, sprites[1]->flags, sprites[2]->flags, sprites[3]->flags);
+
+    XMVECTOR sourceInTexels   = XMVectorNotEqualInt(XMVectorAndInt(flags, XMVectorReplicateInt(SpriteInfo::SourceInTexels)), XMVectorZero());
+    XMVECTOR destSizeInPixels = XMVectorNotEqualInt(XMVectorAndInt(flags, XMVectorReplicateInt(SpriteInfo::DestSizeInPixels)), XMVectorZero());
+    XMVECTOR flipHorizontally = XMVectorNotEqualInt(XMVectorAndInt(flags, XMVectorReplicateInt(SpriteEffects_FlipHorizontally)), XMVectorZero());
+    XMVECTOR flipVertically   = XMVectorNotEqualInt(XMVectorAndInt(flags, XMVectorReplicateInt(SpriteEffects_FlipVertically)), XMVectorZero());
+
+    XMVECTOR textureWidth = XMVectorSplatX(textureSize);
+    XMVECTOR textureHeight = XMVectorSplatY(textureSize);
+    XMVECTOR inverseTextureWidth = XMVectorSplatX(inverseTextureSize);
+    XMVECTOR inverseTextureHeight = XMVectorSplatY(inverseTextureSize);
+
+    // Scale the origin offset by source size, taking care to avoid overflow if the source region is zero.
+    XMVECTOR nonZeroSourceWidth  = XMVectorSelect(sourceWidth,  g_XMEpsilon, XMVectorEqual(sourceWidth,  XMVectorZero()));
+    XMVECTOR nonZeroSourceHeight = XMVectorSelect(sourceHeight, g_XMEpsilon, XMVectorEqual(sourceHeight, XMVectorZero()));
+
+    XMVECTOR originX = XMVectorDivide(originRotationDepth.r[0], nonZeroSourceWidth);
+    XMVECTOR originY = XMVectorDivide(originRotationDepth.r[1], nonZeroSourceHeight);
+
+    // Convert the source region from texels to mod-1 texture coordinate format.
+    sourceX      = XMVectorSelect(sourceX,      sourceX      * inverseTextureWidth,  sourceInTexels);
+    sourceY      = XMVectorSelect(sourceY,      sourceY      * inverseTextureHeight, sourceInTexels);
+    sourceWidth  = XMVectorSelect(sourceWidth,  sourceWidth  * inverseTextureWidth,  sourceInTexels);
+    sourceHeight = XMVectorSelect(sourceHeight, sourceHeight * inverseTextureHeight, sourceInTexels);
+
+    originX = XMVectorSelect(originX * inverseTextureWidth,  originX, sourceInTexels);
+    originY = XMVectorSelect(originY * inverseTextureHeight, originY, sourceInTexels);
+
+    // If the destination size is relative to the source region, convert it to pixels.
+    destinationWidth  = XMVectorSelect(destinationWidth  * textureWidth,  destinationWidth,  destSizeInPixels);
+    destinationHeight = XMVectorSelect(destinationHeight * textureHeight, destinationHeight, destSizeInPixels);
+
+    // Compute the 2x2 rotation matrices. Sin/cos use the same scalar approximation as
+    // RenderSprite, and unrotated sprites get an exact identity (including the sign of zero).
+    XMFLOAT4A sinValues, cosValues, negSinValues;
+
+    float* sinLanes = &sinValues.x;
+    float* cosLanes = &cosValues.x;
+    float* negSinLanes = &negSinValues.x;
+
+    for (int j = 0; j < 4; j++)
+    {
+        float rotation = sprites[j]->originRotationDepth.z;
+
+        if (rotation != 0)
+        {
+            XMScalarSinCos(&sinLanes[j], &cosLanes[j], rotation);
+
+            negSinLanes[j] = -sinLanes[j];
+        }
+        else
+        {
+            sinLanes[j] = 0;
+            cosLanes[j] = 1;
+            negSinLanes[j] = 0;
+        }
+    }
+
+    XMVECTOR sinRotation = XMLoadFloat4A(&sinValues);
+    XMVECTOR cosRotation = XMLoadFloat4A(&cosValues);
+    XMVECTOR negSinRotation = XMLoadFloat4A(&negSinValues);
+
+    // Generate the four output vertices for each sprite.
+    for (int i = 0; i < VerticesPerSprite; i++)
+    {
+        XMVECTOR cornerX = (i & 1) ? g_XMOne : g_XMZero;
+        XMVECTOR cornerY = (i & 2) ? g_XMOne : g_XMZero;
+
+        // Calculate position.
+        XMVECTOR cornerOffsetX = (cornerX - originX) * destinationWidth;
+        XMVECTOR cornerOffsetY = (cornerY - originY) * destinationHeight;
+
+        // Apply 2x2 rotation matrix.
+        XMVECTOR positionX = XMVectorMultiplyAdd(cornerOffsetX, cosRotation, destinationX);
+        XMVECTOR positionY = XMVectorMultiplyAdd(cornerOffsetX, sinRotation, destinationY);
+
+        positionX = XMVectorMultiplyAdd(cornerOffsetY, negSinRotation, positionX);
+        positionY = XMVectorMultiplyAdd(cornerOffsetY, cosRotation, positionY);
+
+        // Compute the texture coordinate, indexing the corner table in mirrored order where needed.
+        XMVECTOR mirrorX = XMVectorSelect(cornerX, g_XMOne - cornerX, flipHorizontally);
+        XMVECTOR mirrorY = XMVectorSelect(cornerY, g_XMOne - cornerY, flipVertically);
+
+        XMVECTOR textureCoordinateX = XMVectorMultiplyAdd(mirrorX, sourceWidth, sourceX);
+        XMVECTOR textureCoordinateY = XMVectorMultiplyAdd(mirrorY, sourceHeight, sourceY);
+
+        // Transpose back to one vector per sprite.
+        XMMATRIX positions = XMMatrixTranspose(XMMATRIX(positionX, positionY, depth, g_XMZero));
+        XMMATRIX textureCoordinates = XMMatrixTranspose(XMMATRIX(textureCoordinateX, textureCoordinateY, g_XMZero, g_XMZero));
+
+        for (int j = 0; j < 4; j++)
+        {
+            VertexPositionColorTexture* vertex = &vertices[j * VerticesPerSprite + i];
+
+            // As in RenderSprite, the float4 position store clobbers color.x, which is written next.
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&vertex->position), positions.r[j]);
+            XMStoreFloat4(&vertex->color, XMLoadFloat4A(&sprites[j]->color));
+            XMStoreFloat2(&vertex->textureCoordinate, textureCoordinates.r[j]);
+        }
+    }
+}
+
+
+// Submits a batch of sprites to the GPU, uploading one SpriteInstance per sprite rather than four vertices.
+// Without texture slots every sprite uses the first texture size, otherwise each one indexes the size arrays.
+void SpriteBatch::Impl::RenderBatchInstanced(_In_reads_(count) SpriteInfo const* const* sprites, _In_reads_opt_(count) uint32_t const* textureSlots, size_t count, _In_ XMVECTOR const* textureSizes, _In_ XMVECTOR const* inverseTextureSizes)
+{
+    auto deviceContext = mContextResources->deviceContext.Get();
+
     while (count > 0)
     {
         // How many sprites do we want to draw?
-        size_t batchSize = count;
+        size_t batchSize = std::min(count, mContextResources->ringSize);
 
-        // How many sprites does the D3D vertex buffer have room for?
-        size_t remainingSpace = MaxBatchSize - mContextResources->vertexBufferPosition;
+        // How many sprites does the D3D instance buffer have room for?
+        size_t remainingSpace = mContextResources->ringSize - mContextResources->instanceBufferPosition;
 
         if (batchSize > remainingSpace)
         {
             if (remainingSpace < MinBatchSize)
             {
-                // If we are out of room, or about to submit an excessively small batch, wrap back to the start of the vertex buffer.
-                mContextResources->vertexBufferPosition = 0;
+                // If we are out of room, or about to submit an excessively small batch, wrap back to the start of the instance buffer.
+                WrapBufferRing(&mContextResources->instanceBufferPosition, true);
 
-                batchSize = std::min(count, MaxBatchSize);
+                batchSize = std::min(count, mContextResources->ringSize);
             }
             else
             {
-                // Take however many sprites fit in what's left of the vertex buffer.
+                // Take however many sprites fit in what's left of the instance buffer.
                 batchSize = remainingSpace;
             }
         }
 
-        // Lock the vertex buffer.
-        D3D11_MAP mapType = (mContextResources->vertexBufferPosition == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+        // Lock the instance buffer. This is looked up each time, as wrapping may have replaced it.
+        auto instanceBuffer = mContextResources->GetInstanceBuffer();
+
+        D3D11_MAP mapType = (mContextResources->instanceBufferPosition == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
 
         D3D11_MAPPED_SUBRESOURCE mappedBuffer;
 
         ThrowIfFailed(
-            deviceContext->Map(mContextResources->vertexBuffer.Get(), 0, mapType, 0, &mappedBuffer)
+            deviceContext->Map(instanceBuffer, 0, mapType, 0, &mappedBuffer)
         );
 
-        auto vertices = static_cast<VertexPositionColorTexture*>(mappedBuffer.pData) + mContextResources->vertexBufferPosition * VerticesPerSprite;
+        mStatistics.maps++;
 
-        // Generate sprite vertex data.
-        for (size_t i = 0; i < batchSize; i++)
+        if (mapType == D3D11_MAP_WRITE_DISCARD)
         {
-            assert(i < count);
-            _Analysis_assume_(i < count);
-            RenderSprite(sprites[i], vertices, textureSize, inverseTextureSize);
-
-            vertices += VerticesPerSprite;
+            mStatistics.discards++;
         }
 
-        deviceContext->Unmap(mContextResources->vertexBuffer.Get(), 0);
+        auto instances = static_cast<SpriteInstance*>(mappedBuffer.pData) + mContextResources->instanceBufferPosition;
 
-        // Ok lads, the time has come for us draw ourselves some sprites!
-        UINT startIndex = (UINT)mContextResources->vertexBufferPosition * IndicesPerSprite;
-        UINT indexCount = (UINT)batchSize * IndicesPerSprite;
+        // Generate per-sprite instance data.
+        RenderChunks(sprites, instances, 1, batchSize, [&](SpriteInfo const* const* chunkSprites, SpriteInstance* chunkInstances, size_t chunkCount)
+        {
+            uint32_t const* chunkSlots = textureSlots ? textureSlots + (chunkSprites - sprites) : nullptr;
+
+            for (size_t i = 0; i < chunkCount; i++)
+            {
+                size_t slot = chunkSlots ? chunkSlots[i] : 0;
+
+                RenderSpriteInstance(chunkSprites[i], chunkInstances + i, textureSizes[slot], inverseTextureSizes[slot]);
+            }
+        });
+
+        deviceContext->Unmap(instanceBuffer, 0);
+
+        if (textureSlots)
+        {
+            // Upload the matching texture indices, wrapping the index buffer separately from the instance buffer.
+            auto textureIndexBuffer = mContextResources->GetInstanceTextureIndexBuffer();
+
+            if (batchSize > mContextResources->ringSize - mContextResources->instanceTextureIndexBufferPosition)
+            {
+                mContextResources->instanceTextureIndexBufferPosition = 0;
+            }
+
+            size_t textureIndexPosition = mContextResources->instanceTextureIndexBufferPosition;
+
+            D3D11_MAP textureIndexMapType = (textureIndexPosition == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+
+            ThrowIfFailed(
+                deviceContext->Map(textureIndexBuffer, 0, textureIndexMapType, 0, &mappedBuffer)
+            );
+
+            mStatistics.maps++;
+
+            if (textureIndexMapType == D3D11_MAP_WRITE_DISCARD)
+            {
+                mStatistics.discards++;
+            }
 
-        deviceContext->DrawIndexed(indexCount, startIndex, 0);
+            memcpy(static_cast<uint32_t*>(mappedBuffer.pData) + textureIndexPosition, textureSlots, sizeof(uint32_t) * batchSize);
+
+            deviceContext->Unmap(textureIndexBuffer, 0);
+
+            // StartInstanceLocation would offset both streams by the same amount, so each is offset through its binding instead.
+            ID3D11Buffer* instanceBuffers[2] = { instanceBuffer, textureIndexBuffer };
+            UINT instanceStrides[2] = { sizeof(SpriteInstance), sizeof(uint32_t) };
+            UINT instanceOffsets[2] = { (UINT)(mContextResources->instanceBufferPosition * sizeof(SpriteInstance)), (UINT)(textureIndexPosition * sizeof(uint32_t)) };
+
+            deviceContext->IASetVertexBuffers(0, 2, instanceBuffers, instanceStrides, instanceOffsets);
+
+            deviceContext->DrawInstanced(VerticesPerSprite, (UINT)batchSize, 0, 0);
+
+            mContextResources->instanceTextureIndexBufferPosition += batchSize;
+
+            textureSlots += batchSize;
+        }
+        else
+        {
+            deviceContext->DrawInstanced(VerticesPerSprite, (UINT)batchSize, 0, (UINT)mContextResources->instanceBufferPosition);
+        }
+
+        mStatistics.drawCalls++;
+        mStatistics.sprites += batchSize;
+
+        mContextResources->frameSprites += batchSize;
 
         // Advance the buffer position.
-        mContextResources->vertexBufferPosition += batchSize;
+        mContextResources->instanceBufferPosition += batchSize;
 
         sprites += batchSize;
         count -= batchSize;
+
+        if (count > 0)
+        {
+            mStatistics.bufferSplits++;
+        }
     }
 }
 
@@ -840,6 +2117,65 @@ void XM_CALLCONV SpriteBatch::Impl::RenderSprite(_In_ SpriteInfo const* sprite,
 }
 
 
+// Generates the per-instance data for drawing a single sprite. This performs the same
+// normalization as RenderSprite, leaving only the corner and rotation math to the GPU.
+void XM_CALLCONV SpriteBatch::Impl::RenderSpriteInstance(_In_ SpriteInfo const* sprite, _Out_ SpriteInstance* instance, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize)
+{
+    // Load sprite parameters into SIMD registers.
+    XMVECTOR source = XMLoadFloat4A(&sprite->source);
+    XMVECTOR destination = XMLoadFloat4A(&sprite->destination);
+    XMVECTOR originRotationDepth = XMLoadFloat4A(&sprite->originRotationDepth);
+
+    int flags = sprite->flags;
+
+    // Extract the source and destination sizes into separate vectors.
+    XMVECTOR sourceSize = XMVectorSwizzle<2, 3, 2, 3>(source);
+    XMVECTOR destinationSize = XMVectorSwizzle<2, 3, 2, 3>(destination);
+
+    // Scale the origin offset by source size, taking care to avoid overflow if the source region is zero.
+    XMVECTOR isZeroMask = XMVectorEqual(sourceSize, XMVectorZero());
+    XMVECTOR nonZeroSourceSize = XMVectorSelect(sourceSize, g_XMEpsilon, isZeroMask);
+
+    XMVECTOR origin = XMVectorDivide(originRotationDepth, nonZeroSourceSize);
+
+    // Convert the source region from texels to mod-1 texture coordinate format.
+    if (flags & SpriteInfo::SourceInTexels)
+    {
+        source *= inverseTextureSize;
+        sourceSize *= inverseTextureSize;
+    }
+    else
+    {
+        origin *= inverseTextureSize;
+    }
+
+    // If the destination size is relative to the source region, convert it to pixels.
+    if (!(flags & SpriteInfo::DestSizeInPixels))
+    {
+        destinationSize *= textureSize;
+    }
+
+    // Fold mirroring into the source region: a flipped axis starts at the far edge and runs backwards.
+    static const XMVECTORU32 flipMasks[4] =
+    {
+        { 0,          0,          0, 0 },
+        { 0xFFFFFFFF, 0,          0, 0 },
+        { 0,          0xFFFFFFFF, 0, 0 },
+        { 0xFFFFFFFF, 0xFFFFFFFF, 0, 0 },
+    };
+
+    XMVECTOR flipMask = flipMasks[flags & 3];
+
+    source = XMVectorSelect(source, source + sourceSize, flipMask);
+    sourceSize = XMVectorSelect(sourceSize, -sourceSize, flipMask);
+
+    XMStoreFloat4(&instance->destination, XMVectorPermute<0, 1, 4, 5>(destination, destinationSize));
+    XMStoreFloat4(&instance->source, XMVectorPermute<0, 1, 4, 5>(source, sourceSize));
+    XMStoreFloat4(&instance->originRotationDepth, XMVectorPermute<0, 1, 6, 7>(origin, originRotationDepth));
+    instance->color = sprite->color;
+}
+
+
 // Helper looks up the size of the specified texture.
 XMVECTOR SpriteBatch::Impl::GetTextureSize(_In_ ID3D11ShaderResourceView* texture)
 {
@@ -928,6 +2264,111 @@ XMMATRIX SpriteBatch::Impl::GetViewportTransform(_In_ ID3D11DeviceContext* devic
 }
 
 
+// Enables or disables instanced rendering for subsequent batches.
+void SpriteBatch::Impl::SetInstancing(bool enable)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot change instancing mode inside a Begin/End pair");
+
+    mInstancing = enable;
+}
+
+
+// Enables or disables the stable radix sort and multithreaded vertex generation.
+void SpriteBatch::Impl::SetParallelBatching(bool enable)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot change parallel batching mode inside a Begin/End pair");
+
+    mParallelBatching = enable;
+}
+
+
+// Sets how many textures can be bound at once by multi-texture batching. 1 disables it.
+void SpriteBatch::Impl::SetBatchTextureCount(size_t count)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot change batch texture count inside a Begin/End pair");
+
+    if (count < 1 || count > MaxBatchTextures)
+        throw std::exception("Batch texture count must be between 1 and MaxBatchTextures");
+
+    mBatchTextureCount = count;
+}
+
+
+// Enables or disables timestamp queries around each flush.
+void SpriteBatch::Impl::SetGpuTiming(bool enable)
+{
+    if (mInBeginEndPair)
+        throw std::exception("Cannot change GPU timing mode inside a Begin/End pair");
+
+    mGpuTiming = enable;
+}
+
+
+// Resizes the dynamic buffer ring shared by every SpriteBatch on this device context.
+void SpriteBatch::Impl::SetBufferRingSize(size_t spriteCount)
+{
+    if (mInBeginEndPair || mContextResources->inImmediateMode)
+        throw std::exception("Cannot change buffer ring size inside a Begin/End pair");
+
+    if (spriteCount < MaxBatchSize || spriteCount > MaxBufferRingSize)
+        throw std::exception("Buffer ring size must be between 2048 and 65536 sprites");
+
+    mContextResources->SetRingSize(spriteCount);
+}
+
+
+size_t SpriteBatch::Impl::GetBufferRingSize() const
+{
+    return mContextResources->ringSize;
+}
+
+
+void SpriteBatch::Impl::SetMaxDiscardsPerFrame(size_t maxDiscards)
+{
+    mContextResources->maxDiscardsPerFrame = maxDiscards;
+}
+
+
+void SpriteBatch::Impl::SetAdaptiveBufferRing(bool enable)
+{
+    mContextResources->adaptiveRingSize = enable;
+}
+
+
+// Marks a frame boundary for the per-context buffer ring policies.
+void SpriteBatch::Impl::EndFrame()
+{
+    if (mInBeginEndPair || mContextResources->inImmediateMode)
+        throw std::exception("Cannot end a frame inside a Begin/End pair");
+
+    mContextResources->EndFrame();
+}
+
+
+// Reports whether sprites will actually be drawn using instancing.
+bool SpriteBatch::Impl::GetInstancing() const
+{
+    return UseInstancing();
+}
+
+
+// Instancing is opt-in, and silently falls back to the CPU vertex path on devices that can't support it.
+bool SpriteBatch::Impl::UseInstancing() const
+{
+    return mInstancing && (mDeviceResources->instancedVertexShader != nullptr);
+}
+
+
+// Multi-texture batching is built on the instanced path, so has no effect without it.
+bool SpriteBatch::Impl::UseMultiTexture() const
+{
+    return (mBatchTextureCount > 1) && UseInstancing();
+}
+
+
 // Public constructor.
 SpriteBatch::SpriteBatch(_In_ ID3D11DeviceContext* deviceContext)
   : pImpl(new Impl(deviceContext))
@@ -1046,6 +2487,18 @@ void XM_CALLCONV SpriteBatch::Draw(_In_ ID3D11ShaderResourceView* texture, RECT
 }
 
 
+void XM_CALLCONV SpriteBatch::DrawSprites(_In_ ID3D11ShaderResourceView* texture, size_t count, _In_reads_(count) RECT const* sourceRectangles, _In_reads_(count) XMFLOAT2 const* origins, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects, float layerDepth)
+{
+    XMVECTOR destination = XMVectorPermute<0, 1, 4, 5>(position, scale); // x, y, scale.x, scale.y
+
+    XMVECTOR rotationDepth = XMVectorMergeXY(XMVectorReplicate(rotation), XMVectorReplicate(layerDepth));
+
+    XMVECTOR originRotationDepth = XMVectorPermute<0, 1, 4, 5>(origin, rotationDepth);
+
+    pImpl->DrawSprites(texture, count, sourceRectangles, origins, destination, color, originRotationDepth, effects);
+}
+
+
 void SpriteBatch::SetRotation( DXGI_MODE_ROTATION mode )
 {
     pImpl->mRotation = mode;
@@ -1063,3 +2516,144 @@ void SpriteBatch::SetViewport( const D3D11_VIEWPORT& viewPort )
     pImpl->mSetViewport = true;
     pImpl->mViewPort = viewPort;
 }
+
+
+ID3D11DeviceContext* SpriteBatch::GetDeviceContext() const
+{
+    return pImpl->mContextResources->deviceContext.Get();
+}
+
+
+void SpriteBatch::SetInstancing(bool enable)
+{
+    pImpl->SetInstancing(enable);
+}
+
+
+bool SpriteBatch::GetInstancing() const
+{
+    return pImpl->GetInstancing();
+}
+
+
+void SpriteBatch::SetParallelBatching(bool enable)
+{
+    pImpl->SetParallelBatching(enable);
+}
+
+
+void SpriteBatch::SetBatchTextureCount(size_t count)
+{
+    pImpl->SetBatchTextureCount(count);
+}
+
+
+SpriteBatchStatistics SpriteBatch::GetStatistics() const
+{
+    return pImpl->mStatistics;
+}
+
+
+void SpriteBatch::ResetStatistics()
+{
+    memset(&pImpl->mStatistics, 0, sizeof(pImpl->mStatistics));
+}
+
+
+void SpriteBatch::SetGpuTiming(bool enable)
+{
+    pImpl->SetGpuTiming(enable);
+}
+
+
+void SpriteBatch::SetBufferRingSize(size_t spriteCount)
+{
+    pImpl->SetBufferRingSize(spriteCount);
+}
+
+
+size_t SpriteBatch::GetBufferRingSize() const
+{
+    return pImpl->GetBufferRingSize();
+}
+
+
+void SpriteBatch::SetMaxDiscardsPerFrame(size_t maxDiscards)
+{
+    pImpl->SetMaxDiscardsPerFrame(maxDiscards);
+}
+
+
+void SpriteBatch::SetAdaptiveBufferRing(bool enable)
+{
+    pImpl->SetAdaptiveBufferRing(enable);
+}
+
+
+void SpriteBatch::EndFrame()
+{
+    pImpl->EndFrame();
+}
+
+
+std::unique_ptr<SpriteList> SpriteBatch::EndSpriteList()
+{
+    std::unique_ptr<SpriteList> spriteList(new SpriteList());
+
+    pImpl->EndSpriteList(spriteList->pImpl.get());
+
+    return spriteList;
+}
+
+
+void XM_CALLCONV SpriteBatch::DrawSpriteList(_In_ SpriteList const* spriteList, FXMMATRIX transformMatrix)
+{
+    if (!spriteList)
+        throw std::exception("SpriteList cannot be null");
+
+    pImpl->DrawSpriteList(spriteList->pImpl.get(), transformMatrix);
+}
+
+
+//--------------------------------------------------------------------------------------
+// SpriteList
+//--------------------------------------------------------------------------------------
+
+// Private constructor, used by SpriteBatch::EndSpriteList.
+SpriteList::SpriteList()
+  : pImpl(new Impl())
+{
+}
+
+
+// Move constructor.
+SpriteList::SpriteList(SpriteList&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+SpriteList& SpriteList::operator= (SpriteList&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+SpriteList::~SpriteList()
+{
+}
+
+
+size_t SpriteList::GetSpriteCount() const
+{
+    return pImpl->spriteCount;
+}
+
+
+size_t SpriteList::GetBatchCount() const
+{
+    return pImpl->batches.size();
+}
@@ -20,6 +20,7 @@
 #include "SpriteFont.h"
 #include "DirectXHelpers.h"
 #include "BinaryReader.h"
+#include "PlatformHelpers.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -29,11 +30,17 @@ using namespace Microsoft::WRL;
 class SpriteFont::Impl
 {
 public:
-    Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader);
+    Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader, size_t atlasWidth, size_t atlasHeight);
     Impl(_In_ ID3D11ShaderResourceView* texture, _In_reads_(glyphCount) Glyph const* glyphs, _In_ size_t glyphCount, _In_ float lineSpacing);
 
     Glyph const* FindGlyph(wchar_t character) const;
 
+    float GetKerning(uint32_t first, uint32_t second) const;
+
+    ID3D11ShaderResourceView* GetGlyphSource(_In_ ID3D11DeviceContext* deviceContext, _In_ Glyph const* glyph, _Out_ RECT* sourceRect);
+
+    void EndFrame();
+
     void SetDefaultCharacter(wchar_t character);
 
     template<typename TAction>
@@ -45,6 +52,82 @@ public:
     std::vector<Glyph> glyphs;
     Glyph const* defaultGlyph;
     float lineSpacing;
+
+    // Spacing adjustments between pairs of characters, sorted by first then second character.
+    // Only version 2 files carry these, so for other fonts the vector is empty.
+    struct KerningPair
+    {
+        uint32_t First;
+        uint32_t Second;
+        float Amount;
+    };
+
+    std::vector<KerningPair> kerningPairs;
+
+    // Streaming mode keeps the glyph bitmaps in system memory, copying them into a
+    // small GPU atlas as they are used, so only recently drawn glyphs take up VRAM.
+    bool IsStreaming() const { return atlasTexture != nullptr; }
+
+private:
+    void BuildGlyphPages();
+    void ReadGlyphPages(_In_ BinaryReader* reader);
+    void CreateAtlas(_In_ ID3D11Device* device, DXGI_FORMAT format, size_t atlasWidth, size_t atlasHeight);
+    uint32_t AllocateAtlasCell();
+    void UploadAtlasCell(_In_ ID3D11DeviceContext* deviceContext, _In_ Glyph const* glyph, uint32_t cell);
+    void TouchAtlasCell(uint32_t cell);
+    void UnlinkAtlasCell(uint32_t cell);
+
+    // Two-level lookup table mapping every 16-bit wchar_t to a glyph index, so FindGlyph does not
+    // need to binary search. glyphPageMap selects a 256 entry page within glyphPages for each block
+    // of 256 characters. Blocks with no glyphs all share page 0, which is never written to, so the
+    // lookup needs no extra branch.
+    static const uint32_t GlyphPageSize = 256;
+    static const uint32_t GlyphPageCount = 256;
+    static const uint32_t MissingGlyph = 0xFFFFFFFF;
+
+    uint32_t glyphPageMap[GlyphPageCount];
+    std::vector<uint32_t> glyphPages;
+
+    // Streaming mode source data.
+    std::vector<uint8_t> glyphPixels;
+    uint32_t glyphPixelsWidth;
+    uint32_t glyphPixelsHeight;
+    uint32_t glyphPixelsStride;
+    uint32_t bytesPerPixel;
+
+    // The atlas is a grid of equal sized cells big enough for the largest glyph, plus a border
+    // so linear filtering doesn't pick up whatever used to live in the neighboring cell.
+    static const uint32_t AtlasBorder = 1;
+    static const uint32_t NoAtlasCell = 0xFFFFFFFF;
+
+    ComPtr<ID3D11Texture2D> atlasTexture;
+
+    // Set when the driver does not support command lists, in which case the runtime applies the destination
+    // box of an UpdateSubresource on a deferred context to the source data as well, so that has to be undone.
+    bool atlasDeferredBoxWorkaround;
+
+    // Guards all the atlas state below, since SpriteBatches on different threads can draw with the same font.
+    std::mutex atlasMutex;
+
+    uint32_t atlasCellWidth;
+    uint32_t atlasCellHeight;
+    uint32_t atlasCellsPerRow;
+
+    std::vector<uint32_t> glyphAtlasCells;      // Per glyph: the cell holding it, or NoAtlasCell.
+    std::vector<uint32_t> atlasCellGlyphs;      // Per cell: the glyph it holds, or NoAtlasCell if free.
+    std::vector<uint32_t> atlasCellFrames;      // Per cell: the frame in which it was last used.
+
+    // Per cell: the frame and context of its latest upload. Another context's command list may not have run
+    // yet when this one draws, so a glyph uploaded this frame is uploaded again by each context that draws it.
+    std::vector<uint32_t> atlasCellUploadFrames;
+    std::vector<ID3D11DeviceContext*> atlasCellUploadContexts;
+
+    // Doubly linked list of cells, in least recently used order.
+    std::vector<uint32_t> atlasCellPrev;
+    std::vector<uint32_t> atlasCellNext;
+    uint32_t atlasHead;
+    uint32_t atlasTail;
+    uint32_t atlasFrame;
 };
 
 
@@ -52,6 +135,38 @@ public:
 const XMFLOAT2 SpriteFont::Float2Zero(0, 0);
 
 static const char spriteFontMagic[] = "DXTKfont";
+static const char spriteFontMagicV2[] = "DXTKfnt2";
+
+static_assert(sizeof(spriteFontMagic) == sizeof(spriteFontMagicV2), "Both versions must use the same size header");
+
+
+// Internal TextLayout implementation class.
+class TextLayout::Impl
+{
+public:
+    Impl()
+      : effects(SpriteEffects_None),
+        lineSpacing(0),
+        defaultGlyph(nullptr),
+        size(0, 0),
+        valid(false)
+    { }
+
+    // The inputs this layout was built from.
+    std::wstring text;
+    SpriteEffects effects;
+    float lineSpacing;
+    SpriteFont::Glyph const* defaultGlyph;
+
+    // The results: one source rectangle and origin offset per glyph, plus the measured size.
+    ComPtr<ID3D11ShaderResourceView> texture;
+    std::vector<RECT> sourceRectangles;
+    std::vector<XMFLOAT2> origins;
+    std::vector<SpriteFont::Glyph const*> glyphs;
+    XMFLOAT2 size;
+
+    bool valid;
+};
 
 
 // Comparison operators make our sorted glyph vector work with std::binary_search and lower_bound.
@@ -71,20 +186,27 @@ namespace DirectX
     {
         return left.Character < right;
     }
+
+    static inline bool operator< (SpriteFont::Impl::KerningPair const& left, SpriteFont::Impl::KerningPair const& right)
+    {
+        return (left.First != right.First) ? (left.First < right.First) : (left.Second < right.Second);
+    }
 }
 
 
-// Reads a SpriteFont from the binary format created by the MakeSpriteFont utility.
-SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader)
+// Reads a SpriteFont from the binary format created by the MakeSpriteFont utility. Version 2 files
+// add kerning pairs and a prebuilt glyph lookup table after the font properties.
+SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader, size_t atlasWidth, size_t atlasHeight)
 {
     // Validate the header.
-    for (char const* magic = spriteFontMagic; *magic; magic++)
+    auto magic = reader->ReadArray<char>(sizeof(spriteFontMagic) - 1);
+
+    bool isVersion2 = (memcmp(magic, spriteFontMagicV2, sizeof(spriteFontMagicV2) - 1) == 0);
+
+    if (!isVersion2 && memcmp(magic, spriteFontMagic, sizeof(spriteFontMagic) - 1) != 0)
     {
-        if (reader->Read<uint8_t>() != *magic)
-        {
-            DebugTrace( "SpriteFont provided with an invalid .spritefont file\n" );
-            throw std::exception("Not a MakeSpriteFont output binary");
-        }
+        DebugTrace( "SpriteFont provided with an invalid .spritefont file\n" );
+        throw std::exception("Not a MakeSpriteFont output binary");
     }
 
     // Read the glyph data.
@@ -96,7 +218,29 @@ SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader)
     // Read font properties.
     lineSpacing = reader->Read<float>();
 
-    SetDefaultCharacter((wchar_t)reader->Read<uint32_t>());
+    auto defaultCharacter = (wchar_t)reader->Read<uint32_t>();
+
+    if (isVersion2)
+    {
+        auto kerningPairCount = reader->Read<uint32_t>();
+        auto kerningPairData = reader->ReadArray<KerningPair>(kerningPairCount);
+
+        kerningPairs.assign(kerningPairData, kerningPairData + kerningPairCount);
+
+        if (!std::is_sorted(kerningPairs.begin(), kerningPairs.end()))
+        {
+            DebugTrace( "SpriteFont provided with an invalid .spritefont file (kerning pairs out of order)\n" );
+            throw std::exception("Invalid kerning pairs");
+        }
+
+        ReadGlyphPages(reader);
+    }
+    else
+    {
+        BuildGlyphPages();
+    }
+
+    SetDefaultCharacter(defaultCharacter);
 
     // Read the texture data.
     auto textureWidth = reader->Read<uint32_t>();
@@ -106,6 +250,49 @@ SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader)
     auto textureRows = reader->Read<uint32_t>();
     auto textureData = reader->ReadArray<uint8_t>(textureStride * textureRows);
 
+    if (atlasWidth && atlasHeight)
+    {
+        // Streaming mode: keep a system memory copy of the glyphs, to be uploaded on demand.
+        switch (textureFormat)
+        {
+            case DXGI_FORMAT_R8G8B8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+                bytesPerPixel = 4;
+                break;
+
+            case DXGI_FORMAT_B4G4R4A4_UNORM:
+            case DXGI_FORMAT_B5G6R5_UNORM:
+            case DXGI_FORMAT_B5G5R5A1_UNORM:
+                bytesPerPixel = 2;
+                break;
+
+            case DXGI_FORMAT_R8_UNORM:
+            case DXGI_FORMAT_A8_UNORM:
+                bytesPerPixel = 1;
+                break;
+
+            default:
+                // Block compressed glyphs can't be copied at arbitrary texel positions.
+                DebugTrace( "SpriteFont streaming requires an uncompressed texture format (%d)\n", textureFormat );
+                throw std::exception("SpriteFont streaming does not support this texture format");
+        }
+
+        glyphPixels.assign(textureData, textureData + textureStride * textureRows);
+        glyphPixelsWidth = textureWidth;
+        glyphPixelsHeight = textureHeight;
+        glyphPixelsStride = textureStride;
+
+        CreateAtlas(device, textureFormat, atlasWidth, atlasHeight);
+        return;
+    }
+
+    // BC7 is only available from Feature Level 11.0, which MakeSpriteFont can't know about.
+    if ((textureFormat == DXGI_FORMAT_BC7_UNORM || textureFormat == DXGI_FORMAT_BC7_UNORM_SRGB) && device->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0)
+    {
+        DebugTrace( "SpriteFont texture format %d requires Feature Level 11.0 or later\n", textureFormat );
+        throw std::exception("SpriteFont texture format not supported by this device");
+    }
+
     // Create the D3D texture.
     CD3D11_TEXTURE2D_DESC textureDesc(textureFormat, textureWidth, textureHeight, 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
     CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(D3D11_SRV_DIMENSION_TEXTURE2D, textureFormat);
@@ -136,17 +323,306 @@ SpriteFont::Impl::Impl(_In_ ID3D11ShaderResourceView* texture, _In_reads_(glyphC
     {
         throw std::exception("Glyphs must be in ascending codepoint order");
     }
+
+    BuildGlyphPages();
+}
+
+
+// Builds the page table used by FindGlyph.
+void SpriteFont::Impl::BuildGlyphPages()
+{
+    // Page 0 is the shared empty page.
+    glyphPages.assign(GlyphPageSize, MissingGlyph);
+
+    std::fill(glyphPageMap, glyphPageMap + GlyphPageCount, 0);
+
+    for (size_t i = 0; i < glyphs.size(); i++)
+    {
+        uint32_t character = glyphs[i].Character;
+
+        // A wchar_t can never name characters beyond the BMP, so there is nothing to look them up with.
+        if (character >= GlyphPageCount * GlyphPageSize)
+            continue;
+
+        uint32_t& page = glyphPageMap[character / GlyphPageSize];
+
+        if (!page)
+        {
+            page = static_cast<uint32_t>(glyphPages.size());
+
+            glyphPages.resize(page + GlyphPageSize, MissingGlyph);
+        }
+
+        glyphPages[page + character % GlyphPageSize] = static_cast<uint32_t>(i);
+    }
+}
+
+
+// Loads the page table stored in a version 2 file, checking that every entry is in range
+// so a bad file can't make FindGlyph read out of bounds.
+void SpriteFont::Impl::ReadGlyphPages(_In_ BinaryReader* reader)
+{
+    auto pageMapData = reader->ReadArray<uint32_t>(GlyphPageCount);
+
+    auto pageEntryCount = reader->Read<uint32_t>();
+    auto pageEntryData = reader->ReadArray<uint32_t>(pageEntryCount);
+
+    if (!pageEntryCount || (pageEntryCount % GlyphPageSize))
+    {
+        DebugTrace( "SpriteFont provided with an invalid .spritefont file (%u glyph page entries)\n", pageEntryCount );
+        throw std::exception("Invalid glyph pages");
+    }
+
+    for (uint32_t i = 0; i < GlyphPageCount; i++)
+    {
+        if ((pageMapData[i] % GlyphPageSize) || pageMapData[i] >= pageEntryCount)
+        {
+            DebugTrace( "SpriteFont provided with an invalid .spritefont file (glyph page %u)\n", i );
+            throw std::exception("Invalid glyph pages");
+        }
+    }
+
+    for (uint32_t i = 0; i < pageEntryCount; i++)
+    {
+        if (pageEntryData[i] != MissingGlyph && pageEntryData[i] >= glyphs.size())
+        {
+            DebugTrace( "SpriteFont provided with an invalid .spritefont file (glyph page entry %u)\n", i );
+            throw std::exception("Invalid glyph pages");
+        }
+    }
+
+    std::copy(pageMapData, pageMapData + GlyphPageCount, glyphPageMap);
+
+    glyphPages.assign(pageEntryData, pageEntryData + pageEntryCount);
+}
+
+
+// Creates the GPU atlas texture and empty cell bookkeeping used in streaming mode.
+void SpriteFont::Impl::CreateAtlas(_In_ ID3D11Device* device, DXGI_FORMAT format, size_t atlasWidth, size_t atlasHeight)
+{
+    // Size the cells to fit the largest glyph.
+    atlasCellWidth = 1;
+    atlasCellHeight = 1;
+
+    for (auto it = glyphs.cbegin(); it != glyphs.cend(); ++it)
+    {
+        atlasCellWidth = std::max(atlasCellWidth, static_cast<uint32_t>(it->Subrect.right - it->Subrect.left));
+        atlasCellHeight = std::max(atlasCellHeight, static_cast<uint32_t>(it->Subrect.bottom - it->Subrect.top));
+    }
+
+    atlasCellWidth += AtlasBorder * 2;
+    atlasCellHeight += AtlasBorder * 2;
+
+    atlasCellsPerRow = static_cast<uint32_t>(atlasWidth / atlasCellWidth);
+
+    uint32_t cellRows = static_cast<uint32_t>(atlasHeight / atlasCellHeight);
+    uint32_t cellCount = atlasCellsPerRow * cellRows;
+
+    if (!cellCount)
+        throw std::exception("SpriteFont atlas is too small to hold the largest glyph");
+
+    // Create the texture.
+    CD3D11_TEXTURE2D_DESC textureDesc(format, static_cast<UINT>(atlasWidth), static_cast<UINT>(atlasHeight), 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DEFAULT);
+    CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(D3D11_SRV_DIMENSION_TEXTURE2D, format);
+
+    ThrowIfFailed(
+        device->CreateTexture2D(&textureDesc, nullptr, &atlasTexture)
+    );
+
+    ThrowIfFailed(
+        device->CreateShaderResourceView(atlasTexture.Get(), &viewDesc, &texture)
+    );
+
+    SetDebugObjectName(texture.Get(),      "DirectXTK:SpriteFont");
+    SetDebugObjectName(atlasTexture.Get(), "DirectXTK:SpriteFont");
+
+    D3D11_FEATURE_DATA_THREADING threading = {};
+
+    atlasDeferredBoxWorkaround = FAILED(device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading)))
+                                 || !threading.DriverCommandLists;
+
+    // Every cell starts out free.
+    glyphAtlasCells.assign(glyphs.size(), NoAtlasCell);
+    atlasCellGlyphs.assign(cellCount, NoAtlasCell);
+    atlasCellFrames.assign(cellCount, 0);
+    atlasCellUploadFrames.assign(cellCount, 0);
+    atlasCellUploadContexts.assign(cellCount, nullptr);
+    atlasCellPrev.resize(cellCount);
+    atlasCellNext.resize(cellCount);
+
+    for (uint32_t i = 0; i < cellCount; i++)
+    {
+        atlasCellPrev[i] = i ? i - 1 : NoAtlasCell;
+        atlasCellNext[i] = (i + 1 < cellCount) ? i + 1 : NoAtlasCell;
+    }
+
+    // The list runs from least recently used (tail) to most recently used (head).
+    atlasHead = cellCount - 1;
+    atlasTail = 0;
+
+    atlasFrame = 1;
+}
+
+
+// Returns the texture and source region to draw a glyph with. In streaming mode this copies
+// the glyph into the atlas, through the context the glyph is about to be drawn on, if that
+// context cannot already see it there.
+ID3D11ShaderResourceView* SpriteFont::Impl::GetGlyphSource(_In_ ID3D11DeviceContext* deviceContext, _In_ Glyph const* glyph, _Out_ RECT* sourceRect)
+{
+    if (!IsStreaming())
+    {
+        *sourceRect = glyph->Subrect;
+        return texture.Get();
+    }
+
+    std::lock_guard<std::mutex> lock(atlasMutex);
+
+    size_t glyphIndex = glyph - &glyphs.front();
+
+    uint32_t cell = glyphAtlasCells[glyphIndex];
+
+    if (cell == NoAtlasCell)
+    {
+        cell = AllocateAtlasCell();
+
+        glyphAtlasCells[glyphIndex] = cell;
+        atlasCellGlyphs[cell] = static_cast<uint32_t>(glyphIndex);
+
+        UploadAtlasCell(deviceContext, glyph, cell);
+    }
+    else if (atlasCellUploadFrames[cell] == atlasFrame && atlasCellUploadContexts[cell] != deviceContext)
+    {
+        UploadAtlasCell(deviceContext, glyph, cell);
+    }
+
+    TouchAtlasCell(cell);
+
+    LONG x = (cell % atlasCellsPerRow) * atlasCellWidth + AtlasBorder;
+    LONG y = (cell / atlasCellsPerRow) * atlasCellHeight + AtlasBorder;
+
+    sourceRect->left = x;
+    sourceRect->top = y;
+    sourceRect->right = x + (glyph->Subrect.right - glyph->Subrect.left);
+    sourceRect->bottom = y + (glyph->Subrect.bottom - glyph->Subrect.top);
+
+    return texture.Get();
+}
+
+
+// Copies a glyph, plus as much of its border as the source has, into an atlas cell.
+void SpriteFont::Impl::UploadAtlasCell(_In_ ID3D11DeviceContext* deviceContext, _In_ Glyph const* glyph, uint32_t cell)
+{
+    RECT const& subrect = glyph->Subrect;
+
+    uint32_t left = std::max<LONG>(subrect.left - AtlasBorder, 0);
+    uint32_t top = std::max<LONG>(subrect.top - AtlasBorder, 0);
+    uint32_t right = std::min<LONG>(subrect.right + AtlasBorder, glyphPixelsWidth);
+    uint32_t bottom = std::min<LONG>(subrect.bottom + AtlasBorder, glyphPixelsHeight);
+
+    uint32_t cellX = (cell % atlasCellsPerRow) * atlasCellWidth + AtlasBorder;
+    uint32_t cellY = (cell / atlasCellsPerRow) * atlasCellHeight + AtlasBorder;
+
+    D3D11_BOX box;
+
+    box.left = cellX - (subrect.left - left);
+    box.top = cellY - (subrect.top - top);
+    box.right = box.left + (right - left);
+    box.bottom = box.top + (bottom - top);
+    box.front = 0;
+    box.back = 1;
+
+    uint8_t const* source = &glyphPixels[top * glyphPixelsStride + left * bytesPerPixel];
+
+    if (atlasDeferredBoxWorkaround && deviceContext->GetType() == D3D11_DEVICE_CONTEXT_DEFERRED)
+    {
+        source -= box.top * glyphPixelsStride + box.left * bytesPerPixel;
+    }
+
+    deviceContext->UpdateSubresource(atlasTexture.Get(), 0, &box, source, glyphPixelsStride, 0);
+
+    atlasCellUploadFrames[cell] = atlasFrame;
+    atlasCellUploadContexts[cell] = deviceContext;
+}
+
+
+// Takes the least recently used atlas cell, evicting whatever glyph it held.
+uint32_t SpriteFont::Impl::AllocateAtlasCell()
+{
+    uint32_t cell = atlasTail;
+
+    // Sprites drawn this frame may still be waiting in a SpriteBatch queue, so their glyphs must stay put.
+    if (atlasCellGlyphs[cell] != NoAtlasCell && atlasCellFrames[cell] == atlasFrame)
+    {
+        DebugTrace( "SpriteFont atlas cannot hold all the glyphs drawn in one frame (%u cells)\n", static_cast<uint32_t>(atlasCellGlyphs.size()) );
+        throw std::exception("SpriteFont atlas is too small");
+    }
+
+    if (atlasCellGlyphs[cell] != NoAtlasCell)
+    {
+        glyphAtlasCells[atlasCellGlyphs[cell]] = NoAtlasCell;
+        atlasCellGlyphs[cell] = NoAtlasCell;
+    }
+
+    return cell;
+}
+
+
+// Marks a cell as used this frame, moving it to the most recently used end of the list.
+void SpriteFont::Impl::TouchAtlasCell(uint32_t cell)
+{
+    atlasCellFrames[cell] = atlasFrame;
+
+    if (cell == atlasHead)
+        return;
+
+    UnlinkAtlasCell(cell);
+
+    atlasCellPrev[cell] = atlasHead;
+    atlasCellNext[cell] = NoAtlasCell;
+    atlasCellNext[atlasHead] = cell;
+    atlasHead = cell;
+}
+
+
+// Removes a cell from the LRU list.
+void SpriteFont::Impl::UnlinkAtlasCell(uint32_t cell)
+{
+    uint32_t prev = atlasCellPrev[cell];
+    uint32_t next = atlasCellNext[cell];
+
+    if (prev != NoAtlasCell)
+        atlasCellNext[prev] = next;
+    else
+        atlasTail = next;
+
+    if (next != NoAtlasCell)
+        atlasCellPrev[next] = prev;
+    else
+        atlasHead = prev;
+}
+
+
+// Glyphs used before this point may be evicted from the atlas again.
+void SpriteFont::Impl::EndFrame()
+{
+    std::lock_guard<std::mutex> lock(atlasMutex);
+
+    atlasFrame++;
 }
 
 
 // Looks up the requested glyph, falling back to the default character if it is not in the font.
 SpriteFont::Glyph const* SpriteFont::Impl::FindGlyph(wchar_t character) const
 {
-    auto glyph = std::lower_bound(glyphs.begin(), glyphs.end(), character);
+    static_assert(sizeof(wchar_t) == 2, "The glyph page table covers 16-bit characters only");
+
+    uint32_t code = static_cast<uint32_t>(character);
 
-    if (glyph != glyphs.end() && glyph->Character == character)
+    uint32_t index = glyphPages[glyphPageMap[code / GlyphPageSize] + code % GlyphPageSize];
+
+    if (index != MissingGlyph)
     {
-        return &*glyph;
+        return &glyphs[index];
     }
 
     if (defaultGlyph)
@@ -159,6 +635,22 @@ SpriteFont::Glyph const* SpriteFont::Impl::FindGlyph(wchar_t character) const
 }
 
 
+// Returns the spacing adjustment between two characters, or zero if the font doesn't kern them.
+float SpriteFont::Impl::GetKerning(uint32_t first, uint32_t second) const
+{
+    KerningPair key = { first, second, 0 };
+
+    auto pair = std::lower_bound(kerningPairs.begin(), kerningPairs.end(), key);
+
+    if (pair != kerningPairs.end() && pair->First == first && pair->Second == second)
+    {
+        return pair->Amount;
+    }
+
+    return 0;
+}
+
+
 // Sets the missing-character fallback glyph.
 void SpriteFont::Impl::SetDefaultCharacter(wchar_t character)
 {
@@ -178,6 +670,8 @@ void SpriteFont::Impl::ForEachGlyph(_In_z_ wchar_t const* text, TAction action)
     float x = 0;
     float y = 0;
 
+    Glyph const* previous = nullptr;
+
     for (; *text; text++)
     {
         wchar_t character = *text;
@@ -192,12 +686,20 @@ void SpriteFont::Impl::ForEachGlyph(_In_z_ wchar_t const* text, TAction action)
                 // New line.
                 x = 0;
                 y += lineSpacing;
+                previous = nullptr;
                 break;
 
             default:
                 // Output this character.
                 auto glyph = FindGlyph(character);
 
+                if (previous && !kerningPairs.empty())
+                {
+                    x += GetKerning(previous->Character, glyph->Character);
+                }
+
+                previous = glyph;
+
                 x += glyph->XOffset;
 
                 if (x < 0)
@@ -217,12 +719,69 @@ void SpriteFont::Impl::ForEachGlyph(_In_z_ wchar_t const* text, TAction action)
 }
 
 
+namespace
+{
+    static_assert(SpriteEffects_FlipHorizontally == 1 &&
+                  SpriteEffects_FlipVertically == 2, "If you change these enum values, the following tables must be updated to match");
+
+    // Lookup table indicates which way to move along each axis per SpriteEffects enum value.
+    const XMVECTORF32 axisDirectionTable[4] =
+    {
+        { -1, -1 },
+        {  1, -1 },
+        { -1,  1 },
+        {  1,  1 },
+    };
+
+    // Lookup table indicates which axes are mirrored for each SpriteEffects enum value.
+    const XMVECTORF32 axisIsMirroredTable[4] =
+    {
+        { 0, 0 },
+        { 1, 0 },
+        { 0, 1 },
+        { 1, 1 },
+    };
+
+
+    // Computes the origin offset that positions a glyph relative to the start of the string.
+    inline XMVECTOR XM_CALLCONV GetGlyphOffset(_In_ SpriteFont::Glyph const* glyph, float x, float y, FXMVECTOR baseOffset, SpriteEffects effects)
+    {
+        XMVECTOR offset = XMVectorMultiplyAdd(XMVectorSet(x, y + glyph->YOffset, 0, 0), axisDirectionTable[effects & 3], baseOffset);
+
+        if (effects)
+        {
+            // For mirrored characters, specify bottom and/or right instead of top left.
+            XMVECTOR glyphRect = XMConvertVectorIntToFloat(XMLoadInt4(reinterpret_cast<uint32_t const*>(&glyph->Subrect)), 0);
+
+            // xy = glyph width/height.
+            glyphRect = XMVectorSwizzle<2, 3, 0, 1>(glyphRect) - glyphRect;
+
+            offset = XMVectorMultiplyAdd(glyphRect, axisIsMirroredTable[effects & 3], offset);
+        }
+
+        return offset;
+    }
+}
+
+
 // Construct from a binary file created by the MakeSpriteFont utility.
 SpriteFont::SpriteFont(_In_ ID3D11Device* device, _In_z_ wchar_t const* fileName)
 {
     BinaryReader reader(fileName);
 
-    pImpl.reset(new Impl(device, &reader));
+    pImpl.reset(new Impl(device, &reader, 0, 0));
+}
+
+
+// Construct a streaming font from a binary file, drawing through a glyph atlas of the specified size.
+SpriteFont::SpriteFont(_In_ ID3D11Device* device, _In_z_ wchar_t const* fileName, size_t atlasWidth, size_t atlasHeight)
+{
+    if (!atlasWidth || !atlasHeight)
+        throw std::exception("Invalid atlas size");
+
+    BinaryReader reader(fileName);
+
+    pImpl.reset(new Impl(device, &reader, atlasWidth, atlasHeight));
 }
 
 
@@ -231,7 +790,19 @@ SpriteFont::SpriteFont(_In_ ID3D11Device* device, _In_reads_bytes_(dataSize) uin
 {
     BinaryReader reader(dataBlob, dataSize);
 
-    pImpl.reset(new Impl(device, &reader));
+    pImpl.reset(new Impl(device, &reader, 0, 0));
+}
+
+
+// Construct a streaming font from a binary blob, drawing through a glyph atlas of the specified size.
+SpriteFont::SpriteFont(_In_ ID3D11Device* device, _In_reads_bytes_(dataSize) uint8_t const* dataBlob, _In_ size_t dataSize, size_t atlasWidth, size_t atlasHeight)
+{
+    if (!atlasWidth || !atlasHeight)
+        throw std::exception("Invalid atlas size");
+
+    BinaryReader reader(dataBlob, dataSize);
+
+    pImpl.reset(new Impl(device, &reader, atlasWidth, atlasHeight));
 }
 
 
@@ -283,27 +854,6 @@ void XM_CALLCONV SpriteFont::DrawString(_In_ SpriteBatch* spriteBatch, _In_z_ wc
 
 void XM_CALLCONV SpriteFont::DrawString(_In_ SpriteBatch* spriteBatch, _In_z_ wchar_t const* text, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects, float layerDepth)
 {
-    static_assert(SpriteEffects_FlipHorizontally == 1 &&
-                  SpriteEffects_FlipVertically == 2, "If you change these enum values, the following tables must be updated to match");
-
-    // Lookup table indicates which way to move along each axis per SpriteEffects enum value.
-    static XMVECTORF32 axisDirectionTable[4] =
-    {
-        { -1, -1 },
-        {  1, -1 },
-        { -1,  1 },
-        {  1,  1 },
-    };
-
-    // Lookup table indicates which axes are mirrored for each SpriteEffects enum value.
-    static XMVECTORF32 axisIsMirroredTable[4] =
-    {
-        { 0, 0 },
-        { 1, 0 },
-        { 0, 1 },
-        { 1, 1 },
-    };
-
     XMVECTOR baseOffset = origin;
 
     // If the text is mirrored, offset the start position accordingly.
@@ -315,20 +865,13 @@ void XM_CALLCONV SpriteFont::DrawString(_In_ SpriteBatch* spriteBatch, _In_z_ wc
     // Draw each character in turn.
     pImpl->ForEachGlyph(text, [&](Glyph const* glyph, float x, float y)
     {
-        XMVECTOR offset = XMVectorMultiplyAdd(XMVectorSet(x, y + glyph->YOffset, 0, 0), axisDirectionTable[effects & 3], baseOffset);
-        
-        if (effects)
-        {
-            // For mirrored characters, specify bottom and/or right instead of top left.
-            XMVECTOR glyphRect = XMConvertVectorIntToFloat(XMLoadInt4(reinterpret_cast<uint32_t const*>(&glyph->Subrect)), 0);
+        XMVECTOR offset = GetGlyphOffset(glyph, x, y, baseOffset, effects);
 
-            // xy = glyph width/height.
-            glyphRect = XMVectorSwizzle<2, 3, 0, 1>(glyphRect) - glyphRect;
+        RECT sourceRect;
 
-            offset = XMVectorMultiplyAdd(glyphRect, axisIsMirroredTable[effects & 3], offset);
-        }
+        auto texture = pImpl->GetGlyphSource(spriteBatch->GetDeviceContext(), glyph, &sourceRect);
 
-        spriteBatch->Draw(pImpl->texture.Get(), position, &glyph->Subrect, color, rotation, offset, scale, effects, layerDepth);
+        spriteBatch->Draw(texture, position, &sourceRect, color, rotation, offset, scale, effects, layerDepth);
     });
 }
 
@@ -375,7 +918,177 @@ void SpriteFont::SetDefaultCharacter(wchar_t character)
 }
 
 
+float SpriteFont::GetKerning(wchar_t first, wchar_t second) const
+{
+    if (pImpl->kerningPairs.empty())
+        return 0;
+
+    return pImpl->GetKerning(first, second);
+}
+
+
 bool SpriteFont::ContainsCharacter(wchar_t character) const
 {
     return std::binary_search(pImpl->glyphs.begin(), pImpl->glyphs.end(), character);
 }
+
+
+bool SpriteFont::IsStreaming() const
+{
+    return pImpl->IsStreaming();
+}
+
+
+void SpriteFont::EndFrame()
+{
+    if (pImpl->IsStreaming())
+    {
+        pImpl->EndFrame();
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// TextLayout
+//--------------------------------------------------------------------------------------
+
+const XMFLOAT2 TextLayout::Float2Zero(0, 0);
+
+
+// Public constructor.
+TextLayout::TextLayout(_In_ SpriteFont const* font, _In_opt_z_ wchar_t const* text, SpriteEffects effects)
+  : pImpl(new Impl()),
+    mFont(font)
+{
+    if (!font)
+        throw std::exception("SpriteFont cannot be null");
+
+    if (text)
+    {
+        SetText(text, effects);
+    }
+}
+
+
+// Move constructor.
+TextLayout::TextLayout(TextLayout&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl)),
+    mFont(moveFrom.mFont)
+{
+}
+
+
+// Move assignment.
+TextLayout& TextLayout::operator= (TextLayout&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    mFont = moveFrom.mFont;
+    return *this;
+}
+
+
+// Public destructor.
+TextLayout::~TextLayout()
+{
+}
+
+
+// Runs the usual glyph layout once, storing what DrawString would pass to SpriteBatch for each glyph.
+void TextLayout::SetText(_In_z_ wchar_t const* text, SpriteEffects effects)
+{
+    auto font = mFont->pImpl.get();
+
+    // Skip the work if nothing that affects the layout has changed.
+    if (pImpl->valid &&
+        pImpl->effects == effects &&
+        pImpl->lineSpacing == font->lineSpacing &&
+        pImpl->defaultGlyph == font->defaultGlyph &&
+        pImpl->text == text)
+    {
+        return;
+    }
+
+    pImpl->valid = false;
+
+    XMVECTOR size = mFont->MeasureString(text);
+
+    // As in DrawString, mirrored text starts from the far edge. The caller's origin is added at draw time.
+    XMVECTOR baseOffset = -size * axisIsMirroredTable[effects & 3];
+
+    pImpl->sourceRectangles.clear();
+    pImpl->origins.clear();
+    pImpl->glyphs.clear();
+
+    font->ForEachGlyph(text, [&](SpriteFont::Glyph const* glyph, float x, float y)
+    {
+        XMFLOAT2 origin;
+
+        XMStoreFloat2(&origin, GetGlyphOffset(glyph, x, y, baseOffset, effects));
+
+        pImpl->sourceRectangles.push_back(glyph->Subrect);
+        pImpl->origins.push_back(origin);
+        pImpl->glyphs.push_back(glyph);
+    });
+
+    XMStoreFloat2(&pImpl->size, size);
+
+    pImpl->text = text;
+    pImpl->effects = effects;
+    pImpl->lineSpacing = font->lineSpacing;
+    pImpl->defaultGlyph = font->defaultGlyph;
+    pImpl->texture = font->texture;
+    pImpl->valid = true;
+}
+
+
+void XM_CALLCONV TextLayout::Draw(_In_ SpriteBatch* spriteBatch, XMFLOAT2 const& position, FXMVECTOR color, float rotation, XMFLOAT2 const& origin, float scale, float layerDepth)
+{
+    Draw(spriteBatch, XMLoadFloat2(&position), color, rotation, XMLoadFloat2(&origin), XMVectorReplicate(scale), layerDepth);
+}
+
+
+void XM_CALLCONV TextLayout::Draw(_In_ SpriteBatch* spriteBatch, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, float layerDepth)
+{
+    if (!pImpl->valid)
+        throw std::exception("SetText must be called before Draw");
+
+    // Pick up any change to the font line spacing or default character since the text was laid out.
+    auto font = mFont->pImpl.get();
+
+    if (pImpl->lineSpacing != font->lineSpacing || pImpl->defaultGlyph != font->defaultGlyph)
+    {
+        pImpl->valid = false;
+
+        std::wstring text(pImpl->text);
+
+        SetText(text.c_str(), pImpl->effects);
+    }
+
+    if (pImpl->sourceRectangles.empty())
+        return;
+
+    // Streaming fonts move glyphs around the atlas, so look up where each one currently lives.
+    if (font->IsStreaming())
+    {
+        auto deviceContext = spriteBatch->GetDeviceContext();
+
+        for (size_t i = 0; i < pImpl->glyphs.size(); i++)
+        {
+            font->GetGlyphSource(deviceContext, pImpl->glyphs[i], &pImpl->sourceRectangles[i]);
+        }
+    }
+
+    spriteBatch->DrawSprites(pImpl->texture.Get(), pImpl->sourceRectangles.size(), &pImpl->sourceRectangles.front(), &pImpl->origins.front(), position, color, rotation, origin, scale, pImpl->effects, layerDepth);
+}
+
+
+XMVECTOR XM_CALLCONV TextLayout::Measure() const
+{
+    return XMLoadFloat2(&pImpl->size);
+}
+
+
+size_t TextLayout::GetGlyphCount() const
+{
+    return pImpl->sourceRectangles.size();
+}
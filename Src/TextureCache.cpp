@@ -0,0 +1,620 @@
+//--------------------------------------------------------------------------------------
+// File: TextureCache.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+#include "TextureCache.h"
+#include "SharedResourcePool.h"
+#include "PlatformHelpers.h"
+
+#include "DDSTextureLoader.h"
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+#include "WICTextureLoader.h"
+#endif
+
+#include <list>
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+
+
+namespace
+{
+    //----------------------------------------------------------------------------------
+    // Return the BPP for a particular format
+    //----------------------------------------------------------------------------------
+    size_t BitsPerPixel( _In_ DXGI_FORMAT fmt )
+    {
+        switch( fmt )
+        {
+        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32A32_UINT:
+        case DXGI_FORMAT_R32G32B32A32_SINT:
+            return 128;
+
+        case DXGI_FORMAT_R32G32B32_TYPELESS:
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+        case DXGI_FORMAT_R32G32B32_UINT:
+        case DXGI_FORMAT_R32G32B32_SINT:
+            return 96;
+
+        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R16G16B16A16_UINT:
+        case DXGI_FORMAT_R16G16B16A16_SNORM:
+        case DXGI_FORMAT_R16G16B16A16_SINT:
+        case DXGI_FORMAT_R32G32_TYPELESS:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R32G32_UINT:
+        case DXGI_FORMAT_R32G32_SINT:
+        case DXGI_FORMAT_R32G8X24_TYPELESS:
+        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        case DXGI_FORMAT_Y416:
+        case DXGI_FORMAT_Y210:
+        case DXGI_FORMAT_Y216:
+            return 64;
+
+        case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+        case DXGI_FORMAT_R10G10B10A2_UNORM:
+        case DXGI_FORMAT_R10G10B10A2_UINT:
+        case DXGI_FORMAT_R11G11B10_FLOAT:
+        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_R8G8B8A8_UINT:
+        case DXGI_FORMAT_R8G8B8A8_SNORM:
+        case DXGI_FORMAT_R8G8B8A8_SINT:
+        case DXGI_FORMAT_R16G16_TYPELESS:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16_UINT:
+        case DXGI_FORMAT_R16G16_SNORM:
+        case DXGI_FORMAT_R16G16_SINT:
+        case DXGI_FORMAT_R32_TYPELESS:
+        case DXGI_FORMAT_D32_FLOAT:
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R32_UINT:
+        case DXGI_FORMAT_R32_SINT:
+        case DXGI_FORMAT_R24G8_TYPELESS:
+        case DXGI_FORMAT_D24_UNORM_S8_UINT:
+        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+        case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+        case DXGI_FORMAT_R8G8_B8G8_UNORM:
+        case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+        case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        case DXGI_FORMAT_AYUV:
+        case DXGI_FORMAT_Y410:
+        case DXGI_FORMAT_YUY2:
+            return 32;
+
+        case DXGI_FORMAT_P010:
+        case DXGI_FORMAT_P016:
+            return 24;
+
+        case DXGI_FORMAT_R8G8_TYPELESS:
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R8G8_UINT:
+        case DXGI_FORMAT_R8G8_SNORM:
+        case DXGI_FORMAT_R8G8_SINT:
+        case DXGI_FORMAT_R16_TYPELESS:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_D16_UNORM:
+        case DXGI_FORMAT_R16_UNORM:
+        case DXGI_FORMAT_R16_UINT:
+        case DXGI_FORMAT_R16_SNORM:
+        case DXGI_FORMAT_R16_SINT:
+        case DXGI_FORMAT_B5G6R5_UNORM:
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+        case DXGI_FORMAT_A8P8:
+        case DXGI_FORMAT_B4G4R4A4_UNORM:
+            return 16;
+
+        case DXGI_FORMAT_NV12:
+        case DXGI_FORMAT_420_OPAQUE:
+        case DXGI_FORMAT_NV11:
+            return 12;
+
+        case DXGI_FORMAT_R8_TYPELESS:
+        case DXGI_FORMAT_R8_UNORM:
+        case DXGI_FORMAT_R8_UINT:
+        case DXGI_FORMAT_R8_SNORM:
+        case DXGI_FORMAT_R8_SINT:
+        case DXGI_FORMAT_A8_UNORM:
+        case DXGI_FORMAT_AI44:
+        case DXGI_FORMAT_IA44:
+        case DXGI_FORMAT_P8:
+            return 8;
+
+        case DXGI_FORMAT_R1_UNORM:
+            return 1;
+
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            return 4;
+
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return 8;
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+
+        case DXGI_FORMAT_R10G10B10_7E3_A2_FLOAT:
+        case DXGI_FORMAT_R10G10B10_6E4_A2_FLOAT:
+            return 32;
+
+        case DXGI_FORMAT_D16_UNORM_S8_UINT:
+        case DXGI_FORMAT_R16_UNORM_X8_TYPELESS:
+        case DXGI_FORMAT_X16_TYPELESS_G8_UINT:
+            return 24;
+
+#endif // _XBOX_ONE && _TITLE
+
+        default:
+            return 0;
+        }
+    }
+
+
+    // Block compressed formats are stored as 4x4 texel blocks.
+    bool IsCompressed( _In_ DXGI_FORMAT fmt )
+    {
+        return (fmt >= DXGI_FORMAT_BC1_TYPELESS && fmt <= DXGI_FORMAT_BC5_SNORM)
+            || (fmt >= DXGI_FORMAT_BC6H_TYPELESS && fmt <= DXGI_FORMAT_BC7_UNORM_SRGB);
+    }
+
+
+    // Estimates the memory used by a mip chain. Padding and alignment are ignored.
+    size_t EstimateMipChainSize( DXGI_FORMAT format, size_t width, size_t height, size_t depth, size_t mipLevels, size_t arraySize )
+    {
+        size_t bpp = BitsPerPixel( format );
+        bool compressed = IsCompressed( format );
+
+        size_t total = 0;
+
+        for (size_t i = 0; i < mipLevels; i++)
+        {
+            if (compressed)
+            {
+                total += std::max<size_t>( 1, (width + 3) / 4 ) * std::max<size_t>( 1, (height + 3) / 4 ) * bpp * 2 * depth;
+            }
+            else
+            {
+                total += (width * height * depth * bpp + 7) / 8;
+            }
+
+            width = std::max<size_t>( width / 2, 1 );
+            height = std::max<size_t>( height / 2, 1 );
+            depth = std::max<size_t>( depth / 2, 1 );
+        }
+
+        return total * arraySize;
+    }
+
+
+    size_t EstimateTextureSize( _In_ ID3D11ShaderResourceView* textureView )
+    {
+        ComPtr<ID3D11Resource> resource;
+
+        textureView->GetResource( &resource );
+
+        D3D11_RESOURCE_DIMENSION dimension;
+
+        resource->GetType( &dimension );
+
+        switch (dimension)
+        {
+            case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+            {
+                ComPtr<ID3D11Texture1D> texture;
+                D3D11_TEXTURE1D_DESC desc;
+
+                if (FAILED(resource.As(&texture)))
+                    return 0;
+
+                texture->GetDesc( &desc );
+
+                return EstimateMipChainSize( desc.Format, desc.Width, 1, 1, desc.MipLevels, desc.ArraySize );
+            }
+
+            case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+            {
+                ComPtr<ID3D11Texture2D> texture;
+                D3D11_TEXTURE2D_DESC desc;
+
+                if (FAILED(resource.As(&texture)))
+                    return 0;
+
+                texture->GetDesc( &desc );
+
+                return EstimateMipChainSize( desc.Format, desc.Width, desc.Height, 1, desc.MipLevels, desc.ArraySize );
+            }
+
+            case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+            {
+                ComPtr<ID3D11Texture3D> texture;
+                D3D11_TEXTURE3D_DESC desc;
+
+                if (FAILED(resource.As(&texture)))
+                    return 0;
+
+                texture->GetDesc( &desc );
+
+                return EstimateMipChainSize( desc.Format, desc.Width, desc.Height, desc.Depth, desc.MipLevels, 1 );
+            }
+
+            default:
+                return 0;
+        }
+    }
+
+
+    // True if nobody but the cache holds a reference.
+    bool IsUnused( _In_ IUnknown* object )
+    {
+        object->AddRef();
+
+        return object->Release() == 1;
+    }
+}
+
+
+// Internal TextureCache implementation class. Only one of these is allocated per D3D device,
+// even if there are multiple public facing TextureCache instances.
+class TextureCache::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device)
+      : mDevice(device),
+        mMemoryBudget(DefaultMemoryBudget),
+        mMemoryUsage(0)
+    { }
+
+    void CreateTexture( _In_z_ const wchar_t* fileName, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView, size_t maxsize, bool forceSRGB );
+
+    void SetMemoryBudget( size_t bytes );
+    void Trim();
+    void ReleaseCache();
+
+    static SharedResourcePool<ID3D11Device*, Impl> instancePool;
+
+    size_t mMemoryBudget;
+    size_t mMemoryUsage;
+
+    mutable std::mutex mMutex;
+
+private:
+    // Keys in the LRU list point into the map, whose nodes never move.
+    typedef std::list<std::wstring const*> LruList;
+
+    struct Entry
+    {
+        ComPtr<ID3D11ShaderResourceView> textureView;
+        size_t size;
+        LruList::iterator lruPosition;
+    };
+
+    typedef std::map<std::wstring, Entry> EntryMap;
+
+    void Load( _In_z_ const wchar_t* fileName, _In_opt_ ID3D11DeviceContext* deviceContext, _Outptr_ ID3D11ShaderResourceView** textureView, size_t maxsize, bool forceSRGB );
+    void EvictUnused( size_t budget );
+
+    ComPtr<ID3D11Device> mDevice;
+
+    EntryMap mEntries;
+
+    // Most recently used at the front.
+    LruList mLru;
+
+    // Loads that auto-generate mips use the device context, which is not free-threaded.
+    std::mutex mContextMutex;
+};
+
+
+// Global instance pool.
+SharedResourcePool<ID3D11Device*, TextureCache::Impl> TextureCache::Impl::instancePool;
+
+
+_Use_decl_annotations_
+void TextureCache::Impl::CreateTexture( const wchar_t* fileName, ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView** textureView, size_t maxsize, bool forceSRGB )
+{
+    if ( !fileName || !*fileName || !textureView )
+        throw std::exception("invalid arguments");
+
+    *textureView = nullptr;
+
+    // Build the key from the full path, ignoring case and slash direction, plus the load options.
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY == WINAPI_FAMILY_DESKTOP_APP)
+    wchar_t fullPath[MAX_PATH];
+
+    if ( !GetFullPathNameW( fileName, MAX_PATH, fullPath, nullptr ) )
+    {
+        wcscpy_s( fullPath, fileName );
+    }
+
+    std::wstring key( fullPath );
+#else
+    std::wstring key( fileName );
+#endif
+
+    for (auto it = key.begin(); it != key.end(); ++it)
+    {
+        *it = (*it == L'/') ? L'\\' : towlower( *it );
+    }
+
+    wchar_t options[64];
+    swprintf_s( options, L"|%Iu|%d|%d", maxsize, forceSRGB ? 1 : 0, deviceContext ? 1 : 0 );
+
+    key += options;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        auto it = mEntries.find( key );
+
+        if ( it != mEntries.end() )
+        {
+            // Move to the front of the LRU list.
+            mLru.splice( mLru.begin(), mLru, it->second.lruPosition );
+
+            *textureView = it->second.textureView.Get();
+            (*textureView)->AddRef();
+            return;
+        }
+    }
+
+    // Load without holding the lock, so other threads can use the cache meanwhile.
+    ComPtr<ID3D11ShaderResourceView> newView;
+
+    Load( fileName, deviceContext, &newView, maxsize, forceSRGB );
+
+    size_t size = EstimateTextureSize( newView.Get() );
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto it = mEntries.find( key );
+
+    if ( it != mEntries.end() )
+    {
+        // Another thread got there first, so share its copy.
+        mLru.splice( mLru.begin(), mLru, it->second.lruPosition );
+
+        newView = it->second.textureView;
+    }
+    else
+    {
+        it = mEntries.insert( EntryMap::value_type( key, Entry() ) ).first;
+
+        it->second.textureView = newView;
+        it->second.size = size;
+
+        mLru.push_front( &it->first );
+        it->second.lruPosition = mLru.begin();
+
+        mMemoryUsage += size;
+
+        // Make room, keeping the new texture (which the caller is about to use) where it is.
+        EvictUnused( mMemoryBudget );
+    }
+
+    *textureView = newView.Detach();
+}
+
+
+// Loads a texture with whichever loader suits the file extension.
+_Use_decl_annotations_
+void TextureCache::Impl::Load( const wchar_t* fileName, ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView** textureView, size_t maxsize, bool forceSRGB )
+{
+#if defined(_XBOX_ONE) && defined(_TITLE)
+    UNREFERENCED_PARAMETER(deviceContext);
+#endif
+
+#if !defined(WINAPI_FAMILY) || (WINAPI_FAMILY != WINAPI_FAMILY_PHONE_APP) || (_WIN32_WINNT > _WIN32_WINNT_WIN8)
+    WCHAR ext[_MAX_EXT];
+    _wsplitpath_s( fileName, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT );
+
+    if ( _wcsicmp( ext, L".dds" ) == 0 )
+    {
+#if !defined(_XBOX_ONE) || !defined(_TITLE)
+        if ( deviceContext )
+        {
+            std::lock_guard<std::mutex> lock(mContextMutex);
+            HRESULT hr = CreateDDSTextureFromFileEx( mDevice.Get(), deviceContext, fileName, maxsize, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, forceSRGB, nullptr, textureView );
+            if ( FAILED(hr) )
+            {
+                DebugTrace( "CreateDDSTextureFromFile failed (%08X) for '%ls'\n", hr, fileName );
+                throw std::exception( "CreateDDSTextureFromFile" );
+            }
+        }
+        else
+#endif
+        {
+            HRESULT hr = CreateDDSTextureFromFileEx( mDevice.Get(), fileName, maxsize, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, forceSRGB, nullptr, textureView );
+            if ( FAILED(hr) )
+            {
+                DebugTrace( "CreateDDSTextureFromFile failed (%08X) for '%ls'\n", hr, fileName );
+                throw std::exception( "CreateDDSTextureFromFile" );
+            }
+        }
+    }
+#if !defined(_XBOX_ONE) || !defined(_TITLE)
+    else if ( deviceContext )
+    {
+        std::lock_guard<std::mutex> lock(mContextMutex);
+        HRESULT hr = CreateWICTextureFromFileEx( mDevice.Get(), deviceContext, fileName, maxsize, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, forceSRGB, nullptr, textureView );
+        if ( FAILED(hr) )
+        {
+            DebugTrace( "CreateWICTextureFromFile failed (%08X) for '%ls'\n", hr, fileName );
+            throw std::exception( "CreateWICTextureFromFile" );
+        }
+    }
+#endif
+    else
+    {
+        HRESULT hr = CreateWICTextureFromFileEx( mDevice.Get(), fileName, maxsize, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, forceSRGB, nullptr, textureView );
+        if ( FAILED(hr) )
+        {
+            DebugTrace( "CreateWICTextureFromFile failed (%08X) for '%ls'\n", hr, fileName );
+            throw std::exception( "CreateWICTextureFromFile" );
+        }
+    }
+#else
+    UNREFERENCED_PARAMETER( deviceContext );
+    HRESULT hr = CreateDDSTextureFromFileEx( mDevice.Get(), fileName, maxsize, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, forceSRGB, nullptr, textureView );
+    if ( FAILED(hr) )
+    {
+        DebugTrace( "CreateDDSTextureFromFile failed (%08X) for '%ls'\n", hr, fileName );
+        throw std::exception( "CreateDDSTextureFromFile" );
+    }
+#endif
+}
+
+
+// Drops unused textures, least recently used first, until the cache fits the budget. Textures
+// still in use elsewhere are skipped, since dropping them would not free any memory.
+void TextureCache::Impl::EvictUnused( size_t budget )
+{
+    auto it = mLru.end();
+
+    while ( mMemoryUsage > budget && it != mLru.begin() )
+    {
+        --it;
+
+        auto entry = mEntries.find( **it );
+
+        if ( IsUnused( entry->second.textureView.Get() ) )
+        {
+            mMemoryUsage -= entry->second.size;
+
+            mEntries.erase( entry );
+            it = mLru.erase( it );
+        }
+    }
+}
+
+
+void TextureCache::Impl::SetMemoryBudget( size_t bytes )
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mMemoryBudget = bytes;
+
+    EvictUnused( mMemoryBudget );
+}
+
+
+void TextureCache::Impl::Trim()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    EvictUnused( 0 );
+}
+
+
+void TextureCache::Impl::ReleaseCache()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mLru.clear();
+    mEntries.clear();
+    mMemoryUsage = 0;
+}
+
+
+
+//--------------------------------------------------------------------------------------
+// TextureCache
+//--------------------------------------------------------------------------------------
+
+TextureCache::TextureCache(_In_ ID3D11Device* device)
+    : pImpl(Impl::instancePool.DemandCreate(device))
+{
+}
+
+TextureCache::~TextureCache()
+{
+}
+
+
+TextureCache::TextureCache(TextureCache&& moveFrom)
+    : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+TextureCache& TextureCache::operator= (TextureCache&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+_Use_decl_annotations_
+void TextureCache::CreateTexture( const wchar_t* fileName, ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView** textureView, size_t maxsize, bool forceSRGB )
+{
+    pImpl->CreateTexture( fileName, deviceContext, textureView, maxsize, forceSRGB );
+}
+
+void TextureCache::SetMemoryBudget( size_t bytes )
+{
+    pImpl->SetMemoryBudget( bytes );
+}
+
+size_t TextureCache::GetMemoryBudget() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->mMutex);
+
+    return pImpl->mMemoryBudget;
+}
+
+size_t TextureCache::GetMemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->mMutex);
+
+    return pImpl->mMemoryUsage;
+}
+
+void TextureCache::Trim()
+{
+    pImpl->Trim();
+}
+
+void TextureCache::ReleaseCache()
+{
+    pImpl->ReleaseCache();
+}
@@ -0,0 +1,275 @@
+//--------------------------------------------------------------------------------------
+// File: VertexPacker.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "PlatformHelpers.h"
+
+#include <DirectXPackedVector.h>
+#include <memory>
+#include <vector>
+
+
+namespace DirectX
+{
+    // Used by the model loaders to convert full precision vertex data to the packed formats used by the
+    // VertexTypes.h *Packed structs. Positions become half4 with w = 1, normals, tangents and binormals become
+    // SNORM8, and float2 texture coordinates become half2. Every other element is copied unchanged.
+    //
+    // The input assembler expands all of these back to float, so the packed layouts bind to the same effect
+    // shaders as the full precision ones.
+    class VertexPacker
+    {
+    public:
+        // Builds the packed layout for a single stream vertex declaration.
+        VertexPacker(std::vector<D3D11_INPUT_ELEMENT_DESC> const& decl, size_t inputStride)
+          : mInputStride(inputStride),
+            mOutputStride(0),
+            mPacking(false),
+            mOutputDecl(std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(decl))
+        {
+            size_t inputOffset = 0;
+
+            for (auto it = mOutputDecl->begin(); it != mOutputDecl->end(); ++it)
+            {
+                if (it->InputSlot != 0 || it->InputSlotClass != D3D11_INPUT_PER_VERTEX_DATA)
+                    return;
+
+                if (it->AlignedByteOffset != D3D11_APPEND_ALIGNED_ELEMENT)
+                    inputOffset = it->AlignedByteOffset;
+
+                Element element;
+                element.conversion = ChooseConversion(*it);
+                element.inputOffset = inputOffset;
+                element.outputOffset = mOutputStride;
+                element.bytes = BytesPerElement(it->Format);
+
+                if (!element.bytes)
+                    return;
+
+                inputOffset += element.bytes;
+
+                if (inputOffset > inputStride)
+                    return;
+
+                switch (element.conversion)
+                {
+                    case Conversion_PositionToHalf4:
+                        it->Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+                        mOutputStride += 8;
+                        break;
+
+                    case Conversion_Float3ToByteN4:
+                    case Conversion_Float4ToByteN4:
+                        it->Format = DXGI_FORMAT_R8G8B8A8_SNORM;
+                        mOutputStride += 4;
+                        break;
+
+                    case Conversion_Float2ToHalf2:
+                        it->Format = DXGI_FORMAT_R16G16_FLOAT;
+                        mOutputStride += 4;
+                        break;
+
+                    default:
+                        mOutputStride += element.bytes;
+                        break;
+                }
+
+                it->AlignedByteOffset = static_cast<UINT>(element.outputOffset);
+
+                mElements.push_back(element);
+            }
+
+            mPacking = (mOutputStride > 0) && (mOutputStride < inputStride);
+        }
+
+
+        // True if the declaration was understood and packing it saves space. Otherwise the loader keeps the original data.
+        bool IsPacking() const { return mPacking; }
+
+        size_t GetOutputStride() const { return mOutputStride; }
+
+        std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> const& GetOutputDecl() const { return mOutputDecl; }
+
+
+        // Source holds vertexCount vertices at the input stride, dest has room for as many at the output stride.
+        void Pack(_In_ const uint8_t* source, size_t vertexCount, _Out_ uint8_t* dest) const
+        {
+            using namespace DirectX::PackedVector;
+
+            assert(mPacking);
+
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                for (auto it = mElements.cbegin(); it != mElements.cend(); ++it)
+                {
+                    const uint8_t* in = source + it->inputOffset;
+                    uint8_t* out = dest + it->outputOffset;
+
+                    switch (it->conversion)
+                    {
+                        case Conversion_PositionToHalf4:
+                        {
+                            XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(in));
+
+                            XMStoreHalf4(reinterpret_cast<XMHALF4*>(out), XMVectorSelect(g_XMIdentityR3, position, g_XMSelect1110));
+                            break;
+                        }
+
+                        case Conversion_Float3ToByteN4:
+                        {
+                            XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(in)));
+
+                            XMStoreByteN4(reinterpret_cast<XMBYTEN4*>(out), normal);
+                            break;
+                        }
+
+                        case Conversion_Float4ToByteN4:
+                        {
+                            // The w of a float4 tangent holds the bitangent sign, which survives SNORM8 exactly.
+                            XMVECTOR tangent = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(in));
+
+                            tangent = XMVectorSelect(tangent, XMVector3Normalize(tangent), g_XMSelect1110);
+
+                            XMStoreByteN4(reinterpret_cast<XMBYTEN4*>(out), tangent);
+                            break;
+                        }
+
+                        case Conversion_Float2ToHalf2:
+                            XMStoreHalf2(reinterpret_cast<XMHALF2*>(out), XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(in)));
+                            break;
+
+                        default:
+                            memcpy(out, in, it->bytes);
+                            break;
+                    }
+                }
+
+                source += mInputStride;
+                dest += mOutputStride;
+            }
+        }
+
+
+        // The packed formats are only guaranteed as vertex buffer formats from Feature Level 10.0 up.
+        static bool IsSupported(_In_ ID3D11Device* device)
+        {
+            static const DXGI_FORMAT formats[] =
+            {
+                DXGI_FORMAT_R16G16B16A16_FLOAT,
+                DXGI_FORMAT_R16G16_FLOAT,
+                DXGI_FORMAT_R8G8B8A8_SNORM,
+            };
+
+            for (size_t i = 0; i < _countof(formats); ++i)
+            {
+                UINT support = 0;
+
+                if (FAILED(device->CheckFormatSupport(formats[i], &support)) || !(support & D3D11_FORMAT_SUPPORT_IA_VERTEX_BUFFER))
+                    return false;
+            }
+
+            return true;
+        }
+
+
+    private:
+        enum Conversion
+        {
+            Conversion_Copy,
+            Conversion_PositionToHalf4,
+            Conversion_Float3ToByteN4,
+            Conversion_Float4ToByteN4,
+            Conversion_Float2ToHalf2,
+        };
+
+
+        struct Element
+        {
+            Conversion conversion;
+            size_t inputOffset;
+            size_t outputOffset;
+            size_t bytes;
+        };
+
+
+        static Conversion ChooseConversion(D3D11_INPUT_ELEMENT_DESC const& desc)
+        {
+            if (_stricmp(desc.SemanticName, "SV_Position") == 0 || _stricmp(desc.SemanticName, "POSITION") == 0)
+            {
+                if (desc.Format == DXGI_FORMAT_R32G32B32_FLOAT)
+                    return Conversion_PositionToHalf4;
+            }
+            else if (_stricmp(desc.SemanticName, "NORMAL") == 0
+                     || _stricmp(desc.SemanticName, "TANGENT") == 0
+                     || _stricmp(desc.SemanticName, "BINORMAL") == 0)
+            {
+                if (desc.Format == DXGI_FORMAT_R32G32B32_FLOAT)
+                    return Conversion_Float3ToByteN4;
+
+                if (desc.Format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+                    return Conversion_Float4ToByteN4;
+            }
+            else if (_stricmp(desc.SemanticName, "TEXCOORD") == 0)
+            {
+                if (desc.Format == DXGI_FORMAT_R32G32_FLOAT)
+                    return Conversion_Float2ToHalf2;
+            }
+
+            return Conversion_Copy;
+        }
+
+
+        // Covers the formats the model loaders produce. Anything else returns zero, which turns packing off.
+        static size_t BytesPerElement(DXGI_FORMAT format)
+        {
+            switch (format)
+            {
+                case DXGI_FORMAT_R32G32B32A32_FLOAT:
+                    return 16;
+
+                case DXGI_FORMAT_R32G32B32_FLOAT:
+                    return 12;
+
+                case DXGI_FORMAT_R32G32_FLOAT:
+                case DXGI_FORMAT_R16G16B16A16_FLOAT:
+                case DXGI_FORMAT_R16G16B16A16_SNORM:
+                    return 8;
+
+                case DXGI_FORMAT_R32_FLOAT:
+                case DXGI_FORMAT_R16G16_FLOAT:
+                case DXGI_FORMAT_R8G8B8A8_UNORM:
+                case DXGI_FORMAT_R8G8B8A8_SNORM:
+                case DXGI_FORMAT_R8G8B8A8_UINT:
+                case DXGI_FORMAT_B8G8R8A8_UNORM:
+                    return 4;
+
+                default:
+                    return 0;
+            }
+        }
+
+
+        size_t mInputStride;
+        size_t mOutputStride;
+        bool mPacking;
+
+        std::vector<Element> mElements;
+        std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>> mOutputDecl;
+
+
+        // Prevent copying.
+        VertexPacker(VertexPacker const&) DIRECTX_CTOR_DELETE
+        VertexPacker& operator= (VertexPacker const&) DIRECTX_CTOR_DELETE
+    };
+}
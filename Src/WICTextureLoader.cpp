@@ -40,6 +40,13 @@
 
 #include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
+#include "ScopedInstrumentationEvent.h"
+
+#include <ppl.h>
+
+#if defined(_XM_SSE_INTRINSICS_) && defined(__AVX__)
+#include <tmmintrin.h>
+#endif
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -300,22 +307,193 @@ static DXGI_FORMAT MakeSRGB( _In_ DXGI_FORMAT format )
 }
 
 
+//--------------------------------------------------------------------------------------
+// Fast paths for the most common conversions to 32bppRGBA, used instead of IWICFormatConverter
+//--------------------------------------------------------------------------------------
+enum WIC_FASTCONVERT
+{
+    WIC_FASTCONVERT_NONE = 0,
+    WIC_FASTCONVERT_RGB24,      // 24bppRGB -> 32bppRGBA
+    WIC_FASTCONVERT_BGR24,      // 24bppBGR -> 32bppRGBA (most JPEG files)
+    WIC_FASTCONVERT_BGRA32,     // 32bppBGRA -> 32bppRGBA
+    WIC_FASTCONVERT_BGRX32,     // 32bppBGR -> 32bppRGBA
+};
+
+static WIC_FASTCONVERT _GetFastConvert( REFGUID source, REFGUID target )
+{
+    if ( memcmp( &target, &GUID_WICPixelFormat32bppRGBA, sizeof(GUID) ) != 0 )
+        return WIC_FASTCONVERT_NONE;
+
+    if ( memcmp( &source, &GUID_WICPixelFormat24bppRGB, sizeof(GUID) ) == 0 )
+        return WIC_FASTCONVERT_RGB24;
+
+    if ( memcmp( &source, &GUID_WICPixelFormat24bppBGR, sizeof(GUID) ) == 0 )
+        return WIC_FASTCONVERT_BGR24;
+
+    if ( memcmp( &source, &GUID_WICPixelFormat32bppBGRA, sizeof(GUID) ) == 0 )
+        return WIC_FASTCONVERT_BGRA32;
+
+    if ( memcmp( &source, &GUID_WICPixelFormat32bppBGR, sizeof(GUID) ) == 0 )
+        return WIC_FASTCONVERT_BGRX32;
+
+    return WIC_FASTCONVERT_NONE;
+}
+
 //---------------------------------------------------------------------------------
-static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
-                                     _In_opt_ ID3D11DeviceContext* d3dContext,
-#if defined(_XBOX_ONE) && defined(_TITLE)
-                                     _In_opt_ ID3D11DeviceX* d3dDeviceX,
-                                     _In_opt_ ID3D11DeviceContextX* d3dContextX,
+static void ExpandScanline24( _Out_writes_bytes_(width * 4) uint8_t* dest, _In_reads_bytes_(width * 3) const uint8_t* src, size_t width, bool swapRB )
+{
+    size_t i = 0;
+
+#if defined(_XM_SSE_INTRINSICS_) && defined(__AVX__)
+    // _mm_shuffle_epi8 is SSSE3, which is only assumed when building for AVX
+    const __m128i shuffle = swapRB ? _mm_setr_epi8( 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1 )
+                                   : _mm_setr_epi8( 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 );
+    const __m128i alpha = _mm_set1_epi32( static_cast<int>( 0xFF000000 ) );
+
+    // Each 16 byte load covers 5 1/3 pixels of which 4 are used, so stop early enough not to read past the row
+    for( ; i + 6 <= width; i += 4 )
+    {
+        __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i * 3 ) );
+        v = _mm_or_si128( _mm_shuffle_epi8( v, shuffle ), alpha );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 4 ), v );
+    }
 #endif
+
+    const size_t r = swapRB ? 2 : 0;
+    const size_t b = swapRB ? 0 : 2;
+
+    for( ; i < width; ++i )
+    {
+        const uint8_t* s = src + i * 3;
+        uint8_t* d = dest + i * 4;
+        d[0] = s[r];
+        d[1] = s[1];
+        d[2] = s[b];
+        d[3] = 0xFF;
+    }
+}
+
+//---------------------------------------------------------------------------------
+static void SwizzleScanline32( _Inout_updates_bytes_(width * 4) uint8_t* pixels, size_t width, bool setAlpha )
+{
+    size_t i = 0;
+
+#if defined(_XM_SSE_INTRINSICS_)
+    const __m128i maskGA = _mm_set1_epi32( static_cast<int>( 0xFF00FF00 ) );
+    const __m128i maskLow = _mm_set1_epi32( 0xFF );
+    const __m128i alpha = _mm_set1_epi32( setAlpha ? static_cast<int>( 0xFF000000 ) : 0 );
+
+    for( ; i + 4 <= width; i += 4 )
+    {
+        __m128i* ptr = reinterpret_cast<__m128i*>( pixels + i * 4 );
+        __m128i v = _mm_loadu_si128( ptr );
+
+        // Swap bytes 0 and 2 of each pixel
+        __m128i ga = _mm_or_si128( _mm_and_si128( v, maskGA ), alpha );
+        __m128i low = _mm_and_si128( _mm_srli_epi32( v, 16 ), maskLow );
+        __m128i high = _mm_slli_epi32( _mm_and_si128( v, maskLow ), 16 );
+        _mm_storeu_si128( ptr, _mm_or_si128( ga, _mm_or_si128( low, high ) ) );
+    }
+#endif
+
+    const uint32_t alphaBits = setAlpha ? 0xFF000000 : 0;
+
+    for( ; i < width; ++i )
+    {
+        uint32_t* p = reinterpret_cast<uint32_t*>( pixels + i * 4 );
+        uint32_t t = *p;
+        *p = ( t & 0xFF00FF00 ) | ( ( t >> 16 ) & 0xFF ) | ( ( t & 0xFF ) << 16 ) | alphaBits;
+    }
+}
+
+//---------------------------------------------------------------------------------
+static HRESULT CopyPixelsFast( _In_ IWICBitmapSource* source,
+                               _In_ WIC_FASTCONVERT convert,
+                               _In_ UINT width,
+                               _In_ UINT height,
+                               _In_ size_t rowPitch,
+                               _In_ size_t imageSize,
+                               _Out_writes_bytes_(imageSize) uint8_t* pixels )
+{
+    switch( convert )
+    {
+    case WIC_FASTCONVERT_BGRA32:
+    case WIC_FASTCONVERT_BGRX32:
+        {
+            // Same size, so decode straight into the destination and swizzle in place
+            HRESULT hr = source->CopyPixels( 0, static_cast<UINT>( rowPitch ), static_cast<UINT>( imageSize ), pixels );
+            if ( FAILED(hr) )
+                return hr;
+
+            for( UINT y = 0; y < height; ++y )
+            {
+                SwizzleScanline32( pixels + rowPitch * y, width, convert == WIC_FASTCONVERT_BGRX32 );
+            }
+        }
+        return S_OK;
+
+    case WIC_FASTCONVERT_RGB24:
+    case WIC_FASTCONVERT_BGR24:
+        {
+            // Decode a strip of rows at a time into a scratch buffer, and expand it into the destination
+            const UINT stripHeight = std::min<UINT>( height, 64 );
+            const size_t srcPitch = static_cast<size_t>( width ) * 3;
+
+            std::unique_ptr<uint8_t[]> strip( new (std::nothrow) uint8_t[ srcPitch * stripHeight ] );
+            if ( !strip )
+                return E_OUTOFMEMORY;
+
+            for( UINT y = 0; y < height; y += stripHeight )
+            {
+                UINT rows = std::min( stripHeight, height - y );
+
+                WICRect rect = { 0, static_cast<INT>( y ), static_cast<INT>( width ), static_cast<INT>( rows ) };
+
+                HRESULT hr = source->CopyPixels( &rect, static_cast<UINT>( srcPitch ), static_cast<UINT>( srcPitch * rows ), strip.get() );
+                if ( FAILED(hr) )
+                    return hr;
+
+                for( UINT row = 0; row < rows; ++row )
+                {
+                    ExpandScanline24( pixels + rowPitch * ( y + row ), strip.get() + srcPitch * row, width, convert == WIC_FASTCONVERT_BGR24 );
+                }
+            }
+        }
+        return S_OK;
+
+    default:
+        return E_UNEXPECTED;
+    }
+}
+
+
+//---------------------------------------------------------------------------------
+// The top-level image of a WIC frame, after any resize and format conversion
+struct WICImage
+{
+    WICImage()
+      : width(0),
+        height(0),
+        format(DXGI_FORMAT_UNKNOWN),
+        rowPitch(0),
+        imageSize(0)
+    { }
+
+    UINT width;
+    UINT height;
+    DXGI_FORMAT format;
+    size_t rowPitch;
+    size_t imageSize;
+    std::unique_ptr<uint8_t[]> pixels;
+};
+
+// Decoding only uses the free-threaded device, so it is safe to call from any thread
+static HRESULT DecodeTextureFromWIC( _In_ ID3D11Device* d3dDevice,
                                      _In_ IWICBitmapFrameDecode *frame,
                                      _In_ size_t maxsize,
-                                     _In_ D3D11_USAGE usage,
-                                     _In_ unsigned int bindFlags,
-                                     _In_ unsigned int cpuAccessFlags,
-                                     _In_ unsigned int miscFlags,
                                      _In_ bool forceSRGB,
-                                     _Out_opt_ ID3D11Resource** texture,
-                                     _Out_opt_ ID3D11ShaderResourceView** textureView )
+                                     _In_ bool wantMips,
+                                     _Out_ WICImage& image )
 {
     UINT width, height;
     HRESULT hr = frame->GetSize( &width, &height );
@@ -430,7 +608,7 @@ static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
     }
 
 #if (_WIN32_WINNT >= _WIN32_WINNT_WIN8) || defined(_WIN7_PLATFORM_UPDATE)
-    if ( (format == DXGI_FORMAT_R32G32B32_FLOAT) && d3dContext != 0 && textureView != 0 )
+    if ( (format == DXGI_FORMAT_R32G32B32_FLOAT) && wantMips )
     {
         // Special case test for optional device support for autogen mipchains for R32G32B32_FLOAT 
         UINT fmtSupport = 0;
@@ -535,6 +713,15 @@ static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
         if ( FAILED(hr) )
             return hr;
     }
+    else if ( _GetFastConvert( pixelFormat, convertGUID ) != WIC_FASTCONVERT_NONE
+              && twidth == width
+              && theight == height )
+    {
+        // Common format conversion with a fast path, no resize
+        hr = CopyPixelsFast( frame, _GetFastConvert( pixelFormat, convertGUID ), twidth, theight, rowPitch, imageSize, temp.get() );
+        if ( FAILED(hr) )
+            return hr;
+    }
     else if ( twidth != width || theight != height )
     {
         // Resize
@@ -563,6 +750,12 @@ static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
             if ( FAILED(hr) )
                 return hr;
         }
+        else if ( _GetFastConvert( pfScaler, convertGUID ) != WIC_FASTCONVERT_NONE )
+        {
+            hr = CopyPixelsFast( scaler.Get(), _GetFastConvert( pfScaler, convertGUID ), twidth, theight, rowPitch, imageSize, temp.get() );
+            if ( FAILED(hr) )
+                return hr;
+        }
         else
         {
             ComPtr<IWICFormatConverter> FC;
@@ -614,6 +807,46 @@ static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
             return hr;
     }
 
+    image.width = twidth;
+    image.height = theight;
+    image.format = format;
+    image.rowPitch = rowPitch;
+    image.imageSize = imageSize;
+    image.pixels = std::move( temp );
+
+    return S_OK;
+}
+
+
+//---------------------------------------------------------------------------------
+static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
+                                     _In_opt_ ID3D11DeviceContext* d3dContext,
+#if defined(_XBOX_ONE) && defined(_TITLE)
+                                     _In_opt_ ID3D11DeviceX* d3dDeviceX,
+                                     _In_opt_ ID3D11DeviceContextX* d3dContextX,
+#endif
+                                     _In_ IWICBitmapFrameDecode *frame,
+                                     _In_ size_t maxsize,
+                                     _In_ D3D11_USAGE usage,
+                                     _In_ unsigned int bindFlags,
+                                     _In_ unsigned int cpuAccessFlags,
+                                     _In_ unsigned int miscFlags,
+                                     _In_ bool forceSRGB,
+                                     _Out_opt_ ID3D11Resource** texture,
+                                     _Out_opt_ ID3D11ShaderResourceView** textureView )
+{
+    WICImage image;
+    HRESULT hr = DecodeTextureFromWIC( d3dDevice, frame, maxsize, forceSRGB, d3dContext != 0 && textureView != 0, image );
+    if ( FAILED(hr) )
+        return hr;
+
+    UINT twidth = image.width;
+    UINT theight = image.height;
+    DXGI_FORMAT format = image.format;
+    size_t rowPitch = image.rowPitch;
+    size_t imageSize = image.imageSize;
+    uint8_t* pixels = image.pixels.get();
+
     // See if format is supported for auto-gen mipmaps (varies by feature level)
     bool autogen = false;
     if ( d3dContext != 0 && textureView != 0 ) // Must have context and shader-view to auto generate mipmaps
@@ -654,7 +887,7 @@ static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
     }
 
     D3D11_SUBRESOURCE_DATA initData;
-    initData.pSysMem = temp.get();
+    initData.pSysMem = pixels;
     initData.SysMemPitch = static_cast<UINT>( rowPitch );
     initData.SysMemSlicePitch = static_cast<UINT>( imageSize );
 
@@ -686,7 +919,7 @@ static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
                 ID3D11Texture2D *pStaging = nullptr;
                 CD3D11_TEXTURE2D_DESC stagingDesc( format, twidth, theight, 1, 1, 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ, 1, 0, 0 );
                 D3D11_SUBRESOURCE_DATA initData;
-                initData.pSysMem =  temp.get();
+                initData.pSysMem =  pixels;
                 initData.SysMemPitch = static_cast<UINT>(rowPitch);
                 initData.SysMemSlicePitch = static_cast<UINT>(imageSize);
 
@@ -700,7 +933,7 @@ static HRESULT CreateTextureFromWIC( _In_ ID3D11Device* d3dDevice,
                     pStaging->Release();
                 }
 #else
-                d3dContext->UpdateSubresource( tex, 0, nullptr, temp.get(), static_cast<UINT>(rowPitch), static_cast<UINT>(imageSize) );
+                d3dContext->UpdateSubresource( tex, 0, nullptr, pixels, static_cast<UINT>(rowPitch), static_cast<UINT>(imageSize) );
 #endif
                 d3dContext->GenerateMips( *textureView );
             }
@@ -976,6 +1209,8 @@ HRESULT DirectX::CreateWICTextureFromFileEx( ID3D11Device* d3dDevice,
     if (!d3dDevice || !fileName || (!texture && !textureView))
         return E_INVALIDARG;
 
+    ScopedInstrumentationEvent event( InstrumentationCategory_TextureLoader, L"CreateWICTextureFromFileEx", fileName );
+
     IWICImagingFactory* pWIC = _GetWIC();
     if ( !pWIC )
         return E_NOINTERFACE;
@@ -1090,6 +1325,8 @@ HRESULT DirectX::CreateWICTextureFromFileEx( ID3D11Device* d3dDevice,
     if (!d3dDevice || !fileName || (!texture && !textureView))
         return E_INVALIDARG;
 
+    ScopedInstrumentationEvent event( InstrumentationCategory_TextureLoader, L"CreateWICTextureFromFileEx", fileName, 0, 0, d3dContext );
+
     IWICImagingFactory* pWIC = _GetWIC();
     if ( !pWIC )
         return E_NOINTERFACE;
@@ -1173,3 +1410,425 @@ HRESULT DirectX::CreateWICTextureFromFileEx( ID3D11Device* d3dDevice,
 
     return hr;
 }
+
+
+//--------------------------------------------------------------------------------------
+// Batched loading
+//--------------------------------------------------------------------------------------
+
+// Internal WICTextureBatch implementation class.
+class WICTextureBatch::Impl
+{
+public:
+    // A single image in the batch.
+    struct Entry
+    {
+        Entry()
+          : wicData(nullptr),
+            wicDataSize(0),
+            maxsize(0),
+            forceSRGB(false),
+            generateMips(false),
+            needsMips(false),
+            done(0),
+            result(E_PENDING)
+        { }
+
+        // Load parameters.
+        std::wstring fileName;
+        const uint8_t* wicData;
+        size_t wicDataSize;
+        size_t maxsize;
+        bool forceSRGB;
+        bool generateMips;
+
+        // Results, all written by the worker before done is set.
+        bool needsMips;
+        volatile LONG done;
+        HRESULT result;
+        ComPtr<ID3D11Texture2D> texture;
+        ComPtr<ID3D11ShaderResourceView> textureView;
+    };
+
+    Impl(_In_ ID3D11Device* device, size_t workerCount);
+    ~Impl();
+
+    size_t Enqueue(std::unique_ptr<Entry> entry);
+
+    ComPtr<ID3D11Device> mDevice;
+    size_t mMaxWorkers;
+
+    // Guards everything below.
+    mutable std::mutex mMutex;
+
+    std::vector<std::unique_ptr<Entry>> mEntries;
+    size_t mNextEntry;
+    size_t mWorkerCount;
+
+    Concurrency::task_group mWorkers;
+
+private:
+    void WorkerLoop();
+    HRESULT Process(_In_ Entry* entry);
+};
+
+
+WICTextureBatch::Impl::Impl(_In_ ID3D11Device* device, size_t workerCount)
+  : mDevice(device),
+    mMaxWorkers(workerCount),
+    mNextEntry(0),
+    mWorkerCount(0)
+{
+    if (!device)
+        throw std::exception("Direct3D device cannot be null");
+
+    if (!workerCount)
+        throw std::exception("WICTextureBatch needs at least one worker");
+
+    // Create the factory now rather than racing to do so on the workers.
+    if (!_GetWIC())
+        throw std::exception("WIC imaging factory not available");
+}
+
+
+WICTextureBatch::Impl::~Impl()
+{
+    mWorkers.wait();
+}
+
+
+// Adds an image to the batch, starting another worker if there is room for one.
+size_t WICTextureBatch::Impl::Enqueue(std::unique_ptr<Entry> entry)
+{
+    bool startWorker = false;
+    size_t index;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        index = mEntries.size();
+
+        mEntries.push_back(std::move(entry));
+
+        if (mWorkerCount < mMaxWorkers && mWorkerCount < mEntries.size() - mNextEntry)
+        {
+            mWorkerCount++;
+            startWorker = true;
+        }
+    }
+
+    if (startWorker)
+    {
+        mWorkers.run([this]()
+        {
+            WorkerLoop();
+        });
+    }
+
+    return index;
+}
+
+
+// Each worker keeps decoding the next image until there are none left.
+void WICTextureBatch::Impl::WorkerLoop()
+{
+    // WIC needs COM, and this thread belongs to the PPL scheduler rather than the application.
+    HRESULT hrCOM = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+
+    for (;;)
+    {
+        Entry* entry;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            if (mNextEntry >= mEntries.size())
+            {
+                mWorkerCount--;
+                break;
+            }
+
+            entry = mEntries[mNextEntry++].get();
+        }
+
+        HRESULT hr = Process(entry);
+
+        if (FAILED(hr))
+        {
+            entry->texture.Reset();
+            entry->textureView.Reset();
+            entry->needsMips = false;
+        }
+
+        entry->result = hr;
+        InterlockedExchange(&entry->done, 1);
+    }
+
+    if (SUCCEEDED(hrCOM))
+    {
+        CoUninitialize();
+    }
+}
+
+
+// Decodes the image and creates its texture on the calling (worker) thread.
+HRESULT WICTextureBatch::Impl::Process(_In_ Entry* entry)
+{
+    IWICImagingFactory* pWIC = _GetWIC();
+    if ( !pWIC )
+        return E_NOINTERFACE;
+
+    ComPtr<IWICBitmapDecoder> decoder;
+    HRESULT hr;
+
+    if ( entry->wicData )
+    {
+        if ( !entry->wicDataSize )
+            return E_FAIL;
+
+#ifdef _M_AMD64
+        if ( entry->wicDataSize > 0xFFFFFFFF )
+            return HRESULT_FROM_WIN32( ERROR_FILE_TOO_LARGE );
+#endif
+
+        ComPtr<IWICStream> stream;
+        hr = pWIC->CreateStream( stream.GetAddressOf() );
+        if ( FAILED(hr) )
+            return hr;
+
+        hr = stream->InitializeFromMemory( const_cast<uint8_t*>( entry->wicData ), static_cast<DWORD>( entry->wicDataSize ) );
+        if ( FAILED(hr) )
+            return hr;
+
+        hr = pWIC->CreateDecoderFromStream( stream.Get(), 0, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf() );
+    }
+    else
+    {
+        hr = pWIC->CreateDecoderFromFilename( entry->fileName.c_str(), 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf() );
+    }
+
+    if ( FAILED(hr) )
+        return hr;
+
+    ComPtr<IWICBitmapFrameDecode> frame;
+    hr = decoder->GetFrame( 0, frame.GetAddressOf() );
+    if ( FAILED(hr) )
+        return hr;
+
+    WICImage image;
+    hr = DecodeTextureFromWIC( mDevice.Get(), frame.Get(), entry->maxsize, entry->forceSRGB, entry->generateMips, image );
+    if ( FAILED(hr) )
+        return hr;
+
+    // See if format is supported for auto-gen mipmaps (varies by feature level)
+    bool autogen = false;
+    if ( entry->generateMips )
+    {
+        UINT fmtSupport = 0;
+        hr = mDevice->CheckFormatSupport( image.format, &fmtSupport );
+        autogen = SUCCEEDED(hr) && ( fmtSupport & D3D11_FORMAT_SUPPORT_MIP_AUTOGEN );
+    }
+
+    UINT mipLevels = 1;
+    if ( autogen )
+    {
+        for( UINT size = std::max( image.width, image.height ); size > 1; size >>= 1 )
+        {
+            ++mipLevels;
+        }
+    }
+
+    CD3D11_TEXTURE2D_DESC desc( image.format, image.width, image.height, 1, mipLevels,
+                                (autogen) ? ( D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET ) : D3D11_BIND_SHADER_RESOURCE,
+                                D3D11_USAGE_DEFAULT, 0, 1, 0,
+                                (autogen) ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0 );
+
+    // Every level is initialized from the top-level pixels (the smaller levels just read the start of each row),
+    // and GenerateMips overwrites them later. This creates the texture with its data here on the worker, which
+    // leaves nothing but GPU work for Submit.
+    std::unique_ptr<D3D11_SUBRESOURCE_DATA[]> initData( new (std::nothrow) D3D11_SUBRESOURCE_DATA[ mipLevels ] );
+    if ( !initData )
+        return E_OUTOFMEMORY;
+
+    for( UINT level = 0; level < mipLevels; ++level )
+    {
+        initData[ level ].pSysMem = image.pixels.get();
+        initData[ level ].SysMemPitch = static_cast<UINT>( image.rowPitch );
+        initData[ level ].SysMemSlicePitch = static_cast<UINT>( image.imageSize );
+    }
+
+    hr = mDevice->CreateTexture2D( &desc, initData.get(), entry->texture.GetAddressOf() );
+    if ( FAILED(hr) )
+        return hr;
+
+    CD3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc( D3D11_SRV_DIMENSION_TEXTURE2D, image.format, 0, mipLevels );
+
+    hr = mDevice->CreateShaderResourceView( entry->texture.Get(), &SRVDesc, entry->textureView.GetAddressOf() );
+    if ( FAILED(hr) )
+        return hr;
+
+    SetDebugObjectName(entry->texture.Get(), "WICTextureLoader");
+    SetDebugObjectName(entry->textureView.Get(), "WICTextureLoader");
+
+    entry->needsMips = autogen;
+
+    return S_OK;
+}
+
+
+// Public constructor.
+WICTextureBatch::WICTextureBatch(_In_ ID3D11Device* device, size_t workerCount)
+  : pImpl(new Impl(device, workerCount))
+{
+}
+
+
+// Move constructor.
+WICTextureBatch::WICTextureBatch(WICTextureBatch&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+WICTextureBatch& WICTextureBatch::operator= (WICTextureBatch&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+WICTextureBatch::~WICTextureBatch()
+{
+}
+
+
+_Use_decl_annotations_
+size_t WICTextureBatch::AddFile( const wchar_t* fileName, size_t maxsize, bool forceSRGB, bool generateMips )
+{
+    if (!fileName)
+        throw std::exception("File name cannot be null");
+
+    std::unique_ptr<Impl::Entry> entry(new Impl::Entry());
+
+    entry->fileName = fileName;
+    entry->maxsize = maxsize;
+    entry->forceSRGB = forceSRGB;
+    entry->generateMips = generateMips;
+
+    return pImpl->Enqueue(std::move(entry));
+}
+
+
+_Use_decl_annotations_
+size_t WICTextureBatch::AddMemory( const uint8_t* wicData, size_t wicDataSize, size_t maxsize, bool forceSRGB, bool generateMips )
+{
+    if (!wicData)
+        throw std::exception("Image data cannot be null");
+
+    std::unique_ptr<Impl::Entry> entry(new Impl::Entry());
+
+    entry->wicData = wicData;
+    entry->wicDataSize = wicDataSize;
+    entry->maxsize = maxsize;
+    entry->forceSRGB = forceSRGB;
+    entry->generateMips = generateMips;
+
+    return pImpl->Enqueue(std::move(entry));
+}
+
+
+void WICTextureBatch::Wait()
+{
+    pImpl->mWorkers.wait();
+}
+
+
+_Use_decl_annotations_
+size_t WICTextureBatch::Submit( ID3D11DeviceContext* deviceContext )
+{
+    if (!deviceContext)
+        throw std::exception("Direct3D device context cannot be null");
+
+    Wait();
+
+    size_t count = 0;
+
+    for (auto it = pImpl->mEntries.cbegin(); it != pImpl->mEntries.cend(); ++it)
+    {
+        auto entry = it->get();
+
+        if (entry->needsMips)
+        {
+            deviceContext->GenerateMips(entry->textureView.Get());
+
+            entry->needsMips = false;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+
+_Use_decl_annotations_
+HRESULT WICTextureBatch::GetResult( size_t index, ID3D11Resource** texture, ID3D11ShaderResourceView** textureView ) const
+{
+    if ( texture )
+    {
+        *texture = nullptr;
+    }
+    if ( textureView )
+    {
+        *textureView = nullptr;
+    }
+
+    Impl::Entry* entry;
+
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mMutex);
+
+        if (index >= pImpl->mEntries.size())
+            return E_INVALIDARG;
+
+        entry = pImpl->mEntries[index].get();
+    }
+
+    if (!entry->done)
+        return E_PENDING;
+
+    if (SUCCEEDED(entry->result))
+    {
+        if (texture)
+        {
+            entry->texture.CopyTo(texture);
+        }
+
+        if (textureView)
+        {
+            entry->textureView.CopyTo(textureView);
+        }
+    }
+
+    return entry->result;
+}
+
+
+size_t WICTextureBatch::GetCount() const
+{
+    std::lock_guard<std::mutex> lock(pImpl->mMutex);
+
+    return pImpl->mEntries.size();
+}
+
+
+void WICTextureBatch::Clear()
+{
+    Wait();
+
+    std::lock_guard<std::mutex> lock(pImpl->mMutex);
+
+    pImpl->mEntries.clear();
+    pImpl->mNextEntry = 0;
+}
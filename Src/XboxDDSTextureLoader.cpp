@@ -415,6 +415,17 @@ static HRESULT CreateD3DResources( _In_ ID3D11DeviceX* d3dDevice,
 
 
 //--------------------------------------------------------------------------------------
+static void GetPlacementRequirements( _In_ const DDS_HEADER_XBOX* xboxext,
+                                      _Out_ size_t* sizeBytes,
+                                      _Out_ size_t* alignmentBytes )
+{
+    *sizeBytes = (size_t( xboxext->dataSize ) + 0xFFF) & ~0xFFF; // 4K boundary
+    *alignmentBytes = std::max<size_t>( xboxext->baseAlignment, 4096 );
+}
+
+
+//--------------------------------------------------------------------------------------
+// If grfxPool is given the texture is placed in it, otherwise graphics memory is allocated and returned in grfxMemory
 static HRESULT CreateTextureFromDDS( _In_ ID3D11DeviceX* d3dDevice,
                                      _In_ const DDS_HEADER* header,
                                      _In_reads_bytes_(bitSize) const uint8_t* bitData,
@@ -422,7 +433,10 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11DeviceX* d3dDevice,
                                      _In_ bool forceSRGB,
                                      _Outptr_opt_ ID3D11Resource** texture,
                                      _Outptr_opt_ ID3D11ShaderResourceView** textureView,
-                                     _Outptr_ void** grfxMemory )
+                                     _In_opt_ void* grfxPool,
+                                     _In_ size_t poolSize,
+                                     _In_ size_t poolOffset,
+                                     _Outptr_opt_ void** grfxMemory )
 {
     HRESULT hr = S_OK;
 
@@ -556,34 +570,112 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11DeviceX* d3dDevice,
         return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
     }
 
-    // Allocate graphics memory
-    size_t sizeBytes = (size_t( xboxext->dataSize ) + 0xFFF) & ~0xFFF; // 4K boundary
-    size_t alignmentBytes = std::max<size_t>( xboxext->baseAlignment, 4096 );
+    size_t sizeBytes, alignmentBytes;
+    GetPlacementRequirements( xboxext, &sizeBytes, &alignmentBytes );
 
-    hr = D3DAllocateGraphicsMemory( sizeBytes, alignmentBytes, 0, D3D11_GRAPHICS_MEMORY_ACCESS_CPU_CACHE_COHERENT, grfxMemory );
-    if ( FAILED(hr) )
-        return hr;
+    void* memory = nullptr;
+
+    if ( grfxPool )
+    {
+        // Place in the caller's pool
+        if ( poolOffset > poolSize || sizeBytes > ( poolSize - poolOffset ) )
+        {
+            return HRESULT_FROM_WIN32( ERROR_INSUFFICIENT_BUFFER );
+        }
+
+        memory = reinterpret_cast<uint8_t*>( grfxPool ) + poolOffset;
+
+        if ( reinterpret_cast<uintptr_t>( memory ) & ( alignmentBytes - 1 ) )
+        {
+            return HRESULT_FROM_WIN32( ERROR_INVALID_ADDRESS );
+        }
+    }
+    else
+    {
+        // Allocate graphics memory
+        assert( grfxMemory != 0 );
+
+        hr = D3DAllocateGraphicsMemory( sizeBytes, alignmentBytes, 0, D3D11_GRAPHICS_MEMORY_ACCESS_CPU_CACHE_COHERENT, &memory );
+        if ( FAILED(hr) )
+            return hr;
+    }
 
-    assert( *grfxMemory != 0 );
+    assert( memory != 0 );
 
     // Copy tiled data into graphics memory
-    memcpy( *grfxMemory, bitData, xboxext->dataSize );
+    memcpy( memory, bitData, xboxext->dataSize );
 
     // Create the texture
     hr = CreateD3DResources( d3dDevice, xboxext,
                              width, height, depth, mipCount, arraySize,
-                             forceSRGB, isCubeMap, *grfxMemory,
+                             forceSRGB, isCubeMap, memory,
                              texture, textureView );
     if ( FAILED(hr) )
     {
-        D3DFreeGraphicsMemory( *grfxMemory );
-        *grfxMemory = nullptr;
+        if ( !grfxPool )
+        {
+            D3DFreeGraphicsMemory( memory );
+        }
+        return hr;
+    }
+
+    if ( !grfxPool )
+    {
+        *grfxMemory = memory;
     }
 
     return hr;
 }
 
 
+//--------------------------------------------------------------------------------------
+static HRESULT ValidateDDSHeaders( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                   _In_ size_t ddsDataSize,
+                                   _Outptr_ const DDS_HEADER** header )
+{
+    *header = nullptr;
+
+    // Validate DDS file in memory
+    if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+    {
+        return E_FAIL;
+    }
+
+    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData );
+    if (dwMagicNumber != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto hdr = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+
+    // Verify header to validate DDS file
+    if (hdr->size != sizeof(DDS_HEADER) ||
+        hdr->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    // Check for XBOX extension
+    if ( !( hdr->ddspf.flags & DDS_FOURCC )
+         || ( MAKEFOURCC( 'X', 'B', 'O', 'X' ) != hdr->ddspf.fourCC ) )
+    {
+        // Use standard DDSTextureLoader instead
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+
+    // Must be long enough for both headers and magic value
+    if (ddsDataSize < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_XBOX)))
+    {
+        return E_FAIL;
+    }
+
+    *header = hdr;
+
+    return S_OK;
+}
+
+
 //--------------------------------------------------------------------------------------
 static DDS_ALPHA_MODE GetAlphaMode( _In_ const DDS_HEADER* header )
 {
@@ -639,47 +731,150 @@ HRESULT Xbox::CreateDDSTextureFromMemory( ID3D11DeviceX* d3dDevice,
 
     *grfxMemory = nullptr;
 
-    // Validate DDS file in memory
-    if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+    const DDS_HEADER* header = nullptr;
+    HRESULT hr = ValidateDDSHeaders( ddsData, ddsDataSize, &header );
+    if ( FAILED(hr) )
+        return hr;
+
+    ptrdiff_t offset = sizeof( uint32_t ) + sizeof( DDS_HEADER ) + sizeof( DDS_HEADER_XBOX );
+
+    hr = CreateTextureFromDDS( d3dDevice, header,
+                               ddsData + offset, ddsDataSize - offset, forceSRGB,
+                               texture, textureView,
+                               nullptr, 0, 0, grfxMemory );
+    if ( SUCCEEDED(hr) )
     {
-        return E_FAIL;
+        if (texture != 0 && *texture != 0)
+        {
+            SetDebugObjectName(*texture, "XboxDDSTextureLoader");
+        }
+
+        if (textureView != 0 && *textureView != 0)
+        {
+            SetDebugObjectName(*textureView, "XboxDDSTextureLoader");
+        }
+
+        if ( alphaMode )
+            *alphaMode = GetAlphaMode( header );
     }
 
-    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData );
-    if (dwMagicNumber != DDS_MAGIC)
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT Xbox::CreateDDSTextureFromFile( ID3D11DeviceX* d3dDevice,
+                                        const wchar_t* fileName,
+                                        ID3D11Resource** texture,
+                                        ID3D11ShaderResourceView** textureView,
+                                        void** grfxMemory,
+                                        DDS_ALPHA_MODE* alphaMode,
+                                        bool forceSRGB )
+{
+    if ( texture )
     {
-        return E_FAIL;
+        *texture = nullptr;
+    }
+    if ( textureView )
+    {
+        *textureView = nullptr;
+    }
+    if ( alphaMode )
+    {
+        *alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+    }
+
+    if ( !d3dDevice || !fileName || (!texture && !textureView) || !grfxMemory )
+    {
+        return E_INVALIDARG;
     }
 
-    auto header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+    *grfxMemory = nullptr;
 
-    // Verify header to validate DDS file
-    if (header->size != sizeof(DDS_HEADER) ||
-        header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    DDS_HEADER* header = nullptr;
+    uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+
+    std::unique_ptr<uint8_t[]> ddsData;
+    HRESULT hr = LoadTextureDataFromFile( fileName,
+                                          ddsData,
+                                          &header,
+                                          &bitData,
+                                          &bitSize
+                                        );
+    if (FAILED(hr))
     {
-        return E_FAIL;
+        return hr;
     }
 
-    // Check for XBOX extension
-    if ( !( header->ddspf.flags & DDS_FOURCC )
-         || ( MAKEFOURCC( 'X', 'B', 'O', 'X' ) != header->ddspf.fourCC ) )
+    hr = CreateTextureFromDDS( d3dDevice, header,
+                               bitData, bitSize, forceSRGB,
+                               texture, textureView,
+                               nullptr, 0, 0, grfxMemory );
+
+    if ( SUCCEEDED(hr) )
     {
-        // Use standard DDSTextureLoader instead
-        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+#if !defined(NO_D3D11_DEBUG_NAME) && ( defined(_DEBUG) || defined(PROFILE) )
+        if (texture != 0 && *texture != 0)
+        {
+            (*texture)->SetName( fileName );
+        }
+        if (textureView != 0 && *textureView != 0 )
+        {
+            (*textureView)->SetName( fileName );
+        }
+#endif
+
+        if ( alphaMode )
+            *alphaMode = GetAlphaMode( header );
     }
 
-    // Must be long enough for both headers and magic value
-    if (ddsDataSize < (sizeof(DDS_HEADER) + sizeof(uint32_t) + sizeof(DDS_HEADER_XBOX)))
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT Xbox::CreateDDSTextureFromMemory( ID3D11DeviceX* d3dDevice,
+                                          const uint8_t* ddsData,
+                                          size_t ddsDataSize,
+                                          ID3D11Resource** texture,
+                                          ID3D11ShaderResourceView** textureView,
+                                          void* grfxPool,
+                                          size_t poolSize,
+                                          size_t poolOffset,
+                                          DDS_ALPHA_MODE* alphaMode,
+                                          bool forceSRGB )
+{
+    if ( texture )
     {
-        return E_FAIL;
+        *texture = nullptr;
+    }
+    if ( textureView )
+    {
+        *textureView = nullptr;
+    }
+    if ( alphaMode )
+    {
+        *alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+    }
+
+    if ( !d3dDevice || !ddsData || (!texture && !textureView) || !grfxPool )
+    {
+        return E_INVALIDARG;
     }
 
+    const DDS_HEADER* header = nullptr;
+    HRESULT hr = ValidateDDSHeaders( ddsData, ddsDataSize, &header );
+    if ( FAILED(hr) )
+        return hr;
+
     ptrdiff_t offset = sizeof( uint32_t ) + sizeof( DDS_HEADER ) + sizeof( DDS_HEADER_XBOX );
 
-    HRESULT hr = CreateTextureFromDDS( d3dDevice, header,
-                                       ddsData + offset, ddsDataSize - offset, forceSRGB,
-                                       texture, textureView,
-                                       grfxMemory );
+    hr = CreateTextureFromDDS( d3dDevice, header,
+                               ddsData + offset, ddsDataSize - offset, forceSRGB,
+                               texture, textureView,
+                               grfxPool, poolSize, poolOffset, nullptr );
     if ( SUCCEEDED(hr) )
     {
         if (texture != 0 && *texture != 0)
@@ -705,7 +900,9 @@ HRESULT Xbox::CreateDDSTextureFromFile( ID3D11DeviceX* d3dDevice,
                                         const wchar_t* fileName,
                                         ID3D11Resource** texture,
                                         ID3D11ShaderResourceView** textureView,
-                                        void** grfxMemory,
+                                        void* grfxPool,
+                                        size_t poolSize,
+                                        size_t poolOffset,
                                         DDS_ALPHA_MODE* alphaMode,
                                         bool forceSRGB )
 {
@@ -722,13 +919,11 @@ HRESULT Xbox::CreateDDSTextureFromFile( ID3D11DeviceX* d3dDevice,
         *alphaMode = DDS_ALPHA_MODE_UNKNOWN;
     }
 
-    if ( !d3dDevice || !fileName || (!texture && !textureView) || !grfxMemory )
+    if ( !d3dDevice || !fileName || (!texture && !textureView) || !grfxPool )
     {
         return E_INVALIDARG;
     }
 
-    *grfxMemory = nullptr;
-
     DDS_HEADER* header = nullptr;
     uint8_t* bitData = nullptr;
     size_t bitSize = 0;
@@ -748,7 +943,7 @@ HRESULT Xbox::CreateDDSTextureFromFile( ID3D11DeviceX* d3dDevice,
     hr = CreateTextureFromDDS( d3dDevice, header,
                                bitData, bitSize, forceSRGB,
                                texture, textureView,
-                               grfxMemory );
+                               grfxPool, poolSize, poolOffset, nullptr );
 
     if ( SUCCEEDED(hr) )
     {
@@ -769,3 +964,78 @@ HRESULT Xbox::CreateDDSTextureFromFile( ID3D11DeviceX* d3dDevice,
 
     return hr;
 }
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT Xbox::GetDDSTextureMemoryRequirements( const uint8_t* ddsData,
+                                               size_t ddsDataSize,
+                                               size_t* sizeBytes,
+                                               size_t* alignmentBytes )
+{
+    if ( !ddsData || !sizeBytes || !alignmentBytes )
+    {
+        return E_INVALIDARG;
+    }
+
+    *sizeBytes = 0;
+    *alignmentBytes = 0;
+
+    const DDS_HEADER* header = nullptr;
+    HRESULT hr = ValidateDDSHeaders( ddsData, ddsDataSize, &header );
+    if ( FAILED(hr) )
+        return hr;
+
+    auto xboxext = reinterpret_cast<const DDS_HEADER_XBOX*>( reinterpret_cast<const uint8_t*>( header ) + sizeof(DDS_HEADER) );
+
+    if ( !xboxext->dataSize || !xboxext->baseAlignment )
+    {
+        return E_FAIL;
+    }
+
+    GetPlacementRequirements( xboxext, sizeBytes, alignmentBytes );
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT Xbox::GetDDSTextureMemoryRequirements( const wchar_t* fileName,
+                                               size_t* sizeBytes,
+                                               size_t* alignmentBytes )
+{
+    if ( !fileName || !sizeBytes || !alignmentBytes )
+    {
+        return E_INVALIDARG;
+    }
+
+    *sizeBytes = 0;
+    *alignmentBytes = 0;
+
+    // open the file
+    ScopedHandle hFile( safe_handle( CreateFile2( fileName,
+                                                  GENERIC_READ,
+                                                  FILE_SHARE_READ,
+                                                  OPEN_EXISTING,
+                                                  nullptr ) ) );
+
+    if ( !hFile )
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    // Only the headers are needed
+    uint8_t headers[ sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_XBOX) ];
+
+    DWORD BytesRead = 0;
+    if (!ReadFile( hFile.get(),
+                   headers,
+                   sizeof(headers),
+                   &BytesRead,
+                   nullptr
+                 ))
+    {
+        return HRESULT_FROM_WIN32( GetLastError() );
+    }
+
+    return GetDDSTextureMemoryRequirements( headers, BytesRead, sizeBytes, alignmentBytes );
+}
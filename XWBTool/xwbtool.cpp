@@ -3,7 +3,8 @@
 //
 // Simple command-line tool for building wave banks from 1 or more .WAV files. This
 // generates binary wave banks compliant with XACT 3's Wave Bank .XWB format. The
-// .WAV files are not format converted or compressed.
+// .WAV files are not format converted, but PCM data can optionally be compressed
+// to MS-ADPCM.
 //
 // For a more full-featured builder, see XACT 3 and the XACTBLD tool in the legacy
 // DirectX SDK (June 2010) release.
@@ -19,6 +20,7 @@
 //--------------------------------------------------------------------------------------
 
 #define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
 #include <windows.h>
 
 #include <stdio.h>
@@ -28,6 +30,8 @@
 #include <memory>
 #include <vector>
 
+#include <ppl.h>
+
 #include "WAVFileReader.h"
 
 //////////////////////////////////////////////////////////////////////////////
@@ -329,6 +333,223 @@ DWORD EncodeWMABlockAlign(DWORD dwBlockAlign, DWORD dwAvgBytesPerSec)
     return DWORD( blockAlignIndex | (bytesPerSecIndex << 5) );
 }
 
+// Microsoft ADPCM standard encoding coefficients
+const short g_pAdpcmCoefficients1[] = {256,  512, 0, 192, 240,  460,  392};
+const short g_pAdpcmCoefficients2[] = {  0, -256, 0,  64,   0, -208, -232};
+
+// Microsoft ADPCM step size adaptation, indexed by the encoded nibble
+const int g_pAdpcmAdaptation[] = { 230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230 };
+
+// Encoded blocks are 262 bytes for mono which is within the range of the mini-format block alignment
+const WORD ADPCM_SAMPLES_PER_BLOCK = 512;
+
+struct AdpcmChannelHeader
+{
+    int predictor;
+    int delta;
+    int sample1;
+    int sample2;
+};
+
+// Encodes one channel of a block using the given predictor, returning the squared error of the result
+uint64_t EncodeAdpcmChannel( _In_reads_(frames * stride) const short* samples, size_t stride, size_t frames, int predictor,
+                             AdpcmChannelHeader& header, _Out_writes_(frames - 2) uint8_t* nibbles )
+{
+    const int coef1 = g_pAdpcmCoefficients1[ predictor ];
+    const int coef2 = g_pAdpcmCoefficients2[ predictor ];
+
+    int sample2 = samples[ 0 ];
+    int sample1 = samples[ stride ];
+
+    // Initial step size from the average prediction residual at the start of the block
+    size_t count = std::min<size_t>( frames, 18 );
+    int total = 0;
+    for( size_t j = 2; j < count; ++j )
+    {
+        int pred = ( samples[ ( j - 1 ) * stride ] * coef1 + samples[ ( j - 2 ) * stride ] * coef2 ) >> 8;
+        total += abs( samples[ j * stride ] - pred );
+    }
+
+    int delta = ( count > 2 ) ? ( total / int( ( count - 2 ) * 2 ) ) : 0;
+    delta = std::max( 16, std::min( delta, 32767 ) );
+
+    header.predictor = predictor;
+    header.delta = delta;
+    header.sample1 = sample1;
+    header.sample2 = sample2;
+
+    uint64_t error = 0;
+    for( size_t j = 2; j < frames; ++j )
+    {
+        int target = samples[ j * stride ];
+        int pred = ( sample1 * coef1 + sample2 * coef2 ) >> 8;
+
+        int residual = target - pred;
+        int nibble = ( residual >= 0 ) ? ( residual + delta / 2 ) / delta : -( ( -residual + delta / 2 ) / delta );
+        nibble = std::max( -8, std::min( nibble, 7 ) );
+
+        // Track the decoder's reconstruction so the error doesn't accumulate
+        int decoded = std::max( -32768, std::min( pred + nibble * delta, 32767 ) );
+
+        int64_t diff = target - decoded;
+        error += uint64_t( diff * diff );
+
+        sample2 = sample1;
+        sample1 = decoded;
+
+        delta = ( g_pAdpcmAdaptation[ nibble & 0xF ] * delta ) >> 8;
+        if ( delta < 16 )
+            delta = 16;
+
+        nibbles[ j - 2 ] = uint8_t( nibble & 0xF );
+    }
+
+    return error;
+}
+
+inline uint8_t* PutShort( _Out_writes_(2) uint8_t* ptr, int value )
+{
+    ptr[0] = uint8_t( value & 0xFF );
+    ptr[1] = uint8_t( ( value >> 8 ) & 0xFF );
+    return ptr + 2;
+}
+
+// Encodes one block of ADPCM_SAMPLES_PER_BLOCK 16-bit frames, picking the best predictor for each channel
+void EncodeAdpcmBlock( _In_reads_(ADPCM_SAMPLES_PER_BLOCK * channels) const short* samples, size_t channels, _Out_ uint8_t* block )
+{
+    assert( channels == 1 || channels == 2 );
+
+    AdpcmChannelHeader headers[2];
+    uint8_t nibbles[2][ ADPCM_SAMPLES_PER_BLOCK - 2 ];
+
+    for( size_t ch = 0; ch < channels; ++ch )
+    {
+        uint64_t bestError = uint64_t(-1);
+
+        for( int predictor = 0; predictor < 7 /*MSADPCM_NUM_COEFFICIENTS*/; ++predictor )
+        {
+            AdpcmChannelHeader header;
+            uint8_t trial[ ADPCM_SAMPLES_PER_BLOCK - 2 ];
+
+            uint64_t error = EncodeAdpcmChannel( samples + ch, channels, ADPCM_SAMPLES_PER_BLOCK, predictor, header, trial );
+            if ( error < bestError )
+            {
+                bestError = error;
+                headers[ ch ] = header;
+                memcpy( nibbles[ ch ], trial, sizeof(trial) );
+            }
+        }
+    }
+
+    // Block header is each field in turn for all channels
+    uint8_t* ptr = block;
+    for( size_t ch = 0; ch < channels; ++ch )
+        *ptr++ = uint8_t( headers[ ch ].predictor );
+
+    for( size_t ch = 0; ch < channels; ++ch )
+        ptr = PutShort( ptr, headers[ ch ].delta );
+
+    for( size_t ch = 0; ch < channels; ++ch )
+        ptr = PutShort( ptr, headers[ ch ].sample1 );
+
+    for( size_t ch = 0; ch < channels; ++ch )
+        ptr = PutShort( ptr, headers[ ch ].sample2 );
+
+    // Remaining frames are packed high nibble first, interleaving channels for stereo
+    if ( channels == 1 )
+    {
+        for( size_t j = 0; j < ( ADPCM_SAMPLES_PER_BLOCK - 2 ); j += 2 )
+            *ptr++ = uint8_t( ( nibbles[0][ j ] << 4 ) | nibbles[0][ j + 1 ] );
+    }
+    else
+    {
+        for( size_t j = 0; j < ( ADPCM_SAMPLES_PER_BLOCK - 2 ); ++j )
+            *ptr++ = uint8_t( ( nibbles[0][ j ] << 4 ) | nibbles[1][ j ] );
+    }
+}
+
+bool CanEncodeADPCM( const DirectX::WAVData& data )
+{
+    auto wfx = data.wfx;
+    if ( !wfx || wfx->wFormatTag != WAVE_FORMAT_PCM )
+        return false;
+
+    if ( ( wfx->nChannels != 1 && wfx->nChannels != 2 )
+         || ( wfx->wBitsPerSample != 8 && wfx->wBitsPerSample != 16 )
+         || wfx->nBlockAlign != ( wfx->nChannels * wfx->wBitsPerSample / 8 ) )
+        return false;
+
+    // ADPCM loop regions must start and end on block boundaries
+    if ( data.loopLength > 0
+         && ( ( data.loopStart % ADPCM_SAMPLES_PER_BLOCK ) || ( data.loopLength % ADPCM_SAMPLES_PER_BLOCK ) ) )
+        return false;
+
+    return ( data.audioBytes >= wfx->nBlockAlign );
+}
+
+// Encodes 8-bit or 16-bit mono or stereo PCM to MS-ADPCM. The final block is padded with silence.
+void EncodeADPCM( const DirectX::WAVData& source, std::unique_ptr<uint8_t[]>& result, DirectX::WAVData& encoded )
+{
+    assert( CanEncodeADPCM( source ) );
+
+    auto wfx = source.wfx;
+    const size_t channels = wfx->nChannels;
+    const size_t frames = source.audioBytes / wfx->nBlockAlign;
+    const size_t blockCount = ( frames + ADPCM_SAMPLES_PER_BLOCK - 1 ) / ADPCM_SAMPLES_PER_BLOCK;
+
+    // Expand the source to 16-bit samples
+    std::unique_ptr<short[]> samples( new short[ blockCount * ADPCM_SAMPLES_PER_BLOCK * channels ] );
+    memset( samples.get(), 0, sizeof(short) * blockCount * ADPCM_SAMPLES_PER_BLOCK * channels );
+
+    if ( wfx->wBitsPerSample == 8 )
+    {
+        for( size_t j = 0; j < frames * channels; ++j )
+            samples[ j ] = short( ( int( source.startAudio[ j ] ) - 128 ) * 256 );
+    }
+    else
+    {
+        memcpy( samples.get(), source.startAudio, sizeof(short) * frames * channels );
+    }
+
+    const size_t blockAlign = AdpcmBlockSizeFromPcmFrames( ADPCM_SAMPLES_PER_BLOCK, WORD( channels ) );
+    const size_t formatSize = BLOCKALIGNPAD( sizeof(WAVEFORMATEX) + 32 /*MSADPCM_FORMAT_EXTRA_BYTES*/, 16 );
+
+    result.reset( new uint8_t[ formatSize + blockCount * blockAlign ] );
+    memset( result.get(), 0, formatSize );
+
+    auto adpcm = reinterpret_cast<ADPCMWAVEFORMAT*>( result.get() );
+    adpcm->wfx.wFormatTag = WAVE_FORMAT_ADPCM;
+    adpcm->wfx.nChannels = WORD( channels );
+    adpcm->wfx.nSamplesPerSec = wfx->nSamplesPerSec;
+    adpcm->wfx.nAvgBytesPerSec = DWORD( uint64_t( blockAlign ) * wfx->nSamplesPerSec / ADPCM_SAMPLES_PER_BLOCK );
+    adpcm->wfx.nBlockAlign = WORD( blockAlign );
+    adpcm->wfx.wBitsPerSample = 4 /*MSADPCM_BITS_PER_SAMPLE*/;
+    adpcm->wfx.cbSize = 32 /*MSADPCM_FORMAT_EXTRA_BYTES*/;
+    adpcm->wSamplesPerBlock = ADPCM_SAMPLES_PER_BLOCK;
+    adpcm->wNumCoef = 7 /*MSADPCM_NUM_COEFFICIENTS*/;
+
+    for( int j = 0; j < 7 /*MSADPCM_NUM_COEFFICIENTS*/; ++j )
+    {
+        adpcm->aCoef[ j ].iCoef1 = g_pAdpcmCoefficients1[ j ];
+        adpcm->aCoef[ j ].iCoef2 = g_pAdpcmCoefficients2[ j ];
+    }
+
+    // Blocks are independent, so long waves are split across threads as well
+    uint8_t* audio = result.get() + formatSize;
+    const short* src = samples.get();
+    Concurrency::parallel_for( size_t(0), blockCount, [&]( size_t block )
+    {
+        EncodeAdpcmBlock( src + block * ADPCM_SAMPLES_PER_BLOCK * channels, channels, audio + block * blockAlign );
+    } );
+
+    encoded = source;
+    encoded.wfx = &adpcm->wfx;
+    encoded.startAudio = audio;
+    encoded.audioBytes = uint32_t( blockCount * blockAlign );
+    encoded.seek = nullptr;
+    encoded.seekCount = 0;
+}
+
 bool ConvertToMiniFormat( const WAVEFORMATEX* wfx, bool hasSeek, MINIWAVEFORMAT& miniFmt )
 {
     if ( !wfx )
@@ -431,10 +652,6 @@ bool ConvertToMiniFormat( const WAVEFORMATEX* wfx, bool hasSeek, MINIWAVEFORMAT&
             bool valid = true;
             for ( int j = 0; j < 7 /*MSADPCM_NUM_COEFFICIENTS*/; ++j )
             {
-                // Microsoft ADPCM standard encoding coefficients
-                static const short g_pAdpcmCoefficients1[] = {256,  512, 0, 192, 240,  460,  392};
-                static const short g_pAdpcmCoefficients2[] = {  0, -256, 0,  64,   0, -208, -232};
-
                 if ( wfadpcm->aCoef[j].iCoef1 != g_pAdpcmCoefficients1[j]
                      || wfadpcm->aCoef[j].iCoef2 != g_pAdpcmCoefficients2[j] )
                 {
@@ -771,6 +988,9 @@ enum OPTIONS    // Note: dwOptions below assumes 32 or less options.
     OPT_NOCOMPACT,
     OPT_FRIENDLY_NAMES,
     OPT_NOLOGO,
+    OPT_INCREMENTAL,
+    OPT_THREADS,
+    OPT_ADPCM,
     OPT_MAX
 };
 
@@ -795,8 +1015,11 @@ struct WaveFile
     uint8_t* waveData;
     const SConversion* conv;
     MINIWAVEFORMAT miniFmt;
+    HRESULT hr;
+    uint64_t hash;
+    bool encoded;
 
-    WaveFile() : waveData(nullptr), conv(nullptr) { memset( &data, 0, sizeof(data) ); }
+    WaveFile() : waveData(nullptr), conv(nullptr), hr(E_FAIL), hash(0), encoded(false) { memset( &data, 0, sizeof(data) ); }
 };
 
 void FileNameToIdentifier( _Inout_updates_all_(count) WCHAR* str, size_t count )
@@ -825,6 +1048,9 @@ SValue g_pOptions[] =
     { L"nc",        OPT_NOCOMPACT },
     { L"f",         OPT_FRIENDLY_NAMES },
     { L"nologo",    OPT_NOLOGO },
+    { L"i",         OPT_INCREMENTAL },
+    { L"j",         OPT_THREADS },
+    { L"adpcm",     OPT_ADPCM },
     { nullptr,      0 }
 };
 
@@ -881,6 +1107,10 @@ void PrintUsage()
     wprintf( L"   -c                  force creation of compact wavebank\n" );
     wprintf( L"   -nc                 force creation of non-compact wavebank\n" );
     wprintf( L"   -f                  include entry friendly names\n" );
+    wprintf( L"   -adpcm              encode PCM wave files as MS-ADPCM\n" );
+    wprintf( L"   -i <xwb-filename>   incremental build, reusing the previous wave bank\n" );
+    wprintf( L"                       if no entries have changed\n" );
+    wprintf( L"   -j <count>          number of threads used to read wave files\n" );
     wprintf( L"   -nologo             suppress copyright message\n" );
 }
 
@@ -940,6 +1170,289 @@ bool FileExists( const WCHAR* pszFilename )
     return false;
 }
 
+//--------------------------------------------------------------------------------------
+// FNV-1a hash of entry wave data, used for incremental builds
+//--------------------------------------------------------------------------------------
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t HashBytes( _In_reads_bytes_(size) const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS )
+{
+    auto ptr = reinterpret_cast<const uint8_t*>( data );
+    for( size_t j = 0; j < size; ++j )
+    {
+        hash ^= ptr[ j ];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+//--------------------------------------------------------------------------------------
+// Metadata and per-entry wave data hashes of a previously built wave bank
+//--------------------------------------------------------------------------------------
+struct PreviousBank
+{
+    HEADER                      header;
+    BANKDATA                    data;
+    std::unique_ptr<uint8_t[]>  entries;
+    std::unique_ptr<uint8_t[]>  seekTables;
+    std::unique_ptr<uint8_t[]>  entryNames;
+    std::vector<uint64_t>       hashes;
+
+    PreviousBank() { memset( &header, 0, sizeof(header) ); memset( &data, 0, sizeof(data) ); }
+};
+
+bool ReadFileRegion( _In_ HANDLE hFile, uint64_t offset, _Out_writes_bytes_(bytes) void* buffer, uint32_t bytes )
+{
+    LARGE_INTEGER pos;
+    pos.QuadPart = LONGLONG( offset );
+    if ( !SetFilePointerEx( hFile, pos, nullptr, FILE_BEGIN ) )
+        return false;
+
+    DWORD bytesRead = 0;
+    if ( !ReadFile( hFile, buffer, bytes, &bytesRead, nullptr ) )
+        return false;
+
+    return ( bytesRead == bytes );
+}
+
+bool ReadSegment( _In_ HANDLE hFile, const REGION& segment, std::unique_ptr<uint8_t[]>& result )
+{
+    if ( !segment.dwLength )
+        return true;
+
+    result.reset( new uint8_t[ segment.dwLength ] );
+    return ReadFileRegion( hFile, segment.dwOffset, result.get(), segment.dwLength );
+}
+
+bool LoadPreviousBank( _In_z_ const WCHAR* szFileName, PreviousBank& bank )
+{
+    ScopedHandle hFile( safe_handle( CreateFileW( szFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) ) );
+    if ( !hFile )
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if ( !GetFileSizeEx( hFile.get(), &fileSize ) )
+        return false;
+
+    if ( !ReadFileRegion( hFile.get(), 0, &bank.header, sizeof(HEADER) ) )
+        return false;
+
+    if ( bank.header.dwSignature != HEADER::SIGNATURE || bank.header.dwHeaderVersion != HEADER::VERSION )
+        return false;
+
+    const REGION* segments = bank.header.Segments;
+
+    for( size_t j = 0; j < HEADER::SEGIDX_COUNT; ++j )
+    {
+        if ( ( uint64_t( segments[ j ].dwOffset ) + segments[ j ].dwLength ) > uint64_t( fileSize.QuadPart ) )
+            return false;
+    }
+
+    if ( segments[ HEADER::SEGIDX_BANKDATA ].dwLength != sizeof(BANKDATA)
+         || !ReadFileRegion( hFile.get(), segments[ HEADER::SEGIDX_BANKDATA ].dwOffset, &bank.data, sizeof(BANKDATA) ) )
+        return false;
+
+    uint32_t count = bank.data.dwEntryCount;
+    bool compact = ( bank.data.dwFlags & BANKDATA::FLAGS_COMPACT ) != 0;
+    uint32_t elementSize = compact ? sizeof(ENTRYCOMPACT) : sizeof(ENTRY);
+
+    if ( !count || !bank.data.dwAlignment
+         || bank.data.dwEntryMetaDataElementSize != elementSize
+         || segments[ HEADER::SEGIDX_ENTRYMETADATA ].dwLength != ( uint64_t( count ) * elementSize ) )
+        return false;
+
+    if ( !ReadSegment( hFile.get(), segments[ HEADER::SEGIDX_ENTRYMETADATA ], bank.entries )
+         || !ReadSegment( hFile.get(), segments[ HEADER::SEGIDX_SEEKTABLES ], bank.seekTables )
+         || !ReadSegment( hFile.get(), segments[ HEADER::SEGIDX_ENTRYNAMES ], bank.entryNames ) )
+        return false;
+
+    // Hash the wave data of each entry
+    static const uint32_t HASH_BUFFER_SIZE = 1024 * 1024;
+    std::unique_ptr<uint8_t[]> buffer( new uint8_t[ HASH_BUFFER_SIZE ] );
+
+    const REGION& waveData = segments[ HEADER::SEGIDX_ENTRYWAVEDATA ];
+
+    bank.hashes.reserve( count );
+    for( uint32_t j = 0; j < count; ++j )
+    {
+        uint64_t offset, length;
+        if ( compact )
+        {
+            auto entry = reinterpret_cast<const ENTRYCOMPACT*>( bank.entries.get() ) + j;
+
+            offset = uint64_t( entry->dwOffset ) * bank.data.dwAlignment;
+
+            uint64_t end = ( j < ( count - 1 ) ) ? uint64_t( entry[ 1 ].dwOffset ) * bank.data.dwAlignment : waveData.dwLength;
+            if ( end < ( offset + entry->dwLengthDeviation ) )
+                return false;
+
+            length = end - offset - entry->dwLengthDeviation;
+        }
+        else
+        {
+            auto entry = reinterpret_cast<const ENTRY*>( bank.entries.get() ) + j;
+
+            offset = entry->PlayRegion.dwOffset;
+            length = entry->PlayRegion.dwLength;
+        }
+
+        if ( ( offset + length ) > waveData.dwLength )
+            return false;
+
+        uint64_t hash = FNV_OFFSET_BASIS;
+        uint64_t pos = waveData.dwOffset + offset;
+        while ( length > 0 )
+        {
+            uint32_t chunk = uint32_t( std::min<uint64_t>( length, HASH_BUFFER_SIZE ) );
+            if ( !ReadFileRegion( hFile.get(), pos, buffer.get(), chunk ) )
+                return false;
+
+            hash = HashBytes( buffer.get(), chunk, hash );
+            pos += chunk;
+            length -= chunk;
+        }
+
+        bank.hashes.push_back( hash );
+    }
+
+    return true;
+}
+
+bool IsSameFile( _In_z_ const WCHAR* szFileA, _In_z_ const WCHAR* szFileB )
+{
+    WCHAR fullA[ MAX_PATH ];
+    WCHAR fullB[ MAX_PATH ];
+    if ( !GetFullPathNameW( szFileA, MAX_PATH, fullA, nullptr )
+         || !GetFullPathNameW( szFileB, MAX_PATH, fullB, nullptr ) )
+        return false;
+
+    return ( _wcsicmp( fullA, fullB ) == 0 );
+}
+
+//--------------------------------------------------------------------------------------
+// Sequential writer for the output wave bank. Data is staged through a page-aligned
+// buffer and written in whole sectors so the file can be opened for unbuffered I/O.
+//--------------------------------------------------------------------------------------
+class BankWriter
+{
+public:
+    BankWriter() : mBuffer(nullptr), mUsed(0), mOffset(0) { *mFileName = 0; }
+
+    ~BankWriter()
+    {
+        if ( mBuffer )
+            VirtualFree( mBuffer, 0, MEM_RELEASE );
+    }
+
+    bool Open( _In_z_ const WCHAR* szFileName )
+    {
+        wcscpy_s( mFileName, MAX_PATH, szFileName );
+
+        mBuffer = reinterpret_cast<uint8_t*>( VirtualAlloc( nullptr, BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE ) );
+        if ( !mBuffer )
+            return false;
+
+        mFile.reset( safe_handle( CreateFileW( szFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) ) );
+        if ( !mFile )
+        {
+            // Not all file systems support unbuffered I/O, so fall back to a normal write
+            mFile.reset( safe_handle( CreateFileW( szFileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr ) ) );
+            if ( !mFile )
+                return false;
+        }
+
+        return true;
+    }
+
+    // Appends data to the file, or zeros if data is null
+    bool Write( _In_reads_bytes_opt_(size) const void* data, size_t size )
+    {
+        auto ptr = reinterpret_cast<const uint8_t*>( data );
+
+        while ( size > 0 )
+        {
+            size_t chunk = std::min( size, BUFFER_SIZE - mUsed );
+            if ( ptr )
+            {
+                memcpy( mBuffer + mUsed, ptr, chunk );
+                ptr += chunk;
+            }
+            else
+            {
+                memset( mBuffer + mUsed, 0, chunk );
+            }
+
+            mUsed += chunk;
+            mOffset += chunk;
+            size -= chunk;
+
+            if ( mUsed == BUFFER_SIZE && !Flush() )
+                return false;
+        }
+
+        return true;
+    }
+
+    // Zero-fills the file up to the given offset
+    bool PadTo( uint64_t offset )
+    {
+        assert( offset >= mOffset );
+        return Write( nullptr, size_t( offset - mOffset ) );
+    }
+
+    bool Close()
+    {
+        if ( mUsed > 0 )
+        {
+            // Unbuffered writes must be a multiple of the sector size, so pad the final write
+            size_t alignedSize = BLOCKALIGNPAD( mUsed, SECTOR_ALIGNMENT );
+            memset( mBuffer + mUsed, 0, alignedSize - mUsed );
+            mUsed = alignedSize;
+
+            if ( !Flush() )
+                return false;
+        }
+
+        mFile.reset();
+
+        // Trim the sector padding
+        ScopedHandle hFile( safe_handle( CreateFileW( mFileName, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr ) ) );
+        if ( !hFile )
+            return false;
+
+        LARGE_INTEGER eof;
+        eof.QuadPart = LONGLONG( mOffset );
+        if ( !SetFilePointerEx( hFile.get(), eof, nullptr, FILE_BEGIN ) )
+            return false;
+
+        return ( SetEndOfFile( hFile.get() ) != 0 );
+    }
+
+    uint64_t Offset() const { return mOffset; }
+
+private:
+    static const size_t BUFFER_SIZE = 4 * 1024 * 1024;
+    static const size_t SECTOR_ALIGNMENT = 4096;
+
+    bool Flush()
+    {
+        DWORD bytesWritten = 0;
+        if ( !WriteFile( mFile.get(), mBuffer, DWORD( mUsed ), &bytesWritten, nullptr ) || bytesWritten != mUsed )
+            return false;
+
+        mUsed = 0;
+        return true;
+    }
+
+    ScopedHandle    mFile;
+    WCHAR           mFileName[ MAX_PATH ];
+    uint8_t*        mBuffer;
+    size_t          mUsed;
+    uint64_t        mOffset;
+};
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -956,8 +1469,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
 
     WCHAR szOutputFile[MAX_PATH] = { 0 };
     WCHAR szHeaderFile[MAX_PATH] = { 0 };
-
-    ScopedHandle hFile;
+    WCHAR szPreviousFile[MAX_PATH] = { 0 };
+    DWORD dwThreads = 0;
 
     // Process command line
     DWORD dwOptions = 0;
@@ -989,7 +1502,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             dwOptions |= 1 << dwOption;
 
             if( (OPT_NOLOGO != dwOption) && (OPT_STREAMING != dwOption) && (OPT_NOOVERWRITE != dwOption)
-                && (OPT_COMPACT != dwOption) && (OPT_NOCOMPACT != dwOption) && (OPT_FRIENDLY_NAMES != dwOption) )
+                && (OPT_COMPACT != dwOption) && (OPT_NOCOMPACT != dwOption) && (OPT_FRIENDLY_NAMES != dwOption)
+                && (OPT_ADPCM != dwOption) )
             {
                 if(!*pValue)
                 {
@@ -1014,6 +1528,19 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 wcscpy_s(szHeaderFile, MAX_PATH, pValue);
                 break;
 
+            case OPT_INCREMENTAL:
+                wcscpy_s(szPreviousFile, MAX_PATH, pValue);
+                break;
+
+            case OPT_THREADS:
+                if ( swscanf_s( pValue, L"%u", &dwThreads ) != 1 || !dwThreads || dwThreads > 64 )
+                {
+                    wprintf( L"Invalid value specified with -j (%ls)\n\n", pValue );
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
             case OPT_COMPACT:
                 if ( dwOptions & (1 << OPT_NOCOMPACT) )
                 {
@@ -1059,22 +1586,21 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     // Gather wave files
     std::unique_ptr<uint8_t[]> entries;
     std::unique_ptr<char[]> entryNames;
+    std::unique_ptr<uint32_t[]> seekTables;
     std::vector<WaveFile> waves; 
+    PreviousBank previous;
     MINIWAVEFORMAT compactFormat={0};
 
     bool xma = false;
 
     for( SConversion *pConv = pConversion; pConv; pConv = pConv->pNext )
     {
-        WCHAR ext[_MAX_EXT];
-        WCHAR fname[_MAX_FNAME];
-        _wsplitpath_s( pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
-
-        // Load source image
-        if( pConv != pConversion )
-            wprintf( L"\n");
-        else if ( !*szOutputFile )
+        if ( pConv == pConversion && !*szOutputFile )
         {
+            WCHAR ext[_MAX_EXT];
+            WCHAR fname[_MAX_FNAME];
+            _wsplitpath_s( pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT );
+
             if ( _wcsicmp( ext, L".xwb" ) == 0 )
             {
                 wprintf( L"ERROR: Need to specify output file via -o\n");
@@ -1084,28 +1610,74 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             _wmakepath_s( szOutputFile, nullptr, nullptr, fname, L".xwb" );
         }
 
-        wprintf( L"reading %ls", pConv->szSrc );
-        fflush(stdout);
-
         WaveFile wave;
         wave.conv = pConv;
-        std::unique_ptr<uint8_t[]> waveData;
+        waves.emplace_back( wave );
+    }
 
-        HRESULT hr = DirectX::LoadWAVAudioFromFileEx( pConv->szSrc, waveData, wave.data );
-        if ( FAILED(hr) )
+    // Load source files in parallel. Results are stored by input index, so the wave bank
+    // entry order is the command-line order regardless of how the reads are scheduled.
+    {
+        bool incremental = ( *szPreviousFile != 0 );
+        bool adpcm = ( dwOptions & (1 << OPT_ADPCM) ) != 0;
+
+        if ( dwThreads > 0 )
         {
-            wprintf( L"\nERROR: Failed to load file (%08X)\n", hr);
+            Concurrency::CurrentScheduler::Create( Concurrency::SchedulerPolicy( 2,
+                                                                                Concurrency::MinConcurrency, 1,
+                                                                                Concurrency::MaxConcurrency, dwThreads ) );
+        }
+
+        Concurrency::parallel_for( size_t(0), waves.size(), [&]( size_t j )
+        {
+            auto& wave = waves[ j ];
+
+            std::unique_ptr<uint8_t[]> waveData;
+            wave.hr = DirectX::LoadWAVAudioFromFileEx( wave.conv->szSrc, waveData, wave.data );
+            if ( SUCCEEDED(wave.hr) )
+            {
+                if ( adpcm && CanEncodeADPCM( wave.data ) )
+                {
+                    std::unique_ptr<uint8_t[]> encodedData;
+                    EncodeADPCM( wave.data, encodedData, wave.data );
+                    waveData.swap( encodedData );
+                    wave.encoded = true;
+                }
+
+                wave.waveData = waveData.release();
+
+                if ( incremental )
+                    wave.hash = HashBytes( wave.data.startAudio, wave.data.audioBytes );
+            }
+        } );
+
+        if ( dwThreads > 0 )
+            Concurrency::CurrentScheduler::Detach();
+    }
+
+    for( auto it = waves.begin(); it != waves.end(); ++it )
+    {
+        if ( it != waves.begin() )
+            wprintf( L"\n");
+
+        wprintf( L"reading %ls", it->conv->szSrc );
+
+        if ( FAILED(it->hr) )
+        {
+            wprintf( L"\nERROR: Failed to load file (%08X)\n", it->hr);
             goto LError;
         }
 
-        wave.waveData = waveData.release();
+        PrintInfo( *it );
 
-        PrintInfo( wave );
+        if ( ( dwOptions & (1 << OPT_ADPCM) ) && !it->encoded && it->data.wfx->wFormatTag == WAVE_FORMAT_PCM )
+        {
+            wprintf( L"\nWARNING: Left as PCM, ADPCM encoding needs 8-bit or 16-bit mono or stereo data with loop points on %u sample boundaries",
+                     ADPCM_SAMPLES_PER_BLOCK );
+        }
 
-        if ( wave.data.wfx->wFormatTag == WAVE_FORMAT_XMA2 )
+        if ( it->data.wfx->wFormatTag == WAVE_FORMAT_XMA2 )
             xma = true;
-
-        waves.emplace_back( wave );
     }
 
     wprintf( L"\n" );
@@ -1286,35 +1858,54 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
 
     assert( count > 0 && count == waves.size() );
 
-    // Create wave bank
-    assert( *szOutputFile != 0 );
+    // Build seek tables
+    uint32_t seekLen = 0;
 
-    wprintf( L"writing %ls%ls wavebank %ls\n", (compact) ? L"compact " : L"", (dwOptions & (1 << OPT_STREAMING)) ? L"streaming" : L"in-memory", szOutputFile );
-    fflush(stdout);
-
-    if (dwOptions & (1 << OPT_NOOVERWRITE))
+    if ( seekEntries > 0 )
     {
-        if ( FileExists( szOutputFile ) )
-        {
-            wprintf( L"ERROR: Output file %ls already exists!\n", szOutputFile );
-            goto LError;
-        }
+        seekEntries += waves.size(); // Room for an offset per entry
 
-        if ( *szHeaderFile )
+        seekTables.reset( new uint32_t[ seekEntries ] );
+
+        uint32_t seekoffset = 0;
+        uint32_t index = 0;
+        for( auto it = waves.begin(); it != waves.end(); ++it, ++index )
         {
-            if ( FileExists( szHeaderFile ) )
+            if ( it->miniFmt.wFormatTag == MINIWAVEFORMAT::TAG_WMA )
             {
-                wprintf( L"ERROR: Output header file %ls already exists!\n", szHeaderFile );
-                goto LError;
+                seekTables[ index ] = seekoffset * sizeof(uint32_t);
+
+                uint32_t baseoffset = uint32_t( waves.size() + seekoffset );
+                seekTables[ baseoffset ] = it->data.seekCount;
+
+                for( uint32_t j = 0; j < it->data.seekCount; ++j )
+                {
+                    seekTables[ baseoffset + j + 1 ]  = it->data.seek[ j ];
+                }
+
+                seekoffset += it->data.seekCount + 1;
+            }
+            else if ( it->miniFmt.wFormatTag == MINIWAVEFORMAT::TAG_XMA )
+            {
+                seekTables[ index ] = seekoffset * sizeof(uint32_t);
+
+                uint32_t baseoffset = uint32_t( waves.size() + seekoffset );
+                seekTables[ baseoffset ] = it->data.seekCount;
+
+                for( uint32_t j = 0; j < it->data.seekCount; ++j )
+                {
+                    seekTables[ baseoffset + j + 1 ]  = _byteswap_ulong( it->data.seek[ j ] );
+                }
+
+                seekoffset += it->data.seekCount + 1;
+            }
+            else
+            {
+                seekTables[ index ] = uint32_t( -1 );
             }
         }
-    }
 
-    hFile.reset( safe_handle( CreateFileW( szOutputFile, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr ) ) );
-    if ( !hFile )
-    {
-        wprintf( L"ERROR: Failed opening output file %ls, %u\n", szOutputFile, GetLastError() );
-        goto LError;
+        seekLen = uint32_t( sizeof(uint32_t) * seekEntries );
     }
 
     // Setup wave bank header
@@ -1324,11 +1915,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     header.dwHeaderVersion = HEADER::VERSION;
     header.dwVersion = XACT_CONTENT_VERSION;
 
-    DWORD segmentOffset = sizeof(HEADER);
-
-    // Write bank metadata
-    assert( ( segmentOffset % 4 ) == 0 );
-
+    // Setup bank metadata
     BANKDATA data;
     memset( &data, 0, sizeof(data) );
 
@@ -1369,193 +1956,195 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
     }
 
-    if ( SetFilePointer( hFile.get(), segmentOffset, 0, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
-    {
-        wprintf( L"ERROR: Failed writing bank data to %ls, SFP %u\n", szOutputFile, GetLastError() );
-        goto LError;
-    }
+    // Lay out segments
+    uint32_t entryBytes = uint32_t( waves.size() * data.dwEntryMetaDataElementSize );
+    uint32_t entryNamesBytes = uint32_t( count * data.dwEntryNameElementSize );
 
-    if ( !WriteFile( hFile.get(), &data, sizeof(data), nullptr, nullptr ) )
-    {
-        wprintf( L"ERROR: Failed writing bank data to %ls, %u\n", szOutputFile, GetLastError() );
-        goto LError;
-    }
+    DWORD segmentOffset = sizeof(HEADER);
 
+    assert( ( segmentOffset % 4 ) == 0 );
     header.Segments[ HEADER::SEGIDX_BANKDATA ].dwOffset = segmentOffset;
     header.Segments[ HEADER::SEGIDX_BANKDATA ].dwLength = sizeof(BANKDATA);
     segmentOffset += sizeof(BANKDATA);
 
-    // Write entry metadata
     assert( ( segmentOffset % 4 ) == 0 );
+    header.Segments[ HEADER::SEGIDX_ENTRYMETADATA ].dwOffset = segmentOffset;
+    header.Segments[ HEADER::SEGIDX_ENTRYMETADATA ].dwLength = entryBytes;
+    segmentOffset += entryBytes;
+
+    assert( ( segmentOffset % 4 ) == 0 );
+    header.Segments[ HEADER::SEGIDX_SEEKTABLES ].dwOffset = segmentOffset;
+    header.Segments[ HEADER::SEGIDX_SEEKTABLES ].dwLength = seekLen;
+    segmentOffset += seekLen;
 
-    if ( SetFilePointer( hFile.get(), segmentOffset, 0, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+    if ( dwOptions & (1 << OPT_FRIENDLY_NAMES ) )
     {
-        wprintf( L"ERROR: Failed writing entry metadata to %ls, SFP %u\n", szOutputFile, GetLastError() );
-        goto LError;
+        assert( ( segmentOffset % 4 ) == 0 );
+        header.Segments[ HEADER::SEGIDX_ENTRYNAMES ].dwOffset = segmentOffset;
+        header.Segments[ HEADER::SEGIDX_ENTRYNAMES ].dwLength = entryNamesBytes;
+        segmentOffset += entryNamesBytes;
     }
 
-    uint32_t entryBytes = uint32_t( waves.size() * data.dwEntryMetaDataElementSize );
-    if ( !WriteFile( hFile.get(), entries.get(), entryBytes, nullptr, nullptr ) )
+    segmentOffset = BLOCKALIGNPAD( segmentOffset, dwAlignment );
+
+    if ( ( uint64_t(segmentOffset) + waveOffset ) > 0xFFFFFFFF )
     {
-        wprintf( L"ERROR: Failed writing entry metadata to %ls, %u\n", szOutputFile, GetLastError() );
+        wprintf( L"ERROR: Data exceeds maximum size for wavebank\n" );
         goto LError;
     }
 
-    header.Segments[ HEADER::SEGIDX_ENTRYMETADATA ].dwOffset = segmentOffset;
-    header.Segments[ HEADER::SEGIDX_ENTRYMETADATA ].dwLength = entryBytes;
-    segmentOffset += entryBytes;
-
-    // Write seek tables
-    assert( ( segmentOffset % 4 ) == 0 );
+    header.Segments[ HEADER::SEGIDX_ENTRYWAVEDATA ].dwOffset = segmentOffset;
+    header.Segments[ HEADER::SEGIDX_ENTRYWAVEDATA ].dwLength = uint32_t( waveOffset );
 
-    header.Segments[ HEADER::SEGIDX_SEEKTABLES ].dwOffset = segmentOffset;
+    // Create wave bank
+    assert( *szOutputFile != 0 );
 
-    if ( seekEntries > 0 )
+    if (dwOptions & (1 << OPT_NOOVERWRITE))
     {
-        seekEntries += waves.size(); // Room for an offset per entry
-
-        std::unique_ptr<uint32_t[]> seekTables( new uint32_t[ seekEntries ] );
-
-        if ( SetFilePointer( hFile.get(), segmentOffset, 0, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+        if ( FileExists( szOutputFile ) )
         {
-            wprintf( L"ERROR: Failed writing seek tables to %ls, SFP %u\n", szOutputFile, GetLastError() );
+            wprintf( L"ERROR: Output file %ls already exists!\n", szOutputFile );
             goto LError;
         }
 
-        uint32_t seekoffset = 0;
-        uint32_t index = 0;
-        for( auto it = waves.begin(); it != waves.end(); ++it, ++index )
+        if ( *szHeaderFile )
         {
-            if ( it->miniFmt.wFormatTag == MINIWAVEFORMAT::TAG_WMA )
+            if ( FileExists( szHeaderFile ) )
             {
-                seekTables[ index ] = seekoffset * sizeof(uint32_t);
+                wprintf( L"ERROR: Output header file %ls already exists!\n", szHeaderFile );
+                goto LError;
+            }
+        }
+    }
 
-                uint32_t baseoffset = uint32_t( waves.size() + seekoffset );
-                seekTables[ baseoffset ] = it->data.seekCount;
+    // Compare against the previous wave bank for an incremental build
+    bool upToDate = false;
 
-                for( uint32_t j = 0; j < it->data.seekCount; ++j )
-                {
-                    seekTables[ baseoffset + j + 1 ]  = it->data.seek[ j ];
-                }
+    if ( *szPreviousFile )
+    {
+        if ( !LoadPreviousBank( szPreviousFile, previous ) )
+        {
+            wprintf( L"previous wave bank %ls not found or invalid, rebuilding all entries\n", szPreviousFile );
+        }
+        else
+        {
+            std::vector<uint64_t> hashes( previous.hashes );
+            std::sort( hashes.begin(), hashes.end() );
 
-                seekoffset += it->data.seekCount + 1;
+            size_t unchanged = 0;
+            for( auto it = waves.begin(); it != waves.end(); ++it )
+            {
+                if ( std::binary_search( hashes.begin(), hashes.end(), it->hash ) )
+                    ++unchanged;
             }
-            else if ( it->miniFmt.wFormatTag == MINIWAVEFORMAT::TAG_XMA )
+
+            wprintf( L"%Iu of %Iu entries unchanged from %ls\n", unchanged, waves.size(), szPreviousFile );
+
+            if ( unchanged == waves.size() && previous.hashes.size() == waves.size() )
             {
-                seekTables[ index ] = seekoffset * sizeof(uint32_t);
+                // Everything but the build time must match for the previous bank to be reused
+                BANKDATA previousData = previous.data;
+                previousData.BuildTime = data.BuildTime;
 
-                uint32_t baseoffset = uint32_t( waves.size() + seekoffset );
-                seekTables[ baseoffset ] = it->data.seekCount;
+                upToDate = ( memcmp( &header, &previous.header, sizeof(HEADER) ) == 0 )
+                           && ( memcmp( &data, &previousData, sizeof(BANKDATA) ) == 0 )
+                           && ( memcmp( entries.get(), previous.entries.get(), entryBytes ) == 0 )
+                           && ( !seekLen || memcmp( seekTables.get(), previous.seekTables.get(), seekLen ) == 0 )
+                           && ( !( dwOptions & (1 << OPT_FRIENDLY_NAMES) ) || memcmp( entryNames.get(), previous.entryNames.get(), entryNamesBytes ) == 0 );
 
-                for( uint32_t j = 0; j < it->data.seekCount; ++j )
+                for( size_t j = 0; upToDate && j < waves.size(); ++j )
                 {
-                    seekTables[ baseoffset + j + 1 ]  = _byteswap_ulong( it->data.seek[ j ] );
+                    if ( waves[ j ].hash != previous.hashes[ j ] )
+                        upToDate = false;
                 }
-
-                seekoffset += it->data.seekCount + 1;
-            }
-            else
-            {
-                seekTables[ index ] = uint32_t( -1 );
             }
         }
+    }
 
-        uint32_t seekLen = uint32_t( sizeof(uint32_t) * seekEntries );
-
-        if ( !WriteFile( hFile.get(), seekTables.get(), seekLen, nullptr, nullptr ) )
+    if ( upToDate )
+    {
+        if ( IsSameFile( szPreviousFile, szOutputFile ) )
         {
-            wprintf( L"ERROR: Failed writing seek tables to %ls, %u\n", szOutputFile, GetLastError() );
-            goto LError;
+            wprintf( L"wavebank %ls is up to date\n", szOutputFile );
         }
+        else
+        {
+            wprintf( L"copying unchanged wavebank %ls to %ls\n", szPreviousFile, szOutputFile );
 
-        segmentOffset += seekLen;
-
-        header.Segments[ HEADER::SEGIDX_SEEKTABLES ].dwLength = seekLen;
+            if ( !CopyFileW( szPreviousFile, szOutputFile, FALSE ) )
+            {
+                wprintf( L"ERROR: Failed copying wavebank to %ls, %u\n", szOutputFile, GetLastError() );
+                goto LError;
+            }
+        }
     }
     else
     {
-        header.Segments[ HEADER::SEGIDX_SEEKTABLES ].dwLength = 0;
-    }
-
-    // Write entry names
-    if ( dwOptions & (1 << OPT_FRIENDLY_NAMES ) )
-    {
-        assert( ( segmentOffset % 4 ) == 0 );
+        wprintf( L"writing %ls%ls wavebank %ls\n", (compact) ? L"compact " : L"", (dwOptions & (1 << OPT_STREAMING)) ? L"streaming" : L"in-memory", szOutputFile );
+        fflush(stdout);
 
-        if ( SetFilePointer( hFile.get(), segmentOffset, 0, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+        // Write all segments in one sequential pass
+        BankWriter writer;
+        if ( !writer.Open( szOutputFile ) )
         {
-            wprintf( L"ERROR: Failed writing friendly entry names to %ls, SFP %u\n", szOutputFile, GetLastError() );
+            wprintf( L"ERROR: Failed opening output file %ls, %u\n", szOutputFile, GetLastError() );
             goto LError;
         }
 
-        uint32_t entryNamesBytes = uint32_t( count * data.dwEntryNameElementSize );
-        if ( !WriteFile( hFile.get(), entryNames.get(), entryNamesBytes, nullptr, nullptr ) )
+        if ( !writer.Write( &header, sizeof(header) ) )
         {
-            wprintf( L"ERROR: Failed writing friendly entry names to %ls, %u\n", szOutputFile, GetLastError() );
+            wprintf( L"ERROR: Failed writing header to %ls, %u\n", szOutputFile, GetLastError() );
             goto LError;
         }
 
-        header.Segments[ HEADER::SEGIDX_ENTRYNAMES ].dwOffset = segmentOffset;
-        header.Segments[ HEADER::SEGIDX_ENTRYNAMES ].dwLength = entryNamesBytes;
-        segmentOffset += entryNamesBytes;
-    }
-
-    // Write wave data
-    segmentOffset = BLOCKALIGNPAD( segmentOffset, dwAlignment );
-
-    header.Segments[ HEADER::SEGIDX_ENTRYWAVEDATA ].dwOffset = segmentOffset;
-    header.Segments[ HEADER::SEGIDX_ENTRYWAVEDATA ].dwLength = uint32_t( waveOffset );
-
-    for( auto it = waves.begin(); it != waves.end(); ++it )
-    {
-        if ( SetFilePointer( hFile.get(), segmentOffset, 0, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
+        if ( !writer.Write( &data, sizeof(data) ) )
         {
-            wprintf( L"ERROR: Failed writing audio data to %ls, SFP %u\n", szOutputFile, GetLastError() );
+            wprintf( L"ERROR: Failed writing bank data to %ls, %u\n", szOutputFile, GetLastError() );
             goto LError;
         }
 
-        if ( !WriteFile( hFile.get(), it->data.startAudio, it->data.audioBytes, nullptr, nullptr ) )
+        if ( !writer.Write( entries.get(), entryBytes ) )
         {
-            wprintf( L"ERROR: Failed writing audio data to %ls, %u\n", szOutputFile, GetLastError() );
+            wprintf( L"ERROR: Failed writing entry metadata to %ls, %u\n", szOutputFile, GetLastError() );
             goto LError;
         }
 
-        DWORD alignedSize = BLOCKALIGNPAD( it->data.audioBytes, dwAlignment );
-
-        if ( ( uint64_t(segmentOffset) + alignedSize ) > 0xFFFFFFFF )
+        if ( seekLen > 0 && !writer.Write( seekTables.get(), seekLen ) )
         {
-            wprintf( L"ERROR: Data exceeds maximum size for wavebank\n" );
+            wprintf( L"ERROR: Failed writing seek tables to %ls, %u\n", szOutputFile, GetLastError() );
             goto LError;
         }
 
-        segmentOffset += alignedSize;
-    }
-
-    assert( segmentOffset == ( header.Segments[ HEADER::SEGIDX_ENTRYWAVEDATA ].dwOffset + waveOffset ) );
+        if ( ( dwOptions & (1 << OPT_FRIENDLY_NAMES ) ) && !writer.Write( entryNames.get(), entryNamesBytes ) )
+        {
+            wprintf( L"ERROR: Failed writing friendly entry names to %ls, %u\n", szOutputFile, GetLastError() );
+            goto LError;
+        }
 
-    // Commit wave bank
-    if ( SetFilePointer( hFile.get(), segmentOffset, 0, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
-    {
-        wprintf( L"ERROR: Failed committing output file %ls, EOF %u\n", szOutputFile, GetLastError() );
-        goto LError;
-    }
+        for( auto it = waves.begin(); it != waves.end(); ++it )
+        {
+            if ( !writer.PadTo( BLOCKALIGNPAD( writer.Offset(), dwAlignment ) )
+                 || !writer.Write( it->data.startAudio, it->data.audioBytes ) )
+            {
+                wprintf( L"ERROR: Failed writing audio data to %ls, %u\n", szOutputFile, GetLastError() );
+                goto LError;
+            }
+        }
 
-    if ( !SetEndOfFile( hFile.get() ) )
-    {
-        wprintf( L"ERROR: Failed committing output file %ls, EOF %u\n", szOutputFile, GetLastError() );
-        goto LError;
-    }
+        if ( !writer.PadTo( BLOCKALIGNPAD( writer.Offset(), dwAlignment ) ) )
+        {
+            wprintf( L"ERROR: Failed writing audio data to %ls, %u\n", szOutputFile, GetLastError() );
+            goto LError;
+        }
 
-    if ( SetFilePointer( hFile.get(), 0, 0, FILE_BEGIN ) == INVALID_SET_FILE_POINTER )
-    {
-        wprintf( L"ERROR: Failed committing output file %ls, HDR %u\n", szOutputFile, GetLastError() );
-        goto LError;
-    }
+        assert( writer.Offset() == ( uint64_t( header.Segments[ HEADER::SEGIDX_ENTRYWAVEDATA ].dwOffset ) + waveOffset ) );
 
-    if ( !WriteFile( hFile.get(), &header, sizeof(header), nullptr, nullptr ) )
-    {
-        wprintf( L"ERROR: Failed committing output file %ls, HDR %u\n", szOutputFile, GetLastError() );
-        goto LError;
+        // Commit wave bank
+        if ( !writer.Close() )
+        {
+            wprintf( L"ERROR: Failed committing output file %ls, EOF %u\n", szOutputFile, GetLastError() );
+            goto LError;
+        }
     }
 
     // Write C header if requested